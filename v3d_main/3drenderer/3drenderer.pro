@@ -40,6 +40,9 @@ INCLUDEPATH += ../basic_c_fun/
 HEADERS += GLee_r.h \
     renderer.h \
     renderer_gl1.h \
+    pickindex.h \
+    neurontube.h \
+    labelmarchingcubes.h \
     renderer_gl2.h \
     v3dr_mainwindow.h \
     v3dr_glwidget.h \
@@ -52,7 +55,12 @@ SOURCES += GLee_r.c \
     renderer.cpp \
     renderer_tex.cpp \
     renderer_obj.cpp \
+    renderer_brick.cpp \
+    renderer_tube.cpp \
     renderer_hit.cpp \
+    pickindex.cpp \
+    neurontube.cpp \
+    labelmarchingcubes.cpp \
     renderer_labelfield.cpp \
     renderer_gl2.cpp \
     test_main.cpp \
@@ -0,0 +1,11 @@
+# micro-benchmark of the picking index (standalone, not part of the V3D build)
+TEMPLATE = app
+TARGET = benchmark_pick
+CONFIG += console release
+CONFIG -= qt
+mac {
+    CONFIG -= app_bundle
+}
+HEADERS += ../pickindex.h
+SOURCES += ../pickindex.cpp \
+           benchmark_pick.cpp
@@ -0,0 +1,227 @@
+// Micro-benchmark of the block-parallel label field marching cubes used by Renderer_gl1::constructLabelfieldSurf
+// (see labelmarchingcubes.h), against MarchingCubes() called once per label with the label sampling function.
+// A random label field of touching blobs is extracted both ways. Each label must get the same surface area
+// (MarchingCubes samples a grid point shared by two cubes at slightly different float positions, so a few cubes
+// with values right at the iso value may differ), the blocks must share their face vertexes as one single block
+// does, and the merge of blocks marched by several threads must equal the serial run.
+//
+// usage: benchmark_labelmc [size [labels [steps [threads]]]]
+
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <vector>
+#include <pthread.h>
+#include <sys/time.h>
+
+#include "../labelmarchingcubes.h"
+#include "../marchingcubes.cpp"
+
+static double now()
+{
+    timeval t;
+    gettimeofday(&t, 0);
+    return t.tv_sec + t.tv_usec * 1e-6;
+}
+
+// the label sampling function of renderer_labelfield.cpp
+static unsigned short* lf_data = 0;
+static int lf_sz0, lf_sz1, lf_sz2;
+static int mesh_iso0, mesh_iso1;
+
+static float labelSample(float fX, float fY, float fZ)
+{
+    float x = CLAMP01(fX)*(lf_sz0-1), y = CLAMP01(fY)*(lf_sz1-1), z = CLAMP01(fZ)*(lf_sz2-1);
+    int x0 = floor(x), x1 = ceil(x), y0 = floor(y), y1 = ceil(y), z0 = floor(z), z1 = ceil(z);
+    float xf = x-x0, yf = y-y0, zf = z-z0;
+    #define SAMPLE(ix,iy,iz)  float(lf_data[(iz)*lf_sz1*lf_sz0 + (iy)*lf_sz0 + (ix)])
+    float is[8] = {SAMPLE(x0,y0,z0), SAMPLE(x0,y0,z1), SAMPLE(x0,y1,z0), SAMPLE(x0,y1,z1),
+                   SAMPLE(x1,y0,z0), SAMPLE(x1,y0,z1), SAMPLE(x1,y1,z0), SAMPLE(x1,y1,z1)};
+    float sf[8] = {(1-xf)*(1-yf)*(1-zf), (1-xf)*(1-yf)*(zf), (1-xf)*(yf)*(1-zf), (1-xf)*(yf)*(zf),
+                   (xf)*(1-yf)*(1-zf), (xf)*(1-yf)*(zf), (xf)*(yf)*(1-zf), (xf)*(yf)*(zf)};
+    float count = 0;
+    for(int i=0; i<8; i++) count += (mesh_iso0<=is[i] && is[i]<=mesh_iso1) * sf[i];
+    return count*255;
+}
+
+static double triArea(const float* a, const float* b, const float* c)
+{
+    double u[3] = {b[0]-a[0], b[1]-a[1], b[2]-a[2]}, v[3] = {c[0]-a[0], c[1]-a[1], c[2]-a[2]};
+    double n[3] = {u[1]*v[2]-u[2]*v[1], u[2]*v[0]-u[0]*v[2], u[0]*v[1]-u[1]*v[0]};
+    return 0.5 * sqrt(n[0]*n[0] + n[1]*n[1] + n[2]*n[2]);
+}
+
+static double meshArea(const LabelMesh& m)
+{
+    double s = 0;
+    for(size_t t=0; t<m.index.size(); t+=3)
+        s += triArea(&m.vertex[3*m.index[t]], &m.vertex[3*m.index[t+1]], &m.vertex[3*m.index[t+2]]);
+    return s;
+}
+
+static bool sameMeshes(const std::vector<LabelMesh>& a, const std::vector<LabelMesh>& b)
+{
+    if(a.size() != b.size()) return false;
+    for(size_t g=0; g<a.size(); g++)
+        if(a[g].vertex != b[g].vertex || a[g].normal != b[g].normal || a[g].index != b[g].index) return false;
+    return true;
+}
+
+// blocks marched by threads, merged in block order as they finish
+struct Shared
+{
+    LabelMarchingCubes* mc;
+    std::vector<LabelMeshBlock> blocks;
+    std::vector<int> done;
+    int next;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+};
+
+static void* worker(void* arg)
+{
+    Shared* s = (Shared*)arg;
+    for(;;)
+    {
+        pthread_mutex_lock(&s->mutex);
+        int b = s->next++;
+        pthread_mutex_unlock(&s->mutex);
+        if(b >= s->mc->blockCount()) return 0;
+
+        s->mc->marchBlock(b, s->blocks[b]);
+        pthread_mutex_lock(&s->mutex);
+        s->done[b] = 1;
+        pthread_cond_signal(&s->cond);
+        pthread_mutex_unlock(&s->mutex);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    int size = 128, n_labels = 300, steps = 128, n_threads = 4;
+    if(argc >= 2) size = atoi(argv[1]);
+    if(argc >= 3) n_labels = atoi(argv[2]);
+    if(argc >= 4) steps = atoi(argv[3]);
+    if(argc >= 5) n_threads = atoi(argv[4]);
+
+    // nearest-seed cells within random radius, label 0 outside
+    int sx = size, sy = size - size/4, sz = size/2 + 3;
+    srand(0);
+    std::vector<float> seed(4 * n_labels);
+    for(int l=0; l<n_labels; l++)
+    {
+        seed[4*l] = rand() % sx;  seed[4*l+1] = rand() % sy;  seed[4*l+2] = rand() % sz;
+        seed[4*l+3] = 4 + rand() % (size/8 + 1);
+    }
+    std::vector<unsigned short> volume(size_t(sx) * sy * sz, 0);
+    for(int z=0; z<sz; z++) for(int y=0; y<sy; y++) for(int x=0; x<sx; x++)
+    {
+        float best = 1e30f; int label = 0;
+        for(int l=0; l<n_labels; l++)
+        {
+            float dx = x-seed[4*l], dy = y-seed[4*l+1], dz = z-seed[4*l+2];
+            float d2 = dx*dx + dy*dy + dz*dz;
+            if(d2 < best && d2 < seed[4*l+3]*seed[4*l+3]) {best = d2; label = l+1;}
+        }
+        volume[(size_t(z)*sy + y)*sx + x] = label;
+    }
+    std::vector< std::pair<float,float> > groups;
+    for(int l=1; l<=n_labels; l++) groups.push_back(std::make_pair(float(l), float(l)));
+
+    // one MarchingCubes pass per label
+    lf_data = &volume[0];
+    lf_sz0 = sx;  lf_sz1 = sy;  lf_sz2 = sz;
+    std::vector<long> legacyCount(n_labels);
+    std::vector<double> legacyArea(n_labels);
+    double t0 = now();
+    for(int l=0; l<n_labels; l++)
+    {
+        mesh_iso0 = mesh_iso1 = l+1;
+        Triangle* pT = MarchingCubes(steps, 255/2.f, labelSample, 0);
+        legacyCount[l] = numTriangles(pT);
+        double s = 0;
+        for(Triangle* p = pT; p; p = p->next) s += triArea(p->vertex[0], p->vertex[1], p->vertex[2]);
+        legacyArea[l] = s;
+        delTriangles(pT);
+    }
+    double t_legacy = now() - t0;
+
+    // all labels in one pass, serial
+    std::vector<LabelMesh> meshes;
+    t0 = now();
+    {
+        LabelMarchingCubes mc(&volume[0], 2, sx, sy, sz, steps, groups);
+        mc.run(meshes);
+    }
+    double t_serial = now() - t0;
+
+    // one single block: same shared vertexes as merged blocks
+    std::vector<LabelMesh> single;
+    {
+        LabelMarchingCubes mc(&volume[0], 2, sx, sy, sz, steps, groups, steps);
+        mc.run(single);
+    }
+
+    // threads
+    std::vector<LabelMesh> parallel;
+    t0 = now();
+    {
+        LabelMarchingCubes mc(&volume[0], 2, sx, sy, sz, steps, groups);
+        Shared s;
+        s.mc = &mc;
+        s.blocks.resize(mc.blockCount());
+        s.done.assign(mc.blockCount(), 0);
+        s.next = 0;
+        pthread_mutex_init(&s.mutex, 0);
+        pthread_cond_init(&s.cond, 0);
+        std::vector<pthread_t> threads(n_threads);
+        for(int t=0; t<n_threads; t++) pthread_create(&threads[t], 0, worker, &s);
+        for(int b=0; b<mc.blockCount(); b++)
+        {
+            pthread_mutex_lock(&s.mutex);
+            while(! s.done[b]) pthread_cond_wait(&s.cond, &s.mutex);
+            pthread_mutex_unlock(&s.mutex);
+            mc.merge(s.blocks[b], parallel);
+            s.blocks[b] = LabelMeshBlock();
+        }
+        for(int t=0; t<n_threads; t++) pthread_join(threads[t], 0);
+    }
+    double t_parallel = now() - t0;
+
+    bool ok = true;
+    long triangles = 0, vertexes = 0, same_count = 0;
+    for(int l=0; l<n_labels; l++)
+    {
+        const LabelMesh& m = meshes[l];
+        double area = meshArea(m);
+        triangles += m.triangleCount();
+        vertexes += m.vertex.size()/3;
+        same_count += (m.triangleCount() == legacyCount[l]);
+        if(fabs(area - legacyArea[l]) > 1e-2 * (legacyArea[l] + 1e-6))
+        {
+            ok = false;
+            printf("label %d: %ld triangles area %g, MarchingCubes %ld triangles area %g\n",
+                   l+1, (long)m.triangleCount(), area, legacyCount[l], legacyArea[l]);
+        }
+        if(m.vertex.size() != single[l].vertex.size())
+        {
+            ok = false;
+            printf("label %d: %ld vertexes, %ld in one single block\n", l+1, long(m.vertex.size()/3), long(single[l].vertex.size()/3));
+        }
+    }
+    bool same = sameMeshes(meshes, parallel);
+
+    printf("%dx%dx%d voxels, %d labels, %d steps: %ld triangles, %ld shared vertexes (%.1f per triangle)\n",
+           sx, sy, sz, n_labels, steps, triangles, vertexes, triangles ? double(vertexes)/triangles : 0.);
+    printf("%ld of %d labels with the same triangle count as MarchingCubes\n", same_count, n_labels);
+    printf("MarchingCubes per label  %10.1f ms\n", t_legacy * 1000);
+    printf("one pass, serial         %10.1f ms   x%.1f\n", t_serial * 1000, t_legacy / t_serial);
+    printf("one pass, %2d threads     %10.1f ms   x%.1f\n", n_threads, t_parallel * 1000, t_legacy / t_parallel);
+    printf("\n%s\n", !ok   ? "ERROR: meshes differ from MarchingCubes"
+                   : !same ? "ERROR: threads give a different mesh"
+                   : "same surfaces as MarchingCubes, threads give the serial mesh");
+    return (ok && same) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,15 @@
+# micro-benchmark of the block-parallel label field marching cubes (standalone, not part of the V3D build)
+TEMPLATE = app
+TARGET = benchmark_labelmc
+CONFIG += console release
+CONFIG -= qt
+mac {
+    CONFIG -= app_bundle
+}
+unix {
+    LIBS += -lpthread
+}
+HEADERS += ../labelmarchingcubes.h \
+           ../marchingcubes.h
+SOURCES += ../labelmarchingcubes.cpp \
+           benchmark_labelmc.cpp
@@ -0,0 +1,175 @@
+// Micro-benchmark of the picking index used by Renderer_gl1::findNearestNeuronNode_WinXY (see pickindex.h).
+// Random neuron-like paths are picked at random window positions under a perspective view, with the
+// index and with the linear scan of all the points; both must return the same point.
+// The points are then edited (moved, added, then removed) and picked again. As in Renderer_gl1::pickIndexNeuron,
+// picks after an edit use the linear scan until syncDue(), and the click latency includes the sync.
+//
+// usage: benchmark_pick [points [queries]]
+
+#include "../pickindex.h"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <vector>
+#include <algorithm>
+
+static double frand(double a, double b)
+{
+    return a + (b - a) * (rand() / (double)RAND_MAX);
+}
+
+// column-major, as glGetDoublev
+static void perspective(double fovy, double aspect, double zNear, double zFar, double P[16])
+{
+    double f = 1.0 / tan(fovy * M_PI / 360);
+    for(int i=0; i<16; i++) P[i] = 0;
+    P[0] = f / aspect;
+    P[5] = f;
+    P[10] = (zFar + zNear) / (zNear - zFar);
+    P[11] = -1;
+    P[14] = 2 * zFar * zNear / (zNear - zFar);
+}
+
+static void view(double angle, double scale, double distance, double M[16])
+{
+    double c = cos(angle), s = sin(angle);
+    for(int i=0; i<16; i++) M[i] = 0;
+    M[0] = c * scale;  M[2] = -s * scale;
+    M[5] = scale;
+    M[8] = s * scale;  M[10] = c * scale;
+    M[12] = -500 * c * scale - 500 * s * scale;
+    M[13] = -500 * scale;
+    M[14] = 500 * s * scale - 500 * c * scale - distance;
+    M[15] = 1;
+}
+
+// the linear scan of the source data, as Renderer_gl1::findNearestNeuronNode_WinXY without index
+static long linearPick(const std::vector<float>& xyz, double cx, double cy,
+        const double M[16], const double P[16], const int viewport[4], double& best_dist)
+{
+    long best = -1;  best_dist = -1;
+    for(long i=0; i<(long)xyz.size()/3; i++)
+    {
+        double px, py, w;
+        if(!projectWinXY(xyz[3*i], xyz[3*i+1], xyz[3*i+2], M, P, viewport, px, py, w)) return -1;
+        double cur_dist = (px-cx)*(px-cx)+(py-cy)*(py-cy);
+        if(best < 0 || cur_dist < best_dist) {best_dist = cur_dist; best = i;}
+    }
+    return best;
+}
+
+struct ClickStats
+{
+    double total, worst;
+    long n, n_linear;
+    ClickStats() : total(0), worst(0), n(0), n_linear(0) {}
+    void add(double t, bool linear) {total += t; worst = std::max(worst, t); n++; if(linear) n_linear++;}
+    void print(const char* name) const
+    {
+        printf("%-28s %10.3f ms/click  (worst %8.2f ms, %ld of %ld clicks by linear scan)\n", name, total / n * 1000, worst * 1000, n_linear, n);
+    }
+};
+
+int main(int argc, char** argv)
+{
+    long n_points = 2000000, n_queries = 200;
+    if(argc >= 2) n_points = atol(argv[1]);
+    if(argc >= 3) n_queries = atol(argv[2]);
+
+    // neuron-like random walks in a 1000^3 box
+    srand(0);
+    std::vector<float> xyz(3 * n_points);
+    for(long i=0; i<n_points; i++)
+    {
+        if(i % 5000 == 0)
+            for(int d=0; d<3; d++) xyz[3*i+d] = (float)frand(0, 1000);
+        else
+            for(int d=0; d<3; d++) xyz[3*i+d] = xyz[3*(i-1)+d] + (float)frand(-1, 1);
+    }
+
+    PointPickIndex index;
+    index.dataChanged();
+
+    int viewport[4] = {0, 0, 1200, 900};
+    double M[16], P[16];
+    perspective(30, 1200.0 / 900, 1, 10000, P);
+
+    bool ok = true;
+    double t_linear = 0, t_sync_worst = 0;
+    long n_linear = 0, visited = 0, n_index = 0;
+    const char* names[4] = {"after loading", "after moving 1% points", "after adding 1% points", "after removing 1% points"};
+    for(int pass=0; pass<4; pass++)
+    {
+        if(pass == 1)
+        {
+            for(long k=0; k<n_points/100; k++)
+            {
+                long i = rand() % n_points;
+                for(int d=0; d<3; d++) xyz[3*i+d] += (float)frand(-20, 20);
+            }
+            index.dataChanged();
+        }
+        if(pass == 2)
+        {
+            for(long k=0; k<n_points/100; k++)
+                for(int d=0; d<3; d++) xyz.push_back(xyz[xyz.size()-3] + (float)frand(-1, 1));
+            index.dataChanged();
+        }
+        if(pass == 3)
+        {
+            xyz.erase(xyz.begin() + 3*(n_points/2), xyz.begin() + 3*(n_points/2 + n_points/100));
+            index.dataChanged();
+        }
+
+        ClickStats stats;
+        for(long q=0; q<n_queries; q++)
+        {
+            view(frand(0, 2 * M_PI), frand(0.5, 4), 2500, M);
+            double cx = frand(0, viewport[2]), cy = frand(0, viewport[3]);
+
+            // one click, as Renderer_gl1::findNearestNeuronNode_WinXY
+            double d_pick, d_linear;
+            long i_pick;
+            clock_t start = clock();
+            bool linear = !index.isSynced() && !index.syncDue((long)xyz.size() / 3);
+            if(linear)
+                i_pick = linearPick(xyz, cx, cy, M, P, viewport, d_pick);
+            else
+            {
+                if(!index.isSynced())
+                {
+                    clock_t start_sync = clock();
+                    long n = (long)xyz.size() / 3;
+                    index.resize(n);
+                    for(long i=0; i<n; i++) index.setPoint(i, xyz[3*i], xyz[3*i+1], xyz[3*i+2]);
+                    index.commit();
+                    t_sync_worst = std::max(t_sync_worst, double(clock() - start_sync) / CLOCKS_PER_SEC);
+                }
+                i_pick = index.nearestWinXY(cx, cy, M, P, viewport, d_pick);
+                visited += index.nodeVisited();
+                n_index++;
+            }
+            stats.add(double(clock() - start) / CLOCKS_PER_SEC, linear);
+
+            start = clock();
+            long i_linear = linearPick(xyz, cx, cy, M, P, viewport, d_linear);
+            t_linear += double(clock() - start) / CLOCKS_PER_SEC;
+            n_linear++;
+
+            if(i_pick != i_linear)
+            {
+                ok = false;
+                printf("MISMATCH query %ld: pick %ld (%g), linear %ld (%g)\n", q, i_pick, d_pick, i_linear, d_linear);
+            }
+        }
+        stats.print(names[pass]);
+    }
+
+    printf("\n%ld points, slowest sync (rebuild or refit) %8.2f ms\n", n_points, t_sync_worst * 1000);
+    printf("linear scan  %10.3f ms/query\n", t_linear / n_linear * 1000);
+    printf("click latencies above include the change check, the sync and the query; %.0f nodes visited/query by the index\n",
+           n_index ? double(visited) / n_index : 0.0);
+    printf("\n%s\n", ok ? "picks match the linear scan" : "ERROR: picks do not match the linear scan");
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
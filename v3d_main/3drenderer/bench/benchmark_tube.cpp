@@ -0,0 +1,192 @@
+// Micro-benchmark of the neuron tube data used by Renderer_gl1::drawNeuronTreeBuffer (see neurontube.h).
+// A random neuron-like tree is packed, then single nodes are moved and appended as when editing, and the
+// tree is synced again each time: the time and the bytes to patch in the buffers are those of one redraw.
+// The patched data must equal a full packing, and all the triangles placed as by shader/tube_vertex.txt
+// must face outward (clockwise).
+//
+// usage: benchmark_tube [nodes [edits]]
+
+#include "../neurontube.h"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <vector>
+
+static double frand(double a, double b)
+{
+    return a + (b - a) * (rand() / (double)RAND_MAX);
+}
+
+struct TreeNode
+{
+    float x, y, z, r;
+    long parent;
+    unsigned char c[3];
+};
+
+static void sync(NeuronTubeMesh& mesh, const std::vector<TreeNode>& tree)
+{
+    mesh.resize(tree.size());
+    for(size_t i=0; i<tree.size(); i++)
+    {
+        const TreeNode& a = tree[i];
+        mesh.setNode(i, a.x, a.y, a.z, a.r, a.parent, a.c);
+    }
+    mesh.commit();
+}
+
+static long patchBytes(const NeuronTubeMesh& mesh)
+{
+    long nodes = 0;
+    for(size_t k=0; k<mesh.dirtyRanges().size(); k++)
+        nodes += mesh.dirtyRanges()[k].second - mesh.dirtyRanges()[k].first;
+    return nodes * (sizeof(NeuronTubeInstance) + 2 * sizeof(NeuronLineVertex));
+}
+
+static std::vector<NeuronTubeInstance> instances(const NeuronTubeMesh& mesh)
+{
+    std::vector<NeuronTubeInstance> inst(mesh.size());
+    mesh.packInstances(0, mesh.size(), &inst[0]);
+    return inst;
+}
+
+// vertex k of the unit mesh placed by instance a, as shader/tube_vertex.txt does
+static void placeVertex(const NeuronTubeMesh& mesh, const NeuronTubeInstance& a, int k, double pos[3])
+{
+    const float* u = mesh.unitVertices() + 4*k;
+    if(u[3] > 0.5)
+    {
+        for(int d=0; d<3; d++) pos[d] = a.p1[d] + a.p1[3]*u[d];
+        return;
+    }
+    double C[3] = {a.p0[0]-a.p1[0], a.p0[1]-a.p1[1], a.p0[2]-a.p1[2]};
+    double len = sqrt(C[0]*C[0] + C[1]*C[1] + C[2]*C[2]);
+    if(len > 0) {C[0] /= len; C[1] /= len; C[2] /= len;}
+    else        {C[0] = 0; C[1] = 0; C[2] = 1;}
+    double B[3] = {C[1], -C[0], 0};  // C x (0,0,1)
+    double lb = sqrt(B[0]*B[0] + B[1]*B[1]);
+    if(lb < 0.1) {B[0] = 0; B[1] = 1;}
+    else         {B[0] /= lb; B[1] /= lb;}
+    double A[3] = {C[1]*B[2]-C[2]*B[1], C[2]*B[0]-C[0]*B[2], C[0]*B[1]-C[1]*B[0]};
+    for(int d=0; d<3; d++)
+    {
+        double dir = -u[0]*A[d] + u[1]*B[d];
+        double p1 = a.p1[d] + a.p1[3]*dir, p0 = a.p0[d] + a.p0[3]*dir;
+        pos[d] = p1 + (p0 - p1)*u[2];
+    }
+}
+
+// clockwise seen from outside: the normal of (b-a)x(c-a) points inside
+static bool facesOutward(const NeuronTubeMesh& mesh)
+{
+    std::vector<NeuronTubeInstance> inst = instances(mesh);
+    const unsigned int* index = mesh.unitIndex();
+    long nIndex = mesh.tubeIndexCount() + mesh.sphereIndexCount();
+    for(size_t i=0; i<inst.size(); i++)
+    {
+        const NeuronTubeInstance& S = inst[i];
+        if(S.c[3] == 0) continue;
+        for(long t=0; t<nIndex; t+=3)
+        {
+            double a[3], b[3], c[3];
+            placeVertex(mesh, S, index[t], a);
+            placeVertex(mesh, S, index[t+1], b);
+            placeVertex(mesh, S, index[t+2], c);
+            double ab[3] = {b[0]-a[0], b[1]-a[1], b[2]-a[2]}, ac[3] = {c[0]-a[0], c[1]-a[1], c[2]-a[2]};
+            double n[3] = {ab[1]*ac[2]-ab[2]*ac[1], ab[2]*ac[0]-ab[0]*ac[2], ab[0]*ac[1]-ab[1]*ac[0]};
+            double area = sqrt(n[0]*n[0] + n[1]*n[1] + n[2]*n[2]);
+            if(area < 1e-6) continue;
+
+            // from the axis of the tube, or from the center of the sphere
+            double m[3] = {(a[0]+b[0]+c[0])/3 - S.p1[0], (a[1]+b[1]+c[1])/3 - S.p1[1], (a[2]+b[2]+c[2])/3 - S.p1[2]};
+            if(t < mesh.tubeIndexCount())
+            {
+                double D[3] = {S.p0[0]-S.p1[0], S.p0[1]-S.p1[1], S.p0[2]-S.p1[2]};
+                double L2 = D[0]*D[0] + D[1]*D[1] + D[2]*D[2];
+                if(L2 == 0) continue;
+                double s = (m[0]*D[0] + m[1]*D[1] + m[2]*D[2]) / L2;
+                for(int d=0; d<3; d++) m[d] -= s * D[d];
+            }
+            if(n[0]*m[0] + n[1]*m[1] + n[2]*m[2] >= 0)
+            {
+                printf("triangle %ld of node %ld faces inward\n", t/3, long(i));
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    long n_nodes = 200000, n_edits = 100;
+    if(argc >= 2) n_nodes = atol(argv[1]);
+    if(argc >= 3) n_edits = atol(argv[2]);
+
+    // branching random walks in a 1000^3 box
+    srand(0);
+    std::vector<TreeNode> tree(n_nodes);
+    for(long i=0; i<n_nodes; i++)
+    {
+        TreeNode& a = tree[i];
+        a.parent = (i % 5000 == 0) ? -1 : (rand() % 20 == 0) ? rand() % i : i - 1;
+        if(a.parent < 0)
+            {a.x = (float)frand(0, 1000); a.y = (float)frand(0, 1000); a.z = (float)frand(0, 1000);}
+        else
+        {
+            const TreeNode& p = tree[a.parent];
+            a.x = p.x + (float)frand(-3, 3);  a.y = p.y + (float)frand(-3, 3);  a.z = p.z + (float)frand(-3, 3);
+        }
+        a.r = (float)frand(0.5, 3);
+        a.c[0] = (unsigned char)(rand() % 256);  a.c[1] = 128;  a.c[2] = 0;
+    }
+
+    NeuronTubeMesh mesh;
+    clock_t start = clock();
+    sync(mesh, tree);
+    double t_full = double(clock() - start) / CLOCKS_PER_SEC;
+    long full_bytes = patchBytes(mesh);
+    bool ok = facesOutward(mesh);
+
+    // move one node per redraw, and append one every 10 edits
+    double t_edit = 0, t_max = 0;
+    long edit_bytes = 0;
+    for(long e=0; e<n_edits; e++)
+    {
+        if(e % 10 == 9)
+        {
+            TreeNode a = tree[rand() % tree.size()];
+            a.parent = rand() % tree.size();
+            tree.push_back(a);
+        }
+        else
+        {
+            TreeNode& a = tree[rand() % tree.size()];
+            a.x += (float)frand(-5, 5);  a.r = (float)frand(0.5, 3);
+        }
+        start = clock();
+        sync(mesh, tree);
+        double t = double(clock() - start) / CLOCKS_PER_SEC;
+        t_edit += t;
+        if(t > t_max) t_max = t;
+        edit_bytes += patchBytes(mesh);
+    }
+
+    NeuronTubeMesh fresh;
+    sync(fresh, tree);
+    std::vector<NeuronTubeInstance> patched = instances(mesh), full = instances(fresh);
+    bool same = memcmp(&patched[0], &full[0], tree.size() * sizeof(NeuronTubeInstance)) == 0
+             && memcmp(mesh.lineVertices(), fresh.lineVertices(), tree.size() * 2 * sizeof(NeuronLineVertex)) == 0;
+    ok = ok && same && facesOutward(mesh);
+
+    printf("%ld nodes, one unit mesh of %d vertexes and %d triangles, %d bytes per node\n", n_nodes, mesh.unitVertexCount(),
+           (mesh.tubeIndexCount() + mesh.sphereIndexCount()) / 3, int(sizeof(NeuronTubeInstance) + 2 * sizeof(NeuronLineVertex)));
+    printf("full packing  %10.2f ms  %10.1f MB\n", t_full * 1000, full_bytes / 1048576.0);
+    printf("edit sync     %10.2f ms  %10.1f KB  (mean of %ld, max %.2f ms)\n", t_edit / n_edits * 1000, edit_bytes / 1024.0 / n_edits, n_edits, t_max * 1000);
+    printf("\n%s\n", !same ? "ERROR: patched data differs from a full packing"
+                   : !ok   ? "ERROR: triangles facing inward"
+                   : "patched data matches a full packing, triangles face outward");
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,11 @@
+# micro-benchmark of the packed neuron tube data (standalone, not part of the V3D build)
+TEMPLATE = app
+TARGET = benchmark_tube
+CONFIG += console release
+CONFIG -= qt
+mac {
+    CONFIG -= app_bundle
+}
+HEADERS += ../neurontube.h
+SOURCES += ../neurontube.cpp \
+           benchmark_tube.cpp
@@ -0,0 +1,375 @@
+/*
+ *  labelmarchingcubes.cpp
+ *
+ *  see labelmarchingcubes.h
+ *
+ */
+
+#include "labelmarchingcubes.h"
+#include "marchingcubes.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+#define LABEL_ISO  (255/2.f)    // iso value of the label sampling, as constructLabelfieldSurf
+
+// tables of marchingcubes.cpp
+extern float a2fVertexOffset[8][3];
+extern int   a2iEdgeConnection[12][2];
+extern float a2fEdgeDirection[12][3];
+extern int   aiCubeEdgeFlags[256];
+extern int   a2iTriangleConnectionTable[256][16];
+
+
+struct _GroupLess
+{
+	const std::vector< std::pair<float,float> >& groups;
+	_GroupLess(const std::vector< std::pair<float,float> >& g) : groups(g) {}
+	bool operator()(int a, int b) const  {return groups[a].first < groups[b].first;}
+};
+
+LabelMarchingCubes::LabelMarchingCubes(const void* data, int datatype, V3DLONG sx, V3DLONG sy, V3DLONG sz,
+		int numStep, const std::vector< std::pair<float,float> >& groups, int blockSize)
+	: data(data), datatype(datatype), numStep(numStep), blockSize(blockSize), groups(groups)
+{
+	this->sz[0] = sx;  this->sz[1] = sy;  this->sz[2] = sz;
+	if (this->numStep < 1)  this->numStep = 1;
+	if (this->blockSize < 1)  this->blockSize = 1;
+	fStepSize = 1.0f/this->numStep;
+	for (int d=0; d<3; d++)  nBlock[d] = (this->numStep + this->blockSize-1)/this->blockSize;
+
+	order.resize(groups.size());
+	for (size_t g=0; g<groups.size(); g++)  order[g] = int(g);
+	std::sort(order.begin(), order.end(), _GroupLess(groups));
+	b_overlap = false;
+	for (size_t k=1; k<order.size(); k++)
+		if (groups[order[k]].first <= groups[order[k-1]].second)  b_overlap = true;
+
+	if (datatype==1 || datatype==2)
+	{
+		int vmax = (datatype==1)? 255 : 65535;
+		lut.assign(vmax+1, -1);
+		for (size_t g=0; g<groups.size(); g++)
+		{
+			int lo = int(std::max(0.f, std::ceil(groups[g].first)));
+			int hi = int(std::min(float(vmax), std::floor(groups[g].second)));
+			for (int v=lo; v<=hi; v++)  if (lut[v]<0)  lut[v] = int(g);
+		}
+	}
+
+	// voxels of the grid points, as _labelSampleFunc
+	for (int d=0; d<3; d++)
+	{
+		v0[d].resize(this->numStep+1);
+		v1[d].resize(this->numStep+1);
+		vf[d].resize(this->numStep+1);
+		for (int i=0; i<=this->numStep; i++)
+		{
+			float x = CLAMP01(i*fStepSize)*(this->sz[d]-1);
+			v0[d][i] = V3DLONG(floor(x));
+			v1[d][i] = V3DLONG(ceil(x));
+			vf[d][i] = x - v0[d][i];
+		}
+	}
+}
+
+int LabelMarchingCubes::voxelGroup(V3DLONG i) const
+{
+	if (datatype==1)  return lut[((const unsigned char*)data)[i]];
+	if (datatype==2)  return lut[((const unsigned short*)data)[i]];
+
+	// last group starting at or below the value
+	float v = ((const float*)data)[i];
+	int a = 0, b = int(order.size());
+	while (a < b)
+	{
+		int m = (a+b)/2;
+		if (groups[order[m]].first <= v)  a = m+1;
+		else  b = m;
+	}
+	if (a==0)  return -1;
+	int g = order[a-1];
+	return (v <= groups[g].second)? g : -1;
+}
+
+float LabelMarchingCubes::sampleGroup(int g, float fX, float fY, float fZ) const
+{
+	float x, y, z;
+	x = CLAMP01(fX)*(sz[0]-1);
+	y = CLAMP01(fY)*(sz[1]-1);
+	z = CLAMP01(fZ)*(sz[2]-1);
+
+	V3DLONG x0,x1, y0,y1, z0,z1;
+	x0 = V3DLONG(floor(x)); 		x1 = V3DLONG(ceil(x));
+	y0 = V3DLONG(floor(y)); 		y1 = V3DLONG(ceil(y));
+	z0 = V3DLONG(floor(z)); 		z1 = V3DLONG(ceil(z));
+	float xf, yf, zf;
+	xf = x-x0;
+	yf = y-y0;
+	zf = z-z0;
+
+	#define _IN(ix,iy,iz)  (voxelGroup(((iz)*sz[1] + (iy))*sz[0] + (ix)) == g)
+	float sf[8], count = 0;
+	sf[0] = (1-xf)*(1-yf)*(1-zf);
+	sf[1] = (1-xf)*(1-yf)*(  zf);
+	sf[2] = (1-xf)*(  yf)*(1-zf);
+	sf[3] = (1-xf)*(  yf)*(  zf);
+	sf[4] = (  xf)*(1-yf)*(1-zf);
+	sf[5] = (  xf)*(1-yf)*(  zf);
+	sf[6] = (  xf)*(  yf)*(1-zf);
+	sf[7] = (  xf)*(  yf)*(  zf);
+	count += _IN(x0, y0, z0) * sf[0];
+	count += _IN(x0, y0, z1) * sf[1];
+	count += _IN(x0, y1, z0) * sf[2];
+	count += _IN(x0, y1, z1) * sf[3];
+	count += _IN(x1, y0, z0) * sf[4];
+	count += _IN(x1, y0, z1) * sf[5];
+	count += _IN(x1, y1, z0) * sf[6];
+	count += _IN(x1, y1, z1) * sf[7];
+	#undef _IN
+	return (count*255);
+}
+
+void LabelMarchingCubes::normalOf(int g, const float p[3], float n[3]) const
+{
+	float d = fStepSize;
+	float fX = p[0], fY = p[1], fZ = p[2];
+	#define S(x,y,z)  sampleGroup(g, x, y, z)
+	n[0] =  2*(S(fX-d,  fY,    fZ)   - S(fX+d,  fY,    fZ))+
+			1*(S(fX-d,  fY-d,  fZ)   - S(fX+d,  fY-d,  fZ))+
+			1*(S(fX-d,  fY+d,  fZ)   - S(fX+d,  fY+d,  fZ))+
+			1*(S(fX-d,  fY,    fZ-d) - S(fX+d,  fY,    fZ-d))+
+			1*(S(fX-d,  fY,    fZ+d) - S(fX+d,  fY,    fZ+d));
+
+	n[1] =  2*(S(fX,    fY-d,  fZ)   - S(fX,    fY+d,  fZ))+
+			1*(S(fX-d,  fY-d,  fZ)   - S(fX-d,  fY+d,  fZ))+
+			1*(S(fX+d,  fY-d,  fZ)   - S(fX+d,  fY+d,  fZ))+
+			1*(S(fX,    fY-d,  fZ-d) - S(fX,    fY+d,  fZ-d))+
+			1*(S(fX,    fY-d,  fZ+d) - S(fX,    fY+d,  fZ+d));
+
+	n[2] =  2*(S(fX,    fY,    fZ-d) - S(fX,    fY,    fZ+d))+
+			1*(S(fX-d,  fY,    fZ-d) - S(fX-d,  fY,    fZ+d))+
+			1*(S(fX+d,  fY,    fZ-d) - S(fX+d,  fY,    fZ+d))+
+			1*(S(fX,    fY-d,  fZ-d) - S(fX,    fY-d,  fZ+d))+
+			1*(S(fX,    fY+d,  fZ-d) - S(fX,    fY+d,  fZ+d));
+	#undef S
+
+	float len = sqrtf(n[0]*n[0] + n[1]*n[1] + n[2]*n[2]);
+	if (len != 0)  {n[0] /= len;  n[1] /= len;  n[2] /= len;}
+}
+
+// values of the label groups at a grid point, at most 8
+struct _GridSample
+{
+	int n;
+	int group[8];
+	float value[8];
+
+	float valueOf(int g) const
+	{
+		for (int k=0; k<n; k++)  if (group[k]==g)  return value[k];
+		return 0;
+	}
+};
+
+struct _EdgeVertex
+{
+	int group;
+	unsigned int vertex;
+	int next;
+};
+
+void LabelMarchingCubes::marchBlock(int b, LabelMeshBlock& out) const
+{
+	out.block = b;
+	out.parts.clear();
+
+	int bi[3] = {b % nBlock[0], (b / nBlock[0]) % nBlock[1], b / (nBlock[0]*nBlock[1])};
+	int c0[3], n[3], np[3];
+	for (int d=0; d<3; d++)
+	{
+		c0[d] = bi[d]*blockSize;
+		n[d] = std::min(blockSize, numStep - c0[d]);  // cubes
+		np[d] = n[d]+1;                                // grid points
+	}
+	#define _P(i,j,k)  ((V3DLONG(k)*np[1] + (j))*np[0] + (i))
+
+	// group values of the grid points, as _labelSampleFunc
+	std::vector<_GridSample> samples(V3DLONG(np[0])*np[1]*np[2]);
+	for (int k=0; k<np[2]; k++)
+	for (int j=0; j<np[1]; j++)
+	for (int i=0; i<np[0]; i++)
+	{
+		int gx = c0[0]+i, gy = c0[1]+j, gz = c0[2]+k;
+		V3DLONG x0 = v0[0][gx], x1 = v1[0][gx];
+		V3DLONG y0 = v0[1][gy], y1 = v1[1][gy];
+		V3DLONG z0 = v0[2][gz], z1 = v1[2][gz];
+		float xf = vf[0][gx], yf = vf[1][gy], zf = vf[2][gz];
+
+		V3DLONG vi[8];
+		float sf[8];
+		#define _V(ix,iy,iz)  ((iz)*sz[1] + (iy))*sz[0] + (ix)
+		vi[0] = _V(x0, y0, z0);  sf[0] = (1-xf)*(1-yf)*(1-zf);
+		vi[1] = _V(x0, y0, z1);  sf[1] = (1-xf)*(1-yf)*(  zf);
+		vi[2] = _V(x0, y1, z0);  sf[2] = (1-xf)*(  yf)*(1-zf);
+		vi[3] = _V(x0, y1, z1);  sf[3] = (1-xf)*(  yf)*(  zf);
+		vi[4] = _V(x1, y0, z0);  sf[4] = (  xf)*(1-yf)*(1-zf);
+		vi[5] = _V(x1, y0, z1);  sf[5] = (  xf)*(1-yf)*(  zf);
+		vi[6] = _V(x1, y1, z0);  sf[6] = (  xf)*(  yf)*(1-zf);
+		vi[7] = _V(x1, y1, z1);  sf[7] = (  xf)*(  yf)*(  zf);
+		#undef _V
+
+		// summed in the same order as the percent filter, so the values are the same
+		_GridSample& s = samples[_P(i,j,k)];
+		s.n = 0;
+		for (int c=0; c<8; c++)
+		{
+			int g = voxelGroup(vi[c]);
+			if (g < 0)  continue;
+			int m = 0;
+			while (m < s.n && s.group[m] != g)  m++;
+			if (m == s.n)  {s.group[m] = g;  s.value[m] = 0;  s.n++;}
+			s.value[m] += sf[c];
+		}
+		for (int m=0; m<s.n; m++)  s.value[m] *= 255;
+	}
+
+	// cube edges: lower corner and axis
+	int edgeLow[12], edgeAxis[12];
+	for (int e=0; e<12; e++)
+	{
+		for (int d=0; d<3; d++)  if (a2fEdgeDirection[e][d] != 0)  edgeAxis[e] = d;
+		edgeLow[e] = (a2fEdgeDirection[e][edgeAxis[e]] > 0)? a2iEdgeConnection[e][0] : a2iEdgeConnection[e][1];
+	}
+
+	std::vector<int> edgeHead(3*samples.size(), -1);
+	std::vector<_EdgeVertex> edgeVertex;
+	std::map<int, int> partOf;
+	float iso = LABEL_ISO;
+	V3DLONG N1 = numStep+1;
+
+	for (int i=0; i<n[0]; i++)  // x, y, z order as MarchingCubes
+	for (int j=0; j<n[1]; j++)
+	for (int k=0; k<n[2]; k++)
+	{
+		const _GridSample* corner[8];
+		for (int c=0; c<8; c++)
+			corner[c] = &samples[_P(i+int(a2fVertexOffset[c][0]), j+int(a2fVertexOffset[c][1]), k+int(a2fVertexOffset[c][2]))];
+
+		// groups around the cube
+		int cand[64], nc = 0;
+		for (int c=0; c<8; c++)
+			for (int m=0; m<corner[c]->n; m++)
+			{
+				int g = corner[c]->group[m], t = 0;
+				while (t < nc && cand[t] != g)  t++;
+				if (t == nc)  cand[nc++] = g;
+			}
+
+		for (int t=0; t<nc; t++)
+		{
+			int g = cand[t];
+			float value[8];
+			int flag = 0;
+			for (int c=0; c<8; c++)
+			{
+				value[c] = corner[c]->valueOf(g);
+				if (value[c] <= iso)  flag |= 1<<c;
+			}
+			int edgeFlags = aiCubeEdgeFlags[flag];
+			if (edgeFlags == 0)  continue;
+
+			std::map<int,int>::iterator it = partOf.find(g);
+			if (it == partOf.end())
+			{
+				it = partOf.insert(std::make_pair(g, int(out.parts.size()))).first;
+				out.parts.push_back(LabelMeshBlock::Part());
+				out.parts.back().group = g;
+			}
+			LabelMeshBlock::Part& part = out.parts[it->second];
+
+			// one vertex per intersected grid edge, shared by the cubes around it
+			unsigned int vid[12];
+			for (int e=0; e<12; e++)
+			{
+				if (! (edgeFlags & (1<<e)))  continue;
+				int a = edgeAxis[e];
+				int l[3] = {i+int(a2fVertexOffset[edgeLow[e]][0]), j+int(a2fVertexOffset[edgeLow[e]][1]), k+int(a2fVertexOffset[edgeLow[e]][2])};
+				V3DLONG slot = 3*_P(l[0],l[1],l[2]) + a;
+
+				int h = edgeHead[slot];
+				while (h >= 0 && edgeVertex[h].group != g)  h = edgeVertex[h].next;
+				if (h >= 0)  {vid[e] = edgeVertex[h].vertex;  continue;}
+
+				int ca = edgeLow[e], cb = (a2iEdgeConnection[e][0]==ca)? a2iEdgeConnection[e][1] : a2iEdgeConnection[e][0];
+				float delta = value[cb] - value[ca];
+				float offset = (delta == 0)? 0.5f : (iso - value[ca])/delta;
+				float p[3], nm[3];
+				for (int d=0; d<3; d++)  p[d] = (c0[d]+l[d])*fStepSize;
+				p[a] += offset*fStepSize;
+				normalOf(g, p, nm);
+
+				bool b_face = false;
+				for (int d=0; d<3; d++)  if (d != a && (l[d]==0 || l[d]==n[d]))  b_face = true;
+
+				LabelMesh& m = part.mesh;
+				vid[e] = (unsigned int)(m.vertex.size()/3);
+				for (int d=0; d<3; d++)  {m.vertex.push_back(p[d]);  m.normal.push_back(nm[d]);}
+				part.edge.push_back(b_face? ((V3DLONG(c0[2]+l[2])*N1 + c0[1]+l[1])*N1 + c0[0]+l[0])*3 + a : -1);
+
+				_EdgeVertex ev = {g, vid[e], edgeHead[slot]};
+				edgeHead[slot] = int(edgeVertex.size());
+				edgeVertex.push_back(ev);
+			}
+
+			for (int tri=0; tri<5; tri++)
+			{
+				if (a2iTriangleConnectionTable[flag][3*tri] < 0)  break;
+				for (int c=0; c<3; c++)
+					part.mesh.index.push_back(vid[ a2iTriangleConnectionTable[flag][3*tri+c] ]);
+			}
+		}
+	}
+	#undef _P
+}
+
+void LabelMarchingCubes::merge(const LabelMeshBlock& blk, std::vector<LabelMesh>& meshes)
+{
+	if (meshes.size() < groups.size())  meshes.resize(groups.size());
+	if (shared.size() < groups.size())  shared.resize(groups.size());
+
+	for (size_t k=0; k<blk.parts.size(); k++)
+	{
+		const LabelMeshBlock::Part& part = blk.parts[k];
+		LabelMesh& m = meshes[part.group];
+		std::map<V3DLONG, unsigned int>& sh = shared[part.group];
+
+		V3DLONG nv = V3DLONG(part.edge.size());
+		std::vector<unsigned int> remap(nv);
+		for (V3DLONG v=0; v<nv; v++)
+		{
+			if (part.edge[v] >= 0) // on the block faces, maybe merged from a neighbor block
+			{
+				std::map<V3DLONG, unsigned int>::iterator it = sh.find(part.edge[v]);
+				if (it != sh.end())  {remap[v] = it->second;  continue;}
+				sh[part.edge[v]] = (unsigned int)(m.vertex.size()/3);
+			}
+			remap[v] = (unsigned int)(m.vertex.size()/3);
+			m.vertex.insert(m.vertex.end(), part.mesh.vertex.begin()+3*v, part.mesh.vertex.begin()+3*v+3);
+			m.normal.insert(m.normal.end(), part.mesh.normal.begin()+3*v, part.mesh.normal.begin()+3*v+3);
+		}
+		for (size_t t=0; t<part.mesh.index.size(); t++)
+			m.index.push_back(remap[part.mesh.index[t]]);
+	}
+}
+
+void LabelMarchingCubes::run(std::vector<LabelMesh>& meshes)
+{
+	LabelMeshBlock blk;
+	for (int b=0; b<blockCount(); b++)
+	{
+		marchBlock(b, blk);
+		merge(blk, meshes);
+	}
+}
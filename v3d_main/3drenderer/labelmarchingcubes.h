@@ -0,0 +1,88 @@
+/*
+ *  labelmarchingcubes.h
+ *
+ *  Block-parallel marching cubes of a label field, for Renderer_gl1::constructLabelfieldSurf.
+ *
+ *  Same surfaces as MarchingCubes() with the label sampling function (_labelSampleFunc), but all the
+ *  label groups are extracted in one pass over the typed label array, instead of one pass per label
+ *  through a sampling callback. The sampling grid is split into blocks of cubes that can be marched
+ *  by several threads, and merged into one indexed mesh per group as they finish: the vertexes are
+ *  shared by the triangles, also across the block faces.
+ *  No OpenGL or Qt dependency.
+ *
+ */
+
+#ifndef V3DR_LABELMARCHINGCUBES_H
+#define V3DR_LABELMARCHINGCUBES_H
+
+#include "../basic_c_fun/v3d_basicdatatype.h"
+#include <vector>
+#include <map>
+#include <utility>
+
+
+// indexed mesh of a label group, in the unit coordinates of MarchingCubes
+struct LabelMesh
+{
+	std::vector<float> vertex;          // x,y,z
+	std::vector<float> normal;          // x,y,z, unit
+	std::vector<unsigned int> index;    // 3 per triangle, same orientation as MarchingCubes
+	V3DLONG triangleCount() const {return V3DLONG(index.size()/3);}
+};
+
+// triangles of one block, see LabelMarchingCubes::marchBlock
+struct LabelMeshBlock
+{
+	struct Part
+	{
+		int group;
+		LabelMesh mesh;
+		std::vector<V3DLONG> edge;      // grid edge of each vertex on the block faces, -1 for inner vertexes
+	};
+	int block;
+	std::vector<Part> parts;
+};
+
+class LabelMarchingCubes
+{
+public:
+	// data: sx*sy*sz voxels of datatype 1/2/4 (unsigned char, unsigned short, float), as the lf_mask of the label field.
+	// groups: value ranges [lo, hi], a voxel is in the group containing its value. numStep: as MarchingCubes
+	LabelMarchingCubes(const void* data, int datatype, V3DLONG sx, V3DLONG sy, V3DLONG sz,
+			int numStep, const std::vector< std::pair<float,float> >& groups, int blockSize=32);
+
+	// the groups must be disjoint to be extracted in one pass, else extract them one by one
+	bool groupsOverlap() const {return b_overlap;}
+
+	int blockCount() const {return nBlock[0]*nBlock[1]*nBlock[2];}
+	void marchBlock(int b, LabelMeshBlock& out) const;               // thread safe
+	void merge(const LabelMeshBlock& blk, std::vector<LabelMesh>& meshes); // one group per mesh, blocks in any order
+	void run(std::vector<LabelMesh>& meshes);                         // all blocks in order, in this thread
+
+protected:
+	int voxelGroup(V3DLONG i) const;
+	float sampleGroup(int g, float fX, float fY, float fZ) const;     // _labelSampleFunc of group g
+	void normalOf(int g, const float p[3], float n[3]) const;         // vGetNormal of group g
+
+	const void* data;
+	int datatype;
+	V3DLONG sz[3];
+	int numStep;
+	float fStepSize;
+	int blockSize;
+	int nBlock[3];
+
+	std::vector< std::pair<float,float> > groups;
+	std::vector<int> order;             // groups sorted by lo, for float data
+	std::vector<int> lut;               // group of each value, for integer data
+	bool b_overlap;
+
+	// sampling of grid points, per axis
+	std::vector<V3DLONG> v0[3], v1[3];  // floor and ceil voxel
+	std::vector<float> vf[3];           // fraction
+
+	std::vector< std::map<V3DLONG, unsigned int> > shared; // merged vertex of the block face edges, per group
+};
+
+
+#endif
@@ -0,0 +1,208 @@
+/*
+ *  neurontube.cpp
+ *
+ *  see neurontube.h
+ *
+ */
+
+#include "neurontube.h"
+
+#include <cmath>
+
+
+#define TUBE_MERGE_GAP  16      // dirty ranges closer than this are patched as one
+
+
+NeuronTubeMesh::NeuronTubeMesh(int sides)
+{
+	nSides = (sides<3)? 3 : sides;
+	nStacks = (nSides+1)/2;
+	b_topology = b_relink = true;
+	for (int d=0; d<6; d++)  bbox[d] = 0;
+	meanR = 0;
+	buildUnit();
+}
+
+static inline void _sub(const float a[3], const float b[3], float c[3])  {c[0]=a[0]-b[0]; c[1]=a[1]-b[1]; c[2]=a[2]-b[2];}
+static inline void _cross(const float a[3], const float b[3], float c[3])
+{
+	c[0] = a[1]*b[2]-a[2]*b[1];
+	c[1] = a[2]*b[0]-a[0]*b[2];
+	c[2] = a[0]*b[1]-a[1]*b[0];
+}
+static inline float _dot(const float a[3], const float b[3])  {return a[0]*b[0]+a[1]*b[1]+a[2]*b[2];}
+
+// append triangle a,b,c of the unit mesh, clockwise when seen from outside
+static void _addTriangle(std::vector<unsigned int>& pattern, const std::vector<float>& unit, const float center[3],
+		unsigned int a, unsigned int b, unsigned int c)
+{
+	float ab[3], ac[3], n[3], m[3];
+	_sub(&unit[4*b], &unit[4*a], ab);
+	_sub(&unit[4*c], &unit[4*a], ac);
+	_cross(ab, ac, n);
+	for (int d=0; d<3; d++)  m[d] = (unit[4*a+d]+unit[4*b+d]+unit[4*c+d])/3 - center[d];
+	pattern.push_back(a);
+	if (_dot(n, m) > 0)  {pattern.push_back(c); pattern.push_back(b);}
+	else                 {pattern.push_back(b); pattern.push_back(c);}
+}
+
+void NeuronTubeMesh::buildUnit()
+{
+	// in the right-handed frame (-A,B,C) of the vertex shader, with the parent along +z
+	unit.assign(4*unitVertexCount(), 0.f);
+	int s = nSides, T = 2*nSides;
+	for (int k=0; k<s; k++)
+	{
+		double a = 2*M_PI*k/s;
+		float* p0 = &unit[4*k];      p0[0] = -float(cos(a));  p0[1] = float(sin(a));  p0[2] = 0;
+		float* p1 = &unit[4*(s+k)];  p1[0] = -float(cos(a));  p1[1] = float(sin(a));  p1[2] = 1;
+	}
+	for (int m=T; m<unitVertexCount(); m++)  unit[4*m+3] = 1;
+	unit[4*T+2] = 1;  // north pole
+	for (int j=1; j<nStacks; j++)
+	{
+		double t = M_PI*j/nStacks;
+		for (int k=0; k<s; k++)
+		{
+			double a = 2*M_PI*k/s;
+			float* p = &unit[4*(T+1+(j-1)*s+k)];
+			p[0] = float(sin(t)*cos(a));  p[1] = float(sin(t)*sin(a));  p[2] = float(cos(t));
+		}
+	}
+	unit[4*(T+1+(nStacks-1)*s)+2] = -1;  // south pole
+
+	unitTriangles.clear();
+	for (int k=0; k<s; k++)
+	{
+		int k1 = (k+1)%s;
+		float axis[3] = {0, 0, 0.5f};
+		_addTriangle(unitTriangles, unit, axis, k, k1, s+k);
+		_addTriangle(unitTriangles, unit, axis, k1, s+k1, s+k);
+	}
+	nTubeIndex = int(unitTriangles.size());
+
+	float center[3] = {0, 0, 0};
+	unsigned int north = T, south = T+1+(nStacks-1)*s;
+	for (int k=0; k<s; k++)
+	{
+		int k1 = (k+1)%s;
+		_addTriangle(unitTriangles, unit, center, north, T+1+k, T+1+k1);
+		for (int j=1; j<nStacks-1; j++)
+		{
+			unsigned int a = T+1+(j-1)*s, b = a+s;
+			_addTriangle(unitTriangles, unit, center, a+k, b+k, b+k1);
+			_addTriangle(unitTriangles, unit, center, a+k, b+k1, a+k1);
+		}
+		unsigned int last = T+1+(nStacks-2)*s;
+		_addTriangle(unitTriangles, unit, center, south, last+k1, last+k);
+	}
+}
+
+void NeuronTubeMesh::resize(V3DLONG n)
+{
+	if (n == size())  return;
+	Node none = {0, 0, 0, 0, -2, {0, 0, 0}};
+	nodes.resize(n, none);
+	changed.resize(n, 1);  // new nodes are packed
+	b_relink = true;
+}
+
+bool NeuronTubeMesh::setNode(V3DLONG i, float x, float y, float z, float r, V3DLONG parent, const unsigned char rgb[3])
+{
+	Node& a = nodes[i];
+	if (a.x==x && a.y==y && a.z==z && a.r==r && a.parent==parent
+			&& a.c[0]==rgb[0] && a.c[1]==rgb[1] && a.c[2]==rgb[2])
+		return false;
+
+	if (a.parent != parent)  b_relink = true;
+	a.x = x;  a.y = y;  a.z = z;  a.r = r;
+	a.parent = parent;
+	a.c[0] = rgb[0];  a.c[1] = rgb[1];  a.c[2] = rgb[2];
+	changed[i] = 1;
+	return true;
+}
+
+void NeuronTubeMesh::packLine(V3DLONG i)
+{
+	const Node& S1 = nodes[i];
+	const Node& S0 = (S1.parent>=0)? nodes[S1.parent] : S1;
+
+	NeuronLineVertex* l = &lineVerts[2*i];
+	l[0].x = S0.x;  l[0].y = S0.y;  l[0].z = S0.z;
+	l[1].x = S1.x;  l[1].y = S1.y;  l[1].z = S1.z;
+	for (int d=0; d<3; d++)  l[0].c[d] = l[1].c[d] = S1.c[d];
+	l[0].c[3] = l[1].c[3] = 255;
+}
+
+void NeuronTubeMesh::packInstances(V3DLONG first, V3DLONG last, NeuronTubeInstance* out) const
+{
+	for (V3DLONG i=first; i<last; i++, out++)
+	{
+		const Node& S1 = nodes[i];
+		const Node& S0 = (S1.parent>=0)? nodes[S1.parent] : S1;
+		out->p1[0] = S1.x;  out->p1[1] = S1.y;  out->p1[2] = S1.z;  out->p1[3] = S1.r;
+		out->p0[0] = S0.x;  out->p0[1] = S0.y;  out->p0[2] = S0.z;  out->p0[3] = S0.r;
+		for (int d=0; d<3; d++)  out->c[d] = S1.c[d]/255.f;
+		out->c[3] = (S1.parent >= -1)? 1.f : 0.f; // not drawn: all vertexes at the node, nothing rasterized
+	}
+}
+
+void NeuronTubeMesh::commit()
+{
+	V3DLONG n = size();
+	lineVerts.resize(2*n);
+
+	// a node is drawn again when it or its parent changed
+	dirty.clear();
+	V3DLONG first = -1;
+	for (V3DLONG i=0; i<=n; i++)
+	{
+		bool d = false;
+		if (i<n)
+		{
+			V3DLONG p = nodes[i].parent;
+			d = changed[i] || (p>=0 && p<n && changed[p]);
+			if (d)  packLine(i);
+		}
+		if (d && first<0)  first = i;
+		else if (!d && first>=0)
+		{
+			if (!dirty.empty() && first - dirty.back().second <= TUBE_MERGE_GAP)  dirty.back().second = i;
+			else  dirty.push_back(std::make_pair(first, i));
+			first = -1;
+		}
+	}
+	for (V3DLONG i=0; i<n; i++)  changed[i] = 0;
+
+	b_topology = b_relink;
+	b_relink = false;
+	if (b_topology)
+	{
+		nodePoints.clear();
+		rootPoints.clear();
+		for (V3DLONG i=0; i<n; i++)
+			if (nodes[i].parent >= 0)        nodePoints.push_back((unsigned int)(2*i+1));
+			else if (nodes[i].parent == -1)  rootPoints.push_back((unsigned int)(2*i+1));
+	}
+
+	if (b_topology || !dirty.empty())
+	{
+		V3DLONG count = 0;
+		double sumR = 0;
+		for (V3DLONG i=0; i<n; i++)
+		{
+			const Node& a = nodes[i];
+			if (a.parent < -1)  continue;
+			float p[3] = {a.x, a.y, a.z};
+			for (int d=0; d<3; d++)
+			{
+				if (count==0 || p[d]-a.r < bbox[d])    bbox[d] = p[d]-a.r;
+				if (count==0 || p[d]+a.r > bbox[d+3])  bbox[d+3] = p[d]+a.r;
+			}
+			sumR += a.r;
+			count++;
+		}
+		if (count==0)  for (int d=0; d<6; d++)  bbox[d] = 0;
+		meanR = (count>0)? float(sumR/count) : 0;
+	}
+}
@@ -0,0 +1,104 @@
+/*
+ *  neurontube.h
+ *
+ *  Data of a neuron tree for drawing with buffer objects (see Renderer_gl1::drawNeuronTreeBuffer),
+ *  instead of one gluCylinder and one sphere per node.
+ *
+ *  The tubes and spheres are instances of one unit mesh: each node owns the attributes of one instance
+ *  (the node, its parent and its color), placed by the vertex shader shader/tube_vertex.txt.
+ *  The lines from the parent to the nodes are packed for the line mode and for level-of-detail.
+ *  The nodes are kept in the mesh, so a later sync with the tree only finds the changed nodes and
+ *  their children, and returns them as ranges to patch in the buffers.
+ *  No OpenGL dependency.
+ *
+ */
+
+#ifndef V3DR_NEURONTUBE_H
+#define V3DR_NEURONTUBE_H
+
+#include "../basic_c_fun/v3d_basicdatatype.h"
+#include <vector>
+#include <utility>
+
+
+struct NeuronTubeInstance  // 48 bytes, three RGBA32F texels of the instance buffer texture
+{
+	float p1[4];  // x,y,z,r of the node
+	float p0[4];  // x,y,z,r of the parent, the node itself for a root
+	float c[4];   // color in [0,1], and 1 if drawn else 0
+};
+
+struct NeuronLineVertex  // 16 bytes, glVertexPointer(3,GL_FLOAT) + glColorPointer(4,GL_UNSIGNED_BYTE)
+{
+	float x, y, z;
+	unsigned char c[4];
+};
+
+class NeuronTubeMesh
+{
+public:
+	NeuronTubeMesh(int sides=8);
+
+	V3DLONG size() const {return V3DLONG(nodes.size());}
+
+	// sync with the tree: resize() then setNode() for all nodes, then commit().
+	// parent is the index of the parent node, -1 for a root, -2 if the parent is not found (not drawn)
+	void resize(V3DLONG n);
+	bool setNode(V3DLONG i, float x, float y, float z, float r, V3DLONG parent, const unsigned char rgb[3]); // return true if changed
+	void commit();                                              // repack the changed lines
+
+	// result of the last commit
+	const std::vector< std::pair<V3DLONG,V3DLONG> > & dirtyRanges() const {return dirty;} // nodes [first, last)
+	bool topologyChanged() const {return b_topology;}  // size or parents changed
+
+	// unit mesh of every instance, x,y,z,w per vertex: the tube ring at x,y with z = 0 at the node and 1 at
+	// the parent and w = 0, then the sphere at the node with w = 1.
+	// The triangles are those of the tube, then of the sphere. Front faces are clockwise, as
+	// drawNeuronTreeList draws with glFrontFace(GL_CW)
+	int unitVertexCount() const  {return 2*nSides + 2 + (nStacks-1)*nSides;}
+	const float * unitVertices() const {return &unit[0];}
+	const unsigned int * unitIndex() const {return &unitTriangles[0];}
+	int tubeIndexCount() const   {return nTubeIndex;}
+	int sphereIndexCount() const {return int(unitTriangles.size()) - nTubeIndex;}
+
+	// instance attributes of the nodes [first, last), packed when uploaded: no copy is kept
+	void packInstances(V3DLONG first, V3DLONG last, NeuronTubeInstance * out) const;
+
+	const NeuronLineVertex * lineVertices() const {return lineVerts.empty()? 0 : &lineVerts[0];} // node i: 2*i parent, 2*i+1 node
+
+	// line vertexes of the nodes with a parent and of the roots, rebuilt when the topology changes
+	const std::vector<unsigned int> & nodePointIndex() const {return nodePoints;}
+	const std::vector<unsigned int> & rootPointIndex() const {return rootPoints;}
+
+	// of the drawn nodes
+	const float * boundingBox() const {return bbox;}  // x0,y0,z0, x1,y1,z1
+	float meanRadius() const {return meanR;}
+
+protected:
+	struct Node
+	{
+		float x, y, z, r;
+		V3DLONG parent;
+		unsigned char c[3];
+	};
+
+	void buildUnit();
+	void packLine(V3DLONG i);
+
+	int nSides, nStacks;
+	std::vector<float> unit;
+	std::vector<unsigned int> unitTriangles;
+	int nTubeIndex;
+
+	std::vector<Node> nodes;
+	std::vector<char> changed;
+	std::vector<NeuronLineVertex> lineVerts;
+	std::vector<unsigned int> nodePoints, rootPoints;
+	std::vector< std::pair<V3DLONG,V3DLONG> > dirty;
+	bool b_topology, b_relink;
+	float bbox[6];
+	float meanR;
+};
+
+
+#endif
@@ -0,0 +1,288 @@
+/*
+ *  pickindex.cpp
+ *
+ *  see pickindex.h
+ *
+ */
+
+#include "pickindex.h"
+
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include <utility>
+
+
+#define PICK_LEAF_SIZE  8       // points per leaf
+#define PICK_SLACK      1e-3    // pixels, against rounding of the projected box corners
+#define PICK_REBUILD_PICKS  16  // a rebuild costs about 20 linear scans (bench/benchmark_pick)
+
+
+bool projectWinXY(double x, double y, double z,
+		const double M[16], const double P[16], const int viewport[4],
+		double& px, double& py, double& w)
+{
+	// column-major matrices, as glGetDoublev
+	double e[4], c[4];
+	for (int r=0; r<4; r++)  e[r] = M[r]*x + M[4+r]*y + M[8+r]*z + M[12+r];
+	for (int r=0; r<4; r++)  c[r] = P[r]*e[0] + P[4+r]*e[1] + P[8+r]*e[2] + P[12+r]*e[3];
+	w = c[3];
+	if (w == 0.0)  return false;
+
+	px = viewport[0] + (1 + c[0]/w) * viewport[2] / 2;
+	py = viewport[1] + (1 + c[1]/w) * viewport[3] / 2;
+	py = viewport[3] - py; //the Y axis is reversed
+	return true;
+}
+
+
+struct _PickAxisLess
+{
+	const float* pts;
+	int axis;
+	_PickAxisLess(const float* p, int a) : pts(p), axis(a) {}
+	bool operator()(V3DLONG i, V3DLONG j) const  {return pts[3*i+axis] < pts[3*j+axis];}
+};
+
+
+PointPickIndex::PointPickIndex()
+{
+	b_rebuild = true;
+	b_synced = false;
+	n_unsynced_picks = 0;
+	n_visited = 0;
+}
+
+bool PointPickIndex::needRebuild(V3DLONG n) const
+{
+	V3DLONG n_indexed = order.size();
+	return n < n_indexed || n - n_indexed > n_indexed/8 + PICK_LEAF_SIZE; // removed points, or a long tail
+}
+
+bool PointPickIndex::syncDue(V3DLONG n)
+{
+	if (! b_rebuild && ! needRebuild(n))  return true; // a refit costs about one linear scan
+	return ++n_unsynced_picks > PICK_REBUILD_PICKS;
+}
+
+void PointPickIndex::resize(V3DLONG n)
+{
+	if (n == size())  return;
+	if (needRebuild(n))  b_rebuild = true;
+	pts.resize(3*n);
+}
+
+bool PointPickIndex::setPoint(V3DLONG i, float x, float y, float z)
+{
+	float* p = &pts[3*i];
+	if (p[0]==x && p[1]==y && p[2]==z)  return false;
+
+	p[0] = x;  p[1] = y;  p[2] = z;
+	if (! b_rebuild && i < V3DLONG(order.size()))  dirtyLeaves.push_back(leafOf[i]); // the tail has no box
+	return true;
+}
+
+void PointPickIndex::commit()
+{
+	V3DLONG n = size();
+	if (b_rebuild)
+	{
+		order.resize(n);
+		leafOf.resize(n);
+		for (V3DLONG i=0; i<n; i++)  order[i] = i;
+		nodes.clear();
+		nodes.reserve(4*(n/PICK_LEAF_SIZE +1));
+		if (n>0)
+		{
+			float cell[6];
+			boxOfPoints(0, n, cell);
+			buildNode(0, n, -1, cell);
+		}
+		dirtyLeaves.clear();
+		b_rebuild = false;
+		b_synced = true;
+		return;
+	}
+
+	// refit the changed leaves and their ancestors
+	for (size_t k=0; k<dirtyLeaves.size(); k++)
+	{
+		V3DLONG i = dirtyLeaves[k];
+		Node& leaf = nodes[i];
+		boxOfPoints(leaf.start, leaf.count, leaf.box);
+		for (i = leaf.parent; i >= 0; i = nodes[i].parent)
+		{
+			Node& a = nodes[i];
+			const Node& l = nodes[a.left];
+			const Node& r = nodes[a.right];
+			for (int d=0; d<3; d++)
+			{
+				a.box[d]   = std::min(l.box[d], r.box[d]);
+				a.box[d+3] = std::max(l.box[d+3], r.box[d+3]);
+			}
+		}
+	}
+	dirtyLeaves.clear();
+	b_synced = true;
+}
+
+void PointPickIndex::boxOfPoints(V3DLONG start, V3DLONG count, float box[6]) const
+{
+	const float* p = &pts[3*order[start]];
+	for (int d=0; d<3; d++)  box[d] = box[d+3] = p[d];
+	for (V3DLONG k=start+1; k<start+count; k++)
+	{
+		p = &pts[3*order[k]];
+		for (int d=0; d<3; d++)
+		{
+			if (p[d] < box[d])    box[d] = p[d];
+			if (p[d] > box[d+3])  box[d+3] = p[d];
+		}
+	}
+}
+
+// cell: a box containing the points, to choose the split axis; the node boxes are computed bottom-up
+V3DLONG PointPickIndex::buildNode(V3DLONG start, V3DLONG count, V3DLONG parent, const float cell[6])
+{
+	V3DLONG id = nodes.size();
+	nodes.push_back(Node());
+	{
+		Node& a = nodes[id];
+		a.parent = parent;
+		a.left = a.right = -1;
+		a.start = start;
+		a.count = count;
+	}
+
+	if (count <= PICK_LEAF_SIZE)
+	{
+		for (V3DLONG k=start; k<start+count; k++)  leafOf[order[k]] = id;
+		boxOfPoints(start, count, nodes[id].box);
+		return id;
+	}
+
+	// median split along the longest side of the cell
+	int axis = 0;
+	for (int d=1; d<3; d++)
+		if (cell[d+3]-cell[d] > cell[axis+3]-cell[axis])  axis = d;
+	V3DLONG half = count/2;
+	std::nth_element(order.begin()+start, order.begin()+start+half, order.begin()+start+count,
+			_PickAxisLess(&pts[0], axis));
+	float split = pts[3*order[start+half]+axis];
+	float lcell[6], rcell[6];
+	for (int d=0; d<6; d++)  lcell[d] = rcell[d] = cell[d];
+	lcell[axis+3] = split;
+	rcell[axis] = split;
+
+	V3DLONG l = buildNode(start, half, id, lcell);
+	V3DLONG r = buildNode(start+half, count-half, id, rcell);
+	Node& a = nodes[id];  // after the recursion, nodes may be reallocated
+	a.left = l;
+	a.right = r;
+	for (int d=0; d<3; d++)
+	{
+		a.box[d]   = std::min(nodes[l].box[d], nodes[r].box[d]);
+		a.box[d+3] = std::max(nodes[l].box[d+3], nodes[r].box[d+3]);
+	}
+	return id;
+}
+
+double PointPickIndex::boxLowerBound(const float box[6], double cx, double cy,
+		const double M[16], const double P[16], const int viewport[4]) const
+{
+	double x0=0, x1=0, y0=0, y1=0;
+	for (int c=0; c<8; c++)
+	{
+		double px, py, w;
+		if (! projectWinXY((c&1)? box[3]:box[0], (c&2)? box[4]:box[1], (c&4)? box[5]:box[2],
+				M, P, viewport, px, py, w) || w < 0)
+			return 0; // box across the eye plane, no bound
+
+		if (c==0)  {x0 = x1 = px;  y0 = y1 = py;}
+		else
+		{
+			x0 = std::min(x0, px);  x1 = std::max(x1, px);
+			y0 = std::min(y0, py);  y1 = std::max(y1, py);
+		}
+	}
+	x0 -= PICK_SLACK;  x1 += PICK_SLACK;
+	y0 -= PICK_SLACK;  y1 += PICK_SLACK;
+
+	double dx = (cx < x0)? x0-cx : (cx > x1)? cx-x1 : 0;
+	double dy = (cy < y0)? y0-cy : (cy > y1)? cy-y1 : 0;
+	return dx*dx + dy*dy;
+}
+
+void PointPickIndex::pickPoint(V3DLONG i, double cx, double cy,
+		const double M[16], const double P[16], const int viewport[4],
+		V3DLONG& best_ind, double& best_dist) const
+{
+	double px, py, w;
+	if (! projectWinXY(pts[3*i], pts[3*i+1], pts[3*i+2], M, P, viewport, px, py, w))  return;
+
+	double cur_dist = (px-cx)*(px-cx)+(py-cy)*(py-cy);
+	if (best_ind < 0 || cur_dist < best_dist || (cur_dist == best_dist && i < best_ind))
+	{
+		best_dist = cur_dist;  best_ind = i;
+	}
+}
+
+V3DLONG PointPickIndex::nearestWinXY(double cx, double cy,
+		const double M[16], const double P[16], const int viewport[4],
+		double& best_dist) const
+{
+	V3DLONG best_ind = -1;  best_dist = -1;
+	n_visited = 0;
+	if (b_rebuild)  return -1;
+
+	// the tail first, its best point bounds the search in the hierarchy
+	for (V3DLONG i=order.size(); i<size(); i++)
+		pickPoint(i, cx, cy, M, P, viewport, best_ind, best_dist);
+	if (nodes.empty())  return best_ind;
+
+	// best first
+	typedef std::pair<double, V3DLONG> Entry;
+	std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry> > queue;
+	queue.push(Entry(0, 0));
+
+	while (! queue.empty())
+	{
+		Entry top = queue.top();  queue.pop();
+		if (best_ind >= 0 && top.first > best_dist)  break; // no closer point in the remaining boxes
+
+		const Node& a = nodes[top.second];
+		n_visited++;
+		if (a.left < 0)
+		{
+			for (V3DLONG k=a.start; k<a.start+a.count; k++)
+				pickPoint(order[k], cx, cy, M, P, viewport, best_ind, best_dist);
+		}
+		else
+		{
+			V3DLONG child[2] = {a.left, a.right};
+			for (int c=0; c<2; c++)
+			{
+				double bound = boxLowerBound(nodes[child[c]].box, cx, cy, M, P, viewport);
+				if (best_ind < 0 || bound <= best_dist)  queue.push(Entry(bound, child[c]));
+			}
+		}
+	}
+	return best_ind;
+}
+
+V3DLONG PointPickIndex::nearestWinXY_linear(double cx, double cy,
+		const double M[16], const double P[16], const int viewport[4],
+		double& best_dist) const
+{
+	V3DLONG best_ind = -1;  best_dist = -1;
+	for (V3DLONG i=0; i<size(); i++)
+	{
+		double px, py, w;
+		if (! projectWinXY(pts[3*i], pts[3*i+1], pts[3*i+2], M, P, viewport, px, py, w))  return -1;
+
+		double cur_dist = (px-cx)*(px-cx)+(py-cy)*(py-cy);
+		if (i==0) {	best_dist = cur_dist; best_ind=0; }
+		else {	if (cur_dist<best_dist) {best_dist=cur_dist; best_ind = i;}}
+	}
+	return best_ind;
+}
@@ -0,0 +1,92 @@
+/*
+ *  pickindex.h
+ *
+ *  Bounding volume hierarchy over 3D points, for picking the point nearest to a window position
+ *  (same result as projecting every point with gluProject, see Renderer_gl1::findNearestNeuronNode_WinXY).
+ *
+ *  The points are kept in the index, so a later sync with the source data only refits the boxes of the
+ *  moved points. Added points are kept in a tail that is scanned linearly, until it is large enough to
+ *  rebuild the hierarchy; removed points rebuild it.
+ *  A rebuild costs as much as many linear scans, so after the source data changed the index is synced
+ *  lazily: picks are answered by the linear scan of the source data until syncDue() is true.
+ *  No OpenGL dependency: the projection is done with the saved modelview, projection and viewport.
+ *
+ */
+
+#ifndef V3DR_PICKINDEX_H
+#define V3DR_PICKINDEX_H
+
+#include "../basic_c_fun/v3d_basicdatatype.h"
+#include <vector>
+
+
+// window position of a point projected as gluProject (Y axis reversed), return false if it cannot be projected
+bool projectWinXY(double x, double y, double z,
+		const double modelview[16], const double projection[16], const int viewport[4],
+		double& px, double& py, double& w);
+
+class PointPickIndex
+{
+public:
+	PointPickIndex();
+
+	V3DLONG size() const {return V3DLONG(pts.size()/3);}
+
+	// sync with the source data: resize() then setPoint() for all points, then commit()
+	void resize(V3DLONG n);
+	bool setPoint(V3DLONG i, float x, float y, float z); // return true if the point changed
+	void commit();                                       // rebuild or refit the changed boxes
+
+	// lazy sync: dataChanged() when the source data changed, then for each pick while !isSynced(), syncDue(n)
+	// tells whether to sync now with the n source points, or to scan the source data. The sync is due at once
+	// if it only refits boxes or appends points, else after PICK_REBUILD_PICKS picks on unchanged data.
+	void dataChanged()  {b_synced = false;  n_unsynced_picks = 0;}
+	bool isSynced() const  {return b_synced;}
+	bool syncDue(V3DLONG n);
+
+	// index of the point nearest to window position (cx,cy), squared distance in best_dist.
+	// Ties are broken by the lower index, as a linear scan does. Return -1 if no point.
+	V3DLONG nearestWinXY(double cx, double cy,
+			const double modelview[16], const double projection[16], const int viewport[4],
+			double& best_dist) const;
+
+	// the same query by projecting every point, for testing and benchmarking
+	V3DLONG nearestWinXY_linear(double cx, double cy,
+			const double modelview[16], const double projection[16], const int viewport[4],
+			double& best_dist) const;
+
+	V3DLONG nodeVisited() const {return n_visited;} // of the last query
+
+protected:
+	struct Node
+	{
+		float box[6];     // x0,y0,z0, x1,y1,z1
+		V3DLONG parent;   // -1 for root
+		V3DLONG left;     // child nodes, -1 for leaf
+		V3DLONG right;
+		V3DLONG start;    // points order[start .. start+count)
+		V3DLONG count;
+	};
+
+	bool needRebuild(V3DLONG n) const;
+	V3DLONG buildNode(V3DLONG start, V3DLONG count, V3DLONG parent, const float cell[6]);
+	void boxOfPoints(V3DLONG start, V3DLONG count, float box[6]) const;
+	double boxLowerBound(const float box[6], double cx, double cy,
+			const double modelview[16], const double projection[16], const int viewport[4]) const;
+	void pickPoint(V3DLONG i, double cx, double cy,
+			const double modelview[16], const double projection[16], const int viewport[4],
+			V3DLONG& best_ind, double& best_dist) const;
+
+	std::vector<float> pts;         // x,y,z of each point
+	std::vector<V3DLONG> order;     // indexed points, leaves own contiguous ranges; points from order.size() on are the tail
+	std::vector<V3DLONG> leafOf;    // leaf node of each indexed point
+	std::vector<Node> nodes;
+	std::vector<V3DLONG> dirtyLeaves;
+	bool b_rebuild;
+	bool b_synced;                  // commit() called since dataChanged()
+	int n_unsynced_picks;           // picks since dataChanged()
+	mutable V3DLONG n_visited;
+};
+
+
+#endif
@@ -41,6 +41,7 @@ Peng, H, Ruan, Z., Atasoy, D., and Sternson, S. (2010) “Automatic reconstructi
 #include "v3dr_glwidget.h" //for makeCurrent, drawText
 #include <sstream>
 #include <string>
+#include <vector>
 
 //<<<<<<< HEAD
 Renderer::SelectMode Renderer::defaultSelectMode = Renderer::smObject;
@@ -310,7 +311,7 @@ void Renderer::initialize(int version)
 	glEnable(GL_DEPTH_TEST);
 	glDepthFunc(GL_LESS);
 
-	if (rgbaBuf==0)   color_background = color_background2; // only geometric objects, 081023
+	if (! has_image())   color_background = color_background2; // only geometric objects, 081023
 	
 	loadObj();
 }
@@ -1031,10 +1032,88 @@ void rgba3d_r2gray(RGBA8* rgbaBuf, V3DLONG bufSize[5])
 		}
 }
 
+// RGBA components of one row of voxels, ch[SAM0+k] gives component k (see data4dp_to_rgba3d)
+static void _rgba3dRow(const std::vector<Rgba3dChannel>& ch, int channelMask, V3DLONG imageC, V3DLONG SAM0, V3DLONG dim4,
+		bool b_in, RGBA8* dst, V3DLONG offset_yz, const V3DLONG* ixs, const bool* xin, V3DLONG n)
+{
+	for (int k=0; k<4; k++)
+	{
+		if (! (channelMask & (1<<k)))  continue;
+		if (k < imageC && b_in && SAM0+k < dim4)
+			ch[SAM0+k].convertRow(dst, k, offset_yz, ixs, xin, n);
+		else if (k < imageC || k < 3) // out of image or no such channel
+			for (V3DLONG ox=0; ox<n; ox++)  dst[ox].c[k] = 0;
+	}
+
+	// alpha of less than 4 channels
+	if (imageC==1 && (channelMask & 1))
+		for (V3DLONG ox=0; ox<n; ox++)
+		{
+			float t = (0.f + dst[ox].r + dst[ox].g + dst[ox].b);
+			dst[ox].a = (unsigned char)t;
+		}
+	else if (imageC==2 && (channelMask & 3))
+		for (V3DLONG ox=0; ox<n; ox++)
+		{
+			float t = (0.f + dst[ox].r + dst[ox].g + dst[ox].b)/2.0;
+			dst[ox].a = (unsigned char)t;
+		}
+	else if (imageC==3 && (channelMask & 7))
+		for (V3DLONG ox=0; ox<n; ox++)
+		{
+			float t = (0.f + dst[ox].r + dst[ox].g + dst[ox].b)/3.0;
+			dst[ox].a = (unsigned char)t;
+		}
+}
+
+// convert planes [p0, p1) of the rgbaBuf, plane p = ot*imageZ + oz
+class Rgba3dSlabTask : public QRunnable
+{
+public:
+	Rgba3dSlabTask(const std::vector<Rgba3dChannel>& ch, int channelMask, V3DLONG imageC,
+			V3DLONG imageX, V3DLONG imageY, V3DLONG imageZ,
+			const V3DLONG* ixs, const bool* xin, const V3DLONG* iys, const bool* yin, const V3DLONG* izs, const bool* zin,
+			V3DLONG dim1, V3DLONG dim2, V3DLONG dim4, V3DLONG imageT,
+			RGBA8* rgbaBuf, V3DLONG p0, V3DLONG p1)
+		: ch(ch), channelMask(channelMask), imageC(imageC), imageX(imageX), imageY(imageY), imageZ(imageZ),
+		  ixs(ixs), xin(xin), iys(iys), yin(yin), izs(izs), zin(zin),
+		  dim1(dim1), dim2(dim2), dim4(dim4), imageT(imageT), rgbaBuf(rgbaBuf), p0(p0), p1(p1)
+	{}
+
+	void run()
+	{
+		for (V3DLONG p=p0; p<p1; p++)
+		{
+			V3DLONG ot = p/imageZ;
+			V3DLONG oz = p%imageZ;
+			V3DLONG SAM0 = ot*dim4/imageT;
+			for (V3DLONG oy=0; oy<imageY; oy++)
+			{
+				RGBA8* dst = rgbaBuf + (ot*imageZ + oz)*(imageY*imageX) + oy*imageX;
+				V3DLONG offset_yz = izs[oz]*(dim2*dim1) + iys[oy]*dim1;
+				bool b_in = zin[oz] && yin[oy];
+
+				_rgba3dRow(ch, channelMask, imageC, SAM0, dim4, b_in, dst, offset_yz, ixs, xin, imageX);
+			}
+		}
+	}
+
+private:
+	const std::vector<Rgba3dChannel>& ch;
+	int channelMask;
+	V3DLONG imageC, imageX, imageY, imageZ;
+	const V3DLONG *ixs;  const bool *xin;
+	const V3DLONG *iys;  const bool *yin;
+	const V3DLONG *izs;  const bool *zin;
+	V3DLONG dim1, dim2, dim4, imageT;
+	RGBA8* rgbaBuf;
+	V3DLONG p0, p1;
+};
+
 void data4dp_to_rgba3d(Image4DProxy<Image4DSimple>& img4dp, V3DLONG dim5,
 		V3DLONG start1, V3DLONG start2, V3DLONG start3, V3DLONG start4,
 		V3DLONG size1, V3DLONG size2, V3DLONG size3, V3DLONG size4,
-		RGBA8* rgbaBuf, V3DLONG bufSize[5])
+		RGBA8* rgbaBuf, V3DLONG bufSize[5], int channelMask)
 {
 	if (rgbaBuf==0 || bufSize==0)
 		return;
@@ -1048,12 +1127,6 @@ void data4dp_to_rgba3d(Image4DProxy<Image4DSimple>& img4dp, V3DLONG dim5,
 
 	V3DLONG dim1=img4dp.sx; V3DLONG dim2=img4dp.sy; V3DLONG dim3=img4dp.sz;
 	V3DLONG dim4=img4dp.sc;
-	#define SAMPLE(it, ic, ix,iy,iz, dx,dy,dz) \
-				(unsigned char)sampling3dUINT8( img4dp, (it*dim4/imageT + ic), \
-												ix, iy, iz, dx, dy, dz )
-
-        #define SAMPLE2(si, ix,iy,iz, dx,dy,dz, dxyz) \
-                        (unsigned char)sampling3dUINT8_2( img4dp, si, ix, iy, iz, dx, dy, dz, dxyz)
 
 	// only convert 1<=dim4<=4 ==> RGBA
 	V3DLONG imageX, imageY, imageZ, imageC, imageT;
@@ -1066,6 +1139,8 @@ void data4dp_to_rgba3d(Image4DProxy<Image4DSimple>& img4dp, V3DLONG dim5,
 	}
 	if (imageX*imageY*imageZ*imageC*imageT==0)
 		return;
+	if ((channelMask & 0xF)==0)
+		return;
 
 	float sx, sy, sz;
 	V3DLONG dx, dy, dz;
@@ -1078,82 +1153,101 @@ void data4dp_to_rgba3d(Image4DProxy<Image4DSimple>& img4dp, V3DLONG dim5,
         V3DLONG dxyz = dx*dy*dz;
 	MESSAGE_ASSERT(dx*dy*dz >=1); //down sampling
 
-	V3DLONG ot;
+	// sampled position along each axis, and whether it is in the image (see sampling3dUINT8_2)
+	std::vector<V3DLONG> ixs(imageX), iys(imageY), izs(imageZ);
+	bool *xin = new bool[imageX], *yin = new bool[imageY], *zin = new bool[imageZ];
 	V3DLONG ox, oy, oz;
-	V3DLONG ix, iy, iz;
+	for (ox=0; ox<imageX; ox++)
+	{
+		ixs[ox] = start1+ CLAMP(0,dim1-1, IROUND(ox*sx));
+		xin[ox] = (dxyz>0 && ixs[ox]>=0 && ixs[ox]+dx<=dim1);
+		if (! xin[ox])  ixs[ox] = 0;
+	}
+	for (oy=0; oy<imageY; oy++)
+	{
+		iys[oy] = start2+ CLAMP(0,dim2-1, IROUND(oy*sy));
+		yin[oy] = (iys[oy]>=0 && iys[oy]+dy<=dim2);
+		if (! yin[oy])  iys[oy] = 0;
+	}
+	for (oz=0; oz<imageZ; oz++)
+	{
+		izs[oz] = start3+ CLAMP(0,dim3-1, IROUND(oz*sz));
+		zin[oz] = (izs[oz]>=0 && izs[oz]+dz<=dim3);
+		if (! zin[oz])  izs[oz] = 0;
+	}
 
-        V3DLONG otOffset, ozOffset, oyOffset, oxOffset;
-
-        V3DLONG SAM0, SAM1, SAM2, SAM3;
-
-
-        for (ot=0; ot<imageT; ot++) {
-            SAM0 = ot*dim4/imageT + 0;
-            SAM1 = SAM0+1;
-            SAM2 = SAM0+2;
-            SAM3 = SAM0+3;
-            otOffset=ot*(imageZ*imageY*imageX);
-            for (oz = 0; oz < imageZ; oz++) {
-                ozOffset=oz*(imageY*imageX);
-                iz = start3+ CLAMP(0,dim3-1, IROUND(oz*sz));
-                for (oy = 0; oy < imageY; oy++) {
-                    oyOffset=oy*imageX;
-                    oxOffset=otOffset+ozOffset+oyOffset;
-                    iy = start2+ CLAMP(0,dim2-1, IROUND(oy*sy));
-
-                    if (imageC==1) {
-                        for (ox=0;ox<imageX;ox++) {
-                            ix = start1+ CLAMP(0,dim1-1, IROUND(ox*sx));
-                            RGBA8 rgba;
-                            rgba.r = SAMPLE2(SAM0, ix,iy,iz, dx,dy,dz, dxyz);
-                            rgba.g = 0;
-                            rgba.b = 0;
-                            float t = (0.f + rgba.r + rgba.g + rgba.b);
-                            rgba.a = (unsigned char)t;
-                            rgbaBuf[oxOffset++] = rgba;
-                        }
-                    }
-
-                    if (imageC==2) {
-                        for (ox=0;ox<imageX;ox++) {
-                            ix = start1+ CLAMP(0,dim1-1, IROUND(ox*sx));
-                            RGBA8 rgba;
-                            rgba.r = SAMPLE2(SAM0, ix,iy,iz, dx,dy,dz, dxyz);
-                            rgba.g = SAMPLE2(SAM1, ix,iy,iz, dx,dy,dz, dxyz);;
-                            rgba.b = 0;
-                            float t = (0.f + rgba.r + rgba.g + rgba.b)/2.0;
-                            rgba.a = (unsigned char)t;
-                            rgbaBuf[oxOffset++] = rgba;
-                        }
-                    }
-
-                    if (imageC==3) {
-                        for (ox=0;ox<imageX;ox++) {
-                            ix = start1+ CLAMP(0,dim1-1, IROUND(ox*sx));
-                            RGBA8 rgba;
-                            rgba.r = SAMPLE2(SAM0, ix,iy,iz, dx,dy,dz, dxyz);
-                            rgba.g = SAMPLE2(SAM1, ix,iy,iz, dx,dy,dz, dxyz);
-                            rgba.b = SAMPLE2(SAM2, ix,iy,iz, dx,dy,dz, dxyz);
-                            float t = (0.f + rgba.r + rgba.g + rgba.b)/3.0;
-                            rgba.a = (unsigned char)t;
-                            rgbaBuf[oxOffset++] = rgba;
-                        }
-                    }
-
-                    if (imageC>=4) {
-                        for (ox=0;ox<imageX;ox++) {
-                            ix = start1+ CLAMP(0,dim1-1, IROUND(ox*sx));
-                            RGBA8 rgba;
-                            rgba.r = SAMPLE2(SAM0, ix,iy,iz, dx,dy,dz, dxyz);
-                            rgba.g = SAMPLE2(SAM1, ix,iy,iz, dx,dy,dz, dxyz);
-                            rgba.b = SAMPLE2(SAM2, ix,iy,iz, dx,dy,dz, dxyz);
-                            rgba.a = SAMPLE2(SAM3, ix,iy,iz, dx,dy,dz, dxyz);
-                            rgbaBuf[oxOffset++] = rgba;
-                        }
-                    }
-                }
-            }
-        }
+	// only the channels to be converted
+	std::vector<Rgba3dChannel> ch(dim4);
+	for (V3DLONG ot=0; ot<imageT; ot++)
+	for (int k=0; k<imageC; k++)
+	{
+		V3DLONG c = ot*dim4/imageT + k;
+		if ((channelMask & (1<<k)) && c<dim4)  ch[c].setup(img4dp, c);
+	}
+
+	// Z slabs in parallel
+	V3DLONG n_plane = imageT*imageZ;
+	int n_thread = MAX(1, MIN(QThread::idealThreadCount(), int(n_plane)));
+	QThreadPool pool;
+	pool.setMaxThreadCount(n_thread);
+	V3DLONG n_slab = MIN(n_plane, V3DLONG(n_thread)*4); // more slabs than threads for balance
+	for (V3DLONG s=0; s<n_slab; s++)
+	{
+		pool.start(new Rgba3dSlabTask(ch, channelMask, imageC, imageX, imageY, imageZ,
+				&ixs[0], xin, &iys[0], yin, &izs[0], zin, dim1, dim2, dim4, imageT,
+				rgbaBuf, n_plane*s/n_slab, n_plane*(s+1)/n_slab));
+	}
+	pool.waitForDone();
+
+	delete[] xin;
+	delete[] yin;
+	delete[] zin;
+}
+
+void Rgba3dSource::setup(Image4DProxy<Image4DSimple>& img4dp, V3DLONG dim5,
+		V3DLONG start1, V3DLONG start2, V3DLONG start3, V3DLONG size4)
+{
+	this->start1 = start1;  this->start2 = start2;  this->start3 = start3;
+	dim1 = img4dp.sx;  dim2 = img4dp.sy;  dim4 = img4dp.sc;
+	this->dim5 = MAX(1, dim5);
+	imageC = MIN(4, size4);
+	sam0 = 0;
+	ch.resize(dim4);
+	for (V3DLONG c=0; c<dim4; c++)  ch[c].setup(img4dp, c);
+}
+
+void Rgba3dSource::convertBox(V3DLONG x0, V3DLONG x1, V3DLONG y0, V3DLONG y1, V3DLONG z0, V3DLONG z1, RGBA8* rgba) const
+{
+	V3DLONG n = x1-x0;
+	if (! ready() || n<=0)  return;
+
+	std::vector<V3DLONG> ixs(n);
+	bool* xin = new bool[n];
+	for (V3DLONG ox=0; ox<n; ox++)
+	{
+		ixs[ox] = start1 + x0+ox;
+		xin[ox] = true;
+	}
+	for (V3DLONG oz=z0; oz<z1; oz++)
+	for (V3DLONG oy=y0; oy<y1; oy++, rgba += n)
+	{
+		_rgba3dRow(ch, 0xF, imageC, sam0, dim4, true, rgba, (start3+oz)*(dim2*dim1) + (start2+oy)*dim1, &ixs[0], xin, n);
+		if (imageC==1) // see rgba3d_r2gray
+			for (V3DLONG ox=0; ox<n; ox++)  rgba[ox].g = rgba[ox].b = rgba[ox].r;
+	}
+	delete[] xin;
+}
+
+RGBA8 Rgba3dSource::voxel(V3DLONG x, V3DLONG y, V3DLONG z) const
+{
+	RGBA8 rgba;  rgba.i = 0;
+	if (! ready())  return rgba;
+
+	V3DLONG ix = start1 + x;
+	bool xin = true;
+	_rgba3dRow(ch, 0xF, imageC, sam0, dim4, true, &rgba, (start3+z)*(dim2*dim1) + (start2+y)*dim1, &ix, &xin, 1);
+	if (imageC==1)  rgba.g = rgba.b = rgba.r;
+	return rgba;
 }
 
 void data4dp_to_rgba3d(unsigned char* data4dp, V3DLONG dim1, V3DLONG dim2, V3DLONG dim3, V3DLONG dim4, V3DLONG dim5,
@@ -42,6 +42,7 @@ Peng, H, Ruan, Z., Atasoy, D., and Sternson, S. (2010) “Automatic reconstructi
 
 #include "v3dr_common.h"
 #include "version_control.h"
+#include <vector>
 #if defined(USE_Qt5_VS2015_Win7_81) || defined(USE_Qt5_VS2015_Win10_10_14393)
   #include <GLES3\gl3.h>
   #include <GL\glew.h>
@@ -124,6 +125,7 @@ public:
 // link to Data (volume & surface)
 	virtual void setupData(void* data) {};
 	virtual void cleanData()           {};
+	virtual bool updateDataChannels()  {return false;}; // return false if need setupData
 	virtual const bool has_image()   {return bool(rgbaBuf);}
 	virtual void getLimitedDataSize(int size[5]) {for (int i=0;i<5;i++) size[i]=bufSize[i];};
 	virtual bool beLimitedDataSize() {return b_limitedsize;};
@@ -424,10 +426,87 @@ void setRGB3dUINT8(unsigned char* data, V3DLONG dim1, V3DLONG dim2, V3DLONG dim3
 		V3DLONG x, V3DLONG y, V3DLONG z, RGB8 tmp);
 
 
+// converted in parallel Z slabs. channelMask: bit k set for converting RGBA component k, others are kept in rgbaBuf
 void data4dp_to_rgba3d(Image4DProxy<Image4DSimple>& img4dp, V3DLONG dim5,
 		V3DLONG start1, V3DLONG start2, V3DLONG start3, V3DLONG start4,
 		V3DLONG size1, V3DLONG size2, V3DLONG size3, V3DLONG size4,
-		RGBA8* rgbaBuf, V3DLONG bufSize[5]);
+		RGBA8* rgbaBuf, V3DLONG bufSize[5], int channelMask=0xF);
+
+// 8-bit value of a channel, same as Image4DProxy::value8bit_at() but with the type switch and the
+// display range lookup taken out of the inner loop (lut[] for 8/16-bit data)
+struct Rgba3dChannel
+{
+	const v3d_uint8* data;  // first voxel of the channel
+	int su;
+	bool b_minmax;
+	double vmin, r;
+	std::vector<v3d_uint8> lut;
+
+	void setup(Image4DProxy<Image4DSimple>& img4dp, V3DLONG c)
+	{
+		data = img4dp.at(0,0,0, c);
+		su = img4dp.su;
+		b_minmax = img4dp.has_minmax();
+		vmin = (b_minmax)? img4dp.vmin[c] : 0;
+		r = (b_minmax)? 255./(img4dp.vmax[c]-img4dp.vmin[c]) : 1;
+		lut.clear();
+		if (su==1 || su==2)
+		{
+			lut.resize((su==1)? 256 : 65536);
+			for (V3DLONG i=0; i<V3DLONG(lut.size()); i++)  lut[i] = value8bit(double(i));
+		}
+	}
+	inline v3d_uint8 value8bit(double v) const
+	{
+		if (b_minmax)  v = (v-vmin)*r;
+		return (v3d_uint8)v;
+	}
+	// dst[ox].c[k] = 8-bit value of voxel (ix[ox], iy, iz), 0 outside
+	void convertRow(RGBA8* dst, int k, V3DLONG offset_yz, const V3DLONG* ixs, const bool* xin, V3DLONG n) const
+	{
+		if (su==2)
+		{
+			const v3d_uint16* p = (const v3d_uint16*)data + offset_yz;
+			const v3d_uint8* t = &lut[0];
+			for (V3DLONG ox=0; ox<n; ox++)  dst[ox].c[k] = (xin[ox])? t[p[ixs[ox]]] : 0;
+		}
+		else if (su==4)
+		{
+			const v3d_float32* p = (const v3d_float32*)data + offset_yz;
+			for (V3DLONG ox=0; ox<n; ox++)  dst[ox].c[k] = (xin[ox])? value8bit(double(p[ixs[ox]])) : 0;
+		}
+		else
+		{
+			const v3d_uint8* p = data + offset_yz;
+			const v3d_uint8* t = &lut[0];
+			for (V3DLONG ox=0; ox<n; ox++)  dst[ox].c[k] = (xin[ox])? t[p[ixs[ox]]] : 0;
+		}
+	}
+};
+
+// the image converted to RGBA8 on demand, as data4dp_to_rgba3d at full resolution (bufSize = size),
+// for the bricked texture which keeps no RGBA copy of the image (see renderer_brick.cpp)
+class Rgba3dSource
+{
+public:
+	Rgba3dSource()  {clear();}
+	void setup(Image4DProxy<Image4DSimple>& img4dp, V3DLONG dim5,
+			V3DLONG start1, V3DLONG start2, V3DLONG start3, V3DLONG size4);
+	void clear()  {ch.clear(); start1=start2=start3=dim1=dim2=dim4=imageC=sam0=0; dim5=1;}
+	bool ready() const  {return imageC>0;}
+	void setTimepoint(V3DLONG t)  {sam0 = t*dim4/dim5;}
+
+	// the box [x0,x1)x[y0,y1)x[z0,z1) of the current time point into rgba, in x-y-z order
+	void convertBox(V3DLONG x0, V3DLONG x1, V3DLONG y0, V3DLONG y1, V3DLONG z0, V3DLONG z1, RGBA8* rgba) const;
+	RGBA8 voxel(V3DLONG x, V3DLONG y, V3DLONG z) const;
+
+protected:
+	std::vector<Rgba3dChannel> ch;
+	V3DLONG start1, start2, start3;
+	V3DLONG dim1, dim2, dim4, dim5;
+	V3DLONG imageC, sam0;
+};
+
 float sampling3dUINT8(Image4DProxy<Image4DSimple>& img4dp,
 		V3DLONG c,
 		V3DLONG x, V3DLONG y, V3DLONG z, V3DLONG dx, V3DLONG dy, V3DLONG dz);
@@ -515,6 +594,10 @@ inline bool supported_PBO()
 {
 	GLeeInit();	return (GLEE_ARB_pixel_buffer_object>0);
 }
+inline bool supported_VBO()
+{
+	GLeeInit();	return (GLEE_ARB_vertex_buffer_object>0);
+}
 
 /////////////////////////////////////////////////////////////////////////////
 
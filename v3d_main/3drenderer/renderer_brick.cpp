@@ -0,0 +1,553 @@
+/*
+ * Copyright (c)2006-2010  Hanchuan Peng (Janelia Farm, Howard Hughes Medical Institute).
+ * All rights reserved.
+ */
+
+
+/************
+                                            ********* LICENSE NOTICE ************
+
+This folder contains all source codes for the V3D project, which is subject to the following conditions if you want to use it.
+
+You will ***have to agree*** the following terms, *before* downloading/using/running/editing/changing any portion of codes in this package.
+
+1. This package is free for non-profit research, but needs a special license for any commercial purpose. Please contact Hanchuan Peng for details.
+
+2. You agree to appropriately cite this work in your related studies and publications.
+
+Peng, H., Ruan, Z., Long, F., Simpson, J.H., and Myers, E.W. (2010) “V3D enables real-time 3D visualization and quantitative analysis of large-scale biological image data sets,” Nature Biotechnology, Vol. 28, No. 4, pp. 348-353, DOI: 10.1038/nbt.1612. ( http://penglab.janelia.org/papersall/docpdf/2010_NBT_V3D.pdf )
+
+Peng, H, Ruan, Z., Atasoy, D., and Sternson, S. (2010) “Automatic reconstruction of 3D neuron structures using a graph-augmented deformable model,” Bioinformatics, Vol. 26, pp. i38-i46, 2010. ( http://penglab.janelia.org/papersall/docpdf/2010_Bioinfo_GD_ISMB2010.pdf )
+
+3. This software is provided by the copyright holders (Hanchuan Peng), Howard Hughes Medical Institute, Janelia Farm Research Campus, and contributors "as is" and any express or implied warranties, including, but not limited to, any implied warranties of merchantability, non-infringement, or fitness for a particular purpose are disclaimed. In no event shall the copyright owner, Howard Hughes Medical Institute, Janelia Farm Research Campus, or contributors be liable for any direct, indirect, incidental, special, exemplary, or consequential damages (including, but not limited to, procurement of substitute goods or services; loss of use, data, or profits; reasonable royalties; or business interruption) however caused and on any theory of liability, whether in contract, strict liability, or tort (including negligence or otherwise) arising in any way out of the use of this software, even if advised of the possibility of such damage.
+
+4. Neither the name of the Howard Hughes Medical Institute, Janelia Farm Research Campus, nor Hanchuan Peng, may be used to endorse or promote products derived from this software without specific prior written permission.
+
+*************/
+
+
+
+
+/*
+ *  renderer_brick.cpp
+ *
+ *  Bricked 3D texture of the full resolution volume (tryTexStream==TEX_STREAM_BRICK).
+ *
+ *  The volume is split into bricks of (BRICK_SIZE-2)^3 voxels. Each brick owns a small 3D texture
+ *  with a 1-texel border, so linear filtering has no seam between neighbour bricks.
+ *  Every frame, the bricks outside the cut box or the view frustum are culled, and a level of detail
+ *  is selected per brick from its projected voxel size (2^level voxels per texel, max of each channel).
+ *  Visible bricks are uploaded nearest first, at most BRICK_UPLOAD_STEP bytes per frame, and resident
+ *  textures are kept within BRICK_TEX_BUDGET by evicting the least recently visible bricks.
+ *  No RGBA copy of the volume is kept: each brick is converted from the image when uploaded (rgbaSource).
+ *
+ */
+
+#include "renderer_gl1.h"
+#include "v3dr_glwidget.h"
+
+#include <algorithm>
+
+
+#define BRICK_CORE  (BRICK_SIZE-2)
+
+// unit volume space [0,1] <==> voxel coordinate
+#define V2U(v, dim)  (((dim)>1)? double(v)/((dim)-1) : 0.)
+#define U2V(u, dim)  (((dim)>1)? double(u)*((dim)-1) : 0.)
+
+
+static inline int _brickTexels(int core, int level)
+{
+	return (core + (1<<level) -1) >>level;
+}
+
+// voxel range [b0, b1) of texel t along one axis of a brick (t=-1 and t=ct are the border texels).
+// The border texels take the voxel layer next to the brick, so only 1 voxel more is converted on each side
+static void _brickTexelRange(int v0, int sv, int n, int t, int ct, int dim, int& b0, int& b1)
+{
+	if (t<0)
+	{
+		b0 = v0-1;  b1 = v0;
+	}
+	else if (t>=ct)
+	{
+		b0 = v0+sv;  b1 = v0+sv+1;
+	}
+	else
+	{
+		b0 = v0+t*n;  b1 = qMin(v0+(t+1)*n, v0+sv);
+	}
+	b0 = qMax(b0, 0);  b1 = qMin(b1, dim);
+
+	if (b1<=b0) // border at the volume boundary, clamp to the core
+	{
+		if (t<0)  _brickTexelRange(v0, sv, n, 0, ct, dim, b0, b1);
+		else      _brickTexelRange(v0, sv, n, ct-1, ct, dim, b0, b1);
+	}
+}
+
+struct _BrickDepthGreater
+{
+	const QVector<VolBrick>& bricks;
+	_BrickDepthGreater(const QVector<VolBrick>& b) : bricks(b) {}
+	bool operator()(int i, int j) const  {return bricks[i].depth > bricks[j].depth;}
+};
+
+
+void Renderer_gl1::setupBrickTexture()
+{
+	cleanBrickTexture();
+	if (imageX<=0 || imageY<=0 || imageZ<=0)  return;
+
+	brickNX = (imageX + BRICK_CORE-1) /BRICK_CORE;
+	brickNY = (imageY + BRICK_CORE-1) /BRICK_CORE;
+	brickNZ = (imageZ + BRICK_CORE-1) /BRICK_CORE;
+
+	brickMaxLevel = 0;
+	while (_brickTexels(BRICK_CORE, brickMaxLevel+1) >= 2)  brickMaxLevel++;
+
+	volBricks.resize(brickNX*brickNY*brickNZ);
+	int i = 0;
+	for (int bz=0; bz<brickNZ; bz++)
+	for (int by=0; by<brickNY; by++)
+	for (int bx=0; bx<brickNX; bx++, i++)
+	{
+		VolBrick& b = volBricks[i];
+		b.x0 = bx*BRICK_CORE;  b.sx = qMin(BRICK_CORE, imageX - b.x0);
+		b.y0 = by*BRICK_CORE;  b.sy = qMin(BRICK_CORE, imageY - b.y0);
+		b.z0 = bz*BRICK_CORE;  b.sz = qMin(BRICK_CORE, imageZ - b.z0);
+		b.tex = 0;
+		b.level = -1;
+		b.texX = b.texY = b.texZ = 0;
+		b.bytes = 0;
+		b.wantLevel = -1;
+		b.depth = 0;
+		b.lastFrame = -1;
+	}
+	brickResidentBytes = 0;
+	brickFrame = 0;
+
+	qDebug("   setupBrickTexture: %dx%dx%d bricks of %d^3 voxels, %d LOD",
+			brickNX, brickNY, brickNZ, BRICK_CORE, brickMaxLevel+1);
+}
+
+void Renderer_gl1::cleanBrickTexture()
+{
+	for (int i=0; i<volBricks.size(); i++)
+	{
+		if (volBricks[i].tex)  glDeleteTextures(1, &(volBricks[i].tex));
+	}
+	volBricks.clear();
+	brickNX = brickNY = brickNZ = 0;
+	brickMaxLevel = 0;
+	brickResidentBytes = 0;
+}
+
+void Renderer_gl1::invalidateBrickTexture()
+{
+	// textures are kept and converted again from the image while drawing
+	for (int i=0; i<volBricks.size(); i++)
+	{
+		volBricks[i].level = -1;
+	}
+	realX = fillX = imageX;
+	realY = fillY = imageY;
+	realZ = fillZ = imageZ;
+}
+
+void Renderer_gl1::_uploadBrick(VolBrick& b, int level)
+{
+	if (! rgbaSource.ready() && ! rgbaBuf)  return;
+
+	int n = 1<<level;
+	int cx = _brickTexels(b.sx, level);
+	int cy = _brickTexels(b.sy, level);
+	int cz = _brickTexels(b.sz, level);
+	int tx = _getTexFillSize(cx+2);
+	int ty = _getTexFillSize(cy+2);
+	int tz = _getTexFillSize(cz+2);
+
+	// voxel range of each texel, including the border
+	QVector<int> rx(2*(cx+2)), ry(2*(cy+2)), rz(2*(cz+2));
+	for (int t=-1; t<=cx; t++)  _brickTexelRange(b.x0, b.sx, n, t, cx, imageX, rx[2*(t+1)], rx[2*(t+1)+1]);
+	for (int t=-1; t<=cy; t++)  _brickTexelRange(b.y0, b.sy, n, t, cy, imageY, ry[2*(t+1)], ry[2*(t+1)+1]);
+	for (int t=-1; t<=cz; t++)  _brickTexelRange(b.z0, b.sz, n, t, cz, imageZ, rz[2*(t+1)], rz[2*(t+1)+1]);
+
+	// voxels of the brick and its border
+	int x0 = rx[0], x1 = rx[1];
+	int y0 = ry[0], y1 = ry[1];
+	int z0 = rz[0], z1 = rz[1];
+	for (int t=0; t<cx+2; t++)  {x0 = qMin(x0, rx[2*t]);  x1 = qMax(x1, rx[2*t+1]);}
+	for (int t=0; t<cy+2; t++)  {y0 = qMin(y0, ry[2*t]);  y1 = qMax(y1, ry[2*t+1]);}
+	for (int t=0; t<cz+2; t++)  {z0 = qMin(z0, rz[2*t]);  z1 = qMax(z1, rz[2*t+1]);}
+	int wx = x1-x0, wy = y1-y0, wz = z1-z0;
+
+	RGBA8* buf = 0;
+	RGBA8* vox = 0;
+	try
+	{
+		buf = new RGBA8[V3DLONG(tx)*ty*tz];
+		vox = new RGBA8[V3DLONG(wx)*wy*wz];
+	}
+	catch (...)
+	{
+		qDebug("   _uploadBrick: fail to allocate %dx%dx%d texels", tx, ty, tz);
+		if (buf)  delete[] buf;
+		return;
+	}
+	memset(buf, 0, sizeof(RGBA8)*V3DLONG(tx)*ty*tz);
+
+	if (rgbaSource.ready())
+	{
+		rgbaSource.convertBox(x0,x1, y0,y1, z0,z1, vox);
+	}
+	else // the renderer set its own rgbaBuf
+	{
+		for (int z=z0; z<z1; z++)
+		for (int y=y0; y<y1; y++)
+			memcpy(vox + (V3DLONG(z-z0)*wy + (y-y0))*wx, rgbaBuf + (V3DLONG(z)*imageY + y)*imageX + x0, sizeof(RGBA8)*wx);
+	}
+
+	for (int k=0; k<cz+2; k++)
+	for (int j=0; j<cy+2; j++)
+	{
+		RGBA8* p = buf + (V3DLONG(k)*ty + j)*tx;
+		for (int i=0; i<cx+2; i++, p++)
+		{
+			RGBA8 m;  m.i = 0;
+			for (int z=rz[2*k]; z<rz[2*k+1]; z++)
+			for (int y=ry[2*j]; y<ry[2*j+1]; y++)
+			{
+				const RGBA8* q = vox + (V3DLONG(z-z0)*wy + (y-y0))*wx;
+				for (int x=rx[2*i]-x0; x<rx[2*i+1]-x0; x++)
+				{
+					if (q[x].r > m.r)  m.r = q[x].r;
+					if (q[x].g > m.g)  m.g = q[x].g;
+					if (q[x].b > m.b)  m.b = q[x].b;
+					if (q[x].a > m.a)  m.a = q[x].a;
+				}
+			}
+			*p = m;
+		}
+	}
+
+	if (! b.tex)  glGenTextures(1, &(b.tex));
+	glBindTexture(GL_TEXTURE_3D, b.tex);
+	setTexParam3D();
+	glTexImage3D(GL_TEXTURE_3D, // target
+		0, // level
+		texture_format, // texture format
+		tx, // width
+		ty, // height
+		tz, // depth
+		0, // border
+		image_format, // image format
+		image_type, // image type
+		buf);
+	CHECK_GLError_print();
+	delete[] buf;
+	delete[] vox;
+
+	V3DLONG bytes = V3DLONG(tx)*ty*tz*sizeof(RGBA8);
+	brickResidentBytes += bytes - b.bytes;
+	b.bytes = bytes;
+	b.level = level;
+	b.texX = tx;
+	b.texY = ty;
+	b.texZ = tz;
+}
+
+bool Renderer_gl1::updateBrickTexture()
+{
+	if (volBricks.size()<1)  return false;
+
+	GLint render_mode = GL_RENDER;
+	glGetIntegerv(GL_RENDER_MODE, &render_mode);
+	bool b_select = (render_mode == GL_SELECT); // only culling for selection, no upload
+
+	if (! b_select)  brickFrame++;
+
+	GLdouble M[16], P[16];
+	GLint view[4];
+	glGetDoublev(GL_MODELVIEW_MATRIX, M);  // in unit volume space
+	glGetDoublev(GL_PROJECTION_MATRIX, P);
+	glGetIntegerv(GL_VIEWPORT, view);
+
+	// eye size of 1 voxel
+	double vox = 0;
+	{
+		int dim[3] = {imageX, imageY, imageZ};
+		for (int a=0; a<3; a++)
+		{
+			double len = sqrt(M[4*a+0]*M[4*a+0] + M[4*a+1]*M[4*a+1] + M[4*a+2]*M[4*a+2]);
+			if (dim[a]>1)  vox = qMax(vox, len/(dim[a]-1));
+		}
+	}
+	bool b_ortho = (P[15] != 0); // glOrtho: P[3][3]==1, gluPerspective: P[3][3]==0
+	double pix_scale = P[5] * view[3] * 0.5; // eye size ==> pixels
+
+	// cut box in voxel coordinate
+	double cut0[3] = {U2V(VOL_X0, imageX), U2V(VOL_Y0, imageY), U2V(VOL_Z0, imageZ)};
+	double cut1[3] = {U2V(VOL_X1, imageX), U2V(VOL_Y1, imageY), U2V(VOL_Z1, imageZ)};
+	bool b_section = (renderMode == rmCrossSection);
+	bool b_plane[3] = {bXSlice, bYSlice, bZSlice};
+
+	QVector<int> visible;
+	for (int i=0; i<volBricks.size(); i++)
+	{
+		VolBrick& b = volBricks[i];
+		b.wantLevel = -1;
+
+		double v0[3] = {b.x0 -.5, b.y0 -.5, b.z0 -.5};
+		double v1[3] = {b.x0+b.sx -.5, b.y0+b.sy -.5, b.z0+b.sz -.5};
+		int iv0[3] = {b.x0, b.y0, b.z0};
+		int is[3] = {b.sx, b.sy, b.sz};
+
+		// cut box
+		bool in_cut = true;
+		if (b_section) // only the bricks across the section planes
+		{
+			in_cut = false;
+			for (int a=0; a<3; a++)
+			{
+				int slice = int(cut0[a]);
+				if (b_plane[a] && iv0[a]<=slice && slice<iv0[a]+is[a])  in_cut = true;
+			}
+		}
+		else
+		{
+			for (int a=0; a<3; a++)
+			{
+				if (v1[a] < cut0[a] || v0[a] > cut1[a])  in_cut = false;
+			}
+		}
+		if (! in_cut)  continue;
+
+		// view frustum
+		double u0[3] = {V2U(qMax(v0[0],0.), imageX), V2U(qMax(v0[1],0.), imageY), V2U(qMax(v0[2],0.), imageZ)};
+		double u1[3] = {V2U(qMin(v1[0],imageX-1.), imageX), V2U(qMin(v1[1],imageY-1.), imageY), V2U(qMin(v1[2],imageZ-1.), imageZ)};
+		int out[6] = {0,0,0,0,0,0};
+		for (int c=0; c<8; c++)
+		{
+			double p[4] = {(c&1)? u1[0]:u0[0], (c&2)? u1[1]:u0[1], (c&4)? u1[2]:u0[2], 1};
+			double e[4], q[4];
+			for (int r=0; r<4; r++)  e[r] = M[r]*p[0] + M[4+r]*p[1] + M[8+r]*p[2] + M[12+r]*p[3];
+			for (int r=0; r<4; r++)  q[r] = P[r]*e[0] + P[4+r]*e[1] + P[8+r]*e[2] + P[12+r]*e[3];
+			for (int a=0; a<3; a++)
+			{
+				if (q[a] < -q[3])  out[2*a]++;
+				if (q[a] >  q[3])  out[2*a+1]++;
+			}
+		}
+		bool in_view = true;
+		for (int f=0; f<6; f++)  if (out[f]==8)  in_view = false;
+		if (! in_view)  continue;
+
+		// depth of brick center & LOD
+		double c[3] = {(u0[0]+u1[0])*.5, (u0[1]+u1[1])*.5, (u0[2]+u1[2])*.5};
+		b.depth = -(M[2]*c[0] + M[6]*c[1] + M[10]*c[2] + M[14]);
+
+		double ppv = vox * pix_scale; // pixels per voxel
+		if (! b_ortho)  ppv = (b.depth > 1e-6)? ppv / b.depth : 1e10;
+		int level = 0;
+		if (ppv > 0 && ppv < 1)  level = int(floor(log(1/ppv)/log(2.)));
+		b.wantLevel = CLAMP(0, brickMaxLevel, level);
+
+		if (! b_select)  b.lastFrame = brickFrame;
+		visible.append(i);
+	}
+	if (b_select)  return false;
+
+	// far to near
+	std::sort(visible.begin(), visible.end(), _BrickDepthGreater(volBricks));
+
+	// fit wanted LOD in budget, coarsen the far bricks first
+	V3DLONG need = 0;
+	for (int k=0; k<visible.size(); k++)
+	{
+		VolBrick& b = volBricks[visible[k]];
+		need += V3DLONG(_getTexFillSize(_brickTexels(b.sx, b.wantLevel)+2)) *_getTexFillSize(_brickTexels(b.sy, b.wantLevel)+2)
+			*_getTexFillSize(_brickTexels(b.sz, b.wantLevel)+2) *sizeof(RGBA8);
+	}
+	for (bool changed=true; need > BRICK_TEX_BUDGET && changed; )
+	{
+		changed = false;
+		for (int k=0; k<visible.size() && need > BRICK_TEX_BUDGET; k++)
+		{
+			VolBrick& b = volBricks[visible[k]];
+			if (b.wantLevel >= brickMaxLevel)  continue;
+			int l = b.wantLevel;
+			need -= V3DLONG(_getTexFillSize(_brickTexels(b.sx, l)+2)) *_getTexFillSize(_brickTexels(b.sy, l)+2)
+				*_getTexFillSize(_brickTexels(b.sz, l)+2) *sizeof(RGBA8);
+			need += V3DLONG(_getTexFillSize(_brickTexels(b.sx, l+1)+2)) *_getTexFillSize(_brickTexels(b.sy, l+1)+2)
+				*_getTexFillSize(_brickTexels(b.sz, l+1)+2) *sizeof(RGBA8);
+			b.wantLevel = l+1;
+			changed = true;
+		}
+	}
+
+	// least recently visible bricks, for eviction
+	QVector<int> hidden;
+	for (int i=0; i<volBricks.size(); i++)
+	{
+		if (volBricks[i].tex && volBricks[i].lastFrame != brickFrame)  hidden.append(i);
+	}
+	int n_evicted = 0;
+
+	// upload near to far: first the coarsest LOD of the missing bricks, then refine
+	V3DLONG uploaded = 0;
+	bool pending = false;
+	for (int pass=0; pass<2; pass++)
+	for (int k=visible.size()-1; k>=0; k--)
+	{
+		VolBrick& b = volBricks[visible[k]];
+		int level;
+		if (pass==0)
+		{
+			if (b.level >= 0)  continue;
+			level = brickMaxLevel;
+		}
+		else
+		{
+			if (b.level == b.wantLevel)  continue;
+			if (b.level >= 0 && b.level < b.wantLevel && brickResidentBytes <= BRICK_TEX_BUDGET)  continue; // finer than needed, keep it
+			level = b.wantLevel;
+		}
+		if (uploaded >= BRICK_UPLOAD_STEP)
+		{
+			pending = true;
+			break;
+		}
+
+		V3DLONG bytes = V3DLONG(_getTexFillSize(_brickTexels(b.sx, level)+2)) *_getTexFillSize(_brickTexels(b.sy, level)+2)
+			*_getTexFillSize(_brickTexels(b.sz, level)+2) *sizeof(RGBA8);
+		while (brickResidentBytes - b.bytes + bytes > BRICK_TEX_BUDGET && n_evicted < hidden.size())
+		{
+			int lru = n_evicted;
+			for (int h=n_evicted+1; h<hidden.size(); h++)
+				if (volBricks[hidden[h]].lastFrame < volBricks[hidden[lru]].lastFrame)  lru = h;
+			qSwap(hidden[n_evicted], hidden[lru]);
+
+			VolBrick& e = volBricks[hidden[n_evicted++]];
+			glDeleteTextures(1, &(e.tex));
+			brickResidentBytes -= e.bytes;
+			e.tex = 0;
+			e.level = -1;
+			e.bytes = 0;
+		}
+		if (brickResidentBytes - b.bytes + bytes > BRICK_TEX_BUDGET && b.level >= 0)  continue; // no room to refine
+
+		_uploadBrick(b, level);
+		uploaded += bytes;
+	}
+	glBindTexture(GL_TEXTURE_3D, 0);
+
+	return pending;
+}
+
+void Renderer_gl1::drawBrickStack(int stack_i, float direction, int section)
+{
+	// stack_i: 1=Z[y][x], 2=Y[z][x], 3=X[z][y]
+	int as, ah, aw;
+	int thickness;
+	switch (stack_i)
+	{
+	case 1:  as = 2; ah = 1; aw = 0;  thickness = int(thicknessZ);  break;
+	case 2:  as = 1; ah = 2; aw = 0;  thickness = int(thicknessY);  break;
+	default: as = 0; ah = 2; aw = 1;  thickness = int(thicknessX);  break;
+	}
+	if (thickness <1) return; // only support thickness>=1
+
+	int dim[3] = {imageX, imageY, imageZ};
+	double cut0[3] = {VOL_X0, VOL_Y0, VOL_Z0};
+	double cut1[3] = {VOL_X1, VOL_Y1, VOL_Z1};
+
+	double s0 = cut0[as], s1 = cut1[as];
+	double h0 = cut0[ah], h1 = cut1[ah];
+	double w0 = cut0[aw], w1 = cut1[aw];
+	if ((s1-s0<0)||(h1-h0<0)||(w1-w0<0)) return; // no draw
+
+	int slice0 = s0*((dim[as]<=1)? 0 : dim[as]-1);
+	int slice1 = s1*((dim[as]<=1)? 0 : dim[as]-1);
+	if (section >0) { // cross-section
+		h0 = 0;		h1 = 1;
+		w0 = 0;		w1 = 1;
+		slice1 = slice0;
+	}
+	double ds = (dim[as]<=1)? 0 : (1.f / (dim[as]-1));
+	int step = (direction <0)? (+1) : (-1);
+
+	// far to near
+	QVector<int> order;
+	for (int i=0; i<volBricks.size(); i++)
+	{
+		if (volBricks[i].wantLevel >= 0 && volBricks[i].level >= 0)  order.append(i);
+	}
+	std::sort(order.begin(), order.end(), _BrickDepthGreater(volBricks));
+
+	for (int k=0; k<order.size(); k++)
+	{
+		const VolBrick& b = volBricks[order[k]];
+		int v0[3] = {b.x0, b.y0, b.z0};
+		int sv[3] = {b.sx, b.sy, b.sz};
+		int tdim[3] = {b.texX, b.texY, b.texZ};
+		double n = 1<<b.level;
+
+		int bs0 = qMax(slice0, v0[as]);
+		int bs1 = qMin(slice1, v0[as]+sv[as]-1);
+		if (bs1 < bs0)  continue;
+
+		double bh0 = h0, bh1 = h1, bw0 = w0, bw1 = w1;
+		if (dim[ah]>1)
+		{
+			bh0 = qMax(bh0, V2U(v0[ah]-.5, dim[ah]));
+			bh1 = qMin(bh1, V2U(v0[ah]+sv[ah]-.5, dim[ah]));
+		}
+		if (dim[aw]>1)
+		{
+			bw0 = qMax(bw0, V2U(v0[aw]-.5, dim[aw]));
+			bw1 = qMin(bw1, V2U(v0[aw]+sv[aw]-.5, dim[aw]));
+		}
+		if ((bh1-bh0<0)||(bw1-bw0<0))  continue;
+
+		// unit volume space ==> brick texture coordinate
+#define BRICK_TEXCOORD(a, u)  (((U2V(u, dim[a]) +.5 - v0[a])/n + 1) / tdim[a])
+		double th0 = BRICK_TEXCOORD(ah, bh0),  th1 = BRICK_TEXCOORD(ah, bh1);
+		double tw0 = BRICK_TEXCOORD(aw, bw0),  tw1 = BRICK_TEXCOORD(aw, bw1);
+
+		glBindTexture(GL_TEXTURE_3D, b.tex);
+		setTexParam3D();
+
+		for (int slice = (step>0)? bs0 : bs1;
+			bs0 <= slice && slice <= bs1;
+			slice += step)
+		{
+			int k_repeat = thickness;
+			if ( (step>0 && slice==slice1)
+				||(step<0 && slice==slice0)
+				)  k_repeat = 1;
+
+			for (int r=0; r<k_repeat; r++)
+			{
+				double s = V2U(slice, dim[as]) + step * r*ds/thickness;
+				double ts = BRICK_TEXCOORD(as, s);
+
+				double vh[4] = {bh0, bh0, bh1, bh1},  vw[4] = {bw0, bw1, bw1, bw0};
+				double th[4] = {th0, th0, th1, th1},  tw[4] = {tw0, tw1, tw1, tw0};
+
+				glBegin(GL_QUADS);
+				for (int c=0; c<4; c++)
+				{
+					double tc[3], vc[3];
+					tc[as] = ts;     vc[as] = s;
+					tc[ah] = th[c];  vc[ah] = vh[c];
+					tc[aw] = tw[c];  vc[aw] = vw[c];
+					glTexCoord3d(tc[0], tc[1], tc[2]);
+					glVertex3d(vc[0], vc[1], vc[2]);
+				}
+				glEnd();
+			}
+		}
+#undef BRICK_TEXCOORD
+	}
+}
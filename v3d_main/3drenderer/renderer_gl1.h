@@ -52,6 +52,8 @@ Peng, H, Ruan, Z., Atasoy, D., and Sternson, S. (2010) “Automatic reconstructi
 
 #include "renderer.h"
 #include "marchingcubes.h"
+#include "pickindex.h"
+#include "neurontube.h"
 #include <time.h>
 
 enum v3dr_DataClass { dcDataNone=0,
@@ -64,6 +66,54 @@ enum v3dr_VolSlice { vsSliceNone=0,
 				vsZslice=3,
 				vsFslice=4,
 				};
+// brick of the bricked 3D texture (tryTexStream==TEX_STREAM_BRICK), see renderer_brick.cpp
+struct VolBrick
+{
+	int x0, y0, z0;          // first voxel of the brick core
+	int sx, sy, sz;          // size of the brick core (voxels)
+	GLuint tex;              // 3D texture of the brick core plus 1-texel border (0 if not resident)
+	int level;               // LOD of the resident texture, i.e. 2^level voxels per texel (-1 if not resident or stale)
+	int texX, texY, texZ;    // size of the resident texture
+	V3DLONG bytes;           // texture memory of the resident texture
+	int wantLevel;           // LOD wanted for the current frame (-1 if culled)
+	double depth;            // eye-space depth of the brick center in the current frame
+	V3DLONG lastFrame;       // last frame the brick was drawn in (for eviction)
+};
+// size and checksum of the nodes of a neuron tree, to find the tree changed without keeping a copy of its nodes
+struct NeuronNodesStamp
+{
+	V3DLONG size;
+	quint64 sum;
+	NeuronNodesStamp() {size = -1; sum = 0;}
+	NeuronNodesStamp(const QList <NeuronSWC>& nodes); // see renderer_hit.cpp
+	bool operator==(const NeuronNodesStamp& s) const {return size==s.size && sum==s.sum;}
+	bool operator!=(const NeuronNodesStamp& s) const {return !(*this == s);}
+};
+// picking index of a neuron tree or a label surface, see renderer_hit.cpp
+struct PickIndexEntry
+{
+	PointPickIndex index;
+	NeuronNodesStamp stamp;          // the nodes last seen
+	QVector <Triangle*> triangles;   // the triangles of the surface (surfaces are not edited)
+};
+// packed data of a neuron tree and its buffer objects, see renderer_tube.cpp
+struct NeuronTubeBuffer
+{
+	NeuronTubeMesh mesh;
+	NeuronNodesStamp stamp;   // the nodes last synced
+	V3DLONG hashSize;         // size and checksum of the node hash last synced
+	quint64 hashSum;
+	RGBA8 color;
+	bool editable;
+	bool b_changed;           // synced with changed nodes in this frame, the dirty ranges of the mesh are to upload
+	bool b_instanceStale;     // changed while not drawn instanced, all the instances are uploaded again
+	GLuint vbo[2];            // line vertexes (0 if drawn from client memory), tube instances (0 if not drawn instanced)
+	GLuint tex;               // buffer texture of the tube instances
+	V3DLONG lineCapacity;     // nodes allocated for the lines
+	V3DLONG instanceCapacity; // nodes allocated for the tube instances
+	NeuronTubeBuffer() {vbo[0] = vbo[1] = tex = 0; lineCapacity = instanceCapacity = hashSize = 0; hashSum = 0; color.i = 0; editable = b_changed = b_instanceStale = false;}
+};
+
 enum v3dr_SurfaceType { stSurfaceNone=0,
 				stImageMarker=1,
 				stLabelSurface=2,
@@ -90,6 +140,7 @@ public:
 // link to Data
 	virtual void setupData(void* data);
 	virtual void cleanData();                      // makeCurrent
+	virtual bool updateDataChannels();             // only re-convert the channels whose display range (p_vmin/p_vmax) changed
 	virtual const bool has_image()   {return (size4>0);}
 	virtual const BoundingBox getDataBox() {return dataBox;}
 
@@ -162,6 +213,14 @@ public:
 			GLuint tex3D, GLuint texs[], int stack_i,
 			float direction, int section, bool t3d, bool stream);
 
+	virtual void setupBrickTexture();		// called by loadVol when tryTexStream==TEX_STREAM_BRICK
+	virtual void cleanBrickTexture();		// called by cleanVol
+	virtual void invalidateBrickTexture();	// called by setupStackTexture, e.g. when time point is changed
+	virtual bool updateBrickTexture();		// called by drawUnitVolume: selects LOD, culls and uploads bricks. Returns true if uploads are pending
+	virtual void _uploadBrick(VolBrick& b, int level);
+	virtual void drawBrickStack(int stack_i, float direction, int section);
+	bool _brickTex_ready()											{return volBricks.size()>0;}
+
 	virtual bool supported_TexStream()								{return false;} //091003
 	virtual void setupTexStreamBuffer()							{tex_stream_buffer = false;}; //091003
 	virtual void cleanTexStreamBuffer()							{tex_stream_buffer = false;}; //091003
@@ -237,6 +296,9 @@ public:
 	QList <CellAPO> *getHandleAPOCellList() {return &listCell;}
 
 	Triangle * findNearestSurfTriangle_WinXY(int cx, int cy, int & vertex_i, Triangle * plist);
+	PointPickIndex * pickIndexNeuron(const NeuronTree * ptree);	// synced with the nodes, 0 if not a loaded neuron or not synced yet
+	PickIndexEntry * pickIndexSurf(Triangle * plist);	// synced with the vertexes, 0 if not a loaded surface or not synced yet
+	void cleanPickIndex();
 
 	double computeSurfaceArea(int dataClass, int surfaceType, int index);
 	double computeSurfaceVolume(int dataClass, int surfaceType, int index);
@@ -592,6 +654,8 @@ public:
 	V3DLONG size1, size2, size3, size4, size5;
 	BoundingBox dataBox;
 	BoundingBox dataViewProcBox; //current clip box that data are visible (and thus are processable). 091113 PHC
+	QVector<double> rgbaVmin, rgbaVmax; // display range of each channel when total_rgbaBuf was converted
+	Rgba3dSource rgbaSource; // converts the bricks from the image, no total_rgbaBuf in bricked mode
 
 	bool texture_unit0_3D, tex_stream_buffer, drawing_fslice;
 	GLenum texture_format, image_format, image_type;
@@ -606,6 +670,11 @@ public:
 	int realX, realY, realZ, realF;
 	int fillX, fillY, fillZ, fillF;
 	GLdouble volumeViewMatrix[16]; // for choosing stack direction
+	QVector<VolBrick> volBricks;			// bricked 3D texture, in x-y-z order
+	int brickNX, brickNY, brickNZ;			// number of bricks along X, Y, Z
+	int brickMaxLevel;						// coarsest LOD
+	V3DLONG brickResidentBytes;				// texture memory used by resident bricks
+	V3DLONG brickFrame;						// frame counter
 	float VOL_X1, VOL_X0, VOL_Y1, VOL_Y0, VOL_Z1, VOL_Z0;
 	int VOLUME_FILTER;
 	RGBA32f SLICE_COLOR; // proxy geometry color+alpha
@@ -651,6 +720,10 @@ private:
 		safeX = safeY = safeZ = 0;
 		fillX = fillY = fillZ = fillF = 0;
 		realX = realY = realZ = realF = 0;
+		brickNX = brickNY = brickNZ = 0;
+		brickMaxLevel = 0;
+		brickResidentBytes = 0;
+		brickFrame = 0;
 		VOL_X1 = VOL_Y1 = VOL_Z1 = 1;
 		VOL_X0 = VOL_Y0 = VOL_Z0 = 0;
 		VOLUME_FILTER = 1;
@@ -723,6 +796,11 @@ public:
 	QList <GLuint> list_glistLabel;
 	BoundingBox labelBB;
 
+	// picking index of each neuron / surface, see pickIndexNeuron & pickIndexSurf
+	QHash <const void*, PickIndexEntry*> pickIndexes;
+	// packed vertex buffer of each neuron, see neuronBuffer
+	QHash <const void*, NeuronTubeBuffer*> neuronBuffers;
+
 	void createMarker_atom();  					// makeCurrent & called in loadObj
 	virtual void drawMarkerList();
 	void loadLandmarks_from_file(const QString & filename);
@@ -740,6 +818,13 @@ public:
 	void loadNeuronTree(const QString& filename);
 	void updateNeuronBoundingBox();
 	virtual void drawNeuronTree(int i);
+	bool drawNeuronTreeBuffer(int i, int lineType);	// packed vertex buffer path of drawNeuronTree, false if not applicable
+	NeuronTubeBuffer * neuronBuffer(int i, int lineType, int & lod);	// synced with the nodes of the tree, and level of detail
+	void uploadNeuronBuffer(NeuronTubeBuffer * buf);
+	bool uploadNeuronInstances(NeuronTubeBuffer * buf);	// into a buffer texture, false if not supported
+	virtual bool drawNeuronTubeInstances(NeuronTubeBuffer * buf, int lod) {return false;}	// instanced tubes, needs the shader of Renderer_gl2
+	void cleanNeuronBuffer();
+	void neuronNodeColor(const NeuronSWC & S, const RGBA8 & rgba, bool editable, GLubyte color[3]);
 	virtual void drawNeuronTreeList();
 	virtual void drawGrid();
 
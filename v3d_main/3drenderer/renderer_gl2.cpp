@@ -196,6 +196,20 @@ void Renderer_gl2::loadShader()
 				Q_CSTR(QString("#define TEX3D \n") + deftexlod + resourceTextFile(":/shader/tex_fragment.txt")));
 
 	} CATCH_handler("Renderer_gl2::initialze");
+
+	// optional, the neuron tubes are drawn node by node without it
+	if (GLEE_EXT_draw_instanced && GLEE_EXT_gpu_shader4 && GLEE_EXT_texture_buffer_object && GLEE_ARB_texture_float)
+		try {
+
+			qDebug("+++++++++ shader for instanced Neuron Tube");
+			linkGLShader(SMgr, shaderTube,
+					Q_CSTR(resourceTextFile(":/shader/tube_vertex.txt")),
+					0);
+
+		} catch (...) {
+			qDebug("   *** instanced Neuron Tube shader not available");
+			shaderTube = 0;
+		}
 	qDebug("+++++++++ GLSL shader setup finished.");
 
 
@@ -211,6 +225,11 @@ void Renderer_gl2::cleanShader()
 	DELETE_AND_ZERO(shaderTex2D);
 	DELETE_AND_ZERO(shaderTex3D);
 	DELETE_AND_ZERO(shaderObj);
+	DELETE_AND_ZERO(shaderTube);
+	if (tubeUnitVBO[0]) {
+		glDeleteBuffersARB(2, tubeUnitVBO);
+		tubeUnitVBO[0] = tubeUnitVBO[1] = 0;
+	}
 
 	if (texColormap) {
 		glDeleteTextures(1, &texColormap);
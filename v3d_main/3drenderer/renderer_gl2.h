@@ -76,6 +76,7 @@ public:
 	virtual void cleanShader(); // called by ~Renderer_gl2 	// makeCurrent
 
 	virtual void drawObj();  // called by paint()
+	virtual bool drawNeuronTubeInstances(NeuronTubeBuffer * buf, int lod); // called by drawNeuronTreeBuffer(), see renderer_tube.cpp
 	//virtual void drawVol();  // called by paint() //use default.
 
 	virtual void equAlphaBlendingProjection();
@@ -102,6 +103,8 @@ public:
 //protected:
 	cwc::glShaderManager SMgr;
 	cwc::glShader *shader, *shaderTex2D, *shaderTex3D, *shaderObj;
+	cwc::glShader *shaderTube;  // instanced neuron tubes, 0 if not supported
+	GLuint tubeUnitVBO[2];      // vertexes and triangles of the unit tube and sphere
 
 	GLuint texColormap; // nearest filter, [x-coord for intensity][y-coord for channel]
 	// RGBA8 colormap[FILL_CHANNEL][256];      // [n-channel][256-intensity]
@@ -114,6 +117,8 @@ private:
 	void init_members()
 	{
 		shader = shaderTex2D=shaderTex3D = shaderObj = 0;
+		shaderTube = 0;
+		tubeUnitVBO[0] = tubeUnitVBO[1] = 0;
 		texColormap = 0;
 		pboZ = pboY = pboX = 0;
 		pbo_texture_format = pbo_image_format = pbo_image_type = -1;
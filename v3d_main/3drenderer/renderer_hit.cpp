@@ -2027,13 +2027,15 @@ int Renderer_gl1::processHit(int namelen, int names[], int cx, int cy, bool b_me
         {
             QString tmpstr, ts2;
             float ave_sd=0, ave_ssd=0, ave_ssd_percent=0;
+            QList<NeuronTree> others = listNeuronTree; others.removeAt(names[2]-1);
+            QList<NeuronDistSimple> scores = neuron_score_rounding_nearest_neighbor_batch(&(listNeuronTree.at(names[2]-1)), others, 1);
             for (int ci=0;ci<listNeuronTree.size();ci++)
             {
                 if (ci!=(names[2]-1))
                 {
                     ts2.setNum(names[2]); ts2.prepend("dists between "); tmpstr += ts2;
                     ts2.setNum(ci+1); ts2.prepend(" and "); tmpstr += ts2;
-                    NeuronDistSimple tmp_score = neuron_score_rounding_nearest_neighbor(&(listNeuronTree.at(names[2]-1)), &(listNeuronTree.at(ci)),1);
+                    NeuronDistSimple tmp_score = scores.at((ci<names[2]-1) ? ci : ci-1);
                     ts2.setNum(tmp_score.dist_allnodes); ts2.prepend(" are <br> entire-structure-average = "); tmpstr += ts2 + "<br>";
                     ts2.setNum(tmp_score.dist_apartnodes); ts2.prepend(" different-structure-average = "); tmpstr += ts2 + "<br>";
                     ts2.setNum(tmp_score.percent_apartnodes); ts2.prepend(" percent of different-structure = "); tmpstr += ts2 + "<br>";
@@ -3183,6 +3185,10 @@ QString Renderer_gl1::info_SurfVertex(int n_id, Triangle * face, int label)
 V3DLONG Renderer_gl1::findNearestNeuronNode_WinXY(int cx, int cy, NeuronTree * ptree, double &best_dist) //find the nearest node in a neuron in XY project of the display window
 {
 	if (!ptree) return -1;
+	if (PointPickIndex* index = pickIndexNeuron(ptree)) // loaded and unchanged neuron: BVH instead of projecting all nodes
+	{
+		return index->nearestWinXY(cx, cy, markerViewMatrix, projectionMatrix, viewport, best_dist);
+	}
 	QList <NeuronSWC> *p_listneuron = &(ptree->listNeuron);
 	if (!p_listneuron) return -1;
 	//qDebug()<<"win click position:"<<cx<<" "<<cy;
@@ -3205,6 +3211,13 @@ V3DLONG Renderer_gl1::findNearestNeuronNode_WinXY(int cx, int cy, NeuronTree * p
 Triangle * Renderer_gl1::findNearestSurfTriangle_WinXY(int cx, int cy, int & vertex_i, Triangle * plist)
 {
 	if (!plist) return NULL;
+	if (PickIndexEntry* e = pickIndexSurf(plist)) // loaded surface: BVH instead of projecting all vertexes
+	{
+		double best_dist;
+		V3DLONG best = e->index.nearestWinXY(cx, cy, markerViewMatrix, projectionMatrix, viewport, best_dist);
+		vertex_i = (best<0)? -1 : best%3;
+		return (best<0)? NULL : e->triangles[best/3];
+	}
 	//qDebug()<<"win click position:"<<cx<<" "<<cy;
 	GLdouble px, py, pz, ix, iy, iz;
 	V3DLONG best_ind=-1, best_vertex=-1; double best_dist=-1;
@@ -3225,6 +3238,90 @@ Triangle * Renderer_gl1::findNearestSurfTriangle_WinXY(int cx, int cy, int & ver
 	vertex_i = best_vertex;
 	return best_pT; //091020 RZC
 }
+// FNV-1a over the fields of the nodes that are drawn or picked
+static inline quint64 _stampMix(quint64 h, quint64 w)  {return (h ^ w) * Q_UINT64_C(1099511628211);}
+static inline quint64 _stampBits(float f)  {union {float f; quint32 u;} b;  b.f = f;  return b.u;}
+NeuronNodesStamp::NeuronNodesStamp(const QList <NeuronSWC>& nodes)
+{
+	size = nodes.size();
+	sum = Q_UINT64_C(14695981039346656037);
+	for (V3DLONG i=0; i<size; i++)
+	{
+		const NeuronSWC& S = nodes.at(i);
+		sum = _stampMix(sum, _stampBits(S.x) | (_stampBits(S.y) << 32));
+		sum = _stampMix(sum, _stampBits(S.z) | (_stampBits(S.r) << 32));
+		sum = _stampMix(sum, quint64(S.n) ^ (quint64(S.pn) << 32));
+		sum = _stampMix(sum, quint64(S.type) ^ (quint64(S.seg_id) << 32));
+	}
+}
+
+PointPickIndex * Renderer_gl1::pickIndexNeuron(const NeuronTree * ptree)
+{
+	bool b_loaded = false;
+	for (int i=0; i<listNeuronTree.size() && !b_loaded; i++)  b_loaded = (ptree == &(listNeuronTree.at(i)));
+	if (!b_loaded) return 0; // a copy, only used once
+
+	if (!pickIndexes.contains(ptree) && pickIndexes.size() >= listNeuronTree.size()+list_listTriangle.size())
+		cleanPickIndex(); // some are of deleted objects
+	PickIndexEntry*& e = pickIndexes[ptree];
+	if (!e) e = new PickIndexEntry;
+
+	// the nodes are checksummed instead of kept, the edits of the tree do not mark it changed
+	const QList <NeuronSWC>& nodes = ptree->listNeuron;
+	NeuronNodesStamp stamp(nodes);
+	if (stamp != e->stamp)
+	{
+		e->stamp = stamp;
+		e->index.dataChanged();
+	}
+	if (! e->index.isSynced())
+	{
+		if (! e->index.syncDue(nodes.size())) return 0; // linear scan until a rebuild is worthwhile
+
+		// only the moved nodes are refitted and the added ones appended, the BVH is rebuilt if nodes are deleted
+		e->index.resize(nodes.size());
+		for (V3DLONG i=0; i<nodes.size(); i++)
+		{
+			const NeuronSWC& p = nodes.at(i);
+			e->index.setPoint(i, p.x, p.y, p.z);
+		}
+		e->index.commit();
+	}
+	return &(e->index);
+}
+
+PickIndexEntry * Renderer_gl1::pickIndexSurf(Triangle * plist)
+{
+	if (!list_listTriangle.contains(plist)) return 0;
+
+	if (!pickIndexes.contains(plist) && pickIndexes.size() >= listNeuronTree.size()+list_listTriangle.size())
+		cleanPickIndex(); // some are of deleted objects
+	PickIndexEntry*& e = pickIndexes[plist];
+	if (!e) e = new PickIndexEntry;
+
+	// the triangles are not changed until cleanLabelfieldSurf, which drops the entries
+	if (! e->index.isSynced())
+	{
+		if (! e->index.syncDue(3*e->triangles.size())) return 0; // the first sync is a build
+
+		e->triangles.clear();
+		for (Triangle * pT=plist; pT->next!=NULL; pT=pT->next) // same as findNearestSurfTriangle_WinXY, without the last one
+			e->triangles.append(pT);
+		e->index.resize(3*e->triangles.size());
+		for (V3DLONG i=0; i<e->triangles.size(); i++)
+			for (int j=0; j<3; j++) // 3 vertexes in triangle
+				e->index.setPoint(3*i+j, e->triangles[i]->vertex[j][0], e->triangles[i]->vertex[j][1], e->triangles[i]->vertex[j][2]);
+		e->index.commit();
+	}
+	return e;
+}
+
+void Renderer_gl1::cleanPickIndex()
+{
+	foreach (PickIndexEntry* e, pickIndexes)  delete e;
+	pickIndexes.clear();
+}
+
 double Renderer_gl1::computeSurfaceArea(int dc, int st, int index) //index is 1-based
 {
 	qDebug("  Renderer_gl1::computeSurfaceArea");
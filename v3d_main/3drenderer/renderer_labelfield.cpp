@@ -42,6 +42,7 @@ Peng, H, Ruan, Z., Atasoy, D., and Sternson, S. (2010) “Automatic reconstructi
 #include "renderer_gl1.h"
 
 #include "marchingcubes.cpp"
+#include "labelmarchingcubes.h"
 
 
 ////////////////////////////////////////////////////
@@ -288,6 +289,101 @@ float _labelSampleFunc(float fX, float fY, float fZ)
 	return (count*255);
 }
 
+// marches blocks of the label field until none is left
+class LabelBlockTask : public QRunnable
+{
+public:
+	LabelBlockTask(const LabelMarchingCubes& mc, std::vector<LabelMeshBlock>& blocks, std::vector<char>& done,
+			QMutex& mutex, QWaitCondition& finished, QAtomicInt& next)
+		: mc(mc), blocks(blocks), done(done), mutex(mutex), finished(finished), next(next)
+	{}
+
+	void run()
+	{
+		for (;;)
+		{
+			int b = next.fetchAndAddOrdered(1);
+			if (b >= mc.blockCount())  return;
+			mc.marchBlock(b, blocks[b]);
+
+			QMutexLocker locker(&mutex);
+			done[b] = 1;
+			finished.wakeAll();
+		}
+	}
+
+protected:
+	const LabelMarchingCubes& mc;
+	std::vector<LabelMeshBlock>& blocks;
+	std::vector<char>& done;
+	QMutex& mutex;
+	QWaitCondition& finished;
+	QAtomicInt& next;
+};
+
+// all the groups of mc in one pass, the blocks are marched by the thread pool and merged into meshes as they finish
+static void _marchLabelGroups(LabelMarchingCubes& mc, std::vector<LabelMesh>& meshes,
+		QProgressDialog& progress, int percent0, int percent1)
+{
+	int nb = mc.blockCount();
+	std::vector<LabelMeshBlock> blocks(nb);
+	std::vector<char> done(nb, 0);
+	QMutex mutex;
+	QWaitCondition finished;
+	QAtomicInt next(0);
+
+	int n_thread = MAX(1, MIN(QThread::idealThreadCount(), nb));
+	QThreadPool pool;
+	pool.setMaxThreadCount(n_thread);
+	for (int t=0; t<n_thread; t++)
+		pool.start(new LabelBlockTask(mc, blocks, done, mutex, finished, next));
+
+	// in block order, so the meshes do not depend on the threads
+	QTime qtime;
+	qtime.start();
+	for (int b=0; b<nb; b++)
+	{
+		mutex.lock();
+		while (! done[b])  finished.wait(&mutex);
+		mutex.unlock();
+
+		mc.merge(blocks[b], meshes);
+		blocks[b] = LabelMeshBlock();
+		if (qtime.elapsed() > 200)
+		{
+			PROGRESS_TEXT( QObject::tr("Creating geometric data: block %1 of %2").arg(b+1).arg(nb) );
+			PROGRESS_PERCENT(percent0 + (percent1-percent0)*(b+1)/nb);
+			qtime.restart();
+		}
+	}
+	pool.waitForDone();
+}
+
+// triangle list of an indexed mesh, with the scale restored as for MarchingCubes
+static Triangle* _labelMeshTriangles(const LabelMesh& m, float sx, float sy, float sz)
+{
+	Triangle* pT0 = NULL;
+	Triangle* pT1 = NULL;
+	for (V3DLONG t=0; t<m.triangleCount(); t++)
+	{
+		Triangle* p = new Triangle;
+		p->next = NULL;
+		for (int iCorner = 0; iCorner < 3; iCorner++)
+		{
+			unsigned int v = m.index[3*t+iCorner];
+			p->vertex[iCorner][0] = m.vertex[3*v]   * sx;
+			p->vertex[iCorner][1] = m.vertex[3*v+1] * sy;
+			p->vertex[iCorner][2] = m.vertex[3*v+2] * sz;
+			p->normal[iCorner][0] = m.normal[3*v];
+			p->normal[iCorner][1] = m.normal[3*v+1];
+			p->normal[iCorner][2] = m.normal[3*v+2];
+		}
+		if (pT1 == NULL)  pT0 = pT1 = p;
+		else  {pT1->next = p;  pT1 = p;}
+	}
+	return pT0;
+}
+
 void Renderer_gl1::constructLabelfieldSurf(int mesh_method, int mesh_density)
 {
 	qDebug("    Renderer_gl1::constructLabelfieldSurf");
@@ -337,6 +433,8 @@ void Renderer_gl1::constructLabelfieldSurf(int mesh_method, int mesh_density)
     {
 		qDebug("-------------------------------------------------------");
         unsigned V3DLONG count = 0;
+		QSet<int> labels; // instead of searching listLabelSurf for every voxel
+		for (i=0; i<listLabelSurf.size(); i++)  labels.insert(listLabelSurf.at(i).label);
 		{
             for (V3DLONG z=0; z<lf_sz2; z++)
 			{
@@ -357,7 +455,7 @@ void Renderer_gl1::constructLabelfieldSurf(int mesh_method, int mesh_density)
 					S.on = true; //090406
 					//S.color;
 
-					if (label>0  &&  ! listLabelSurf.contains(S))
+					if (label>0  &&  ! labels.contains(label))
 					{
 //						//always generate a sorted list. by PHC, 090222  // 090427 RZC: replaced by qSort
 //						bool b_insert=false;
@@ -370,6 +468,7 @@ void Renderer_gl1::constructLabelfieldSurf(int mesh_method, int mesh_density)
 //						}
 //						if (b_insert==false)
 							listLabelSurf.append(S);
+						labels.insert(label);
 						count++;
 					}
 				}
@@ -408,6 +507,43 @@ void Renderer_gl1::constructLabelfieldSurf(int mesh_method, int mesh_density)
 
     V3DLONG f_num = 0;
     V3DLONG num_surf = listLabelSurf.size();
+	if (mesh_method==0) // marching cubes of all the groups in one pass, see labelmarchingcubes.h
+	{
+		std::vector< std::pair<float,float> > groups;
+		for (i=0; i<num_surf; i++)
+			groups.push_back(std::make_pair(float(listLabelSurf.at(i).label), float(listLabelSurf.at(i).label2)));
+		int datatype = (lf_mask==0xff)? 1 : (lf_mask==0xffff)? 2 : 4;
+
+		std::vector<LabelMesh> meshes(num_surf);
+		LabelMarchingCubes mc(lf_data_ch, datatype, lf_sz0, lf_sz1, lf_sz2, mesh_density, groups);
+		if (! mc.groupsOverlap())
+		{
+			PROGRESS_TEXT( QObject::tr("Creating geometric data of %1 groups/labels").arg(num_surf) );
+			_marchLabelGroups(mc, meshes, progress, 1, 90);
+		}
+		else for (i=0; i<num_surf; i++) // overlapped ranges, one pass per group
+		{
+			PROGRESS_TEXT( QObject::tr("Creating geometric group/label %1 of %2").arg(i+1).arg(num_surf) );
+			std::vector<LabelMesh> one(1);
+			LabelMarchingCubes mc1(lf_data_ch, datatype, lf_sz0, lf_sz1, lf_sz2, mesh_density,
+					std::vector< std::pair<float,float> >(1, groups[i]));
+			_marchLabelGroups(mc1, one, progress, 1+i*89/num_surf, 1+(i+1)*89/num_surf);
+			meshes[i].vertex.swap(one[0].vertex);
+			meshes[i].normal.swap(one[0].normal);
+			meshes[i].index.swap(one[0].index);
+		}
+
+		for (i=0; i<num_surf; i++)
+		{
+			V3DLONG t_num = meshes[i].triangleCount();
+			qDebug("		#%d label(%d-%d) triangle num = %d", i, listLabelSurf.at(i).label, listLabelSurf.at(i).label2, t_num);
+
+			list_listTriangle.append(_labelMeshTriangles(meshes[i], lf_sz0, lf_sz1, lf_sz2));
+			meshes[i] = LabelMesh();
+			f_num += t_num;
+		}
+	}
+	else // marching tetrahedrons, one pass per group
     for (i=0; i<num_surf; i++)
 	{
         V3DLONG t_num = 0;
@@ -527,6 +663,7 @@ void Renderer_gl1::cleanLabelfieldSurf()
 		delTriangles(list_listTriangle[i]);
 	}
 	list_listTriangle.clear();
+	cleanPickIndex(); // of the deleted triangles
 
     for (V3DLONG i=0; i<list_glistLabel.size(); i++)
 	{
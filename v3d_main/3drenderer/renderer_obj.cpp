@@ -811,6 +811,8 @@ void Renderer_gl1::cleanObj()
 	glistTube=glistTubeEnd = 0;
 	// label field
 	cleanLabelfieldSurf();
+	cleanPickIndex();
+	cleanNeuronBuffer();
 }
 void Renderer_gl1::updateBoundingBox()
 {
@@ -2192,6 +2194,37 @@ void Renderer_gl1::setColorByAncestry(NeuronSWC s, time_t seconds){
 void Renderer_gl1::initColorMaps(){}
 
 
+void Renderer_gl1::neuronNodeColor(const NeuronSWC & S1, const RGBA8 & rgba, bool editable, GLubyte neuronColor[3])
+{
+	if (rgba.a==0 || editable) //make the skeleton be able to use the default color by adjusting alpha value
+	{
+		int type = S1.type; 			 // 090925
+		if (editable)
+		{
+			int ncolorused = neuron_type_color_num; if (neuron_type_color_num>19) ncolorused = 19; //added by PHC, 20120330
+			type = S1.seg_id %(ncolorused -5)+5; //090829, 091027 RZC: segment color using hanchuan's neuron_type_color
+		}
+		if (type >= 300 && type <= 555 )  // heat colormap index starts from 300 , for sequencial feature scalar visaulziation
+		{
+			neuronColor[0] =  neuron_type_color_heat[ type - 300][0];
+			neuronColor[1] =  neuron_type_color_heat[ type - 300][1];
+			neuronColor[2] =  neuron_type_color_heat[ type - 300][2];
+		}
+		else
+		{
+			neuronColor[0] =  neuron_type_color[ (type>=0 && type<neuron_type_color_num)? type : 0 ][0];
+			neuronColor[1] =  neuron_type_color[ (type>=0 && type<neuron_type_color_num)? type : 0 ][1];
+			neuronColor[2] =  neuron_type_color[ (type>=0 && type<neuron_type_color_num)? type : 0 ][2];
+		}
+	}
+	else
+	{
+		neuronColor[0] = rgba.c[0];
+		neuronColor[1] = rgba.c[1];
+		neuronColor[2] = rgba.c[2];
+	}
+}
+
 void Renderer_gl1::drawNeuronTree(int index)
 {
 	if (listNeuronTree.size() <1)  return;
@@ -2211,6 +2244,7 @@ void Renderer_gl1::drawNeuronTree(int index)
      // for neuron color: same as neuron label color (ZJL)
      GLubyte neuronColor[3];
 	if (! on) return;
+	if (drawNeuronTreeBuffer(index, cur_lineType)) return; // packed vertex buffer, see renderer_tube.cpp
     time_t seconds = time(NULL);
 //  for debug ////////////////////////////
 //	if (listNeuron.size()<=0) return;
@@ -2259,35 +2293,8 @@ void Renderer_gl1::drawNeuronTree(int index)
 		{
 			//qDebug("%i-%i  (%g %g %g) - (%g %g %g)", i,j,  S1.x,S1.y,S1.z, S0.x,S0.y,S0.z);
 			//if (rgba.a==0 || lineType==1)
-			if (rgba.a==0 || editable) //make the skeleton be able to use the default color by adjusting alpha value
-			{
-				int type = S1.type; 			 // 090925
-				if (editable)
-				{
-					int ncolorused = neuron_type_color_num; if (neuron_type_color_num>19) ncolorused = 19; //added by PHC, 20120330
-					type = S1.seg_id %(ncolorused -5)+5; //090829, 091027 RZC: segment color using hanchuan's neuron_type_color
-				}
-				if (type >= 300 && type <= 555 )  // heat colormap index starts from 300 , for sequencial feature scalar visaulziation
-				{
-					neuronColor[0] =  neuron_type_color_heat[ type - 300][0];
-					neuronColor[1] =  neuron_type_color_heat[ type - 300][1];
-					neuronColor[2] =  neuron_type_color_heat[ type - 300][2];
-				} 
-				else
-				{
-					neuronColor[0] =  neuron_type_color[ (type>=0 && type<neuron_type_color_num)? type : 0 ][0];
-					neuronColor[1] =  neuron_type_color[ (type>=0 && type<neuron_type_color_num)? type : 0 ][1];
-					neuronColor[2] =  neuron_type_color[ (type>=0 && type<neuron_type_color_num)? type : 0 ][2];
-				}
-				glColor3ubv(neuronColor); // 081230, 090331
-			}
-			else
-			{
-				glColor3ubv(rgba.c);
-				neuronColor[0] = rgba.c[0];
-				neuronColor[1] = rgba.c[1];
-				neuronColor[2] = rgba.c[2];
-			}
+			neuronNodeColor(S1, rgba, editable, neuronColor);
+			glColor3ubv(neuronColor); // 081230, 090331
 			// (0,0,0)--(0,0,1) ==> S0--S1
 			XYZ D = S0 - S1;
 			float length = norm(D);
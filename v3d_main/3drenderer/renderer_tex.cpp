@@ -276,7 +276,7 @@ void Renderer_gl1::setupData(void* idep)
                }
 
                total_rgbaBuf = rgbaBuf = 0; //(RGBA*)-1; //test whether the new sets pointer to 0 when failed
-               if (data4dp && size4>0)
+               if (data4dp && size4>0 && (tryTexStream != TEX_STREAM_BRICK || isSimulatedData)) // bricks are converted by rgbaSource
                {
                     // only RGB, first 3 channels of original image
                     total_rgbaBuf = rgbaBuf = new RGBA8[ bufSize[0] * bufSize[1] * bufSize[2] * 1 * bufSize[4] ];
@@ -309,6 +309,15 @@ void Renderer_gl1::setupData(void* idep)
 					start1, start2, start3, start4,
 					size1, size2, size3, size4,
 					total_rgbaBuf, bufSize);
+                    rgbaSource.setup(img4dp, dim5, start1, start2, start3, size4);
+
+                    rgbaVmin.resize(image4d->getCDim());
+                    rgbaVmax.resize(image4d->getCDim());
+                    for (int c=0; c<rgbaVmin.size(); c++)
+                    {
+                         rgbaVmin[c] = image4d->p_vmin[c];
+                         rgbaVmax[c] = image4d->p_vmax[c];
+                    }
                }
 #else // then _idep==0
                data4dp_to_rgba3d(data4dp,
@@ -347,6 +356,57 @@ void Renderer_gl1::cleanData()
 	rgbaBuf = 0;
 	DELETE_AND_ZERO(rgbaBuf_Yzx);
 	DELETE_AND_ZERO(rgbaBuf_Xzy);
+	rgbaSource.clear();
+	rgbaVmin.clear();
+	rgbaVmax.clear();
+}
+
+bool Renderer_gl1::updateDataChannels()
+{
+#ifndef test_main_cpp
+	// the image data must be the same as in setupData, only the display range of some channels changed
+	if ((! total_rgbaBuf && ! rgbaSource.ready()) || ! _idep || dim4<1)  return false;
+
+	My4DImage* image4d = v3dr_getImage4d(_idep);
+	if (! image4d
+		|| image4d->getRawData() != data4dp
+		|| image4d->getUnitBytes() != data_unitbytes
+		|| image4d->getXDim() != dim1 || image4d->getYDim() != dim2 || image4d->getZDim() != dim3
+		|| image4d->getCDim() != rgbaVmin.size())
+		return false;
+
+	int channelMask = 0;
+	for (int c=0; c<rgbaVmin.size(); c++)
+	{
+		if (image4d->p_vmin[c] != rgbaVmin[c] || image4d->p_vmax[c] != rgbaVmax[c])
+			if (c % dim4 < 4)  channelMask |= 1<<(c % dim4);
+	}
+	if (! channelMask)  return true;
+
+	QTime qtime;  qtime.start();
+	{
+		Image4DProxy<Image4DSimple> img4dp( image4d );
+		img4dp.set_minmax(image4d->p_vmin, image4d->p_vmax);
+
+		data4dp_to_rgba3d(img4dp,  dim5,
+				start1, start2, start3, start4,
+				size1, size2, size3, size4,
+				total_rgbaBuf, bufSize, channelMask);
+		rgbaSource.setup(img4dp, dim5, start1, start2, start3, size4);
+
+		if (dim4==1)   rgba3d_r2gray(total_rgbaBuf, bufSize);
+
+		for (int c=0; c<rgbaVmin.size(); c++)
+		{
+			rgbaVmin[c] = image4d->p_vmin[c];
+			rgbaVmax[c] = image4d->p_vmax[c];
+		}
+	}
+	qDebug("   Renderer_gl1::updateDataChannels (mask 0x%x) ......................... cost time = %g sec", channelMask, qtime.elapsed()*0.001);
+	return true;
+#else
+	return false;
+#endif
 }
 
 
@@ -1004,6 +1064,7 @@ void Renderer_gl1::cleanVol()
 		glDeleteTextures(1, &texFslice);
 		texFslice = 0;
 	}
+	cleanBrickTexture();
 
 	texture_format = image_format = image_type = -1;
 	imageX = imageY = imageZ = imageT = 0;
@@ -1020,7 +1081,7 @@ void Renderer_gl1::loadVol()
 	qDebug("  Renderer_gl1::loadVol");
 	makeCurrent(); //ensure right context when multiple views animation or mouse drop, 081105
 
-	if (! rgbaBuf || bufSize[3]<1 ) return; // no image data, 081002
+	if ((! rgbaBuf && ! rgbaSource.ready()) || bufSize[3]<1 ) return; // no image data, 081002
 
 	////////////////////////////////////////////////////////////////
 	// set coordinate frame size
@@ -1046,7 +1107,7 @@ void Renderer_gl1::loadVol()
         qDebug()<< QString("	EXT_texture3D (or OpenGL 2.0)         %1 supported ").arg(ok?"":"NOT");
 
 	if ( !(ok = supported_TexStream()) )
-		if (tryTexStream != -1)
+		if (tryTexStream != -1 && tryTexStream != TEX_STREAM_BRICK)
 			tryTexStream = 0;
         qDebug()<< QString("	texture stream (need PBO and GLSL)    %1 supported ").arg(ok?"":"NOT");
 
@@ -1058,7 +1119,45 @@ void Renderer_gl1::loadVol()
 	{
 		//tryTex3D = 1; 			qDebug("	Turn on tryTex3D for Time series");
 		tryTexCompress = 0;		qDebug("		Turn off tryTexCompress for time series");
-		tryTexStream = 0;		qDebug("		Turn off tryTexStream for time series");
+		if (tryTexStream != TEX_STREAM_BRICK) //bricks are reloaded at each time point
+		{
+			tryTexStream = 0;		qDebug("		Turn off tryTexStream for time series");
+		}
+	}
+	if (tryTexStream == TEX_STREAM_BRICK && !supported_Tex3D())
+	{
+		tryTexStream = -1;		qDebug("		Turn off bricked texture (need 3D texture), use full resolution resident texture");
+	}
+	if (tryTexStream == TEX_STREAM_BRICK) //bricks are uploaded with TexImage3D at each LOD change
+	{
+		tryTexCompress = 0;		qDebug("		Turn off tryTexCompress for bricked texture");
+	}
+
+	if (tryTexStream == TEX_STREAM_BRICK && rgbaSource.ready()) //bricks are converted from the image, no RGBA copy is kept
+	{
+		DELETE_AND_ZERO(total_rgbaBuf);
+		rgbaBuf = 0;
+	}
+	else if (! total_rgbaBuf) //switched from the bricked texture, convert the whole image again
+	{
+		try
+		{
+			V3DLONG sizeXYZ = V3DLONG(imageX)*imageY*imageZ;
+			total_rgbaBuf = new RGBA8[sizeXYZ * imageT];
+			for (int t=0; t<imageT; t++)
+			{
+				rgbaSource.setTimepoint(t);
+				rgbaSource.convertBox(0,imageX, 0,imageY, 0,imageZ, total_rgbaBuf + t*sizeXYZ);
+			}
+			rgbaBuf = total_rgbaBuf;
+		}
+		catch (...)
+		{
+			qDebug("	Fail to allocate the RGBA buffer of %dx%dx%d_%d", imageX, imageY, imageZ, imageT);
+			DELETE_AND_ZERO(total_rgbaBuf);
+			rgbaBuf = 0;
+			return;
+		}
 	}
 
 //	// comment for easy test on small volume
@@ -1091,12 +1190,17 @@ void Renderer_gl1::loadVol()
 	qDebug("   sampleScale = %gx%gx%g""   sampledImage = %dx%dx%d""   fillTexture = %dx%dx%d",
 			sampleScaleX, sampleScaleY, sampleScaleZ,  imageX, imageY, imageZ,  fillX, fillY, fillZ);
 
-	if (tryTex3D && supported_Tex3D())
+	if (tryTexStream == TEX_STREAM_BRICK)
+	{
+            qDebug() << "Renderer_gl1::loadVol() - creating bricked 3D texture\n";
+		setupBrickTexture(); // bricks are uploaded while drawing, nearest first
+	}
+	else if (tryTex3D && supported_Tex3D())
 	{
             qDebug() << "Renderer_gl1::loadVol() - creating 3D texture ID\n";
 		glGenTextures(1, &tex3D);		//qDebug("	tex3D = %u", tex3D);
 	}
-	if (!tex3D || tryTexStream !=0) //stream = -1/1/2
+	if (!_brickTex_ready() && (!tex3D || tryTexStream !=0)) //stream = -1/1/2
 	{
 		//tryTex3D = 0; //091015: no need, because tex3D & tex_stream_buffer is not related now.
 
@@ -1163,18 +1267,20 @@ void Renderer_gl1::loadVol()
 void Renderer_gl1::subloadTex(V3DLONG timepoint, bool bfirst)
 {
 	if (texture_format==-1)  return; // not done by loadVol
-	if (! rgbaBuf || bufSize[3]<1 ) return; // no image data, 081002
+	if ((! rgbaBuf && ! _brickTex_ready()) || bufSize[3]<1 ) return; // no image data, 081002
 
 	QTime qtime;  qtime.start();
 	{
 		timepoint = CLAMP(0, imageT-1, timepoint);
-		rgbaBuf = total_rgbaBuf + timepoint*(imageZ*imageY*imageX);
+		if (total_rgbaBuf)
+			rgbaBuf = total_rgbaBuf + timepoint*(imageZ*imageY*imageX);
+		rgbaSource.setTimepoint(timepoint);
 
           qDebug() << "Calling setupStackTexture() from Renderer_gl1::subloadTex()";
 		//if (tryTexStream<=0) 			// 091014: mix down-sampled & streamed method
 			setupStackTexture(bfirst);  // use a temporary buffer, so first
 
-		if (tryTexStream >0 && bfirst)
+		if (tryTexStream >0 && tryTexStream != TEX_STREAM_BRICK && bfirst)
 		{
 			setupTexStreamBuffer();
 		}
@@ -1326,6 +1432,12 @@ void Renderer_gl1::setupStackTexture(bool bfirst)
 	//090802: seems glSubImage conflicts against all compression texture2D, and large compression texture3D
 	////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+	if (_brickTex_ready()) // no full copy of the volume: bricks are converted from the image while drawing
+	{
+		invalidateBrickTexture();
+		return;
+	}
+
 	RGBA8* tex3DBuf = NULL;
 	if (tryTexStream == -1) //091016
 	{
@@ -1596,6 +1708,14 @@ void Renderer_gl1::_drawStack( double ts, double th, double tw,
 
 void Renderer_gl1::drawStackZ(float direction, int section, bool t3d, bool stream)
 {
+	if (_brickTex_ready())
+	{
+		glPushName(vsZslice);
+		drawBrickStack(1, direction, section);
+		glPopName();
+		return;
+	}
+
 	double ts = double(realZ) /fillZ;
 	double th = double(realY) /fillY;
 	double tw = double(realX) /fillX;
@@ -1619,6 +1739,14 @@ void Renderer_gl1::drawStackZ(float direction, int section, bool t3d, bool strea
 }
 void Renderer_gl1::drawStackY(float direction, int section, bool t3d, bool stream)
 {
+	if (_brickTex_ready())
+	{
+		glPushName(vsYslice);
+		drawBrickStack(2, direction, section);
+		glPopName();
+		return;
+	}
+
 	double ts = double(realY) /fillY;
 	double th = double(realZ) /fillZ;
 	double tw = double(realX) /fillX;
@@ -1642,6 +1770,14 @@ void Renderer_gl1::drawStackY(float direction, int section, bool t3d, bool strea
 }
 void Renderer_gl1::drawStackX(float direction, int section, bool t3d, bool stream)
 {
+	if (_brickTex_ready())
+	{
+		glPushName(vsXslice);
+		drawBrickStack(3, direction, section);
+		glPopName();
+		return;
+	}
+
 	double ts = double(realX) /fillX;
 	double th = double(realZ) /fillZ;
 	double tw = double(realY) /fillY;
@@ -1687,14 +1823,16 @@ void Renderer_gl1::setUnitVolumeSpace()
 
 void Renderer_gl1::drawUnitVolume()
 {
-	if (! rgbaBuf || bufSize[3]<1 ) return; // no image data, 081002
+	if ((! rgbaBuf && ! _brickTex_ready()) || bufSize[3]<1 ) return; // no image data, 081002
 	if ((VOL_X1<VOL_X0) || (VOL_Y1<VOL_Y0) || (VOL_Z1<VOL_Z0)) return; // all clipped, no drawing
 
 	bool b_stream = _streamTex_ready();
-	bool b_tex3d = tex3D>0;
+	bool b_brick = _brickTex_ready();
+	bool b_tex3d = tex3D>0 || b_brick;
 
 	if (b_stream   //091014: for streamed method
-		|| tryTexStream == -1) //091016
+		|| tryTexStream == -1 //091016
+		|| b_brick)
 	{
             //qDebug() << "Renderer_gl1::drawUnitVolume() - setting realX,Y,Z to imageX,Y,Z   b_stream=" << b_stream << " tryTexStream=" << tryTexStream;
 		realX = imageX;
@@ -1734,6 +1872,9 @@ void Renderer_gl1::drawUnitVolume()
 	glLoadIdentity();
 	glMatrixMode(GL_MODELVIEW);
 
+	// select LOD and upload the bricks visible in the current view (under the current GL_MODELVIEW matrix)
+	bool b_brick_pending = b_brick && updateBrickTexture();
+
 	if (b_stream || !b_tex3d)
 	{
 		TEXTURE_UNIT0_3D(false);
@@ -1790,10 +1931,17 @@ void Renderer_gl1::drawUnitVolume()
 	shaderTexEnd();
 
 	BIND_TEXTURE_0();
+
+	// bricks still to be uploaded (or refined): draw again
+	if (b_brick_pending)
+	{
+		V3dR_GLWidget* w = (V3dR_GLWidget*)widget;
+		if (w) w->update();
+	}
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////
-static void _frontSliceFromStack(RGBA8* rgbaBuf, int imageX, int imageY, int imageZ,
+static void _frontSliceFromStack(RGBA8* rgbaBuf, const Rgba3dSource& source, int imageX, int imageY, int imageZ,
 							RGBA8* slice, int copyX, int copyY,
 							XYZ& S0, XYZ& Sx, XYZ& Sy)
 {
@@ -1818,7 +1966,8 @@ static void _frontSliceFromStack(RGBA8* rgbaBuf, int imageX, int imageY, int ima
 
 		if (BETWEENEQ(0,imageX-1,ix) && BETWEENEQ(0,imageY-1,iy) && BETWEENEQ(0,imageZ-1,iz))
 		{
-			slice[oy * (copyX) + ox] = rgbaBuf[iz * (imageY * imageX) + iy * (imageX) + ix];
+			slice[oy * (copyX) + ox] = (rgbaBuf)? rgbaBuf[iz * (imageY * imageX) + iy * (imageX) + ix]
+			                                    : source.voxel(ix, iy, iz); // bricked texture, no RGBA copy
 		}
 	}
 }
@@ -1853,7 +2002,7 @@ void Renderer_gl1::setupFrontSliceBuffer()
 
 void Renderer_gl1::drawUnitFrontSlice(int line)
 {
-	if (!rgbaBuf || bufSize[3]<1 ) return; // no image data, 081231
+	if ((!rgbaBuf && !rgbaSource.ready()) || bufSize[3]<1 ) return; // no image data, 081231
 	if (boundingBox.Dmin()<=1) return; //081231
 
 	if (renderMode==rmCrossSection)
@@ -1950,7 +2099,7 @@ void Renderer_gl1::drawUnitFrontSlice(int line)
 	if (use_tex2D)
 	{
 		// dynamic sampling slice image in unit volume space
-		_frontSliceFromStack(rgbaBuf, imageX, imageY, imageZ,
+		_frontSliceFromStack(rgbaBuf, rgbaSource, imageX, imageY, imageZ,
 							Fslice_data, realF, realF,
 							S0, Sx, Sy);
 
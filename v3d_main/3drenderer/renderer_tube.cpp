@@ -0,0 +1,341 @@
+/*
+ * Copyright (c)2006-2010  Hanchuan Peng (Janelia Farm, Howard Hughes Medical Institute).
+ * All rights reserved.
+ */
+
+
+/************
+                                            ********* LICENSE NOTICE ************
+
+This folder contains all source codes for the V3D project, which is subject to the following conditions if you want to use it.
+
+You will ***have to agree*** the following terms, *before* downloading/using/running/editing/changing any portion of codes in this package.
+
+1. This package is free for non-profit research, but needs a special license for any commercial purpose. Please contact Hanchuan Peng for details.
+
+2. You agree to appropriately cite this work in your related studies and publications.
+
+Peng, H., Ruan, Z., Long, F., Simpson, J.H., and Myers, E.W. (2010) “V3D enables real-time 3D visualization and quantitative analysis of large-scale biological image data sets,” Nature Biotechnology, Vol. 28, No. 4, pp. 348-353, DOI: 10.1038/nbt.1612. ( http://penglab.janelia.org/papersall/docpdf/2010_NBT_V3D.pdf )
+
+Peng, H, Ruan, Z., Atasoy, D., and Sternson, S. (2010) “Automatic reconstruction of 3D neuron structures using a graph-augmented deformable model,” Bioinformatics, Vol. 26, pp. i38-i46, 2010. ( http://penglab.janelia.org/papersall/docpdf/2010_Bioinfo_GD_ISMB2010.pdf )
+
+3. This software is provided by the copyright holders (Hanchuan Peng), Howard Hughes Medical Institute, Janelia Farm Research Campus, and contributors "as is" and any express or implied warranties, including, but not limited to, any implied warranties of merchantability, non-infringement, or fitness for a particular purpose are disclaimed. In no event shall the copyright owner, Howard Hughes Medical Institute, Janelia Farm Research Campus, or contributors be liable for any direct, indirect, incidental, special, exemplary, or consequential damages (including, but not limited to, procurement of substitute goods or services; loss of use, data, or profits; reasonable royalties; or business interruption) however caused and on any theory of liability, whether in contract, strict liability, or tort (including negligence or otherwise) arising in any way out of the use of this software, even if advised of the possibility of such damage.
+
+4. Neither the name of the Howard Hughes Medical Institute, Janelia Farm Research Campus, nor Hanchuan Peng, may be used to endorse or promote products derived from this software without specific prior written permission.
+
+*************/
+
+
+/*
+ *  renderer_tube.cpp
+ *
+ *  Packed vertex buffer path of Renderer_gl1::drawNeuronTree.
+ *
+ *  Each neuron tree is drawn from one buffer of tube instances (or lines), see neurontube.h.
+ *  The tree is synced with its buffer only when its nodes changed: then only the edited nodes are
+ *  patched with glBufferSubData, so the redraw after an edit does not rebuild the tree.
+ *  The tubes and spheres are drawn as instances of one unit mesh by the vertex shader of Renderer_gl2
+ *  (EXT_draw_instanced, the instances in a buffer texture), else node by node as before.
+ *  Distant trees are drawn with less detail: tubes without spheres, then lines when the tubes are
+ *  thinner than a pixel.
+ *  Uses buffer objects (ARB_vertex_buffer_object) when supported, else vertex arrays from client memory.
+ *
+ */
+
+#include "renderer_gl2.h"
+
+#include <QSet>
+
+
+#define TUBE_LOD_SPHERE  4      // pixels, tubes thinner than this are drawn without the spheres
+#define TUBE_LOD_LINE    1      // pixels, tubes thinner than this are drawn as lines
+#define TUBE_UPLOAD_CHUNK  65536  // instances packed at once for an upload
+
+
+static void _deleteNeuronBuffer(NeuronTubeBuffer* buf)
+{
+	if (buf->vbo[0])  glDeleteBuffersARB(1, &buf->vbo[0]);
+	if (buf->vbo[1])  glDeleteBuffersARB(1, &buf->vbo[1]);
+	if (buf->tex)  glDeleteTextures(1, &buf->tex);
+	delete buf;
+}
+
+// level of detail from the projected thickness of the tubes: 0 = tubes and spheres, 1 = tubes, 2 = lines
+static int _neuronTubeLOD(const NeuronTubeMesh& mesh)
+{
+	GLdouble M[16], P[16];
+	GLint viewport[4];
+	glGetDoublev(GL_MODELVIEW_MATRIX, M);
+	glGetDoublev(GL_PROJECTION_MATRIX, P);
+	glGetIntegerv(GL_VIEWPORT, viewport);
+
+	const float* box = mesh.boundingBox();
+	double x0=0, x1=0, y0=0, y1=0;
+	for (int c=0; c<8; c++)
+	{
+		double px, py, w;
+		if (! projectWinXY((c&1)? box[3]:box[0], (c&2)? box[4]:box[1], (c&4)? box[5]:box[2],
+				M, P, viewport, px, py, w) || w <= 0)
+			return 0; // across the eye plane, near
+		if (c==0)  {x0 = x1 = px;  y0 = y1 = py;}
+		else
+		{
+			x0 = qMin(x0, px);  x1 = qMax(x1, px);
+			y0 = qMin(y0, py);  y1 = qMax(y1, py);
+		}
+	}
+	double size = sqrt(double(box[3]-box[0])*(box[3]-box[0]) + (box[4]-box[1])*(box[4]-box[1]) + (box[5]-box[2])*(box[5]-box[2]));
+	if (size <= 0)  return 0;
+
+	double pixels = 2*mesh.meanRadius() * sqrt((x1-x0)*(x1-x0) + (y1-y0)*(y1-y0)) / size;
+	return (pixels < TUBE_LOD_LINE)? 2 : (pixels < TUBE_LOD_SPHERE)? 1 : 0;
+}
+
+// sum of the mixed entries, not depending on the order of the hash
+static quint64 _hashChecksum(const QHash <int, int>& hash)
+{
+	quint64 sum = 0;
+	for (QHash<int, int>::const_iterator it = hash.constBegin(); it != hash.constEnd(); ++it)
+	{
+		quint64 h = (quint64(quint32(it.key())) << 32) | quint32(it.value());
+		h = (h ^ (h >> 33)) * Q_UINT64_C(0xff51afd7ed558ccd); // murmur3 finalizer
+		sum += h ^ (h >> 33);
+	}
+	return sum;
+}
+
+NeuronTubeBuffer * Renderer_gl1::neuronBuffer(int index, int lineType, int & lod)
+{
+	const NeuronTree * ptree = &(listNeuronTree.at(index));
+	if (!neuronBuffers.contains(ptree) && neuronBuffers.size() >= listNeuronTree.size())
+	{
+		// some are of deleted trees
+		QSet<const void*> loaded;
+		for (int i=0; i<listNeuronTree.size(); i++)  loaded.insert(&(listNeuronTree.at(i)));
+		QMutableHashIterator<const void*, NeuronTubeBuffer*> it(neuronBuffers);
+		while (it.hasNext())
+		{
+			it.next();
+			if (loaded.contains(it.key()))  continue;
+			_deleteNeuronBuffer(it.value());
+			it.remove();
+		}
+	}
+	NeuronTubeBuffer*& buf = neuronBuffers[ptree];
+	if (!buf) buf = new NeuronTubeBuffer;
+
+	// the nodes and the hash are checksummed instead of kept, so an unchanged tree is not synced again
+	NeuronTubeMesh& mesh = buf->mesh;
+	const QList <NeuronSWC>& listNeuron = ptree->listNeuron;
+	const QHash <int, int>& hashNeuron = ptree->hashNeuron;
+	NeuronNodesStamp stamp(listNeuron);
+	quint64 hashSum = _hashChecksum(hashNeuron);
+	buf->b_changed = (stamp != buf->stamp || hashNeuron.size() != buf->hashSize || hashSum != buf->hashSum
+			|| ptree->color.i != buf->color.i || ptree->editable != buf->editable);
+	if (buf->b_changed)
+	{
+		// only the changed nodes are repacked
+		mesh.resize(listNeuron.size());
+		for (V3DLONG i=0; i<listNeuron.size(); i++)
+		{
+			const NeuronSWC& S = listNeuron.at(i);
+			V3DLONG parent = -2;
+			if (S.pn == -1)  parent = -1; // root end
+			else if (S.pn >= 0)
+			{
+				int j = hashNeuron.value(S.pn, -1);
+				if (j>=0 && j<listNeuron.size())  parent = j;
+			}
+			GLubyte color[3];
+			neuronNodeColor(S, ptree->color, ptree->editable, color);
+			mesh.setNode(i, S.x, S.y, S.z, S.r, parent, color);
+		}
+		mesh.commit();
+		buf->stamp = stamp;
+		buf->hashSize = hashNeuron.size();
+		buf->hashSum = hashSum;
+		buf->color = ptree->color;
+		buf->editable = ptree->editable;
+		uploadNeuronBuffer(buf);
+	}
+
+	lod = (lineType==0)? _neuronTubeLOD(mesh) : 2;
+	return buf;
+}
+
+void Renderer_gl1::uploadNeuronBuffer(NeuronTubeBuffer * buf)
+{
+	if (! supported_VBO())  return; // drawn from client memory
+	const NeuronTubeMesh& mesh = buf->mesh;
+	V3DLONG n = mesh.size();
+	const std::vector< std::pair<V3DLONG,V3DLONG> >& dirty = mesh.dirtyRanges();
+	V3DLONG lineSlot = 2 * sizeof(NeuronLineVertex);
+	if (! buf->vbo[0])  glGenBuffersARB(1, &buf->vbo[0]);
+
+	// grow with room for appended nodes, else patch the changed nodes
+	glBindBufferARB(GL_ARRAY_BUFFER_ARB, buf->vbo[0]);
+	if (n > buf->lineCapacity)
+	{
+		buf->lineCapacity = qMax(n, buf->lineCapacity*3/2);
+		glBufferDataARB(GL_ARRAY_BUFFER_ARB, buf->lineCapacity*lineSlot, 0, GL_DYNAMIC_DRAW_ARB);
+		glBufferSubDataARB(GL_ARRAY_BUFFER_ARB, 0, n*lineSlot, mesh.lineVertices());
+	}
+	else
+		for (size_t k=0; k<dirty.size(); k++)
+			glBufferSubDataARB(GL_ARRAY_BUFFER_ARB, dirty[k].first*lineSlot, (dirty[k].second-dirty[k].first)*lineSlot,
+					mesh.lineVertices() + 2*dirty[k].first);
+	glBindBufferARB(GL_ARRAY_BUFFER_ARB, 0);
+	CHECK_GLError_print();
+}
+
+bool Renderer_gl1::uploadNeuronInstances(NeuronTubeBuffer * buf)
+{
+	if (! (supported_VBO() && GLEE_EXT_texture_buffer_object && GLEE_ARB_texture_float))  return false;
+	const NeuronTubeMesh& mesh = buf->mesh;
+	V3DLONG n = mesh.size();
+	GLint maxTexels = 0;
+	glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE_EXT, &maxTexels);
+	if (3*n > maxTexels)  return false;
+
+	if (! buf->vbo[1])  glGenBuffersARB(1, &buf->vbo[1]);
+	glBindBufferARB(GL_TEXTURE_BUFFER_EXT, buf->vbo[1]);
+
+	// grow with room for appended nodes, else patch the changed nodes
+	std::vector< std::pair<V3DLONG,V3DLONG> > ranges;
+	if (n > buf->instanceCapacity)
+	{
+		buf->instanceCapacity = qMin(qMax(n, buf->instanceCapacity*3/2), V3DLONG(maxTexels/3));
+		glBufferDataARB(GL_TEXTURE_BUFFER_EXT, buf->instanceCapacity*sizeof(NeuronTubeInstance), 0, GL_DYNAMIC_DRAW_ARB);
+		ranges.push_back(std::make_pair(V3DLONG(0), n));
+	}
+	else if (buf->b_instanceStale)
+		ranges.push_back(std::make_pair(V3DLONG(0), n));
+	else if (buf->b_changed)
+		ranges = mesh.dirtyRanges();
+	buf->b_instanceStale = false;
+
+	// packed by chunks, no copy of all the instances is kept
+	std::vector<NeuronTubeInstance> chunk;
+	for (size_t k=0; k<ranges.size(); k++)
+		for (V3DLONG first=ranges[k].first; first<ranges[k].second; first+=TUBE_UPLOAD_CHUNK)
+		{
+			V3DLONG last = qMin(first+TUBE_UPLOAD_CHUNK, ranges[k].second);
+			chunk.resize(last-first);
+			mesh.packInstances(first, last, &chunk[0]);
+			glBufferSubDataARB(GL_TEXTURE_BUFFER_EXT, first*sizeof(NeuronTubeInstance), (last-first)*sizeof(NeuronTubeInstance), &chunk[0]);
+		}
+	glBindBufferARB(GL_TEXTURE_BUFFER_EXT, 0);
+
+	if (! buf->tex) // the texture follows the buffer when it grows
+	{
+		glGenTextures(1, &buf->tex);
+		glBindTexture(GL_TEXTURE_BUFFER_EXT, buf->tex);
+		glTexBufferEXT(GL_TEXTURE_BUFFER_EXT, GL_RGBA32F_ARB, buf->vbo[1]);
+		glBindTexture(GL_TEXTURE_BUFFER_EXT, 0);
+	}
+	CHECK_GLError_print();
+	return true;
+}
+
+void Renderer_gl1::cleanNeuronBuffer()
+{
+	foreach (NeuronTubeBuffer* buf, neuronBuffers)  _deleteNeuronBuffer(buf);
+	neuronBuffers.clear();
+}
+
+bool Renderer_gl1::drawNeuronTreeBuffer(int index, int cur_lineType)
+{
+	if (cur_lineType!=0 && cur_lineType!=1)  return false;
+	if (cur_lineType==1)
+	{
+		if (neuronColorMode != 0)  return false; // colored by ancestry or review state, see setNeuronColor
+		if (selectMode == Renderer::smCurveEditExtendOneNode || selectMode == Renderer::smCurveEditExtendTwoNode ||
+			selectMode == Renderer::smJoinTwoNodes || selectMode == Renderer::smHighlightChildren)
+			return false; // highlighted nodes
+	}
+
+	int lod;
+	NeuronTubeBuffer* buf = neuronBuffer(index, cur_lineType, lod);
+	const NeuronTubeMesh& mesh = buf->mesh;
+	V3DLONG n = mesh.size();
+	if (n < 1)  return true;
+	if (lod < 2 && drawNeuronTubeInstances(buf, lod))  return true;
+	if (buf->b_changed)  buf->b_instanceStale = true;
+	if (lod < 2)  return false; // drawn node by node without instancing
+
+	bool b_vbo = (buf->vbo[0] != 0);
+	const char* base = (b_vbo)? 0 : (const char*)mesh.lineVertices();
+	glPushAttrib(GL_CURRENT_BIT | GL_LIGHTING_BIT | GL_LINE_BIT | GL_POINT_BIT); // color is undefined after drawing with a color array
+	glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_COLOR_ARRAY);
+	if (b_vbo)  glBindBufferARB(GL_ARRAY_BUFFER_ARB, buf->vbo[0]);
+	glVertexPointer(3, GL_FLOAT, sizeof(NeuronLineVertex), base);
+	glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(NeuronLineVertex), base + 12);
+
+	if (cur_lineType==0)  glDisable(GL_LIGHTING); // level of detail of tubes
+	glLineWidth(lineWidth);
+	glDrawArrays(GL_LINES, 0, 2*n);
+	if (cur_lineType==1 && nodeSize && mesh.nodePointIndex().size())
+	{
+		glPointSize(nodeSize);
+		glDrawElements(GL_POINTS, mesh.nodePointIndex().size(), GL_UNSIGNED_INT, &(mesh.nodePointIndex()[0]));
+	}
+	if (cur_lineType==1 && rootSize && mesh.rootPointIndex().size())
+	{
+		glPointSize(rootSize);
+		glDrawElements(GL_POINTS, mesh.rootPointIndex().size(), GL_UNSIGNED_INT, &(mesh.rootPointIndex()[0]));
+	}
+	if (b_vbo)  glBindBufferARB(GL_ARRAY_BUFFER_ARB, 0);
+	glPopClientAttrib();
+	glPopAttrib();
+	return true;
+}
+
+bool Renderer_gl2::drawNeuronTubeInstances(NeuronTubeBuffer * buf, int lod)
+{
+	if (! shaderTube || b_selecting || ! GLEE_EXT_draw_instanced)  return false;
+	if (! uploadNeuronInstances(buf))  return false;
+	const NeuronTubeMesh& mesh = buf->mesh;
+
+	// the unit mesh is the same for all trees
+	if (! tubeUnitVBO[0])
+	{
+		glGenBuffersARB(2, tubeUnitVBO);
+		glBindBufferARB(GL_ARRAY_BUFFER_ARB, tubeUnitVBO[0]);
+		glBufferDataARB(GL_ARRAY_BUFFER_ARB, 4*sizeof(float)*mesh.unitVertexCount(), mesh.unitVertices(), GL_STATIC_DRAW_ARB);
+		glBindBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB, tubeUnitVBO[1]);
+		glBufferDataARB(GL_ELEMENT_ARRAY_BUFFER_ARB, sizeof(unsigned int)*(mesh.tubeIndexCount()+mesh.sphereIndexCount()),
+				mesh.unitIndex(), GL_STATIC_DRAW_ARB);
+	}
+
+	GLint program = 0;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &program); // of the surface objects
+	glPushAttrib(GL_TEXTURE_BIT);
+	glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+	glActiveTextureARB(GL_TEXTURE0_ARB);
+	glBindTexture(GL_TEXTURE_BUFFER_EXT, buf->tex);
+	shaderTube->begin(); //must before setUniform
+	shaderTube->setUniform1i("instances", 0); //GL_TEXTURE0
+	shaderTube->setUniform1i("lighting", glIsEnabled(GL_LIGHTING));
+	shaderTube->setUniform3f("lights", glIsEnabled(GL_LIGHT0), glIsEnabled(GL_LIGHT1), glIsEnabled(GL_LIGHT2));
+
+	glBindBufferARB(GL_ARRAY_BUFFER_ARB, tubeUnitVBO[0]);
+	glBindBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB, tubeUnitVBO[1]);
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glVertexPointer(4, GL_FLOAT, 0, 0);
+	glDrawElementsInstancedEXT(GL_TRIANGLES, mesh.tubeIndexCount(), GL_UNSIGNED_INT, 0, mesh.size());
+	if (lod == 0)
+		glDrawElementsInstancedEXT(GL_TRIANGLES, mesh.sphereIndexCount(), GL_UNSIGNED_INT,
+				(const GLvoid*)(sizeof(unsigned int)*mesh.tubeIndexCount()), mesh.size());
+	glBindBufferARB(GL_ARRAY_BUFFER_ARB, 0);
+	glBindBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB, 0);
+
+	shaderTube->end();
+	if (program)  glUseProgram(program);
+	glBindTexture(GL_TEXTURE_BUFFER_EXT, 0);
+	glPopClientAttrib();
+	glPopAttrib();
+	CHECK_GLError_print();
+	return true;
+}
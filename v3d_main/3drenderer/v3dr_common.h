@@ -96,6 +96,12 @@ Peng, H, Ruan, Z., Atasoy, D., and Sternson, S. (2010) ?
 #define IS_LESS_64BIT ((sizeof(void*)<8)? true:false)
 #define IS_FITTED_VOLUME(dim1,dim2,dim3)  (dim1<=LIMIT_VOLX && dim2<=LIMIT_VOLY && dim3<=LIMIT_VOLZ)
 
+// bricked 3D texture (see renderer_brick.cpp)
+#define TEX_STREAM_BRICK  3            //value of tryTexStream: full resolution data -> bricked resident texture
+#define BRICK_SIZE        128          //texels along each side of a full resolution brick texture, i.e. core of BRICK_SIZE-2 voxels plus 1-texel border
+#define BRICK_TEX_BUDGET  (512<<20)    //bytes of texture memory used by resident bricks
+#define BRICK_UPLOAD_STEP (32<<20)     //bytes of brick textures uploaded per frame
+
 #define ANGLE_X0 (15)			//degree
 #define ANGLE_Y0 (360-20)		//degree
 #define ANGLE_Z0 (360-2)		//degree
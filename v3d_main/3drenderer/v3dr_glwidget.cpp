@@ -2459,13 +2459,13 @@ void V3dR_GLWidget::changeVolShadingOption()
 		QCheckBox* qComp  = new QCheckBox(); qComp->setChecked(tex_comp);
 		QCheckBox* qT3D = new QCheckBox(); qT3D->setChecked(tex_3d);
 		QCheckBox* qNPT = new QCheckBox(); qNPT->setChecked(tex_npt);
-		QSpinBox* qStream  = new QSpinBox();  qStream->setRange(-1,2);  qStream->setValue(tex_stream);
+		QSpinBox* qStream  = new QSpinBox();  qStream->setRange(-1, supported_Tex3D()? TEX_STREAM_BRICK : 2);  qStream->setValue(tex_stream);
 		QCheckBox* qShader  = new QCheckBox(); qShader->setChecked(shader);
 
 		qComp->setEnabled(supported_TexCompression());  if (!supported_TexCompression())  qComp->setChecked(0);
 		qT3D->setEnabled(supported_Tex3D());			if (!supported_Tex3D())  qT3D->setChecked(0);
 		qNPT->setEnabled(supported_TexNPT());			if (!supported_TexNPT())  qNPT->setChecked(0);
-														if (!supported_PBO())  qStream->setMaximum(0);
+														if (!supported_PBO())  qStream->setMaximum(supported_Tex3D()? TEX_STREAM_BRICK : 0); // [1],[2] fall back to [0] in loadVol
 		qShader->setEnabled(supported_GL2());			if (!supported_GL2())  qShader->setChecked(0);
 
 		QFormLayout *formLayout = new QFormLayout;
@@ -2476,6 +2476,7 @@ void V3dR_GLWidget::changeVolShadingOption()
 				" [0] -- 512x512x256 Down-sampled data -> Down-sampled Resident texture      \n"
 				" [1] -- Full resolution data -> Adaptive (stream && resident) texture       \n"
 				" [2] -- Full resolution data -> Full resolution Stream texture              \n"
+				" [3] -- Full resolution data -> Bricked 3D texture (LOD, incremental upload)\n"
 				"[-1] -- Full resolution data -> Full resolution Resident texture            \n"
 				"         (prefer checking off '3D Resident texture' for [-1] mode, otherwise\n"
 				"         it may cause crash due to exceeding the limit of your video card!)\n"
@@ -2836,6 +2837,31 @@ void V3dR_GLWidget::updateImageData()
 	POST_updateGL();
 }
 
+void V3dR_GLWidget::updateImageDataChannels()
+{
+	if (! renderer || ! renderer->updateDataChannels()) // image data changed, need re-preparing all
+	{
+		updateImageData();
+		return;
+	}
+
+	PROGRESS_DIALOG( QObject::tr("Updating image channels"), this);
+    if(this->show_progress_bar)
+    {
+        PROGRESS_PERCENT(50);
+    }
+	{
+		renderer->reinitializeVol(renderer->class_version());
+		if (renderer->hasError())	POST_CLOSE(this);
+	}
+    if(this->show_progress_bar)
+    {
+        PROGRESS_PERCENT(100);
+    }
+
+	POST_updateGL();
+}
+
 void V3dR_GLWidget::reloadData()
 {
 
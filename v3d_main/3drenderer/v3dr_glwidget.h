@@ -356,6 +356,7 @@ public slots:
 	virtual void updateWithTriView();
     virtual void updateLandmark();
     virtual void updateImageData();
+    virtual void updateImageDataChannels(); // only the display range of some channels changed
 	virtual void reloadData();
 	virtual void cancelSelect();
 
@@ -32,6 +32,7 @@ Peng, H, Ruan, Z., Atasoy, D., and Sternson, S. (2010) “Automatic reconstructi
  * basic_4dimage.cpp
  * last update: 100819: Hanchuan Peng. use MYLIB only for Llinux and Mac, but not WIN32. FIXME: add VC support later.
  * 20120410: add curFileSuffix check for the potential strcmp crashing. by Hanchuan Peng
+ * 20261017: add the b_mmapRaw option to map a Vaa3D raw file (copy-on-write) instead of reading it
  */
 
 #include "v3d_message.h"
@@ -56,6 +57,11 @@ void Image4DSimple::loadImage(const char* filename)
 }
 
 void Image4DSimple::loadImage(const char* filename, bool b_useMyLib)
+{
+	return this->loadImage(filename, b_useMyLib, false); //default read the whole file into memory
+}
+
+void Image4DSimple::loadImage(const char* filename, bool b_useMyLib, bool b_mmapRaw)
 {
 	cleanExistData(); // note that this variable must be initialized as NULL.
 
@@ -191,7 +197,11 @@ void Image4DSimple::loadImage(const char* filename, bool b_useMyLib)
 	else //then assume it is Hanchuan's Vaa3D RAW format
 	{
 		v3d_msg("The data does not have supported image file suffix, -- now this program assumes it is Vaa3D's RAW format and tries to load it... \n", false);
-		if (loadRaw2Stack(imgSrcFile, data1d, tmp_sz, tmp_datatype))
+		if (b_mmapRaw && loadRaw2Stack_mmap(imgSrcFile, data1d, tmp_sz, tmp_datatype)==0)
+		{
+			p_rawDataReleaser = releaseMappedRawStack; //so that cleanExistData() unmaps instead of delete []
+		}
+		else if (loadRaw2Stack(imgSrcFile, data1d, tmp_sz, tmp_datatype))
 		{
 			printf("The data doesn't look like a correct 4-byte-size Vaa3D's RAW file. Try 2-byte-raw. \n");
 			if (loadRaw2Stack_2byte(imgSrcFile, data1d, tmp_sz, tmp_datatype))
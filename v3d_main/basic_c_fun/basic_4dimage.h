@@ -49,6 +49,7 @@ Peng, H, Ruan, Z., Atasoy, D., and Sternson, S. (2010) “Automatic reconstructi
  * Last edit: 2010-Oct-06. PHC. add the original_x,y,z fields
  * Last edit: 2010-Oct-7. PHC. add a customary void pointer for a unknown struct for parameters passing of plugins
  * Last edit: 2010-Dec-18. PHC. add a valid valid_zslicenum to indicate the reading status of the data
+ * Last edit: 2026-Oct-17. add a releaser function pointer so that data1d can be a memory-mapped raw file instead of a new[] buffer
  *
  *******************************************************************************************
  */
@@ -61,6 +62,8 @@ Peng, H, Ruan, Z., Atasoy, D., and Sternson, S. (2010) “Automatic reconstructi
 #include "v3d_message.h"
 #include <stdio.h>
 
+typedef void (*RawDataReleaseFunc)(unsigned char *); //how to free a data1d buffer which is not allocated by new []
+
 /*!
  * Volume image with dimensions X, Y, Z, and time.
  */
@@ -83,6 +86,7 @@ protected:
 	V3DLONG valid_zslicenum; //indicate how many zslices are usable. This can be used by a plugin program to stream read data
 	V3DLONG prevalid_zslicenum; //indicate previous valid slices loaded before update GUI
 	void * p_customStruct; //a convenient pointer to pass back and forth some useful parameter information for a plugin
+	RawDataReleaseFunc p_rawDataReleaser; //0 when data1d is allocated by new []; otherwise e.g. releaseMappedRawStack() for a memory-mapped raw stack
 
 	void setError( int v ) {b_error = v;}
 
@@ -102,6 +106,7 @@ public:
 
 		origin_x = origin_y = origin_z = 0;
 		p_customStruct = 0;
+		p_rawDataReleaser = 0;
 
 		valid_zslicenum = 0;
 	}
@@ -199,10 +204,17 @@ public:
 
 	void setDatatype(ImagePixelType v) {datatype=v;}
 	void setTimePackType(TimePackType v) {timepacktype=v;}
-	bool setNewRawDataPointer(unsigned char *p) {if (!p) return false; if (data1d) delete []data1d; data1d = p; return true;}
-	void setRawDataPointerToNull() { this->data1d = 0; }
-	void deleteRawDataAndSetPointerToNull() { if (data1d) {delete []data1d; data1d = 0;} }
-	void setRawDataPointer(unsigned char *p) { this->data1d = p; }
+	bool setNewRawDataPointer(unsigned char *p) {if (!p) return false; deleteRawDataAndSetPointerToNull(); data1d = p; return true;}
+	void setRawDataPointerToNull() { this->data1d = 0; p_rawDataReleaser = 0; }
+	void deleteRawDataAndSetPointerToNull()
+	{
+		if (data1d) {if (p_rawDataReleaser) p_rawDataReleaser(data1d); else delete []data1d; data1d = 0;}
+		p_rawDataReleaser = 0;
+	}
+	void setRawDataPointer(unsigned char *p) { this->data1d = p; p_rawDataReleaser = 0; }
+	void setRawDataPointer(unsigned char *p, RawDataReleaseFunc f) { this->data1d = p; p_rawDataReleaser = (p) ? f : 0; }
+	RawDataReleaseFunc getRawDataReleaser() const {return p_rawDataReleaser;}
+	bool isRawDataMapped() const {return (data1d && p_rawDataReleaser) ? true : false;} //if true, do not delete [] the pointer obtained from getRawData()
 
         bool  setValueUINT8(V3DLONG  x,  V3DLONG  y,  V3DLONG z, V3DLONG chanel, v3d_uint8 val)
         {
@@ -388,10 +400,11 @@ public:
 	}
 	const char * getFileName() const { return imgSrcFile; }
 
-    //to call the following 4 functions you must link your project with basic_4dimage.cpp
+    //to call the following 5 functions you must link your project with basic_4dimage.cpp
 	//Normally for the plugin interfaces you don't need to call the following functions
 	void loadImage(const char* filename);
 	void loadImage(const char* filename, bool b_useMylib);
+	void loadImage(const char* filename, bool b_useMylib, bool b_mmapRaw); //b_mmapRaw: map a Vaa3D raw file instead of reading it into memory
     void loadImage_slice(char filename[], bool b_useMyLib, V3DLONG zsliceno);
 	bool saveImage(const char filename[]);
 
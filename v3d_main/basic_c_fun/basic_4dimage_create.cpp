@@ -45,7 +45,7 @@ Peng, H, Ruan, Z., Atasoy, D., and Sternson, S. (2010) “Automatic reconstructi
 bool Image4DSimple::createImage(V3DLONG mysz0, V3DLONG mysz1, V3DLONG mysz2, V3DLONG mysz3, ImagePixelType mytype)
 {
 	if (mysz0<=0 || mysz1<=0 || mysz2<=0 || mysz3<=0) return false; //note that for this sentence I don't change b_error flag
-	if (data1d) {delete []data1d; data1d=0; sz0=0; sz1=0; sz2=0;sz3=0; datatype=V3D_UNKNOWN;}
+	if (data1d) {deleteRawDataAndSetPointerToNull(); sz0=0; sz1=0; sz2=0;sz3=0; datatype=V3D_UNKNOWN;}
 	try //081001
 	{
 		switch (mytype)
@@ -0,0 +1,128 @@
+/*
+ * Copyright (c)2006-2010  Hanchuan Peng (Janelia Farm, Howard Hughes Medical Institute).  
+ * All rights reserved.
+ */
+
+
+/************
+                                            ********* LICENSE NOTICE ************
+
+This folder contains all source codes for the V3D project, which is subject to the following conditions if you want to use it. 
+
+You will ***have to agree*** the following terms, *before* downloading/using/running/editing/changing any portion of codes in this package.
+
+1. This package is free for non-profit research, but needs a special license for any commercial purpose. Please contact Hanchuan Peng for details.
+
+2. You agree to appropriately cite this work in your related studies and publications.
+
+Peng, H., Ruan, Z., Long, F., Simpson, J.H., and Myers, E.W. (2010) “V3D enables real-time 3D visualization and quantitative analysis of large-scale biological image data sets,” Nature Biotechnology, Vol. 28, No. 4, pp. 348-353, DOI: 10.1038/nbt.1612. ( http://penglab.janelia.org/papersall/docpdf/2010_NBT_V3D.pdf )
+
+Peng, H, Ruan, Z., Atasoy, D., and Sternson, S. (2010) “Automatic reconstruction of 3D neuron structures using a graph-augmented deformable model,” Bioinformatics, Vol. 26, pp. i38-i46, 2010. ( http://penglab.janelia.org/papersall/docpdf/2010_Bioinfo_GD_ISMB2010.pdf )
+
+3. This software is provided by the copyright holders (Hanchuan Peng), Howard Hughes Medical Institute, Janelia Farm Research Campus, and contributors "as is" and any express or implied warranties, including, but not limited to, any implied warranties of merchantability, non-infringement, or fitness for a particular purpose are disclaimed. In no event shall the copyright owner, Howard Hughes Medical Institute, Janelia Farm Research Campus, or contributors be liable for any direct, indirect, incidental, special, exemplary, or consequential damages (including, but not limited to, procurement of substitute goods or services; loss of use, data, or profits; reasonable royalties; or business interruption) however caused and on any theory of liability, whether in contract, strict liability, or tort (including negligence or otherwise) arising in any way out of the use of this software, even if advised of the possibility of such damage.
+
+4. Neither the name of the Howard Hughes Medical Institute, Janelia Farm Research Campus, nor Hanchuan Peng, may be used to endorse or promote products derived from this software without specific prior written permission.
+
+*************/
+
+
+//basic_parallel.cpp
+//see basic_parallel.h
+//
+//2026-10-17
+
+#include "basic_parallel.h"
+
+#include <vector>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+int v3d_num_cores()
+{
+#if defined(_WIN32)
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	int n = (int)info.dwNumberOfProcessors;
+#else
+	int n = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+	return (n<1) ? 1 : n;
+}
+
+struct V3dParallelRange
+{
+	v3d_parallel_func f;
+	void * arg;
+	V3DLONG b, e;
+};
+
+#if defined(_WIN32)
+static DWORD WINAPI v3d_parallel_main(LPVOID p)
+{
+	V3dParallelRange * r = (V3dParallelRange *)p;
+	r->f(r->arg, r->b, r->e);
+	return 0;
+}
+#else
+static void * v3d_parallel_main(void * p)
+{
+	V3dParallelRange * r = (V3dParallelRange *)p;
+	r->f(r->arg, r->b, r->e);
+	return 0;
+}
+#endif
+
+void v3d_parallel_for(V3DLONG n, int nThreads, v3d_parallel_func f, void * arg)
+{
+	if (n<=0) return;
+	V3DLONG nt = (nThreads<1) ? 1 : nThreads;
+	if (nt > n) nt = n;
+	if (nt<=1)
+	{
+		f(arg, 0, n);
+		return;
+	}
+
+	std::vector<V3dParallelRange> ranges(nt);
+	for (V3DLONG t=0;t<nt;t++)
+	{
+		ranges[t].f = f;
+		ranges[t].arg = arg;
+		ranges[t].b = n*t/nt;
+		ranges[t].e = n*(t+1)/nt;
+	}
+
+#if defined(_WIN32)
+	std::vector<HANDLE> threads(nt, (HANDLE)0);
+	for (V3DLONG t=1;t<nt;t++)
+	{
+		threads[t] = CreateThread(0, 0, v3d_parallel_main, &ranges[t], 0, 0);
+		if (!threads[t]) f(arg, ranges[t].b, ranges[t].e);
+	}
+	f(arg, ranges[0].b, ranges[0].e);
+	for (V3DLONG t=1;t<nt;t++)
+		if (threads[t]) {WaitForSingleObject(threads[t], INFINITE); CloseHandle(threads[t]);}
+#else
+	std::vector<pthread_t> threads(nt);
+	std::vector<char> started(nt, 0);
+	for (V3DLONG t=1;t<nt;t++)
+	{
+		started[t] = (pthread_create(&threads[t], 0, v3d_parallel_main, &ranges[t])==0);
+		if (!started[t]) f(arg, ranges[t].b, ranges[t].e);
+	}
+	f(arg, ranges[0].b, ranges[0].e);
+	for (V3DLONG t=1;t<nt;t++)
+		if (started[t]) pthread_join(threads[t], 0);
+#endif
+}
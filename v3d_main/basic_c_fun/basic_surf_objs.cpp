@@ -39,6 +39,9 @@ Peng, H, Ruan, Z., Atasoy, D., and Sternson, S. (2010) “Automatic reconstructi
 #include "v3d_message.h"
 
 #include <QString>
+#include <math.h>
+#include <string.h>
+#include <vector>
 
 QList <CellAPO> readAPO_file(const QString& filename)
 {
@@ -285,12 +288,69 @@ bool writeMarker_file(const QString & filename, const QList <ImageMarker> & list
 	return true;
 }
 
+// the numbers of a SWC line are parsed in place. Plain decimal tokens (at most 15 digits, no exponent) give exactly
+// the values of QString::toInt/toFloat (a single correctly rounded division by a power of ten), the other tokens
+// are still converted by QString.
+
+static const double swc_pow10[16] = {1e0,1e1,1e2,1e3,1e4,1e5,1e6,1e7,1e8,1e9,1e10,1e11,1e12,1e13,1e14,1e15};
+
+static bool swc_token_to_double_fast(const char *s, int len, double &v)
+{
+	const char *e = s+len;
+	bool neg = false;
+	if (s<e && (*s=='-' || *s=='+'))  neg = (*s++=='-');
+
+	V3DLONG m = 0;
+	int ndigits = 0, nfrac = 0;
+	const char *d0 = s;
+	for (; s<e && *s>='0' && *s<='9'; s++, ndigits++)  m = m*10 + (*s-'0');
+	if (s==d0 || ndigits>15)  return false;
+	if (s<e && *s=='.')
+	{
+		const char *f0 = ++s;
+		for (; s<e && *s>='0' && *s<='9'; s++, nfrac++)  m = m*10 + (*s-'0');
+		if (s==f0 || ndigits+nfrac>15)  return false;
+	}
+	if (s!=e)  return false;
+
+	v = double(m) / swc_pow10[nfrac];
+	if (neg)  v = -v;
+	return true;
+}
+
+static int swc_token_to_int(const char *s, int len)
+{
+	if (len>99)  len = 99; //as QString::truncate(99) in the former parser
+
+	const char *p = s, *e = s+len;
+	bool neg = false;
+	if (p<e && (*p=='-' || *p=='+'))  neg = (*p++=='-');
+	if (p<e && e-p<=9)
+	{
+		int v = 0;
+		for (; p<e && *p>='0' && *p<='9'; p++)  v = v*10 + (*p-'0');
+		if (p==e)  return (neg)? -v : v;
+	}
+	return QString(QByteArray(s, len)).toInt();
+}
+
+static float swc_token_to_float(const char *s, int len)
+{
+	if (len>99)  len = 99;
+
+	double v;
+	if (swc_token_to_double_fast(s, len, v))  return float(v);
+	return QString(QByteArray(s, len)).toFloat();
+}
+
+static inline bool swc_isspace(char c)  {return c==' ' || c=='\t' || c=='\n' || c=='\v' || c=='\f' || c=='\r';}
+
 NeuronTree readSWC_file(const QString& filename)
 {
 	NeuronTree nt;
     nt.file = QFileInfo(filename).absoluteFilePath();
 	QFile qf(filename);
-	if (! qf.open(QIODevice::ReadOnly | QIODevice::Text))
+	if (! qf.open(QIODevice::ReadOnly))
 	{
 #ifndef DISABLE_V3D_MSG
 		v3d_msg(QString("open file [%1] failed!").arg(filename));
@@ -298,29 +358,48 @@ NeuronTree readSWC_file(const QString& filename)
 		return nt;
 	}
 
+	// the file is parsed in place from a memory map, or from a single read if it cannot be mapped
+	QByteArray qba;
+	const char *data = 0;
+	qint64 size = qf.size();
+	if (size>0)  data = (const char *)qf.map(0, size);
+	if (!data)
+	{
+		qba = qf.readAll();
+		data = qba.constData();
+		size = qba.size();
+	}
+	const char *data_end = data + size;
+
 	int count = 0;
     QList <NeuronSWC> listNeuron;
 	QHash <int, int>  hashNeuron;
-	listNeuron.clear();
-	hashNeuron.clear();
 	QString name = "";
 	QString comment = "";
 
+	V3DLONG nlines = 0;
+	for (const char *p=data; p<data_end && (p=(const char *)memchr(p, '\n', data_end-p)); p++)  nlines++;
+	listNeuron.reserve(nlines+1);
+	hashNeuron.reserve(nlines+1);
+
     qDebug("-------------------------------------------------------");
-    while (! qf.atEnd())
+    for (const char *line=data; line<data_end; )
     {
-        char _buf[1000], *buf;
-        qf.readLine(_buf, sizeof(_buf));
-        for (buf=_buf; (*buf && *buf==' '); buf++); //skip space
+        const char *eol = (const char *)memchr(line, '\n', data_end-line);
+        if (!eol)  eol = data_end;
+        const char *buf = line, *end = eol;
+        line = eol+1;
+        if (end>buf && end[-1]=='\r')  end--; //as the text mode of QFile
+        for (; buf<end && *buf==' '; buf++); //skip space
 
         //  add #name, #comment
-        if (buf[0]=='\0')	continue;
-        if (buf[0]=='#')
+        if (buf==end && eol==data_end)	continue;
+        if (buf<end && buf[0]=='#')
         {
-        	if (buf[1]=='n'&&buf[2]=='a'&&buf[3]=='m'&&buf[4]=='e'&&buf[5]==' ')
-        		name = buf+6;
-        	if (buf[1]=='c'&&buf[2]=='o'&&buf[3]=='m'&&buf[4]=='m'&&buf[5]=='e'&&buf[6]=='n'&&buf[7]=='t'&&buf[8]==' ')
-        		comment = buf+9;
+        	if (end-buf>=6 && strncmp(buf+1, "name ", 5)==0)
+        		name = QString(QByteArray(buf+6, end-(buf+6)));
+        	if (end-buf>=9 && strncmp(buf+1, "comment ", 8)==0)
+        		comment = QString(QByteArray(buf+9, end-(buf+9)));
 
         	continue;
        	}
@@ -328,25 +407,31 @@ NeuronTree readSWC_file(const QString& filename)
         count++;
         NeuronSWC S;
 
-        QStringList qsl = QString(buf).trimmed().split(" ",QString::SkipEmptyParts);
-        if (qsl.size()==0)   continue;
+        //tokens separated by spaces, after trimming the line
+        while (buf<end && swc_isspace(*buf))  buf++;
+        while (end>buf && swc_isspace(end[-1]))  end--;
+        if (buf==end)   continue;
 
-        for (int i=0; i<qsl.size(); i++)
+        for (int i=0; buf<end; i++)
         {
-        	qsl[i].truncate(99);
-        	if (i==0) S.n = qsl[i].toInt();
-        	else if (i==1) S.type = qsl[i].toInt();
-        	else if (i==2) S.x = qsl[i].toFloat();
-        	else if (i==3) S.y = qsl[i].toFloat();
-        	else if (i==4) S.z = qsl[i].toFloat();
-			else if (i==5) S.r = qsl[i].toFloat();
-        	else if (i==6) S.pn = qsl[i].toInt();
+        	const char *tok = buf;
+        	while (buf<end && *buf!=' ')  buf++;
+        	int len = int(buf-tok);
+        	while (buf<end && *buf==' ')  buf++;
+
+        	if (i==0) S.n = swc_token_to_int(tok, len);
+        	else if (i==1) S.type = swc_token_to_int(tok, len);
+        	else if (i==2) S.x = swc_token_to_float(tok, len);
+        	else if (i==3) S.y = swc_token_to_float(tok, len);
+        	else if (i==4) S.z = swc_token_to_float(tok, len);
+			else if (i==5) S.r = swc_token_to_float(tok, len);
+        	else if (i==6) S.pn = swc_token_to_int(tok, len);
             //the ESWC extension, by PHC, 20120217
-        	else if (i==7) S.seg_id = qsl[i].toInt();
-        	else if (i==8) S.level = qsl[i].toInt();
+        	else if (i==7) S.seg_id = swc_token_to_int(tok, len);
+        	else if (i==8) S.level = swc_token_to_int(tok, len);
 	//change ESWC format to adapt to flexible feature number, by WYN, 20150602
         	else 
-		S.fea_val.append(qsl[i].toFloat());
+		S.fea_val.append(swc_token_to_float(tok, len));
        }
 
         //if (! listNeuron.contains(S)) // 081024
@@ -374,6 +459,73 @@ NeuronTree readSWC_file(const QString& filename)
 	return nt;
 }
 
+// buffered output of the node lines of writeSWC_file and writeESWC_file. The numbers are formatted as fprintf
+// does with "%ld" and "%.Nf", and the buffer is written with one fwrite per SWC_WRITE_BUFSIZE bytes.
+#define SWC_WRITE_BUFSIZE  (1<<20)
+
+class SWCWriteBuffer
+{
+public:
+	SWCWriteBuffer(FILE *f) : fp(f), buf(SWC_WRITE_BUFSIZE), len(0) {}
+	~SWCWriteBuffer() {flush();}
+
+	void flush()
+	{
+		if (len)  fwrite(&buf[0], 1, len, fp);
+		len = 0;
+	}
+
+	void putChar(char c)
+	{
+		if (len+1 > buf.size())  flush();
+		buf[len++] = c;
+	}
+
+	void putLong(long v)
+	{
+		char tmp[24];
+		int n = 0;
+		unsigned long u = (v<0)? 0UL-(unsigned long)v : (unsigned long)v;
+		do {tmp[n++] = char('0' + u%10); u /= 10;} while (u);
+		if (v<0)  tmp[n++] = '-';
+		reserve(n);
+		while (n)  buf[len++] = tmp[--n];
+	}
+
+	// "%.<decimals>f" of a float, decimals<=5: v*10^decimals is exact in double, so a round to nearest even
+	// gives the digits of printf
+	void putFixed(float f, int decimals)
+	{
+		double v = f;
+		double x = v * swc_pow10[decimals];
+		if (!(fabs(x) < 9e15))
+		{
+			reserve(400);
+			len += sprintf(&buf[len], "%.*f", decimals, v);
+			return;
+		}
+
+		double ax = fabs(x), fl = floor(ax);
+		V3DLONG r = V3DLONG(fl);
+		if (ax-fl > 0.5 || (ax-fl == 0.5 && (r&1)))  r++;
+		char tmp[32];
+		int n = 0;
+		for (int d=0; d<decimals; d++)  {tmp[n++] = char('0' + r%10); r /= 10;}
+		tmp[n++] = '.';
+		do {tmp[n++] = char('0' + r%10); r /= 10;} while (r);
+		if (v<0 || (v==0 && 1/v<0))  tmp[n++] = '-'; //also "-0.000", as printf
+		reserve(n);
+		while (n)  buf[len++] = tmp[--n];
+	}
+
+private:
+	void reserve(size_t n)  {if (len+n > buf.size())  flush();}
+
+	FILE *fp;
+	std::vector<char> buf;
+	size_t len;
+};
+
 bool writeSWC_file(const QString& filename, const NeuronTree& nt, const QStringList *infostring)
 {
 	QString curFile = filename;
@@ -411,12 +563,20 @@ bool writeSWC_file(const QString& filename, const NeuronTree& nt, const QStringL
     }
     
 	fprintf(fp, "##n,type,x,y,z,radius,parent\n");
-	NeuronSWC * p_pt=0;
-	for (int i=0;i<nt.listNeuron.size(); i++)
 	{
-		p_pt = (NeuronSWC *)(&(nt.listNeuron.at(i)));
-		fprintf(fp, "%ld %d %5.3f %5.3f %5.3f %5.3f %ld\n",
-				p_pt->n, p_pt->type, p_pt->x, p_pt->y, p_pt->z, p_pt->r, p_pt->pn);
+		SWCWriteBuffer out(fp); //"%ld %d %5.3f %5.3f %5.3f %5.3f %ld\n" for each node
+		NeuronSWC * p_pt=0;
+		for (int i=0;i<nt.listNeuron.size(); i++)
+		{
+			p_pt = (NeuronSWC *)(&(nt.listNeuron.at(i)));
+			out.putLong(long(p_pt->n));  out.putChar(' ');
+			out.putLong(p_pt->type);     out.putChar(' ');
+			out.putFixed(p_pt->x, 3);    out.putChar(' ');
+			out.putFixed(p_pt->y, 3);    out.putChar(' ');
+			out.putFixed(p_pt->z, 3);    out.putChar(' ');
+			out.putFixed(p_pt->r, 3);    out.putChar(' ');
+			out.putLong(long(p_pt->pn)); out.putChar('\n');
+		}
 	}
     
 	fclose(fp);
@@ -457,15 +617,28 @@ bool writeESWC_file(const QString& filename, const NeuronTree& nt)
 	fprintf(fp, "#comment %s\n", qPrintable(nt.comment.trimmed()));
     
 	fprintf(fp, "##n,type,x,y,z,radius,parent,seg_id,level,feature_value\n");
-	NeuronSWC * p_pt=0;
-	for (int i=0;i<nt.listNeuron.size(); i++)
-	{
-		p_pt = (NeuronSWC *)(&(nt.listNeuron.at(i)));
-		fprintf(fp, "%ld %d %5.3f %5.3f %5.3f %5.3f %ld %ld %ld",
-				p_pt->n, p_pt->type, p_pt->x, p_pt->y, p_pt->z, p_pt->r, p_pt->pn, p_pt->seg_id, p_pt->level);
-		for (int j=0;j<p_pt->fea_val.size();j++)
-            fprintf(fp, " %.5f", p_pt->fea_val.at(j));
-		fprintf(fp, "\n");
+	{
+		SWCWriteBuffer out(fp); //"%ld %d %5.3f %5.3f %5.3f %5.3f %ld %ld %ld" and " %.5f" for each feature value
+		NeuronSWC * p_pt=0;
+		for (int i=0;i<nt.listNeuron.size(); i++)
+		{
+			p_pt = (NeuronSWC *)(&(nt.listNeuron.at(i)));
+			out.putLong(long(p_pt->n));     out.putChar(' ');
+			out.putLong(p_pt->type);        out.putChar(' ');
+			out.putFixed(p_pt->x, 3);       out.putChar(' ');
+			out.putFixed(p_pt->y, 3);       out.putChar(' ');
+			out.putFixed(p_pt->z, 3);       out.putChar(' ');
+			out.putFixed(p_pt->r, 3);       out.putChar(' ');
+			out.putLong(long(p_pt->pn));    out.putChar(' ');
+			out.putLong(long(p_pt->seg_id)); out.putChar(' ');
+			out.putLong(long(p_pt->level));
+			for (int j=0;j<p_pt->fea_val.size();j++)
+			{
+				out.putChar(' ');
+				out.putFixed(p_pt->fea_val.at(j), 5);
+			}
+			out.putChar('\n');
+		}
 	}
 	fclose(fp);
 #ifndef DISABLE_V3D_MSG
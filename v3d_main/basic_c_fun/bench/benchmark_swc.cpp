@@ -0,0 +1,189 @@
+// Benchmark of the SWC/ESWC reading and writing of basic_surf_objs.cpp (readSWC_file, writeSWC_file, writeESWC_file).
+// A random neuron-like tree is saved and loaded again, and compared with the former line-by-line reader
+// (QFile::readLine, QString::split, QString::toFloat) and the former fprintf writer: the loaded nodes and the
+// written files must be the same.
+//
+// usage: benchmark_swc [nodes [features]]
+
+#include "../basic_surf_objs.h"
+#include <QtCore>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+static double frand(double a, double b)
+{
+    return a + (b - a) * (rand() / (double)RAND_MAX);
+}
+
+static NeuronTree randomTree(long n_nodes, int n_features)
+{
+    NeuronTree nt;
+    nt.name = "benchmark";
+    nt.comment = "random tree";
+    nt.listNeuron.reserve(n_nodes);
+    for(long i=0; i<n_nodes; i++)
+    {
+        NeuronSWC S;
+        S.n = i+1;
+        S.type = 2 + rand()%2;
+        if(i == 0 || rand()%50 == 0)  // a new branch from a random node
+            S.pn = (i == 0) ? -1 : 1 + rand()%i;
+        else
+            S.pn = i;
+        const NeuronSWC *parent = (S.pn > 0) ? &nt.listNeuron.at(S.pn-1) : 0;
+        S.x = parent ? parent->x + frand(-2, 2) : frand(0, 20000);
+        S.y = parent ? parent->y + frand(-2, 2) : frand(0, 20000);
+        S.z = parent ? parent->z + frand(-1, 1) : frand(0, 5000);
+        S.r = frand(0.5, 5);
+        S.seg_id = i/100;
+        S.level = rand()%10;
+        for(int j=0; j<n_features; j++)
+            S.fea_val.append(frand(-100, 100));
+        nt.listNeuron.append(S);
+        nt.hashNeuron.insert(S.n, i);
+    }
+    return nt;
+}
+
+// readSWC_file before the in-place parser
+static NeuronTree readSWC_file_lines(const QString& filename)
+{
+    NeuronTree nt;
+    QFile qf(filename);
+    if (! qf.open(QIODevice::ReadOnly | QIODevice::Text))
+        return nt;
+
+    while (! qf.atEnd())
+    {
+        char _buf[1000], *buf;
+        qf.readLine(_buf, sizeof(_buf));
+        for (buf=_buf; (*buf && *buf==' '); buf++); //skip space
+
+        if (buf[0]=='\0')	continue;
+        if (buf[0]=='#')
+        {
+            if (buf[1]=='n'&&buf[2]=='a'&&buf[3]=='m'&&buf[4]=='e'&&buf[5]==' ')
+                nt.name = QString(buf+6).remove('\n');
+            if (buf[1]=='c'&&buf[2]=='o'&&buf[3]=='m'&&buf[4]=='m'&&buf[5]=='e'&&buf[6]=='n'&&buf[7]=='t'&&buf[8]==' ')
+                nt.comment = QString(buf+9).remove('\n');
+            continue;
+        }
+
+        NeuronSWC S;
+        QStringList qsl = QString(buf).trimmed().split(" ",QString::SkipEmptyParts);
+        if (qsl.size()==0)   continue;
+
+        for (int i=0; i<qsl.size(); i++)
+        {
+            qsl[i].truncate(99);
+            if (i==0) S.n = qsl[i].toInt();
+            else if (i==1) S.type = qsl[i].toInt();
+            else if (i==2) S.x = qsl[i].toFloat();
+            else if (i==3) S.y = qsl[i].toFloat();
+            else if (i==4) S.z = qsl[i].toFloat();
+            else if (i==5) S.r = qsl[i].toFloat();
+            else if (i==6) S.pn = qsl[i].toInt();
+            else if (i==7) S.seg_id = qsl[i].toInt();
+            else if (i==8) S.level = qsl[i].toInt();
+            else S.fea_val.append(qsl[i].toFloat());
+        }
+        nt.listNeuron.append(S);
+        nt.hashNeuron.insert(S.n, nt.listNeuron.size()-1);
+    }
+    return nt;
+}
+
+// writeESWC_file before the buffered output
+static bool writeESWC_file_fprintf(const QString& filename, const NeuronTree& nt)
+{
+    FILE * fp = fopen(filename.toLatin1(), "wt");
+    if (!fp)
+        return false;
+
+    fprintf(fp, "#name %s\n", qPrintable(nt.name.trimmed()));
+    fprintf(fp, "#comment %s\n", qPrintable(nt.comment.trimmed()));
+    fprintf(fp, "##n,type,x,y,z,radius,parent,seg_id,level,feature_value\n");
+    for (int i=0;i<nt.listNeuron.size(); i++)
+    {
+        const NeuronSWC * p_pt = &(nt.listNeuron.at(i));
+        fprintf(fp, "%ld %d %5.3f %5.3f %5.3f %5.3f %ld %ld %ld",
+                p_pt->n, p_pt->type, p_pt->x, p_pt->y, p_pt->z, p_pt->r, p_pt->pn, p_pt->seg_id, p_pt->level);
+        for (int j=0;j<p_pt->fea_val.size();j++)
+            fprintf(fp, " %.5f", p_pt->fea_val.at(j));
+        fprintf(fp, "\n");
+    }
+    fclose(fp);
+    return true;
+}
+
+static bool sameNodes(const NeuronTree& a, const NeuronTree& b)
+{
+    if (a.listNeuron.size() != b.listNeuron.size() || a.name != b.name || a.comment != b.comment)
+        return false;
+    for (int i=0; i<a.listNeuron.size(); i++)
+    {
+        const NeuronSWC &p = a.listNeuron.at(i), &q = b.listNeuron.at(i);
+        if (p.n != q.n || p.type != q.type || p.pn != q.pn || p.seg_id != q.seg_id || p.level != q.level ||
+            memcmp(&p.x, &q.x, sizeof(float)) || memcmp(&p.y, &q.y, sizeof(float)) ||
+            memcmp(&p.z, &q.z, sizeof(float)) || memcmp(&p.r, &q.r, sizeof(float)) || p.fea_val != q.fea_val)
+            return false;
+    }
+    return true;
+}
+
+static bool sameFiles(const QString& f1, const QString& f2)
+{
+    QFile a(f1), b(f2);
+    return a.open(QIODevice::ReadOnly) && b.open(QIODevice::ReadOnly) && a.readAll() == b.readAll();
+}
+
+int main(int argc, char** argv)
+{
+    long n_nodes = (argc > 1) ? atol(argv[1]) : 1000000;
+    int n_features = (argc > 2) ? atoi(argv[2]) : 2;
+    srand(1);
+
+    NeuronTree nt = randomTree(n_nodes, n_features);
+    QString swc = QDir::temp().filePath("benchmark_swc.swc");
+    QString eswc = QDir::temp().filePath("benchmark_swc.eswc");
+    QString eswc_ref = QDir::temp().filePath("benchmark_swc_ref.eswc");
+    QElapsedTimer timer;
+    bool ok = true;
+
+    timer.start();
+    writeSWC_file(swc, nt);
+    printf("writeSWC_file             %10.1f ms\n", double(timer.elapsed()));
+
+    timer.start();
+    writeESWC_file(eswc, nt);
+    double t_write = timer.elapsed();
+    timer.start();
+    writeESWC_file_fprintf(eswc_ref, nt);
+    double t_write_ref = timer.elapsed();
+    printf("writeESWC_file            %10.1f ms   former fprintf writer %10.1f ms\n", t_write, t_write_ref);
+    ok = ok && sameFiles(eswc, eswc_ref);
+
+    timer.start();
+    NeuronTree nt_swc = readSWC_file(swc);
+    printf("readSWC_file (swc)        %10.1f ms\n", double(timer.elapsed()));
+    ok = ok && sameNodes(nt_swc, readSWC_file_lines(swc));
+
+    timer.start();
+    NeuronTree nt_eswc = readSWC_file(eswc);
+    double t_read = timer.elapsed();
+    timer.start();
+    NeuronTree nt_eswc_ref = readSWC_file_lines(eswc);
+    double t_read_ref = timer.elapsed();
+    printf("readSWC_file (eswc)       %10.1f ms   former line reader    %10.1f ms\n", t_read, t_read_ref);
+    ok = ok && sameNodes(nt_eswc, nt_eswc_ref);
+
+    printf("\n%ld nodes, %d feature values: %s\n", n_nodes, n_features,
+           ok ? "the files and the loaded nodes match the former reader and writer" : "ERROR: mismatch with the former reader or writer");
+
+    QFile::remove(swc);
+    QFile::remove(eswc);
+    QFile::remove(eswc_ref);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,15 @@
+# benchmark of the SWC/ESWC reader and writer (standalone, not part of the V3D build)
+TEMPLATE = app
+TARGET = benchmark_swc
+CONFIG += console release
+QT += core gui
+greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
+mac {
+    CONFIG -= app_bundle
+}
+DEFINES += DISABLE_V3D_MSG
+HEADERS += ../basic_surf_objs.h \
+           ../v3d_message.h
+SOURCES += ../basic_surf_objs.cpp \
+           ../v3d_message.cpp \
+           benchmark_swc.cpp
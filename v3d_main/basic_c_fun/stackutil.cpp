@@ -77,6 +77,7 @@ Peng, H, Ruan, Z., Atasoy, D., and Sternson, S. (2010) “Automatic reconstructi
  *           Anyway, I have now used a 2G buffer to read >2G data. I have not changed the saveStack2Raw functions. It seems they work in the Matlab mex functions. Thus I assumed
  *           they don't need to change. Need tests anyway.
  * 20120410: fix a bug when strcasecmp_l() taking a NULL parameter so that it crashes
+ * 20261017: add loadRaw2Stack_mmap() to map (copy-on-write) instead of reading a raw stack, so that big files open quickly
  */
 
 #define _FILE_OFFSET_BITS  64  //20140919
@@ -1436,6 +1437,277 @@ int saveStack2Raw(const char * filename, const unsigned char * img, const V3DLON
 }
 
 
+/* 20261017: memory-mapped loading of Vaa3D raw stacks (both the 4-byte and the 2-byte size header).
+ * The file is mapped privately (copy-on-write), so the data pages are only read from disk when they are
+ * touched, and a page is only duplicated in RAM when it is edited; the file itself is never changed.
+ * The returned img must be released with releaseMappedRawStack() instead of delete [].
+ */
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#endif
+
+#include <map>
+
+struct MappedRawStackRegion
+{
+	void * base; //the start of the mapped view, i.e. img minus the in-page offset of the data
+	V3DLONG nbytes; //the length of the mapped view
+};
+
+#if defined(_WIN32)
+static CRITICAL_SECTION * mappedRawStackLock()
+{
+	static CRITICAL_SECTION cs;
+	static LONG b_initialized = 0;
+	if (InterlockedCompareExchange(&b_initialized, 1, 0)==0)
+	{
+		InitializeCriticalSection(&cs);
+		InterlockedExchange(&b_initialized, 2);
+	}
+	while (b_initialized!=2) Sleep(0);
+	return &cs;
+}
+#define LOCK_MAPPED_RAW_STACK_TABLE   EnterCriticalSection(mappedRawStackLock());
+#define UNLOCK_MAPPED_RAW_STACK_TABLE LeaveCriticalSection(mappedRawStackLock());
+#else
+static pthread_mutex_t mappedRawStackMutex = PTHREAD_MUTEX_INITIALIZER;
+#define LOCK_MAPPED_RAW_STACK_TABLE   pthread_mutex_lock(&mappedRawStackMutex);
+#define UNLOCK_MAPPED_RAW_STACK_TABLE pthread_mutex_unlock(&mappedRawStackMutex);
+#endif
+
+static std::map<const unsigned char *, MappedRawStackRegion> & mappedRawStackTable()
+{
+	static std::map<const unsigned char *, MappedRawStackRegion> table;
+	return table;
+}
+
+static V3DLONG mappingGranularity()
+{
+#if defined(_WIN32)
+	SYSTEM_INFO si;
+	GetSystemInfo(&si);
+	return V3DLONG(si.dwAllocationGranularity);
+#else
+	return V3DLONG(sysconf(_SC_PAGESIZE));
+#endif
+}
+
+static unsigned char * mapRawStackRegion(const char * filename, V3DLONG offset, V3DLONG nbytes)
+{
+	V3DLONG granularity = mappingGranularity();
+	V3DLONG alignedOffset = (offset/granularity)*granularity;
+	V3DLONG delta = offset - alignedOffset;
+	V3DLONG mapBytes = nbytes + delta;
+	void * base = 0;
+
+#if defined(_WIN32)
+	HANDLE hFile = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (hFile==INVALID_HANDLE_VALUE)
+		return 0;
+	HANDLE hMap = CreateFileMappingA(hFile, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+	CloseHandle(hFile);
+	if (!hMap)
+		return 0;
+	base = MapViewOfFile(hMap, FILE_MAP_COPY, DWORD((unsigned __int64)alignedOffset >> 32), DWORD(alignedOffset & 0xFFFFFFFF), SIZE_T(mapBytes));
+	CloseHandle(hMap); //the view keeps the mapping object alive
+	if (!base)
+		return 0;
+#else
+	int fd = open(filename, O_RDONLY);
+	if (fd<0)
+		return 0;
+	base = mmap(0, size_t(mapBytes), PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, off_t(alignedOffset));
+	close(fd); //the mapping keeps its own reference to the file
+	if (base==MAP_FAILED)
+		return 0;
+#endif
+
+	MappedRawStackRegion r;
+	r.base = base;
+	r.nbytes = mapBytes;
+	unsigned char * img = (unsigned char *)base + delta;
+
+	LOCK_MAPPED_RAW_STACK_TABLE
+	mappedRawStackTable()[img] = r;
+	UNLOCK_MAPPED_RAW_STACK_TABLE
+
+	return img;
+}
+
+bool isMappedRawStack(const unsigned char * img)
+{
+	if (!img) return false;
+	LOCK_MAPPED_RAW_STACK_TABLE
+	bool b_found = (mappedRawStackTable().find(img)!=mappedRawStackTable().end());
+	UNLOCK_MAPPED_RAW_STACK_TABLE
+	return b_found;
+}
+
+void releaseMappedRawStack(unsigned char * img)
+{
+	if (!img) return;
+
+	MappedRawStackRegion r;
+	r.base = 0;
+	r.nbytes = 0;
+	LOCK_MAPPED_RAW_STACK_TABLE
+	std::map<const unsigned char *, MappedRawStackRegion>::iterator it = mappedRawStackTable().find(img);
+	if (it!=mappedRawStackTable().end())
+	{
+		r = it->second;
+		mappedRawStackTable().erase(it);
+	}
+	UNLOCK_MAPPED_RAW_STACK_TABLE
+
+	if (!r.base)
+	{
+		printf("releaseMappedRawStack(): the pointer was not obtained from loadRaw2Stack_mmap(). Do nothing.\n");
+		return;
+	}
+
+#if defined(_WIN32)
+	UnmapViewOfFile(r.base);
+#else
+	munmap(r.base, size_t(r.nbytes));
+#endif
+}
+
+int loadRaw2Stack_mmap(char * filename, unsigned char * & img, V3DLONG * & sz, int & datatype, int chan_id_to_load)
+{
+	/* The input parameters img and sz should be empty. When chan_id_to_load<0 all channels are mapped, otherwise only the specified one. */
+	/* A non-zero return value means the file cannot be mapped (e.g. it is not a raw stack, or its endian differs from the machine), */
+	/* and the caller should fall back to loadRaw2Stack() or loadRaw2Stack_2byte(). */
+
+	int berror = 0;
+
+	FILE * fid = fopen(filename, "rb");
+	if (!fid)
+	{
+		printf("Fail to open file for reading.\n");
+		return (berror=1);
+	}
+
+	fseek (fid, 0, SEEK_END);
+	V3DLONG fileSize = ftell(fid);
+	rewind(fid);
+
+	/* Read header */
+
+	char formatkey[] = "raw_image_stack_by_hpeng";
+	V3DLONG lenkey = strlen(formatkey);
+
+	if (fileSize<lenkey+2+4*2+1) /* the smaller (2-byte size) header */
+	{
+		printf("The size of your input file is too small and is not correct, -- it is too small to contain the legal header.\n");
+		fclose(fid);
+		return (berror=1);
+	}
+
+	char keyread[32];
+	char endianCodeData = 0;
+	short int dcode = 0;
+	unsigned char szbuf[4*4];
+	memset(szbuf, 0, sizeof(szbuf));
+
+	V3DLONG nread = fread(keyread, 1, lenkey, fid);
+	keyread[lenkey] = '\0';
+	if (nread!=lenkey || strcmp(formatkey, keyread))
+	{
+		printf("Unrecognized file format.\n");
+		fclose(fid);
+		return (berror=1);
+	}
+	fread(&endianCodeData, 1, 1, fid);
+	fread(&dcode, 2, 1, fid);
+	fread(szbuf, 1, sizeof(szbuf), fid); //may read fewer bytes for a tiny 2-byte-header file, which is checked below
+	fclose(fid);
+
+	char endianCodeMachine = checkMachineEndian();
+	if ((endianCodeData!='B' && endianCodeData!='L') || endianCodeData!=endianCodeMachine)
+	{
+		printf("The data endian [%c] differs from the machine endian [%c], thus the stack cannot be mapped directly.\n", endianCodeData, endianCodeMachine);
+		return (berror=1);
+	}
+
+	if (dcode!=1 && dcode!=2 && dcode!=4)
+	{
+		printf("Unrecognized data type code [%d]. The file type is incorrect or this code is not supported in this version.\n", dcode);
+		return (berror=1);
+	}
+	V3DLONG unitSize = dcode;
+
+	//decide between the 4-byte and the 2-byte size header by the file size, the same way loadImage() tries both
+	V3DLONG mysz[4];
+	V3DLONG headerSize = 0;
+	V3DLONG i;
+	{
+		BIT32_UNIT sz4[4];
+		memcpy(sz4, szbuf, sizeof(sz4));
+		V3DLONG totalUnit = 1;
+		for (i=0;i<4;i++) {mysz[i] = sz4[i]; totalUnit *= mysz[i];}
+		if (totalUnit>0 && totalUnit*unitSize+4*4+2+1+lenkey == fileSize)
+			headerSize = 4*4+2+1+lenkey;
+	}
+	if (!headerSize)
+	{
+		short int sz2[4];
+		memcpy(sz2, szbuf, sizeof(sz2));
+		V3DLONG totalUnit = 1;
+		for (i=0;i<4;i++) {mysz[i] = sz2[i]; totalUnit *= mysz[i];}
+		if (totalUnit>0 && totalUnit*unitSize+4*2+2+1+lenkey == fileSize)
+			headerSize = 4*2+2+1+lenkey;
+	}
+	if (!headerSize)
+	{
+		printf("The input file has a size [%ld bytes] different from what is specified in the header. Exit.\n", fileSize);
+		return (berror=1);
+	}
+
+	V3DLONG channelBytes = mysz[0]*mysz[1]*mysz[2]*unitSize;
+	V3DLONG offset = headerSize, nbytes = channelBytes*mysz[3];
+	if (chan_id_to_load>=0)
+	{
+		if (chan_id_to_load>=mysz[3])
+		{
+			printf("The specified chan_id_to_load [=%d] is out of the valid of the image data [=%ld] \n", chan_id_to_load, mysz[3]);
+			return (berror=1);
+		}
+		offset += channelBytes*chan_id_to_load;
+		nbytes = channelBytes;
+	}
+
+	unsigned char * p = mapRawStackRegion(filename, offset, nbytes);
+	if (!p)
+	{
+		printf("Fail to map the file [%s] into memory.\n", filename);
+		return (berror=1);
+	}
+
+	if (img) {delete []img; img=0;}
+	if (sz) {delete []sz; sz=0;}
+	sz = new V3DLONG [4];
+	for (i=0;i<4;i++)
+		sz[i] = mysz[i];
+	if (chan_id_to_load>=0)
+		sz[3] = 1;
+
+	img = p;
+	datatype = int(unitSize);
+
+	return berror;
+}
+
+
 int loadRaw5d2Stack(char * filename, unsigned char * & img, V3DLONG * & sz, int & datatype)
 {
     /* This function reads 2-5D image stack from v3d raw5 data */
@@ -49,6 +49,7 @@ Peng, H, Ruan, Z., Atasoy, D., and Sternson, S. (2010) “Automatic reconstructi
  * 100519: add v3d_basicdatatype.h
  * 100817: add mylib interface, PHC
  * 150507: add nrrd support, PHC
+ * 261017: add memory-mapped raw stack loading
  */
 
 #ifndef __STACKUTIL__
@@ -87,6 +88,12 @@ int loadRaw2Stack_2byte(char * filename, unsigned char * & img, V3DLONG * & sz,
 int loadRaw2Stack_2byte(char * filename, unsigned char * & img, V3DLONG * & sz, int & datatype, int chan_id_to_load); //overload for convenience to read only 1 channel
 int saveStack2Raw_2byte(const char * filename, const unsigned char * img, const V3DLONG * sz, int datatype);
 
+//map a 4-byte or 2-byte raw stack (copy-on-write) instead of reading it. chan_id_to_load<0 maps all channels. 261017
+//the returned img must be released by releaseMappedRawStack() but NOT delete []. A non-zero return means the caller should read the file normally
+int loadRaw2Stack_mmap(char * filename, unsigned char * & img, V3DLONG * & sz, int & datatype, int chan_id_to_load=-1);
+bool isMappedRawStack(const unsigned char * img);
+void releaseMappedRawStack(unsigned char * img);
+
 void swap2bytes(void *targetp);
 void swap4bytes(void *targetp);
 char checkMachineEndian();
@@ -33,6 +33,7 @@ Peng, H, Ruan, Z., Atasoy, D., and Sternson, S. (2010) “Automatic reconstructi
 // 2010-06-01
 // separated from v3d_global_preference_dialog.h, by PHC, 100601.
 // 2010-09-04: add b_UseMylibTiff
+// 2026-10-17: add b_mmapRawStack
 
 #ifndef __V3D_GLOBAL_PREFERENCE_H__
 #define __V3D_GLOBAL_PREFERENCE_H__
@@ -78,6 +79,9 @@ struct V3D_GlobalSetting
 	bool b_plugin_outputImgRescale; //if rescale the output of plugin's processing result between [0, 255]
 	bool b_plugin_outputImgConvert2UINT8; //if yes then convert a plugin's output to UINT8 type (rounding to it in most cases); if no, then keep as float (32bit)
 
+	//triview tab, appended at the end to keep the layout of the earlier fields
+	bool b_mmapRawStack; //map a .v3draw/.raw file (copy-on-write) instead of reading the whole file when opening it
+
 	//default preferences
 	V3D_GlobalSetting()
 	{
@@ -116,6 +120,8 @@ struct V3D_GlobalSetting
 		b_plugin_dispParameterDialog = true; //if display a dialog to ask a user to supply a plugin's parameters (e.g. image processing parameters)
 		b_plugin_outputImgRescale = false; //if rescale the output of plugin's processing result between [0, 255]
 		b_plugin_outputImgConvert2UINT8 = true; // if yes then convert a plugin's output to UINT8 type (rounding to it in most cases); if no, then keep as float (32bit)
+
+		b_mmapRawStack = false;
 	}
 };
 
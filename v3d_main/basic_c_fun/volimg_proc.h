@@ -40,6 +40,7 @@ Peng, H, Ruan, Z., Atasoy, D., and Sternson, S. (2010) “Automatic reconstructi
 #define __BASIC_VOLUME_IMG_PROCESSING__
 
 #include "volimg_proc_declare.h"
+#include "volimg_proc_fused.h"
 
 #include <math.h>
 #include <stdio.h>
@@ -104,6 +105,10 @@ template <class T> bool vol3d_negative(T *** res, T *** sa, V3DLONG d0, V3DLONG
 	if (!res || !sa || d0<=0 || d1<=0 || d2<=0)
 		return false;
 
+	T * rf = vol3d_flat(res, d0, d1, d2), * af = vol3d_flat(sa, d0, d1, d2);
+	if (rf && af)
+		return vol_eval(rf, -vol_expr(af), d0*d1*d2);
+
 	V3DLONG i,j,k;
 	for (k=0;k<d2;k++)
 	{
@@ -124,6 +129,10 @@ template <class T> bool vol3d_inverse(T *** res, T *** sa, V3DLONG d0, V3DLONG d
 	if (!res || !sa || d0<=0 || d1<=0 || d2<=0)
 		return false;
 
+	T * rf = vol3d_flat(res, d0, d1, d2), * af = vol3d_flat(sa, d0, d1, d2);
+	if (rf && af)
+		return vol_eval(rf, vol_inverse(vol_expr(af)), d0*d1*d2);
+
 	V3DLONG i,j,k;
 	for (k=0;k<d2;k++)
 	{
@@ -144,6 +153,10 @@ template <class T> bool vol3d_square(T *** res, T *** sa, V3DLONG d0, V3DLONG d1
 	if (!res || !sa || d0<=0 || d1<=0 || d2<=0)
 		return false;
 
+	T * rf = vol3d_flat(res, d0, d1, d2), * af = vol3d_flat(sa, d0, d1, d2);
+	if (rf && af)
+		return vol_eval(rf, vol_square(vol_expr(af)), d0*d1*d2);
+
 	double tmp;
 	V3DLONG i,j,k;
 	for (k=0;k<d2;k++)
@@ -166,6 +179,10 @@ template <class T> bool vol3d_root(T *** res, T *** sa, V3DLONG d0, V3DLONG d1,
 	if (!res || !sa || d0<=0 || d1<=0 || d2<=0)
 		return false;
 
+	T * rf = vol3d_flat(res, d0, d1, d2), * af = vol3d_flat(sa, d0, d1, d2);
+	if (rf && af)
+		return vol_eval(rf, vol_root(vol_expr(af)), d0*d1*d2);
+
 	V3DLONG i,j,k;
 	for (k=0;k<d2;k++)
 	{
@@ -186,6 +203,10 @@ template <class T> bool vol3d_exp(T *** res, T *** sa, V3DLONG d0, V3DLONG d1, V
 	if (!res || !sa || d0<=0 || d1<=0 || d2<=0)
 		return false;
 
+	T * rf = vol3d_flat(res, d0, d1, d2), * af = vol3d_flat(sa, d0, d1, d2);
+	if (rf && af)
+		return vol_eval(rf, vol_exp(vol_expr(af)), d0*d1*d2);
+
 	V3DLONG i,j,k;
 	for (k=0;k<d2;k++)
 	{
@@ -206,6 +227,10 @@ template <class T> bool vol3d_log(T *** res, T *** sa, V3DLONG d0, V3DLONG d1, V
 	if (!res || !sa || d0<=0 || d1<=0 || d2<=0)
 		return false;
 
+	T * rf = vol3d_flat(res, d0, d1, d2), * af = vol3d_flat(sa, d0, d1, d2);
+	if (rf && af)
+		return vol_eval(rf, vol_log(vol_expr(af)), d0*d1*d2);
+
 	V3DLONG i,j,k;
 	for (k=0;k<d2;k++)
 	{
@@ -227,6 +252,16 @@ template <class T> bool vol3d_min(T & res, T *** sa, V3DLONG d0, V3DLONG d1, V3D
 	if (!res || !sa || d0<=0 || d1<=0 || d2<=0)
 		return false;
 
+	T * af = vol3d_flat(sa, d0, d1, d2);
+	if (af)
+	{
+		V3DLONG pos_min, pos_max;
+		T minv, maxv;
+		vol_min_max(af, d0*d1*d2, pos_min, minv, pos_max, maxv);
+		res = minv;
+		return true;
+	}
+
 	double v;
 	V3DLONG i,j,k;
 	v = (double)sa[0][0][0];
@@ -250,6 +285,16 @@ template <class T> bool vol3d_max(T & res, T *** sa, V3DLONG d0, V3DLONG d1, V3D
 	if (!res || !sa || d0<=0 || d1<=0 || d2<=0)
 		return false;
 
+	T * af = vol3d_flat(sa, d0, d1, d2);
+	if (af)
+	{
+		V3DLONG pos_min, pos_max;
+		T minv, maxv;
+		vol_min_max(af, d0*d1*d2, pos_min, minv, pos_max, maxv);
+		res = maxv;
+		return true;
+	}
+
 	double v;
 	V3DLONG i,j,k;
 	v = (double)sa[0][0][0];
@@ -274,6 +319,18 @@ template <class T> bool vol3d_scale_01(T *** res, T *** sa, V3DLONG d0, V3DLONG
 	if (!res || !sa || d0<=0 || d1<=0 || d2<=0)
 		return false;
 
+	T * rf = vol3d_flat(res, d0, d1, d2), * af = vol3d_flat(sa, d0, d1, d2);
+	if (rf && af)
+	{
+		V3DLONG pos_min, pos_max;
+		T minv, maxv;
+		vol_min_max(af, d0*d1*d2, pos_min, minv, pos_max, maxv);
+		double L = double(maxv)-double(minv);
+		if (L==0.0)
+			return vol_eval(rf, VolExpr<VolExprConstant>(VolExprConstant(0)), d0*d1*d2);
+		return vol_eval(rf, (vol_expr(rf)-double(minv))/L, d0*d1*d2);
+	}
+
 	double vm, vM;
 	V3DLONG i,j,k;
 	vm = (double)sa[0][0][0];
@@ -327,6 +384,15 @@ template <class T> bool vol3d_sum(T & res, T *** sa, V3DLONG d0, V3DLONG d1, V3D
 	if (!res || !sa || d0<=0 || d1<=0 || d2<=0)
 		return false;
 
+	T * af = vol3d_flat(sa, d0, d1, d2);
+	if (af)
+	{
+		double v;
+		vol_sum(v, vol_expr(af), d0*d1*d2);
+		res = (T)v;
+		return true;
+	}
+
 	double v;
 	V3DLONG i,j,k;
 	v = (double)0;
@@ -351,6 +417,15 @@ template <class T> bool vol3d_mean(T & res, T *** sa, V3DLONG d0, V3DLONG d1, V3
 	if (!res || !sa || d0<=0 || d1<=0 || d2<=0)
 		return false;
 
+	T * af = vol3d_flat(sa, d0, d1, d2);
+	if (af)
+	{
+		double v;
+		vol_sum(v, vol_expr(af), d0*d1*d2);
+		res = (T)(v/(double(d0)*d1*d2));
+		return true;
+	}
+
 	double v;
 	V3DLONG i,j,k;
 	v = (double)0;
@@ -441,6 +516,10 @@ template <class T> bool vol3d_plus(T *** res, T *** sa, T *** sb, V3DLONG d0, V3
 	if (!res || !sa || !sb || d0<=0 || d1<=0 || d2<=0)
 		return false;
 
+	T * rf = vol3d_flat(res, d0, d1, d2), * af = vol3d_flat(sa, d0, d1, d2), * bf = vol3d_flat(sb, d0, d1, d2);
+	if (rf && af && bf)
+		return vol_eval(rf, vol_expr(af) + vol_expr(bf), d0*d1*d2);
+
 	V3DLONG i,j,k;
 	for (k=0;k<d2;k++)
 	{
@@ -461,6 +540,10 @@ template <class T> bool vol3d_plus_constant(T *** res, T *** sa, double c, V3DLO
 	if (!res || !sa || d0<=0 || d1<=0 || d2<=0)
 		return false;
 
+	T * rf = vol3d_flat(res, d0, d1, d2), * af = vol3d_flat(sa, d0, d1, d2);
+	if (rf && af)
+		return vol_eval(rf, vol_expr(af) + c, d0*d1*d2);
+
 	V3DLONG i,j,k;
 	for (k=0;k<d2;k++)
 	{
@@ -481,6 +564,10 @@ template <class T> bool vol3d_minus(T *** res, T *** sa, T *** sb, V3DLONG d0, V
 	if (!res || !sa || !sb || d0<=0 || d1<=0 || d2<=0)
 		return false;
 
+	T * rf = vol3d_flat(res, d0, d1, d2), * af = vol3d_flat(sa, d0, d1, d2), * bf = vol3d_flat(sb, d0, d1, d2);
+	if (rf && af && bf)
+		return vol_eval(rf, vol_expr(af) - vol_expr(bf), d0*d1*d2);
+
 	V3DLONG i,j,k;
 	for (k=0;k<d2;k++)
 	{
@@ -501,6 +588,10 @@ template <class T> bool vol3d_time(T *** res, T *** sa, T *** sb, V3DLONG d0, V3
 	if (!res || !sa || !sb || d0<=0 || d1<=0 || d2<=0)
 		return false;
 
+	T * rf = vol3d_flat(res, d0, d1, d2), * af = vol3d_flat(sa, d0, d1, d2), * bf = vol3d_flat(sb, d0, d1, d2);
+	if (rf && af && bf)
+		return vol_eval(rf, vol_expr(af) * vol_expr(bf), d0*d1*d2);
+
 	V3DLONG i,j,k;
 	for (k=0;k<d2;k++)
 	{
@@ -521,6 +612,10 @@ template <class T> bool vol3d_time_constant(T *** res, T *** sa, double c, V3DLO
 	if (!res || !sa || d0<=0 || d1<=0 || d2<=0)
 		return false;
 
+	T * rf = vol3d_flat(res, d0, d1, d2), * af = vol3d_flat(sa, d0, d1, d2);
+	if (rf && af)
+		return vol_eval(rf, vol_expr(af) * c, d0*d1*d2);
+
 	V3DLONG i,j,k;
 	for (k=0;k<d2;k++)
 	{
@@ -541,6 +636,10 @@ template <class T> bool vol3d_divide(T *** res, T *** sa, T *** sb, V3DLONG d0,
 	if (!res || !sa || !sb || d0<=0 || d1<=0 || d2<=0)
 		return false;
 
+	T * rf = vol3d_flat(res, d0, d1, d2), * af = vol3d_flat(sa, d0, d1, d2), * bf = vol3d_flat(sb, d0, d1, d2);
+	if (rf && af && bf)
+		return vol_eval(rf, vol_expr(af) / vol_expr(bf), d0*d1*d2);
+
 	V3DLONG i,j,k;
 	for (k=0;k<d2;k++)
 	{
@@ -562,6 +661,14 @@ template <class T> bool vol3d_square_root_diff(double & res, T *** sa, T *** sb,
 	if (!sa || !sb || d0<=0 || d1<=0 || d2<=0)
 		return false;
 
+	T * af = vol3d_flat(sa, d0, d1, d2), * bf = vol3d_flat(sb, d0, d1, d2);
+	if (af && bf)
+	{
+		vol_sum(res, vol_square(vol_expr(af)-vol_expr(bf)), d0*d1*d2);
+		res = sqrt(res);
+		return true;
+	}
+
 	V3DLONG i,j,k;
 	double tmp;
 	res = 0.0;
@@ -586,8 +693,7 @@ template <class T1, class T2> bool mean_and_std(T1 *data, V3DLONG n, T2 & ave, T
     if (!data || n<=0)
 	  return false;
 
-	int j;
-	double ep=0.0,s,p;
+	double ep=0.0,s;
 
 	if (n <= 1)
 	{
@@ -597,15 +703,11 @@ template <class T1, class T2> bool mean_and_std(T1 *data, V3DLONG n, T2 & ave, T
 	  return true; //do nothing
 	}
 
-	s=0.0;
-	for (j=0;j<n;j++) s += data[j];
+	vol_sum(s, vol_expr(data), n);
 	double ave_double=(T2)(s/n); //use ave_double for the best accuracy
 
 	double var=0.0;
-	for (j=0;j<n;j++) {
-		s=data[j]-(ave_double);
-		var += (p=s*s);
-	}
+	vol_sum(var, vol_square(vol_expr(data)-ave_double), n);
 	var=(var-ep*ep/n)/(n-1);
 	sdev=(T2)(sqrt(var));
 	ave=(T2)ave_double; //use ave_double for the best accuracy
@@ -787,23 +889,7 @@ template <class T> bool minMaxInVector(T * p, V3DLONG len, V3DLONG &pos_min, T &
 	if (!p || len <= 0)
 		return false;
 	
-	minv = maxv = p[0];
-	pos_min = pos_max = 0;
-	for (V3DLONG i=1;i<len;i++)
-	{
-		if (p[i]>maxv)
-		{
-			maxv = p[i];
-			pos_max = i;
-		}
-		else if (p[i]<minv)
-		{
-			minv = p[i];
-			pos_min = i;
-		}
-	}
-	
-	return true;
+	return vol_min_max(p, len, pos_min, minv, pos_max, maxv);
 }
 
 
@@ -1028,6 +1114,57 @@ template <class T> bool downsample3dimg_1dpt(T * & img, V3DLONG * sz, double dfa
 }
 
 
+//one output slice (c,i) per item of reslice_Z()
+template <class T> class ResliceZTask
+{
+public:
+	T **** invol4d;
+	T **** outvol4d;
+	V3DLONG xlen_out, ylen_out, zlen_out, sz2;
+	double z_rez, z_rez_new;
+	int interp_method;
+
+	void operator()(V3DLONG b, V3DLONG e)
+	{
+		V3DLONG j,k;
+		for (V3DLONG item=b; item<e; item++)
+		{
+			V3DLONG c = item/zlen_out, i = item%zlen_out;
+
+			double curpz = double(i)*z_rez_new/z_rez;
+			if (curpz>=sz2-1) curpz=sz2-1; //100831, by PHC
+
+			V3DLONG cpz0 = (V3DLONG)(floor(curpz)), cpz1 = (V3DLONG)(ceil(curpz));
+
+			if (cpz0==cpz1)
+			{
+				for (j=0;j<ylen_out; j++)
+					for (k=0; k<xlen_out; k++)
+						outvol4d[c][i][j][k] = invol4d[c][cpz0][j][k];
+			}
+			else
+			{
+				double w0z = (cpz1-curpz);
+				double w1z = (curpz-cpz0);
+
+				if (interp_method==1) //linear interp
+				{
+					for (j=0;j<ylen_out; j++)
+						for (k=0; k<xlen_out; k++)
+							outvol4d[c][i][j][k] = (T)(w0z * double(invol4d[c][cpz0][j][k]) + w1z * double(invol4d[c][cpz1][j][k]));
+				}
+				else //nearest neighbor interp
+				{
+					V3DLONG cpz = (w0z>=w1z) ? cpz0 : cpz1; //note >= condition so that to handle the case of x2 zoom-in
+					for (j=0;j<ylen_out; j++)
+						for (k=0; k<xlen_out; k++)
+							outvol4d[c][i][j][k] = invol4d[c][cpz][j][k];
+				}
+			}
+		}
+	}
+};
+
 //simple nearest neighbor reslicing of a 3D stack
 
 template <class T> bool reslice_Z(T * & invol1d, V3DLONG * sz, double xy_rez, double z_rez, int interp_method)
@@ -1090,96 +1227,19 @@ template <class T> bool reslice_Z(T * & invol1d, V3DLONG * sz, double xy_rez, do
   printf("#original slice=%ld original rez=%6.5f -> #output slices=%ld new rez=%6.5f\n", sz[2], z_rez, zlen_out, z_rez_new);
   //return;
 
-  //============ generate linear interpolation ===================
+  //============ interpolate, output slices in parallel ===================
 
-  if (interp_method==1) //linear interp
-  {
-	  for (c=0; c<clen_out; c++)
-	  {
-		  for (i=0; i<zlen_out; i++)
-		  {
-			  double curpz = double(i)*z_rez_new/z_rez;
-			  if (curpz>=sz[2]-1) curpz=sz[2]-1; //100831, by PHC
-			  
-			  V3DLONG cpz0 = (V3DLONG)(floor(curpz)), cpz1 = (V3DLONG)(ceil(curpz));
-
-			  if (cpz0==cpz1)
-			  {
-				  for (j=0;j<ylen_out; j++)
-				  {
-					for (k=0; k<xlen_out; k++)
-					{
-						outvol4d[c][i][j][k] = invol4d[c][cpz0][j][k];
-					}
-				  }
-			  }
-			  else
-			  {
-				  double w0z = (cpz1-curpz);
-				  double w1z = (curpz-cpz0);
-
-				  for (j=0;j<ylen_out; j++)
-				  {
-					for (k=0; k<xlen_out; k++)
-					{
-						outvol4d[c][i][j][k] = (T)(w0z * double(invol4d[c][cpz0][j][k]) + w1z * double(invol4d[c][cpz1][j][k]));
-					}
-				  }
-			  }
-
-		  }
-	  }
-  }
-  else //nearest neighbor interp
-  {
-	  for (c=0; c<clen_out; c++)
-	  {
-		  for (i=0; i<zlen_out; i++)
-		  {
-			  double curpz = double(i)*z_rez_new/z_rez;
-			  if (curpz>=sz[2]-1) curpz=sz[2]-1; //100831, by PHC
-
-			  V3DLONG cpz0 = (V3DLONG)(floor(curpz)), cpz1 = (V3DLONG)(ceil(curpz));
-
-			  if (cpz0==cpz1)
-			  {
-				  for (j=0;j<ylen_out; j++)
-				  {
-					for (k=0; k<xlen_out; k++)
-					{
-						outvol4d[c][i][j][k] = invol4d[c][cpz0][j][k];
-					}
-				  }
-			  }
-			  else
-			  {
-				  double w0z = (cpz1-curpz);
-				  double w1z = (curpz-cpz0);
-
-				  if (w0z>=w1z) //note >= condition so that to handle the case of x2 zoom-in
-				  {
-					  for (j=0;j<ylen_out; j++)
-					  {
-						for (k=0; k<xlen_out; k++)
-						{
-							outvol4d[c][i][j][k] = invol4d[c][cpz0][j][k];
-						}
-					  }
-				  }
-				  else
-				  {
-					  for (j=0;j<ylen_out; j++)
-					  {
-						for (k=0; k<xlen_out; k++)
-						{
-							outvol4d[c][i][j][k] = invol4d[c][cpz1][j][k];
-						}
-					  }
-				  }
-			  }
-		  }
-	  }
-  }
+  ResliceZTask<T> task;
+  task.invol4d = invol4d;
+  task.outvol4d = outvol4d;
+  task.xlen_out = xlen_out;
+  task.ylen_out = ylen_out;
+  task.zlen_out = zlen_out;
+  task.sz2 = sz[2];
+  task.z_rez = z_rez;
+  task.z_rez_new = z_rez_new;
+  task.interp_method = interp_method;
+  vol_parallel_for(clen_out*zlen_out, task, 1);
 
   // ====free memory=============
   if (invol4d) {delete4dpointer(invol4d, sz[0], sz[1], sz[2], sz[3]); invol4d=0;}
@@ -1194,6 +1254,59 @@ template <class T> bool reslice_Z(T * & invol1d, V3DLONG * sz, double xy_rez, do
   return true;
 }
 
+//one output slice (c,k) per item of resample3dimg_interp()
+template <class T> class Resample3DTask
+{
+public:
+	T **** in_tmp4d;
+	T **** out_tmp4d;
+	const V3DLONG * sz;
+	V3DLONG cur_sz0, cur_sz1, cur_sz2;
+	double dfactor_x, dfactor_y, dfactor_z;
+
+	void operator()(V3DLONG b, V3DLONG e)
+	{
+		for (V3DLONG item=b; item<e; item++)
+		{
+			V3DLONG c = item/cur_sz2, k = item%cur_sz2;
+
+			V3DLONG k2low=(V3DLONG)(floor(k*dfactor_z)), k2high=(V3DLONG)(floor((k+1)*dfactor_z-1));
+			if (k2high>sz[2]-1) k2high = sz[2]-1;
+			V3DLONG kw = k2high - k2low + 1;
+
+			for (V3DLONG j=0;j<cur_sz1;j++)
+			{
+				V3DLONG j2low=(V3DLONG)(floor(j*dfactor_y)), j2high=(V3DLONG)(floor((j+1)*dfactor_y-1));
+				if (j2high>sz[1]-1) j2high = sz[1]-1;
+				V3DLONG jw = j2high - j2low + 1;
+
+				for (V3DLONG i=0;i<cur_sz0;i++)
+				{
+					V3DLONG i2low=(V3DLONG)(floor(i*dfactor_x)), i2high=(V3DLONG)(floor((i+1)*dfactor_x-1));
+					if (i2high>sz[0]-1) i2high = sz[0]-1;
+					V3DLONG iw = i2high - i2low + 1;
+
+					double cubevolume = double(kw) * jw * iw;
+
+					double s=0.0;
+					for (V3DLONG k1=k2low;k1<=k2high;k1++)
+					{
+						for (V3DLONG j1=j2low;j1<=j2high;j1++)
+						{
+							for (V3DLONG i1=i2low;i1<=i2high;i1++)
+							{
+								s += in_tmp4d[c][k1][j1][i1];
+							}
+						}
+					}
+
+					out_tmp4d[c][k][j][i] = (T)(s/cubevolume);
+				}
+			}
+		}
+	}
+};
+
 //re-sampling data volume with different scaling factors of different axes
 template <class T> bool resample3dimg_interp(T * & img, V3DLONG * sz, double dfactor_x, double dfactor_y, double dfactor_z, int interp_method)
 {
@@ -1245,46 +1358,18 @@ template <class T> bool resample3dimg_interp(T * & img, V3DLONG * sz, double dfa
 	new4dpointer(out_tmp4d, cur_sz0, cur_sz1, cur_sz2, cur_sz3, outimg);
 	new4dpointer(in_tmp4d, sz[0], sz[1], sz[2], sz[3], img);
 
-    for (V3DLONG c=0;c<cur_sz3;c++)
-	{
-		for (V3DLONG k=0;k<cur_sz2;k++)
-		{
-			V3DLONG k2low=(V3DLONG)(floor(k*dfactor_z)), k2high=(V3DLONG)(floor((k+1)*dfactor_z-1));
-			if (k2high>sz[2]-1) k2high = sz[2]-1;
-			V3DLONG kw = k2high - k2low + 1;
-
-			for (V3DLONG j=0;j<cur_sz1;j++)
-			{
-				V3DLONG j2low=(V3DLONG)(floor(j*dfactor_y)), j2high=(V3DLONG)(floor((j+1)*dfactor_y-1));
-				if (j2high>sz[1]-1) j2high = sz[1]-1;
-				V3DLONG jw = j2high - j2low + 1;
-
-				for (V3DLONG i=0;i<cur_sz0;i++)
-				{
-					V3DLONG i2low=(V3DLONG)(floor(i*dfactor_x)), i2high=(V3DLONG)(floor((i+1)*dfactor_x-1));
-					if (i2high>sz[0]-1) i2high = sz[0]-1;
-					V3DLONG iw = i2high - i2low + 1;
-
-					double cubevolume = double(kw) * jw * iw;
-					//cout<<cubevolume <<" ";
-
-					double s=0.0;
-					for (V3DLONG k1=k2low;k1<=k2high;k1++)
-					{
-						for (V3DLONG j1=j2low;j1<=j2high;j1++)
-						{
-							for (V3DLONG i1=i2low;i1<=i2high;i1++)
-							{
-								s += in_tmp4d[c][k1][j1][i1];
-							}
-						}
-					}
-
-					out_tmp4d[c][k][j][i] = (T)(s/cubevolume);
-				}
-			}
-		}
-	}
+	//output slices in parallel
+	Resample3DTask<T> task;
+	task.in_tmp4d = in_tmp4d;
+	task.out_tmp4d = out_tmp4d;
+	task.sz = sz;
+	task.cur_sz0 = cur_sz0;
+	task.cur_sz1 = cur_sz1;
+	task.cur_sz2 = cur_sz2;
+	task.dfactor_x = dfactor_x;
+	task.dfactor_y = dfactor_y;
+	task.dfactor_z = dfactor_z;
+	vol_parallel_for(cur_sz3*cur_sz2, task, 1);
 
 	//delete temprary 4d pointers
 
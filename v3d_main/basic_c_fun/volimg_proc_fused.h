@@ -0,0 +1,322 @@
+/*
+ * Copyright (c)2006-2010  Hanchuan Peng (Janelia Farm, Howard Hughes Medical Institute).  
+ * All rights reserved.
+ */
+
+
+/************
+                                            ********* LICENSE NOTICE ************
+
+This folder contains all source codes for the V3D project, which is subject to the following conditions if you want to use it. 
+
+You will ***have to agree*** the following terms, *before* downloading/using/running/editing/changing any portion of codes in this package.
+
+1. This package is free for non-profit research, but needs a special license for any commercial purpose. Please contact Hanchuan Peng for details.
+
+2. You agree to appropriately cite this work in your related studies and publications.
+
+Peng, H., Ruan, Z., Long, F., Simpson, J.H., and Myers, E.W. (2010) “V3D enables real-time 3D visualization and quantitative analysis of large-scale biological image data sets,” Nature Biotechnology, Vol. 28, No. 4, pp. 348-353, DOI: 10.1038/nbt.1612. ( http://penglab.janelia.org/papersall/docpdf/2010_NBT_V3D.pdf )
+
+Peng, H, Ruan, Z., Atasoy, D., and Sternson, S. (2010) “Automatic reconstruction of 3D neuron structures using a graph-augmented deformable model,” Bioinformatics, Vol. 26, pp. i38-i46, 2010. ( http://penglab.janelia.org/papersall/docpdf/2010_Bioinfo_GD_ISMB2010.pdf )
+
+3. This software is provided by the copyright holders (Hanchuan Peng), Howard Hughes Medical Institute, Janelia Farm Research Campus, and contributors "as is" and any express or implied warranties, including, but not limited to, any implied warranties of merchantability, non-infringement, or fitness for a particular purpose are disclaimed. In no event shall the copyright owner, Howard Hughes Medical Institute, Janelia Farm Research Campus, or contributors be liable for any direct, indirect, incidental, special, exemplary, or consequential damages (including, but not limited to, procurement of substitute goods or services; loss of use, data, or profits; reasonable royalties; or business interruption) however caused and on any theory of liability, whether in contract, strict liability, or tort (including negligence or otherwise) arising in any way out of the use of this software, even if advised of the possibility of such damage.
+
+4. Neither the name of the Howard Hughes Medical Institute, Janelia Farm Research Campus, nor Hanchuan Peng, may be used to endorse or promote products derived from this software without specific prior written permission.
+
+*************/
+
+
+//volimg_proc_fused.h
+//
+//Fused evaluation of voxel-wise expressions over flat image buffers, e.g. the raw data of one Image4DSimple channel.
+//
+//  vol_eval(res, (vol_expr(a) - vol_expr(b)) * 0.5 + 10.0, len);
+//
+//computes res[i] = (T)(((double)a[i]-(double)b[i])*0.5+10.0) in one pass, instead of one pass over the memory per
+//operator. The expression is evaluated in double and converted to the result type once. The buffer is split into
+//contiguous tiles that are handed out to all cores; the inner loop over a tile is a plain indexed loop the compiler
+//can vectorize. Reductions (vol_sum, vol_min_max) add their tiles in tile order, so their results do not depend
+//on the number of threads.
+//
+//By default everything runs on the calling thread, so plugins that only include volimg_proc.h link as before.
+//Builds that link basic_parallel.cpp (Vaa3D itself) define VOLIMG_PROC_THREADS to spread the tiles over all cores.
+//
+//2026-10-17
+
+#ifndef __BASIC_VOLUME_IMG_PROC_FUSED__
+#define __BASIC_VOLUME_IMG_PROC_FUSED__
+
+#include "v3d_basicdatatype.h"
+
+#include <math.h>
+#include <vector>
+
+#if defined(VOLIMG_PROC_THREADS)
+#include "basic_parallel.h"
+#endif
+
+#define VOLIMG_PROC_TILE_SIZE (1<<16)
+
+//================== threads ==================
+
+//the number of threads used by the fused functions; 0 (default) means one per core
+inline int & vol_num_threads_setting()
+{
+	static int n = 0;
+	return n;
+}
+
+inline int vol_num_threads()
+{
+#if !defined(VOLIMG_PROC_THREADS)
+	return 1;
+#else
+	int n = vol_num_threads_setting();
+	if (n<=0) n = v3d_num_cores();
+	return (n<1) ? 1 : n;
+#endif
+}
+
+#if defined(VOLIMG_PROC_THREADS)
+template <class F> void vol_parallel_range(void * f, V3DLONG b, V3DLONG e)
+{
+	(*(F *)f)(b, e);
+}
+#endif
+
+//calls f(b,e) on contiguous ranges covering [0,n), one range per thread, with at least grain items per range.
+//f must be safe to call concurrently on disjoint ranges.
+template <class F> void vol_parallel_for(V3DLONG n, F & f, V3DLONG grain)
+{
+	if (n<=0) return;
+	if (grain<1) grain = 1;
+	V3DLONG nt = vol_num_threads();
+	if (nt > n/grain) nt = n/grain;
+	if (nt<=1)
+	{
+		f(0, n);
+		return;
+	}
+
+#if defined(VOLIMG_PROC_THREADS)
+	v3d_parallel_for(n, (int)nt, vol_parallel_range<F>, &f);
+#else
+	f(0, n);
+#endif
+}
+
+//================== expressions ==================
+
+template <class E> class VolExpr
+{
+public:
+	E e;
+	VolExpr(const E & e0) : e(e0) {}
+	double operator[](V3DLONG i) const {return e[i];}
+};
+
+template <class T> class VolExprData
+{
+public:
+	const T * p;
+	VolExprData(const T * p0) : p(p0) {}
+	double operator[](V3DLONG i) const {return double(p[i]);}
+};
+
+class VolExprConstant
+{
+public:
+	double c;
+	VolExprConstant(double c0) : c(c0) {}
+	double operator[](V3DLONG) const {return c;}
+};
+
+template <class A, class B, class Op> class VolExprBinary
+{
+public:
+	A a;
+	B b;
+	VolExprBinary(const A & a0, const B & b0) : a(a0), b(b0) {}
+	double operator[](V3DLONG i) const {return Op::apply(a[i], b[i]);}
+};
+
+template <class A, class Op> class VolExprUnary
+{
+public:
+	A a;
+	VolExprUnary(const A & a0) : a(a0) {}
+	double operator[](V3DLONG i) const {return Op::apply(a[i]);}
+};
+
+struct VolOpPlus {static double apply(double a, double b) {return a+b;}};
+struct VolOpMinus {static double apply(double a, double b) {return a-b;}};
+struct VolOpTime {static double apply(double a, double b) {return a*b;}};
+struct VolOpDivide {static double apply(double a, double b) {return a/b;}};
+struct VolOpNegative {static double apply(double a) {return -a;}};
+struct VolOpInverse {static double apply(double a) {return 1.0/a;}};
+struct VolOpSquare {static double apply(double a) {return a*a;}};
+struct VolOpRoot {static double apply(double a) {return sqrt(a);}};
+struct VolOpExp {static double apply(double a) {return exp(a);}};
+struct VolOpLog {static double apply(double a) {return log(a);}};
+struct VolOpAbs {static double apply(double a) {return fabs(a);}};
+
+template <class T> VolExpr< VolExprData<T> > vol_expr(const T * p)
+{
+	return VolExpr< VolExprData<T> >(VolExprData<T>(p));
+}
+
+#define VOLIMG_PROC_BINARY_OPERATOR(OP, OPCLASS) \
+template <class A, class B> VolExpr< VolExprBinary< VolExpr<A>, VolExpr<B>, OPCLASS > > operator OP (const VolExpr<A> & a, const VolExpr<B> & b) \
+{ return VolExpr< VolExprBinary< VolExpr<A>, VolExpr<B>, OPCLASS > >(VolExprBinary< VolExpr<A>, VolExpr<B>, OPCLASS >(a, b)); } \
+template <class A> VolExpr< VolExprBinary< VolExpr<A>, VolExprConstant, OPCLASS > > operator OP (const VolExpr<A> & a, double c) \
+{ return VolExpr< VolExprBinary< VolExpr<A>, VolExprConstant, OPCLASS > >(VolExprBinary< VolExpr<A>, VolExprConstant, OPCLASS >(a, VolExprConstant(c))); } \
+template <class B> VolExpr< VolExprBinary< VolExprConstant, VolExpr<B>, OPCLASS > > operator OP (double c, const VolExpr<B> & b) \
+{ return VolExpr< VolExprBinary< VolExprConstant, VolExpr<B>, OPCLASS > >(VolExprBinary< VolExprConstant, VolExpr<B>, OPCLASS >(VolExprConstant(c), b)); }
+
+VOLIMG_PROC_BINARY_OPERATOR(+, VolOpPlus)
+VOLIMG_PROC_BINARY_OPERATOR(-, VolOpMinus)
+VOLIMG_PROC_BINARY_OPERATOR(*, VolOpTime)
+VOLIMG_PROC_BINARY_OPERATOR(/, VolOpDivide)
+
+#undef VOLIMG_PROC_BINARY_OPERATOR
+
+#define VOLIMG_PROC_UNARY_FUNCTION(NAME, OPCLASS) \
+template <class A> VolExpr< VolExprUnary< VolExpr<A>, OPCLASS > > NAME (const VolExpr<A> & a) \
+{ return VolExpr< VolExprUnary< VolExpr<A>, OPCLASS > >(VolExprUnary< VolExpr<A>, OPCLASS >(a)); }
+
+VOLIMG_PROC_UNARY_FUNCTION(operator -, VolOpNegative)
+VOLIMG_PROC_UNARY_FUNCTION(vol_inverse, VolOpInverse)
+VOLIMG_PROC_UNARY_FUNCTION(vol_square, VolOpSquare)
+VOLIMG_PROC_UNARY_FUNCTION(vol_root, VolOpRoot)
+VOLIMG_PROC_UNARY_FUNCTION(vol_exp, VolOpExp)
+VOLIMG_PROC_UNARY_FUNCTION(vol_log, VolOpLog)
+VOLIMG_PROC_UNARY_FUNCTION(vol_abs, VolOpAbs)
+
+#undef VOLIMG_PROC_UNARY_FUNCTION
+
+//================== evaluation ==================
+
+template <class T, class E> class VolEvalTask
+{
+public:
+	T * res;
+	const VolExpr<E> * e;
+	void operator()(V3DLONG b, V3DLONG end)
+	{
+		T * r = res;
+		const VolExpr<E> & x = *e;
+		for (V3DLONG i=b;i<end;i++)
+			r[i] = (T)(x[i]);
+	}
+};
+
+//res[i] = (T)e[i] for i in [0,len). res may be one of the buffers of e, as every voxel only reads its own index.
+template <class T, class E> bool vol_eval(T * res, const VolExpr<E> & e, V3DLONG len)
+{
+	if (!res || len<=0)
+		return false;
+	VolEvalTask<T, E> task;
+	task.res = res;
+	task.e = &e;
+	vol_parallel_for(len, task, VOLIMG_PROC_TILE_SIZE);
+	return true;
+}
+
+//reductions run over fixed tiles, independent of the number of threads, and combine the tiles in order
+template <class E> class VolSumTask
+{
+public:
+	const VolExpr<E> * e;
+	V3DLONG len;
+	std::vector<double> tileSum;
+	void operator()(V3DLONG tb, V3DLONG te)
+	{
+		const VolExpr<E> & x = *e;
+		for (V3DLONG t=tb;t<te;t++)
+		{
+			V3DLONG b = t*VOLIMG_PROC_TILE_SIZE, end = b+VOLIMG_PROC_TILE_SIZE;
+			if (end>len) end = len;
+			double s = 0.0;
+			for (V3DLONG i=b;i<end;i++) s += x[i];
+			tileSum[t] = s;
+		}
+	}
+};
+
+template <class E> bool vol_sum(double & res, const VolExpr<E> & e, V3DLONG len)
+{
+	if (len<=0)
+		return false;
+	V3DLONG ntiles = (len+VOLIMG_PROC_TILE_SIZE-1)/VOLIMG_PROC_TILE_SIZE;
+	VolSumTask<E> task;
+	task.e = &e;
+	task.len = len;
+	task.tileSum.resize(ntiles);
+	vol_parallel_for(ntiles, task, 1);
+	res = 0.0;
+	for (V3DLONG t=0;t<ntiles;t++) res += task.tileSum[t];
+	return true;
+}
+
+template <class T> class VolMinMaxTask
+{
+public:
+	const T * p;
+	V3DLONG len;
+	std::vector<T> tileMin, tileMax;
+	std::vector<V3DLONG> tilePosMin, tilePosMax;
+	void operator()(V3DLONG tb, V3DLONG te)
+	{
+		for (V3DLONG t=tb;t<te;t++)
+		{
+			V3DLONG b = t*VOLIMG_PROC_TILE_SIZE, end = b+VOLIMG_PROC_TILE_SIZE;
+			if (end>len) end = len;
+			T minv = p[b], maxv = p[b];
+			V3DLONG pos_min = b, pos_max = b;
+			for (V3DLONG i=b+1;i<end;i++)
+			{
+				if (p[i]>maxv) {maxv = p[i]; pos_max = i;}
+				else if (p[i]<minv) {minv = p[i]; pos_min = i;}
+			}
+			tileMin[t] = minv; tilePosMin[t] = pos_min;
+			tileMax[t] = maxv; tilePosMax[t] = pos_max;
+		}
+	}
+};
+
+//the first position of the minimum and of the maximum, as minMaxInVector()
+template <class T> bool vol_min_max(const T * p, V3DLONG len, V3DLONG & pos_min, T & minv, V3DLONG & pos_max, T & maxv)
+{
+	if (!p || len<=0)
+		return false;
+	V3DLONG ntiles = (len+VOLIMG_PROC_TILE_SIZE-1)/VOLIMG_PROC_TILE_SIZE;
+	VolMinMaxTask<T> task;
+	task.p = p;
+	task.len = len;
+	task.tileMin.resize(ntiles); task.tileMax.resize(ntiles);
+	task.tilePosMin.resize(ntiles); task.tilePosMax.resize(ntiles);
+	vol_parallel_for(ntiles, task, 1);
+	minv = task.tileMin[0]; pos_min = task.tilePosMin[0];
+	maxv = task.tileMax[0]; pos_max = task.tilePosMax[0];
+	for (V3DLONG t=1;t<ntiles;t++)
+	{
+		if (task.tileMin[t]<minv) {minv = task.tileMin[t]; pos_min = task.tilePosMin[t];}
+		if (task.tileMax[t]>maxv) {maxv = task.tileMax[t]; pos_max = task.tilePosMax[t];}
+	}
+	return true;
+}
+
+//the flat buffer behind a T*** volume made by new3dpointer(), or 0 if the rows are not laid out contiguously
+template <class T> T * vol3d_flat(T *** p, V3DLONG d0, V3DLONG d1, V3DLONG d2)
+{
+	if (!p || !p[0] || d0<=0 || d1<=0 || d2<=0)
+		return 0;
+	T * base = p[0][0];
+	for (V3DLONG k=0;k<d2;k++)
+		for (V3DLONG j=0;j<d1;j++)
+			if (p[k][j] != base + (k*d1+j)*d0)
+				return 0;
+	return base;
+}
+
+#endif
@@ -11,3 +11,4 @@ int teramanager::TiffLoadMetadata::gid = 0;
 int teramanager::TiffLoadData::gid = 0;
 int teramanager::TiffInitData::gid = 0;
 int teramanager::TiffAppendData::gid = 0;
+int teramanager::TiledLoadSubvolume::gid = 0;
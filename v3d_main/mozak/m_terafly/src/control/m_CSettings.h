@@ -67,6 +67,9 @@ class teramanager::CSettings
         int annotationVirtualMargin;
         int annotationMarkerSize;
         bool previewMode;
+        int ioThreads;          //threads reading the files of one subvolume (see iim::IO_THREADS)
+        int codecThreads;       //threads decoding/encoding the pages of one 3D TIFF file (see iim::TIFF_CODEC_THREADS)
+        int blockCacheSize;     //size (in MB) of the cache of decoded TIFF slices, 0 = no cache (see iim::BLOCK_CACHE_SIZE_MB)
 
         //TeraConverter members
         std::string volumeConverterInputPathLRU;
@@ -110,6 +113,9 @@ class teramanager::CSettings
         int getAnnotationVirtualMargin(){return annotationVirtualMargin;}
         int getAnnotationMarkerSize(){return annotationMarkerSize;}
         bool getPreviewMode(){return previewMode;}
+        int getIOThreads(){return ioThreads;}
+        int getCodecThreads(){return codecThreads;}
+        int getBlockCacheSize(){return blockCacheSize;}
 
         void setVolumePathLRU(std::string _volumePathLRU)
         {
@@ -145,6 +151,9 @@ class teramanager::CSettings
         void setAnnotationVirtualMargin(int newval){annotationVirtualMargin = newval;}
         void setAnnotationMarkerSize(int newval){annotationMarkerSize = newval;}
         void setPreviewMode(bool newval){previewMode = newval;}
+        void setIOThreads(int newval);
+        void setCodecThreads(int newval);
+        void setBlockCacheSize(int newval);
 
         //GET and SET methods for TeraConverter
         std::string getVCInputPath(){return volumeConverterInputPathLRU;}
@@ -79,6 +79,9 @@ typedef struct {
 	                  // to be transformed with i-th transformation; percents[n_transforms-1] must be 1.00
 	iom::real_t *c;        // used only if enhance=true; list of values; the i-th transformations map pixels from value 
 					  // c[i-1] to value c[i] 
+	int n_threads;    // number of threads used to compute the NCC maps of the three MIPs (<=1: sequential computation)
+	int fftThr;       // NCC maps with at least fftThr displacements, i.e. (2*delayu+1)*(2*delayv+1), are computed in the
+	                  // frequency domain (0: never); NCC values, and hence the thresholds above, are not affected
 } NCC_parms_t;
 
 /***************************************** MAIN FUNCTION ***********************************************/
@@ -46,6 +46,8 @@
 #define CM_DEF_W_RANGE_THR 29     //default range used to evaluate maximum width (when maximum width is greater or equal to this value, width is set to INF_W
 #define CM_DEF_UNR_NCC 0	  //default unreliable NCC peak value
 #define CM_DEF_INF_W 30    //default infinite NCC peak width
+#define CM_DEF_FFT_THR 1024   //default minimum number of displacements of an NCC map computed in the frequency domain
+#define CM_NCC_VAR_EPS 1e-9   //windows whose variance is at most this fraction of their energy are flat: their NCC is NaN
 
 
 typedef float real_t;
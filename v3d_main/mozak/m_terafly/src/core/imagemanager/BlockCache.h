@@ -0,0 +1,157 @@
+//------------------------------------------------------------------------------------------------
+// Copyright (c) 2012  Alessandro Bria and Giulio Iannello (University Campus Bio-Medico of Rome).  
+// All rights reserved.
+//------------------------------------------------------------------------------------------------
+
+/*******************************************************************************************************************************************************************************************
+*    LICENSE NOTICE
+********************************************************************************************************************************************************************************************
+*    By downloading/using/running/editing/changing any portion of codes in this package you agree to this license. If you do not agree to this license, do not download/use/run/edit/change
+*    this code.
+********************************************************************************************************************************************************************************************
+*    1. This material is free for non-profit research, but needs a special license for any commercial purpose. Please contact Alessandro Bria at a.bria@unicas.it or Giulio Iannello at 
+*       g.iannello@unicampus.it for further details.
+*    2. You agree to appropriately cite this work in your related studies and publications.
+*    3. This material is provided by  the copyright holders (Alessandro Bria  and  Giulio Iannello),  University Campus Bio-Medico and contributors "as is" and any express or implied war-
+*       ranties, including, but  not limited to,  any implied warranties  of merchantability,  non-infringement, or fitness for a particular purpose are  disclaimed. In no event shall the
+*       copyright owners, University Campus Bio-Medico, or contributors be liable for any direct, indirect, incidental, special, exemplary, or  consequential  damages  (including, but not 
+*       limited to, procurement of substitute goods or services; loss of use, data, or profits;reasonable royalties; or business interruption) however caused  and on any theory of liabil-
+*       ity, whether in contract, strict liability, or tort  (including negligence or otherwise) arising in any way out of the use of this software,  even if advised of the possibility of
+*       such damage.
+*    4. Neither the name of University  Campus Bio-Medico of Rome, nor Alessandro Bria and Giulio Iannello, may be used to endorse or  promote products  derived from this software without
+*       specific prior written permission.
+********************************************************************************************************************************************************************************************/
+
+
+#ifndef BLOCK_CACHE_H
+#define BLOCK_CACHE_H
+
+#include "IM_config.h"
+#include <string>
+#include <list>
+#include <map>
+#include <vector>
+
+#ifdef _VAA3D_TERAFLY_PLUGIN_MODE
+#include <QMutex>
+#endif
+
+/* Decoded block cache
+ *
+ * Process-wide, size-bounded (see iim::BLOCK_CACHE_SIZE_MB) LRU cache of decoded 3D TIFF slices shared by all the
+ * volume classes of this module. Cached slices are keyed by file and slice index and contain all the channels of
+ * the slice (channels are stored either interleaved in the same file or in different files, so the file and the
+ * slice identify the data). Consecutive VOIs that overlap load the common slices with memory copies only, even
+ * if their depth ranges differ.
+ *
+ * Slices are pinned while they are used and unpinned slices are evicted in least-recently-used order. A cached
+ * slice is dropped if its file has been modified (size or modification time changed) since it was decoded.
+ */
+namespace IconImageManager
+{
+	class BlockCache
+	{
+		public:
+
+			struct Block
+			{
+				std::string filename;
+				unsigned int slice;						// index of the slice in the file
+				unsigned int width, height, chans;
+				int bytes_x_chan;
+				uint8 *data;							// width * height * chans * bytes_x_chan bytes
+				sint64 size;							// size of data in bytes
+
+				sint64 file_size;						// used to detect files modified after decoding
+				sint64 file_mtime;
+				int pins;								// number of users of the block
+				bool cached;							// false if the block is deleted when unpinned
+
+				Block() : slice(0), width(0), height(0), chans(0), bytes_x_chan(0), data(0), size(0),
+						  file_size(-1), file_mtime(-1), pins(0), cached(false) {}
+				~Block(){ if(data) delete[] data; }
+			};
+
+			struct Stats
+			{
+				sint64 hits, misses, evictions;			// slices served from/missing in the cache, slices evicted
+				sint64 bytes_hit, bytes_decoded;		// bytes served from the cache, bytes decoded after a miss
+				sint64 bytes_cached;					// current size of the cache
+				int blocks_cached;						// current number of slices in the cache
+			};
+
+			static BlockCache& instance(){ return cache; }
+
+			// sets blocks[i] to the (pinned) slice <first>+i of file <filename> if it is cached, to 0 otherwise;
+			// returns the number of cached slices
+			int acquire(const char *filename, unsigned int first, unsigned int last, std::vector<Block*> &blocks);
+
+			// inserts decoded slices of file <filename> (ownership is taken) and pins them; the slices already
+			// inserted in the meanwhile (by another thread) are deleted and replaced by the cached ones
+			void insert(const char *filename, std::vector<Block*> &blocks);
+
+			// unpins a slice returned by acquire or insert
+			void release(Block *block);
+
+			// removes all the unpinned slices
+			void clear();
+
+			// removes the unpinned slices beyond the capacity, e.g. after iim::BLOCK_CACHE_SIZE_MB has been changed
+			void shrink();
+
+			Stats getStats();
+			void resetStats();
+
+		private:
+
+			typedef std::pair<std::string, unsigned int> key_t;
+			typedef std::map<key_t, std::list<Block*>::iterator> index_t;
+
+			static BlockCache cache;
+
+			std::list<Block*> lru;								// most recently used first
+			index_t index;
+			Stats stats;
+			#ifdef _VAA3D_TERAFLY_PLUGIN_MODE
+			QMutex mutex;
+			#endif
+
+			BlockCache();
+			~BlockCache();
+			BlockCache(const BlockCache&);
+			BlockCache& operator=(const BlockCache&);
+
+			void remove(index_t::iterator it);
+			void evict(sint64 capacity);
+	};
+
+	// unpins cached slices when going out of scope
+	class BlockCacheRef
+	{
+		public:
+
+			std::vector<BlockCache::Block*> blocks;
+
+			BlockCacheRef(){}
+			~BlockCacheRef(){
+				for(size_t i=0; i<blocks.size(); i++)
+					if(blocks[i])
+						BlockCache::instance().release(blocks[i]);
+			}
+
+		private:
+
+			BlockCacheRef(const BlockCacheRef&);
+			BlockCacheRef& operator=(const BlockCacheRef&);
+	};
+
+	/* returns in slices.blocks[i] (pinned) the decoded slice <first>+i of the 3D TIFF file <filename>, for i
+	 * in [0, last-first]; only the slices that are not cached yet are read from the file
+	 *
+	 * if some exception occurs, returns a string describing the exception; returns a NULL pointer
+	 * if there are no exceptions
+	 */
+	char *loadTiff3DBlock ( char *filename, unsigned int first, unsigned int last, BlockCacheRef &slices );
+}
+
+#endif
@@ -0,0 +1,506 @@
+//------------------------------------------------------------------------------------------------
+// Copyright (c) 2012  Alessandro Bria and Giulio Iannello (University Campus Bio-Medico of Rome).  
+// All rights reserved.
+//------------------------------------------------------------------------------------------------
+
+/*******************************************************************************************************************************************************************************************
+*    LICENSE NOTICE
+********************************************************************************************************************************************************************************************
+*    By downloading/using/running/editing/changing any portion of codes in this package you agree to this license. If you do not agree to this license, do not download/use/run/edit/change
+*    this code.
+********************************************************************************************************************************************************************************************
+*    1. This material is free for non-profit research, but needs a special license for any commercial purpose. Please contact Alessandro Bria at a.bria@unicas.it or Giulio Iannello at 
+*       g.iannello@unicampus.it for further details.
+*    2. You agree to appropriately cite this work in your related studies and publications.
+*    3. This material is provided by  the copyright holders (Alessandro Bria  and  Giulio Iannello),  University Campus Bio-Medico and contributors "as is" and any express or implied war-
+*       ranties, including, but  not limited to,  any implied warranties  of merchantability,  non-infringement, or fitness for a particular purpose are  disclaimed. In no event shall the
+*       copyright owners, University Campus Bio-Medico, or contributors be liable for any direct, indirect, incidental, special, exemplary, or  consequential  damages  (including, but not 
+*       limited to, procurement of substitute goods or services; loss of use, data, or profits;reasonable royalties; or business interruption) however caused  and on any theory of liabil-
+*       ity, whether in contract, strict liability, or tort  (including negligence or otherwise) arising in any way out of the use of this software,  even if advised of the possibility of
+*       such damage.
+*    4. Neither the name of University  Campus Bio-Medico of Rome, nor Alessandro Bria and Giulio Iannello, may be used to endorse or  promote products  derived from this software without
+*       specific prior written permission.
+********************************************************************************************************************************************************************************************/
+
+#include "ChunkedFmtMngr.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sstream>
+#include <fstream>
+
+#include <zlib.h>
+#ifdef IIM_WITH_ZSTD
+#include <zstd.h>
+#endif
+#ifdef IIM_WITH_LZ4
+#include <lz4.h>
+#endif
+#ifdef IIM_WITH_BLOSC
+#include <blosc.h>
+#endif
+
+using namespace iim;
+
+namespace
+{
+	/************************************************************************************
+	* Minimal JSON access, sufficient for the metadata written by this module and by Zarr
+	*************************************************************************************/
+
+	// returns the position just after the end of the JSON value starting at <pos>
+	size_t jsonValueEnd ( const std::string &text, size_t pos )
+	{
+		if ( pos >= text.size() )
+			return pos;
+		if ( text[pos] == '"' ) {
+			for ( pos++; pos < text.size() && text[pos] != '"'; pos++ )
+				if ( text[pos] == '\\' )
+					pos++;
+			return pos + 1;
+		}
+		if ( text[pos] == '[' || text[pos] == '{' ) {
+			int depth = 0;
+			for ( ; pos < text.size(); pos++ ) {
+				if ( text[pos] == '"' )
+					pos = jsonValueEnd(text,pos) - 1;
+				else if ( text[pos] == '[' || text[pos] == '{' )
+					depth++;
+				else if ( (text[pos] == ']' || text[pos] == '}') && --depth == 0 )
+					return pos + 1;
+			}
+			return pos;
+		}
+		while ( pos < text.size() && text[pos] != ',' && text[pos] != '}' && text[pos] != ']' && !isspace(text[pos]) )
+			pos++;
+		return pos;
+	}
+
+	// returns the value associated to <key> in the outermost level of the JSON object <text> ("" if not found)
+	std::string jsonGet ( const std::string &text, const std::string &key )
+	{
+		size_t pos = text.find('{');
+		if ( pos == std::string::npos )
+			return "";
+		for ( pos++; pos < text.size(); ) {
+			while ( pos < text.size() && (isspace(text[pos]) || text[pos] == ',') )
+				pos++;
+			if ( pos >= text.size() || text[pos] != '"' )
+				return "";
+			size_t key_end = jsonValueEnd(text,pos);
+			std::string name = text.substr(pos+1,key_end-pos-2);
+			pos = text.find(':',key_end);
+			if ( pos == std::string::npos )
+				return "";
+			for ( pos++; pos < text.size() && isspace(text[pos]); pos++ )
+				;
+			size_t value_end = jsonValueEnd(text,pos);
+			if ( name == key )
+				return text.substr(pos,value_end-pos);
+			pos = value_end;
+		}
+		return "";
+	}
+
+	// returns the string without quotes
+	std::string jsonString ( const std::string &value )
+	{
+		if ( value.size() >= 2 && value[0] == '"' )
+			return value.substr(1,value.size()-2);
+		return value;
+	}
+
+	// returns the numbers of a JSON array
+	std::vector<double> jsonNumbers ( const std::string &value )
+	{
+		std::vector<double> numbers;
+		const char *p = value.c_str();
+		while ( *p && *p != '[' )
+			p++;
+		while ( *p && *p != ']' ) {
+			p++;
+			char *end;
+			double v = strtod(p,&end);
+			if ( end != p ) {
+				numbers.push_back(v);
+				p = end;
+			}
+			while ( *p && *p != ',' && *p != ']' )
+				p++;
+		}
+		return numbers;
+	}
+
+	std::string readTextFile ( const std::string &fname ) throw (IOException)
+	{
+		std::ifstream f(fname.c_str());
+		if ( !f.is_open() )
+			throw IOException(strprintf("cannot open file \"%s\"", fname.c_str()), __iim__current__function__);
+		std::stringstream ss;
+		ss << f.rdbuf();
+		return ss.str();
+	}
+
+	void writeTextFile ( const std::string &fname, const std::string &text ) throw (IOException)
+	{
+		std::ofstream f(fname.c_str(), std::ofstream::out);
+		if ( !f.is_open() )
+			throw IOException(strprintf("cannot create file \"%s\"", fname.c_str()), __iim__current__function__);
+		f << text;
+		if ( !f.good() )
+			throw IOException(strprintf("cannot write file \"%s\"", fname.c_str()), __iim__current__function__);
+	}
+
+
+	/************************************************************************************
+	* Filters and codecs
+	*************************************************************************************/
+
+	// byte shuffle: first bytes of all elements, then second bytes, and so on
+	void shuffle ( const uint8 *src, uint8 *dst, sint64 n_bytes, int elem_size )
+	{
+		sint64 n = n_bytes / elem_size;
+		for ( sint64 i=0; i<n; i++ )
+			for ( int j=0; j<elem_size; j++ )
+				dst[j*n + i] = src[i*elem_size + j];
+	}
+
+	void unshuffle ( const uint8 *src, uint8 *dst, sint64 n_bytes, int elem_size )
+	{
+		sint64 n = n_bytes / elem_size;
+		for ( sint64 i=0; i<n; i++ )
+			for ( int j=0; j<elem_size; j++ )
+				dst[i*elem_size + j] = src[j*n + i];
+	}
+
+	// encodes n bytes of src according to the codec of arr
+	void encode ( const chunked_array_t &arr, const uint8 *src, sint64 n, std::vector<uint8> &dst ) throw (IOException)
+	{
+		if ( arr.codec == "raw" ) {
+			dst.assign(src,src+n);
+		}
+		else if ( arr.codec == "zlib" ) {
+			uLongf len = compressBound((uLong)n);
+			dst.resize(len);
+			if ( compress2(&dst[0],&len,src,(uLong)n,arr.level) != Z_OK )
+				throw IOException("zlib compression failed", __iim__current__function__);
+			dst.resize(len);
+		}
+#ifdef IIM_WITH_ZSTD
+		else if ( arr.codec == "zstd" ) {
+			dst.resize(ZSTD_compressBound((size_t)n));
+			size_t len = ZSTD_compress(&dst[0],dst.size(),src,(size_t)n,arr.level);
+			if ( ZSTD_isError(len) )
+				throw IOException(strprintf("zstd compression failed: %s", ZSTD_getErrorName(len)), __iim__current__function__);
+			dst.resize(len);
+		}
+#endif
+#ifdef IIM_WITH_LZ4
+		else if ( arr.codec == "lz4" ) {
+			dst.resize(4 + LZ4_compressBound((int)n));
+			for ( int i=0; i<4; i++ )
+				dst[i] = (uint8)((n >> (8*i)) & 0xFF); // uncompressed size (little-endian), as numcodecs does
+			int len = LZ4_compress_fast((const char *)src,(char *)&dst[4],(int)n,(int)dst.size()-4,arr.level);
+			if ( len <= 0 )
+				throw IOException("lz4 compression failed", __iim__current__function__);
+			dst.resize(4 + len);
+		}
+#endif
+#ifdef IIM_WITH_BLOSC
+		else if ( arr.codec == "blosc" ) {
+			dst.resize(n + BLOSC_MAX_OVERHEAD);
+			int len = blosc_compress_ctx(arr.level,arr.shuffle ? BLOSC_SHUFFLE : BLOSC_NOSHUFFLE,arr.bytes_chan,(size_t)n,src,&dst[0],dst.size(),"lz4",0,1);
+			if ( len <= 0 )
+				throw IOException("blosc compression failed", __iim__current__function__);
+			dst.resize(len);
+		}
+#endif
+		else
+			throw IOException(strprintf("unsupported codec \"%s\"", arr.codec.c_str()), __iim__current__function__);
+	}
+
+	// decodes src into exactly n bytes of dst
+	void decode ( const chunked_array_t &arr, const std::vector<uint8> &src, uint8 *dst, sint64 n ) throw (IOException)
+	{
+		if ( arr.codec == "raw" ) {
+			if ( (sint64)src.size() != n )
+				throw IOException(strprintf("invalid chunk size (%lld bytes instead of %lld)", (long long)src.size(), (long long)n), __iim__current__function__);
+			memcpy(dst,&src[0],n);
+		}
+		else if ( arr.codec == "zlib" ) {
+			uLongf len = (uLongf)n;
+			if ( src.empty() || uncompress(dst,&len,&src[0],(uLong)src.size()) != Z_OK || (sint64)len != n )
+				throw IOException("zlib decompression failed", __iim__current__function__);
+		}
+#ifdef IIM_WITH_ZSTD
+		else if ( arr.codec == "zstd" ) {
+			size_t len = src.empty() ? 0 : ZSTD_decompress(dst,(size_t)n,&src[0],src.size());
+			if ( ZSTD_isError(len) || (sint64)len != n )
+				throw IOException("zstd decompression failed", __iim__current__function__);
+		}
+#endif
+#ifdef IIM_WITH_LZ4
+		else if ( arr.codec == "lz4" ) {
+			if ( src.size() < 4 || LZ4_decompress_safe((const char *)&src[4],(char *)dst,(int)src.size()-4,(int)n) != (int)n )
+				throw IOException("lz4 decompression failed", __iim__current__function__);
+		}
+#endif
+#ifdef IIM_WITH_BLOSC
+		else if ( arr.codec == "blosc" ) {
+			if ( src.empty() || blosc_decompress_ctx(&src[0],dst,(size_t)n,1) != (int)n )
+				throw IOException("blosc decompression failed", __iim__current__function__);
+		}
+#endif
+		else
+			throw IOException(strprintf("unsupported codec \"%s\"", arr.codec.c_str()), __iim__current__function__);
+	}
+
+	// true if the (numcodecs) shuffle filter has to be applied outside the codec
+	bool outerShuffle ( const chunked_array_t &arr )
+	{
+		return arr.shuffle && arr.bytes_chan > 1 && arr.codec != "blosc";
+	}
+
+	std::string chunkPath ( const std::string &dir, const chunked_array_t &arr, int c, sint64 z, sint64 y, sint64 x )
+	{
+		std::stringstream path;
+		path << dir << "/";
+		if ( arr.ndims == 4 )
+			path << c << arr.separator;
+		path << z << arr.separator << y << arr.separator << x;
+		return path.str();
+	}
+}
+
+
+bool chunkedCodecAvailable ( const std::string &codec )
+{
+	if ( codec == "raw" || codec == "zlib" )
+		return true;
+#ifdef IIM_WITH_ZSTD
+	if ( codec == "zstd" )
+		return true;
+#endif
+#ifdef IIM_WITH_LZ4
+	if ( codec == "lz4" )
+		return true;
+#endif
+#ifdef IIM_WITH_BLOSC
+	if ( codec == "blosc" )
+		return true;
+#endif
+	return false;
+}
+
+
+void chunkedWriteMetadata ( const std::string &dir, const chunked_array_t &arr ) throw (IOException)
+{
+    /**/iim::debug(iim::LEV3, strprintf("dir=%s, codec=%s", dir.c_str(), arr.codec.c_str()).c_str(), __iim__current__function__);
+
+	if ( !chunkedCodecAvailable(arr.codec) )
+		throw IOException(strprintf("codec \"%s\" is not available", arr.codec.c_str()), __iim__current__function__);
+	if ( arr.bytes_chan != 1 && arr.bytes_chan != 2 )
+		throw IOException(strprintf("unsupported number of bytes per channel (%d)", arr.bytes_chan), __iim__current__function__);
+	if ( !check_and_make_dir(dir.c_str()) )
+		throw IOException(strprintf("unable to create DIR = \"%s\"", dir.c_str()), __iim__current__function__);
+
+	std::string compressor;
+	if ( arr.codec == "raw" )
+		compressor = "null";
+	else if ( arr.codec == "lz4" )
+		compressor = strprintf("{\"id\": \"lz4\", \"acceleration\": %d}", arr.level);
+	else if ( arr.codec == "blosc" )
+		compressor = strprintf("{\"id\": \"blosc\", \"cname\": \"lz4\", \"clevel\": %d, \"shuffle\": %d, \"blocksize\": 0}", arr.level, arr.shuffle ? 1 : 0);
+	else
+		compressor = strprintf("{\"id\": \"%s\", \"level\": %d}", arr.codec.c_str(), arr.level);
+
+	std::stringstream zarray;
+	zarray << "{\n"
+		   << "    \"zarr_format\": 2,\n"
+		   << "    \"shape\": [" << arr.dims[0] << ", " << arr.dims[1] << ", " << arr.dims[2] << ", " << arr.dims[3] << "],\n"
+		   << "    \"chunks\": [" << arr.chunk_dims[0] << ", " << arr.chunk_dims[1] << ", " << arr.chunk_dims[2] << ", " << arr.chunk_dims[3] << "],\n"
+		   << "    \"dtype\": \"" << (arr.bytes_chan == 1 ? "|u1" : "<u2") << "\",\n"
+		   << "    \"compressor\": " << compressor << ",\n"
+		   << "    \"fill_value\": 0,\n"
+		   << "    \"order\": \"C\",\n"
+		   << "    \"filters\": " << (outerShuffle(arr) ? strprintf("[{\"id\": \"shuffle\", \"elementsize\": %d}]", arr.bytes_chan) : std::string("null")) << ",\n"
+		   << "    \"dimension_separator\": \"" << arr.separator << "\"\n"
+		   << "}\n";
+	writeTextFile(dir + "/.zarray", zarray.str());
+
+	writeTextFile(dir + "/.zattrs", strprintf("{\n    \"voxel_size_um\": [%f, %f, %f],\n    \"origin_mm\": [%f, %f, %f]\n}\n",
+		arr.vxl[0], arr.vxl[1], arr.vxl[2], arr.org[0], arr.org[1], arr.org[2]));
+}
+
+
+void chunkedReadMetadata ( const std::string &dir, chunked_array_t &arr ) throw (IOException)
+{
+    /**/iim::debug(iim::LEV3, strprintf("dir=%s", dir.c_str()).c_str(), __iim__current__function__);
+
+	std::string zarray = readTextFile(dir + "/.zarray");
+
+	if ( jsonGet(zarray,"zarr_format") != "2" )
+		throw IOException(strprintf("\"%s\" is not a Zarr v2 array", dir.c_str()), __iim__current__function__);
+	if ( jsonString(jsonGet(zarray,"order")) != "C" )
+		throw IOException("only C order is supported", __iim__current__function__);
+
+	std::vector<double> shape  = jsonNumbers(jsonGet(zarray,"shape"));
+	std::vector<double> chunks = jsonNumbers(jsonGet(zarray,"chunks"));
+	arr.ndims = (int) shape.size();
+	if ( shape.size() == 3 && chunks.size() == 3 ) { // single channel, chunk keys without channel index
+		shape.insert(shape.begin(),1.0);
+		chunks.insert(chunks.begin(),1.0);
+	}
+	if ( shape.size() != 4 || chunks.size() != 4 || chunks[0] != 1 )
+		throw IOException("only arrays with dimensions (C, D, V, H) and one channel per chunk are supported", __iim__current__function__);
+	for ( int i=0; i<4; i++ ) {
+		arr.dims[i] = (sint64) shape[i];
+		arr.chunk_dims[i] = (int) chunks[i];
+		if ( arr.dims[i] <= 0 || arr.chunk_dims[i] <= 0 )
+			throw IOException("invalid array or chunk dimensions", __iim__current__function__);
+	}
+
+	std::string dtype = jsonString(jsonGet(zarray,"dtype"));
+	if ( dtype == "|u1" || dtype == "<u1" )
+		arr.bytes_chan = 1;
+	else if ( dtype == "<u2" )
+		arr.bytes_chan = 2;
+	else
+		throw IOException(strprintf("unsupported data type \"%s\"", dtype.c_str()), __iim__current__function__);
+
+	std::string compressor = jsonGet(zarray,"compressor");
+	std::string filters = jsonGet(zarray,"filters");
+	arr.shuffle = false;
+	if ( compressor.empty() || compressor == "null" ) {
+		arr.codec = "raw";
+		arr.level = 0;
+	}
+	else {
+		arr.codec = jsonString(jsonGet(compressor,"id"));
+		if ( arr.codec == "gzip" )
+			throw IOException("gzip codec is not supported, use zlib", __iim__current__function__);
+		arr.level = atoi(jsonGet(compressor, arr.codec == "lz4" ? "acceleration" : (arr.codec == "blosc" ? "clevel" : "level")).c_str());
+		if ( arr.codec == "blosc" )
+			arr.shuffle = atoi(jsonGet(compressor,"shuffle").c_str()) != 0;
+	}
+	if ( !filters.empty() && filters != "null" ) {
+		if ( jsonString(jsonGet(filters.substr(filters.find('{')),"id")) != "shuffle" || filters.find('{',filters.find('}')) != std::string::npos )
+			throw IOException(strprintf("unsupported filters %s", filters.c_str()), __iim__current__function__);
+		arr.shuffle = true;
+	}
+	if ( !chunkedCodecAvailable(arr.codec) )
+		throw IOException(strprintf("codec \"%s\" is not available", arr.codec.c_str()), __iim__current__function__);
+
+	std::string separator = jsonString(jsonGet(zarray,"dimension_separator"));
+	arr.separator = separator.empty() ? '.' : separator[0];
+
+	// voxel size and origin are optional
+	arr.vxl[0] = arr.vxl[1] = arr.vxl[2] = 1.0f;
+	arr.org[0] = arr.org[1] = arr.org[2] = 0.0f;
+	if ( isFile(dir + "/.zattrs") ) {
+		std::string zattrs = readTextFile(dir + "/.zattrs");
+		std::vector<double> vxl = jsonNumbers(jsonGet(zattrs,"voxel_size_um"));
+		std::vector<double> org = jsonNumbers(jsonGet(zattrs,"origin_mm"));
+		for ( int i=0; i<3 && vxl.size() == 3; i++ )
+			arr.vxl[i] = (float) vxl[i];
+		for ( int i=0; i<3 && org.size() == 3; i++ )
+			arr.org[i] = (float) org[i];
+	}
+}
+
+
+void chunkedWriteGroup ( const std::string &dir, const std::vector<std::string> &arrays, const std::vector<float> &scales ) throw (IOException)
+{
+    /**/iim::debug(iim::LEV3, strprintf("dir=%s, arrays=%d", dir.c_str(), (int)arrays.size()).c_str(), __iim__current__function__);
+
+	writeTextFile(dir + "/.zgroup", "{\n    \"zarr_format\": 2\n}\n");
+
+	std::stringstream zattrs;
+	zattrs << "{\n"
+		   << "    \"multiscales\": [{\n"
+		   << "        \"version\": \"0.4\",\n"
+		   << "        \"axes\": [{\"name\": \"c\", \"type\": \"channel\"}, {\"name\": \"z\", \"type\": \"space\", \"unit\": \"micrometer\"}, "
+		   <<                    "{\"name\": \"y\", \"type\": \"space\", \"unit\": \"micrometer\"}, {\"name\": \"x\", \"type\": \"space\", \"unit\": \"micrometer\"}],\n"
+		   << "        \"datasets\": [";
+	for ( size_t i=0; i<arrays.size(); i++ )
+		zattrs << (i ? ",\n                     " : "")
+			   << "{\"path\": \"" << arrays[i] << "\", \"coordinateTransformations\": [{\"type\": \"scale\", \"scale\": [1.0, "
+			   << scales[3*i] << ", " << scales[3*i+1] << ", " << scales[3*i+2] << "]}]}";
+	zattrs << "]\n"
+		   << "    }]\n"
+		   << "}\n";
+	writeTextFile(dir + "/.zattrs", zattrs.str());
+}
+
+
+void chunkedMakeChunkDirs ( const std::string &dir, int c, sint64 z, sint64 y ) throw (IOException)
+{
+	std::stringstream path;
+	path << dir << "/" << c;
+	if ( check_and_make_dir(path.str().c_str()) ) {
+		path << "/" << z;
+		if ( check_and_make_dir(path.str().c_str()) ) {
+			path << "/" << y;
+			if ( check_and_make_dir(path.str().c_str()) )
+				return;
+		}
+	}
+	throw IOException(strprintf("unable to create DIR = \"%s\"", path.str().c_str()), __iim__current__function__);
+}
+
+
+void chunkedWriteChunk ( const std::string &dir, const chunked_array_t &arr, int c, sint64 z, sint64 y, sint64 x, const uint8 *data ) throw (IOException)
+{
+	sint64 n = arr.chunkBytes();
+	std::vector<uint8> encoded;
+	if ( outerShuffle(arr) ) {
+		std::vector<uint8> shuffled(n);
+		shuffle(data,&shuffled[0],n,arr.bytes_chan);
+		encode(arr,&shuffled[0],n,encoded);
+	}
+	else
+		encode(arr,data,n,encoded);
+
+	std::string fname = chunkPath(dir,arr,c,z,y,x);
+	FILE *f = fopen(fname.c_str(),"wb");
+	if ( !f )
+		throw IOException(strprintf("cannot create chunk file \"%s\"", fname.c_str()), __iim__current__function__);
+	size_t written = encoded.empty() ? 0 : fwrite(&encoded[0],1,encoded.size(),f);
+	fclose(f);
+	if ( written != encoded.size() )
+		throw IOException(strprintf("cannot write chunk file \"%s\"", fname.c_str()), __iim__current__function__);
+}
+
+
+bool chunkedReadChunk ( const std::string &dir, const chunked_array_t &arr, int c, sint64 z, sint64 y, sint64 x, uint8 *data ) throw (IOException)
+{
+	sint64 n = arr.chunkBytes();
+	std::string fname = chunkPath(dir,arr,c,z,y,x);
+	FILE *f = fopen(fname.c_str(),"rb");
+	if ( !f ) {
+		memset(data,0,n);
+		return false;
+	}
+	std::vector<uint8> encoded;
+	fseek(f,0,SEEK_END);
+	long size = ftell(f);
+	fseek(f,0,SEEK_SET);
+	if ( size > 0 ) {
+		encoded.resize(size);
+		if ( fread(&encoded[0],1,size,f) != (size_t)size ) {
+			fclose(f);
+			throw IOException(strprintf("cannot read chunk file \"%s\"", fname.c_str()), __iim__current__function__);
+		}
+	}
+	fclose(f);
+
+	if ( outerShuffle(arr) ) {
+		std::vector<uint8> shuffled(n);
+		decode(arr,encoded,&shuffled[0],n);
+		unshuffle(&shuffled[0],data,n,arr.bytes_chan);
+	}
+	else
+		decode(arr,encoded,data,n);
+	return true;
+}
@@ -0,0 +1,255 @@
+//------------------------------------------------------------------------------------------------
+// Copyright (c) 2012  Alessandro Bria and Giulio Iannello (University Campus Bio-Medico of Rome).  
+// All rights reserved.
+//------------------------------------------------------------------------------------------------
+
+/*******************************************************************************************************************************************************************************************
+*    LICENSE NOTICE
+********************************************************************************************************************************************************************************************
+*    By downloading/using/running/editing/changing any portion of codes in this package you agree to this license. If you do not agree to this license, do not download/use/run/edit/change
+*    this code.
+********************************************************************************************************************************************************************************************
+*    1. This material is free for non-profit research, but needs a special license for any commercial purpose. Please contact Alessandro Bria at a.bria@unicas.it or Giulio Iannello at 
+*       g.iannello@unicampus.it for further details.
+*    2. You agree to appropriately cite this work in your related studies and publications.
+*    3. This material is provided by  the copyright holders (Alessandro Bria  and  Giulio Iannello),  University Campus Bio-Medico and contributors "as is" and any express or implied war-
+*       ranties, including, but  not limited to,  any implied warranties  of merchantability,  non-infringement, or fitness for a particular purpose are  disclaimed. In no event shall the
+*       copyright owners, University Campus Bio-Medico, or contributors be liable for any direct, indirect, incidental, special, exemplary, or  consequential  damages  (including, but not 
+*       limited to, procurement of substitute goods or services; loss of use, data, or profits;reasonable royalties; or business interruption) however caused  and on any theory of liabil-
+*       ity, whether in contract, strict liability, or tort  (including negligence or otherwise) arising in any way out of the use of this software,  even if advised of the possibility of
+*       such damage.
+*    4. Neither the name of University  Campus Bio-Medico of Rome, nor Alessandro Bria and Giulio Iannello, may be used to endorse or  promote products  derived from this software without
+*       specific prior written permission.
+********************************************************************************************************************************************************************************************/
+
+#include <string.h>
+#include <vector>
+#include "ChunkedVolume.h"
+#include "RawFmtMngr.h"
+
+#ifdef _VAA3D_TERAFLY_PLUGIN_MODE
+#include <QThreadPool>
+#include <QRunnable>
+#endif
+
+using namespace std;
+using namespace iim;
+
+namespace
+{
+	// decodes the chunks of one row (channel, layer and row of chunks are fixed) and copies their
+	// intersection with the subvolume into the output buffer
+	class ChunkRowLoader
+#ifdef _VAA3D_TERAFLY_PLUGIN_MODE
+		: public QRunnable
+#endif
+	{
+		public:
+
+			const std::string *dir;
+			const chunked_array_t *array;
+			int c, ci;                          // channel of the array and channel of the output buffer
+			sint64 cz, cy, cx0, cx1;            // chunks [cx0,cx1) of row cy of layer cz are loaded
+			int V0, V1, H0, H1, D0, D1;
+			uint8 *subvol;
+			std::string error;                  // empty if the job succeeded
+
+			ChunkRowLoader(){
+#ifdef _VAA3D_TERAFLY_PLUGIN_MODE
+				setAutoDelete(false);
+#endif
+			}
+
+			void run()
+			{
+				try
+				{
+					int B = array->bytes_chan;
+					sint64 cd = array->chunk_dims[1], cv = array->chunk_dims[2], ch = array->chunk_dims[3];
+					sint64 sbv_height = V1 - V0, sbv_width = H1 - H0, sbv_depth = D1 - D0;
+					std::vector<uint8> chunk(array->chunkBytes());
+
+					sint64 z0 = cz*cd, y0 = cy*cv;
+					sint64 zs = std::max<sint64>(D0,z0), ze = std::min<sint64>(D1,z0+cd);
+					sint64 ys = std::max<sint64>(V0,y0), ye = std::min<sint64>(V1,y0+cv);
+					for ( sint64 cx=cx0; cx<cx1; cx++ ) {
+						chunkedReadChunk(*dir,*array,c,cz,cy,cx,&chunk[0]); // missing chunks are read as zeros
+						sint64 x0 = cx*ch;
+						sint64 xs = std::max<sint64>(H0,x0), xe = std::min<sint64>(H1,x0+ch);
+						for ( sint64 z=zs; z<ze; z++ )
+							for ( sint64 y=ys; y<ye; y++ )
+								memcpy(subvol + (((ci*sbv_depth + (z-D0))*sbv_height + (y-V0))*sbv_width + (xs-H0))*B,
+									   &chunk[0] + (((z-z0)*cv + (y-y0))*ch + (xs-x0))*B, (xe-xs)*B);
+					}
+				}
+				catch(IOException & ex) { error = ex.what(); }
+				catch(...)              { error = "unknown error"; }
+			}
+	};
+}
+
+ChunkedVolume::ChunkedVolume(const char* _root_dir)  throw (IOException)
+: VirtualVolume(_root_dir)
+{
+	/**/iim::debug(iim::LEV3, strprintf("_root_dir=%s", _root_dir).c_str(), __iim__current__function__);
+
+	chunkedReadMetadata(_root_dir,array);
+	if ( array.dims[1] > 0xFFFFFFFF || array.dims[2] > 0xFFFFFFFF || array.dims[3] > 0xFFFFFFFF )
+		throw IOException(strprintf("in ChunkedVolume::ChunkedVolume: array \"%s\" is too large", _root_dir));
+
+	DIM_D = (uint32) array.dims[1];
+	DIM_V = (uint32) array.dims[2];
+	DIM_H = (uint32) array.dims[3];
+	VXL_D = array.vxl[0];
+	VXL_V = array.vxl[1];
+	VXL_H = array.vxl[2];
+	ORG_D = array.org[0];
+	ORG_V = array.org[1];
+	ORG_H = array.org[2];
+
+	initChannels();
+}
+
+ChunkedVolume::~ChunkedVolume(void)
+{
+	/**/iim::debug(iim::LEV3, 0, __iim__current__function__);
+}
+
+void ChunkedVolume::initChannels ( ) throw (IOException)
+{
+	/**/iim::debug(iim::LEV3, 0, __iim__current__function__);
+
+	DIM_C = (int) array.dims[0];
+	BYTESxCHAN = array.bytes_chan;
+
+	n_active = DIM_C;
+	active = new uint32[n_active];
+	for ( int c=0; c<DIM_C; c++ )
+		active[c] = c; // all channels are assumed active
+}
+
+bool ChunkedVolume::isChunkedArray(const std::string &dir)
+{
+	return isFile(dir + "/.zarray");
+}
+
+real32 *ChunkedVolume::loadSubvolume_to_real32(int V0,int V1, int H0, int H1, int D0, int D1)  throw (IOException)
+{
+	/**/iim::debug(iim::LEV3, strprintf("V0=%d, V1=%d, H0=%d, H1=%d, D0=%d, D1=%d", V0, V1, H0, H1, D0, D1).c_str(), __iim__current__function__);
+
+	// the first active channel, with intensities scaled to [0,1]
+	int channels = 0;
+	uint8 *subvol = loadSubvolume_to_UINT8(V0,V1,H0,H1,D0,D1,&channels,iim::NATIVE_RTYPE);
+
+	V0 = V0 < 0 ? 0 : V0;
+	H0 = H0 < 0 ? 0 : H0;
+	D0 = D0 < 0 ? 0 : D0;
+	V1 = (V1 < 0 || V1 > (int)DIM_V) ? DIM_V : V1;
+	H1 = (H1 < 0 || H1 > (int)DIM_H) ? DIM_H : H1;
+	D1 = (D1 < 0 || D1 > (int)DIM_D) ? DIM_D : D1;
+	sint64 sbv_ch_dim = ((sint64)(V1 - V0)) * (H1 - H0) * (D1 - D0);
+
+	real32 *buf = new real32[sbv_ch_dim];
+	if ( BYTESxCHAN == 1 )
+		for ( sint64 i=0; i<sbv_ch_dim; i++ )
+			buf[i] = subvol[i] / 255.0f;
+	else {
+		uint16 *subvol16 = (uint16 *) subvol;
+		for ( sint64 i=0; i<sbv_ch_dim; i++ )
+			buf[i] = subvol16[i] / 65535.0f;
+	}
+	delete[] subvol;
+
+	return buf;
+}
+
+uint8 *ChunkedVolume::loadSubvolume_to_UINT8(int V0,int V1, int H0, int H1, int D0, int D1, int *channels, int ret_type) throw (IOException)
+{
+	/**/iim::debug(iim::LEV3, strprintf("V0=%d, V1=%d, H0=%d, H1=%d, D0=%d, D1=%d, *channels=%d, ret_type=%d", V0, V1, H0, H1, D0, D1, channels ? *channels : -1, ret_type).c_str(), __iim__current__function__);
+
+	if ( (ret_type != iim::NATIVE_RTYPE) && (ret_type != iim::DEF_IMG_DEPTH) ) {
+		// return type should be converted, but not to 8 bits per channel
+		throw IOException(strprintf("in ChunkedVolume::loadSubvolume_to_UINT8: non supported return type (%d bits) - native type is %d bits", ret_type, 8*BYTESxCHAN));
+	}
+
+	// reduction factor to be applied to the loaded buffer
+	int red_factor = (ret_type == iim::NATIVE_RTYPE) ? 1 : ((8 * BYTESxCHAN) / ret_type);
+
+	//initializations
+	V0 = V0 < 0 ? 0 : V0;
+	H0 = H0 < 0 ? 0 : H0;
+	D0 = D0 < 0 ? 0 : D0;
+	V1 = (V1 < 0 || V1 > (int)DIM_V) ? DIM_V : V1;
+	H1 = (H1 < 0 || H1 > (int)DIM_H) ? DIM_H : H1;
+	D1 = (D1 < 0 || D1 > (int)DIM_D) ? DIM_D : D1;
+
+	//checking that the interval is valid
+	if(V1-V0 <=0 || H1-H0 <= 0 || D1-D0 <= 0)
+		throw IOException("in ChunkedVolume::loadSubvolume_to_UINT8: invalid subvolume intervals");
+
+	//computing dimensions
+	sint64 sbv_ch_dim = ((sint64)(V1 - V0)) * (H1 - H0) * (D1 - D0);
+	uint8 *subvol = new uint8[n_active*sbv_ch_dim*BYTESxCHAN];
+
+	// one job per row of chunks intersecting the subvolume
+	std::string dir = root_dir;
+	std::vector<ChunkRowLoader*> jobs;
+	for ( int ci=0; ci<(int)n_active; ci++ )
+		for ( sint64 cz=D0/array.chunk_dims[1]; cz<=(D1-1)/array.chunk_dims[1]; cz++ )
+			for ( sint64 cy=V0/array.chunk_dims[2]; cy<=(V1-1)/array.chunk_dims[2]; cy++ ) {
+				ChunkRowLoader *job = new ChunkRowLoader();
+				job->dir = &dir;
+				job->array = &array;
+				job->c = active[ci];
+				job->ci = ci;
+				job->cz = cz;
+				job->cy = cy;
+				job->cx0 = H0/array.chunk_dims[3];
+				job->cx1 = (H1-1)/array.chunk_dims[3] + 1;
+				job->V0 = V0; job->V1 = V1;
+				job->H0 = H0; job->H1 = H1;
+				job->D0 = D0; job->D1 = D1;
+				job->subvol = subvol;
+				jobs.push_back(job);
+			}
+
+	// jobs write disjoint regions of the output buffer
+#ifdef _VAA3D_TERAFLY_PLUGIN_MODE
+	if ( jobs.size() > 1 ) {
+		QThreadPool pool;
+		for ( size_t i=0; i<jobs.size(); i++ )
+			pool.start(jobs[i]);
+		pool.waitForDone();
+	}
+	else
+#endif
+	for ( size_t i=0; i<jobs.size(); i++ )
+		jobs[i]->run();
+
+	std::string error;
+	for ( size_t i=0; i<jobs.size(); i++ ) {
+		if ( error.empty() && !jobs[i]->error.empty() )
+			error = jobs[i]->error;
+		delete jobs[i];
+	}
+	if ( !error.empty() ) {
+		delete[] subvol;
+		throw IOException(strprintf("in ChunkedVolume::loadSubvolume_to_UINT8: %s", error.c_str()));
+	}
+
+	//returning outputs
+	if(channels)
+		*channels = (int)n_active;
+
+	if ( red_factor > 1 ) { // the buffer has to be reduced
+		char *err_rawfmt;
+		if ( (err_rawfmt = convert2depth8bits(red_factor,sbv_ch_dim,n_active,subvol)) != 0  ) {
+			char err_msg[STATIC_STRINGS_SIZE];
+			sprintf(err_msg,"ChunkedVolume::loadSubvolume_to_UINT8: %s", err_rawfmt);
+			delete[] subvol;
+			throw IOException(err_msg);
+		}
+	}
+
+	return subvol;
+}
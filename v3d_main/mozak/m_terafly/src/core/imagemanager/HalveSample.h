@@ -0,0 +1,65 @@
+//------------------------------------------------------------------------------------------------
+// Copyright (c) 2012  Alessandro Bria and Giulio Iannello (University Campus Bio-Medico of Rome).  
+// All rights reserved.
+//------------------------------------------------------------------------------------------------
+
+/*******************************************************************************************************************************************************************************************
+*    LICENSE NOTICE
+********************************************************************************************************************************************************************************************
+*    By downloading/using/running/editing/changing any portion of codes in this package you agree to this license. If you do not agree to this license, do not download/use/run/edit/change
+*    this code.
+********************************************************************************************************************************************************************************************
+*    1. This material is free for non-profit research, but needs a special license for any commercial purpose. Please contact Alessandro Bria at a.bria@unicas.it or Giulio Iannello at 
+*       g.iannello@unicampus.it for further details.
+*    2. You agree to appropriately cite this work in your related studies and publications.
+*    3. This material is provided by  the copyright holders (Alessandro Bria  and  Giulio Iannello),  University Campus Bio-Medico and contributors "as is" and any express or implied war-
+*       ranties, including, but  not limited to,  any implied warranties  of merchantability,  non-infringement, or fitness for a particular purpose are  disclaimed. In no event shall the
+*       copyright owners, University Campus Bio-Medico, or contributors be liable for any direct, indirect, incidental, special, exemplary, or  consequential  damages  (including, but not 
+*       limited to, procurement of substitute goods or services; loss of use, data, or profits;reasonable royalties; or business interruption) however caused  and on any theory of liabil-
+*       ity, whether in contract, strict liability, or tort  (including negligence or otherwise) arising in any way out of the use of this software,  even if advised of the possibility of
+*       such damage.
+*    4. Neither the name of University  Campus Bio-Medico of Rome, nor Alessandro Bria and Giulio Iannello, may be used to endorse or  promote products  derived from this software without
+*       specific prior written permission.
+********************************************************************************************************************************************************************************************/
+
+#ifndef _IIM_HALVE_SAMPLE_H
+#define _IIM_HALVE_SAMPLE_H
+
+#include "IM_config.h"
+
+/*******************************************************************************************************************************
+* Halving kernels used to build resolution pyramids.
+* Each kernel downsamples the given image at a halved frequency (2x2x2 voxels, or 2x2 pixels for the 2D variants) either by
+* mean or by max. The image is overwritten in order to store its halvesampled version without allocating any additional
+* resources. Results are identical to the per-voxel loops they replace, whatever instruction set is used:
+* - real32 mean is computed with the same summation order and is then divided by 8 (or 4)
+* - integer mean is rounded to the nearest integer (halfway cases away from zero), as iim::round does
+* The instruction set is selected at runtime among the ones supported by both the build and the running CPU.
+*******************************************************************************************************************************/
+namespace IconImageManager
+{
+    // instruction sets available to the halving kernels (in increasing order of preference)
+    enum halve_isa { HALVE_ISA_SCALAR, HALVE_ISA_SSE2, HALVE_ISA_AVX2 };
+
+    // best instruction set supported by both the build and the running CPU
+    halve_isa halveISAdetected();
+
+    // instruction set currently used by the halving kernels (default: halveISAdetected())
+    halve_isa halveISA();
+
+    // force the instruction set used by the halving kernels (e.g. for benchmarking), clamped to halveISAdetected()
+    void setHalveISA(halve_isa isa);
+
+    // instruction set printable name
+    const char* halveISAname(halve_isa isa);
+
+    // 2x2x2 halving of a single-channel 3D image (by max if 'by_max' is true, otherwise by mean)
+    void halveSample3D(uint8*  img, sint64 height, sint64 width, sint64 depth, bool by_max = false);
+    void halveSample3D(uint16* img, sint64 height, sint64 width, sint64 depth, bool by_max = false);
+    void halveSample3D(real32* img, sint64 height, sint64 width, sint64 depth, bool by_max = false);
+
+    // 2x2 halving of each slice of a single-channel 3D image (by max if 'by_max' is true, otherwise by mean)
+    void halveSample2D(real32* img, sint64 height, sint64 width, sint64 depth, bool by_max = false);
+}
+
+#endif //_IIM_HALVE_SAMPLE_H
@@ -36,12 +36,19 @@
 */
 
 #include "Tiff3DMngr.h"
+#include "IM_config.h"
 #include <stdlib.h> // needed by clang: defines size_t
 #include <string.h>
+#include <stdio.h>
+#include <vector>
+#include <algorithm>
 #include "tiffio.h"
 
 #ifdef _VAA3D_TERAFLY_PLUGIN_MODE
 #include <QElapsedTimer>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QSemaphore>
 #include "PLog.h"
 #include "COperation.h"
 #endif
@@ -70,6 +77,227 @@ void swap4bytes(void *targetp)
     *(tp+2) = a;
 }
 
+/* decodes n_pages consecutive pages starting from the current directory of input into buf
+ * and returns the number of pages actually read
+ */
+static
+int readTiff3DPages ( TIFF *input, unsigned char *buf, unsigned int img_width, uint32 rps, uint16 spp, uint16 bpp, uint16 comp,
+					  int StripsPerImage, int LastStripSize, int n_pages ) {
+	int page=0;
+	do{
+
+		for (int i=0; i < StripsPerImage-1; i++){
+			if (comp==1) {
+				TIFFReadRawStrip(input, i, buf, spp * rps * img_width * (bpp/8));
+				buf = buf + spp * rps * img_width * (bpp/8);
+			}
+			else{
+				TIFFReadEncodedStrip(input, i, buf, spp * rps * img_width * (bpp/8));
+				buf = buf + spp * rps * img_width * (bpp/8);
+			}
+		}
+
+		if (comp==1) {
+			TIFFReadRawStrip(input, StripsPerImage-1, buf, spp * LastStripSize * img_width * (bpp/8));
+		}
+		else{
+			TIFFReadEncodedStrip(input, StripsPerImage-1, buf, spp * LastStripSize * img_width * (bpp/8));
+		}
+		buf = buf + spp * LastStripSize * img_width * (bpp/8);
+
+		page++;
+	
+	}while ( page < n_pages && TIFFReadDirectory(input));//while (TIFFReadDirectory(input));
+
+	return page;
+}
+
+/* sets the tags of a page of a 3D image written by this module (one LZW-compressed strip per page) */
+static
+void setTiff3DPageTags ( TIFF *output, int slice, unsigned int img_width, unsigned int img_height, int spp, int bpp, int NPages ) {
+	TIFFSetField(output, TIFFTAG_IMAGEWIDTH, img_width);
+	TIFFSetField(output, TIFFTAG_IMAGELENGTH, img_height);
+	TIFFSetField(output, TIFFTAG_BITSPERSAMPLE, (uint16)bpp); 
+	TIFFSetField(output, TIFFTAG_SAMPLESPERPIXEL, (uint16)spp);
+	TIFFSetField(output, TIFFTAG_ROWSPERSTRIP, img_height);
+	TIFFSetField(output, TIFFTAG_COMPRESSION, COMPRESSION_LZW);
+	//TIFFSetField(output, TIFFTAG_COMPRESSION, COMPRESSION_NONE);
+	TIFFSetField(output, TIFFTAG_PLANARCONFIG,PLANARCONFIG_CONTIG);
+	TIFFSetField(output, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_MINISBLACK);	
+	//TIFFSetField(output, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_RGB);	
+	// We are writing single page of the multipage file 
+	TIFFSetField(output, TIFFTAG_SUBFILETYPE, FILETYPE_PAGE);
+	TIFFSetField(output, TIFFTAG_PAGENUMBER, (uint16)slice, (uint16)NPages); 
+}
+
+/* writes one page (already compressed if raw is true) at the current directory of output and moves to the next one */
+static
+char *writeTiff3DPage ( TIFF *output, int slice, unsigned char *data, tsize_t size, bool raw, unsigned int img_width, unsigned int img_height, int spp, int bpp, int NPages ) {
+	setTiff3DPageTags(output,slice,img_width,img_height,spp,bpp,NPages);
+	if ( (raw ? TIFFWriteRawStrip(output, 0, data, size) : TIFFWriteEncodedStrip(output, 0, data, size)) < 0 )
+		return ((char *) "Cannot write the page.");
+	if ( !TIFFWriteDirectory(output) )
+		return ((char *) "Cannot write a new directory.");
+	return (char *) 0;
+}
+
+#ifdef _VAA3D_TERAFLY_PLUGIN_MODE
+
+/* in-memory TIFF file, used to compress pages independently of the file they are appended to */
+struct MemTiff
+{
+	std::vector<unsigned char> data;
+	size_t pos;
+
+	MemTiff() : pos(0) {}
+};
+
+static tsize_t memTiffRead ( thandle_t fd, tdata_t buf, tsize_t size ) {
+	MemTiff *mem = (MemTiff *) fd;
+	size_t n = (mem->pos < mem->data.size()) ? std::min((size_t) size, mem->data.size() - mem->pos) : 0;
+	if ( n )
+		memcpy(buf, &mem->data[mem->pos], n);
+	mem->pos += n;
+	return (tsize_t) n;
+}
+
+static tsize_t memTiffWrite ( thandle_t fd, tdata_t buf, tsize_t size ) {
+	MemTiff *mem = (MemTiff *) fd;
+	if ( mem->pos + size > mem->data.size() )
+		mem->data.resize(mem->pos + size);
+	memcpy(&mem->data[mem->pos], buf, size);
+	mem->pos += size;
+	return size;
+}
+
+static toff_t memTiffSeek ( thandle_t fd, toff_t off, int whence ) {
+	MemTiff *mem = (MemTiff *) fd;
+	if ( whence == SEEK_CUR )
+		mem->pos += (size_t) off;
+	else if ( whence == SEEK_END )
+		mem->pos = mem->data.size() + (size_t) off;
+	else
+		mem->pos = (size_t) off;
+	return (toff_t) mem->pos;
+}
+
+static int memTiffClose ( thandle_t ) {
+	return 0;
+}
+
+static toff_t memTiffSize ( thandle_t fd ) {
+	return (toff_t) ((MemTiff *) fd)->data.size();
+}
+
+static int memTiffMap ( thandle_t, tdata_t *, toff_t * ) {
+	return 0;
+}
+
+static void memTiffUnmap ( thandle_t, tdata_t, toff_t ) {
+}
+
+/* compresses one page with the codec used by setTiff3DPageTags and returns in strip the compressed bytes */
+static
+char *encodeTiff3DPage ( unsigned char *img, unsigned int img_width, unsigned int img_height, int spp, int bpp, std::vector<unsigned char> &strip ) {
+	MemTiff mem;
+	TIFF *tif = TIFFClientOpen("memory", "w", (thandle_t) &mem, memTiffRead, memTiffWrite, memTiffSeek, memTiffClose, memTiffSize, memTiffMap, memTiffUnmap);
+	if ( !tif )
+		return ((char *) "Cannot create the page in memory.");
+	setTiff3DPageTags(tif, 0, img_width, img_height, spp, bpp, 1);
+	if ( TIFFWriteEncodedStrip(tif, 0, img, img_width * img_height * spp * (bpp/8)) < 0 ) {
+		TIFFClose(tif);
+		return ((char *) "Cannot compress the page.");
+	}
+	TIFFClose(tif);
+
+	mem.pos = 0;
+	tif = TIFFClientOpen("memory", "rm", (thandle_t) &mem, memTiffRead, memTiffWrite, memTiffSeek, memTiffClose, memTiffSize, memTiffMap, memTiffUnmap);
+	if ( !tif )
+		return ((char *) "Cannot read the compressed page.");
+	tsize_t size = TIFFRawStripSize(tif, 0);
+	strip.resize(size > 0 ? (size_t) size : 0);
+	if ( size <= 0 || TIFFReadRawStrip(tif, 0, &strip[0], size) != size ) {
+		TIFFClose(tif);
+		return ((char *) "Cannot read the compressed page.");
+	}
+	TIFFClose(tif);
+
+	return ((char *) 0);
+}
+
+// threads decoding/encoding pages, shared by all the callers (also by the threads reading several files at once, see
+// TiledVolume::loadSubvolume_to_UINT8): a caller only hands pages to the idle ones (QThreadPool::tryStart) and
+// codes the others itself, so that at most iim::TIFF_CODEC_THREADS-1 threads are added to the callers
+Q_GLOBAL_STATIC(QThreadPool, tiff3DCodecThreads)
+
+static
+QThreadPool *tiff3DCodecPool ( ) {
+	QThreadPool *pool = tiff3DCodecThreads();
+	pool->setMaxThreadCount(std::max(iim::TIFF_CODEC_THREADS - 1, 1));
+	return pool;
+}
+
+// a decoder opens the file again and walks its directories up to the first page of its range
+static const int TIFF3D_MIN_PAGES_X_DECODER = 8;
+
+namespace
+{
+	// decodes a range of consecutive pages of a 3D TIFF file with its own handle, since a libtiff handle
+	// cannot be shared between threads
+	class Tiff3DPageDecoder : public QRunnable
+	{
+		public:
+
+			const char *filename;
+			unsigned int first;				// first page to be decoded
+			int n_pages;
+			unsigned char *buf;
+			unsigned int img_width;
+			uint32 rps;
+			uint16 spp, bpp, comp;
+			int StripsPerImage, LastStripSize;
+			int pages_read;
+			QSemaphore *done;				// released when the range has been decoded
+
+			Tiff3DPageDecoder(){ setAutoDelete(false); }
+
+			void run()
+			{
+				pages_read = 0;
+				TIFF *handle = TIFFOpen(filename,"r");
+				if ( handle ) {
+					if ( TIFFSetDirectory(handle, first) )
+						pages_read = readTiff3DPages(handle,buf,img_width,rps,spp,bpp,comp,StripsPerImage,LastStripSize,n_pages);
+					TIFFClose(handle);
+				}
+				done->release();
+			}
+	};
+
+	// compresses one page (see encodeTiff3DPage)
+	class Tiff3DPageEncoder : public QRunnable
+	{
+		public:
+
+			unsigned char *img;
+			unsigned int img_width, img_height;
+			int spp, bpp;
+			std::vector<unsigned char> strip;
+			char *error;
+			QSemaphore *done;				// released when the page has been compressed
+
+			Tiff3DPageEncoder(){ setAutoDelete(false); }
+
+			void run()
+			{
+				error = encodeTiff3DPage(img,img_width,img_height,spp,bpp,strip);
+				done->release();
+			}
+	};
+}
+
+#endif
+
 
 char *loadTiff3D2Metadata ( char * filename, unsigned int &sz0, unsigned int  &sz1, unsigned int  &sz2, unsigned int  &sz3, int &datatype, int &b_swap, void * &fhandle, int &header_len ) {
 
@@ -385,19 +613,7 @@ char *appendSlice2Tiff3DFile ( void *fhandler, int slice, unsigned char *img, un
 
 	TIFFSetDirectory(output,slice); // WARNING: slice must be the first page after the last, otherwise the file can be corrupted
 
-	TIFFSetField(output, TIFFTAG_IMAGEWIDTH, img_width);
-	TIFFSetField(output, TIFFTAG_IMAGELENGTH, img_height);
-	TIFFSetField(output, TIFFTAG_BITSPERSAMPLE, (uint16)bpp); 
-	TIFFSetField(output, TIFFTAG_SAMPLESPERPIXEL, (uint16)spp);
-	TIFFSetField(output, TIFFTAG_ROWSPERSTRIP, img_height);
-	TIFFSetField(output, TIFFTAG_COMPRESSION, COMPRESSION_LZW);
-	//TIFFSetField(output, TIFFTAG_COMPRESSION, COMPRESSION_NONE);
-	TIFFSetField(output, TIFFTAG_PLANARCONFIG,PLANARCONFIG_CONTIG);
-	TIFFSetField(output, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_MINISBLACK);	
-	//TIFFSetField(output, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_RGB);	
-	// We are writing single page of the multipage file 
-	TIFFSetField(output, TIFFTAG_SUBFILETYPE, FILETYPE_PAGE);
-	TIFFSetField(output, TIFFTAG_PAGENUMBER, (uint16)slice, (uint16)NPages); 
+	setTiff3DPageTags(output,slice,img_width,img_height,spp,bpp,NPages);
 
 	TIFFWriteEncodedStrip(output, 0, img, img_width * img_height * spp * (bpp/8));
 	//img +=  img_width * img_height;
@@ -407,6 +623,60 @@ char *appendSlice2Tiff3DFile ( void *fhandler, int slice, unsigned char *img, un
 	return (char *) 0;
 }
 
+char *appendSlices2Tiff3DFile ( void *fhandler, int first, unsigned char *img, unsigned int  img_width, unsigned int  img_height, int spp, int bpp, int NPages, int n_slices ) {
+	TIFF *output = (TIFF *) fhandler;
+	size_t page_size = ((size_t) img_width) * img_height * spp * (bpp/8);
+	char *err_msg = 0;
+
+	// the handle is moved once after the last page, which must be page first-1 (there TIFFSetDirectory fails and
+	// the current directory is the last one): each page written then leaves the handle on the next one
+	if ( TIFFSetDirectory(output,first) || (first > 0 && TIFFCurrentDirectory(output) != (tdir_t) (first - 1)) )
+		return ((char *) "The first slice to be appended does not follow the last page of the file.");
+
+#ifdef _VAA3D_TERAFLY_PLUGIN_MODE
+	int n_threads = std::min(iim::TIFF_CODEC_THREADS, n_slices);
+	if ( n_threads > 1 ) {
+		// pages are compressed in parallel in windows of 2*n_threads pages and then appended in order as raw strips
+		int window = 2 * n_threads;
+		QThreadPool *pool = tiff3DCodecPool();
+		QSemaphore done;
+		std::vector<Tiff3DPageEncoder *> encoders(window);
+		for ( int i=0; i<window; i++ ) {
+			encoders[i] = new Tiff3DPageEncoder();
+			encoders[i]->done = &done;
+		}
+
+		for ( int s0=0; s0<n_slices && !err_msg; s0+=window ) {
+			int n = std::min(window, n_slices - s0);
+			for ( int i=0; i<n; i++ ) {
+				encoders[i]->img = img + (s0 + i) * page_size;
+				encoders[i]->img_width = img_width;
+				encoders[i]->img_height = img_height;
+				encoders[i]->spp = spp;
+				encoders[i]->bpp = bpp;
+				if ( !pool->tryStart(encoders[i]) )
+					encoders[i]->run();
+			}
+			done.acquire(n);
+
+			for ( int i=0; i<n && !err_msg; i++ )
+				if ( (err_msg = encoders[i]->error) == 0 )
+					err_msg = writeTiff3DPage(output,first + s0 + i,&(encoders[i]->strip[0]),(tsize_t) encoders[i]->strip.size(),true,img_width,img_height,spp,bpp,NPages);
+		}
+
+		for ( int i=0; i<window; i++ )
+			delete encoders[i];
+		return err_msg;
+	}
+#endif
+
+	for ( int i=0; i<n_slices; i++ )
+		if ( (err_msg = writeTiff3DPage(output,first + i,img + i * page_size,(tsize_t) page_size,false,img_width,img_height,spp,bpp,NPages)) != 0 )
+			return err_msg;
+
+	return (char *) 0;
+}
+
 char *readTiff3DFile2Buffer ( char *filename, unsigned char *img, unsigned int img_width, unsigned int img_height, unsigned int first, unsigned int last ) {
 
     // 2015-01-30. Alessandro. @ADDED performance (time) measurement in all most time-consuming methods.
@@ -489,38 +759,60 @@ char *readTiff3DFile2Buffer ( void *fhandler, unsigned char *img, unsigned int i
 	if (LastStripSize==0)
 		LastStripSize=rps;
 
-	check=TIFFSetDirectory(input, first);
-	if (!check)
-	{
-		return ((char *) "Cannot open the requested first strip.");
-	}
-
-	unsigned char *buf = img;
+	int n_pages = static_cast<int>(last-first+1);
 	int page=0;
-	do{
 
-		for (int i=0; i < StripsPerImage-1; i++){
-			if (comp==1) {
-				TIFFReadRawStrip(input, i, buf, spp * rps * img_width * (bpp/8));
-				buf = buf + spp * rps * img_width * (bpp/8);
-			}
-			else{
-				TIFFReadEncodedStrip(input, i, buf, spp * rps * img_width * (bpp/8));
-				buf = buf + spp * rps * img_width * (bpp/8);
-			}
+#ifdef _VAA3D_TERAFLY_PLUGIN_MODE
+	// compressed pages are decoded in parallel: the first ranges of consecutive pages are handed to the idle threads
+	// of the codec pool, the caller decodes the remaining pages with its own handle
+	int n_threads = std::min(iim::TIFF_CODEC_THREADS, n_pages / TIFF3D_MIN_PAGES_X_DECODER);
+	if ( comp != COMPRESSION_NONE && n_threads > 1 ) {
+		size_t page_size = ((size_t) spp) * img_width * img_height * (bpp/8);
+		QThreadPool *pool = tiff3DCodecPool();
+		QSemaphore done;
+		std::vector<Tiff3DPageDecoder *> decoders(n_threads - 1);
+		for ( int t=0, p0=0; t<n_threads-1; t++ ) {
+			int n = n_pages / n_threads + (t < n_pages % n_threads ? 1 : 0);
+			decoders[t] = new Tiff3DPageDecoder();
+			decoders[t]->filename = TIFFFileName(input);
+			decoders[t]->first = first + p0;
+			decoders[t]->n_pages = n;
+			decoders[t]->buf = img + p0 * page_size;
+			decoders[t]->img_width = img_width;
+			decoders[t]->rps = rps;
+			decoders[t]->spp = spp;
+			decoders[t]->bpp = bpp;
+			decoders[t]->comp = comp;
+			decoders[t]->StripsPerImage = StripsPerImage;
+			decoders[t]->LastStripSize = LastStripSize;
+			decoders[t]->done = &done;
+			p0 += n;
 		}
 
-		if (comp==1) {
-			TIFFReadRawStrip(input, StripsPerImage-1, buf, spp * LastStripSize * img_width * (bpp/8));
+		int started = 0, p0 = 0;
+		while ( started < n_threads-1 && pool->tryStart(decoders[started]) )
+			p0 += decoders[started++]->n_pages;
+		if ( TIFFSetDirectory(input, first + p0) )
+			page = readTiff3DPages(input,img + p0 * page_size,img_width,rps,spp,bpp,comp,StripsPerImage,LastStripSize,n_pages - p0);
+		done.acquire(started);
+
+		for ( int t=0; t<n_threads-1; t++ ) {
+			if ( t < started )
+				page += decoders[t]->pages_read;
+			delete decoders[t];
 		}
-		else{
-			TIFFReadEncodedStrip(input, StripsPerImage-1, buf, spp * LastStripSize * img_width * (bpp/8));
+	}
+	else
+#endif
+	{
+		check=TIFFSetDirectory(input, first);
+		if (!check)
+		{
+			return ((char *) "Cannot open the requested first strip.");
 		}
-		buf = buf + spp * LastStripSize * img_width * (bpp/8);
 
-		page++;
-	
-	}while ( page < static_cast<int>(last-first+1) && TIFFReadDirectory(input));//while (TIFFReadDirectory(input));
+		page = readTiff3DPages(input,img,img_width,rps,spp,bpp,comp,StripsPerImage,LastStripSize,n_pages);
+	}
 
 	// input file is assumedo ti be already open and it is provided as an handler; the file should be closed by caller
 	//TIFFClose(input);  
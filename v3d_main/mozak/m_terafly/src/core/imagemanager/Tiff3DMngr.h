@@ -91,6 +91,25 @@ char *appendSlice2Tiff3DFile ( void *fhandler, int slice, unsigned char *img, un
  * WARNING: the file is already open and it is not closed after data have been read
  */
 
+char *appendSlices2Tiff3DFile ( void *fhandler, int first, unsigned char *img, unsigned int  img_width, unsigned int  img_height, int spp, int bpp, int NPages, int n_slices );
+/* writes n_slices consecutive slices to a file containing a 3D image
+ * 
+ * fhandler:   handler of the file to be modified
+ * first:      index of the first slice to be appended
+ * img:        pointer to the slices (3D buffer of n_slices * img_width * img_height * spp * (bpp/8) bytes)
+ * img_width:  width of the slices
+ * img_height: height of the slices
+ * spp:        samples per pixel (channels)
+ * bpp:        bits per pixel (pixel depth)
+ * NPages:     total number of pages of the file (when all pages have been appended)
+ * n_slices:   number of slices to be appended
+ *
+ * pages are compressed in parallel by at most iim::TIFF_CODEC_THREADS threads and then written in order;
+ * returns an error if slice first is not the page following the last one of the file
+ *
+ * WARNING: the file is already open and it is not closed after data have been written
+ */
+
 char *readTiff3DFile2Buffer ( char *filename, unsigned char *img, unsigned int img_width, unsigned int img_height, unsigned int first, unsigned int last );
 /* reads a substack from a file containing a 3D image
  * 
@@ -54,14 +54,77 @@
 // Giulio_CV #include <highgui.h>
 
 #include <list>
+#include <vector>
+#include <algorithm>
 #include <fstream>
 #include "ProgressBar.h"
 
 #include "IOPluginAPI.h" // 2015-03-03. Giulio.
 
+#ifdef _VAA3D_TERAFLY_PLUGIN_MODE
+#include <QElapsedTimer>
+#include <QThreadPool>
+#include <QRunnable>
+#include "PLog.h"
+#include "COperation.h"
+#endif
+
 using namespace std;
 using namespace iim;
 
+namespace
+{
+	// extracts the intersection of one file block with the subvolume and copies it into the output buffer;
+	// since exceptions cannot cross thread boundaries, errors are stored and rethrown by loadSubvolume_to_UINT8
+	class TiledBlockReader
+#ifdef _VAA3D_TERAFLY_PLUGIN_MODE
+		: public QRunnable
+#endif
+	{
+		public:
+
+			VirtualFmtMngr *fmtMngr;
+			char slice_fullpath[STATIC_STRINGS_SIZE];
+			const char *filename;
+			int sV0, sV1, sH0, sH1, sD0, sD1;	// vertices of file block
+			unsigned char *buf;
+			int pxl_size;
+			sint64 offs, stridex, stridexy, stridexyz;
+			std::string error;					// empty if the block has been copied
+
+			TiledBlockReader(){
+#ifdef _VAA3D_TERAFLY_PLUGIN_MODE
+				setAutoDelete(false);
+#endif
+			}
+
+			void run()
+			{
+				try
+				{
+					char *err_rawfmt = fmtMngr->copyFileBlock2Buffer(slice_fullpath,sV0,sV1,sH0,sH1,sD0,sD1,buf,pxl_size,offs,stridex,stridexy,stridexyz);
+					if ( err_rawfmt )
+						error = strprintf("error in extracting a block from file %s (%s)", filename, err_rawfmt);
+				}
+				catch(...)
+				{
+					error = strprintf("error in extracting a block from file %s (unable to allocate memory)", filename);
+				}
+			}
+	};
+
+	// readers of one subvolume, deleted when going out of scope (also if an exception is thrown while they are collected)
+	class TiledBlockReaders : public std::vector<TiledBlockReader*>
+	{
+		public:
+
+			~TiledBlockReaders(){
+				for ( size_t i=0; i<size(); i++ )
+					delete (*this)[i];
+			}
+	};
+}
+
 // 2015-04-15. Alessandro. @ADDED definition for default constructor.
 TiledVolume::TiledVolume(void) : VirtualVolume()
 {
@@ -1019,9 +1082,15 @@ iim::uint8* TiledVolume::loadSubvolume_to_UINT8(int V0,int V1, int H0, int H1, i
     subvol_area.H1 = H1;
     subvol_area.V1 = V1;
 
-    char slice_fullpath[STATIC_STRINGS_SIZE];
     bool first_time = true;
 
+    // blocks intersecting the subvolume are first collected and then read by at most iim::IO_THREADS threads
+    // (they write disjoint regions of subvol)
+    #ifdef _VAA3D_TERAFLY_PLUGIN_MODE
+    TERAFLY_TIME_START(TiledLoadSubvolume)
+    #endif
+    TiledBlockReaders readers;
+
 	Segm_t *intersect_segm = BLOCKS[0][0]->Intersects(D0,D1);
 
 	if (intersect_segm) // there is intersection
@@ -1065,7 +1134,10 @@ iim::uint8* TiledVolume::loadSubvolume_to_UINT8(int V0,int V1, int H0, int H1, i
                             catch(...){throw IOException("in TiledVolume::loadSubvolume_to_UINT8: unable to allocate memory");}
 					    }
 						//loading region
-						sprintf(slice_fullpath, "%s/%s/%s", root_dir, BLOCKS[row][col]->getDIR_NAME(), BLOCKS[row][col]->getFILENAMES()[k]);
+						TiledBlockReader *reader = new TiledBlockReader();
+						readers.push_back(reader);
+						sprintf(reader->slice_fullpath, "%s/%s/%s", root_dir, BLOCKS[row][col]->getDIR_NAME(), BLOCKS[row][col]->getFILENAMES()[k]);
+						reader->filename = BLOCKS[row][col]->getFILENAMES()[k];
 						
 						/* rationale (for V dimension, the same for H)
 						 *
@@ -1117,22 +1189,16 @@ iim::uint8* TiledVolume::loadSubvolume_to_UINT8(int V0,int V1, int H0, int H1, i
 						int bD0 = (D0>BLOCKS[row][col]->getBLOCK_ABS_D()[k]) ? 0 : (BLOCKS[row][col]->getBLOCK_ABS_D()[k] - D0);
 						//int bD1 = (D1<(int)(BLOCKS[row][col]->getBLOCK_ABS_D()[k]+BLOCKS[row][col]->getBLOCK_SIZE()[k])) ? (int)sbv_depth : (BLOCKS[row][col]->getBLOCK_ABS_D()[k]+BLOCKS[row][col]->getBLOCK_SIZE()[k] - D0); // unused
 
-						if ( (err_rawfmt = fmtMngr->copyFileBlock2Buffer(
-								slice_fullpath,
-								sV0,sV1,sH0,sH1,sD0,sD1,
-								(unsigned char *)subvol,
-								(int)sbv_bytes_chan, // this is native rtype, it has substituted sizeof(iim::uint8)
-								bH0+bV0*sbv_width+bD0*sbv_width*sbv_height,
-								sbv_width,
-								sbv_width*sbv_height,
-								sbv_width*sbv_height*sbv_depth) ) != 0 ) 
-						{
-                            char err_msg[STATIC_STRINGS_SIZE];
-							sprintf(err_msg,
-								"TiledVolume::loadSubvolume_to_UINT8: error in extracting a block from file %s (%s)", 
-								BLOCKS[row][col]->getFILENAMES()[k], err_rawfmt);
-                            throw IOException(err_msg);
-						}
+						reader->fmtMngr = fmtMngr;
+						reader->sV0 = sV0; reader->sV1 = sV1;
+						reader->sH0 = sH0; reader->sH1 = sH1;
+						reader->sD0 = sD0; reader->sD1 = sD1;
+						reader->buf = (unsigned char *)subvol;
+						reader->pxl_size = (int)sbv_bytes_chan; // this is native rtype, it has substituted sizeof(iim::uint8)
+						reader->offs = bH0+bV0*sbv_width+bD0*sbv_width*sbv_height;
+						reader->stridex = sbv_width;
+						reader->stridexy = sbv_width*sbv_height;
+						reader->stridexyz = sbv_width*sbv_height*sbv_depth;
 					}
 					delete intersect_area;
 				}
@@ -1142,6 +1208,35 @@ iim::uint8* TiledVolume::loadSubvolume_to_UINT8(int V0,int V1, int H0, int H1, i
 	}
 	else
         throw IOException("in TiledVolume::loadSubvolume_to_UINT8: depth interval out of range");
+
+#ifdef _VAA3D_TERAFLY_PLUGIN_MODE
+	int n_threads = (int) std::min<size_t>(readers.size(), (size_t) (IO_THREADS < 1 ? 1 : IO_THREADS));
+	if ( n_threads > 1 ) {
+		QThreadPool pool;
+		pool.setMaxThreadCount(n_threads);
+		for ( size_t i=0; i<readers.size(); i++ )
+			pool.start(readers[i]);
+		pool.waitForDone();
+	}
+	else
+#endif
+	for ( size_t i=0; i<readers.size(); i++ )
+		readers[i]->run();
+
+	std::string error;
+	for ( size_t i=0; i<readers.size(); i++ ) {
+		if ( error.empty() && !readers[i]->error.empty() )
+			error = readers[i]->error;
+	}
+	if ( !error.empty() ) {
+		delete[] subvol;
+		throw IOException(strprintf("TiledVolume::loadSubvolume_to_UINT8: %s", error.c_str()));
+	}
+
+    #ifdef _VAA3D_TERAFLY_PLUGIN_MODE
+    int n_blocks = (int) readers.size();
+    TERAFLY_TIME_STOP(TiledLoadSubvolume, itm::IO, itm::strprintf("loaded subvolume x(%d-%d), y(%d-%d), z(%d-%d) from %d blocks with %d threads", H0, H1, V0, V1, D0, D1, n_blocks, n_threads))
+    #endif
 	
     //returning outputs
     if(channels)
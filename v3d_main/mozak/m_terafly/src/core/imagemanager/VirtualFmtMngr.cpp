@@ -24,6 +24,7 @@
 
 #include "VirtualFmtMngr.h"
 #include "Tiff3DMngr.h"
+#include "BlockCache.h"
 
 using namespace iim;
 
@@ -186,34 +187,22 @@ char *Tiff3DFmtMngr::copyFileBlock2Buffer ( char *filename, int sV0, int sV1, in
                                 unsigned char *buf, int pxl_size, iim::sint64 offs, iim::sint64 stridex, iim::sint64 stridexy, iim::sint64 stridexyz ) {
 
 	char *err_msg;
-	unsigned int sz[4];
-	int datatype;
-	int b_swap;
-	void *fhandle;
-	int header_len;
-	
-	// get metadata
-    if ( (err_msg = loadTiff3D2Metadata(filename,sz[0],sz[1],sz[2],sz[3],datatype,b_swap,fhandle,header_len)) != 0 ) {
-		return ((char *) "in Tiff3DFmtMngr::copyFileBlock2Buffer(...): cannot load metadata of Tiff file");
-	}
-	// fhandle should be left open
 
-	if ( datatype != pxl_size ) {
-		return ((char *) "in Tiff3DFmtMngr::copyFileBlock2Buffer(...): source data type differs from destination pixel size");
+	// decoded slices are shared with the other volumes through the block cache
+	BlockCacheRef slices;
+	if ( (err_msg = loadTiff3DBlock(filename,sD0,sD1-1,slices)) != 0 ) {
+		return err_msg;
 	}
 
-	unsigned char *buf_t = new unsigned char[sz[0] * sz[1] * (sD1 - sD0) * sz[3] * datatype];
-	
-	if ( (err_msg = readTiff3DFile2Buffer(fhandle,buf_t,sz[0],sz[1],sD0,sD1-1,b_swap)) != 0 ) {
-		closeTiff3DFile(fhandle);
-		delete [] buf_t;
-		return err_msg;      
+	unsigned int width = slices.blocks[0]->width;
+	unsigned int height = slices.blocks[0]->height;
+	unsigned int chans = slices.blocks[0]->chans;
+	if ( slices.blocks[0]->bytes_x_chan != pxl_size ) {
+		return ((char *) "in Tiff3DFmtMngr::copyFileBlock2Buffer(...): source data type differs from destination pixel size");
 	}
 
-	closeTiff3DFile(fhandle);
-
-	sint64 s_stridej  = sz[0];
-	sint64 s_strideij = sz[0] * sz[1];
+	sint64 s_stridej  = width;
+	sint64 s_strideij = width * height;
 	sint64 d_stridej  = stridex;
 	sint64 d_strideij = stridexy;
 	
@@ -221,30 +210,30 @@ char *Tiff3DFmtMngr::copyFileBlock2Buffer ( char *filename, int sV0, int sV1, in
 	int dimj = sH1 - sH0;
 	int dimk = sD1 - sD0;
 	
-	if ( sz[3] == 1 ) { // single channeel Tiff
-		VirtualFmtMngr::copyBlock2SubBuf(
-			buf_t + pxl_size*(s_stridej*sV0 + sH0),
-			buf + pxl_size*offs,
-			dimi,dimj,dimk,pxl_size,
-	 		s_stridej,s_strideij,d_stridej,d_strideij
-	 	);
-	 }
-	else if ( sz[3] == 3 ) { // RGB Tiff
-		sint64 d_strideijk = stridexyz;
-		VirtualFmtMngr::copyRGBBlock2Vaa3DRawSubBuf(
-			buf_t + 3*pxl_size*(s_stridej*sV0 + sH0),
-			buf + pxl_size*offs,
-			dimi,dimj,dimk,pxl_size,
-	 		s_stridej,s_strideij,
-			d_stridej,d_strideij,d_strideijk
+	for ( int k=0; k<dimk; k++ ) {
+		unsigned char *buf_t = slices.blocks[k]->data;
+		if ( chans == 1 ) { // single channeel Tiff
+			VirtualFmtMngr::copyBlock2SubBuf(
+				buf_t + pxl_size*(s_stridej*sV0 + sH0),
+				buf + pxl_size*(offs + k*d_strideij),
+				dimi,dimj,1,pxl_size,
+				s_stridej,s_strideij,d_stridej,d_strideij
 			);
+		 }
+		else if ( chans == 3 ) { // RGB Tiff
+			sint64 d_strideijk = stridexyz;
+			VirtualFmtMngr::copyRGBBlock2Vaa3DRawSubBuf(
+				buf_t + 3*pxl_size*(s_stridej*sV0 + sH0),
+				buf + pxl_size*(offs + k*d_strideij),
+				dimi,dimj,1,pxl_size,
+				s_stridej,s_strideij,
+				d_stridej,d_strideij,d_strideijk
+				);
+		}
+		else {
+			return ((char *) "in Tiff3DFmtMngr::copyFileBlock2Buffer(...): unsupported number of channels.");
+		}
 	}
-	else {
-		delete []buf_t;
-		return ((char *) "in Tiff3DFmtMngr::copyFileBlock2Buffer(...): unsupported number of channels.");
-	}
-	 						   
-	delete [] buf_t;
 	
 	return ((char *) 0);
 }
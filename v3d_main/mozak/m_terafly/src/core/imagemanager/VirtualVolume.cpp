@@ -51,9 +51,11 @@
 #include "StackedVolume.h"
 #include "UnstitchedVolume.h"
 #include "BDVVolume.h"
+#include "ChunkedVolume.h"
 #include "RawFmtMngr.h"
 #include "Tiff3DMngr.h"
 #include "TimeSeries.h"
+#include "HalveSample.h"
 #include <typeinfo>
 
 // Giulio_CV #include <cxcore.h>
@@ -673,228 +675,33 @@ void VirtualVolume::saveImage_from_UINT8_to_Tiff3D (int slice, std::string img_p
 **************************************************************************************************************/
 void VirtualVolume::halveSample ( real32* img, int height, int width, int depth, int method )
 {
-	float A,B,C,D,E,F,G,H;
-
-	// indices are sint64 because offsets can be larger that 2^31 - 1
-
-	if ( method == HALVE_BY_MEAN ) {
-
-		for(sint64 z=0; z<depth/2; z++)
-		{
-			for(sint64 i=0; i<height/2; i++)
-			{
-				for(sint64 j=0; j<width/2; j++)
-				{
-					//computing 8-neighbours
-					A = img[2*z*width*height +2*i*width + 2*j];
-					B = img[2*z*width*height +2*i*width + (2*j+1)];
-					C = img[2*z*width*height +(2*i+1)*width + 2*j];
-					D = img[2*z*width*height +(2*i+1)*width + (2*j+1)];
-					E = img[(2*z+1)*width*height +2*i*width + 2*j];
-					F = img[(2*z+1)*width*height +2*i*width + (2*j+1)];
-					G = img[(2*z+1)*width*height +(2*i+1)*width + 2*j];
-					H = img[(2*z+1)*width*height +(2*i+1)*width + (2*j+1)];
-
-					//computing mean
-					img[z*(width/2)*(height/2)+i*(width/2)+j] = (A+B+C+D+E+F+G+H)/(float)8;
-				}
-			}
-		}
-
-	}
-	else if ( method == HALVE_BY_MAX ) {
-
-		for(sint64 z=0; z<depth/2; z++)
-		{
-			for(sint64 i=0; i<height/2; i++)
-			{
-				for(sint64 j=0; j<width/2; j++)
-				{
-					//computing max of 8-neighbours
-					A = img[2*z*width*height + 2*i*width + 2*j];
-					B = img[2*z*width*height + 2*i*width + (2*j+1)];
-					if ( B > A ) A = B;
-					B = img[2*z*width*height + (2*i+1)*width + 2*j];
-					if ( B > A ) A = B;
-					B = img[2*z*width*height + (2*i+1)*width + (2*j+1)];
-					if ( B > A ) A = B;
-					B = img[(2*z+1)*width*height + 2*i*width + 2*j];
-					if ( B > A ) A = B;
-					B = img[(2*z+1)*width*height + 2*i*width + (2*j+1)];
-					if ( B > A ) A = B;
-					B = img[(2*z+1)*width*height + (2*i+1)*width + 2*j];
-					if ( B > A ) A = B;
-					B = img[(2*z+1)*width*height + (2*i+1)*width + (2*j+1)];
-					if ( B > A ) A = B;
-
-					//computing mean
-					img[z*(width/2)*(height/2) + i*(width/2) + j] = A;
-				}
-			}
-		}
-
-	}
-	else {
+	if ( method != HALVE_BY_MEAN && method != HALVE_BY_MAX ) {
 		char buffer[STATIC_STRINGS_SIZE];
 		sprintf(buffer,"in halveSample(...): invalid halving method\n");
         throw IOException(buffer);
 	}
-	
+
+	// vectorized kernels with runtime CPU dispatch (see HalveSample.h)
+	iim::halveSample3D(img, height, width, depth, method == HALVE_BY_MAX);
 }
 
 
 void VirtualVolume::halveSample_UINT8 ( uint8** img, int height, int width, int depth, int channels, int method, int bytes_chan )
 {
+	if ( method != HALVE_BY_MEAN && method != HALVE_BY_MAX ) {
+		char buffer[STATIC_STRINGS_SIZE];
+		sprintf(buffer,"in VirtualVolume::halveSample_UINT8(...): invalid halving method\n");
+        throw IOException(buffer);
+	}
 
-	float A,B,C,D,E,F,G,H;
-
-	// indices are sint64 because offsets can be larger that 2^31 - 1
-
+	// vectorized kernels with runtime CPU dispatch (see HalveSample.h)
 	if ( bytes_chan == 1 ) {
-
-		if ( method == HALVE_BY_MEAN ) {   
-
-			for(sint64 c=0; c<channels; c++)
-			{
-				for(sint64 z=0; z<depth/2; z++)
-				{
-					for(sint64 i=0; i<height/2; i++)
-					{
-						for(sint64 j=0; j<width/2; j++)
-						{
-							//computing 8-neighbours
-							A = img[c][2*z*width*height + 2*i*width + 2*j];
-							B = img[c][2*z*width*height + 2*i*width + (2*j+1)];
-							C = img[c][2*z*width*height + (2*i+1)*width + 2*j];
-							D = img[c][2*z*width*height + (2*i+1)*width + (2*j+1)];
-							E = img[c][(2*z+1)*width*height + 2*i*width + 2*j];
-							F = img[c][(2*z+1)*width*height + 2*i*width + (2*j+1)];
-							G = img[c][(2*z+1)*width*height + (2*i+1)*width + 2*j];
-							H = img[c][(2*z+1)*width*height + (2*i+1)*width + (2*j+1)];
-
-							//computing mean
-                            img[c][z*(width/2)*(height/2) + i*(width/2) + j] = (uint8) iim::round((A+B+C+D+E+F+G+H)/(float)8);
-						}
-					}
-				}
-			}
-		}
-
-		else if ( method == HALVE_BY_MAX ) {
-
 		for(sint64 c=0; c<channels; c++)
-		{
-			for(sint64 z=0; z<depth/2; z++)
-			{
-				for(sint64 i=0; i<height/2; i++)
-				{
-					for(sint64 j=0; j<width/2; j++)
-					{
-						//computing max of 8-neighbours
-						A = img[c][2*z*width*height + 2*i*width + 2*j];
-						B = img[c][2*z*width*height + 2*i*width + (2*j+1)];
-						if ( B > A ) A = B;
-						B = img[c][2*z*width*height + (2*i+1)*width + 2*j];
-						if ( B > A ) A = B;
-						B = img[c][2*z*width*height + (2*i+1)*width + (2*j+1)];
-						if ( B > A ) A = B;
-						B = img[c][(2*z+1)*width*height + 2*i*width + 2*j];
-						if ( B > A ) A = B;
-						B = img[c][(2*z+1)*width*height + 2*i*width + (2*j+1)];
-						if ( B > A ) A = B;
-						B = img[c][(2*z+1)*width*height + (2*i+1)*width + 2*j];
-						if ( B > A ) A = B;
-						B = img[c][(2*z+1)*width*height + (2*i+1)*width + (2*j+1)];
-						if ( B > A ) A = B;
-
-						//computing mean
-                        img[c][z*(width/2)*(height/2) + i*(width/2) + j] = (uint8) iim::round(A);
-					}
-				}
-			}
-		}
-
-		}
-		else {
-			char buffer[STATIC_STRINGS_SIZE];
-			sprintf(buffer,"in VirtualVolume::halveSample_UINT8(...): invalid halving method\n");
-            throw IOException(buffer);
-		}
-
+			iim::halveSample3D(img[c], height, width, depth, method == HALVE_BY_MAX);
 	}
 	else if ( bytes_chan == 2 ) {
-
-		uint16 **img16 = (uint16 **) img;
-
-		if ( method == HALVE_BY_MEAN ) {   
-
-			for(sint64 c=0; c<channels; c++)
-			{
-				for(sint64 z=0; z<depth/2; z++)
-				{
-					for(sint64 i=0; i<height/2; i++)
-					{
-						for(sint64 j=0; j<width/2; j++)
-						{
-							//computing 8-neighbours
-							A = img16[c][2*z*width*height + 2*i*width + 2*j];
-							B = img16[c][2*z*width*height + 2*i*width + (2*j+1)];
-							C = img16[c][2*z*width*height + (2*i+1)*width + 2*j];
-							D = img16[c][2*z*width*height + (2*i+1)*width + (2*j+1)];
-							E = img16[c][(2*z+1)*width*height + 2*i*width + 2*j];
-							F = img16[c][(2*z+1)*width*height + 2*i*width + (2*j+1)];
-							G = img16[c][(2*z+1)*width*height + (2*i+1)*width + 2*j];
-							H = img16[c][(2*z+1)*width*height + (2*i+1)*width + (2*j+1)];
-
-							//computing mean
-                            img16[c][z*(width/2)*(height/2) + i*(width/2) + j] = (uint16) iim::round((A+B+C+D+E+F+G+H)/(float)8);
-						}
-					}
-				}
-			}
-		}
-
-		else if ( method == HALVE_BY_MAX ) {
-
 		for(sint64 c=0; c<channels; c++)
-		{
-			for(sint64 z=0; z<depth/2; z++)
-			{
-				for(sint64 i=0; i<height/2; i++)
-				{
-					for(sint64 j=0; j<width/2; j++)
-					{
-						//computing max of 8-neighbours
-						A = img16[c][2*z*width*height + 2*i*width + 2*j];
-						B = img16[c][2*z*width*height + 2*i*width + (2*j+1)];
-						if ( B > A ) A = B;
-						B = img16[c][2*z*width*height + (2*i+1)*width + 2*j];
-						if ( B > A ) A = B;
-						B = img16[c][2*z*width*height + (2*i+1)*width + (2*j+1)];
-						if ( B > A ) A = B;
-						B = img16[c][(2*z+1)*width*height + 2*i*width + 2*j];
-						if ( B > A ) A = B;
-						B = img16[c][(2*z+1)*width*height + 2*i*width + (2*j+1)];
-						if ( B > A ) A = B;
-						B = img16[c][(2*z+1)*width*height + (2*i+1)*width + 2*j];
-						if ( B > A ) A = B;
-						B = img16[c][(2*z+1)*width*height + (2*i+1)*width + (2*j+1)];
-						if ( B > A ) A = B;
-
-						//computing mean
-                        img[c][z*(width/2)*(height/2) + i*(width/2) + j] = (uint8) iim::round(A);
-					}
-				}
-			}
-		}
-
-		}
-		else {
-			char buffer[STATIC_STRINGS_SIZE];
-			sprintf(buffer,"in VirtualVolume::halveSample_UINT8(...): invalid halving method\n");
-            throw IOException(buffer);
-		}
-
+			iim::halveSample3D((uint16 *) img[c], height, width, depth, method == HALVE_BY_MAX);
 	}
 	else {
 		char buffer[STATIC_STRINGS_SIZE];
@@ -925,6 +732,8 @@ VirtualVolume* VirtualVolume::instance_format(const char* path, std::string form
             volume = new SimpleVolume(path);
         else if(format.compare(TIME_SERIES) == 0)
             volume = new TimeSeries(path);
+        else if(format.compare(CHUNKED_FORMAT) == 0)
+            volume = new ChunkedVolume(path);
         else
             throw IOException(strprintf("in VirtualVolume::instance(): Unsupported format \"%s\" for path \"%s\" which is a directory", format.c_str(), path), __iim__current__function__);
     }
@@ -982,6 +791,8 @@ VirtualVolume* VirtualVolume::instance(const char* path) throw (IOException)
                         volume = new SimpleVolumeRaw(path);
                     else if(format.compare((TimeSeries().getPrintableFormat())) == 0)
                         volume = new TimeSeries(path);
+                    else if(format.compare(CHUNKED_FORMAT) == 0)
+                        volume = new ChunkedVolume(path);
                     else
                         iim::warning(iim::strprintf("Cannot recognize format \"%s\"", format.c_str()).c_str(), __iim__current__function__);
                 }
@@ -992,6 +803,19 @@ VirtualVolume* VirtualVolume::instance(const char* path) throw (IOException)
             }
         }
 
+        // chunked arrays are recognized by their metadata file
+        if(!volume && ChunkedVolume::isChunkedArray(path))
+        {
+            try
+            {
+                volume = new ChunkedVolume(path);
+            }
+            catch(IOException &ex)
+            {
+                debug(LEV3, strprintf("Cannot import <ChunkedVolume> at \"%s\": %s", path, ex.what()).c_str(),__iim__current__function__);
+            }
+        }
+
         if(!volume)
         {
             try
@@ -1143,6 +967,8 @@ VirtualVolume* VirtualVolume::instance(const char* path, std::string format,
             volume = new SimpleVolumeRaw(path);
         else if(format.compare(SIMPLE_FORMAT) == 0)
             volume = new SimpleVolume(path);
+        else if(format.compare(CHUNKED_FORMAT) == 0)
+            volume = new ChunkedVolume(path);
         else
             throw IOException(strprintf("in VirtualVolume::instance(): Unsupported format \"%s\" for path \"%s\" which is a directory", format.c_str(), path), __iim__current__function__);
     }
@@ -1197,6 +1023,8 @@ bool VirtualVolume::isHierarchical(std::string format) throw (iim::IOException)
         return true;
     else if(format.compare(TILED_TIF3D_FORMAT) == 0)
         return true;
+    else if(format.compare(CHUNKED_FORMAT) == 0)
+        return true;
     else if(format.compare(RAW_FORMAT) == 0)
         return false;
     else if(format.compare(TIF3D_FORMAT) == 0)
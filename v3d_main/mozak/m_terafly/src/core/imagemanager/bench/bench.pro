@@ -0,0 +1,12 @@
+# micro-benchmark of the halving kernels (standalone, not part of the TeraFly build)
+TEMPLATE = app
+TARGET = benchmark_halve
+CONFIG += console release
+CONFIG -= qt
+mac {
+    CONFIG -= app_bundle
+}
+HEADERS += ../IM_config.h \
+           ../HalveSample.h
+SOURCES += ../HalveSample.cpp \
+           benchmark_halve.cpp
@@ -0,0 +1,86 @@
+// Micro-benchmark of the halving kernels used to build resolution pyramids (see HalveSample.h).
+// For each data type and halving method, all the instruction sets supported by the running CPU are timed on the same
+// random image and checked to produce the same output of the scalar kernel.
+//
+// usage: benchmark_halve [width height depth [repetitions]]
+
+#include "../HalveSample.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <vector>
+
+using namespace iim;
+
+template <typename T>
+bool benchmark(const char* type_name, T max_value, sint64 width, sint64 height, sint64 depth, int repetitions, bool two_d, bool by_max)
+{
+    sint64 size = width*height*depth;
+    std::vector<T> src(size), img(size), ref;
+    srand(0);
+    for(sint64 i=0; i<size; i++)
+        src[i] = T(max_value * (rand() / (double)RAND_MAX));
+
+    bool ok = true;
+    double t_scalar = 0;
+    for(int isa = HALVE_ISA_SCALAR; isa <= halveISAdetected(); isa++)
+    {
+        setHalveISA(halve_isa(isa));
+        double elapsed = 0;
+        for(int r=0; r<repetitions; r++)
+        {
+            img = src;
+            clock_t start = clock();
+            if(two_d)
+                halveSample2D((real32*)&img[0], height, width, depth, by_max);
+            else
+                halveSample3D(&img[0], height, width, depth, by_max);
+            elapsed += double(clock() - start) / CLOCKS_PER_SEC;
+        }
+        elapsed /= repetitions;
+
+        // output is the first (width/2)*(height/2)*depth' voxels
+        sint64 out_size = (width/2)*(height/2)*(two_d ? depth : depth/2);
+        if(isa == HALVE_ISA_SCALAR)
+        {
+            ref.assign(img.begin(), img.begin() + out_size);
+            t_scalar = elapsed;
+        }
+        bool same = memcmp(&ref[0], &img[0], out_size*sizeof(T)) == 0;
+        ok = ok && same;
+
+        printf("%-7s %s %-4s %-7s %8.2f ms %9.1f MVoxel/s   x%-5.2f %s\n", type_name, two_d ? "2D" : "3D", by_max ? "max" : "mean", halveISAname(halve_isa(isa)),
+               elapsed*1000, size / (elapsed * 1e6), t_scalar / elapsed, same ? "" : "MISMATCH");
+    }
+    return ok;
+}
+
+int main(int argc, char** argv)
+{
+    sint64 width = 1024, height = 1024, depth = 64;
+    int repetitions = 5;
+    if(argc >= 4)
+    {
+        width  = atoi(argv[1]);
+        height = atoi(argv[2]);
+        depth  = atoi(argv[3]);
+    }
+    if(argc >= 5)
+        repetitions = atoi(argv[4]);
+
+    printf("image %lld x %lld x %lld, %d repetitions, detected instruction set: %s\n\n",
+           width, height, depth, repetitions, halveISAname(halveISAdetected()));
+
+    bool ok = true;
+    for(int by_max = 0; by_max <= 1; by_max++)
+    {
+        ok = benchmark<uint8> ("uint8",  255,    width, height, depth, repetitions, false, by_max != 0) && ok;
+        ok = benchmark<uint16>("uint16", 65535,  width, height, depth, repetitions, false, by_max != 0) && ok;
+        ok = benchmark<real32>("real32", 1000.0f, width, height, depth, repetitions, false, by_max != 0) && ok;
+        ok = benchmark<real32>("real32", 1000.0f, width, height, depth, repetitions, true,  by_max != 0) && ok;
+    }
+
+    printf("\n%s\n", ok ? "all kernels match the scalar implementation" : "ERROR: some kernels do not match the scalar implementation");
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -237,29 +237,39 @@ throw (iom::exception)
 
 	buf = raw_img + z0*stridexy + x0*stridex + y0*img_chans*img_bytes_x_chan; // buf points to the first byte to be written
 
-	if ( x0 == 0 && x1 == img_width && y0 == 0 && y1 == img_height ) { // all buffer must be written
-		for ( int i=0; i<(z1-z0); i++, buf += stridexy ) {
-			if ( (err_Tiff3Dfmt = appendSlice2Tiff3DFile((char *)img_path.c_str(),i,buf,img_width,img_height)) != 0 ) {
-				throw iom::exception(iom::strprintf("(%s) unable to write slice %d into file %s",err_Tiff3Dfmt,z0+i,img_path.c_str()), __iom__current__function__);
-			}
-		}
-	}
-	else { // copy to a sub buffer before writing
+	unsigned char *raw_img_ROI = 0;
+	iim::sint64 stridexy_ROI = stridexy;
+	if ( !(x0 == 0 && x1 == img_width && y0 == 0 && y1 == img_height) ) { // copy to a sub buffer before writing
 		iim::sint64 stridex_ROI    = (x1-x0) * img_chans * img_bytes_x_chan;
-		iim::sint64 stridexy_ROI   = stridex_ROI * (y1-y0);
-		unsigned char *raw_img_ROI = new unsigned char[(z1-z0) * (y1-y0) * (x1-x0) * img_chans * img_bytes_x_chan];
-		unsigned char *buf_ROI;
+		stridexy_ROI               = stridex_ROI * (y1-y0);
+		raw_img_ROI = new unsigned char[(z1-z0) * (y1-y0) * (x1-x0) * img_chans * img_bytes_x_chan];
 
 		iim::VirtualFmtMngr::copyBlock2SubBuf(buf,raw_img_ROI,(y1-y0),(x1-x0),(z1-z0),img_bytes_x_chan,stridex,stridexy,stridex_ROI,stridexy_ROI);
 
-		buf_ROI = raw_img_ROI;
-		for ( int i=0; i<(z1-z0); i++, buf_ROI += stridexy_ROI ) {
-			if ( (err_Tiff3Dfmt = appendSlice2Tiff3DFile((char *)img_path.c_str(),i,buf_ROI,(x1-x0),(y1-y0))) != 0 ) {
+		buf = raw_img_ROI;
+	}
+
+	if ( img_chans == 1 || img_chans == 3 ) { // pages are compressed in parallel and written through a single file handle
+		void *fhandle;
+		if ( (err_Tiff3Dfmt = openTiff3DFile((char *)img_path.c_str(),(char *)"w",fhandle)) == 0 ) {
+			err_Tiff3Dfmt = appendSlices2Tiff3DFile(fhandle,0,buf,(x1-x0),(y1-y0),img_chans,8*img_bytes_x_chan,(z1-z0),(z1-z0));
+			closeTiff3DFile(fhandle);
+		}
+		if ( err_Tiff3Dfmt ) {
+			delete []raw_img_ROI;
+			throw iom::exception(iom::strprintf("(%s) unable to write slices [%d,%d) into file %s",err_Tiff3Dfmt,z0,z1,img_path.c_str()), __iom__current__function__);
+		}
+	}
+	else {
+		for ( int i=0; i<(z1-z0); i++, buf += stridexy_ROI ) {
+			if ( (err_Tiff3Dfmt = appendSlice2Tiff3DFile((char *)img_path.c_str(),i,buf,(x1-x0),(y1-y0))) != 0 ) {
+				delete []raw_img_ROI;
 				throw iom::exception(iom::strprintf("(%s) unable to write slice %d into file %s",err_Tiff3Dfmt,z0+i,img_path.c_str()), __iom__current__function__);
 			}
 		}
-		delete []raw_img_ROI;
 	}
+
+	delete []raw_img_ROI;
 }
 
 
@@ -0,0 +1,97 @@
+//------------------------------------------------------------------------------------------------
+// Copyright (c) 2012  Alessandro Bria and Giulio Iannello (University Campus Bio-Medico of Rome).  
+// All rights reserved.
+//------------------------------------------------------------------------------------------------
+
+/*******************************************************************************************************************************************************************************************
+*    LICENSE NOTICE
+********************************************************************************************************************************************************************************************
+*    By downloading/using/running/editing/changing any portion of codes in this package you agree to this license. If you do not agree to this license, do not download/use/run/edit/change
+*    this code.
+********************************************************************************************************************************************************************************************
+*    1. This material is free for non-profit research, but needs a special license for any commercial purpose. Please contact Alessandro Bria at a.bria@unicas.it or Giulio Iannello at 
+*       g.iannello@unicampus.it for further details.
+*    2. You agree to appropriately cite this work in your related studies and publications.
+*
+*       Bria, A., Iannello, G., "TeraStitcher - A Tool for Fast 3D Automatic Stitching of Teravoxel-sized Microscopy Images", (2012) BMC Bioinformatics, 13 (1), art. no. 316.
+*
+*    3. This material is provided by  the copyright holders (Alessandro Bria  and  Giulio Iannello),  University Campus Bio-Medico and contributors "as is" and any express or implied war-
+*       ranties, including, but  not limited to,  any implied warranties  of merchantability,  non-infringement, or fitness for a particular purpose are  disclaimed. In no event shall the
+*       copyright owners, University Campus Bio-Medico, or contributors be liable for any direct, indirect, incidental, special, exemplary, or  consequential  damages  (including, but not 
+*       limited to, procurement of substitute goods or services; loss of use, data, or profits;reasonable royalties; or business interruption) however caused  and on any theory of liabil-
+*       ity, whether in contract, strict liability, or tort  (including negligence or otherwise) arising in any way out of the use of this software,  even if advised of the possibility of
+*       such damage.
+*    4. Neither the name of University  Campus Bio-Medico of Rome, nor Alessandro Bria and Giulio Iannello, may be used to endorse or  promote products  derived from this software without
+*       specific prior written permission.
+********************************************************************************************************************************************************************************************/
+
+#ifndef BLOCK_MERGER_H
+#define BLOCK_MERGER_H
+
+#include <vector>
+#include "iomanager.config.h"
+
+class StackStitcher;
+class StackRestorer;
+class MergeWorker;
+struct stripe_2Dcoords;
+struct stripe_2Dcorners;
+
+/*******************************************************************************************************************************
+* Provides to 'StackStitcher::mergeTiles()' and 'StackStitcher::mergeTilesVaa3DRaw()' the blocks of merged slices to be halved
+* and saved, within the RAM budget S_MERGE_RAM_LIMIT_DEF:
+* - if whole slices of a block do not fit the budget, each block is merged by bands of rows, which are cut where tile rows of
+*   every resolution begin, so that halving and saving a band is the same as halving and saving whole slices. The buffer
+*   stores the largest band (whole slices if the tile rows cannot be cut within the budget);
+* - if the remaining budget allows a second buffer and Qt is available, the next band is merged by a worker thread while
+*   the current one is being halved and saved;
+* - what remains is used to obtain stripes several slices at a time (up to the block depth), so that each tile is loaded
+*   once per sub-stripe instead of once per slice.
+* Merged data are identical whatever the budget.
+*******************************************************************************************************************************/
+class BlockMerger
+{
+	friend class MergeWorker;
+
+	private:
+
+		StackStitcher *stitcher;
+		stripe_2Dcoords *stripesCoords;
+		stripe_2Dcorners *stripesCorners;
+		int restore_direction;
+		StackRestorer *stk_rst;
+		int blending_algo;
+		int d_size;							//number of slices of each sub-stripe
+		std::vector<int> bands;				//first row of each band, followed by the height of the volume
+		iom::real_t *next_buffer;			//buffer where the next band is merged in background (NULL if disabled)
+		iom::sint64 next_z;					//first slice of the block stored (or being merged) into <next_buffer> (-1 if none)
+		int next_z_size;					//number of slices of that block
+		int next_band;						//band of that block
+		MergeWorker *worker;				//worker thread (NULL if the next band is not merged in background)
+
+		// merges the next band into <next_buffer> (called by the worker thread)
+		void mergeNext() throw (iom::exception);
+
+	public:
+
+		iom::real_t *buffer;				//current band of merged slices
+
+		// <tile_rows_height> stores, for each resolution to be saved, the heights of the rows of tiles to be saved
+		BlockMerger(StackStitcher *_stitcher, int z_max_res, const std::vector< std::vector<int> > &tile_rows_height,
+					stripe_2Dcoords *_stripesCoords, stripe_2Dcorners *_stripesCorners,
+					int _restore_direction, StackRestorer *_stk_rst, int _blending_algo);
+		~BlockMerger();
+
+		// makes <buffer> store the <band>-th band of the <z_size> merged slices starting at <z>, then starts merging in
+		// background the <_next_band>-th band of the <_next_z_size> slices starting at <_next_z> (if any and if enabled)
+		void merge(iom::sint64 z, int z_size, int band, iom::sint64 _next_z, int _next_z_size, int _next_band,
+				   bool show_progress_bar) throw (iom::exception);
+
+		int getBands(){ return (int)bands.size()-1; }
+		int getBandV0(int band){ return bands[band]; }				// first row of the band (at the highest resolution)
+		int getBandHeight(int band){ return bands[band+1]-bands[band]; }
+		int getSubStripeDepth(){ return d_size; }
+		bool isPipelined(){ return worker != 0; }
+};
+
+#endif /* BLOCK_MERGER_H */
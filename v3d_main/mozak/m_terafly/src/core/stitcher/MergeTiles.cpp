@@ -69,6 +69,7 @@
 #include "../iomanager/ProgressBar.h"
 
 #include "resumer.h" // GI_141029: added stop and resume facility
+#include "BlockMerger.h"
 
 #include "IOPluginAPI.h" // GI_150213
 
@@ -104,28 +105,13 @@ void StackStitcher::mergeTilesVaa3DRaw(std::string output_path, int block_height
 	sint64 height, width, depth; //height, width and depth of the whole volume that covers all stacks
 	sint64 whole_depth; // 2015-08-14. Giulio. to be used only if par_mode is set to store the depth of the whole volume
 	iom::real_t* buffer;								//buffer temporary image data are stored
-	iom::real_t* stripe_up=NULL, *stripe_down;                                   //will contain up-stripe and down-stripe computed by calling 'getStripe' method
-	double angle;								//angle between 0 and PI used to sample overlapping zone in [0,PI]
-	double delta_angle;							//angle step
 	int z_ratio, z_max_res;
     int n_stacks_V[S_MAX_MULTIRES], n_stacks_H[S_MAX_MULTIRES], n_stacks_D[S_MAX_MULTIRES];             //array of number of tiles along V and H directions respectively at i-th resolution
     int ***stacks_height[S_MAX_MULTIRES], ***stacks_width[S_MAX_MULTIRES], ***stacks_depth[S_MAX_MULTIRES];	//array of matrices of tiles dimensions at i-th resolution
-	sint64 u_strp_bottom_displ;
-	sint64 d_strp_top_displ;
-	sint64 u_strp_top_displ;
-	sint64 d_strp_left_displ;
-	sint64 u_strp_left_displ;
-	sint64 d_strp_width;
-	sint64 u_strp_width;
-	sint64 dd_strp_top_displ;
-	sint64 u_strp_d_strp_overlap;
-	sint64 h_up, h_down, h_overlap;
 	stripe_2Dcoords  *stripesCoords;
 	stripe_2Dcorners *stripesCorners;
 	int resolutions_size = 0;
 	StackRestorer *stk_rst = NULL;
-	iom::real_t *buffer_ptr, *ustripe_ptr, *dstripe_ptr;	
-	iom::real_t (*blending)(double& angle, iom::real_t& pixel1, iom::real_t& pixel2);
 
 	std::stringstream output_path_par; // used if parallel option is set
 	int halve_pow2[S_MAX_MULTIRES];
@@ -155,14 +141,8 @@ void StackStitcher::mergeTilesVaa3DRaw(std::string output_path, int block_height
 	 */
 	sint64 n_slices_pred;       
 
-	//retrieving blending function
-	if(blending_algo == S_SINUSOIDAL_BLENDING)
-            blending = sinusoidal_blending;
-	else if(blending_algo == S_NO_BLENDING)
-            blending = no_blending;
-	else if(blending_algo == S_SHOW_STACK_MARGIN)
-            blending = stack_margin;
-	else
+	//checking blending function (stripes are blended by 'mergeBlock()')
+	if(blending_algo != S_SINUSOIDAL_BLENDING && blending_algo != S_NO_BLENDING && blending_algo != S_SHOW_STACK_MARGIN)
             throw iom::exception("in StackStitcher::mergeTilesVaa3DRaw(...): unrecognized blending function");
 
 	//initializing the progress bar
@@ -388,7 +368,11 @@ void StackStitcher::mergeTilesVaa3DRaw(std::string output_path, int block_height
 
 	z_max_res = POW_INT(2,halve_pow2[resolutions_size-1]); 
 	z_ratio= static_cast<int>(depth/z_max_res);
-	buffer = new iom::real_t[height*width*z_max_res];
+	std::vector< std::vector<int> > tile_rows_height(resolutions_size);
+	for(int res_i=0; res_i< resolutions_size; res_i++)
+		for(int stack_row = 0; stack_row < n_stacks_V[res_i]; stack_row++)
+			tile_rows_height[res_i].push_back(stacks_height[res_i][stack_row][0][0]);
+	BlockMerger merger(this, z_max_res, tile_rows_height, stripesCoords, stripesCorners, restore_direction, stk_rst, blending_algo);
 
 	// 2014-10-29. Giulio. @DELETED 
 	////slice_start and slice_end of current block depend on the resolution
@@ -448,364 +432,254 @@ void StackStitcher::mergeTilesVaa3DRaw(std::string output_path, int block_height
 		z_parts = 1;
 	}
 
-	#ifdef S_TIME_CALC
-	double proc_time;
-	#endif
-
 	// z must begin from D0 (absolute index into the volume) since it is used to compute tha file names (containing the absolute position along D)
 	for( /* 2014-10-29. Giulio. @DELETED (sint64 z = this->D0, z_parts = 1) */; z < this->D1; z += z_max_res, z_parts++)
 	{
-		// 2014-09-09. Alessandro. @FIXED missing buffer initialization and reset in 'mergeTiles()' method.
-		for(sint64 i=0; i<height*width*z_max_res; i++)
-			buffer[i]=0;
+		//buffer size along D is different when the remainder of the subdivision by z_max_res is considered
+		int z_size = (z_parts<=z_ratio) ? z_max_res : (depth%z_max_res);
+		int next_z_size = z+z_max_res >= this->D1 ? 0 : ((z_parts+1<=z_ratio) ? z_max_res : (depth%z_max_res));
 
-		for(sint64 k = 0; k < ( z_parts <= z_ratio ? z_max_res : depth%z_max_res ); k++)
+		for(int band = 0; band < merger.getBands(); band++)
 		{
-			//updating the progress bar
-			if(show_progress_bar)
-			{	
-				sprintf(progressBarMsg, "Merging slice %d of %d",((uint32)(z-D0+k+1)),(uint32)depth);
-                                ProgressBar::instance()->update(((float)(z-D0+k+1)*100/(float)depth), progressBarMsg);
-                                ProgressBar::instance()->show();
-			}
-
-			//looping on all stripes
-			for(int row_index=ROW_START; row_index<=ROW_END; row_index++)
+			//merging current band of slices (the next one is merged in background while the current one is saved, if enabled)
+			bool last_band = band == merger.getBands()-1;
+			merger.merge(z, z_size, band, last_band ? z+z_max_res : z, last_band ? next_z_size : z_size, last_band ? 0 : band+1, show_progress_bar);
+			buffer = merger.buffer;
+			int band_V0 = merger.getBandV0(band), band_height = merger.getBandHeight(band);
+
+			//saving current buffer data at selected resolutions and in multitile format
+			for(int i=0; i< resolutions_size; i++)
 			{
-				//loading down stripe
-				if(row_index==ROW_START) stripe_up = NULL;
-				stripe_down = this->getStripe(row_index,(int)(z+k), restore_direction, stk_rst, blending_algo);
-
-				#ifdef S_TIME_CALC
-				proc_time = -TIME(0);
-				#endif
-
-				if(stripe_up) u_strp_bottom_displ	= stripesCoords[row_index-1].bottom_right.V	 - V0;
-				d_strp_top_displ					= stripesCoords[row_index  ].up_left.V	     - V0;
-				if(stripe_up) u_strp_top_displ      = stripesCoords[row_index-1].up_left.V	     - V0;
-				d_strp_left_displ					= stripesCoords[row_index  ].up_left.H		 - H0;
-				if(stripe_up) u_strp_left_displ     = stripesCoords[row_index-1].up_left.H		 - H0;
-				d_strp_width						= stripesCoords[row_index  ].bottom_right.H - stripesCoords[row_index  ].up_left.H;
-				if(stripe_up) u_strp_width			= stripesCoords[row_index-1].bottom_right.H - stripesCoords[row_index-1].up_left.H;
-				if(stripe_up) u_strp_d_strp_overlap = u_strp_bottom_displ - d_strp_top_displ;
-				if(row_index!=ROW_END) 
-					dd_strp_top_displ				= stripesCoords[row_index+1].up_left.V		 - V0;
-				h_up =  h_down						= u_strp_d_strp_overlap;
-
-				//overlapping zone
-				if(row_index!=ROW_START)
-				{	
-					std::list<stripe_corner>::iterator cnr_i_next, cnr_i = stripesCorners[row_index-1].merged.begin();
-					stripe_corner *cnr_left=&(*cnr_i), *cnr_right;
-					cnr_i++;
-					cnr_i_next = cnr_i;
-					cnr_i_next++;
-
-					while( cnr_i != stripesCorners[row_index-1].merged.end())
-					{
-						//computing h_up, h_overlap, h_down
-						cnr_right = &(*cnr_i);
-						if(cnr_i_next == stripesCorners[row_index-1].merged.end())
-						{
-							h_up =   cnr_left->up ? u_strp_d_strp_overlap : 0;
-							h_down = cnr_left->up ? 0                     : u_strp_d_strp_overlap;
-						}
-						else
-							if(cnr_left->up)
-								h_up = cnr_left->h;
-							else
-								h_down = cnr_left->h;
-							
-						h_overlap = u_strp_d_strp_overlap - h_up - h_down;
-
-						//splitting overlapping zone in sub-regions along H axis
-						for(sint64 j= cnr_left->H - H0; j < cnr_right->H - H0; j++)
-						{
-							delta_angle = PI/(h_overlap-1);
-							angle = 0;
-
-							//UP stripe zone
-							buffer_ptr  = &buffer[k*height*width+d_strp_top_displ*width+j];
-							ustripe_ptr = &stripe_up[(d_strp_top_displ-u_strp_top_displ)*u_strp_width +j - u_strp_left_displ];
-							for(sint64 i=d_strp_top_displ; i<d_strp_top_displ+h_up+(h_overlap >= 0 ?  0 : h_overlap); i++, buffer_ptr+=width, ustripe_ptr+= u_strp_width)
-								*buffer_ptr = *ustripe_ptr;
-
-							//OVERLAPPING zone
-							buffer_ptr  = &buffer[k*height*width+(d_strp_top_displ+h_up)*width+j];
-							ustripe_ptr = &stripe_up[(d_strp_top_displ+h_up-u_strp_top_displ)*u_strp_width +j - u_strp_left_displ];
-							dstripe_ptr = &stripe_down[(d_strp_top_displ+h_up-d_strp_top_displ)*d_strp_width +j - d_strp_left_displ];
-							for(sint64 i=d_strp_top_displ+h_up; i<d_strp_top_displ+h_up+h_overlap; i++, buffer_ptr+=width, ustripe_ptr+= u_strp_width, dstripe_ptr+=d_strp_width, angle+=delta_angle)
-								*buffer_ptr = blending(angle,*ustripe_ptr,*dstripe_ptr);
-
-							//DOWN stripe zone
-							buffer_ptr = &buffer[k*height*width+(d_strp_top_displ+h_up+(h_overlap >= 0 ? h_overlap : 0))*width+j];
-							dstripe_ptr = &stripe_down[((d_strp_top_displ+h_up+(h_overlap >= 0 ? h_overlap : 0))-d_strp_top_displ)*d_strp_width +j - d_strp_left_displ];
-							for(sint64 i=d_strp_top_displ+h_up+(h_overlap >= 0 ? h_overlap : 0); i<d_strp_top_displ+h_up+h_overlap+h_down; i++, buffer_ptr+=width, dstripe_ptr+=d_strp_width)
-								*buffer_ptr = *dstripe_ptr;
-						}
-
-						cnr_left = cnr_right;
-						cnr_i++;
-						if(cnr_i_next != stripesCorners[row_index-1].merged.end())
-							cnr_i_next++;
-					}
-				}
-
-				//non-overlapping zone
-				buffer_ptr = &buffer[k*height*width+((row_index==ROW_START ? 0 : u_strp_bottom_displ))*width];
-				for(sint64 i= (row_index==ROW_START ? 0 : u_strp_bottom_displ); i<(row_index==ROW_END? height : dd_strp_top_displ); i++)
+				if(show_progress_bar)
 				{
-					dstripe_ptr = &stripe_down[(i-d_strp_top_displ)*d_strp_width - d_strp_left_displ];
-					for(sint64 j=0; j<width; j++, buffer_ptr++, dstripe_ptr++)
-						if(j - d_strp_left_displ >= 0 && j - d_strp_left_displ < stripesCoords[row_index].bottom_right.H)
-							*buffer_ptr = *dstripe_ptr;
+					sprintf(progressBarMsg, "Generating resolution %d of %d",i+1,ISR_MAX(resolutions_size, resolutions_size));
+	                                ProgressBar::instance()->updateInfo(progressBarMsg);
+	                                ProgressBar::instance()->show();
 				}
 
-				//moving to bottom stripe_up
-				delete stripe_up;
-				stripe_up=stripe_down;
-
-				#ifdef S_TIME_CALC
-				proc_time += TIME(0);
-				StackStitcher::time_merging+=proc_time;
-				#endif
-			}
-			//releasing last stripe_down
-			delete stripe_down;
-		}
-		
-		//saving current buffer data at selected resolutions and in multitile format
-		for(int i=0; i< resolutions_size; i++)
-		{
-			if(show_progress_bar)
-			{
-				sprintf(progressBarMsg, "Generating resolution %d of %d",i+1,ISR_MAX(resolutions_size, resolutions_size));
-                                ProgressBar::instance()->updateInfo(progressBarMsg);
-                                ProgressBar::instance()->show();
-			}
-
-			// check if current block is changed
-			// D0 must be subtracted because z is an absolute index in volume while slice index should be computed on a relative basis (i.e. starting form 0)
-            if ( ((z - this->D0) / POW_INT(2,halve_pow2[i])) > slice_end[i] ) {
-				stack_block[i]++;
-				slice_start[i] = slice_end[i] + 1;
-				slice_end[i] += stacks_depth[i][0][0][stack_block[i]];
-			}
-
-			// find abs_pos_z at resolution i
-			std::stringstream abs_pos_z;
-			abs_pos_z.width(6);
-			abs_pos_z.fill('0');
-			abs_pos_z << (int)(this->getMultiresABS_D(i,0) + // all stacks start at the same D position
-								//- D0 * volume->getVXL_D() * 10 + // WARNING: D0 is counted twice,both in getMultiresABS_D and in slice_start
-                                (POW_INT(2,halve_pow2[i])*slice_start[i]) * volume->getVXL_D() * 10);
-
-			//compute the number of slice of previous groups at resolution i
-			//note that z_parts in the number and not an index (starts from 1)
-            n_slices_pred  = (z_parts - 1) * z_max_res / POW_INT(2,halve_pow2[i]);
-
-			//buffer size along D is different when the remainder of the subdivision by z_max_res is considered
-			sint64 z_size = (z_parts<=z_ratio) ? z_max_res : (depth%z_max_res);
-
-			//halvesampling resolution if current resolution is not the deepest one
-			if(i!=0) {
-				if ( halve_pow2[i] == (halve_pow2[i-1]+1) ) { // *modified*
-					// also D dimension has to be halvesampled
-					StackStitcher::halveSample(buffer,(int)(height/(POW_INT(2,i-1))),(int)(width/(POW_INT(2,i-1))),(int)(z_size/(POW_INT(2,halve_pow2[i-1]))),method);
-				}
-				else if ( halve_pow2[i] == halve_pow2[i-1] ) {// *modified*
-					// D dimension must not be halvesampled
-					StackStitcher::halveSample2D(buffer,(int)(height/(POW_INT(2,i-1))),(int)(width/(POW_INT(2,i-1))),(int)(z_size/(POW_INT(2,halve_pow2[i-1]))),method); 
+				// check if current block is changed (once per group of slices, i.e. with the first band)
+				// D0 must be subtracted because z is an absolute index in volume while slice index should be computed on a relative basis (i.e. starting form 0)
+	            if ( band == 0 && ((z - this->D0) / POW_INT(2,halve_pow2[i])) > slice_end[i] ) {
+					stack_block[i]++;
+					slice_start[i] = slice_end[i] + 1;
+					slice_end[i] += stacks_depth[i][0][0][stack_block[i]];
 				}
-				else {
-					char err_msg[S_STATIC_STRINGS_SIZE];
-					sprintf(err_msg, "in StackStitcher::mergeTilesVaa3DRaw(...): halve sampling level %d not supported at resolution %d\n", halve_pow2[i], i);
-					throw iom::exception(err_msg);
-				}
-			}
 
-			//saving at current resolution if it has been selected and iff buffer is at least 1 voxel (Z) deep
-			if(resolutions[i] && (z_size/(POW_INT(2,halve_pow2[i]))) > 0)
-			{
-				if(show_progress_bar)
-				{
-					sprintf(progressBarMsg, "Saving to disc resolution %d",i+1);
-                                        ProgressBar::instance()->updateInfo(progressBarMsg);
-                                        ProgressBar::instance()->show();
+				// find abs_pos_z at resolution i
+				std::stringstream abs_pos_z;
+				abs_pos_z.width(6);
+				abs_pos_z.fill('0');
+				abs_pos_z << (int)(this->getMultiresABS_D(i,0) + // all stacks start at the same D position
+									//- D0 * volume->getVXL_D() * 10 + // WARNING: D0 is counted twice,both in getMultiresABS_D and in slice_start
+	                                (POW_INT(2,halve_pow2[i])*slice_start[i]) * volume->getVXL_D() * 10);
+
+				//compute the number of slice of previous groups at resolution i
+				//note that z_parts in the number and not an index (starts from 1)
+	            n_slices_pred  = (z_parts - 1) * z_max_res / POW_INT(2,halve_pow2[i]);
+
+				//halvesampling resolution if current resolution is not the deepest one
+				if(i!=0) {
+					if ( halve_pow2[i] == (halve_pow2[i-1]+1) ) { // *modified*
+						// also D dimension has to be halvesampled
+						StackStitcher::halveSample(buffer,(int)(band_height/(POW_INT(2,i-1))),(int)(width/(POW_INT(2,i-1))),(int)(z_size/(POW_INT(2,halve_pow2[i-1]))),method);
+					}
+					else if ( halve_pow2[i] == halve_pow2[i-1] ) {// *modified*
+						// D dimension must not be halvesampled
+						StackStitcher::halveSample2D(buffer,(int)(band_height/(POW_INT(2,i-1))),(int)(width/(POW_INT(2,i-1))),(int)(z_size/(POW_INT(2,halve_pow2[i-1]))),method); 
+					}
+					else {
+						char err_msg[S_STATIC_STRINGS_SIZE];
+						sprintf(err_msg, "in StackStitcher::mergeTilesVaa3DRaw(...): halve sampling level %d not supported at resolution %d\n", halve_pow2[i], i);
+						throw iom::exception(err_msg);
+					}
 				}
 
-				//storing in 'base_path' the absolute path of the directory that will contain all stacks
-				std::stringstream base_path;
-				if ( par_mode ) // 2015-08-14. Giulio. directory name depends on the depth of the whole volume
-					base_path << output_path << "/RES(" << (int)(height/POW_INT(2,i)) << "x" << 
-						(int)(width/POW_INT(2,i)) << "x" << (int)(whole_depth/POW_INT(2,halve_pow2[i])) << ")/";
-				else 
-					base_path << output_path << "/RES(" << (int)(height/POW_INT(2,i)) << "x" << 
-						(int)(width/POW_INT(2,i)) << "x" << (int)(depth/POW_INT(2,halve_pow2[i])) << ")/";
-
-				//looping on new stacks
-				for(int stack_row = 0, start_height = 0, end_height = 0; stack_row < n_stacks_V[i]; stack_row++)
+				//saving at current resolution if it has been selected and iff buffer is at least 1 voxel (Z) deep
+				if(resolutions[i] && (z_size/(POW_INT(2,halve_pow2[i]))) > 0)
 				{
-					//incrementing end_height
-					end_height = start_height + stacks_height[i][stack_row][0][0]-1;
-						
-					//computing V_DIR_path and creating the directory the first time it is needed
-					std::stringstream V_DIR_path;
-					V_DIR_path << base_path.str() << this->getMultiresABS_V_string(i,start_height);
-					if(!test_mode && z==D0 && !make_dir(V_DIR_path.str().c_str()))
+					if(show_progress_bar)
 					{
-						char err_msg[S_STATIC_STRINGS_SIZE];
-						sprintf(err_msg, "in StackStitcher::mergeTilesVaa3DRaw(...): unable to create V_DIR = \"%s\"\n", V_DIR_path.str().c_str());
-						throw iom::exception(err_msg);
+						sprintf(progressBarMsg, "Saving to disc resolution %d",i+1);
+	                                        ProgressBar::instance()->updateInfo(progressBarMsg);
+	                                        ProgressBar::instance()->show();
 					}
 
-					for(int stack_column = 0, start_width=0, end_width=0; stack_column < n_stacks_H[i]; stack_column++)
+					//storing in 'base_path' the absolute path of the directory that will contain all stacks
+					std::stringstream base_path;
+					if ( par_mode ) // 2015-08-14. Giulio. directory name depends on the depth of the whole volume
+						base_path << output_path << "/RES(" << (int)(height/POW_INT(2,i)) << "x" << 
+							(int)(width/POW_INT(2,i)) << "x" << (int)(whole_depth/POW_INT(2,halve_pow2[i])) << ")/";
+					else 
+						base_path << output_path << "/RES(" << (int)(height/POW_INT(2,i)) << "x" << 
+							(int)(width/POW_INT(2,i)) << "x" << (int)(depth/POW_INT(2,halve_pow2[i])) << ")/";
+
+					//looping on new stacks
+					for(int stack_row = 0, start_height = 0, end_height = 0; stack_row < n_stacks_V[i]; start_height += stacks_height[i][stack_row][0][0], stack_row++)
 					{
-						end_width  = start_width  + stacks_width [i][stack_row][stack_column][0]-1;
+						//skipping rows of tiles saved with another band
+						if(start_height < band_V0/POW_INT(2,i) || start_height >= band_V0/POW_INT(2,i)+band_height/POW_INT(2,i))
+							continue;
+
+						//incrementing end_height
+						end_height = start_height + stacks_height[i][stack_row][0][0]-1;
+						
+						//computing V_DIR_path and creating the directory the first time it is needed
+						std::stringstream V_DIR_path;
+						V_DIR_path << base_path.str() << this->getMultiresABS_V_string(i,start_height);
+						if(!test_mode && z==D0 && !make_dir(V_DIR_path.str().c_str()))
+						{
+							char err_msg[S_STATIC_STRINGS_SIZE];
+							sprintf(err_msg, "in StackStitcher::mergeTilesVaa3DRaw(...): unable to create V_DIR = \"%s\"\n", V_DIR_path.str().c_str());
+							throw iom::exception(err_msg);
+						}
+
+						for(int stack_column = 0, start_width=0, end_width=0; stack_column < n_stacks_H[i]; stack_column++)
+						{
+							end_width  = start_width  + stacks_width [i][stack_row][stack_column][0]-1;
 							
-						//computing H_DIR_path and creating the directory the first time it is needed
-						std::stringstream H_DIR_path;
-						H_DIR_path << V_DIR_path.str() << "/" << this->getMultiresABS_V_string(i,start_height) << "_" << this->getMultiresABS_H_string(i,start_width);
-						if ( z==D0 ) {
-							if(!test_mode && !make_dir(H_DIR_path.str().c_str()))
-							{
-								char err_msg[S_STATIC_STRINGS_SIZE];
-								sprintf(err_msg, "in StackStitcher::mergeTilesVaa3DRaw(...): unable to create H_DIR = \"%s\"\n", H_DIR_path.str().c_str());
-								throw iom::exception(err_msg);
-							}
-							else { // the directory has been created for the first time
-								   // initialize block files
-								V3DLONG *sz = new V3DLONG[4];
-								int datatype;
-								char *err_rawfmt;
-
-								sz[0] = stacks_width[i][stack_row][stack_column][0];
-								sz[1] = stacks_height[i][stack_row][stack_column][0];
-								sz[3] = 1; // onle one channel for now
-
-								if ( saved_img_depth == 16 )
-									datatype = 2;
-								else if ( saved_img_depth == 8 ) 
-									datatype = 1;
-								else {
+							//computing H_DIR_path and creating the directory the first time it is needed
+							std::stringstream H_DIR_path;
+							H_DIR_path << V_DIR_path.str() << "/" << this->getMultiresABS_V_string(i,start_height) << "_" << this->getMultiresABS_H_string(i,start_width);
+							if ( z==D0 ) {
+								if(!test_mode && !make_dir(H_DIR_path.str().c_str()))
+								{
 									char err_msg[S_STATIC_STRINGS_SIZE];
-									sprintf(err_msg, "in StackStitcher::mergeTilesVaa3DRaw(...): unknown image depth (%d)", saved_img_depth);
+									sprintf(err_msg, "in StackStitcher::mergeTilesVaa3DRaw(...): unable to create H_DIR = \"%s\"\n", H_DIR_path.str().c_str());
 									throw iom::exception(err_msg);
 								}
+								else { // the directory has been created for the first time
+									   // initialize block files
+									V3DLONG *sz = new V3DLONG[4];
+									int datatype;
+									char *err_rawfmt;
+
+									sz[0] = stacks_width[i][stack_row][stack_column][0];
+									sz[1] = stacks_height[i][stack_row][stack_column][0];
+									sz[3] = 1; // onle one channel for now
+
+									if ( saved_img_depth == 16 )
+										datatype = 2;
+									else if ( saved_img_depth == 8 ) 
+										datatype = 1;
+									else {
+										char err_msg[S_STATIC_STRINGS_SIZE];
+										sprintf(err_msg, "in StackStitcher::mergeTilesVaa3DRaw(...): unknown image depth (%d)", saved_img_depth);
+										throw iom::exception(err_msg);
+									}
+
+									int slice_start_temp = 0;
+									for ( int j=0; j < n_stacks_D[i]; j++ ) {
+										sz[2] = stacks_depth[i][stack_row][stack_column][j];
+
+										std::stringstream abs_pos_z_temp;
+										abs_pos_z_temp.width(6);
+										abs_pos_z_temp.fill('0');
+										abs_pos_z_temp << (int)(this->getMultiresABS_D(i,0) + // all stacks start at the same D position
+	                                       (POW_INT(2,halve_pow2[i])*(slice_start_temp)) * volume->getVXL_D() * 10);
+
+										std::stringstream img_path_temp;
+										img_path_temp << H_DIR_path.str() << "/" 
+													  << this->getMultiresABS_V_string(i,start_height) << "_" 
+													  << this->getMultiresABS_H_string(i,start_width) << "_"
+													  << abs_pos_z_temp.str();
+
+										// 2014-09-10. Alessandro. @CHANGED 'saved_img_format' interpretation in 'mergeTilesVaa3DRaw()' method.
+										err_rawfmt = 0; // the plugin does not return a message
+										if( strcmp(saved_img_format, "tif") == 0 || strcmp(saved_img_format, "tiff") == 0 || strcmp(saved_img_format, "TIF") == 0 || strcmp(saved_img_format, "TIFF") == 0)
+											//err_rawfmt = initTiff3DFile((char *)img_path_temp.str().c_str(),(uint32)sz[0],(uint32)sz[1],(uint32)sz[2],(uint32)sz[3],datatype);
+											iom::IOPluginFactory::getPlugin3D(iom::IMOUT_PLUGIN)->create3Dimage((char *)img_path_temp.str().c_str(),(int)sz[1],(int)sz[0],(int)sz[2],datatype,(int)sz[3]);
+										else if(strcmp(saved_img_format, "v3draw") == 0 || strcmp(saved_img_format, "raw") == 0)
+											err_rawfmt = initRawFile((char *)img_path_temp.str().c_str(),sz,datatype);
+										else
+											throw iom::exception(vm::strprintf("in StackStitcher::mergeTilesVaa3DRaw(): unsupported image format \"%s\"", saved_img_format));
+										if(err_rawfmt != 0)
+											throw iom::exception(vm::strprintf("in StackStitcher::mergeTilesVaa3DRaw(): error in initializing block file (%s)", err_rawfmt));
+								
+										slice_start_temp += (int)sz[2];
+									}
+									delete [] sz;
+								}
+							}
 
-								int slice_start_temp = 0;
-								for ( int j=0; j < n_stacks_D[i]; j++ ) {
-									sz[2] = stacks_depth[i][stack_row][stack_column][j];
-
-									std::stringstream abs_pos_z_temp;
-									abs_pos_z_temp.width(6);
-									abs_pos_z_temp.fill('0');
-									abs_pos_z_temp << (int)(this->getMultiresABS_D(i,0) + // all stacks start at the same D position
-                                       (POW_INT(2,halve_pow2[i])*(slice_start_temp)) * volume->getVXL_D() * 10);
+							//saving HERE
+							for(int buffer_z=0; buffer_z<z_size/(POW_INT(2,halve_pow2[i])); buffer_z++)
+							{
+								int slice_ind; 
+								std::stringstream img_path;
+	 							std::stringstream abs_pos_z_next;
+
+								int rel_pos_z = (int)(POW_INT(2,halve_pow2[i])*buffer_z+z-D0);		// Alessandro, 23/03/2013 - see below. This is the relative Z pixel coordinate in the 
+																									// highest resolution image space. '-D0' is necessary to make it relative, since
+																									// getMultiresABS_D_string(...) accepts relative coordinates only.
+
+								/*std::stringstream abs_pos_z;
+								abs_pos_z.width(6);
+								abs_pos_z.fill('0');
+								abs_pos_z << (int)(POW_INT(2,halve_pow2[i])*buffer_z+z);*/	// Alessandro, 23/03/2013 - bug found: we are saving the image space coordinate (in pixels) 
+																				// instead of the volume space coordinate (in tenths of microns)
+								img_path << H_DIR_path.str() << "/" 
+											<< this->getMultiresABS_V_string(i,start_height) << "_" 
+											<< this->getMultiresABS_H_string(i,start_width)  << "_";
+										
+								// D0 must be subtracted because z is an absolute index in volume while slice index should be computed on a relative basis (i.e. starting form 0)
+			                    if ( ((z - this->D0) / POW_INT(2,halve_pow2[i])+buffer_z) > slice_end[i] ) { // start a new block along z !!! GI_140427 THIS HAS NOT BE CHECKED YET
+									abs_pos_z_next.width(6);
+									abs_pos_z_next.fill('0');
+									//abs_pos_z_next << (int)(this->getMultiresABS_D(i) + // all stacks start at the same D position
+									abs_pos_z_next << (int)(this->getMultiresABS_D(i,0) + // all stacks start at the same D position
+	                                        (POW_INT(2,halve_pow2[i])*(slice_end[i]+1)) * volume->getVXL_D() * 10);
+									img_path << abs_pos_z_next.str();
+									slice_ind = (int)(n_slices_pred - (slice_end[i]+1)) + buffer_z;
+								}
+								else {
+									//img_path
+										// << abs_pos_z.str();							// Alessandro, 23/03/2013 - bug found: see above
+										//<< this->getMultiresABS_D_string(0, rel_pos_z);	// Alessandro, 23/03/2013 - we pass '0' because rel_pos_z is the relative Z
+																						// pixel coordinate in the HIGHEST (i=0) resolution image space (see above).
+									img_path << abs_pos_z.str(); 
+									slice_ind = (int)(n_slices_pred - slice_start[i]) + buffer_z;
+								}
 
-									std::stringstream img_path_temp;
-									img_path_temp << H_DIR_path.str() << "/" 
-												  << this->getMultiresABS_V_string(i,start_height) << "_" 
-												  << this->getMultiresABS_H_string(i,start_width) << "_"
-												  << abs_pos_z_temp.str();
+								if(test_mode)
+								{
+									img_path.str("");
+									img_path << volume->getSTACKS_DIR() << "/test_middle_slice";
+								}
 
+	                            // @FIXED by Alessandro on 2014-06-25: iim::IOException objects must be caught here
+	                            try
+	                            {
 									// 2014-09-10. Alessandro. @CHANGED 'saved_img_format' interpretation in 'mergeTilesVaa3DRaw()' method.
-									err_rawfmt = 0; // the plugin does not return a message
+									std::string iim_format;
 									if( strcmp(saved_img_format, "tif") == 0 || strcmp(saved_img_format, "tiff") == 0 || strcmp(saved_img_format, "TIF") == 0 || strcmp(saved_img_format, "TIFF") == 0)
-										//err_rawfmt = initTiff3DFile((char *)img_path_temp.str().c_str(),(uint32)sz[0],(uint32)sz[1],(uint32)sz[2],(uint32)sz[3],datatype);
-										iom::IOPluginFactory::getPlugin3D(iom::IMOUT_PLUGIN)->create3Dimage((char *)img_path_temp.str().c_str(),(int)sz[1],(int)sz[0],(int)sz[2],datatype,(int)sz[3]);
+										iim_format  = "Tiff3D";
 									else if(strcmp(saved_img_format, "v3draw") == 0 || strcmp(saved_img_format, "raw") == 0)
-										err_rawfmt = initRawFile((char *)img_path_temp.str().c_str(),sz,datatype);
+										iim_format = "Vaa3DRaw";
 									else
 										throw iom::exception(vm::strprintf("in StackStitcher::mergeTilesVaa3DRaw(): unsupported image format \"%s\"", saved_img_format));
-									if(err_rawfmt != 0)
-										throw iom::exception(vm::strprintf("in StackStitcher::mergeTilesVaa3DRaw(): error in initializing block file (%s)", err_rawfmt));
-								
-									slice_start_temp += (int)sz[2];
-								}
-								delete [] sz;
-							}
-						}
 
-						//saving HERE
-						for(int buffer_z=0; buffer_z<z_size/(POW_INT(2,halve_pow2[i])); buffer_z++)
-						{
-							int slice_ind; 
-							std::stringstream img_path;
- 							std::stringstream abs_pos_z_next;
-
-							int rel_pos_z = (int)(POW_INT(2,halve_pow2[i])*buffer_z+z-D0);		// Alessandro, 23/03/2013 - see below. This is the relative Z pixel coordinate in the 
-																								// highest resolution image space. '-D0' is necessary to make it relative, since
-																								// getMultiresABS_D_string(...) accepts relative coordinates only.
-
-							/*std::stringstream abs_pos_z;
-							abs_pos_z.width(6);
-							abs_pos_z.fill('0');
-							abs_pos_z << (int)(POW_INT(2,halve_pow2[i])*buffer_z+z);*/	// Alessandro, 23/03/2013 - bug found: we are saving the image space coordinate (in pixels) 
-																			// instead of the volume space coordinate (in tenths of microns)
-							img_path << H_DIR_path.str() << "/" 
-										<< this->getMultiresABS_V_string(i,start_height) << "_" 
-										<< this->getMultiresABS_H_string(i,start_width)  << "_";
-										
-							// D0 must be subtracted because z is an absolute index in volume while slice index should be computed on a relative basis (i.e. starting form 0)
-		                    if ( ((z - this->D0) / POW_INT(2,halve_pow2[i])+buffer_z) > slice_end[i] ) { // start a new block along z !!! GI_140427 THIS HAS NOT BE CHECKED YET
-								abs_pos_z_next.width(6);
-								abs_pos_z_next.fill('0');
-								//abs_pos_z_next << (int)(this->getMultiresABS_D(i) + // all stacks start at the same D position
-								abs_pos_z_next << (int)(this->getMultiresABS_D(i,0) + // all stacks start at the same D position
-                                        (POW_INT(2,halve_pow2[i])*(slice_end[i]+1)) * volume->getVXL_D() * 10);
-								img_path << abs_pos_z_next.str();
-								slice_ind = (int)(n_slices_pred - (slice_end[i]+1)) + buffer_z;
-							}
-							else {
-								//img_path
-									// << abs_pos_z.str();							// Alessandro, 23/03/2013 - bug found: see above
-									//<< this->getMultiresABS_D_string(0, rel_pos_z);	// Alessandro, 23/03/2013 - we pass '0' because rel_pos_z is the relative Z
-																					// pixel coordinate in the HIGHEST (i=0) resolution image space (see above).
-								img_path << abs_pos_z.str(); 
-								slice_ind = (int)(n_slices_pred - slice_start[i]) + buffer_z;
-							}
+									// 2014-09-10. Alessandro. @FIXED 'mergeTilesVaa3DRaw' method: set 'imagemanager' module to silent mode.
+									iim::DEBUG = iim::NO_DEBUG;
 
-							if(test_mode)
-							{
-								img_path.str("");
-								img_path << volume->getSTACKS_DIR() << "/test_middle_slice";
+									// 2014-09-10. Alessandro. @CHANGED 'saved_img_format' interpretation in 'mergeTilesVaa3DRaw()' method.
+	                                iim::VirtualVolume::saveImage_to_Vaa3DRaw(
+	                                    slice_ind,
+	                                    img_path.str(),
+	                                    buffer + buffer_z*(band_height/POW_INT(2,i))*(width/POW_INT(2,i)), // adds the stride
+	                                    (int)band_height/(POW_INT(2,i)),
+	                                    (int)width/(POW_INT(2,i)),
+	                                    start_height - band_V0/POW_INT(2,i),end_height - band_V0/POW_INT(2,i),start_width,end_width,
+	                                    iim_format.c_str(), saved_img_depth
+	                                );
+	                            }
+	                            catch( iim::IOException& exception)
+	                            {
+	                                throw iom::exception(exception.what());
+	                            }
 							}
-
-                            // @FIXED by Alessandro on 2014-06-25: iim::IOException objects must be caught here
-                            try
-                            {
-								// 2014-09-10. Alessandro. @CHANGED 'saved_img_format' interpretation in 'mergeTilesVaa3DRaw()' method.
-								std::string iim_format;
-								if( strcmp(saved_img_format, "tif") == 0 || strcmp(saved_img_format, "tiff") == 0 || strcmp(saved_img_format, "TIF") == 0 || strcmp(saved_img_format, "TIFF") == 0)
-									iim_format  = "Tiff3D";
-								else if(strcmp(saved_img_format, "v3draw") == 0 || strcmp(saved_img_format, "raw") == 0)
-									iim_format = "Vaa3DRaw";
-								else
-									throw iom::exception(vm::strprintf("in StackStitcher::mergeTilesVaa3DRaw(): unsupported image format \"%s\"", saved_img_format));
-
-								// 2014-09-10. Alessandro. @FIXED 'mergeTilesVaa3DRaw' method: set 'imagemanager' module to silent mode.
-								iim::DEBUG = iim::NO_DEBUG;
-
-								// 2014-09-10. Alessandro. @CHANGED 'saved_img_format' interpretation in 'mergeTilesVaa3DRaw()' method.
-                                iim::VirtualVolume::saveImage_to_Vaa3DRaw(
-                                    slice_ind,
-                                    img_path.str(),
-                                    buffer + buffer_z*(height/POW_INT(2,i))*(width/POW_INT(2,i)), // adds the stride
-                                    (int)height/(POW_INT(2,i)),
-                                    (int)width/(POW_INT(2,i)),
-                                    start_height,end_height,start_width,end_width,
-                                    iim_format.c_str(), saved_img_depth
-                                );
-                            }
-                            catch( iim::IOException& exception)
-                            {
-                                throw iom::exception(exception.what());
-                            }
+							start_width  += stacks_width [i][stack_row][stack_column][0];
 						}
-						start_width  += stacks_width [i][stack_row][stack_column][0];
 					}
-					start_height += stacks_height[i][stack_row][0][0];
 				}
 			}
 		}
@@ -885,8 +759,7 @@ void StackStitcher::mergeTilesVaa3DRaw(std::string output_path, int block_height
 		delete []stacks_depth[res_i]; 
 	}
 
-	//releasing allocated memory
-	delete buffer;
+	//releasing allocated memory (the buffer is owned by <merger>)
 	if(stk_rst)
 		delete stk_rst;
 	delete []stripesCoords;
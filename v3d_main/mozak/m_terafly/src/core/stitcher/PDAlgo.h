@@ -54,11 +54,13 @@ class PDAlgo
 		* <overlap_direction>	: direction of overlapping (see <direction> type definition for further details)
 		* <overlap>				: expected overlap between the given stacks along the given direction.  This value can
 		*						  be used to determine the region of interest where the overlapping occurs.
+		* <n_threads>			: number of threads this computation may use. It is given per call, since concurrent
+		*						  computations share the same algorithm object.
 		**************************************************************************************************************/
 		virtual Displacement* execute(iom::real_t *stk_A, iom::uint32 A_dim_V, iom::uint32 A_dim_H, iom::uint32 A_dim_D,
 									  iom::real_t *stk_B, iom::uint32 B_dim_V, iom::uint32 B_dim_H, iom::uint32 B_dim_D,
 									  iom::uint32 displ_max_V, iom::uint32 displ_max_H, iom::uint32 displ_max_D,
-									  direction overlap_direction, iom::uint32 overlap) throw (iom::exception) = 0;
+									  direction overlap_direction, iom::uint32 overlap, int n_threads = 1) throw (iom::exception) = 0;
 
 		//static method which is responsible to instance and return the algorithm of the given type
 		static PDAlgo* instanceAlgorithm(int _type);
@@ -75,6 +75,7 @@
 #define S_SAVED_TIFF_BIT_DEPTH 8		//bit depth of saved images
 #define S_MAX_MULTIRES 8				//in multiresolution mode, images will be downsampled up to 2^(S_MAX_MULTIRES)
 #define S_MIN_SLICE_DIM 100
+#define S_MERGE_RAM_LIMIT_DEF 4.0		//default RAM budget (in GB) of tile merging (see BlockMerger)
 
 //*** RESTORING PHASE***
 #define S_RESTORE_V_DIRECTION 1			//association of IDs to restoring directions
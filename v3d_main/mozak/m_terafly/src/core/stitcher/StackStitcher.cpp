@@ -65,9 +65,18 @@
 #include "../imagemanager/IM_config.h"
 #include "../imagemanager/VirtualVolume.h"
 #include "../imagemanager/StackedVolume.h"
+#include "../imagemanager/HalveSample.h"
 #include "../iomanager/IOPluginAPI.h"
 
 #include "resumer.h" // GI_141029: added stop and resume facility
+#include "BlockMerger.h"
+
+#include <vector>
+#include <algorithm>
+#ifdef _VAA3D_TERAFLY_PLUGIN_MODE
+#include <QRunnable>
+#include <QThreadPool>
+#endif
 
 
 using namespace iomanager;
@@ -90,6 +99,85 @@ struct stripe_2Dcorners{std::list<stripe_corner> ups, bottoms, merged;};
 bool compareCorners (stripe_corner first, stripe_corner second)
 { return ( first.H < second.H ); }
 
+namespace
+{
+
+// pairwise displacement computation of two adjacent (and already loaded) stacks, possibly run by a worker thread;
+// since exceptions cannot cross thread boundaries, errors are stored and rethrown by runDisplacementJobs
+class DisplacementJob
+#ifdef _VAA3D_TERAFLY_PLUGIN_MODE
+	: public QRunnable
+#endif
+{
+	public:
+
+		PDAlgo *algorithm;		// shared by concurrent jobs: it is not modified
+		VirtualStack *stk_A, *stk_B;
+		int dim_D, displ_max_V, displ_max_H, displ_max_D, overlap;
+		direction overlap_direction;
+		int n_threads;			// threads this computation may use
+		Displacement *displ;	// result (NULL until computed)
+		std::string error;		// empty if the computation succeeded
+
+		DisplacementJob(PDAlgo *_algorithm, VirtualStack *_stk_A, VirtualStack *_stk_B, int _dim_D,
+						int _displ_max_V, int _displ_max_H, int _displ_max_D, direction _overlap_direction, int _overlap)
+			: algorithm(_algorithm), stk_A(_stk_A), stk_B(_stk_B), dim_D(_dim_D), displ_max_V(_displ_max_V), displ_max_H(_displ_max_H),
+			  displ_max_D(_displ_max_D), overlap(_overlap), overlap_direction(_overlap_direction), n_threads(1), displ(0)
+		{
+			#ifdef _VAA3D_TERAFLY_PLUGIN_MODE
+			setAutoDelete(false);
+			#endif
+		}
+		~DisplacementJob(){ if(displ) delete displ; }
+
+		void run()
+		{
+			try
+			{
+				displ = algorithm->execute(stk_A->getSTACKED_IMAGE(), stk_A->getHEIGHT(), stk_A->getWIDTH(), dim_D,
+										   stk_B->getSTACKED_IMAGE(), stk_B->getHEIGHT(), stk_B->getWIDTH(), dim_D,
+										   displ_max_V, displ_max_H, displ_max_D, overlap_direction, overlap, n_threads);
+			}
+			catch(iom::exception & ex)	{ error = ex.what(); }
+			catch(std::exception & ex)	{ error = ex.what(); }
+			catch(...)					{ error = "unknown error"; }
+		}
+};
+
+// runs the given jobs with at most <n_threads> worker threads (inline if <n_threads> <= 1 or Qt is not available)
+// and waits for them; on error, all jobs are deleted and the first error is thrown
+void runDisplacementJobs(std::vector<DisplacementJob*> & jobs, int n_threads) throw (iom::exception)
+{
+	#ifdef _VAA3D_TERAFLY_PLUGIN_MODE
+	if(n_threads > 1 && jobs.size() > 1)
+	{
+		QThreadPool pool;
+		pool.setMaxThreadCount(n_threads);
+		for(size_t p=0; p<jobs.size(); p++)
+			pool.start(jobs[p]);
+		pool.waitForDone();
+	}
+	else
+	#else
+	(void)n_threads; // no worker threads without Qt
+	#endif
+	for(size_t p=0; p<jobs.size(); p++)
+		jobs[p]->run();
+
+	std::string error;
+	for(size_t p=0; p<jobs.size() && error.empty(); p++)
+		error = jobs[p]->error;
+	if(!error.empty())
+	{
+		for(size_t p=0; p<jobs.size(); p++)
+			delete jobs[p];
+		jobs.clear();
+		throw iom::exception(error.c_str());
+	}
+}
+
+}
+
 StackStitcher::StackStitcher(volumemanager::VirtualVolume* _volume)
 {
 	#if S_VERBOSE > 2
@@ -97,6 +185,7 @@ StackStitcher::StackStitcher(volumemanager::VirtualVolume* _volume)
 	#endif
 	volume = _volume;
 	V0 = V1 = H0 = H1 = D0 = D1 = ROW_START = ROW_END = COL_START = COL_END = -1;
+	n_threads = 1;
 }
 
 
@@ -217,8 +306,14 @@ throw (iom::exception)
 			stk_A->loadImageStack(z_start,z_start+subvol_DIM_D_k-1);
 
 		//scanning LAYER through columns OR through rows depending on row_wise value 
+		//with more than one thread, the displacements of the current row (or column) are computed concurrently 
+		//after all of its stacks have been loaded; otherwise each displacement is computed as soon as its pair of
+		//stacks is available. In both cases displacements are inserted and stacks are released in scanning order.
 		for(i=(row_wise ? row0 : col0); i<=(row_wise ? row1 : col1); i++)
 		{
+			std::vector<DisplacementJob*> jobs;		//pending displacement computations
+			int j_release = (row_wise ? col0 : row0);	//first stack of the current row that has not been released yet
+
 			for(j=(row_wise ? col0 : row0); j<=(row_wise ? col1 : row1); j++)
 			{
 				stk_A = volume->getSTACKS()[(row_wise? i : j  )][(row_wise ? j:   i)];
@@ -234,30 +329,10 @@ throw (iom::exception)
 					if(i== (row_wise ? row0 : col0 ) && stk_B->isComplete(z_start,z_start+subvol_DIM_D_k-1))
 						stk_B->loadImageStack(z_start, z_start+subvol_DIM_D_k-1);
 
-					if(show_progress_bar)
-					{
-						sprintf(buffer, "Displacement computation %d of %d", displ_computations_idx, displ_computations);
-						ProgressBar::instance()->update((100.0f/displ_computations)*displ_computations_idx, buffer);
-						ProgressBar::instance()->show();
-					}
-
 					// 2014-09-09. @ADDED sparse tile support: incomplete or empty substacks are not processed.
 					if(stk_A->isComplete(z_start, z_start+subvol_DIM_D_k-1) && stk_B->isComplete(z_start, z_start+subvol_DIM_D_k-1) )
-					{
-						#ifdef S_TIME_CALC
-						double proc_time = -TIME(0);
-						#endif
-						volume->insertDisplacement(stk_A, stk_B, 
-												  algorithm->execute(stk_A->getSTACKED_IMAGE(), stk_A->getHEIGHT(), stk_A->getWIDTH(), subvol_DIM_D_k,
-												  stk_B->getSTACKED_IMAGE(), stk_B->getHEIGHT(), stk_B->getWIDTH(), subvol_DIM_D_k, displ_max_V, 
-												  displ_max_H, displ_max_D, row_wise ? dir_horizontal : dir_vertical, row_wise ? overlap_H : overlap_V ));
-						displ_computations_idx++;
-						#ifdef S_TIME_CALC
-						proc_time += TIME(0);
-						StackStitcher::time_displ_comp+=proc_time;
-						proc_time = -TIME(0);
-						#endif
-					}
+						jobs.push_back(new DisplacementJob(algorithm, stk_A, stk_B, subvol_DIM_D_k, displ_max_V, displ_max_H, displ_max_D, 
+														   row_wise ? dir_horizontal : dir_vertical, row_wise ? overlap_H : overlap_V));
 				}
 				//if #rows>=#columns, checking if southern VirtualStack exists, otherwise checking if eastern VirtualStack exists
 				if(i!=(row_wise ? row1 : col1))
@@ -268,48 +343,46 @@ throw (iom::exception)
 					// 2014-09-09. @ADDED sparse tile support: incomplete or empty substacks are not processed.
 					if(stk_B->isComplete(z_start, z_start+subvol_DIM_D_k-1))
 						stk_B->loadImageStack(z_start, z_start+subvol_DIM_D_k-1);
-						
-					if(show_progress_bar)
-					{
-						sprintf(buffer, "Displacement computation %d of %d", displ_computations_idx, displ_computations);
-						ProgressBar::instance()->update((100.0f/displ_computations)*displ_computations_idx, buffer);
-						ProgressBar::instance()->show();
-					}
 
 					// 2014-09-09. @ADDED sparse tile support: incomplete or empty substacks are not processed.
 					if(stk_A->isComplete(z_start, z_start+subvol_DIM_D_k-1) && stk_B->isComplete(z_start, z_start+subvol_DIM_D_k-1) )
-					{
-						#ifdef S_TIME_CALC
-						double proc_time = -TIME(0);
-						#endif
-						volume->insertDisplacement(stk_A, stk_B, 
-												  algorithm->execute(stk_A->getSTACKED_IMAGE(), stk_A->getHEIGHT(), stk_A->getWIDTH(), subvol_DIM_D_k,
-												  stk_B->getSTACKED_IMAGE(), stk_B->getHEIGHT(), stk_B->getWIDTH(), subvol_DIM_D_k, displ_max_V, 
-												  displ_max_H, displ_max_D, row_wise ? dir_vertical : dir_horizontal, row_wise ? overlap_V : overlap_H ));
-											displ_computations_idx++;
-											#ifdef S_TIME_CALC
-						proc_time += TIME(0);
-						StackStitcher::time_displ_comp+=proc_time;
-						proc_time = -TIME(0);
-						#endif
-					}
+						jobs.push_back(new DisplacementJob(algorithm, stk_A, stk_B, subvol_DIM_D_k, displ_max_V, displ_max_H, displ_max_D, 
+														   row_wise ? dir_vertical : dir_horizontal, row_wise ? overlap_V : overlap_H));
 				}
 
-				// 2014-09-09. @ADDED sparse tile support: incomplete or empty substacks are not processed.
-				if(restoreSPIM && stk_A->isComplete(z_start, z_start+subvol_DIM_D_k-1))
+				if(n_threads > 1 && j != (row_wise ? col1 : row1))
+					continue;
+
+				if(show_progress_bar)
 				{
-					#ifdef S_TIME_CALC
-					double proc_time = -TIME(0);
-					#endif
-					stk_rst->computeSubvolDescriptors(stk_A->getSTACKED_IMAGE(), stk_A, k-1, subvol_DIM_D_k);
-					#ifdef S_TIME_CALC
-					proc_time += TIME(0);
-					StackStitcher::time_stack_desc+=proc_time;
-					#endif
+					sprintf(buffer, "Displacement computation %d of %d", displ_computations_idx, displ_computations);
+					ProgressBar::instance()->update((100.0f/displ_computations)*displ_computations_idx, buffer);
+					ProgressBar::instance()->show();
 				}
 
-				//deallocating current VirtualStack
-				stk_A->releaseImageStack();
+				#ifdef S_TIME_CALC
+				double proc_time = -TIME(0);
+				#endif
+				// threads not used by concurrent pairs are left to the algorithm
+				for(size_t p=0; p<jobs.size(); p++)
+					jobs[p]->n_threads = std::max(1, n_threads/(int)jobs.size());
+				runDisplacementJobs(jobs, n_threads);
+				#ifdef S_TIME_CALC
+				proc_time += TIME(0);
+				StackStitcher::time_displ_comp+=proc_time;
+				#endif
+
+				for(size_t p=0; p<jobs.size(); p++)
+				{
+					volume->insertDisplacement(jobs[p]->stk_A, jobs[p]->stk_B, jobs[p]->displ);
+					jobs[p]->displ = 0;
+					delete jobs[p];
+					displ_computations_idx++;
+				}
+				jobs.clear();
+
+				for(; j_release<=j; j_release++)
+					releaseLayerStack(volume->getSTACKS()[(row_wise? i : j_release)][(row_wise ? j_release: i)], stk_rst, k-1, z_start, subvol_DIM_D_k);
 			}
 		}
 
@@ -340,6 +413,29 @@ throw (iom::exception)
 	}
 }
 
+/*************************************************************************************************************
+* Called by 'computeDisplacements()' when all the displacements of the given stack in the current layer have 
+* been computed: computes its SPIM descriptors (if a <StackRestorer> object has been passed) and releases it.
+**************************************************************************************************************/
+void StackStitcher::releaseLayerStack(volumemanager::VirtualStack* stk, StackRestorer* stk_rst, int layer, int z_start, int subvol_DIM_D_k)
+{
+	// 2014-09-09. @ADDED sparse tile support: incomplete or empty substacks are not processed.
+	if(stk_rst && stk->isComplete(z_start, z_start+subvol_DIM_D_k-1))
+	{
+		#ifdef S_TIME_CALC
+		double proc_time = -TIME(0);
+		#endif
+		stk_rst->computeSubvolDescriptors(stk->getSTACKED_IMAGE(), stk, layer, subvol_DIM_D_k);
+		#ifdef S_TIME_CALC
+		proc_time += TIME(0);
+		StackStitcher::time_stack_desc+=proc_time;
+		#endif
+	}
+
+	//deallocating current VirtualStack
+	stk->releaseImageStack();
+}
+
 /*************************************************************************************************************
 * Computes final stitched volume dimensions assuming that current <VirtualVolume> object contains  the correct 
 * stack coordinates. The given parameters identify the possible VOI (Volume Of Interest). If these are not us-
@@ -556,10 +652,11 @@ int StackStitcher::getStripeABS_V(int row_index, bool up)
 * Merges all slices of the given row at the given depth index, so obtaining the stripe that is returned.
 * Uses [...]_blending() functions to blend pixels in  overlapping zones.  The appropriate blending function is
 * selected by the [blending_algo] parameter. If a  <StackRestorer>  object has been passed,  each slice is re-
-* stored before it is combined into the final stripe.
+* stored before it is combined into the final stripe. If [d_size] > 1, the stripes of the [d_size] slices star-
+* ting at <d_index> are returned one after the other (sub-stripe) and each VirtualStack is loaded only once.
 **************************************************************************************************************/
 iom::real_t* StackStitcher::getStripe(int row_index, int d_index, int restore_direction, StackRestorer* stk_rst,
-								 int blending_algo)									        throw (iom::exception)
+								 int blending_algo, int d_size)						        throw (iom::exception)
 {
         #if S_VERBOSE >2
 	printf("........in StackStitcher::getStripe(short row_index=%d, short d_index=%d, restore_direction=%d, blending_algo=%d)\n",
@@ -587,7 +684,8 @@ iom::real_t* StackStitcher::getStripe(int row_index, int d_index, int restore_di
 	char errMsg[5000];								//buffer where to store error messages
 	iom::real_t *stripe_ptr;								//buffer where to store the resulting stripe
 	iom::real_t *rslice_ptr, *lslice_ptr;				//buffers where to store each loaded pair of right and left slices
-	sint64 i,j;										//pixel indexes
+	iom::real_t *stripe_k, *slice_left_k, *slice_right_k;	//k-th slice of the sub-stripe and of the loaded slices
+	sint64 i,j,k;									//pixel and slice indexes
 	iom::real_t (*blending)(double& angle, iom::real_t& pixel1, iom::real_t& pixel2); //pointer to blending function
 
 	//retrieving blending function
@@ -613,6 +711,11 @@ iom::real_t* StackStitcher::getStripe(int row_index, int d_index, int restore_di
 		sprintf(errMsg, "in StackStitcher::getStripe(...): d_index (= %d) is out of bounds [%d,%d]", d_index, D0, D1-1);
 		throw iom::exception(errMsg);
 	}
+	if(d_size < 1 || d_index+d_size > D1)
+	{
+		sprintf(errMsg, "in StackStitcher::getStripe(...): sub-stripe [%d,%d] is out of bounds [%d,%d]", d_index, d_index+d_size-1, D0, D1-1);
+		throw iom::exception(errMsg);
+	}
 
 	//computing current stripe VH coordinates and size
 	stripe_V_top  = volume->getSTACKS()[row_index][COL_START]->getABS_V();
@@ -632,10 +735,10 @@ iom::real_t* StackStitcher::getStripe(int row_index, int d_index, int restore_di
 	width=stripe_H_right-stripe_H_left;
 
 	//ALLOCATING once for all the MEMORY SPACE for current stripe
-	stripe = new iom::real_t[height*width];
+	stripe = new iom::real_t[(sint64)height*width*d_size];
 
 	// 2014-09-09. Alessandro. @FIXED missing buffer initialization in 'getStripe()' method.
-	for(int i=0; i<height*width; i++)
+	for(sint64 i=0; i<(sint64)height*width*d_size; i++)
 		stripe[i]=0;
 
 	//looping on all slices with row='row_index'
@@ -653,8 +756,8 @@ iom::real_t* StackStitcher::getStripe(int row_index, int d_index, int restore_di
 		if(l_stk)   l_stk_right_displ = l_stk->getABS_H()  - stripe_H_left + stack_width;
 		if(rr_stk)  rr_stk_left_displ = rr_stk->getABS_H() - stripe_H_left;
 
-		//loading right slice (slice_right) into memory
-		slice_right = r_stk->loadImageStack(d_index-r_stk->getABS_D(), d_index-r_stk->getABS_D());
+		//loading right slice(s) (slice_right) into memory
+		slice_right = r_stk->loadImageStack(d_index-r_stk->getABS_D(), d_index+d_size-1-r_stk->getABS_D());
 
 		#ifdef S_TIME_CALC
 		double proc_time = -TIME(0);
@@ -662,7 +765,8 @@ iom::real_t* StackStitcher::getStripe(int row_index, int d_index, int restore_di
 
 		//restoring right slice if restoring is enabled
 		if(stk_rst)
-			stk_rst->repairSlice(slice_right,d_index-r_stk->getABS_D(), r_stk,restore_direction);
+			for(k=0; k<d_size; k++)
+				stk_rst->repairSlice(slice_right+k*stack_height*stack_width,(int)(d_index+k-r_stk->getABS_D()), r_stk,restore_direction);
 		#ifdef S_TIME_CALC
 		proc_time += TIME(0);
 		StackStitcher::time_stack_restore+=proc_time;
@@ -671,35 +775,42 @@ iom::real_t* StackStitcher::getStripe(int row_index, int d_index, int restore_di
 
 		//setting delta_angle
 		if(l_stk) delta_angle = PI/((l_stk->getABS_H()+stack_width-r_stk->getABS_H())-1);
-                angle = 0;
 
-		//for every pair of adjacent slices, writing 2 different zones
-		for(j=(l_stk ? r_stk_left_displ : 0); j<(rr_stk? rr_stk_left_displ : width); j++)
+		for(k=0; k<d_size; k++)
 		{
-			//FIRST ZONE: overlapping zone (iff l_stk exists)
-			if(l_stk && j < l_stk_right_displ)
-			{	
-				stripe_ptr = &stripe[j];
-				lslice_ptr = &slice_left [-l_stk_top_displ*stack_width+j-l_stk_left_displ];
-				rslice_ptr = &slice_right[-r_stk_top_displ*stack_width+j-r_stk_left_displ];
-				for(i=0; i<height; i++, stripe_ptr+=width, lslice_ptr+=stack_width, rslice_ptr+=stack_width)
-					if(i - r_stk_top_displ >= 0 && i - r_stk_top_displ < stack_height && i - l_stk_top_displ >= 0 && i - l_stk_top_displ < stack_height)
-                        *stripe_ptr = blending(angle,*lslice_ptr,*rslice_ptr);
-					else if (i - r_stk_top_displ >= 0 && i - r_stk_top_displ < stack_height)
-						*stripe_ptr=*rslice_ptr;
-					else if (i - l_stk_top_displ >= 0 && i - l_stk_top_displ < stack_height)
-						*stripe_ptr= *lslice_ptr;
-
-				angle=angle+delta_angle;
-			}
+			stripe_k      = stripe + k*height*width;
+			slice_left_k  = slice_left ? slice_left + k*stack_height*stack_width : NULL;
+			slice_right_k = slice_right + k*stack_height*stack_width;
+			angle = 0;
 
-			//SECOND ZONE: slice_right remainder by excluding overlapping zone between previous slice and overlapping zone between next slice
-			else
+			//for every pair of adjacent slices, writing 2 different zones
+			for(j=(l_stk ? r_stk_left_displ : 0); j<(rr_stk? rr_stk_left_displ : width); j++)
 			{
-				rslice_ptr = &slice_right[-r_stk_top_displ*stack_width+j-r_stk_left_displ];
-				for(i=0, stripe_ptr = &stripe[j]; i<height; i++, stripe_ptr+=width, rslice_ptr+=stack_width)
-					if(i - r_stk_top_displ >= 0 && i - r_stk_top_displ < stack_height)
-						*stripe_ptr=*rslice_ptr;
+				//FIRST ZONE: overlapping zone (iff l_stk exists)
+				if(l_stk && j < l_stk_right_displ)
+				{	
+					stripe_ptr = &stripe_k[j];
+					lslice_ptr = &slice_left_k [-l_stk_top_displ*stack_width+j-l_stk_left_displ];
+					rslice_ptr = &slice_right_k[-r_stk_top_displ*stack_width+j-r_stk_left_displ];
+					for(i=0; i<height; i++, stripe_ptr+=width, lslice_ptr+=stack_width, rslice_ptr+=stack_width)
+						if(i - r_stk_top_displ >= 0 && i - r_stk_top_displ < stack_height && i - l_stk_top_displ >= 0 && i - l_stk_top_displ < stack_height)
+							*stripe_ptr = blending(angle,*lslice_ptr,*rslice_ptr);
+						else if (i - r_stk_top_displ >= 0 && i - r_stk_top_displ < stack_height)
+							*stripe_ptr=*rslice_ptr;
+						else if (i - l_stk_top_displ >= 0 && i - l_stk_top_displ < stack_height)
+							*stripe_ptr= *lslice_ptr;
+
+					angle=angle+delta_angle;
+				}
+
+				//SECOND ZONE: slice_right remainder by excluding overlapping zone between previous slice and overlapping zone between next slice
+				else
+				{
+					rslice_ptr = &slice_right_k[-r_stk_top_displ*stack_width+j-r_stk_left_displ];
+					for(i=0, stripe_ptr = &stripe_k[j]; i<height; i++, stripe_ptr+=width, rslice_ptr+=stack_width)
+						if(i - r_stk_top_displ >= 0 && i - r_stk_top_displ < stack_height)
+							*stripe_ptr=*rslice_ptr;
+				}
 			}
 		}
 
@@ -727,6 +838,187 @@ iom::real_t* StackStitcher::getStripe(int row_index, int d_index, int restore_di
 	return stripe;
 }
 
+/*************************************************************************************************************
+* Merges the <z_size> slices starting at <z> into <buffer>, which stores the <v_size> rows starting at <v0> of
+* the slices of the volume to be stitched. Only the stripes overlapping these rows are loaded. Stripes are ob-
+* tained <d_size> slices at a time. Used by <BlockMerger>.
+**************************************************************************************************************/
+void StackStitcher::mergeBlock(iom::real_t* buffer, sint64 z, int z_size, int v0, int v_size, int d_size, stripe_2Dcoords* stripesCoords,
+							   stripe_2Dcorners* stripesCorners, int restore_direction, StackRestorer* stk_rst, int blending_algo,
+							   bool show_progress_bar)															throw (iom::exception)
+{
+	//LOCAL VARIABLES
+	sint64 height = V1-V0, width = H1-H0, depth = D1-D0;	//height, width and depth of the whole volume that covers all stacks
+	iom::real_t *stripe_up=NULL, *stripe_down=NULL;		//up-substripe and down-substripe computed by calling 'getStripe' method
+	iom::real_t *ustripe, *dstripe;						//current slice of up-substripe and down-substripe
+	double angle;								//angle between 0 and PI used to sample overlapping zone in [0,PI]
+	double delta_angle;							//angle step
+	sint64 u_strp_bottom_displ;
+	sint64 d_strp_top_displ;
+	sint64 u_strp_top_displ;
+	sint64 d_strp_left_displ;
+	sint64 u_strp_left_displ;
+	sint64 d_strp_width;
+	sint64 u_strp_width;
+	sint64 dd_strp_top_displ;
+	sint64 u_strp_d_strp_overlap;
+	sint64 h_up, h_down, h_overlap;
+	iom::real_t *buffer_ptr, *ustripe_ptr, *dstripe_ptr;	
+	iom::real_t (*blending)(double& angle, iom::real_t& pixel1, iom::real_t& pixel2);
+	char progressBarMsg[200];
+	sint64 v1 = v0 + v_size;					//rows [v0,v1) are stored into <buffer>
+
+	//retrieving blending function
+	if(blending_algo == S_SINUSOIDAL_BLENDING)
+        blending = sinusoidal_blending;
+	else if(blending_algo == S_NO_BLENDING)
+        blending = no_blending;
+	else if(blending_algo == S_SHOW_STACK_MARGIN)
+        blending = stack_margin;
+	else
+        throw iom::exception("in StackStitcher::mergeBlock(...): unrecognized blending function");
+
+	// 2014-09-09. Alessandro. @FIXED missing buffer initialization and reset in 'mergeTiles()' method.
+	for(sint64 i=0; i<v_size*width*z_size; i++)
+		buffer[i]=0;
+
+	for(sint64 k0 = 0; k0 < z_size; k0 += d_size)
+	{
+		//number of slices of current sub-stripes
+		int k_size = (int) std::min<sint64>(d_size, z_size - k0);
+
+		//updating the progress bar
+		if(show_progress_bar)
+		{	
+			sprintf(progressBarMsg, "Merging slice %d of %d",((uint32)(z-D0+k0+k_size)),(uint32)depth);
+                            ProgressBar::instance()->update(((float)(z-D0+k0+k_size)*100/(float)depth), progressBarMsg);
+                            ProgressBar::instance()->show();
+		}
+
+		//looping on all stripes
+		for(int row_index=ROW_START; row_index<=ROW_END; row_index++)
+		{
+			//skipping stripes that do not overlap rows [v0,v1): rows merged from a stripe all belong to it
+			if(row_index==ROW_START) stripe_up = NULL;
+			if(stripesCoords[row_index].bottom_right.V - V0 <= v0 || stripesCoords[row_index].up_left.V - V0 >= v1)
+			{
+				delete[] stripe_up;
+				stripe_up = NULL;
+				continue;
+			}
+
+			//loading down sub-stripe
+			stripe_down = this->getStripe(row_index,(int)(z+k0), restore_direction, stk_rst, blending_algo, k_size);
+
+			#ifdef S_TIME_CALC
+			double proc_time = -TIME(0);
+			#endif
+
+			if(row_index!=ROW_START) u_strp_bottom_displ	= stripesCoords[row_index-1].bottom_right.V	 - V0;
+			d_strp_top_displ								= stripesCoords[row_index  ].up_left.V	     - V0;
+			if(row_index!=ROW_START) u_strp_top_displ      = stripesCoords[row_index-1].up_left.V	     - V0;
+			d_strp_left_displ								= stripesCoords[row_index  ].up_left.H		 - H0;
+			if(row_index!=ROW_START) u_strp_left_displ     = stripesCoords[row_index-1].up_left.H		 - H0;
+			d_strp_width									= stripesCoords[row_index  ].bottom_right.H - stripesCoords[row_index  ].up_left.H;
+			if(row_index!=ROW_START) u_strp_width			= stripesCoords[row_index-1].bottom_right.H - stripesCoords[row_index-1].up_left.H;
+			if(row_index!=ROW_START) u_strp_d_strp_overlap = u_strp_bottom_displ - d_strp_top_displ;
+			if(row_index!=ROW_END) 
+				dd_strp_top_displ				= stripesCoords[row_index+1].up_left.V		 - V0;
+
+			for(sint64 k = k0; k < k0 + k_size; k++)
+			{
+				//current slice of the sub-stripes (slices of a sub-stripe are stored one after the other)
+				ustripe = stripe_up ? stripe_up + (k-k0)*(stripesCoords[row_index-1].bottom_right.V-stripesCoords[row_index-1].up_left.V)*u_strp_width : NULL;
+				dstripe = stripe_down + (k-k0)*(stripesCoords[row_index].bottom_right.V-stripesCoords[row_index].up_left.V)*d_strp_width;
+				h_up =  h_down						= u_strp_d_strp_overlap;
+
+				//overlapping zone (not stored if the up stripe has been skipped, since it lies within it)
+				if(row_index!=ROW_START && stripe_up)
+				{	
+					std::list<stripe_corner>::iterator cnr_i_next, cnr_i = stripesCorners[row_index-1].merged.begin();
+					stripe_corner *cnr_left=&(*cnr_i), *cnr_right;
+					cnr_i++;
+					cnr_i_next = cnr_i;
+					cnr_i_next++;
+
+					while( cnr_i != stripesCorners[row_index-1].merged.end())
+					{
+						//computing h_up, h_overlap, h_down
+						cnr_right = &(*cnr_i);
+						if(cnr_i_next == stripesCorners[row_index-1].merged.end())
+						{
+							h_up =   cnr_left->up ? u_strp_d_strp_overlap : 0;
+							h_down = cnr_left->up ? 0                     : u_strp_d_strp_overlap;
+						}
+						else
+							if(cnr_left->up)
+								h_up = cnr_left->h;
+							else
+								h_down = cnr_left->h;
+							
+						h_overlap = u_strp_d_strp_overlap - h_up - h_down;
+
+						//splitting overlapping zone in sub-regions along H axis
+						for(sint64 j= cnr_left->H - H0; j < cnr_right->H - H0; j++)
+						{
+							delta_angle = PI/(h_overlap-1);
+							angle = 0;
+
+							//UP stripe zone (rows out of [v0,v1) are skipped, so that the blending angle is the same whatever the rows)
+							ustripe_ptr = &ustripe[(d_strp_top_displ-u_strp_top_displ)*u_strp_width +j - u_strp_left_displ];
+							for(sint64 i=d_strp_top_displ; i<d_strp_top_displ+h_up+(h_overlap >= 0 ?  0 : h_overlap); i++, ustripe_ptr+= u_strp_width)
+								if(i >= v0 && i < v1)
+									buffer[(k*v_size+i-v0)*width+j] = *ustripe_ptr;
+
+							//OVERLAPPING zone
+							ustripe_ptr = &ustripe[(d_strp_top_displ+h_up-u_strp_top_displ)*u_strp_width +j - u_strp_left_displ];
+							dstripe_ptr = &dstripe[(d_strp_top_displ+h_up-d_strp_top_displ)*d_strp_width +j - d_strp_left_displ];
+							for(sint64 i=d_strp_top_displ+h_up; i<d_strp_top_displ+h_up+h_overlap; i++, ustripe_ptr+= u_strp_width, dstripe_ptr+=d_strp_width, angle+=delta_angle)
+								if(i >= v0 && i < v1)
+									buffer[(k*v_size+i-v0)*width+j] = blending(angle,*ustripe_ptr,*dstripe_ptr);
+
+							//DOWN stripe zone
+							dstripe_ptr = &dstripe[((d_strp_top_displ+h_up+(h_overlap >= 0 ? h_overlap : 0))-d_strp_top_displ)*d_strp_width +j - d_strp_left_displ];
+							for(sint64 i=d_strp_top_displ+h_up+(h_overlap >= 0 ? h_overlap : 0); i<d_strp_top_displ+h_up+h_overlap+h_down; i++, dstripe_ptr+=d_strp_width)
+								if(i >= v0 && i < v1)
+									buffer[(k*v_size+i-v0)*width+j] = *dstripe_ptr;
+						}
+
+						cnr_left = cnr_right;
+						cnr_i++;
+						if(cnr_i_next != stripesCorners[row_index-1].merged.end())
+							cnr_i_next++;
+					}
+				}
+
+				//non-overlapping zone
+				sint64 nonov_start = std::max<sint64>(v0, row_index==ROW_START ? 0 : u_strp_bottom_displ);
+				sint64 nonov_end = std::min<sint64>(v1, row_index==ROW_END? height : dd_strp_top_displ);
+				for(sint64 i= nonov_start; i<nonov_end; i++)
+				{
+					buffer_ptr = &buffer[(k*v_size+i-v0)*width];
+					dstripe_ptr = &dstripe[(i-d_strp_top_displ)*d_strp_width - d_strp_left_displ];
+					for(sint64 j=0; j<width; j++, buffer_ptr++, dstripe_ptr++)
+						if(j - d_strp_left_displ >= 0 && j - d_strp_left_displ < stripesCoords[row_index].bottom_right.H)
+							*buffer_ptr = *dstripe_ptr;
+				}
+			}
+
+			//moving to bottom stripe_up
+			delete[] stripe_up;
+			stripe_up=stripe_down;
+
+			#ifdef S_TIME_CALC
+			proc_time += TIME(0);
+			StackStitcher::time_merging+=proc_time;
+			#endif
+		}
+		//releasing last stripe (NULL if it has been skipped)
+		delete[] stripe_up;
+		stripe_up = stripe_down = NULL;
+	}
+}
+
 /*************************************************************************************************************
 * Method to be called for tile merging. <> parameters are mandatory, while [] are optional.
 * <output_path>			: absolute directory path where merged tiles have to be stored.
@@ -772,38 +1064,17 @@ void StackStitcher::mergeTiles(std::string output_path, int slice_height, int sl
 	//LOCAL VARIABLES
     sint64 height, width, depth;                                            //height, width and depth of the whole volume that covers all stacks
 	iom::real_t* buffer;								//buffer temporary image data are stored
-    iom::real_t* stripe_up=NULL, *stripe_down;                                   //will contain up-stripe and down-stripe computed by calling 'getStripe' method
-	double angle;								//angle between 0 and PI used to sample overlapping zone in [0,PI]
-	double delta_angle;							//angle step
 	int z_ratio, z_max_res;
     int n_stacks_V[S_MAX_MULTIRES], n_stacks_H[S_MAX_MULTIRES];             //array of number of tiles along V and H directions respectively at i-th resolution
     int **stacks_height[S_MAX_MULTIRES], **stacks_width[S_MAX_MULTIRES];	//array of matrices of tiles dimensions at i-th resolution
-	sint64 u_strp_bottom_displ;
-	sint64 d_strp_top_displ;
-	sint64 u_strp_top_displ;
-	sint64 d_strp_left_displ;
-	sint64 u_strp_left_displ;
-	sint64 d_strp_width;
-	sint64 u_strp_width;
-	sint64 dd_strp_top_displ;
-	sint64 u_strp_d_strp_overlap;
-	sint64 h_up, h_down, h_overlap;
 	stripe_2Dcoords  *stripesCoords;
 	stripe_2Dcorners *stripesCorners;
 	int resolutions_size = 0;
 	StackRestorer *stk_rst = NULL;
-	iom::real_t *buffer_ptr, *ustripe_ptr, *dstripe_ptr;	
-	iom::real_t (*blending)(double& angle, iom::real_t& pixel1, iom::real_t& pixel2);
 	std::stringstream file_path[S_MAX_MULTIRES];
 
-	//retrieving blending function
-	if(blending_algo == S_SINUSOIDAL_BLENDING)
-        blending = sinusoidal_blending;
-	else if(blending_algo == S_NO_BLENDING)
-        blending = no_blending;
-	else if(blending_algo == S_SHOW_STACK_MARGIN)
-        blending = stack_margin;
-	else
+	//checking blending function (stripes are blended by 'mergeBlock()')
+	if(blending_algo != S_SINUSOIDAL_BLENDING && blending_algo != S_NO_BLENDING && blending_algo != S_SHOW_STACK_MARGIN)
         throw iom::exception("in StackStitcher::getStripe(...): unrecognized blending function");
 
 	//initializing the progress bar
@@ -970,7 +1241,11 @@ void StackStitcher::mergeTiles(std::string output_path, int slice_height, int sl
 	//ALLOCATING  the MEMORY SPACE for image buffer
 	z_max_res = POW_INT(2,resolutions_size-1);
 	z_ratio= (int) depth/z_max_res;
-	buffer = new iom::real_t[height*width*z_max_res];
+	std::vector< std::vector<int> > tile_rows_height(resolutions_size);
+	for(int res_i=0; res_i< resolutions_size; res_i++)
+		for(int stack_row = 0; stack_row < n_stacks_V[res_i]; stack_row++)
+			tile_rows_height[res_i].push_back(stacks_height[res_i][stack_row][0]);
+	BlockMerger merger(this, z_max_res, tile_rows_height, stripesCoords, stripesCorners, restore_direction, stk_rst, blending_algo);
 
 	// 2014-10-31. Giulio. @ADDED stop and resume facility
 	FILE *fhandle;
@@ -996,249 +1271,139 @@ void StackStitcher::mergeTiles(std::string output_path, int slice_height, int sl
 		z_parts = 1;
 	}
 
-	#ifdef S_TIME_CALC
-	double proc_time;
-	#endif
-
 	for(/* 2014-10-31. Giulio. @DELETED (sint64 z = this->D0, z_parts = 1) */; z < this->D1; z += z_max_res, z_parts++)
 	{
-		// 2014-09-09. Alessandro. @FIXED missing buffer initialization and reset in 'mergeTiles()' method.
-		for(sint64 i=0; i<height*width*z_max_res; i++)
-			buffer[i]=0;
+		//buffer size along D is different when the remainder of the subdivision by z_max_res is considered
+		int z_size = (z_parts<=z_ratio) ? z_max_res : (depth%z_max_res);
+		int next_z_size = z+z_max_res >= this->D1 ? 0 : ((z_parts+1<=z_ratio) ? z_max_res : (depth%z_max_res));
 
-		for(sint64 k = 0; k < ( z_parts <= z_ratio ? z_max_res : depth%z_max_res ); k++)
+		for(int band = 0; band < merger.getBands(); band++)
 		{
-			//updating the progress bar
-			if(show_progress_bar)
-			{	
-				sprintf(progressBarMsg, "Merging slice %d of %d",((uint32)(z-D0+k+1)),(uint32)depth);
-                                ProgressBar::instance()->update(((float)(z-D0+k+1)*100/(float)depth), progressBarMsg);
-                                ProgressBar::instance()->show();
-			}
-
-			//looping on all stripes
-			for(int row_index=ROW_START; row_index<=ROW_END; row_index++)
-			{
-				//loading down stripe
-				if(row_index==ROW_START) stripe_up = NULL;
-				stripe_down = this->getStripe(row_index,(int)(z+k), restore_direction, stk_rst, blending_algo);
-
-				#ifdef S_TIME_CALC
-				proc_time = -TIME(0);
-				#endif
-
-				if(stripe_up) u_strp_bottom_displ	= stripesCoords[row_index-1].bottom_right.V	 - V0;
-				d_strp_top_displ					= stripesCoords[row_index  ].up_left.V	     - V0;
-				if(stripe_up) u_strp_top_displ      = stripesCoords[row_index-1].up_left.V	     - V0;
-				d_strp_left_displ					= stripesCoords[row_index  ].up_left.H		 - H0;
-				if(stripe_up) u_strp_left_displ     = stripesCoords[row_index-1].up_left.H		 - H0;
-				d_strp_width						= stripesCoords[row_index  ].bottom_right.H - stripesCoords[row_index  ].up_left.H;
-				if(stripe_up) u_strp_width			= stripesCoords[row_index-1].bottom_right.H - stripesCoords[row_index-1].up_left.H;
-				if(stripe_up) u_strp_d_strp_overlap = u_strp_bottom_displ - d_strp_top_displ;
-				if(row_index!=ROW_END) 
-					dd_strp_top_displ				= stripesCoords[row_index+1].up_left.V		 - V0;
-				h_up =  h_down						= u_strp_d_strp_overlap;
-
-				//overlapping zone
-				if(row_index!=ROW_START)
-				{	
-					std::list<stripe_corner>::iterator cnr_i_next, cnr_i = stripesCorners[row_index-1].merged.begin();
-					stripe_corner *cnr_left=&(*cnr_i), *cnr_right;
-					cnr_i++;
-					cnr_i_next = cnr_i;
-					cnr_i_next++;
-
-					while( cnr_i != stripesCorners[row_index-1].merged.end())
-					{
-						//computing h_up, h_overlap, h_down
-						cnr_right = &(*cnr_i);
-						if(cnr_i_next == stripesCorners[row_index-1].merged.end())
-						{
-							h_up =   cnr_left->up ? u_strp_d_strp_overlap : 0;
-							h_down = cnr_left->up ? 0                     : u_strp_d_strp_overlap;
-						}
-						else
-							if(cnr_left->up)
-								h_up = cnr_left->h;
-							else
-								h_down = cnr_left->h;
-							
-						h_overlap = u_strp_d_strp_overlap - h_up - h_down;
-
-						//splitting overlapping zone in sub-regions along H axis
-						for(sint64 j= cnr_left->H - H0; j < cnr_right->H - H0; j++)
-						{
-							delta_angle = PI/(h_overlap-1);
-							angle = 0;
-
-							//UP stripe zone
-							buffer_ptr  = &buffer[k*height*width+d_strp_top_displ*width+j];
-							ustripe_ptr = &stripe_up[(d_strp_top_displ-u_strp_top_displ)*u_strp_width +j - u_strp_left_displ];
-							for(sint64 i=d_strp_top_displ; i<d_strp_top_displ+h_up+(h_overlap >= 0 ?  0 : h_overlap); i++, buffer_ptr+=width, ustripe_ptr+= u_strp_width)
-								*buffer_ptr = *ustripe_ptr;
-
-							//OVERLAPPING zone
-							buffer_ptr  = &buffer[k*height*width+(d_strp_top_displ+h_up)*width+j];
-							ustripe_ptr = &stripe_up[(d_strp_top_displ+h_up-u_strp_top_displ)*u_strp_width +j - u_strp_left_displ];
-							dstripe_ptr = &stripe_down[(d_strp_top_displ+h_up-d_strp_top_displ)*d_strp_width +j - d_strp_left_displ];
-							for(sint64 i=d_strp_top_displ+h_up; i<d_strp_top_displ+h_up+h_overlap; i++, buffer_ptr+=width, ustripe_ptr+= u_strp_width, dstripe_ptr+=d_strp_width, angle+=delta_angle)
-								*buffer_ptr = blending(angle,*ustripe_ptr,*dstripe_ptr);
-
-							//DOWN stripe zone
-							buffer_ptr = &buffer[k*height*width+(d_strp_top_displ+h_up+(h_overlap >= 0 ? h_overlap : 0))*width+j];
-							dstripe_ptr = &stripe_down[((d_strp_top_displ+h_up+(h_overlap >= 0 ? h_overlap : 0))-d_strp_top_displ)*d_strp_width +j - d_strp_left_displ];
-							for(sint64 i=d_strp_top_displ+h_up+(h_overlap >= 0 ? h_overlap : 0); i<d_strp_top_displ+h_up+h_overlap+h_down; i++, buffer_ptr+=width, dstripe_ptr+=d_strp_width)
-								*buffer_ptr = *dstripe_ptr;
-						}
-
-						cnr_left = cnr_right;
-						cnr_i++;
-						if(cnr_i_next != stripesCorners[row_index-1].merged.end())
-							cnr_i_next++;
-					}
-				}
-
-				//non-overlapping zone
-				buffer_ptr = &buffer[k*height*width+((row_index==ROW_START ? 0 : u_strp_bottom_displ))*width];
-				for(sint64 i= (row_index==ROW_START ? 0 : u_strp_bottom_displ); i<(row_index==ROW_END? height : dd_strp_top_displ); i++)
-				{
-					dstripe_ptr = &stripe_down[(i-d_strp_top_displ)*d_strp_width - d_strp_left_displ];
-					for(sint64 j=0; j<width; j++, buffer_ptr++, dstripe_ptr++)
-						if(j - d_strp_left_displ >= 0 && j - d_strp_left_displ < stripesCoords[row_index].bottom_right.H)
-							*buffer_ptr = *dstripe_ptr;
-				}
-
-				//moving to bottom stripe_up
-				delete stripe_up;
-				stripe_up=stripe_down;
-
-				#ifdef S_TIME_CALC
-				proc_time += TIME(0);
-				StackStitcher::time_merging+=proc_time;
-				#endif
-			}
-			//releasing last stripe_down
-			delete stripe_down;
-		}
-		
-		//saving current buffer data at selected resolutions and in multitile format
-		for(int i=0; i< resolutions_size; i++)
-		{
-			if(show_progress_bar)
-			{
-				sprintf(progressBarMsg, "Generating resolution %d of %d",i+1,ISR_MAX(resolutions_size, resolutions_size));
-                                ProgressBar::instance()->updateInfo(progressBarMsg);
-                                ProgressBar::instance()->show();
-			}
-
-			//buffer size along D is different when the remainder of the subdivision by z_max_res is considered
-			int z_size = (z_parts<=z_ratio) ? z_max_res : (depth%z_max_res);
-
-			//halvesampling resolution if current resolution is not the deepest one
-			if(i!=0)	
-				StackStitcher::halveSample(buffer,(int)(height/(POW_INT(2,i-1))),(int)(width/(POW_INT(2,i-1))),(int)(z_size/(POW_INT(2,i-1))),method);
-
-			//saving at current resolution if it has been selected and iff buffer is at least 1 voxel (Z) deep
-			if(resolutions[i] && (z_size/(POW_INT(2,i))) > 0)
+			//merging current band of slices (the next one is merged in background while the current one is saved, if enabled)
+			bool last_band = band == merger.getBands()-1;
+			merger.merge(z, z_size, band, last_band ? z+z_max_res : z, last_band ? next_z_size : z_size, last_band ? 0 : band+1, show_progress_bar);
+			buffer = merger.buffer;
+			int band_V0 = merger.getBandV0(band), band_height = merger.getBandHeight(band);
+
+			//saving current buffer data at selected resolutions and in multitile format
+			for(int i=0; i< resolutions_size; i++)
 			{
 				if(show_progress_bar)
 				{
-					sprintf(progressBarMsg, "Saving to disc resolution %d",i+1);
-                                        ProgressBar::instance()->updateInfo(progressBarMsg);
-                                        ProgressBar::instance()->show();
+					sprintf(progressBarMsg, "Generating resolution %d of %d",i+1,ISR_MAX(resolutions_size, resolutions_size));
+	                                ProgressBar::instance()->updateInfo(progressBarMsg);
+	                                ProgressBar::instance()->show();
 				}
 
-				//storing in 'base_path' the absolute path of the directory that will contain all stacks
-				std::stringstream base_path;
-                                base_path << output_path << "/RES(" << (int)(height/POW_INT(2,i)) << "x" << (int)(width/POW_INT(2,i)) << "x" << (int)(depth/POW_INT(2,i)) << ")/";
+				//halvesampling resolution if current resolution is not the deepest one
+				if(i!=0)	
+					StackStitcher::halveSample(buffer,(int)(band_height/(POW_INT(2,i-1))),(int)(width/(POW_INT(2,i-1))),(int)(z_size/(POW_INT(2,i-1))),method);
 
-				//looping on new stacks
-				for(int stack_row = 0, start_height = 0, end_height = 0; stack_row < n_stacks_V[i]; stack_row++)
+				//saving at current resolution if it has been selected and iff buffer is at least 1 voxel (Z) deep
+				if(resolutions[i] && (z_size/(POW_INT(2,i))) > 0)
 				{
-					//incrementing end_height
-					end_height = start_height + stacks_height[i][stack_row][0]-1;
-						
-					//computing V_DIR_path and creating the directory the first time it is needed
-					std::stringstream V_DIR_path;
-					V_DIR_path << base_path.str() << this->getMultiresABS_V_string(i,start_height);
-					if(!test_mode && z==D0 && !make_dir(V_DIR_path.str().c_str()))
+					if(show_progress_bar)
 					{
-						char err_msg[S_STATIC_STRINGS_SIZE];
-						sprintf(err_msg, "in mergeTiles(...): unable to create V_DIR = \"%s\"\n", V_DIR_path.str().c_str());
-						throw iom::exception(err_msg);
+						sprintf(progressBarMsg, "Saving to disc resolution %d",i+1);
+	                                        ProgressBar::instance()->updateInfo(progressBarMsg);
+	                                        ProgressBar::instance()->show();
 					}
 
-					for(int stack_column = 0, start_width=0, end_width=0; stack_column < n_stacks_H[i]; stack_column++)
+					//storing in 'base_path' the absolute path of the directory that will contain all stacks
+					std::stringstream base_path;
+	                                base_path << output_path << "/RES(" << (int)(height/POW_INT(2,i)) << "x" << (int)(width/POW_INT(2,i)) << "x" << (int)(depth/POW_INT(2,i)) << ")/";
+
+					//looping on new stacks
+					for(int stack_row = 0, start_height = 0, end_height = 0; stack_row < n_stacks_V[i]; start_height += stacks_height[i][stack_row][0], stack_row++)
 					{
-						end_width  = start_width  + stacks_width [i][stack_row][stack_column]-1;
-							
-						//computing H_DIR_path and creating the directory the first time it is needed
-						std::stringstream H_DIR_path;
-						H_DIR_path << V_DIR_path.str() << "/" << this->getMultiresABS_V_string(i,start_height) << "_" << this->getMultiresABS_H_string(i,start_width);
-						if(!test_mode && z==D0 && !make_dir(H_DIR_path.str().c_str()))
+						//skipping rows of tiles saved with another band
+						if(start_height < band_V0/POW_INT(2,i) || start_height >= band_V0/POW_INT(2,i)+band_height/POW_INT(2,i))
+							continue;
+
+						//incrementing end_height
+						end_height = start_height + stacks_height[i][stack_row][0]-1;
+						
+						//computing V_DIR_path and creating the directory the first time it is needed
+						std::stringstream V_DIR_path;
+						V_DIR_path << base_path.str() << this->getMultiresABS_V_string(i,start_height);
+						if(!test_mode && z==D0 && !make_dir(V_DIR_path.str().c_str()))
 						{
 							char err_msg[S_STATIC_STRINGS_SIZE];
-							sprintf(err_msg, "in mergeTiles(...): unable to create H_DIR = \"%s\"\n", H_DIR_path.str().c_str());
+							sprintf(err_msg, "in mergeTiles(...): unable to create V_DIR = \"%s\"\n", V_DIR_path.str().c_str());
 							throw iom::exception(err_msg);
 						}
 
-						//saving HERE
-						for(int buffer_z=0; buffer_z<z_size/(POW_INT(2,i)); buffer_z++)
+						for(int stack_column = 0, start_width=0, end_width=0; stack_column < n_stacks_H[i]; stack_column++)
 						{
-							std::stringstream img_path;
-							int rel_pos_z = POW_INT(2,i)*buffer_z+(int)(z)-D0;		// Alessandro, 23/03/2013 - see below. This is the relative Z pixel coordinate in the 
-																			// highest resolution image space. '-D0' is necessary to make it relative, since
-																			// getMultiresABS_D_string(...) accepts relative coordinates only.
-
-							/*std::stringstream abs_pos_z;
-							abs_pos_z.width(6);
-							abs_pos_z.fill('0');
-							abs_pos_z << (int)(POW_INT(2,i)*buffer_z+z);*/	// Alessandro, 23/03/2013 - bug found: we are saving the image space coordinate (in pixels) 
-																			// instead of the volume space coordinate (in tenths of microns)
-							img_path << H_DIR_path.str() << "/" 
-										<< this->getMultiresABS_V_string(i,start_height) << "_" 
-										<< this->getMultiresABS_H_string(i,start_width)  << "_"
-										// << abs_pos_z.str();							// Alessandro, 23/03/2013 - bug found: see above
-										<< this->getMultiresABS_D_string(0, rel_pos_z);	// Alessandro, 23/03/2013 - we pass '0' because rel_pos_z is the relative Z
-																						// pixel coordinate in the HIGHEST (i=0) resolution image space (see above).
-							if(test_mode)
+							end_width  = start_width  + stacks_width [i][stack_row][stack_column]-1;
+							
+							//computing H_DIR_path and creating the directory the first time it is needed
+							std::stringstream H_DIR_path;
+							H_DIR_path << V_DIR_path.str() << "/" << this->getMultiresABS_V_string(i,start_height) << "_" << this->getMultiresABS_H_string(i,start_width);
+							if(!test_mode && z==D0 && !make_dir(H_DIR_path.str().c_str()))
+							{
+								char err_msg[S_STATIC_STRINGS_SIZE];
+								sprintf(err_msg, "in mergeTiles(...): unable to create H_DIR = \"%s\"\n", H_DIR_path.str().c_str());
+								throw iom::exception(err_msg);
+							}
+
+							//saving HERE
+							for(int buffer_z=0; buffer_z<z_size/(POW_INT(2,i)); buffer_z++)
 							{
-								img_path.str("");
-								img_path << volume->getSTACKS_DIR() << "/test_middle_slice";
-							//	// 2014-11-25. Giulio. @CHANGED the "tiff2D" plugin is explicitly used because in test mode the output plugin may not be a 2D plugin
-							//	//iomanager::IOPluginFactory::getPlugin2D("tiff2D")->writeData(
-							//	iim::VirtualVolume::saveImage(
-							//		img_path.str(), 
-							//		buffer + buffer_z*(height/POW_INT(2,i))*(width/POW_INT(2,i)),
-							//		(int)(height/(POW_INT(2,i))),
-							//		(int)(width/(POW_INT(2,i))),
-							//		start_height,
-							//		end_height,
-							//		start_width,
-							//		end_width, 
-							//		saved_img_format,
-							//		saved_img_depth);
+								std::stringstream img_path;
+								int rel_pos_z = POW_INT(2,i)*buffer_z+(int)(z)-D0;		// Alessandro, 23/03/2013 - see below. This is the relative Z pixel coordinate in the 
+																				// highest resolution image space. '-D0' is necessary to make it relative, since
+																				// getMultiresABS_D_string(...) accepts relative coordinates only.
+
+								/*std::stringstream abs_pos_z;
+								abs_pos_z.width(6);
+								abs_pos_z.fill('0');
+								abs_pos_z << (int)(POW_INT(2,i)*buffer_z+z);*/	// Alessandro, 23/03/2013 - bug found: we are saving the image space coordinate (in pixels) 
+																				// instead of the volume space coordinate (in tenths of microns)
+								img_path << H_DIR_path.str() << "/" 
+											<< this->getMultiresABS_V_string(i,start_height) << "_" 
+											<< this->getMultiresABS_H_string(i,start_width)  << "_"
+											// << abs_pos_z.str();							// Alessandro, 23/03/2013 - bug found: see above
+											<< this->getMultiresABS_D_string(0, rel_pos_z);	// Alessandro, 23/03/2013 - we pass '0' because rel_pos_z is the relative Z
+																							// pixel coordinate in the HIGHEST (i=0) resolution image space (see above).
+								if(test_mode)
+								{
+									img_path.str("");
+									img_path << volume->getSTACKS_DIR() << "/test_middle_slice";
+								//	// 2014-11-25. Giulio. @CHANGED the "tiff2D" plugin is explicitly used because in test mode the output plugin may not be a 2D plugin
+								//	//iomanager::IOPluginFactory::getPlugin2D("tiff2D")->writeData(
+								//	iim::VirtualVolume::saveImage(
+								//		img_path.str(), 
+								//		buffer + buffer_z*(height/POW_INT(2,i))*(width/POW_INT(2,i)),
+								//		(int)(height/(POW_INT(2,i))),
+								//		(int)(width/(POW_INT(2,i))),
+								//		start_height,
+								//		end_height,
+								//		start_width,
+								//		end_width, 
+								//		saved_img_format,
+								//		saved_img_depth);
+								}
+								//else {
+									// 2015-02-14. Giulio. restored call to saveImage which now calls the plugin
+									// 2014-09-10. Alessandro. @FIXED 'mergeTiles()' method to include plugin support.
+									//iomanager::IOPluginFactory::getPlugin2D(iomanager::IMOUT_PLUGIN)->writeData(
+									iim::VirtualVolume::saveImage(
+										img_path.str(), 
+										buffer + buffer_z*(band_height/POW_INT(2,i))*(width/POW_INT(2,i)),
+										(int)(band_height/(POW_INT(2,i))),
+										(int)(width/(POW_INT(2,i))),
+										start_height - band_V0/POW_INT(2,i),
+										end_height - band_V0/POW_INT(2,i),
+										start_width,
+										end_width, 
+										saved_img_format,
+										saved_img_depth);
+								//}
 							}
-							//else {
-								// 2015-02-14. Giulio. restored call to saveImage which now calls the plugin
-								// 2014-09-10. Alessandro. @FIXED 'mergeTiles()' method to include plugin support.
-								//iomanager::IOPluginFactory::getPlugin2D(iomanager::IMOUT_PLUGIN)->writeData(
-								iim::VirtualVolume::saveImage(
-									img_path.str(), 
-									buffer + buffer_z*(height/POW_INT(2,i))*(width/POW_INT(2,i)),
-									(int)(height/(POW_INT(2,i))),
-									(int)(width/(POW_INT(2,i))),
-									start_height,
-									end_height,
-									start_width,
-									end_width, 
-									saved_img_format,
-									saved_img_depth);
-							//}
+							start_width  += stacks_width [i][stack_row][stack_column];
 						}
-						start_width  += stacks_width [i][stack_row][stack_column];
 					}
-					start_height += stacks_height[i][stack_row][0];
 				}
 			}
 		}
@@ -1298,8 +1463,7 @@ void StackStitcher::mergeTiles(std::string output_path, int slice_height, int sl
 		delete []stacks_width[res_i]; 
 	}
 
-	//releasing allocated memory
-	delete buffer;
+	//releasing allocated memory (the buffer is owned by <merger>)
 	if(stk_rst)
 		delete stk_rst;
 	delete []stripesCoords;
@@ -1320,72 +1484,15 @@ void StackStitcher::halveSample(iom::real_t* img, int height, int width, int dep
 	double proc_time = -TIME(0);
 	#endif
 
-	float A,B,C,D,E,F,G,H;
-
-	// indices are sint64 because offsets can be larger that 2^31 - 1
-
-	if ( method == HALVE_BY_MEAN ) {
-
-		for(sint64 z=0; z<depth/2; z++)
-		{
-			for(sint64 i=0; i<height/2; i++)
-			{
-				for(sint64 j=0; j<width/2; j++)
-				{
-					//computing 8-neighbours
-					A = img[2*z*width*height +2*i*width + 2*j];
-					B = img[2*z*width*height +2*i*width + (2*j+1)];
-					C = img[2*z*width*height +(2*i+1)*width + 2*j];
-					D = img[2*z*width*height +(2*i+1)*width + (2*j+1)];
-					E = img[(2*z+1)*width*height +2*i*width + 2*j];
-					F = img[(2*z+1)*width*height +2*i*width + (2*j+1)];
-					G = img[(2*z+1)*width*height +(2*i+1)*width + 2*j];
-					H = img[(2*z+1)*width*height +(2*i+1)*width + (2*j+1)];
-
-					//computing mean
-					img[z*(width/2)*(height/2)+i*(width/2)+j] = (A+B+C+D+E+F+G+H)/(float)8;
-				}
-			}
-		}
-
-	}
-	else if ( method == HALVE_BY_MAX ) {
-
-		for(sint64 z=0; z<depth/2; z++)
-		{
-			for(sint64 i=0; i<height/2; i++)
-			{
-				for(sint64 j=0; j<width/2; j++)
-				{
-					//computing max of 8-neighbours
-					A = img[2*z*width*height + 2*i*width + 2*j];
-					B = img[2*z*width*height + 2*i*width + (2*j+1)];
-					if ( B > A ) A = B;
-					B = img[2*z*width*height + (2*i+1)*width + 2*j];
-					if ( B > A ) A = B;
-					B = img[2*z*width*height + (2*i+1)*width + (2*j+1)];
-					if ( B > A ) A = B;
-					B = img[(2*z+1)*width*height + 2*i*width + 2*j];
-					if ( B > A ) A = B;
-					B = img[(2*z+1)*width*height + 2*i*width + (2*j+1)];
-					if ( B > A ) A = B;
-					B = img[(2*z+1)*width*height + (2*i+1)*width + 2*j];
-					if ( B > A ) A = B;
-					B = img[(2*z+1)*width*height + (2*i+1)*width + (2*j+1)];
-					if ( B > A ) A = B;
-
-					//computing mean
-					img[z*(width/2)*(height/2) + i*(width/2) + j] = A;
-				}
-			}
-		}
-
-	}
-	else {
+	if ( method != HALVE_BY_MEAN && method != HALVE_BY_MAX ) {
 		char buffer[S_STATIC_STRINGS_SIZE];
 		sprintf(buffer,"in halveSample(...): invalid halving method\n");
         throw iom::exception(buffer);
 	}
+
+	// vectorized kernels with runtime CPU dispatch (see HalveSample.h)
+	iim::halveSample3D(img, height, width, depth, method == HALVE_BY_MAX);
+
 	#ifdef S_TIME_CALC
 	proc_time += TIME(0);
 	StackStitcher::time_multiresolution+=proc_time;
@@ -1403,60 +1510,15 @@ void StackStitcher::halveSample2D(iom::real_t* img, int height, int width, int d
 	double proc_time = -TIME(0);
 	#endif
 
-	float A,B,C,D;
-
-	// indices are sint64 because offsets can be larger that 2^31 - 1
-
-	if ( method == HALVE_BY_MEAN ) {
-
-		for(sint64 z=0; z<depth; z++)
-		{
-			for(sint64 i=0; i<height/2; i++)
-			{
-				for(sint64 j=0; j<width/2; j++)
-				{
-					//computing 8-neighbours
-					A = img[z*width*height +2*i*width + 2*j];
-					B = img[z*width*height +2*i*width + (2*j+1)];
-					C = img[z*width*height +(2*i+1)*width + 2*j];
-					D = img[z*width*height +(2*i+1)*width + (2*j+1)];
-
-					//computing mean
-					img[z*(width/2)*(height/2)+i*(width/2)+j] = (A+B+C+D)/(float)4;
-				}
-			}
-		}
-
-	}
-	else if ( method == HALVE_BY_MAX ) {
-
-		for(sint64 z=0; z<depth; z++)
-		{
-			for(sint64 i=0; i<height/2; i++)
-			{
-				for(sint64 j=0; j<width/2; j++)
-				{
-					//computing max of 8-neighbours
-					A = img[z*width*height + 2*i*width + 2*j];
-					B = img[z*width*height + 2*i*width + (2*j+1)];
-					if ( B > A ) A = B;
-					B = img[z*width*height + (2*i+1)*width + 2*j];
-					if ( B > A ) A = B;
-					B = img[z*width*height + (2*i+1)*width + (2*j+1)];
-					if ( B > A ) A = B;
-
-					//computing max
-					img[z*(width/2)*(height/2) + i*(width/2) + j] = A;
-				}
-			}
-		}
-
-	}
-	else {
+	if ( method != HALVE_BY_MEAN && method != HALVE_BY_MAX ) {
 		char buffer[S_STATIC_STRINGS_SIZE];
 		sprintf(buffer,"in halveSample(...): invalid halving method\n");
         throw iom::exception(buffer);
 	}
+
+	// vectorized kernels with runtime CPU dispatch (see HalveSample.h)
+	iim::halveSample2D(img, height, width, depth, method == HALVE_BY_MAX);
+
 	#ifdef S_TIME_CALC
 	proc_time += TIME(0);
 	StackStitcher::time_multiresolution+=proc_time;
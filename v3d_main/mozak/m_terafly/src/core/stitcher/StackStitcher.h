@@ -51,6 +51,8 @@
 #endif
 
 class StackRestorer;
+struct stripe_2Dcoords;
+struct stripe_2Dcorners;
 
 // #ifndef _VIRTUAL_VOLUME_H
 // class volumemanager::VirtualVolume;
@@ -65,6 +67,7 @@ class StackRestorer;
 class StackStitcher
 {
 	friend class UnstitchedVolume; // 2015-02-18. Giulio. added unstitched volume
+	friend class BlockMerger;
 
 	private:
 
@@ -73,6 +76,7 @@ class StackStitcher
 		volumemanager::VirtualVolume *volume;		//pointer to the <VirtualVolume> object to be stitched
         int V0, V1, H0, H1, D0, D1;					//voxel intervals that identify the final stitched volume
         int ROW_START, COL_START, ROW_END, COL_END; //stack indexes that identify the stacks involved in stitching
+		int n_threads;								//number of threads used for pairwise displacements computation (default: 1)
 
 		/******CLASS MEMBERS******/
 		static double time_displ_comp;				//time employed for pairwise displacements computation
@@ -95,13 +99,28 @@ class StackStitcher
 		* stored before it is combined into the final stripe.
 		**************************************************************************************************************/
 		iom::real_t* getStripe(int row_index, int d_index, int restore_direction=-1, StackRestorer* stk_rst=NULL,
-						  int blending_algo=S_SINUSOIDAL_BLENDING)    							   throw (iom::exception);
+						  int blending_algo=S_SINUSOIDAL_BLENDING, int d_size=1)    			   throw (iom::exception);
+
+		/*************************************************************************************************************
+		* Merges the <z_size> slices starting at <z> into <buffer>, which stores the <v_size> rows starting at <v0> of
+		* the slices of the volume to be stitched. Only the stripes overlapping these rows are loaded. Stripes are ob-
+		* tained <d_size> slices at a time. Used by <BlockMerger>.
+		**************************************************************************************************************/
+		void mergeBlock(iom::real_t* buffer, iom::sint64 z, int z_size, int v0, int v_size, int d_size, stripe_2Dcoords* stripesCoords,
+						stripe_2Dcorners* stripesCorners, int restore_direction, StackRestorer* stk_rst, int blending_algo,
+						bool show_progress_bar)																   throw (iom::exception);
 
 		/*************************************************************************************************************
 		* Returns the (up = true -> TOP, up = false -> BOTTOM) V coordinate of the virtual stripe at <row_index> row. 
 		**************************************************************************************************************/
 		int getStripeABS_V(int row_index, bool up);
 
+		/*************************************************************************************************************
+		* Called by 'computeDisplacements()' when all the displacements of the given stack in the current layer have 
+		* been computed: computes its SPIM descriptors (if a <StackRestorer> object has been passed) and releases it.
+		**************************************************************************************************************/
+		void releaseLayerStack(volumemanager::VirtualStack* stk, StackRestorer* stk_rst, int layer, int z_start, int subvol_DIM_D_k);
+
 
 
 		/***CLASS PRIVATE METHODS****/
@@ -169,6 +188,11 @@ class StackStitcher
 		// WARNING: the distructor does not deallocate the 'volume' field
 		~StackStitcher(void);
 
+		// number of threads used by 'computeDisplacements()': the displacements of the pairs of adjacent stacks in the
+		// same row (or column) of each layer are computed concurrently
+		void setThreads(int _n_threads) { n_threads = _n_threads < 1 ? 1 : _n_threads; }
+		int getThreads() { return n_threads; }
+
 		// compute pairwise displacements
 		// 2014-09-12. Alessandro. @ADDED [z0, z1] subdata selection along Z in the 'computeDisplacements()' method.
 		void computeDisplacements(
@@ -99,6 +99,13 @@ class VolumeConverter
 		const char *out_fmt;    // output format (for future use, currently not used: the output format is derived
 		                  // implicitly from internal_rep and the format of the source image)
 
+		int n_threads;    // number of threads used by tile generation (default: 1, i.e. sequential conversion)
+		                  // if > 1, the next slab is read while the current one is halved and saved, and the
+		                  // tiles of each resolution are saved concurrently by a bounded pool of n_threads workers
+
+		std::string chunk_codec;  // codec of the chunks saved by generateTilesChunked (default: "zlib")
+		int chunk_level;          // compression level of the chunks saved by generateTilesChunked (default: 1)
+
     public:
 
 		// Constructors
@@ -134,6 +141,22 @@ class VolumeConverter
             int method = HALVE_BY_MEAN                  // downsampling method
         ) throw (iim::IOException);
 
+		/*************************************************************************************************************
+		* Sets the number of threads used by the tile generation methods (values < 1 are treated as 1). With more
+		* than one thread, reading, halving and saving of different slabs/resolutions are pipelined: this requires
+		* RAM for two slabs instead of one.
+		**************************************************************************************************************/
+		void setThreads(int _n_threads) { n_threads = _n_threads < 1 ? 1 : _n_threads; }
+		int getThreads() { return n_threads; }
+
+		/*************************************************************************************************************
+		* Sets the codec used by generateTilesChunked: "raw", "zlib", "zstd", "lz4" or "blosc" (see ChunkedFmtMngr.h
+		* for the codecs actually available) and its compression level (meaning depends on the codec).
+		**************************************************************************************************************/
+		void setChunkCodec(std::string _codec, int _level) throw (iim::IOException);
+		std::string getChunkCodec() { return chunk_codec; }
+		int getChunkLevel() { return chunk_level; }
+
 		/*************************************************************************************************************
 		* Method to be called for tile generation. <> parameters are mandatory, while [] are optional.
 		* <output_path>			: absolute directory path where generated tiles have to be stored.
@@ -255,6 +278,17 @@ class VolumeConverter
             const char* saved_img_format = "h5", int saved_img_depth = iim::NUL_IMG_DEPTH,
             std::string frame_dir = "")	throw (iim::IOException);
 
+		/*************************************************************************************************************
+		* Method to be called for the generation of a chunked (Zarr-style) multiresolution volume, i.e. one chunked 
+		* array per resolution in directories RES(VxHxD) of <output_path> (see ChunkedFmtMngr.h). Parameters are the
+		* same of generateTilesBDV_HDF5, where block dimensions are the chunk dimensions (default: 128x128x64).
+		* Chunks are compressed with the codec set by setChunkCodec and, if setThreads has been called with more
+		* than one thread, they are compressed and saved concurrently. Only UINT8 internal representation is supported.
+		**************************************************************************************************************/
+		void generateTilesChunked ( std::string output_path, bool* resolutions = NULL, 
+			int block_height = -1, int block_width = -1, int block_depth = -1, int method = HALVE_BY_MEAN, bool show_progress_bar = true, 
+            int saved_img_depth = iim::NUL_IMG_DEPTH)	throw (iim::IOException);
+
 };
 
 #endif
@@ -2,6 +2,7 @@
 #include <cmath>
 #include <fstream>
 #include "m_PLog.h"
+#include "BlockCache.h"
 
 using namespace teramanager;
 
@@ -51,6 +52,7 @@ PLog::PLog(QWidget *parent) : QDialog(parent)
     appendOpComboBox->addItem(itm::TiffLoadData().name().c_str());
     appendOpComboBox->addItem(itm::TiffInitData().name().c_str());
     appendOpComboBox->addItem(itm::TiffAppendData().name().c_str());
+    appendOpComboBox->addItem(itm::TiledLoadSubvolume().name().c_str());
     appendCompComboBox = new QComboBox();
     appendCompComboBox->setEnabled(false);
     appendCompComboBox->addItem("--component--");
@@ -169,6 +171,16 @@ void PLog::update()
                         "I/O waiting time: " + QString::number(timeIO, 'f', 3).append("s (").append(QString::number(timeIOperc, 'f', 1)).append("%%)\n") +
                         "GPU waiting time: " + QString::number(timeGPU, 'f', 3).append("s (").append(QString::number(timeGPUperc, 'f', 1)).append("%%)\n") +
                         "CPU waiting time: " + QString::number(timeCPU, 'f', 3).append("s (").append(QString::number(timeCPUperc, 'f', 1)).append("%%)\n");
+
+    // cache of decoded TIFF slices
+    iim::BlockCache::Stats cache = iim::BlockCache::instance().getStats();
+    double lookups = double(cache.hits + cache.misses);
+    compText += "TIFF slice cache: " + QString::number(cache.blocks_cached) + " slices, " +
+                QString::number(cache.bytes_cached/(1024.0*1024.0), 'f', 1) + "/" + QString::number(iim::BLOCK_CACHE_SIZE_MB) + " MB, " +
+                QString::number(cache.hits) + " hits (" + QString::number(lookups > 0 ? (100.0*cache.hits)/lookups : 0.0, 'f', 1) + "%), " +
+                QString::number(cache.misses) + " misses, " + QString::number(cache.evictions) + " evictions\n" +
+                "TIFF slice cache: " + QString::number(cache.bytes_hit/(1024.0*1024.0), 'f', 1) + " MB served, " +
+                QString::number(cache.bytes_decoded/(1024.0*1024.0), 'f', 1) + " MB decoded\n";
     timeComponents->setText(compText);
 
     // time operations
@@ -318,6 +330,7 @@ void PLog::reset()
     /**/itm::debug(itm::LEV1, 0, __itm__current__function__);
 
     timeIO = timeGPU = timeCPU = timeActual = 0.0f;
+    iim::BlockCache::instance().resetStats();
 
     timeOperations->setText("");
     timeComponents->setText("");
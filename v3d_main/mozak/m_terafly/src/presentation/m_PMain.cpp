@@ -341,6 +341,43 @@ PMain::PMain(V3DPluginCallback2 *callback, QWidget *parent) : QWidget(parent)
     fdPreviewAction->setChecked(CSettings::instance()->getPreviewMode());
     fdDirectAction->setChecked(!fdPreviewAction->isChecked());
     connect(fdPreviewAction, SIGNAL(changed()), this, SLOT(fetchAndDisplayChanged()));
+    /* ------------------------- "Options" menu: I/O ----------------------------- */
+    ioMenu = optionsMenu->addMenu("I/O");
+    /* ------------------------- "Options->I/O" menu: Read threads -------------- */
+    ioThreadsMenu = ioMenu->addMenu("Read threads");
+    ioThreadsWidget = new QWidgetAction(this);
+    ioThreadsSpinBox = new QSpinBox();
+    ioThreadsSpinBox->setMinimum(1);
+    ioThreadsSpinBox->setMaximum(64);
+    ioThreadsSpinBox->setSuffix(" (files)");
+    ioThreadsSpinBox->setValue(CSettings::instance()->getIOThreads());
+    ioThreadsWidget->setDefaultWidget(ioThreadsSpinBox);
+    ioThreadsMenu->addAction(ioThreadsWidget);
+    connect(ioThreadsSpinBox, SIGNAL(valueChanged(int)), this, SLOT(ioThreadsChanged(int)));
+    /* ------------------------- "Options->I/O" menu: TIFF codec threads -------- */
+    codecThreadsMenu = ioMenu->addMenu("TIFF codec threads");
+    codecThreadsWidget = new QWidgetAction(this);
+    codecThreadsSpinBox = new QSpinBox();
+    codecThreadsSpinBox->setMinimum(1);
+    codecThreadsSpinBox->setMaximum(64);
+    codecThreadsSpinBox->setSuffix(" (pages)");
+    codecThreadsSpinBox->setValue(CSettings::instance()->getCodecThreads());
+    codecThreadsWidget->setDefaultWidget(codecThreadsSpinBox);
+    codecThreadsMenu->addAction(codecThreadsWidget);
+    connect(codecThreadsSpinBox, SIGNAL(valueChanged(int)), this, SLOT(codecThreadsChanged(int)));
+    /* ------------------------- "Options->I/O" menu: Slice cache size ---------- */
+    blockCacheMenu = ioMenu->addMenu("Slice cache size");
+    blockCacheWidget = new QWidgetAction(this);
+    blockCacheSpinBox = new QSpinBox();
+    blockCacheSpinBox->setMinimum(0);
+    blockCacheSpinBox->setMaximum(65536);
+    blockCacheSpinBox->setSingleStep(128);
+    blockCacheSpinBox->setSuffix(" MB");
+    blockCacheSpinBox->setSpecialValueText("disabled");
+    blockCacheSpinBox->setValue(CSettings::instance()->getBlockCacheSize());
+    blockCacheWidget->setDefaultWidget(blockCacheSpinBox);
+    blockCacheMenu->addAction(blockCacheWidget);
+    connect(blockCacheSpinBox, SIGNAL(valueChanged(int)), this, SLOT(blockCacheSizeChanged(int)));
 
 
 
@@ -2527,6 +2564,33 @@ void PMain::fetchAndDisplayChanged()
     CSettings::instance()->writeSettings();
 }
 
+/**********************************************************************************
+* Called when the corresponding Options->I/O actions are triggered
+***********************************************************************************/
+void PMain::ioThreadsChanged(int n)
+{
+    /**/itm::debug(itm::LEV2, 0, __itm__current__function__);
+
+    CSettings::instance()->setIOThreads(n);
+    CSettings::instance()->writeSettings();
+}
+
+void PMain::codecThreadsChanged(int n)
+{
+    /**/itm::debug(itm::LEV2, 0, __itm__current__function__);
+
+    CSettings::instance()->setCodecThreads(n);
+    CSettings::instance()->writeSettings();
+}
+
+void PMain::blockCacheSizeChanged(int s)
+{
+    /**/itm::debug(itm::LEV2, 0, __itm__current__function__);
+
+    CSettings::instance()->setBlockCacheSize(s);
+    CSettings::instance()->writeSettings();
+}
+
 /**********************************************************************************
 * Called when the corresponding Options->3D annotation->Virtual space size actions are triggered
 ***********************************************************************************/
@@ -123,6 +123,17 @@ class teramanager::PMain : public QWidget
         QMenu* fetchDisplayMenu;        //"Fetch-and-display" menu level 3
         QAction* fdPreviewAction;       //"Preview/streaming" checkbox
         QAction* fdDirectAction;        //"Direct" action
+        // ---- I/O menu level ---------------------- 2
+        QMenu* ioMenu;                  //"I/O" menu level 2
+        QMenu* ioThreadsMenu;           //"Read threads" menu level 3
+        QWidgetAction* ioThreadsWidget; //"Read threads" menu action widget
+        QSpinBox* ioThreadsSpinBox;     //"Read threads" spinbox
+        QMenu* codecThreadsMenu;        //"TIFF codec threads" menu level 3
+        QWidgetAction* codecThreadsWidget; //"TIFF codec threads" menu action widget
+        QSpinBox* codecThreadsSpinBox;  //"TIFF codec threads" spinbox
+        QMenu* blockCacheMenu;          //"Slice cache size" menu level 3
+        QWidgetAction* blockCacheWidget; //"Slice cache size" menu action widget
+        QSpinBox* blockCacheSpinBox;    //"Slice cache size" spinbox
 
         // "Utility" menu widgets
         QMenu* utilityMenu;
@@ -438,6 +449,13 @@ class teramanager::PMain : public QWidget
         ***********************************************************************************/
         void fetchAndDisplayChanged();
 
+        /**********************************************************************************
+        * Called when the corresponding Options->I/O actions are triggered
+        ***********************************************************************************/
+        void ioThreadsChanged(int n);
+        void codecThreadsChanged(int n);
+        void blockCacheSizeChanged(int s);
+
         /**********************************************************************************
         * Linked to verbosity combobox
         ***********************************************************************************/
@@ -92,6 +92,7 @@ void CConverter::setMembers(PConverter* pConverter) throw (RuntimeException)
            outVolFormat.compare(iim::TILED_MC_FORMAT)       != 0 &&
            outVolFormat.compare(iim::TILED_TIF3D_FORMAT)    != 0 &&
             outVolFormat.compare(iim::BDV_HDF5_FORMAT)      != 0 &&
+           outVolFormat.compare(iim::CHUNKED_FORMAT)        != 0 &&
            outVolFormat.compare(iim::TILED_MC_TIF3D_FORMAT) != 0)
         {
             sprintf(errMsg, "Output format \"%s\" not yet supported", outVolFormat.c_str());
@@ -118,6 +119,7 @@ void CConverter::setMembers(PConverter* pConverter) throw (RuntimeException)
         stacksDepth = pConverter->blockDepthField->value();
         downsamplingMethod = pConverter->downsamplingCbox->currentIndex();
         time_series = pConverter->timeSeriesCheckBox->isChecked();
+        threads = pConverter->threadsField->value();
         if(downsamplingMethod == 0)
             downsamplingMethod = HALVE_BY_MEAN;
         else if(downsamplingMethod == 1)
@@ -150,6 +152,7 @@ void CConverter::run()
             if(!outFileMode && !QDir(outVolPath.c_str()).exists())
                 throw RuntimeException(QString("Unable to find the directory \"").append(outVolPath.c_str()).append("\"").toStdString().c_str());
 
+            vc->setThreads(threads);
             vc->convertTo(outVolPath, outVolFormat, vc->getVolume()->getBYTESxCHAN()*8, time_series, resolutions, stacksHeight, stacksWidth, stacksDepth, downsamplingMethod);
         }
 
@@ -68,6 +68,7 @@ class teramanager::CConverter : public QThread
         int stacksHeight;           //height of each stack after conversion
         int stacksDepth;            //depth of each stack after conversion (optional)
         int downsamplingMethod;     //downsampling method
+        int threads;                //number of threads used for tile generation
         string outVolPath;          //absolute path of the folder where to store the converted volume
         string outVolFormat;        //the unique ID of the volume's output format
         VolumeConverter *vc;        //handle of the <VolumeConverter> object which is responsible of volume conversion from the given format
@@ -115,6 +116,7 @@ class teramanager::CConverter : public QThread
             outVolFormat = undefined_str;
             inFileMode = false;
             downsamplingMethod = 0;
+            threads = 1;
             time_series = false;
             outFileMode = false;
         }
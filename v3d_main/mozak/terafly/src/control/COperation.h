@@ -207,6 +207,20 @@ namespace teramanager
             TiffAppendData(std::string m, COMPONENT c, int ms) : Operation(m, c, ms, gid){}
             friend class PLog;
     };
+
+    class TiledLoadSubvolume : public Operation
+    {
+        private:
+            TiledLoadSubvolume(){}
+
+        public:
+
+            static int gid;
+            virtual std::string name(){return "OP_TILED_LOAD_SUBVOL";}
+            static int newGroup(){return gid++;}
+            TiledLoadSubvolume(std::string m, COMPONENT c, int ms) : Operation(m, c, ms, gid){}
+            friend class PLog;
+    };
 }
 
 #define TERAFLY_TIME_START(classname)   \
@@ -27,9 +27,11 @@
 ********************************************************************************************************************************************************************************************/
 
 #include <QSettings>
+#include <QThread>
 #include <iostream>
 #include "CSettings.h"
 #include "IM_config.h"
+#include "BlockCache.h"
 
 using namespace teramanager;
 using namespace std;
@@ -72,6 +74,9 @@ void CSettings::loadDefaultSettings()
     annotationVirtualMargin = 20;
     annotationMarkerSize = 20;
     previewMode = true;
+    ioThreads = iim::IO_THREADS;
+    codecThreads = iim::TIFF_CODEC_THREADS;
+    blockCacheSize = iim::BLOCK_CACHE_SIZE_MB;
 
     //TeraConverter settings
     volumeConverterInputPathLRU = "";
@@ -81,6 +86,7 @@ void CSettings::loadDefaultSettings()
     volumeConverterStacksWidthLRU = 256;
     volumeConverterStacksHeightLRU = 256;
     volumeConverterStacksDepthLRU = 256;
+    volumeConverterThreadsLRU = std::max(QThread::idealThreadCount(), 1);
 }
 
 void CSettings::writeSettings()
@@ -116,6 +122,9 @@ void CSettings::writeSettings()
     settings.setValue("annotationVirtualMargin", annotationVirtualMargin);
     settings.setValue("annotationMarkerSize", annotationMarkerSize);
     settings.setValue("previewMode", previewMode);
+    settings.setValue("ioThreads", ioThreads);
+    settings.setValue("codecThreads", codecThreads);
+    settings.setValue("blockCacheSize", blockCacheSize);
 
     settings.setValue("volumeConverterInputPathLRU", QString(volumeConverterInputPathLRU.c_str()));
     settings.setValue("volumeConverterOutputPathLRU", QString(volumeConverterOutputPathLRU.c_str()));
@@ -124,6 +133,7 @@ void CSettings::writeSettings()
     settings.setValue("volumeConverterStacksWidthLRU", volumeConverterStacksWidthLRU);
     settings.setValue("volumeConverterStacksHeightLRU", volumeConverterStacksHeightLRU);
     settings.setValue("volumeConverterStacksDepthLRU", volumeConverterStacksDepthLRU);
+    settings.setValue("volumeConverterThreadsLRU", volumeConverterThreadsLRU);
 
 
     settings.setValue("verbosity", itm::DEBUG);
@@ -170,6 +180,12 @@ void CSettings::readSettings()
         annotationMarkerSize = settings.value("annotationMarkerSize").toInt();
     if(settings.contains("previewMode"))
         previewMode = settings.value("previewMode").toBool();
+    if(settings.contains("ioThreads"))
+        ioThreads = settings.value("ioThreads").toInt();
+    if(settings.contains("codecThreads"))
+        codecThreads = settings.value("codecThreads").toInt();
+    if(settings.contains("blockCacheSize"))
+        blockCacheSize = settings.value("blockCacheSize").toInt();
 
     int size = settings.beginReadArray("volumePathHistory");
     volumePathHistory.clear();
@@ -195,6 +211,8 @@ void CSettings::readSettings()
         volumeConverterStacksHeightLRU = settings.value("volumeConverterStacksHeightLRU").toInt();
     if(settings.contains("volumeConverterStacksDepthLRU"))
         volumeConverterStacksDepthLRU = settings.value("volumeConverterStacksDepthLRU").toInt();
+    if(settings.contains("volumeConverterThreadsLRU"))
+        volumeConverterThreadsLRU = settings.value("volumeConverterThreadsLRU").toInt();
 
 //     if(settings.contains("verbosity"))
 //     {
@@ -204,4 +222,27 @@ void CSettings::readSettings()
 //     else
     iim::DEBUG = iim::NO_DEBUG;
     itm::DEBUG = itm::NO_DEBUG;
+
+    setIOThreads(ioThreads);
+    setCodecThreads(codecThreads);
+    setBlockCacheSize(blockCacheSize);
+}
+
+void CSettings::setIOThreads(int newval)
+{
+    ioThreads = std::max(newval, 1);
+    iim::IO_THREADS = ioThreads;
+}
+
+void CSettings::setCodecThreads(int newval)
+{
+    codecThreads = std::max(newval, 1);
+    iim::TIFF_CODEC_THREADS = codecThreads;
+}
+
+void CSettings::setBlockCacheSize(int newval)
+{
+    blockCacheSize = std::max(newval, 0);
+    iim::BLOCK_CACHE_SIZE_MB = blockCacheSize;
+    iim::BlockCache::instance().shrink();
 }
@@ -67,6 +67,9 @@ class teramanager::CSettings
         int annotationVirtualMargin;
         int annotationMarkerSize;
         bool previewMode;
+        int ioThreads;          //threads reading the files of one subvolume (see iim::IO_THREADS)
+        int codecThreads;       //threads decoding/encoding the pages of one 3D TIFF file (see iim::TIFF_CODEC_THREADS)
+        int blockCacheSize;     //size (in MB) of the cache of decoded TIFF slices, 0 = no cache (see iim::BLOCK_CACHE_SIZE_MB)
 
         //TeraConverter members
         std::string volumeConverterInputPathLRU;
@@ -76,6 +79,7 @@ class teramanager::CSettings
         int volumeConverterStacksWidthLRU;
         int volumeConverterStacksHeightLRU;
         int volumeConverterStacksDepthLRU;
+        int volumeConverterThreadsLRU;
 
     public:
 
@@ -110,6 +114,9 @@ class teramanager::CSettings
         int getAnnotationVirtualMargin(){return annotationVirtualMargin;}
         int getAnnotationMarkerSize(){return annotationMarkerSize;}
         bool getPreviewMode(){return previewMode;}
+        int getIOThreads(){return ioThreads;}
+        int getCodecThreads(){return codecThreads;}
+        int getBlockCacheSize(){return blockCacheSize;}
 
         void setVolumePathLRU(std::string _volumePathLRU)
         {
@@ -145,6 +152,9 @@ class teramanager::CSettings
         void setAnnotationVirtualMargin(int newval){annotationVirtualMargin = newval;}
         void setAnnotationMarkerSize(int newval){annotationMarkerSize = newval;}
         void setPreviewMode(bool newval){previewMode = newval;}
+        void setIOThreads(int newval);
+        void setCodecThreads(int newval);
+        void setBlockCacheSize(int newval);
 
         //GET and SET methods for TeraConverter
         std::string getVCInputPath(){return volumeConverterInputPathLRU;}
@@ -154,6 +164,7 @@ class teramanager::CSettings
         int getVCStacksWidth(){return volumeConverterStacksWidthLRU;}
         int getVCStacksHeight(){return volumeConverterStacksHeightLRU;}
         int getVCStacksDepth(){return volumeConverterStacksDepthLRU;}
+        int getVCThreads(){return volumeConverterThreadsLRU;}
         void setVCInputPath(std::string newval){volumeConverterInputPathLRU = newval;}
         void setVCOutputPath(std::string newval){volumeConverterOutputPathLRU = newval;}
         void setVCInputFormat(std::string newval){volumeConverterInputFormatLRU = newval;}
@@ -161,6 +172,7 @@ class teramanager::CSettings
         void setVCStacksWidth(int newval){volumeConverterStacksWidthLRU = newval;}
         void setVCStacksHeight(int newval){volumeConverterStacksHeightLRU = newval;}
         void setVCStacksDepth(int newval){volumeConverterStacksDepthLRU = newval;}
+        void setVCThreads(int newval){volumeConverterThreadsLRU = newval;}
 
         //save and restore application settings
         void writeSettings();
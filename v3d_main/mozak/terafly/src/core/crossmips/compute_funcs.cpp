@@ -47,6 +47,10 @@
 # include <stdlib.h>
 
 
+# include <complex>
+# include <algorithm>
+# include <limits>
+
 # include "compute_funcs.h"
 
 # define LOG2(V)   (log((double)V)/log(2.0))
@@ -197,6 +201,122 @@ void compute_NCC_alignment ( NCC_parms_t *NCC_params, NCC_descr_t *result, int i
 			result->NCC_widths[i] = NCC_params->INF_W; // peak of infinite width
 		}
 }
+
+
+/* auxiliary functions of compute_NCC_map_FFT 
+ * transforms are computed in double precision with a radix-2 algorithm, hence dimensions must be powers of 2 
+ */
+
+static
+int next_pow2 ( int n ) {
+	int p = 1;
+	while ( p < n )
+		p <<= 1;
+	return p;
+}
+
+/* returns the n/2 twiddle factors exp(-2*pi*i*k/n) used by fft_1D (to be deallocated by the caller)
+ */
+static
+std::complex<double> *fft_twiddles ( int n ) {
+	std::complex<double> *w = new std::complex<double>[MAX(n/2,1)];
+	for ( int k=0; k<n/2; k++ )
+		w[k] = std::polar(1.0,-2.0*3.14159265358979323846*k/n);
+	return w;
+}
+
+/* in-place transform of the sequence (x,n) using the twiddle factors w returned by fft_twiddles(n); 
+ * the inverse transform is not normalized
+ */
+static
+void fft_1D ( std::complex<double> *x, int n, std::complex<double> *w, bool inverse ) {
+	int i, j, k, bit, len, step;
+	std::complex<double> t;
+
+	// bit-reversal permutation
+	for ( i=1, j=0; i<n; i++ ) {
+		for ( bit=n>>1; j & bit; bit>>=1 )
+			j ^= bit;
+		j ^= bit;
+		if ( i < j )
+			std::swap(x[i],x[j]);
+	}
+
+	// butterflies
+	for ( len=2; len<=n; len<<=1 ) {
+		step = n / len;
+		for ( i=0; i<n; i+=len )
+			for ( k=0; k<len/2; k++ ) {
+				t = (inverse ? std::conj(w[k*step]) : w[k*step]) * x[i+k+len/2];
+				x[i+k+len/2] = x[i+k] - t;
+				x[i+k] += t;
+			}
+	}
+}
+
+/* in-place transform of the dimu x dimv matrix x stored row-wise; the inverse transform is not normalized
+ */
+static
+void fft_2D ( std::complex<double> *x, int dimu, int dimv, bool inverse ) {
+	std::complex<double> *wu = fft_twiddles(dimu);
+	std::complex<double> *wv = fft_twiddles(dimv);
+	std::complex<double> *col = new std::complex<double>[dimu];
+	int u, v;
+
+	for ( u=0; u<dimu; u++ )
+		fft_1D(x + (size_t)u*dimv,dimv,wv,inverse);
+
+	for ( v=0; v<dimv; v++ ) {
+		for ( u=0; u<dimu; u++ )
+			col[u] = x[(size_t)u*dimv + v];
+		fft_1D(col,dimu,wu,inverse);
+		for ( u=0; u<dimu; u++ )
+			x[(size_t)u*dimv + v] = col[u];
+	}
+
+	delete[] wu;
+	delete[] wv;
+	delete[] col;
+}
+
+/* returns in S and S2 the (dimu+1) x (dimv+1) summed-area tables of (im - mean) and of its square, where im is 
+ * a dimu x dimv image stored row-wise
+ */
+static
+void summed_area_tables ( iom::real_t *im, double mean, int dimu, int dimv, double *S, double *S2 ) {
+	int u, v, ind;
+	double x;
+
+	for ( v=0; v<=dimv; v++ )
+		S[v] = S2[v] = 0;
+	for ( u=1; u<=dimu; u++ ) {
+		S[u*(dimv+1)] = S2[u*(dimv+1)] = 0;
+		for ( v=1; v<=dimv; v++ ) {
+			ind = u*(dimv+1) + v;
+			x = im[(u-1)*dimv + (v-1)] - mean;
+			S[ind]  = x   + S[ind-(dimv+1)]  + S[ind-1]  - S[ind-(dimv+1)-1];
+			S2[ind] = x*x + S2[ind-(dimv+1)] + S2[ind-1] - S2[ind-(dimv+1)-1];
+		}
+	}
+}
+
+/* NCC from the sums of a window: <factor[12]> are the sums of the squared deviations from the means, <energy[12]> the
+ * sums of the squared values; a flat window (variance at most CM_NCC_VAR_EPS times the energy) has no NCC and gives NaN,
+ * whether its variance is exactly zero (compute_NCC) or only zero up to round off (compute_NCC_map_FFT)
+ */
+static inline
+iom::real_t NCC_ratio ( double numerator, double factor1, double energy1, double factor2, double energy2 ) {
+	if ( factor1 <= CM_NCC_VAR_EPS*energy1 || factor2 <= CM_NCC_VAR_EPS*energy2 )
+		return std::numeric_limits<iom::real_t>::quiet_NaN();
+	return ((float) (numerator / sqrt(factor1*factor2))); // the result is converted to single precision
+}
+
+/* sum over the nu x nv rectangle with upper-left corner (u0,v0) of the image whose summed-area table is S
+ */
+static
+double rect_sum ( double *S, int dimv, int u0, int v0, int nu, int nv ) {
+	return S[(u0+nu)*(dimv+1) + (v0+nv)] - S[u0*(dimv+1) + (v0+nv)] - S[(u0+nu)*(dimv+1) + v0] + S[u0*(dimv+1) + v0];
+}
 /****************************************************************************************/
 
 
@@ -525,6 +645,94 @@ void compute_NCC_map ( iom::real_t *NCC_map, iom::real_t *MIP_1, iom::real_t *MI
 }
 
 
+void compute_NCC_map_FFT ( iom::real_t *NCC_map, iom::real_t *MIP_1, iom::real_t *MIP_2, 
+					       int dimu, int dimv, int delayu, int delayv ) {
+
+	// zero padding to (at least) dimu+delayu x dimv+delayv prevents circular correlation from wrapping around
+	// within the search window
+	int P = next_pow2(dimu + delayu);
+	int Q = next_pow2(dimv + delayv);
+	std::complex<double> *Z = new std::complex<double>[(size_t)P*Q];
+	double *S_f  = new double[(dimu+1)*(dimv+1)];
+	double *S_ff = new double[(dimu+1)*(dimv+1)];
+	double *S_t  = new double[(dimu+1)*(dimv+1)];
+	double *S_tt = new double[(dimu+1)*(dimv+1)];
+	double mean1, mean2, energy1, energy2, s_ft, s_f, s_ff, s_t, s_tt, n, numerator, factor1, factor2;
+	std::complex<double> zk, zm, F1, F2, R;
+	int u, v, ku, kv, nu, nv;
+	size_t k, m;
+
+	// NCC does not depend on the mean of the MIPs: they are removed to improve the accuracy of the transforms
+	mean1 = mean2 = 0;
+	for ( u=0; u<dimu*dimv; u++ ) {
+		mean1 += MIP_1[u];
+		mean2 += MIP_2[u];
+	}
+	mean1 /= (dimu*dimv);
+	mean2 /= (dimu*dimv);
+
+	// both MIPs are transformed at once: MIP_1 is the real part and MIP_2 is the imaginary part of the input
+	for ( k=0; k<(size_t)P*Q; k++ )
+		Z[k] = 0;
+	for ( u=0; u<dimu; u++ )
+		for ( v=0; v<dimv; v++ )
+			Z[(size_t)u*Q + v] = std::complex<double>(MIP_1[u*dimv+v] - mean1, MIP_2[u*dimv+v] - mean2);
+
+	fft_2D(Z,P,Q,false);
+
+	// the transforms of the MIPs are the hermitian and anti-hermitian parts of Z; Z is replaced by the cross-power
+	// spectrum F1 * conj(F2), which is hermitian as well
+	for ( ku=0; ku<P; ku++ )
+		for ( kv=0; kv<Q; kv++ ) {
+			k = (size_t)ku*Q + kv;
+			m = (size_t)((P-ku)%P)*Q + (Q-kv)%Q;
+			if ( m < k )
+				continue;
+			zk = Z[k];
+			zm = std::conj(Z[m]);
+			F1 = (zk + zm) * 0.5;
+			F2 = (zk - zm) * std::complex<double>(0,-0.5);
+			R  = F1 * std::conj(F2);
+			Z[k] = R;
+			Z[m] = std::conj(R);
+		}
+
+	// Z[u,v] = sum of MIP_1[a,b] * MIP_2[a-u,b-v] (negative displacements are wrapped around)
+	fft_2D(Z,P,Q,true);
+
+	summed_area_tables(MIP_1,mean1,dimu,dimv,S_f,S_ff);
+	summed_area_tables(MIP_2,mean2,dimu,dimv,S_t,S_tt);
+	energy1 = S_ff[(dimu+1)*(dimv+1)-1];
+	energy2 = S_tt[(dimu+1)*(dimv+1)-1];
+
+	// same conventions of compute_NCC_map and same formula of compute_NCC, expanded in terms of raw sums
+	for ( u=-delayu; u<=delayu; u++ )
+		for ( v=-delayv; v<=delayv; v++ ) {
+			nu = dimu - abs(u);
+			nv = dimv - abs(v);
+			n  = (double)nu * nv;
+			s_ft = Z[(size_t)((u+P)%P)*Q + (v+Q)%Q].real() / ((double)P*Q);
+			s_f  = rect_sum(S_f, dimv,START_IND(u), START_IND(v), nu,nv);
+			s_ff = rect_sum(S_ff,dimv,START_IND(u), START_IND(v), nu,nv);
+			s_t  = rect_sum(S_t, dimv,START_IND(-u),START_IND(-v),nu,nv);
+			s_tt = rect_sum(S_tt,dimv,START_IND(-u),START_IND(-v),nu,nv);
+			numerator = s_ft - s_f*s_t/n;
+			factor1 = s_ff - s_f*s_f/n; // round off may produce tiny values, even negative ones, for flat windows
+			factor2 = s_tt - s_t*s_t/n;
+			// the energies of the windows before the means of the MIPs were removed, plus the energies of the whole
+			// MIPs: the round off of the summed-area tables grows with them
+			NCC_map[(u+delayu)*(2*delayv+1)+(v+delayv)] = NCC_ratio(numerator,factor1,s_ff + 2*mean1*s_f + n*mean1*mean1 + energy1,
+																	 factor2,s_tt + 2*mean2*s_t + n*mean2*mean2 + energy2);
+		}
+
+	delete[] Z;
+	delete[] S_f;
+	delete[] S_ff;
+	delete[] S_t;
+	delete[] S_tt;
+}
+
+
 iom::real_t compute_NCC ( iom::real_t *im1, iom::real_t *im2, int dimi, int dimj, int stride ) {
 // parallelization of compute_NCC_map makes parallelization of this operation pointless
 	// 2014-10-31 Giulio. @CHANGED       iom::real_t f_mean, t_mean, f_prime, t_prime, numerator, factor1, factor2;
@@ -555,7 +763,7 @@ iom::real_t compute_NCC ( iom::real_t *im1, iom::real_t *im2, int dimi, int dimj
 			factor2 += t_prime * t_prime;
 		}
 
-	return ((float) (numerator / sqrt(factor1*factor2))); // the result is converted to single precision
+	return NCC_ratio(numerator,factor1,factor1 + dimi*dimj*f_mean*f_mean,factor2,factor2 + dimi*dimj*t_mean*t_mean);
 }
 
 
@@ -61,6 +61,13 @@ void compute_3_MIPs ( iom::real_t *A, iom::real_t *B,
 void compute_NCC_map ( iom::real_t *NCC_map, iom::real_t *MIP_1, iom::real_t *MIP_2, 
 					       int dimu, int dimv, int delayu, int delayv );
 
+void compute_NCC_map_FFT ( iom::real_t *NCC_map, iom::real_t *MIP_1, iom::real_t *MIP_2, 
+					       int dimu, int dimv, int delayu, int delayv );
+/* same as compute_NCC_map, but the cross-correlation terms of all displacements are computed at once in the frequency
+ * domain and the local means and energies are obtained from summed-area tables; its cost does not depend on the number
+ * of displacements, hence it is convenient for large search windows
+ */
+
 iom::real_t compute_NCC ( iom::real_t *im1, iom::real_t *im2, int dimi, int dimj, int stride );
 
 int compute_MAX_ind ( iom::real_t *vect, int len );
@@ -85,6 +85,59 @@ static int _counter = 0;
 bool write_3D_stack ( char *fname, iom::real_t *stck, int dimi, int dimj, int dimk );
 
 
+/* enhances the two MIPs (if required) and computes their NCC map, in the frequency domain if the
+ * search window is large enough
+ */
+static void compute_MIPs_NCC_map ( NCC_parms_t *NCC_params, iom::real_t *NCC_map, iom::real_t *MIP_1, iom::real_t *MIP_2,
+								   int dimu, int dimv, int delayu, int delayv ) {
+	if ( NCC_params->enhance ) {
+		enhance(MIP_1,(dimu*dimv),GRAY_LEVELS,NCC_params);
+		enhance(MIP_2,(dimu*dimv),GRAY_LEVELS,NCC_params);
+	}
+
+	if ( NCC_params->fftThr > 0 && (2*delayu+1)*(2*delayv+1) >= NCC_params->fftThr )
+		compute_NCC_map_FFT(NCC_map,MIP_1,MIP_2,dimu,dimv,delayu,delayv);
+	else
+		compute_NCC_map(NCC_map,MIP_1,MIP_2,dimu,dimv,delayu,delayv);
+}
+
+#ifdef _VAA3D_TERAFLY_PLUGIN_MODE
+# include <string>
+# include <exception>
+# include <QRunnable>
+# include <QThreadPool>
+
+// computation of the NCC map of one of the three projections, run by a worker thread
+class NCCMapJob : public QRunnable
+{
+	public:
+
+		NCC_parms_t *NCC_params;
+		iom::real_t *NCC_map, *MIP_1, *MIP_2;
+		int dimu, dimv, delayu, delayv;
+		std::string error;	// non-empty if the computation failed
+
+		NCCMapJob(NCC_parms_t *_NCC_params, iom::real_t *_NCC_map, iom::real_t *_MIP_1, iom::real_t *_MIP_2, int _dimu, int _dimv, int _delayu, int _delayv)
+			: NCC_params(_NCC_params), NCC_map(_NCC_map), MIP_1(_MIP_1), MIP_2(_MIP_2), dimu(_dimu), dimv(_dimv), delayu(_delayu), delayv(_delayv)
+		{
+			setAutoDelete(false);
+		}
+
+		void run()
+		{
+			try
+			{
+				compute_MIPs_NCC_map(NCC_params,NCC_map,MIP_1,MIP_2,dimu,dimv,delayu,delayv);
+			}
+			catch(std::exception &e)
+			{
+				error = e.what();
+			}
+		}
+};
+#endif
+
+
 NCC_descr_t *norm_cross_corr_mips ( iom::real_t *A, iom::real_t *B,
 						    int dimk, int dimi, int dimj, int nk, int ni, int nj,
 							int delayk, int delayi, int delayj, int side, NCC_parms_t *NCC_params ) throw (iom::exception){
@@ -288,41 +341,54 @@ NCC_descr_t *norm_cross_corr_mips ( iom::real_t *A, iom::real_t *B,
 	write_3D_stack(strcpy(_fname+_PREFIX_LEN,"_MIP_yz2.dat")-_PREFIX_LEN,MIP_yz2,dimj_v,dimk_v,1);
 #endif
 
-	// calcola NCC su xy
+	// alloca le 3 mappe NCC
 	NCC_xy = new iom::real_t[(2*delayi+1)*(2*delayj+1)];
 	for ( i=0; i<((2*delayi+1)*(2*delayj+1)); i++ )
 		NCC_xy[i] = 0;
-
-	if ( NCC_params->enhance ) {
-		enhance(MIP_xy1,(dimi_v*dimj_v),GRAY_LEVELS,NCC_params);
-		enhance(MIP_xy2,(dimi_v*dimj_v),GRAY_LEVELS,NCC_params);
-	}
-
-	compute_NCC_map(NCC_xy,MIP_xy1,MIP_xy2,dimi_v,dimj_v,delayi,delayj);
-
-	// calcola NCC su xz
 	NCC_xz = new iom::real_t[(2*delayi+1)*(2*delayk+1)];
 	for ( i=0; i<((2*delayi+1)*(2*delayk+1)); i++ )
 		NCC_xz[i] = 0;
-
-	if ( NCC_params->enhance ) {
-		enhance(MIP_xz1,(dimi_v*dimk_v),GRAY_LEVELS,NCC_params);
-		enhance(MIP_xz2,(dimi_v*dimk_v),GRAY_LEVELS,NCC_params);
-	}
-
-	compute_NCC_map(NCC_xz,MIP_xz1,MIP_xz2,dimi_v,dimk_v,delayi,delayk);
-
-	// calcola NCC su yz
 	NCC_yz = new iom::real_t[(2*delayj+1)*(2*delayk+1)];
 	for ( i=0; i<((2*delayj+1)*(2*delayk+1)); i++ )
 		NCC_yz[i] = 0;
 
-	if ( NCC_params->enhance ) {
-		enhance(MIP_yz1,(dimj_v*dimk_v),GRAY_LEVELS,NCC_params);
-		enhance(MIP_yz2,(dimj_v*dimk_v),GRAY_LEVELS,NCC_params);
+#ifdef _VAA3D_TERAFLY_PLUGIN_MODE
+	if ( NCC_params->n_threads > 1 ) {
+		// calcola NCC su xz e yz in thread separati mentre NCC su xy e' calcolato dal thread corrente
+		// (each projection reads and writes only its own MIPs and NCC map)
+		QThreadPool pool;
+		pool.setMaxThreadCount(MIN(NCC_params->n_threads,3) - 1);
+		NCCMapJob job_xz(NCC_params,NCC_xz,MIP_xz1,MIP_xz2,dimi_v,dimk_v,delayi,delayk);
+		NCCMapJob job_yz(NCC_params,NCC_yz,MIP_yz1,MIP_yz2,dimj_v,dimk_v,delayj,delayk);
+		pool.start(&job_xz);
+		pool.start(&job_yz);
+
+		std::string error;
+		try {
+			compute_MIPs_NCC_map(NCC_params,NCC_xy,MIP_xy1,MIP_xy2,dimi_v,dimj_v,delayi,delayj);
+		}
+		catch(std::exception &e) {
+			error = e.what();
+		}
+		pool.waitForDone();
+
+		if ( error.empty() )
+			error = !job_xz.error.empty() ? job_xz.error : job_yz.error;
+		if ( !error.empty() )
+			throw iom::exception(("CrossMIPs: cannot compute NCC maps: " + error).c_str());
 	}
+	else
+#endif
+	{
+		// calcola NCC su xy
+		compute_MIPs_NCC_map(NCC_params,NCC_xy,MIP_xy1,MIP_xy2,dimi_v,dimj_v,delayi,delayj);
+
+		// calcola NCC su xz
+		compute_MIPs_NCC_map(NCC_params,NCC_xz,MIP_xz1,MIP_xz2,dimi_v,dimk_v,delayi,delayk);
 
-	compute_NCC_map(NCC_yz,MIP_yz1,MIP_yz2,dimj_v,dimk_v,delayj,delayk);
+		// calcola NCC su yz
+		compute_MIPs_NCC_map(NCC_params,NCC_yz,MIP_yz1,MIP_yz2,dimj_v,dimk_v,delayj,delayk);
+	}
 
 #ifdef _WRITE_IMGS
 	if ( NCC_params->enhance ) {
@@ -0,0 +1,292 @@
+//------------------------------------------------------------------------------------------------
+// Copyright (c) 2012  Alessandro Bria and Giulio Iannello (University Campus Bio-Medico of Rome).  
+// All rights reserved.
+//------------------------------------------------------------------------------------------------
+
+/*******************************************************************************************************************************************************************************************
+*    LICENSE NOTICE
+********************************************************************************************************************************************************************************************
+*    By downloading/using/running/editing/changing any portion of codes in this package you agree to this license. If you do not agree to this license, do not download/use/run/edit/change
+*    this code.
+********************************************************************************************************************************************************************************************
+*    1. This material is free for non-profit research, but needs a special license for any commercial purpose. Please contact Alessandro Bria at a.bria@unicas.it or Giulio Iannello at 
+*       g.iannello@unicampus.it for further details.
+*    2. You agree to appropriately cite this work in your related studies and publications.
+*    3. This material is provided by  the copyright holders (Alessandro Bria  and  Giulio Iannello),  University Campus Bio-Medico and contributors "as is" and any express or implied war-
+*       ranties, including, but  not limited to,  any implied warranties  of merchantability,  non-infringement, or fitness for a particular purpose are  disclaimed. In no event shall the
+*       copyright owners, University Campus Bio-Medico, or contributors be liable for any direct, indirect, incidental, special, exemplary, or  consequential  damages  (including, but not 
+*       limited to, procurement of substitute goods or services; loss of use, data, or profits;reasonable royalties; or business interruption) however caused  and on any theory of liabil-
+*       ity, whether in contract, strict liability, or tort  (including negligence or otherwise) arising in any way out of the use of this software,  even if advised of the possibility of
+*       such damage.
+*    4. Neither the name of University  Campus Bio-Medico of Rome, nor Alessandro Bria and Giulio Iannello, may be used to endorse or  promote products  derived from this software without
+*       specific prior written permission.
+********************************************************************************************************************************************************************************************/
+
+
+#include "BlockCache.h"
+#include "Tiff3DMngr.h"
+#include <stdio.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifdef _VAA3D_TERAFLY_PLUGIN_MODE
+#include <QMutexLocker>
+#define BLOCK_CACHE_LOCK QMutexLocker locker(&mutex);
+#else
+#define BLOCK_CACHE_LOCK
+#endif
+
+using namespace iim;
+
+BlockCache BlockCache::cache;
+
+namespace
+{
+	// size and modification time of <filename> (-1 if the file cannot be accessed)
+	void fileStamp(const char *filename, sint64 &size, sint64 &mtime)
+	{
+		struct stat info;
+		if ( stat(filename, &info) == 0 ) {
+			size  = (sint64) info.st_size;
+			mtime = (sint64) info.st_mtime;
+		}
+		else
+			size = mtime = -1;
+	}
+
+	sint64 capacityBytes()
+	{
+		return BLOCK_CACHE_SIZE_MB > 0 ? ((sint64) BLOCK_CACHE_SIZE_MB) * 1024 * 1024 : 0;
+	}
+}
+
+BlockCache::BlockCache()
+{
+	memset(&stats, 0, sizeof(Stats));
+}
+
+BlockCache::~BlockCache()
+{
+	for ( std::list<Block*>::iterator it = lru.begin(); it != lru.end(); it++ )
+		delete *it;
+}
+
+int BlockCache::acquire(const char *filename, unsigned int first, unsigned int last, std::vector<Block*> &blocks)
+{
+	blocks.assign(last - first + 1, (Block*) 0);
+	if ( capacityBytes() == 0 )
+		return 0;
+
+	sint64 file_size, file_mtime;
+	fileStamp(filename, file_size, file_mtime);
+
+	BLOCK_CACHE_LOCK
+	int n_cached = 0;
+	for ( unsigned int i=0; i<blocks.size(); i++ ) {
+		index_t::iterator it = index.find(key_t(filename, first + i));
+		if ( it != index.end() ) {
+			Block *block = *(it->second);
+			if ( block->file_size == file_size && block->file_mtime == file_mtime && file_size >= 0 ) {
+				lru.splice(lru.begin(), lru, it->second);
+				block->pins++;
+				blocks[i] = block;
+				stats.hits++;
+				stats.bytes_hit += block->size;
+				n_cached++;
+				continue;
+			}
+			remove(it); // the file has been modified
+		}
+		stats.misses++;
+	}
+	return n_cached;
+}
+
+void BlockCache::insert(const char *filename, std::vector<Block*> &blocks)
+{
+	sint64 capacity = capacityBytes();
+	sint64 file_size = -1, file_mtime = -1;
+	if ( capacity > 0 )
+		fileStamp(filename, file_size, file_mtime);
+
+	BLOCK_CACHE_LOCK
+	for ( size_t i=0; i<blocks.size(); i++ ) {
+		Block *block = blocks[i];
+		stats.bytes_decoded += block->size;
+		block->file_size = file_size;
+		block->file_mtime = file_mtime;
+		block->pins = 1;
+		block->cached = false;
+		if ( block->size > capacity || file_size < 0 )
+			continue; // not cached: deleted when unpinned
+
+		key_t key(filename, block->slice);
+		index_t::iterator it = index.find(key);
+		if ( it != index.end() ) {
+			Block *cached = *(it->second);
+			if ( cached->file_size == file_size && cached->file_mtime == file_mtime ) {
+				delete block;
+				lru.splice(lru.begin(), lru, it->second);
+				cached->pins++;
+				blocks[i] = cached;
+				continue;
+			}
+			remove(it);
+		}
+
+		block->cached = true;
+		lru.push_front(block);
+		index[key] = lru.begin();
+		stats.bytes_cached += block->size;
+		stats.blocks_cached++;
+	}
+	evict(capacity);
+}
+
+void BlockCache::release(Block *block)
+{
+	BLOCK_CACHE_LOCK
+	block->pins--;
+	if ( block->pins == 0 ) {
+		if ( !block->cached )
+			delete block;
+		else if ( stats.bytes_cached > capacityBytes() )
+			evict(capacityBytes()); // slices may have been pinned when the cache has been filled
+	}
+}
+
+void BlockCache::clear()
+{
+	BLOCK_CACHE_LOCK
+	sint64 evictions = stats.evictions;
+	evict(0);
+	stats.evictions = evictions;
+}
+
+void BlockCache::shrink()
+{
+	BLOCK_CACHE_LOCK
+	evict(capacityBytes());
+}
+
+BlockCache::Stats BlockCache::getStats()
+{
+	BLOCK_CACHE_LOCK
+	return stats;
+}
+
+void BlockCache::resetStats()
+{
+	BLOCK_CACHE_LOCK
+	stats.hits = stats.misses = stats.evictions = 0;
+	stats.bytes_hit = stats.bytes_decoded = 0;
+}
+
+// removes a cached slice (it is deleted when it is no longer pinned)
+void BlockCache::remove(index_t::iterator it)
+{
+	Block *block = *(it->second);
+	lru.erase(it->second);
+	index.erase(it);
+	stats.bytes_cached -= block->size;
+	stats.blocks_cached--;
+	block->cached = false;
+	if ( block->pins == 0 )
+		delete block;
+}
+
+// removes least recently used unpinned slices until the cache size does not exceed <capacity>
+void BlockCache::evict(sint64 capacity)
+{
+	std::list<Block*>::iterator it = lru.end();
+	while ( stats.bytes_cached > capacity && it != lru.begin() ) {
+		it--;
+		Block *block = *it;
+		if ( block->pins > 0 )
+			continue;
+		std::list<Block*>::iterator next = it;
+		next++;
+		remove(index.find(key_t(block->filename, block->slice)));
+		stats.evictions++;
+		it = next;
+	}
+}
+
+char *iim::loadTiff3DBlock ( char *filename, unsigned int first, unsigned int last, BlockCacheRef &slices )
+{
+	std::vector<BlockCache::Block*> &blocks = slices.blocks;
+	for ( size_t i=0; i<blocks.size(); i++ )
+		if ( blocks[i] )
+			BlockCache::instance().release(blocks[i]);
+
+	if ( BlockCache::instance().acquire(filename, first, last, blocks) == (int) blocks.size() )
+		return ((char *) 0);
+
+	char *err_msg;
+	unsigned int sz[4];
+	int datatype;
+	int b_swap;
+	void *fhandle;
+	int header_len;
+
+	if ( (err_msg = loadTiff3D2Metadata(filename,sz[0],sz[1],sz[2],sz[3],datatype,b_swap,fhandle,header_len)) != 0 )
+		return err_msg;
+
+	// missing slices are read in runs of consecutive slices (the directory of a multipage TIFF is sought once per run)
+	sint64 slice_size = ((sint64) sz[0]) * sz[1] * sz[3] * datatype;
+	std::vector<BlockCache::Block*> decoded;
+	unsigned char *buf = 0;
+	try
+	{
+		for ( unsigned int i=0; i<blocks.size(); ) {
+			if ( blocks[i] ) {
+				i++;
+				continue;
+			}
+			unsigned int j = i;
+			while ( j+1 < blocks.size() && !blocks[j+1] )
+				j++;
+
+			buf = new unsigned char[(j - i + 1) * slice_size];
+			if ( (err_msg = readTiff3DFile2Buffer(fhandle,buf,sz[0],sz[1],first+i,first+j,b_swap)) != 0 )
+				break;
+			for ( unsigned int k=i; k<=j; k++ ) {
+				BlockCache::Block *block = new BlockCache::Block();
+				decoded.push_back(block);
+				block->filename = filename;
+				block->slice = first + k;
+				block->width = sz[0];
+				block->height = sz[1];
+				block->chans = sz[3];
+				block->bytes_x_chan = datatype;
+				block->size = slice_size;
+				block->data = new uint8[slice_size];
+				memcpy(block->data, buf + (k - i) * slice_size, slice_size);
+			}
+			delete[] buf;
+			buf = 0;
+			i = j + 1;
+		}
+	}
+	catch(...)
+	{
+		err_msg = (char *) "in loadTiff3DBlock(...): unable to allocate memory";
+	}
+	closeTiff3DFile(fhandle);
+	if ( buf )
+		delete[] buf;
+
+	if ( err_msg ) {
+		for ( size_t k=0; k<decoded.size(); k++ )
+			delete decoded[k];
+		return err_msg;
+	}
+
+	BlockCache::instance().insert(filename, decoded);
+	for ( size_t i=0, k=0; i<blocks.size(); i++ )
+		if ( !blocks[i] )
+			blocks[i] = decoded[k++];
+
+	return ((char *) 0);
+}
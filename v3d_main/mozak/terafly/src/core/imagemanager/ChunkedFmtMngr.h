@@ -0,0 +1,117 @@
+//------------------------------------------------------------------------------------------------
+// Copyright (c) 2012  Alessandro Bria and Giulio Iannello (University Campus Bio-Medico of Rome).  
+// All rights reserved.
+//------------------------------------------------------------------------------------------------
+
+/*******************************************************************************************************************************************************************************************
+*    LICENSE NOTICE
+********************************************************************************************************************************************************************************************
+*    By downloading/using/running/editing/changing any portion of codes in this package you agree to this license. If you do not agree to this license, do not download/use/run/edit/change
+*    this code.
+********************************************************************************************************************************************************************************************
+*    1. This material is free for non-profit research, but needs a special license for any commercial purpose. Please contact Alessandro Bria at a.bria@unicas.it or Giulio Iannello at 
+*       g.iannello@unicampus.it for further details.
+*    2. You agree to appropriately cite this work in your related studies and publications.
+*    3. This material is provided by  the copyright holders (Alessandro Bria  and  Giulio Iannello),  University Campus Bio-Medico and contributors "as is" and any express or implied war-
+*       ranties, including, but  not limited to,  any implied warranties  of merchantability,  non-infringement, or fitness for a particular purpose are  disclaimed. In no event shall the
+*       copyright owners, University Campus Bio-Medico, or contributors be liable for any direct, indirect, incidental, special, exemplary, or  consequential  damages  (including, but not 
+*       limited to, procurement of substitute goods or services; loss of use, data, or profits;reasonable royalties; or business interruption) however caused  and on any theory of liabil-
+*       ity, whether in contract, strict liability, or tort  (including negligence or otherwise) arising in any way out of the use of this software,  even if advised of the possibility of
+*       such damage.
+*    4. Neither the name of University  Campus Bio-Medico of Rome, nor Alessandro Bria and Giulio Iannello, may be used to endorse or  promote products  derived from this software without
+*       specific prior written permission.
+********************************************************************************************************************************************************************************************/
+
+#ifndef CHUNKED_FMT_MNGR_H
+#define CHUNKED_FMT_MNGR_H
+
+#include "IM_config.h"
+#include <string>
+#include <vector>
+
+/* Chunked block store
+ *
+ * A chunked array is a directory containing:
+ *
+ *   .zarray       JSON metadata in the Zarr v2 format (shape, chunk shape, data type, codec)
+ *   .zattrs       JSON attributes: voxel size (in micrometers) and origin (in millimeters)
+ *   c/z/y/x       one file per chunk: the chunk indices are separated by "/", i.e. chunks of the
+ *                 same channel, layer and row share the same directory (arrays using the Zarr default
+ *                 separator "." and 3D arrays with dimensions (D, V, H) can be read as well)
+ *
+ * Arrays are 4D with dimensions ordered as (channel, D, V, H). Chunks always contain one channel and
+ * have a fixed shape: chunks at the borders are padded (with zeros) to the full chunk shape. Missing
+ * chunk files are read as zeros. Voxels are stored in little-endian order, 1 or 2 bytes per channel.
+ *
+ * Each chunk is encoded independently, so that chunks can be written and read in parallel. The
+ * codecs are identified by the ids used by the Zarr numcodecs package:
+ *
+ *   raw           no compression
+ *   zlib          zlib stream (always available)
+ *   zstd          Zstandard frame (available if compiled with IIM_WITH_ZSTD)
+ *   lz4           LZ4 block preceded by its uncompressed size (available if compiled with IIM_WITH_LZ4)
+ *   blosc         Blosc frame (available if compiled with IIM_WITH_BLOSC)
+ *
+ * With 2 bytes per channel, chunks are byte-shuffled before compression (filter "shuffle"; Blosc uses
+ * its own shuffle), which significantly improves the compression ratio of 16-bit images.
+ */
+
+struct chunked_array_t
+{
+	iim::sint64 dims[4];            // array dimensions (C, D, V, H)
+	int chunk_dims[4];              // chunk dimensions (1, D, V, H)
+	int bytes_chan;                 // bytes per channel (1 or 2)
+	std::string codec;              // codec id (see above)
+	int level;                      // compression level (meaning depends on the codec)
+	bool shuffle;                   // byte-shuffle filter
+	float vxl[3];                   // voxel size (D, V, H) in micrometers
+	float org[3];                   // origin (D, V, H) in millimeters
+	char separator;                 // separator of chunk indices in chunk file names ('/' or '.')
+	int ndims;                      // dimensions of the stored array: 4, or 3 if it has no channel axis (D, V, H)
+
+	// returns the number of chunks along dimension i
+	iim::sint64 nChunks(int i) const { return (dims[i] + chunk_dims[i] - 1) / chunk_dims[i]; }
+	// returns the size (in bytes) of one decoded chunk
+	iim::sint64 chunkBytes() const { return ((iim::sint64)chunk_dims[1]) * chunk_dims[2] * chunk_dims[3] * bytes_chan; }
+};
+
+
+bool chunkedCodecAvailable ( const std::string &codec );
+/* returns true if the given codec has been compiled in
+ */
+
+void chunkedWriteMetadata ( const std::string &dir, const chunked_array_t &arr ) throw (iim::IOException);
+/* creates directory dir (if needed) and writes the metadata files of the chunked array arr
+ */
+
+void chunkedReadMetadata ( const std::string &dir, chunked_array_t &arr ) throw (iim::IOException);
+/* reads the metadata files of the chunked array stored in directory dir
+ */
+
+void chunkedWriteGroup ( const std::string &dir, const std::vector<std::string> &arrays, const std::vector<float> &scales ) throw (iim::IOException);
+/* writes the metadata of a group of arrays representing the same volume at different resolutions, so that
+ * tools reading OME-Zarr can recognize the multiresolution pyramid
+ *
+ * dir:        directory containing the arrays
+ * arrays:     names of the subdirectories containing the arrays, from the highest resolution to the lowest
+ * scales:     for each array, voxel size (D, V, H) in micrometers
+ */
+
+void chunkedMakeChunkDirs ( const std::string &dir, int c, iim::sint64 z, iim::sint64 y ) throw (iim::IOException);
+/* creates the directories containing the chunks of row y of layer z of channel c (not thread-safe)
+ */
+
+void chunkedWriteChunk ( const std::string &dir, const chunked_array_t &arr, int c, iim::sint64 z, iim::sint64 y, iim::sint64 x, 
+					const iim::uint8 *data ) throw (iim::IOException);
+/* encodes chunk (c, z, y, x) and writes it (chunk directories must exist, see chunkedMakeChunkDirs)
+ *
+ * data:       decoded chunk, i.e. arr.chunkBytes() bytes ordered as (D, V, H)
+ */
+
+bool chunkedReadChunk ( const std::string &dir, const chunked_array_t &arr, int c, iim::sint64 z, iim::sint64 y, iim::sint64 x, 
+					iim::uint8 *data ) throw (iim::IOException);
+/* reads and decodes chunk (c, z, y, x) into data, which must be at least arr.chunkBytes() bytes;
+ * returns false (and data is filled with zeros) if the chunk file does not exist
+ */
+
+#endif
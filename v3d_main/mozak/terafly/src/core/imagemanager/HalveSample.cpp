@@ -0,0 +1,597 @@
+//------------------------------------------------------------------------------------------------
+// Copyright (c) 2012  Alessandro Bria and Giulio Iannello (University Campus Bio-Medico of Rome).  
+// All rights reserved.
+//------------------------------------------------------------------------------------------------
+
+/*******************************************************************************************************************************************************************************************
+*    LICENSE NOTICE
+********************************************************************************************************************************************************************************************
+*    By downloading/using/running/editing/changing any portion of codes in this package you agree to this license. If you do not agree to this license, do not download/use/run/edit/change
+*    this code.
+********************************************************************************************************************************************************************************************
+*    1. This material is free for non-profit research, but needs a special license for any commercial purpose. Please contact Alessandro Bria at a.bria@unicas.it or Giulio Iannello at 
+*       g.iannello@unicampus.it for further details.
+*    2. You agree to appropriately cite this work in your related studies and publications.
+*    3. This material is provided by  the copyright holders (Alessandro Bria  and  Giulio Iannello),  University Campus Bio-Medico and contributors "as is" and any express or implied war-
+*       ranties, including, but  not limited to,  any implied warranties  of merchantability,  non-infringement, or fitness for a particular purpose are  disclaimed. In no event shall the
+*       copyright owners, University Campus Bio-Medico, or contributors be liable for any direct, indirect, incidental, special, exemplary, or  consequential  damages  (including, but not 
+*       limited to, procurement of substitute goods or services; loss of use, data, or profits;reasonable royalties; or business interruption) however caused  and on any theory of liabil-
+*       ity, whether in contract, strict liability, or tort  (including negligence or otherwise) arising in any way out of the use of this software,  even if advised of the possibility of
+*       such damage.
+*    4. Neither the name of University  Campus Bio-Medico of Rome, nor Alessandro Bria and Giulio Iannello, may be used to endorse or  promote products  derived from this software without
+*       specific prior written permission.
+********************************************************************************************************************************************************************************************/
+
+#include "HalveSample.h"
+#include <algorithm>
+
+// SSE2 is part of the x86-64 baseline, AVX2 kernels are compiled for the AVX2 target only and are selected at runtime
+#if defined(__x86_64__) || defined(_M_X64)
+    #define HALVE_HAS_SSE2
+    #include <emmintrin.h>
+    #if defined(_MSC_VER) && _MSC_VER >= 1700
+        #define HALVE_HAS_AVX2
+        #define HALVE_TARGET_AVX2
+        #include <immintrin.h>
+        #include <intrin.h>
+    #elif defined(__clang__) || (defined(__GNUC__) && __GNUC__ >= 5)
+        #define HALVE_HAS_AVX2
+        #define HALVE_TARGET_AVX2 __attribute__((target("avx2")))
+        #include <immintrin.h>
+    #endif
+#endif
+
+using namespace iim;
+
+namespace
+{
+    /*************************************************************************************************************
+    * Row kernels: compute one row of 'n' output voxels from the input rows it depends on.
+    * - 3D kernels: r0, r1 = rows 2i and 2i+1 of slice 2z; r2, r3 = rows 2i and 2i+1 of slice 2z+1
+    * - 2D kernels: r0, r1 = rows 2i and 2i+1 (r2 and r3 are not used)
+    * 'out' may alias the input rows (in-place halving): vectorized kernels read all the inputs of a group of output
+    * voxels before writing them, and output voxels never overwrite inputs that have not been read yet.
+    **************************************************************************************************************/
+    template <typename T>
+    struct row_kernel
+    {
+        typedef void (*type)(const T* r0, const T* r1, const T* r2, const T* r3, T* out, sint64 n);
+    };
+
+
+    /*--------------------------------------------- SCALAR kernels ---------------------------------------------*/
+    template <typename T>
+    void mean3D_int_scalar(const T* r0, const T* r1, const T* r2, const T* r3, T* out, sint64 n)
+    {
+        // (sum + 4) / 8 == iim::round(sum / 8.0f) for non-negative sums
+        for(sint64 j=0; j<n; j++)
+            out[j] = (T)((r0[2*j] + r0[2*j+1] + r1[2*j] + r1[2*j+1] + r2[2*j] + r2[2*j+1] + r3[2*j] + r3[2*j+1] + 4) >> 3);
+    }
+
+    void mean3D_f32_scalar(const real32* r0, const real32* r1, const real32* r2, const real32* r3, real32* out, sint64 n)
+    {
+        for(sint64 j=0; j<n; j++)
+            out[j] = (r0[2*j] + r0[2*j+1] + r1[2*j] + r1[2*j+1] + r2[2*j] + r2[2*j+1] + r3[2*j] + r3[2*j+1]) / (float)8;
+    }
+
+    template <typename T>
+    void max3D_scalar(const T* r0, const T* r1, const T* r2, const T* r3, T* out, sint64 n)
+    {
+        for(sint64 j=0; j<n; j++)
+        {
+            T A = r0[2*j];
+            if(r0[2*j+1] > A) A = r0[2*j+1];
+            if(r1[2*j]   > A) A = r1[2*j];
+            if(r1[2*j+1] > A) A = r1[2*j+1];
+            if(r2[2*j]   > A) A = r2[2*j];
+            if(r2[2*j+1] > A) A = r2[2*j+1];
+            if(r3[2*j]   > A) A = r3[2*j];
+            if(r3[2*j+1] > A) A = r3[2*j+1];
+            out[j] = A;
+        }
+    }
+
+    void mean2D_f32_scalar(const real32* r0, const real32* r1, const real32*, const real32*, real32* out, sint64 n)
+    {
+        for(sint64 j=0; j<n; j++)
+            out[j] = (r0[2*j] + r0[2*j+1] + r1[2*j] + r1[2*j+1]) / (float)4;
+    }
+
+    void max2D_f32_scalar(const real32* r0, const real32* r1, const real32*, const real32*, real32* out, sint64 n)
+    {
+        for(sint64 j=0; j<n; j++)
+        {
+            real32 A = r0[2*j];
+            if(r0[2*j+1] > A) A = r0[2*j+1];
+            if(r1[2*j]   > A) A = r1[2*j];
+            if(r1[2*j+1] > A) A = r1[2*j+1];
+            out[j] = A;
+        }
+    }
+
+
+    /*---------------------------------------------- SSE2 kernels ----------------------------------------------*/
+    #ifdef HALVE_HAS_SSE2
+    // even / odd elements of 8 consecutive real32
+    inline void deinterleave_sse2(const real32* p, __m128 & even, __m128 & odd)
+    {
+        __m128 a = _mm_loadu_ps(p), b = _mm_loadu_ps(p+4);
+        even = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2,0,2,0));
+        odd  = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3,1,3,1));
+    }
+
+    // sums of adjacent uint8 pairs (as uint16)
+    inline __m128i pairsum_u8_sse2(const uint8* p)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i*)p);
+        return _mm_add_epi16(_mm_and_si128(v, _mm_set1_epi16(0x00FF)), _mm_srli_epi16(v, 8));
+    }
+
+    // sums of adjacent uint16 pairs (as uint32)
+    inline __m128i pairsum_u16_sse2(const uint16* p)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i*)p);
+        return _mm_add_epi32(_mm_and_si128(v, _mm_set1_epi32(0xFFFF)), _mm_srli_epi32(v, 16));
+    }
+
+    // unsigned 16-bit max (SSE2 provides the signed one only)
+    inline __m128i max_epu16_sse2(__m128i a, __m128i b)
+    {
+        return _mm_add_epi16(_mm_subs_epu16(a, b), b);
+    }
+
+    // pack 2 x 4 uint32 in [0, 65535] into 8 uint16 (SSE2 provides signed saturation only)
+    inline __m128i pack_u32_sse2(__m128i lo, __m128i hi)
+    {
+        const __m128i bias32 = _mm_set1_epi32(32768);
+        return _mm_xor_si128(_mm_packs_epi32(_mm_sub_epi32(lo, bias32), _mm_sub_epi32(hi, bias32)), _mm_set1_epi16((short)0x8000));
+    }
+
+    void mean3D_u8_sse2(const uint8* r0, const uint8* r1, const uint8* r2, const uint8* r3, uint8* out, sint64 n)
+    {
+        const uint8* r[4] = {r0, r1, r2, r3};
+        sint64 j = 0;
+        for(; j+16<=n; j+=16)
+        {
+            __m128i lo = _mm_set1_epi16(4), hi = _mm_set1_epi16(4);
+            for(int k=0; k<4; k++)
+            {
+                lo = _mm_add_epi16(lo, pairsum_u8_sse2(r[k]+2*j));
+                hi = _mm_add_epi16(hi, pairsum_u8_sse2(r[k]+2*j+16));
+            }
+            _mm_storeu_si128((__m128i*)(out+j), _mm_packus_epi16(_mm_srli_epi16(lo, 3), _mm_srli_epi16(hi, 3)));
+        }
+        mean3D_int_scalar<uint8>(r0+2*j, r1+2*j, r2+2*j, r3+2*j, out+j, n-j);
+    }
+
+    void max3D_u8_sse2(const uint8* r0, const uint8* r1, const uint8* r2, const uint8* r3, uint8* out, sint64 n)
+    {
+        const uint8* r[4] = {r0, r1, r2, r3};
+        const __m128i mask = _mm_set1_epi16(0x00FF);
+        sint64 j = 0;
+        for(; j+16<=n; j+=16)
+        {
+            __m128i lo = _mm_loadu_si128((const __m128i*)(r0+2*j));
+            __m128i hi = _mm_loadu_si128((const __m128i*)(r0+2*j+16));
+            for(int k=1; k<4; k++)
+            {
+                lo = _mm_max_epu8(lo, _mm_loadu_si128((const __m128i*)(r[k]+2*j)));
+                hi = _mm_max_epu8(hi, _mm_loadu_si128((const __m128i*)(r[k]+2*j+16)));
+            }
+            lo = _mm_and_si128(_mm_max_epu8(lo, _mm_srli_epi16(lo, 8)), mask);
+            hi = _mm_and_si128(_mm_max_epu8(hi, _mm_srli_epi16(hi, 8)), mask);
+            _mm_storeu_si128((__m128i*)(out+j), _mm_packus_epi16(lo, hi));
+        }
+        max3D_scalar<uint8>(r0+2*j, r1+2*j, r2+2*j, r3+2*j, out+j, n-j);
+    }
+
+    void mean3D_u16_sse2(const uint16* r0, const uint16* r1, const uint16* r2, const uint16* r3, uint16* out, sint64 n)
+    {
+        const uint16* r[4] = {r0, r1, r2, r3};
+        sint64 j = 0;
+        for(; j+8<=n; j+=8)
+        {
+            __m128i lo = _mm_set1_epi32(4), hi = _mm_set1_epi32(4);
+            for(int k=0; k<4; k++)
+            {
+                lo = _mm_add_epi32(lo, pairsum_u16_sse2(r[k]+2*j));
+                hi = _mm_add_epi32(hi, pairsum_u16_sse2(r[k]+2*j+8));
+            }
+            _mm_storeu_si128((__m128i*)(out+j), pack_u32_sse2(_mm_srli_epi32(lo, 3), _mm_srli_epi32(hi, 3)));
+        }
+        mean3D_int_scalar<uint16>(r0+2*j, r1+2*j, r2+2*j, r3+2*j, out+j, n-j);
+    }
+
+    void max3D_u16_sse2(const uint16* r0, const uint16* r1, const uint16* r2, const uint16* r3, uint16* out, sint64 n)
+    {
+        const uint16* r[4] = {r0, r1, r2, r3};
+        const __m128i mask = _mm_set1_epi32(0xFFFF);
+        sint64 j = 0;
+        for(; j+8<=n; j+=8)
+        {
+            __m128i lo = _mm_loadu_si128((const __m128i*)(r0+2*j));
+            __m128i hi = _mm_loadu_si128((const __m128i*)(r0+2*j+8));
+            for(int k=1; k<4; k++)
+            {
+                lo = max_epu16_sse2(lo, _mm_loadu_si128((const __m128i*)(r[k]+2*j)));
+                hi = max_epu16_sse2(hi, _mm_loadu_si128((const __m128i*)(r[k]+2*j+8)));
+            }
+            lo = _mm_and_si128(max_epu16_sse2(lo, _mm_srli_epi32(lo, 16)), mask);
+            hi = _mm_and_si128(max_epu16_sse2(hi, _mm_srli_epi32(hi, 16)), mask);
+            _mm_storeu_si128((__m128i*)(out+j), pack_u32_sse2(lo, hi));
+        }
+        max3D_scalar<uint16>(r0+2*j, r1+2*j, r2+2*j, r3+2*j, out+j, n-j);
+    }
+
+    void mean3D_f32_sse2(const real32* r0, const real32* r1, const real32* r2, const real32* r3, real32* out, sint64 n)
+    {
+        const __m128 eighth = _mm_set1_ps(0.125f);     // x * 0.125f == x / 8 (exact scaling)
+        sint64 j = 0;
+        for(; j+4<=n; j+=4)
+        {
+            // same summation order as the scalar kernel
+            __m128 e, o, sum;
+            deinterleave_sse2(r0+2*j, e, o);    sum = _mm_add_ps(e, o);
+            deinterleave_sse2(r1+2*j, e, o);    sum = _mm_add_ps(_mm_add_ps(sum, e), o);
+            deinterleave_sse2(r2+2*j, e, o);    sum = _mm_add_ps(_mm_add_ps(sum, e), o);
+            deinterleave_sse2(r3+2*j, e, o);    sum = _mm_add_ps(_mm_add_ps(sum, e), o);
+            _mm_storeu_ps(out+j, _mm_mul_ps(sum, eighth));
+        }
+        mean3D_f32_scalar(r0+2*j, r1+2*j, r2+2*j, r3+2*j, out+j, n-j);
+    }
+
+    void max3D_f32_sse2(const real32* r0, const real32* r1, const real32* r2, const real32* r3, real32* out, sint64 n)
+    {
+        sint64 j = 0;
+        for(; j+4<=n; j+=4)
+        {
+            // _mm_max_ps(b, a) == (b > a ? b : a), as in the scalar kernel
+            __m128 e, o, m;
+            deinterleave_sse2(r0+2*j, e, o);    m = _mm_max_ps(o, e);
+            deinterleave_sse2(r1+2*j, e, o);    m = _mm_max_ps(o, _mm_max_ps(e, m));
+            deinterleave_sse2(r2+2*j, e, o);    m = _mm_max_ps(o, _mm_max_ps(e, m));
+            deinterleave_sse2(r3+2*j, e, o);    m = _mm_max_ps(o, _mm_max_ps(e, m));
+            _mm_storeu_ps(out+j, m);
+        }
+        max3D_scalar<real32>(r0+2*j, r1+2*j, r2+2*j, r3+2*j, out+j, n-j);
+    }
+
+    void mean2D_f32_sse2(const real32* r0, const real32* r1, const real32* r2, const real32* r3, real32* out, sint64 n)
+    {
+        const __m128 quarter = _mm_set1_ps(0.25f);
+        sint64 j = 0;
+        for(; j+4<=n; j+=4)
+        {
+            __m128 e, o, sum;
+            deinterleave_sse2(r0+2*j, e, o);    sum = _mm_add_ps(e, o);
+            deinterleave_sse2(r1+2*j, e, o);    sum = _mm_add_ps(_mm_add_ps(sum, e), o);
+            _mm_storeu_ps(out+j, _mm_mul_ps(sum, quarter));
+        }
+        mean2D_f32_scalar(r0+2*j, r1+2*j, r2, r3, out+j, n-j);
+    }
+
+    void max2D_f32_sse2(const real32* r0, const real32* r1, const real32* r2, const real32* r3, real32* out, sint64 n)
+    {
+        sint64 j = 0;
+        for(; j+4<=n; j+=4)
+        {
+            __m128 e, o, m;
+            deinterleave_sse2(r0+2*j, e, o);    m = _mm_max_ps(o, e);
+            deinterleave_sse2(r1+2*j, e, o);    m = _mm_max_ps(o, _mm_max_ps(e, m));
+            _mm_storeu_ps(out+j, m);
+        }
+        max2D_f32_scalar(r0+2*j, r1+2*j, r2, r3, out+j, n-j);
+    }
+    #endif
+
+
+    /*---------------------------------------------- AVX2 kernels ----------------------------------------------*/
+    #ifdef HALVE_HAS_AVX2
+    // 256-bit shuffles and packs work within 128-bit lanes: restore the order of the four 64-bit quarters
+    HALVE_TARGET_AVX2 inline __m256i fixorder_avx2(__m256i v)
+    {
+        return _mm256_permute4x64_epi64(v, _MM_SHUFFLE(3,1,2,0));
+    }
+    HALVE_TARGET_AVX2 inline __m256 fixorder_avx2(__m256 v)
+    {
+        return _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(v), _MM_SHUFFLE(3,1,2,0)));
+    }
+
+    // even / odd elements of 16 consecutive real32 (in lane order, see fixorder_avx2)
+    HALVE_TARGET_AVX2 inline void deinterleave_avx2(const real32* p, __m256 & even, __m256 & odd)
+    {
+        __m256 a = _mm256_loadu_ps(p), b = _mm256_loadu_ps(p+8);
+        even = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(2,0,2,0));
+        odd  = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(3,1,3,1));
+    }
+
+    HALVE_TARGET_AVX2 inline __m256i pairsum_u8_avx2(const uint8* p)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i*)p);
+        return _mm256_add_epi16(_mm256_and_si256(v, _mm256_set1_epi16(0x00FF)), _mm256_srli_epi16(v, 8));
+    }
+
+    HALVE_TARGET_AVX2 inline __m256i pairsum_u16_avx2(const uint16* p)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i*)p);
+        return _mm256_add_epi32(_mm256_and_si256(v, _mm256_set1_epi32(0xFFFF)), _mm256_srli_epi32(v, 16));
+    }
+
+    HALVE_TARGET_AVX2 void mean3D_u8_avx2(const uint8* r0, const uint8* r1, const uint8* r2, const uint8* r3, uint8* out, sint64 n)
+    {
+        const uint8* r[4] = {r0, r1, r2, r3};
+        sint64 j = 0;
+        for(; j+32<=n; j+=32)
+        {
+            __m256i lo = _mm256_set1_epi16(4), hi = _mm256_set1_epi16(4);
+            for(int k=0; k<4; k++)
+            {
+                lo = _mm256_add_epi16(lo, pairsum_u8_avx2(r[k]+2*j));
+                hi = _mm256_add_epi16(hi, pairsum_u8_avx2(r[k]+2*j+32));
+            }
+            _mm256_storeu_si256((__m256i*)(out+j), fixorder_avx2(_mm256_packus_epi16(_mm256_srli_epi16(lo, 3), _mm256_srli_epi16(hi, 3))));
+        }
+        mean3D_u8_sse2(r0+2*j, r1+2*j, r2+2*j, r3+2*j, out+j, n-j);
+    }
+
+    HALVE_TARGET_AVX2 void max3D_u8_avx2(const uint8* r0, const uint8* r1, const uint8* r2, const uint8* r3, uint8* out, sint64 n)
+    {
+        const uint8* r[4] = {r0, r1, r2, r3};
+        const __m256i mask = _mm256_set1_epi16(0x00FF);
+        sint64 j = 0;
+        for(; j+32<=n; j+=32)
+        {
+            __m256i lo = _mm256_loadu_si256((const __m256i*)(r0+2*j));
+            __m256i hi = _mm256_loadu_si256((const __m256i*)(r0+2*j+32));
+            for(int k=1; k<4; k++)
+            {
+                lo = _mm256_max_epu8(lo, _mm256_loadu_si256((const __m256i*)(r[k]+2*j)));
+                hi = _mm256_max_epu8(hi, _mm256_loadu_si256((const __m256i*)(r[k]+2*j+32)));
+            }
+            lo = _mm256_and_si256(_mm256_max_epu8(lo, _mm256_srli_epi16(lo, 8)), mask);
+            hi = _mm256_and_si256(_mm256_max_epu8(hi, _mm256_srli_epi16(hi, 8)), mask);
+            _mm256_storeu_si256((__m256i*)(out+j), fixorder_avx2(_mm256_packus_epi16(lo, hi)));
+        }
+        max3D_u8_sse2(r0+2*j, r1+2*j, r2+2*j, r3+2*j, out+j, n-j);
+    }
+
+    HALVE_TARGET_AVX2 void mean3D_u16_avx2(const uint16* r0, const uint16* r1, const uint16* r2, const uint16* r3, uint16* out, sint64 n)
+    {
+        const uint16* r[4] = {r0, r1, r2, r3};
+        sint64 j = 0;
+        for(; j+16<=n; j+=16)
+        {
+            __m256i lo = _mm256_set1_epi32(4), hi = _mm256_set1_epi32(4);
+            for(int k=0; k<4; k++)
+            {
+                lo = _mm256_add_epi32(lo, pairsum_u16_avx2(r[k]+2*j));
+                hi = _mm256_add_epi32(hi, pairsum_u16_avx2(r[k]+2*j+16));
+            }
+            _mm256_storeu_si256((__m256i*)(out+j), fixorder_avx2(_mm256_packus_epi32(_mm256_srli_epi32(lo, 3), _mm256_srli_epi32(hi, 3))));
+        }
+        mean3D_u16_sse2(r0+2*j, r1+2*j, r2+2*j, r3+2*j, out+j, n-j);
+    }
+
+    HALVE_TARGET_AVX2 void max3D_u16_avx2(const uint16* r0, const uint16* r1, const uint16* r2, const uint16* r3, uint16* out, sint64 n)
+    {
+        const uint16* r[4] = {r0, r1, r2, r3};
+        const __m256i mask = _mm256_set1_epi32(0xFFFF);
+        sint64 j = 0;
+        for(; j+16<=n; j+=16)
+        {
+            __m256i lo = _mm256_loadu_si256((const __m256i*)(r0+2*j));
+            __m256i hi = _mm256_loadu_si256((const __m256i*)(r0+2*j+16));
+            for(int k=1; k<4; k++)
+            {
+                lo = _mm256_max_epu16(lo, _mm256_loadu_si256((const __m256i*)(r[k]+2*j)));
+                hi = _mm256_max_epu16(hi, _mm256_loadu_si256((const __m256i*)(r[k]+2*j+16)));
+            }
+            lo = _mm256_and_si256(_mm256_max_epu16(lo, _mm256_srli_epi32(lo, 16)), mask);
+            hi = _mm256_and_si256(_mm256_max_epu16(hi, _mm256_srli_epi32(hi, 16)), mask);
+            _mm256_storeu_si256((__m256i*)(out+j), fixorder_avx2(_mm256_packus_epi32(lo, hi)));
+        }
+        max3D_u16_sse2(r0+2*j, r1+2*j, r2+2*j, r3+2*j, out+j, n-j);
+    }
+
+    HALVE_TARGET_AVX2 void mean3D_f32_avx2(const real32* r0, const real32* r1, const real32* r2, const real32* r3, real32* out, sint64 n)
+    {
+        const __m256 eighth = _mm256_set1_ps(0.125f);
+        sint64 j = 0;
+        for(; j+8<=n; j+=8)
+        {
+            __m256 e, o, sum;
+            deinterleave_avx2(r0+2*j, e, o);    sum = _mm256_add_ps(e, o);
+            deinterleave_avx2(r1+2*j, e, o);    sum = _mm256_add_ps(_mm256_add_ps(sum, e), o);
+            deinterleave_avx2(r2+2*j, e, o);    sum = _mm256_add_ps(_mm256_add_ps(sum, e), o);
+            deinterleave_avx2(r3+2*j, e, o);    sum = _mm256_add_ps(_mm256_add_ps(sum, e), o);
+            _mm256_storeu_ps(out+j, fixorder_avx2(_mm256_mul_ps(sum, eighth)));
+        }
+        mean3D_f32_sse2(r0+2*j, r1+2*j, r2+2*j, r3+2*j, out+j, n-j);
+    }
+
+    HALVE_TARGET_AVX2 void max3D_f32_avx2(const real32* r0, const real32* r1, const real32* r2, const real32* r3, real32* out, sint64 n)
+    {
+        sint64 j = 0;
+        for(; j+8<=n; j+=8)
+        {
+            __m256 e, o, m;
+            deinterleave_avx2(r0+2*j, e, o);    m = _mm256_max_ps(o, e);
+            deinterleave_avx2(r1+2*j, e, o);    m = _mm256_max_ps(o, _mm256_max_ps(e, m));
+            deinterleave_avx2(r2+2*j, e, o);    m = _mm256_max_ps(o, _mm256_max_ps(e, m));
+            deinterleave_avx2(r3+2*j, e, o);    m = _mm256_max_ps(o, _mm256_max_ps(e, m));
+            _mm256_storeu_ps(out+j, fixorder_avx2(m));
+        }
+        max3D_f32_sse2(r0+2*j, r1+2*j, r2+2*j, r3+2*j, out+j, n-j);
+    }
+
+    HALVE_TARGET_AVX2 void mean2D_f32_avx2(const real32* r0, const real32* r1, const real32* r2, const real32* r3, real32* out, sint64 n)
+    {
+        const __m256 quarter = _mm256_set1_ps(0.25f);
+        sint64 j = 0;
+        for(; j+8<=n; j+=8)
+        {
+            __m256 e, o, sum;
+            deinterleave_avx2(r0+2*j, e, o);    sum = _mm256_add_ps(e, o);
+            deinterleave_avx2(r1+2*j, e, o);    sum = _mm256_add_ps(_mm256_add_ps(sum, e), o);
+            _mm256_storeu_ps(out+j, fixorder_avx2(_mm256_mul_ps(sum, quarter)));
+        }
+        mean2D_f32_sse2(r0+2*j, r1+2*j, r2, r3, out+j, n-j);
+    }
+
+    HALVE_TARGET_AVX2 void max2D_f32_avx2(const real32* r0, const real32* r1, const real32* r2, const real32* r3, real32* out, sint64 n)
+    {
+        sint64 j = 0;
+        for(; j+8<=n; j+=8)
+        {
+            __m256 e, o, m;
+            deinterleave_avx2(r0+2*j, e, o);    m = _mm256_max_ps(o, e);
+            deinterleave_avx2(r1+2*j, e, o);    m = _mm256_max_ps(o, _mm256_max_ps(e, m));
+            _mm256_storeu_ps(out+j, fixorder_avx2(m));
+        }
+        max2D_f32_sse2(r0+2*j, r1+2*j, r2, r3, out+j, n-j);
+    }
+    #endif
+
+
+    /*------------------------------------------------ drivers -------------------------------------------------*/
+    // indices are sint64 because offsets can be larger that 2^31 - 1
+    template <typename T>
+    void halve3D(T* img, sint64 height, sint64 width, sint64 depth, typename row_kernel<T>::type kernel)
+    {
+        sint64 slice = width*height;
+        for(sint64 z=0; z<depth/2; z++)
+            for(sint64 i=0; i<height/2; i++)
+            {
+                const T* r0 = img + 2*z*slice + 2*i*width;
+                kernel(r0, r0 + width, r0 + slice, r0 + slice + width, img + z*(width/2)*(height/2) + i*(width/2), width/2);
+            }
+    }
+
+    template <typename T>
+    void halve2D(T* img, sint64 height, sint64 width, sint64 depth, typename row_kernel<T>::type kernel)
+    {
+        sint64 slice = width*height;
+        for(sint64 z=0; z<depth; z++)
+            for(sint64 i=0; i<height/2; i++)
+            {
+                const T* r0 = img + z*slice + 2*i*width;
+                kernel(r0, r0 + width, 0, 0, img + z*(width/2)*(height/2) + i*(width/2), width/2);
+            }
+    }
+
+    // runtime CPU detection
+    halve_isa detectISA()
+    {
+        #ifdef HALVE_HAS_AVX2
+        #ifdef _MSC_VER
+        int info[4];
+        __cpuid(info, 0);
+        if(info[0] >= 7)
+        {
+            // AVX2 requires the OS to save YMM registers (OSXSAVE + XCR0 bits 1 and 2)
+            __cpuid(info, 1);
+            if((info[2] & (1<<27)) && (info[2] & (1<<28)) && (_xgetbv(0) & 6) == 6)
+            {
+                __cpuidex(info, 7, 0);
+                if(info[1] & (1<<5))
+                    return HALVE_ISA_AVX2;
+            }
+        }
+        #else
+        __builtin_cpu_init();
+        if(__builtin_cpu_supports("avx2"))
+            return HALVE_ISA_AVX2;
+        #endif
+        #endif
+
+        #ifdef HALVE_HAS_SSE2
+        return HALVE_ISA_SSE2;
+        #else
+        return HALVE_ISA_SCALAR;
+        #endif
+    }
+
+    int forcedISA = -1;    // instruction set forced by setHalveISA (-1 = none)
+}
+
+halve_isa iim::halveISAdetected()
+{
+    static halve_isa detected = detectISA();
+    return detected;
+}
+
+halve_isa iim::halveISA()
+{
+    return forcedISA == -1 ? halveISAdetected() : halve_isa(forcedISA);
+}
+
+void iim::setHalveISA(halve_isa isa)
+{
+    forcedISA = std::min(isa, halveISAdetected());
+}
+
+const char* iim::halveISAname(halve_isa isa)
+{
+    switch(isa)
+    {
+        case HALVE_ISA_SSE2: return "SSE2";
+        case HALVE_ISA_AVX2: return "AVX2";
+        default:             return "scalar";
+    }
+}
+
+void iim::halveSample3D(uint8* img, sint64 height, sint64 width, sint64 depth, bool by_max)
+{
+    row_kernel<uint8>::type kernel = by_max ? &max3D_scalar<uint8> : &mean3D_int_scalar<uint8>;
+    #ifdef HALVE_HAS_SSE2
+    if(halveISA() >= HALVE_ISA_SSE2)
+        kernel = by_max ? &max3D_u8_sse2 : &mean3D_u8_sse2;
+    #endif
+    #ifdef HALVE_HAS_AVX2
+    if(halveISA() >= HALVE_ISA_AVX2)
+        kernel = by_max ? &max3D_u8_avx2 : &mean3D_u8_avx2;
+    #endif
+    halve3D(img, height, width, depth, kernel);
+}
+
+void iim::halveSample3D(uint16* img, sint64 height, sint64 width, sint64 depth, bool by_max)
+{
+    row_kernel<uint16>::type kernel = by_max ? &max3D_scalar<uint16> : &mean3D_int_scalar<uint16>;
+    #ifdef HALVE_HAS_SSE2
+    if(halveISA() >= HALVE_ISA_SSE2)
+        kernel = by_max ? &max3D_u16_sse2 : &mean3D_u16_sse2;
+    #endif
+    #ifdef HALVE_HAS_AVX2
+    if(halveISA() >= HALVE_ISA_AVX2)
+        kernel = by_max ? &max3D_u16_avx2 : &mean3D_u16_avx2;
+    #endif
+    halve3D(img, height, width, depth, kernel);
+}
+
+void iim::halveSample3D(real32* img, sint64 height, sint64 width, sint64 depth, bool by_max)
+{
+    row_kernel<real32>::type kernel = by_max ? &max3D_scalar<real32> : &mean3D_f32_scalar;
+    #ifdef HALVE_HAS_SSE2
+    if(halveISA() >= HALVE_ISA_SSE2)
+        kernel = by_max ? &max3D_f32_sse2 : &mean3D_f32_sse2;
+    #endif
+    #ifdef HALVE_HAS_AVX2
+    if(halveISA() >= HALVE_ISA_AVX2)
+        kernel = by_max ? &max3D_f32_avx2 : &mean3D_f32_avx2;
+    #endif
+    halve3D(img, height, width, depth, kernel);
+}
+
+void iim::halveSample2D(real32* img, sint64 height, sint64 width, sint64 depth, bool by_max)
+{
+    row_kernel<real32>::type kernel = by_max ? &max2D_f32_scalar : &mean2D_f32_scalar;
+    #ifdef HALVE_HAS_SSE2
+    if(halveISA() >= HALVE_ISA_SSE2)
+        kernel = by_max ? &max2D_f32_sse2 : &mean2D_f32_sse2;
+    #endif
+    #ifdef HALVE_HAS_AVX2
+    if(halveISA() >= HALVE_ISA_AVX2)
+        kernel = by_max ? &max2D_f32_avx2 : &mean2D_f32_avx2;
+    #endif
+    halve2D(img, height, width, depth, kernel);
+}
@@ -37,6 +37,9 @@ namespace IconImageManager
     std::string DEBUG_FILE_PATH = "/home/alex/Scrivania/iim_debug.log";   //filepath where to save debug information
     bool ADD_NOISE_TO_TIME_SERIES = false;	// whether to mark individual frames of a time series with increasing gaussian noise
     int CHANNEL_SELECTION = ALL;			// channel to be loaded (default is ALL)
+    int IO_THREADS = 4;                     // maximum number of files read concurrently when loading a subvolume
+    int BLOCK_CACHE_SIZE_MB = 512;          // size (in MB) of the cache of decoded TIFF slices shared by all volumes
+    int TIFF_CODEC_THREADS = 4;             // maximum number of threads decoding/encoding the compressed pages of a 3D TIFF file
     /*-------------------------------------------------------------------------------------------------------------------------*/
 }
 
@@ -128,6 +128,7 @@ namespace IconImageManager
     const std::string TILED_MC_TIF3D_FORMAT = "TIFF (tiled, 4D)";           // unique ID for multipage TIFF format (nontiled, 4D)
     const std::string UNST_TIF3D_FORMAT     = "TIFF (unstitched, 3D)";      // unique ID for multipage TIFF format (nontiled, 4D)
     const std::string BDV_HDF5_FORMAT       = "HDF5 (BigDataViewer)";       // unique ID for BDV HDF5
+    const std::string CHUNKED_FORMAT        = "Zarr (chunked, 4D)";         // unique ID for the ChunkedVolume class
     const std::string TIME_SERIES           = "Time series";               // unique ID for the TimeSeries class
 
     const double      PI = 3.14159265;                          // pi
@@ -146,6 +147,9 @@ namespace IconImageManager
     extern std::string DEBUG_FILE_PATH;                         // filepath where to save debug information
     extern bool ADD_NOISE_TO_TIME_SERIES;                       // whether to mark individual frames of a time series with increasing gaussian noise
     extern int CHANNEL_SELECTION;								// channel to be used when image must be converted to an intensity image (default is ALL)
+    extern int IO_THREADS;                                      // maximum number of files read concurrently when loading a subvolume (1 = sequential reads)
+    extern int BLOCK_CACHE_SIZE_MB;                             // size (in MB) of the cache of decoded TIFF slices shared by all volumes (0 = no cache, see BlockCache.h)
+    extern int TIFF_CODEC_THREADS;                              // maximum number of threads decoding/encoding the compressed pages of a 3D TIFF file (1 = sequential)
    /*-------------------------------------------------------------------------------------------------------------------------*/
 
 
@@ -41,6 +41,7 @@
 #include "Stack.h"
 #include "RawFmtMngr.h"
 #include "Tiff3DMngr.h"
+#include "BlockCache.h"
 
 #ifdef _WIN32
 #include "dirent_win.h"
@@ -1049,23 +1050,15 @@ uint8* StackedVolume::loadSubvolume_to_UINT8(int V0,int V1, int H0, int H1, int
 
 					char *err_Tiff3Dfmt;
 
-					unsigned int rows;
-					unsigned int cols;
-					unsigned int n_slices;
-					unsigned int chans;
-					int bytes_x_chan;
-					int swap;
-					void *dummy;
-					int dummy_len;
-
-					if ( (err_Tiff3Dfmt = loadTiff3D2Metadata((char *)slice_fullpath,cols,rows,n_slices,chans,bytes_x_chan,swap,dummy,dummy_len)) != 0 ) {
-						throw iom::exception(iom::strprintf("unable to read tiff file (%s)",err_Tiff3Dfmt), __iom__current__function__);
-					}
-					closeTiff3DFile(dummy);
-					uint8 *slice = new uint8[rows * cols * chans * bytes_x_chan];
-					if ( (err_Tiff3Dfmt = readTiff3DFile2Buffer((char *)slice_fullpath,slice,cols,rows,0,0)) != 0 ) {
+					// decoded slices are shared with the other volumes through the block cache
+					BlockCacheRef cached_slice;
+					if ( (err_Tiff3Dfmt = loadTiff3DBlock((char *)slice_fullpath,0,0,cached_slice)) != 0 ) {
 						throw iom::exception(iom::strprintf("unable to read tiff file (%s)",err_Tiff3Dfmt), __iom__current__function__);
 					}
+					unsigned int cols = cached_slice.blocks[0]->width;
+					unsigned int chans = cached_slice.blocks[0]->chans;
+					int bytes_x_chan = cached_slice.blocks[0]->bytes_x_chan;
+					uint8 *slice = cached_slice.blocks[0]->data;
 
 					//if(!slice)
                     //    throw IOException(std::string("Unable to load slice at \"").append(slice_fullpath).append("\"").c_str());
@@ -1144,7 +1137,6 @@ uint8* StackedVolume::loadSubvolume_to_UINT8(int V0,int V1, int H0, int H1, int
                     else
                         throw IOException(std::string("Unsupported number of channels at \"").append(slice_fullpath).append("\". Only 1 and 3-channels images are supported").c_str());
 
-                    delete []slice; // Giulio_CV cvReleaseImage(&slice);
                 }
             }
         }
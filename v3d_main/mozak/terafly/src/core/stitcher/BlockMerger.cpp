@@ -0,0 +1,211 @@
+//------------------------------------------------------------------------------------------------
+// Copyright (c) 2012  Alessandro Bria and Giulio Iannello (University Campus Bio-Medico of Rome).  
+// All rights reserved.
+//------------------------------------------------------------------------------------------------
+
+/*******************************************************************************************************************************************************************************************
+*    LICENSE NOTICE
+********************************************************************************************************************************************************************************************
+*    By downloading/using/running/editing/changing any portion of codes in this package you agree to this license. If you do not agree to this license, do not download/use/run/edit/change
+*    this code.
+********************************************************************************************************************************************************************************************
+*    1. This material is free for non-profit research, but needs a special license for any commercial purpose. Please contact Alessandro Bria at a.bria@unicas.it or Giulio Iannello at 
+*       g.iannello@unicampus.it for further details.
+*    2. You agree to appropriately cite this work in your related studies and publications.
+*
+*       Bria, A., Iannello, G., "TeraStitcher - A Tool for Fast 3D Automatic Stitching of Teravoxel-sized Microscopy Images", (2012) BMC Bioinformatics, 13 (1), art. no. 316.
+*
+*    3. This material is provided by  the copyright holders (Alessandro Bria  and  Giulio Iannello),  University Campus Bio-Medico and contributors "as is" and any express or implied war-
+*       ranties, including, but  not limited to,  any implied warranties  of merchantability,  non-infringement, or fitness for a particular purpose are  disclaimed. In no event shall the
+*       copyright owners, University Campus Bio-Medico, or contributors be liable for any direct, indirect, incidental, special, exemplary, or  consequential  damages  (including, but not 
+*       limited to, procurement of substitute goods or services; loss of use, data, or profits;reasonable royalties; or business interruption) however caused  and on any theory of liabil-
+*       ity, whether in contract, strict liability, or tort  (including negligence or otherwise) arising in any way out of the use of this software,  even if advised of the possibility of
+*       such damage.
+*    4. Neither the name of University  Campus Bio-Medico of Rome, nor Alessandro Bria and Giulio Iannello, may be used to endorse or  promote products  derived from this software without
+*       specific prior written permission.
+********************************************************************************************************************************************************************************************/
+
+#include <list>
+#include <string>
+#include <algorithm>
+#include "BlockMerger.h"
+#include "StackStitcher.h"
+#include "../iomanager/ProgressBar.h"
+#ifdef _VAA3D_TERAFLY_PLUGIN_MODE
+#include <QRunnable>
+#include <QThreadPool>
+#endif
+
+using namespace iomanager;
+
+struct coord_2D{int V,H;};
+struct stripe_2Dcoords{coord_2D up_left, bottom_right;};
+struct stripe_corner{int h,H; bool up;};
+struct stripe_2Dcorners{std::list<stripe_corner> ups, bottoms, merged;};
+
+#ifdef _VAA3D_TERAFLY_PLUGIN_MODE
+// worker thread merging the next block of a BlockMerger; since exceptions cannot cross thread boundaries, errors
+// are stored and rethrown by BlockMerger::merge
+class MergeWorker : public QRunnable
+{
+	public:
+
+		BlockMerger *merger;
+		std::string error;		// empty if the last merge succeeded
+		QThreadPool pool;
+
+		MergeWorker(BlockMerger *_merger) : merger(_merger)
+		{
+			setAutoDelete(false);
+			pool.setMaxThreadCount(1);
+		}
+
+		void start(){ error.clear(); pool.start(this); }
+		void wait() { pool.waitForDone(); }
+
+		void run()
+		{
+			try							{ merger->mergeNext(); }
+			catch(iom::exception & ex)	{ error = ex.what(); }
+			catch(std::exception & ex)	{ error = ex.what(); }
+			catch(...)					{ error = "unknown error"; }
+		}
+};
+#endif
+
+BlockMerger::BlockMerger(StackStitcher *_stitcher, int z_max_res, const std::vector< std::vector<int> > &tile_rows_height,
+						 stripe_2Dcoords *_stripesCoords, stripe_2Dcorners *_stripesCorners,
+						 int _restore_direction, StackRestorer *_stk_rst, int _blending_algo)
+	: stitcher(_stitcher), stripesCoords(_stripesCoords), stripesCorners(_stripesCorners), restore_direction(_restore_direction),
+	  stk_rst(_stk_rst), blending_algo(_blending_algo), d_size(1), next_buffer(0), next_z(-1), next_z_size(0), next_band(0), worker(0), buffer(0)
+{
+	int height = stitcher->V1-stitcher->V0;
+	sint64 width = stitcher->H1-stitcher->H0;
+
+	// rows where bands can be cut: a cut must split no tile row at any resolution, and must be halved exactly at each one
+	int n_res = (int)tile_rows_height.size();
+	std::vector< std::vector<int> > tile_rows_start(n_res);
+	for(int i=0; i<n_res; i++)
+		for(int row=0, start=0; row<(int)tile_rows_height[i].size(); start += tile_rows_height[i][row], row++)
+			tile_rows_start[i].push_back(start);
+	std::vector<int> cuts(1, 0);
+	if(n_res > 0)
+		for(size_t k=1; k<tile_rows_start[n_res-1].size(); k++)
+		{
+			int cut = tile_rows_start[n_res-1][k] << (n_res-1);
+			bool valid = cut < height;
+			for(int i=0; i<n_res-1 && valid; i++)
+				valid = std::binary_search(tile_rows_start[i].begin(), tile_rows_start[i].end(), cut >> i);
+			if(valid)
+				cuts.push_back(cut);
+		}
+	cuts.push_back(height);
+
+	// memory needed to merge one slice: the up and down stripes plus the two adjacent tile slices loaded by 'getStripe()'
+	sint64 stripe_size = 0;
+	for(int row_index=stitcher->ROW_START; row_index<=stitcher->ROW_END; row_index++)
+		stripe_size = std::max(stripe_size, (sint64)(stripesCoords[row_index].bottom_right.V - stripesCoords[row_index].up_left.V) *
+											(stripesCoords[row_index].bottom_right.H - stripesCoords[row_index].up_left.H));
+	sint64 slice_bytes = (2*stripe_size + 2*(sint64)stitcher->volume->getStacksHeight()*stitcher->volume->getStacksWidth()) * sizeof(iom::real_t);
+	sint64 budget = (sint64)(S_MERGE_RAM_LIMIT_DEF * 1024 * 1024 * 1024);
+
+	// bands as high as the budget allows (each band spans at least two consecutive cuts)
+	sint64 row_bytes = width * z_max_res * sizeof(iom::real_t);
+	sint64 max_rows = std::max<sint64>(1, (budget - slice_bytes) / row_bytes);
+	int max_band_height = 0;
+	bands.push_back(0);
+	for(size_t c=0; c+1<cuts.size(); )
+	{
+		size_t next = c+1;
+		while(next+1 < cuts.size() && cuts[next+1] - cuts[c] <= max_rows)
+			next++;
+		bands.push_back(cuts[next]);
+		max_band_height = std::max(max_band_height, cuts[next] - cuts[c]);
+		c = next;
+	}
+
+	sint64 buffer_size = (sint64)max_band_height * width * z_max_res;
+	sint64 buffer_bytes = buffer_size * sizeof(iom::real_t);
+	sint64 available = budget - buffer_bytes;
+
+	buffer = new iom::real_t[buffer_size];
+
+	#ifdef _VAA3D_TERAFLY_PLUGIN_MODE
+	if(available - buffer_bytes >= slice_bytes)
+	{
+		next_buffer = new iom::real_t[buffer_size];
+		worker = new MergeWorker(this);
+		available -= buffer_bytes;
+	}
+	#endif
+
+	d_size = (int) std::max<sint64>(1, std::min<sint64>(z_max_res, available / slice_bytes));
+}
+
+BlockMerger::~BlockMerger()
+{
+	#ifdef _VAA3D_TERAFLY_PLUGIN_MODE
+	if(worker)
+	{
+		worker->wait();
+		delete worker;
+	}
+	#endif
+	delete[] buffer;
+	if(next_buffer)
+		delete[] next_buffer;
+}
+
+void BlockMerger::mergeNext() throw (iom::exception)
+{
+	stitcher->mergeBlock(next_buffer, next_z, next_z_size, getBandV0(next_band), getBandHeight(next_band), d_size,
+						 stripesCoords, stripesCorners, restore_direction, stk_rst, blending_algo, false);
+}
+
+void BlockMerger::merge(iom::sint64 z, int z_size, int band, iom::sint64 _next_z, int _next_z_size, int _next_band,
+						bool show_progress_bar) throw (iom::exception)
+{
+	// the progress of merging is shown while merging the last band
+	show_progress_bar = show_progress_bar && band == getBands()-1;
+
+	#ifdef _VAA3D_TERAFLY_PLUGIN_MODE
+	if(worker)
+	{
+		worker->wait();
+		if(!worker->error.empty())
+		{
+			next_z = -1;
+			throw iom::exception(worker->error.c_str());
+		}
+	}
+	#endif
+
+	if(next_buffer && next_z == z && next_z_size == z_size && next_band == band)
+	{
+		// the band has already been merged in background
+		std::swap(buffer, next_buffer);
+		if(show_progress_bar)
+		{
+			char progressBarMsg[200];
+			sprintf(progressBarMsg, "Merging slice %d of %d", (uint32)(z-stitcher->D0+z_size), (uint32)(stitcher->D1-stitcher->D0));
+			ProgressBar::instance()->update(((float)(z-stitcher->D0+z_size)*100/(float)(stitcher->D1-stitcher->D0)), progressBarMsg);
+			ProgressBar::instance()->show();
+		}
+	}
+	else
+		stitcher->mergeBlock(buffer, z, z_size, getBandV0(band), getBandHeight(band), d_size,
+							 stripesCoords, stripesCorners, restore_direction, stk_rst, blending_algo, show_progress_bar);
+	next_z = -1;
+
+	#ifdef _VAA3D_TERAFLY_PLUGIN_MODE
+	if(worker && _next_z_size > 0)
+	{
+		next_z = _next_z;
+		next_z_size = _next_z_size;
+		next_band = _next_band;
+		worker->start();
+	}
+	#else
+	(void)_next_z; (void)_next_z_size; (void)_next_band; // merged in background only with Qt
+	#endif
+}
@@ -49,11 +49,12 @@ using namespace iom;
 * <overlap_direction>	: direction of overlapping (see <direction> type definition for further details)
 * <overlap>				: expected overlap between the given stacks along the given direction.  This value can
 *						  be used to determine the region of interest where the overlapping occurs.
+* <n_threads>			: number of threads used to compute the NCC maps of the three MIPs
 **************************************************************************************************************/
 Displacement* PDAlgoMIPNCC::execute(iom::real_t *stk_A, uint32 A_dim_V, uint32 A_dim_H, uint32 A_dim_D,
 	iom::real_t *stk_B, uint32 B_dim_V, uint32 B_dim_H, uint32 B_dim_D,
 	uint32 displ_max_V, uint32 displ_max_H, uint32 displ_max_D,
-	direction overlap_direction, uint32 overlap) throw (iom::exception)
+	direction overlap_direction, uint32 overlap, int n_threads) throw (iom::exception)
 {
 	#if S_VERBOSE>3
 	printf("\t\t\t\tin PDAlgoMIPNCC::execute(..., A_dim_V = %d, A_dim_H = %d, A_dim_D = %d, B_dim_V = %d, B_dim_H = %d, B_dim_D = %d, displ_max_V = %d, displ_max_H = %d, displ_max_D = %d, overlap_direction = %d, overlap = %d)\n",
@@ -87,6 +88,8 @@ Displacement* PDAlgoMIPNCC::execute(iom::real_t *stk_A, uint32 A_dim_V, uint32 A
 	params.INF_W        = MAX(params.wRangeThr_i,MAX(params.wRangeThr_j,params.wRangeThr_k)) + 1;
 	params.widthThr     = 0.75f;
 	params.INV_COORD    = 0;
+	params.n_threads    = n_threads < 1 ? 1 : n_threads;
+	params.fftThr       = CM_DEF_FFT_THR;
 
 	NCC_descr_t* descr = norm_cross_corr_mips(stk_A, stk_B, A_dim_D, A_dim_V, A_dim_H, 0, overlap_direction == dir_vertical ? A_dim_V - overlap : 0, 
 											  overlap_direction == dir_horizontal ? A_dim_H - overlap: 0, displ_max_D, displ_max_V, displ_max_H, overlap_direction, &params);
@@ -46,6 +46,8 @@
 
 #ifdef _VAA3D_TERAFLY_PLUGIN_MODE
 #include <QElapsedTimer>
+#include <QThreadPool>
+#include <QRunnable>
 #include "PLog.h"
 #include "COperation.h"
 #endif
@@ -68,6 +70,7 @@
 
 #include "../imagemanager/Tiff3DMngr.h"
 #include "../imagemanager/HDF5Mngr.h"
+#include "../imagemanager/ChunkedFmtMngr.h"
 
 #include <limits>
 #include <list>
@@ -78,11 +81,400 @@
 
 using namespace iim;
 
+/*******************************************************************************************************
+* Pipelined tile generation (see VolumeConverter::setThreads)
+*
+* ConverterJob:   unit of work executed by a worker thread; since exceptions cannot cross thread bounda-
+*                 ries, errors are stored and rethrown by the thread that waits for the job.
+* ConverterPool:  bounded pool of workers. With 0 threads (or when Qt is not available) jobs are exe-
+*                 cuted inline by start(), so that the sequential behavior is exactly the original one.
+* SlabReader:     loads the next slab of the source volume in background while the current one is
+*                 being halved and saved. The source volume is accessed by one thread at a time. HDF5 is not
+*                 thread-safe, so HDF5 volumes are read synchronously and never while HDF5 files are written.
+* ChunkWriter:    encodes and saves one chunk of a chunked array (the chunk is copied by the main thread).
+*******************************************************************************************************/
+namespace
+{
+
+class ConverterJob
+#ifdef _VAA3D_TERAFLY_PLUGIN_MODE
+    : public QRunnable
+#endif
+{
+    public:
+
+        std::string error;      // empty if the job succeeded
+
+        ConverterJob(){
+            #ifdef _VAA3D_TERAFLY_PLUGIN_MODE
+            setAutoDelete(false);
+            #endif
+        }
+        virtual ~ConverterJob(){}
+
+        virtual void execute() throw (IOException, iom::exception) = 0;
+
+        void run()
+        {
+            try                             { execute(); }
+            catch(IOException & ex)         { error = ex.what(); }
+            catch(iom::exception & ex)      { error = ex.what(); }
+            catch(...)                      { error = "unknown error"; }
+        }
+};
+
+class ConverterPool
+{
+    private:
+
+        std::vector<ConverterJob*> jobs;
+        #ifdef _VAA3D_TERAFLY_PLUGIN_MODE
+        QThreadPool pool;
+        #endif
+        int n_threads;
+
+    public:
+
+        ConverterPool(int _n_threads) : n_threads(_n_threads)
+        {
+            #ifdef _VAA3D_TERAFLY_PLUGIN_MODE
+            if(n_threads > 0)
+                pool.setMaxThreadCount(n_threads);
+            #else
+            n_threads = 0;
+            #endif
+        }
+        ~ConverterPool()
+        {
+            join();
+            for(size_t i=0; i<jobs.size(); i++)
+                delete jobs[i];
+        }
+
+        // queues <job> (ownership is taken)
+        void start(ConverterJob *job)
+        {
+            jobs.push_back(job);
+            #ifdef _VAA3D_TERAFLY_PLUGIN_MODE
+            if(n_threads > 0)
+            {
+                pool.start(job);
+                return;
+            }
+            #endif
+            job->run();
+        }
+
+        // waits for all queued jobs
+        void join()
+        {
+            #ifdef _VAA3D_TERAFLY_PLUGIN_MODE
+            pool.waitForDone();
+            #endif
+        }
+
+        // waits for all queued jobs, releases them and rethrows the first error (if any)
+        void wait() throw (IOException)
+        {
+            join();
+            std::string error;
+            for(size_t i=0; i<jobs.size(); i++)
+            {
+                if(error.empty() && !jobs[i]->error.empty())
+                    error = jobs[i]->error;
+                delete jobs[i];
+            }
+            jobs.clear();
+            if(!error.empty())
+                throw IOException(error.c_str());
+        }
+};
+
+class SlabReader
+{
+    private:
+
+        class Loader : public ConverterJob
+        {
+            public:
+
+                VirtualVolume *volume;
+                bool real;                      // true if internal_rep == REAL_INTERNAL_REP
+                int V0, V1, H0, H1, D0, D1;
+                int channels;
+                real32 *rbuffer;
+                uint8 *ubuffer;
+
+                void execute() throw (IOException, iom::exception)
+                {
+                    if(real)
+                        rbuffer = volume->loadSubvolume_to_real32(V0,V1,H0,H1,D0,D1);
+                    else
+                        ubuffer = volume->loadSubvolume_to_UINT8(V0,V1,H0,H1,D0,D1,&channels,iim::NATIVE_RTYPE);
+                }
+        };
+
+        ConverterPool pool;
+        Loader *pending;
+
+    public:
+
+        SlabReader(bool async) : pool(async ? 1 : 0), pending(0) {}
+        ~SlabReader()
+        {
+            // release a slab that has been read but never taken (e.g. because of an exception)
+            if(pending)
+            {
+                pool.join();
+                delete[] pending->rbuffer;
+                delete[] pending->ubuffer;
+            }
+        }
+
+        bool hasPending() { return pending != 0; }
+
+        // starts reading the given slab; at most one slab can be pending
+        void request(VirtualVolume *volume, bool real, int V0, int V1, int H0, int H1, int D0, int D1, int channels)
+        {
+            pending = new Loader();
+            pending->volume = volume;
+            pending->real = real;
+            pending->V0 = V0; pending->V1 = V1;
+            pending->H0 = H0; pending->H1 = H1;
+            pending->D0 = D0; pending->D1 = D1;
+            pending->channels = channels;
+            pending->rbuffer = 0;
+            pending->ubuffer = 0;
+            pool.start(pending);
+        }
+
+        // waits for the pending slab and returns its buffer (ownership is passed to the caller)
+        void take(real32 *&rbuffer, uint8 *&ubuffer, int &channels) throw (IOException)
+        {
+            if(!pending)
+                throw IOException("in SlabReader::take(): no slab has been requested");
+
+            pool.join();
+            if(pending->real)
+                rbuffer = pending->rbuffer;
+            else
+                ubuffer = pending->ubuffer;
+            channels = pending->channels;
+            pending = 0;
+            pool.wait();    // releases the job and rethrows its error (if any)
+        }
+};
+
+// true if slabs of <volume> can be read in background, i.e. concurrently with the other threads
+bool asyncReadable(VirtualVolume *volume)
+{
+    return volume->getPrintableFormat() != iim::BDV_HDF5_FORMAT;    // the HDF5 library is not thread-safe
+}
+
+// saves the slices of one tile of a slab as 2D images (see generateTiles)
+class SliceTileWriter : public ConverterJob
+{
+    public:
+
+        std::vector<std::string> img_paths;     // one per slice, without extension
+        bool real;                              // true if internal_rep == REAL_INTERNAL_REP
+        real32 *rbuffer;
+        uint8 *ubuffer[3];
+        int channels, bytes_chan;
+        int raw_img_height, raw_img_width;
+        int start_height, end_height, start_width, end_width;
+        const char *img_format;
+        int img_depth;
+
+        void execute() throw (IOException, iom::exception)
+        {
+            sint64 slice_size = ((sint64)raw_img_height) * raw_img_width;
+            for(int buffer_z=0; buffer_z<(int)img_paths.size(); buffer_z++)
+            {
+                if ( real )
+                    VirtualVolume::saveImage(img_paths[buffer_z],
+                        rbuffer + buffer_z*slice_size, // adds the stride
+                        raw_img_height,raw_img_width,
+                        start_height,end_height,start_width,end_width,
+                        img_format, img_depth);
+                else if ( channels == 1 )
+                    VirtualVolume::saveImage_from_UINT8(img_paths[buffer_z],
+                        ubuffer[0] + buffer_z*slice_size, // adds the stride
+                        (uint8 *) 0,
+                        (uint8 *) 0,
+                        raw_img_height,raw_img_width,
+                        start_height,end_height,start_width,end_width,
+                        img_format, img_depth);
+                else if ( channels == 2 )
+                    VirtualVolume::saveImage_from_UINT8(img_paths[buffer_z],
+                        ubuffer[0] + buffer_z*slice_size*bytes_chan, // stride to be added for slice buffer_z
+                        ubuffer[1] + buffer_z*slice_size*bytes_chan, // stride to be added for slice buffer_z
+                        (uint8 *) 0,
+                        raw_img_height,raw_img_width,
+                        start_height,end_height,start_width,end_width,
+                        img_format, img_depth);
+                else // channels = 3
+                    VirtualVolume::saveImage_from_UINT8(img_paths[buffer_z],
+                        ubuffer[0] + buffer_z*slice_size*bytes_chan, // stride to be added for slice buffer_z
+                        ubuffer[1] + buffer_z*slice_size*bytes_chan, // stride to be added for slice buffer_z
+                        ubuffer[2] + buffer_z*slice_size*bytes_chan, // stride to be added for slice buffer_z
+                        raw_img_height,raw_img_width,
+                        start_height,end_height,start_width,end_width,
+                        img_format, img_depth);
+            }
+        }
+};
+
+// appends the slices of one tile of a slab to its 3D block files (see generateTilesVaa3DRaw)
+class BlockTileWriter : public ConverterJob
+{
+    public:
+
+        std::string img_path;                   // block file the first slice is appended to
+        std::string img_path_next;              // next block file (used iff the slab crosses a block boundary)
+        int slice_ind;                          // index of the first slice into its block file
+        int n_slices;                           // number of slices of the slab at the current resolution
+        sint64 first_slice, slice_end;          // index of the first slice and of the last slice of the current block
+        int n_pages_block, n_pages_next;        // number of pages of the current and of the next block
+        bool real;                              // true if internal_rep == REAL_INTERNAL_REP
+        real32 *rbuffer;
+        uint8 **ubuffer;
+        int channels, bytes_chan;
+        int raw_img_height, raw_img_width;
+        int start_height, end_height, start_width, end_width;
+        const char *img_format;
+        int img_depth;
+
+        void execute() throw (IOException, iom::exception)
+        {
+            /* 2015-02-06. Giulio. @ADDED optimization to reduce the number of open/close operations in append operations
+             * Since slices of the same block in a group are appended in sequence, to minimize the overhead of append operations, 
+             * all slices of a group to be appended to the same block file are appended leaving the file open and positioned at 
+             * end of the file.
+             */
+            sint64 slice_size = ((sint64)raw_img_height) * raw_img_width;
+            bool tiff3D = strcmp(img_format,"Tiff3D") == 0;
+            std::string path = img_path;
+            int ind = slice_ind;
+            int n_pages = n_pages_block;
+            bool block_changed = false;         // true if block is changed executing the next for cycle
+
+            void *fhandle = 0;
+            if ( tiff3D )
+                openTiff3DFile((char *)path.c_str(),(char *)(ind ? "a" : "w"),fhandle);
+
+            for(int buffer_z=0; buffer_z<n_slices; buffer_z++, ind++)
+            {
+                if ( (first_slice + buffer_z) > slice_end && !block_changed ) { // start a new block along z
+                    path = img_path_next;
+                    ind = 0; // 2015-02-10. Giulio. @CHANGED (int)(n_slices_pred - (slice_end[i]+1)) + buffer_z;
+                    if ( tiff3D ) {
+                        closeTiff3DFile(fhandle);
+                        openTiff3DFile((char *)path.c_str(),(char *)"w",fhandle);
+                    }
+                    n_pages = n_pages_next;
+                    block_changed = true;
+                }
+
+                if ( real )
+                    VirtualVolume::saveImage_to_Vaa3DRaw(
+                        ind,
+                        path,
+                        rbuffer + buffer_z*slice_size, // adds the stride
+                        raw_img_height,raw_img_width,
+                        start_height,end_height,start_width,end_width,
+                        img_format, img_depth
+                    );
+                else if ( tiff3D )
+                    VirtualVolume::saveImage_from_UINT8_to_Tiff3D(
+                        ind,
+                        path,
+                        ubuffer,
+                        channels,
+                        buffer_z*slice_size*bytes_chan,  // stride to be added for slice buffer_z
+                        raw_img_height,raw_img_width,
+                        start_height,end_height,start_width,end_width,
+                        img_format, img_depth,fhandle,n_pages,false);
+                else // can be only Vaa3DRaw
+                    VirtualVolume::saveImage_from_UINT8_to_Vaa3DRaw(
+                        ind,
+                        path,
+                        ubuffer,
+                        channels,
+                        buffer_z*slice_size*bytes_chan,  // stride to be added for slice buffer_z
+                        raw_img_height,raw_img_width,
+                        start_height,end_height,start_width,end_width,
+                        img_format, img_depth);
+            }
+
+            // close(fhandle) i.e. currently opened file
+            if ( tiff3D )
+                closeTiff3DFile(fhandle);
+        }
+};
+
+class ChunkWriter : public ConverterJob
+{
+    public:
+
+        std::string dir;                        // directory of the chunked array
+        const chunked_array_t *array;
+        int c;
+        sint64 z, y, x;                         // chunk indices
+        std::vector<uint8> data;                // decoded chunk (padded with zeros)
+
+        void execute() throw (IOException, iom::exception)
+        {
+            chunkedWriteChunk(dir,*array,c,z,y,x,&data[0]);
+        }
+};
+
+// queues the chunks of layer <cz> of chunked array <arr>, whose first <n_slices> slices (of all channels) are in <layer>
+void queueChunkLayer(ConverterPool &writers, const std::string &dir, const chunked_array_t &arr,
+                     const std::vector<uint8> &layer, sint64 n_slices, sint64 cz) throw (IOException)
+{
+    sint64 height = arr.dims[2], width = arr.dims[3];
+    sint64 cd = arr.chunk_dims[1], cv = arr.chunk_dims[2], ch = arr.chunk_dims[3];
+    int bytes_chan = arr.bytes_chan;
+
+    for(int c=0; c<arr.dims[0]; c++)
+    {
+        for(sint64 cy=0; cy<arr.nChunks(2); cy++)
+        {
+            chunkedMakeChunkDirs(dir,c,cz,cy);
+            for(sint64 cx=0; cx<arr.nChunks(3); cx++)
+            {
+                ChunkWriter *job = new ChunkWriter();
+                job->dir = dir;
+                job->array = &arr;
+                job->c = c;
+                job->z = cz;
+                job->y = cy;
+                job->x = cx;
+                job->data.resize(arr.chunkBytes(),0);
+
+                sint64 y0 = cy*cv, y1 = std::min(height,y0+cv);
+                sint64 x0 = cx*ch, x1 = std::min(width,x0+ch);
+                for(sint64 z=0; z<n_slices; z++)
+                    for(sint64 y=y0; y<y1; y++)
+                        memcpy(&job->data[((z*cv + (y-y0))*ch)*bytes_chan],
+                               &layer[(((c*cd + z)*height + y)*width + x0)*bytes_chan], (x1-x0)*bytes_chan);
+                writers.start(job);
+            }
+        }
+    }
+}
+
+} // anonymous namespace
+
 VolumeConverter::VolumeConverter( )
 {
     /**/iim::debug(iim::LEV3, 0, __iim__current__function__);
 
 	volume = (VirtualVolume *) 0;
+	n_threads = 1;
+	chunk_codec = "zlib";
+	chunk_level = 1;
 }
 
 
@@ -314,13 +706,20 @@ void VolumeConverter::generateTiles(std::string output_path, bool* resolutions,
 	ubuffer = new uint8 *[supported_channels];
 	memset(ubuffer,0,supported_channels*sizeof(uint8 *)); // initializes to null pointers
 
+	// slabs are read by <reader> (in background if n_threads > 1) and tiles are saved by <writers>
+	SlabReader reader(n_threads > 1 && asyncReadable(volume));
+	ConverterPool writers(n_threads > 1 ? n_threads : 0);
+
 	for(sint64 z = this->D0, z_parts = 1; z < this->D1; z += z_max_res, z_parts++)
 	{
-		// fill one slice block
-		if ( internal_rep == REAL_INTERNAL_REP )
-            rbuffer = volume->loadSubvolume_to_real32(V0,V1,H0,H1,(int)(z-D0),(z-D0+z_max_res <= D1) ? (int)(z-D0+z_max_res) : D1);
-		else { // internal_rep == UINT8_INTERNAL_REP
-            ubuffer[0] = volume->loadSubvolume_to_UINT8(V0,V1,H0,H1,(int)(z-D0),(z-D0+z_max_res <= D1) ? (int)(z-D0+z_max_res) : D1,&channels,iim::NATIVE_RTYPE);
+		// fill one slice block and start reading the next one
+		if ( !reader.hasPending() )
+			reader.request(volume,internal_rep == REAL_INTERNAL_REP,V0,V1,H0,H1,(int)(z-D0),(z-D0+z_max_res <= D1) ? (int)(z-D0+z_max_res) : D1,channels);
+		reader.take(rbuffer,ubuffer[0],channels);
+		if ( z + z_max_res < this->D1 )
+			reader.request(volume,internal_rep == REAL_INTERNAL_REP,V0,V1,H0,H1,(int)(z+z_max_res-D0),(z+2*z_max_res-D0 <= D1) ? (int)(z+2*z_max_res-D0) : D1,channels);
+
+		if ( internal_rep == UINT8_INTERNAL_REP ) {
 			// WARNING: next code assumes that channels is 1 or 3, but implementations of loadSubvolume_to_UINT8 do not guarantee this condition
 			if ( org_channels != channels ) {
 				char err_msg[STATIC_STRINGS_SIZE];
@@ -426,7 +825,8 @@ void VolumeConverter::generateTiles(std::string output_path, bool* resolutions,
                             throw IOException(err_msg);
 						}
 
-						//saving HERE
+						//saving HERE (slices of the tile are saved by one of the writers)
+						SliceTileWriter *writer = new SliceTileWriter();
                         for(int buffer_z=0; buffer_z<z_size/(powInt(2,i)); buffer_z++)
 						{
 							std::stringstream img_path;
@@ -439,42 +839,30 @@ void VolumeConverter::generateTiles(std::string output_path, bool* resolutions,
 										<< this->getMultiresABS_V_string(i,start_height) << "_" 
 										<< this->getMultiresABS_H_string(i,start_width) << "_"
 										<< abs_pos_z.str(); 
-							if ( internal_rep == REAL_INTERNAL_REP )
-								VirtualVolume::saveImage(img_path.str(), 
-                                    rbuffer + buffer_z*(height/powInt(2,i))*(width/powInt(2,i)), // adds the stride
-                                    (int)height/(powInt(2,i)),(int)width/(powInt(2,i)),
-									start_height,end_height,start_width,end_width, 
-									saved_img_format, saved_img_depth);
-							else // internal_rep == UINT8_INTERNAL_REP
-								if ( channels == 1 )
-									VirtualVolume::saveImage_from_UINT8(img_path.str(), 
-                                        ubuffer[0] + buffer_z*(height/powInt(2,i))*(width/powInt(2,i)), // adds the stride
-										(uint8 *) 0,
-										(uint8 *) 0,
-                                        (int)height/(powInt(2,i)),(int)width/(powInt(2,i)),
-										start_height,end_height,start_width,end_width, 
-										saved_img_format, saved_img_depth);
-								else if ( channels == 2 ) 
-									VirtualVolume::saveImage_from_UINT8(img_path.str(), 
-                                        ubuffer[0] + buffer_z*(height/powInt(2,i))*(width/powInt(2,i))*bytes_chan, // stride to be added for slice buffer_z
-                                        ubuffer[1] + buffer_z*(height/powInt(2,i))*(width/powInt(2,i))*bytes_chan, // stride to be added for slice buffer_z
-										(uint8 *) 0,
-                                        (int)height/(powInt(2,i)),(int)width/(powInt(2,i)),
-										start_height,end_height,start_width,end_width, 
-										saved_img_format, saved_img_depth);
-								else // channels = 3
-									VirtualVolume::saveImage_from_UINT8(img_path.str(), 
-                                        ubuffer[0] + buffer_z*(height/powInt(2,i))*(width/powInt(2,i))*bytes_chan, // stride to be added for slice buffer_z
-                                        ubuffer[1] + buffer_z*(height/powInt(2,i))*(width/powInt(2,i))*bytes_chan, // stride to be added for slice buffer_z
-                                        ubuffer[2] + buffer_z*(height/powInt(2,i))*(width/powInt(2,i))*bytes_chan, // stride to be added for slice buffer_z
-                                        (int)height/(powInt(2,i)),(int)width/(powInt(2,i)),
-										start_height,end_height,start_width,end_width, 
-										saved_img_format, saved_img_depth);
+							writer->img_paths.push_back(img_path.str());
 						}
+						writer->real = internal_rep == REAL_INTERNAL_REP;
+						writer->rbuffer = rbuffer;
+						for ( int c=0; c<3; c++ )
+							writer->ubuffer[c] = (c < channels) ? ubuffer[c] : (uint8 *) 0;
+						writer->channels = channels;
+						writer->bytes_chan = bytes_chan;
+						writer->raw_img_height = (int)height/(powInt(2,i));
+						writer->raw_img_width = (int)width/(powInt(2,i));
+						writer->start_height = start_height;
+						writer->end_height = end_height;
+						writer->start_width = start_width;
+						writer->end_width = end_width;
+						writer->img_format = saved_img_format;
+						writer->img_depth = saved_img_depth;
+						writers.start(writer);
 						start_width  += stacks_width [i][stack_row][stack_column];
 					}
 					start_height += stacks_height[i][stack_row][0];
 				}
+
+				// the buffer is halved in place at the next resolution: all tiles must have been saved
+				writers.wait();
 			}
 		}
 
@@ -782,6 +1170,10 @@ void VolumeConverter::generateTilesVaa3DRaw(std::string output_path, bool* resol
 		z_parts = 1;
 	}
 
+	// slabs are read by <reader> (in background if n_threads > 1) and tiles are saved by <writers>
+	SlabReader reader(n_threads > 1 && asyncReadable(volume));
+	ConverterPool writers(n_threads > 1 ? n_threads : 0);
+
 	// z must begin from D0 (absolute index into the volume) since it is used to compute tha file names (containing the absolute position along D)
 	for(/* sint64 z = this->D0, z_parts = 1 */; z < this->D1; z += z_max_res, z_parts++)
 	{
@@ -795,11 +1187,14 @@ void VolumeConverter::generateTilesVaa3DRaw(std::string output_path, bool* resol
         TERAFLY_TIME_START(ConverterLoadBlockOperation)
         #endif
 
-		// fill one slice block
-		if ( internal_rep == REAL_INTERNAL_REP )
-            rbuffer = volume->loadSubvolume_to_real32(V0,V1,H0,H1,(int)(z-D0),(z-D0+z_max_res <= D1) ? (int)(z-D0+z_max_res) : D1);
-		else { // internal_rep == UINT8_INTERNAL_REP
-            ubuffer[0] = volume->loadSubvolume_to_UINT8(V0,V1,H0,H1,(int)(z-D0),(z-D0+z_max_res <= D1) ? (int)(z-D0+z_max_res) : D1,&channels,iim::NATIVE_RTYPE);
+		// fill one slice block and start reading the next one
+		if ( !reader.hasPending() )
+			reader.request(volume,internal_rep == REAL_INTERNAL_REP,V0,V1,H0,H1,(int)(z-D0),(z-D0+z_max_res <= D1) ? (int)(z-D0+z_max_res) : D1,channels);
+		reader.take(rbuffer,ubuffer[0],channels);
+		if ( z + z_max_res < this->D1 )
+			reader.request(volume,internal_rep == REAL_INTERNAL_REP,V0,V1,H0,H1,(int)(z+z_max_res-D0),(z+2*z_max_res-D0 <= D1) ? (int)(z+2*z_max_res-D0) : D1,channels);
+
+		if ( internal_rep == UINT8_INTERNAL_REP ) {
 			if ( org_channels != channels ) {
 				char err_msg[STATIC_STRINGS_SIZE];
 				sprintf(err_msg,"The volume contains images with a different number of channels (%d,%d)", org_channels, channels);
@@ -894,6 +1289,11 @@ void VolumeConverter::generateTilesVaa3DRaw(std::string output_path, bool* resol
 					}
 				}
 
+                // 2015-01-30. Alessandro. @ADDED performance (time) measurement in 'generateTilesVaa3DRaw()' method.
+                #ifdef _VAA3D_TERAFLY_PLUGIN_MODE
+                TERAFLY_TIME_START(ConverterWriteBlockOperation)
+                #endif
+
 				//looping on new stacks
 				for(int stack_row = 0, start_height = 0, end_height = 0; stack_row < n_stacks_V[i]; stack_row++)
 				{
@@ -984,12 +1384,7 @@ void VolumeConverter::generateTilesVaa3DRaw(std::string output_path, bool* resol
 							}
 						}
 
-                        // 2015-01-30. Alessandro. @ADDED performance (time) measurement in 'generateTilesVaa3DRaw()' method.
-                        #ifdef _VAA3D_TERAFLY_PLUGIN_MODE
-                        TERAFLY_TIME_START(ConverterWriteBlockOperation)
-                        #endif
-
-						//saving HERE
+						//saving HERE (slices of the tile are appended to its block files by one of the writers)
 
 						// 2015-02-10. Giulio. @CHANGED changed how img_path is constructed
  						std::stringstream partial_img_path;
@@ -997,100 +1392,55 @@ void VolumeConverter::generateTilesVaa3DRaw(std::string output_path, bool* resol
 									<< this->getMultiresABS_V_string(i,start_height) << "_" 
 									<< this->getMultiresABS_H_string(i,start_width) << "_";
 
-						int slice_ind = (int)(n_slices_pred - slice_start[i]); 
-
- 						std::stringstream img_path;
-						img_path << partial_img_path.str() << abs_pos_z.str();
-
-						/* 2015-02-06. Giulio. @ADDED optimization to reduce the number of open/close operations in append operations
-						 * Since slices of the same block in a group are appended in sequence, to minimize the overhead of append operations, 
-						 * all slices of a group to be appended to the same block file are appended leaving the file open and positioned at 
-						 * end of the file.
-						 * The number of pages of block files of interest can be easily computed as:
-						 *
-						 *    number of slice of current block = stacks_depth[i][0][0][stack_block[i]] 
-						 *    number of slice of next block    = stacks_depth[i][0][0][stack_block[i]+1] 
-						 */
-
-						void *fhandle = 0;
-						int  n_pages_block = stacks_depth[i][0][0][stack_block[i]]; // number of pages of current block
-						bool block_changed = false;                                 // true if block is changed executing the next for cycle
-						// fhandle = open file corresponding to current block 
-						if ( strcmp(saved_img_format,"Tiff3D") == 0 )
-							openTiff3DFile((char *)img_path.str().c_str(),(char *)(slice_ind ? "a" : "w"),fhandle);
+						BlockTileWriter *writer = new BlockTileWriter();
+						writer->img_path = partial_img_path.str() + abs_pos_z.str();
+						writer->slice_ind = (int)(n_slices_pred - slice_start[i]); 
+						writer->n_slices = (int)(z_size/(powInt(2,i)));
+						writer->first_slice = (z - this->D0) / powInt(2,i);
+						writer->slice_end = slice_end[i];
+						writer->n_pages_block = stacks_depth[i][0][0][stack_block[i]]; // number of pages of current block
 
 						// WARNING: assumes that block size along z is not less that z_size/(powInt(2,i))
-                        for(int buffer_z=0; buffer_z<z_size/(powInt(2,i)); buffer_z++, slice_ind++)
-						{
-							// D0 must be subtracted because z is an absolute index in volume while slice index should be computed on a relative basis (i.e. starting form 0)
-							if ( ((z - this->D0) / powInt(2,i) + buffer_z) > slice_end[i] && !block_changed) { // start a new block along z
- 								std::stringstream abs_pos_z_next;
-								abs_pos_z_next.width(6);
-								abs_pos_z_next.fill('0');
-								abs_pos_z_next << (int)(this->getMultiresABS_D(i) + // all stacks start at the same D position
-                                        (powInt(2,i)*(slice_end[i]+1)) * volume->getVXL_D());
-								img_path.str("");
-								img_path << partial_img_path.str() << abs_pos_z_next.str();
-
-								slice_ind = 0; // 2015-02-10. Giulio. @CHANGED (int)(n_slices_pred - (slice_end[i]+1)) + buffer_z;
-
-								// close(fhandle) i.e. file corresponding to current block 
-								if ( strcmp(saved_img_format,"Tiff3D") == 0 )
-									closeTiff3DFile(fhandle);
-								// fhandle = open file corresponding to next block
-								if ( strcmp(saved_img_format,"Tiff3D") == 0 )
-									openTiff3DFile((char *)img_path.str().c_str(),(char *)"w",fhandle);
-								n_pages_block = stacks_depth[i][0][0][stack_block[i]+1];
-								block_changed = true;
-							}
-
-							if ( internal_rep == REAL_INTERNAL_REP )
-								VirtualVolume::saveImage_to_Vaa3DRaw(
-									slice_ind,
-									img_path.str(), 
-                                    rbuffer + buffer_z*(height/powInt(2,i))*(width/powInt(2,i)), // adds the stride
-                                    (int)height/(powInt(2,i)),(int)width/(powInt(2,i)),
-									start_height,end_height,start_width,end_width, 
-									saved_img_format, saved_img_depth
-								);
-							else // internal_rep == UINT8_INTERNAL_REP
-								if ( strcmp(saved_img_format,"Tiff3D")==0 ) {
-									VirtualVolume::saveImage_from_UINT8_to_Tiff3D(
-										slice_ind,
-										img_path.str(), 
-										ubuffer,
-										channels,
-										buffer_z*(height/powInt(2,i))*(width/powInt(2,i))*bytes_chan,  // stride to be added for slice buffer_z
-										(int)height/(powInt(2,i)),(int)width/(powInt(2,i)),
-										start_height,end_height,start_width,end_width, 
-										saved_img_format, saved_img_depth,fhandle,n_pages_block,false);
-								}
-								else { // can be only Vaa3DRaw
-									VirtualVolume::saveImage_from_UINT8_to_Vaa3DRaw(
-										slice_ind,
-										img_path.str(), 
-										ubuffer,
-										channels,
-										buffer_z*(height/powInt(2,i))*(width/powInt(2,i))*bytes_chan,  // stride to be added for slice buffer_z
-										(int)height/(powInt(2,i)),(int)width/(powInt(2,i)),
-										start_height,end_height,start_width,end_width, 
-										saved_img_format, saved_img_depth);
-								}
-                        }
-
-						// close(fhandle) i.e. currently opened file
-						if ( strcmp(saved_img_format,"Tiff3D") == 0 )
-							closeTiff3DFile(fhandle);
+						if ( writer->first_slice + writer->n_slices - 1 > slice_end[i] ) { // a new block along z is started by this slab
+ 							std::stringstream abs_pos_z_next;
+							abs_pos_z_next.width(6);
+							abs_pos_z_next.fill('0');
+							abs_pos_z_next << (int)(this->getMultiresABS_D(i) + // all stacks start at the same D position
+                                    (powInt(2,i)*(slice_end[i]+1)) * volume->getVXL_D());
+							writer->img_path_next = partial_img_path.str() + abs_pos_z_next.str();
+							writer->n_pages_next = stacks_depth[i][0][0][stack_block[i]+1];
+						}
+						else
+							writer->n_pages_next = 0;
+
+						writer->real = internal_rep == REAL_INTERNAL_REP;
+						writer->rbuffer = rbuffer;
+						writer->ubuffer = ubuffer;
+						writer->channels = channels;
+						writer->bytes_chan = bytes_chan;
+						writer->raw_img_height = (int)height/(powInt(2,i));
+						writer->raw_img_width = (int)width/(powInt(2,i));
+						writer->start_height = start_height;
+						writer->end_height = end_height;
+						writer->start_width = start_width;
+						writer->end_width = end_width;
+						writer->img_format = saved_img_format;
+						writer->img_depth = saved_img_depth;
+						writers.start(writer);
 
 						start_width  += stacks_width [i][stack_row][stack_column][0]; // WARNING TO BE CHECKED FOR CORRECTNESS
-
-                        // 2015-01-30. Alessandro. @ADDED performance (time) measurement in 'generateTilesVaa3DRaw()' method.
-                        #ifdef _VAA3D_TERAFLY_PLUGIN_MODE
-                        TERAFLY_TIME_STOP(ConverterWriteBlockOperation, itm::ALL_COMPS, teramanager::strprintf("converter: written multiresolution image block x(%d-%d), y(%d-%d), z(%d-%d)",start_width, end_width, start_height, end_height, ((uint32)(z-D0)),((uint32)(z-D0+z_max_res-1))))
-                        #endif
 					}
 					start_height += stacks_height[i][stack_row][0][0]; // WARNING TO BE CHECKED FOR CORRECTNESS
 				}
+
+				// the buffer is halved in place at the next resolution: all tiles must have been saved
+				writers.wait();
+
+                // 2015-01-30. Alessandro. @ADDED performance (time) measurement in 'generateTilesVaa3DRaw()' method.
+                // (tiles are saved concurrently, hence the time is measured for all the tiles of the resolution)
+                #ifdef _VAA3D_TERAFLY_PLUGIN_MODE
+                TERAFLY_TIME_STOP(ConverterWriteBlockOperation, itm::ALL_COMPS, teramanager::strprintf("converter: written multiresolution image blocks at resolution %d, z(%d-%d)", i, ((uint32)(z-D0)),((uint32)(z-D0+z_max_res-1))))
+                #endif
 			}
 		}
 
@@ -2569,14 +2919,20 @@ void VolumeConverter::generateTilesBDV_HDF5 ( std::string output_path, bool* res
 	memset(ubuffer,0,channels*sizeof(uint8));
 	org_channels = channels; // save for checks
 
+	// HDF5 is not thread-safe: slabs are read and hyperslabs are written by this thread only
+	SlabReader reader(false);
+
 	// z must begin from D0 (absolute index into the volume) since it is used to compute tha file names (containing the absolute position along D)
 	for(sint64 z = this->D0, z_parts = 1; z < this->D1; z += z_max_res, z_parts++)
 	{
-		// fill one slice block
-		if ( internal_rep == REAL_INTERNAL_REP )
-            rbuffer = volume->loadSubvolume_to_real32(V0,V1,H0,H1,(int)(z-D0),(z-D0+z_max_res <= D1) ? (int)(z-D0+z_max_res) : D1);
-		else { // internal_rep == UINT8_INTERNAL_REP
-            ubuffer[0] = volume->loadSubvolume_to_UINT8(V0,V1,H0,H1,(int)(z-D0),(z-D0+z_max_res <= D1) ? (int)(z-D0+z_max_res) : D1,&channels,iim::NATIVE_RTYPE);
+		// fill one slice block and start reading the next one
+		if ( !reader.hasPending() )
+			reader.request(volume,internal_rep == REAL_INTERNAL_REP,V0,V1,H0,H1,(int)(z-D0),(z-D0+z_max_res <= D1) ? (int)(z-D0+z_max_res) : D1,channels);
+		reader.take(rbuffer,ubuffer[0],channels);
+		if ( z + z_max_res < this->D1 )
+			reader.request(volume,internal_rep == REAL_INTERNAL_REP,V0,V1,H0,H1,(int)(z+z_max_res-D0),(z+2*z_max_res-D0 <= D1) ? (int)(z+2*z_max_res-D0) : D1,channels);
+
+		if ( internal_rep == UINT8_INTERNAL_REP ) {
 			if ( org_channels != channels ) {
 				char err_msg[STATIC_STRINGS_SIZE];
 				sprintf(err_msg,"The volume contains images with a different number of channels (%d,%d)", org_channels, channels);
@@ -2711,6 +3067,249 @@ void VolumeConverter::generateTilesBDV_HDF5 ( std::string output_path, bool* res
 }
 
 
+void VolumeConverter::setChunkCodec(std::string _codec, int _level) throw (IOException)
+{
+    /**/iim::debug(iim::LEV3, strprintf("_codec = \"%s\", _level = %d", _codec.c_str(), _level).c_str(), __iim__current__function__);
+
+	if ( !chunkedCodecAvailable(_codec) )
+		throw IOException(strprintf("in VolumeConverter::setChunkCodec: codec \"%s\" is not available", _codec.c_str()).c_str());
+	chunk_codec = _codec;
+	chunk_level = _level;
+}
+
+
+void VolumeConverter::generateTilesChunked ( std::string output_path, bool* resolutions, 
+				int block_height, int block_width, int block_depth, int method, 
+				bool show_progress_bar, int saved_img_depth )	throw (IOException)
+{
+    printf("in VolumeConverter::generateTilesChunked(path = \"%s\", resolutions = ", output_path.c_str());
+    for(int i=0; i< TMITREE_MAX_HEIGHT && resolutions; i++)
+        printf("%d", resolutions[i]);
+    printf(", block_height = %d, block_width = %d, block_depth = %d, method = %d, show_progress_bar = %s, saved_img_depth = %d, codec = %s, level = %d)\n",
+           block_height, block_width, block_depth, method, show_progress_bar ? "true" : "false", saved_img_depth, chunk_codec.c_str(), chunk_level);
+
+	if ( volume == 0 ) {
+		char err_msg[STATIC_STRINGS_SIZE];
+		sprintf(err_msg,"VolumeConverter::generateTilesChunked: undefined source volume");
+        throw IOException(err_msg);
+	}
+
+	if ( internal_rep != UINT8_INTERNAL_REP )
+        throw IOException("VolumeConverter::generateTilesChunked: only UINT8 internal representation is supported");
+
+	if ( saved_img_depth == 0 ) // default is to generate an image with the same depth of the source
+		saved_img_depth = volume->getBYTESxCHAN() * 8;
+		
+	if ( saved_img_depth != (volume->getBYTESxCHAN() * 8) ) {
+		char err_msg[STATIC_STRINGS_SIZE];
+		sprintf(err_msg,"VolumeConverter::generateTilesChunked: mismatch between bits per channel of source (%d) and destination (%d)",
+			volume->getBYTESxCHAN() * 8, saved_img_depth);
+        throw IOException(err_msg);
+	}
+
+	//LOCAL VARIABLES
+    sint64 height, width, depth;	//height, width and depth of the whole volume that covers all stacks
+    real32* rbuffer;			//not used (UINT8_INTERNAL_REP only)
+	uint8** ubuffer;			//array of buffers where temporary image data of channels are stored
+	int bytes_chan = volume->getBYTESxCHAN();
+	int org_channels = 0;       //store the number of channels read the first time (for checking purposes)
+	sint64 z_ratio, z_max_res;
+	int resolutions_size = 0;
+
+	//initializing the progress bar
+	char progressBarMsg[200];
+	if(show_progress_bar)
+	{
+       imProgressBar::getInstance()->start("Multiresolution tile generation");
+       imProgressBar::getInstance()->update(0,"Initializing...");
+       imProgressBar::getInstance()->show();
+	}
+
+	//computing dimensions of volume to be converted
+	width = this->H1-this->H0;
+	height = this->V1-this->V0;
+	depth = this->D1-this->D0;
+
+	//default chunk dimensions
+    block_height = (block_height == -1 ? 128 : block_height);
+    block_width  = (block_width  == -1 ? 128 : block_width);
+    block_depth  = (block_depth  == -1 ? 64  : block_depth);
+    if(block_height <= 0 || block_width <= 0 || block_depth <= 0)
+        throw IOException(strprintf("VolumeConverter::generateTilesChunked: invalid chunk dimensions %dx%dx%d", block_height, block_width, block_depth).c_str());
+
+	if(resolutions == NULL)
+	{
+            resolutions = new bool;
+            *resolutions = true;
+            resolutions_size = 1;
+	}
+	else
+            for(int i=0; i<TMITREE_MAX_HEIGHT; i++)
+                if(resolutions[i])
+                    resolutions_size = std::max(resolutions_size, i+1);
+
+    z_max_res = powInt(2,resolutions_size-1);
+	z_ratio=depth/z_max_res;
+
+	// one chunked array per resolution, plus the buffer where the slices of its current layer of chunks are accumulated
+	std::vector<chunked_array_t> arrays(resolutions_size);
+	std::vector<std::string> array_dirs(resolutions_size);
+	std::vector< std::vector<uint8> > layers(resolutions_size);
+	std::vector<sint64> layer_slices(resolutions_size,0);   // number of slices in the layer
+	std::vector<sint64> layer_index(resolutions_size,0);    // index of the layer along D
+	std::vector<std::string> group_arrays;
+	std::vector<float> group_scales;
+
+	if(!check_and_make_dir(output_path.c_str()))
+		throw IOException(strprintf("VolumeConverter::generateTilesChunked: unable to create DIR = \"%s\"", output_path.c_str()).c_str());
+
+	for(int i=0; i<resolutions_size; i++)
+	{
+		if(!resolutions[i])
+			continue;
+
+		chunked_array_t &arr = arrays[i];
+		arr.dims[0] = channels;
+		arr.dims[1] = depth/powInt(2,i);
+		arr.dims[2] = height/powInt(2,i);
+		arr.dims[3] = width/powInt(2,i);
+		if(arr.dims[1] == 0 || arr.dims[2] == 0 || arr.dims[3] == 0)
+			throw IOException(strprintf("VolumeConverter::generateTilesChunked: too many resolutions (%d) for a volume of %lldx%lldx%lld voxels",
+				resolutions_size, (long long)height, (long long)width, (long long)depth).c_str());
+		arr.chunk_dims[0] = 1;
+		arr.chunk_dims[1] = (int) std::min<sint64>(block_depth,  arr.dims[1]);
+		arr.chunk_dims[2] = (int) std::min<sint64>(block_height, arr.dims[2]);
+		arr.chunk_dims[3] = (int) std::min<sint64>(block_width,  arr.dims[3]);
+		arr.bytes_chan = bytes_chan;
+		arr.codec = chunk_codec;
+		arr.level = chunk_level;
+		arr.shuffle = bytes_chan > 1;
+		arr.ndims = 4;
+		arr.vxl[0] = volume->getVXL_D()*powInt(2,i);
+		arr.vxl[1] = volume->getVXL_V()*powInt(2,i);
+		arr.vxl[2] = volume->getVXL_H()*powInt(2,i);
+		arr.org[0] = volume->getORG_D() + D0*volume->getVXL_D()/1000.0f;
+		arr.org[1] = volume->getORG_V() + V0*volume->getVXL_V()/1000.0f;
+		arr.org[2] = volume->getORG_H() + H0*volume->getVXL_H()/1000.0f;
+		arr.separator = '/';
+
+		std::stringstream res_name;
+		res_name << "RES(" << arr.dims[2] << "x" << arr.dims[3] << "x" << arr.dims[1] << ")";
+		array_dirs[i] = output_path + "/" + res_name.str();
+		chunkedWriteMetadata(array_dirs[i],arr);
+
+		layers[i].resize(channels * arr.chunk_dims[1] * arr.dims[2] * arr.dims[3] * bytes_chan);
+
+		group_arrays.push_back(res_name.str());
+		for(int j=0; j<3; j++)
+			group_scales.push_back(arr.vxl[j]);
+	}
+	chunkedWriteGroup(output_path,group_arrays,group_scales);
+
+	//allocated even if not used
+	ubuffer = new uint8 *[channels];
+	memset(ubuffer,0,channels*sizeof(uint8 *));
+	org_channels = channels; // save for checks
+
+	// slabs are read by <reader> (in background if n_threads > 1) and chunks are encoded and saved by <writers>:
+	// at most one layer of chunks is being saved while the next one is accumulated
+	SlabReader reader(n_threads > 1 && asyncReadable(volume));
+	ConverterPool writers(n_threads > 1 ? n_threads : 0);
+
+	for(sint64 z = this->D0, z_parts = 1; z < this->D1; z += z_max_res, z_parts++)
+	{
+		// fill one slice block and start reading the next one
+		if ( !reader.hasPending() )
+			reader.request(volume,false,V0,V1,H0,H1,(int)(z-D0),(z-D0+z_max_res <= D1) ? (int)(z-D0+z_max_res) : D1,channels);
+		reader.take(rbuffer,ubuffer[0],channels);
+		if ( z + z_max_res < this->D1 )
+			reader.request(volume,false,V0,V1,H0,H1,(int)(z+z_max_res-D0),(z+2*z_max_res-D0 <= D1) ? (int)(z+2*z_max_res-D0) : D1,channels);
+
+		if ( org_channels != channels ) {
+			char err_msg[STATIC_STRINGS_SIZE];
+			sprintf(err_msg,"The volume contains images with a different number of channels (%d,%d)", org_channels, channels);
+            throw IOException(err_msg);
+		}
+
+		for (int i=1; i<channels; i++ ) {
+			// offsets have to be computed taking into account that buffer size along D may be different
+			// WARNING: the offset must be of tipe sint64 
+			ubuffer[i] = ubuffer[i-1] + (height * width * ((z_parts<=z_ratio) ? z_max_res : (depth%z_max_res)) * bytes_chan);
+		}
+
+		//updating the progress bar
+		if(show_progress_bar)
+		{	
+			sprintf(progressBarMsg, "Generating slices from %d to %d og %d",((uint32)(z-D0)),((uint32)(z-D0+z_max_res-1)),(uint32)depth);
+                        imProgressBar::getInstance()->update(((float)(z-D0+z_max_res-1)*100/(float)depth), progressBarMsg);
+                        imProgressBar::getInstance()->show();
+		}
+
+		//saving current buffer data at selected resolutions
+		for(int i=0; i< resolutions_size; i++)
+		{
+			if(show_progress_bar)
+			{
+                sprintf(progressBarMsg, "Generating resolution %d of %d",i+1,resolutions_size);
+                                imProgressBar::getInstance()->updateInfo(progressBarMsg);
+                                imProgressBar::getInstance()->show();
+			}
+
+			//buffer size along D is different when the remainder of the subdivision by z_max_res is considered
+			sint64 z_size = (z_parts<=z_ratio) ? z_max_res : (depth%z_max_res);
+
+			//halvesampling resolution if current resolution is not the deepest one
+			if(i!=0)
+                VirtualVolume::halveSample_UINT8(ubuffer,(int)height/(powInt(2,i-1)),(int)width/(powInt(2,i-1)),(int)z_size/(powInt(2,i-1)),channels,method,bytes_chan);
+			
+			//saving at current resolution if it has been selected and iff buffer is at least 1 voxel (Z) deep
+            if(resolutions[i] && (z_size/(powInt(2,i))) > 0)
+			{
+				if(show_progress_bar)
+				{
+					sprintf(progressBarMsg, "Saving to disc resolution %d",i+1);
+                                        imProgressBar::getInstance()->updateInfo(progressBarMsg);
+                                        imProgressBar::getInstance()->show();
+				}
+
+				// append the slices to the current layer and save the layer when it is complete
+				chunked_array_t &arr = arrays[i];
+				sint64 slice_size = arr.dims[2] * arr.dims[3] * bytes_chan;
+				for(sint64 s=0; s<z_size/powInt(2,i); s++)
+				{
+					for(int c=0; c<channels; c++)
+						memcpy(&layers[i][(c*arr.chunk_dims[1] + layer_slices[i])*slice_size], ubuffer[c] + s*slice_size, slice_size);
+					if(++layer_slices[i] == arr.chunk_dims[1])
+					{
+						writers.wait();
+						queueChunkLayer(writers,array_dirs[i],arr,layers[i],layer_slices[i],layer_index[i]);
+						layer_slices[i] = 0;
+						layer_index[i]++;
+					}
+				}
+			}
+		}
+
+		//releasing allocated memory
+		delete[] ubuffer[0]; // other buffer pointers are only offsets
+	}
+
+	// save the last (incomplete) layers
+	for(int i=0; i<resolutions_size; i++)
+	{
+		if(resolutions[i] && layer_slices[i] > 0)
+		{
+			writers.wait();
+			queueChunkLayer(writers,array_dirs[i],arrays[i],layers[i],layer_slices[i],layer_index[i]);
+		}
+	}
+	writers.wait();
+
+	// ubuffer allocated anyway
+	delete[] ubuffer;
+}
+
+
 // unified access point for volume conversion (@ADDED by Alessandro on 2014-02-24)
 void VolumeConverter::convertTo(
     std::string output_path,                        // path where to save the converted volume
@@ -2767,6 +3366,8 @@ void VolumeConverter::convertTo(
             generateTilesVaa3DRawMC(output_path, resolutions, block_height, block_width, block_depth, method, true, "Tiff3D", output_bitdepth);
         else if(output_format.compare(iim::BDV_HDF5_FORMAT) == 0)
             generateTilesBDV_HDF5(output_path,resolutions, block_height,block_width,block_depth,method, true,"Tiff3D",output_bitdepth);
+        else if(output_format.compare(iim::CHUNKED_FORMAT) == 0)
+            generateTilesChunked(output_path,resolutions, block_height,block_width,block_depth,method, true,output_bitdepth);
         else
             throw iim::IOException(strprintf("Output format \"%s\" not supported", output_format.c_str()).c_str());
     }
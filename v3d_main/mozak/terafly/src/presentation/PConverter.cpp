@@ -104,6 +104,7 @@ PConverter::PConverter(V3DPluginCallback *callback, QWidget *parent) : QWidget(p
     inFormatCBox->insertItem(6, iim::SIMPLE_RAW_FORMAT.c_str());
     inFormatCBox->insertItem(7, iim::TILED_FORMAT.c_str());
     inFormatCBox->insertItem(8, iim::TILED_MC_FORMAT.c_str());
+    inFormatCBox->insertItem(9, iim::CHUNKED_FORMAT.c_str());
    // PMain::setEnabledComboBoxItem(inFormatCBox, 0, false);
     inFormatCBox->setEditable(true);
     inFormatCBox->lineEdit()->setReadOnly(true);
@@ -148,6 +149,7 @@ PConverter::PConverter(V3DPluginCallback *callback, QWidget *parent) : QWidget(p
     outFormatCBox->insertItem(3, iim::TILED_FORMAT.c_str());
     outFormatCBox->insertItem(4, iim::TILED_MC_FORMAT.c_str());
     outFormatCBox->insertItem(5, iim::BDV_HDF5_FORMAT.c_str());
+    outFormatCBox->insertItem(6, iim::CHUNKED_FORMAT.c_str());
     //outFormatCBox->insertItem(8, iim::SIMPLE_RAW_FORMAT.c_str());
     /*PMain::setEnabledComboBoxItem(outFormatCBox, 1, false);
     PMain::setEnabledComboBoxItem(outFormatCBox, 2, false);
@@ -190,6 +192,13 @@ PConverter::PConverter(V3DPluginCallback *callback, QWidget *parent) : QWidget(p
     downsamplingCbox = new QComboBox(this);
     downsamplingCbox->addItem(QString("Mean (2").append(QChar(0x00D7)).append("2").append(QChar(0x00D7)).append("2)"));
     downsamplingCbox->addItem(QString("Max  (2").append(QChar(0x00D7)).append("2").append(QChar(0x00D7)).append("2)"));
+    threadsField = new QSpinBox();
+    threadsField->setAlignment(Qt::AlignCenter);
+    threadsField->setMinimum(1);
+    threadsField->setMaximum(64);
+    threadsField->setValue(CSettings::instance()->getVCThreads());
+    threadsField->setToolTip("Number of threads used to read, downsample and save tiles concurrently.\n"
+                             "With more than one thread, the slab buffer is doubled in RAM.");
 
     //conversion form layout
     QVBoxLayout* conversionFormLayout = new QVBoxLayout();
@@ -262,6 +271,10 @@ PConverter::PConverter(V3DPluginCallback *callback, QWidget *parent) : QWidget(p
     downSampleMethLayout->addWidget(downSampleMethLabel);
     downSampleMethLayout->addWidget(downsamplingCbox, 0, Qt::AlignLeft);
     downsamplingCbox->setFixedWidth(160);
+    downSampleMethLayout->addSpacing(30);
+    downSampleMethLayout->addWidget(new QLabel("Threads:"));
+    downSampleMethLayout->addWidget(threadsField, 0, Qt::AlignLeft);
+    threadsField->setFixedWidth(80);
     downSampleMethLayout->addStretch(1);
 
     QHBoxLayout* ramLayout = new QHBoxLayout();
@@ -321,6 +334,8 @@ PConverter::PConverter(V3DPluginCallback *callback, QWidget *parent) : QWidget(p
     connect(blockWidthField, SIGNAL(valueChanged(int)), this, SLOT(settingsChanged()));
     connect(blockHeightField, SIGNAL(valueChanged(int)), this, SLOT(settingsChanged()));
     connect(blockDepthField, SIGNAL(valueChanged(int)), this, SLOT(settingsChanged()));
+    connect(threadsField, SIGNAL(valueChanged(int)), this, SLOT(settingsChanged()));
+    connect(threadsField, SIGNAL(valueChanged(int)), this, SLOT(updateContent()));
     connect(addResolutionButton, SIGNAL(clicked()), this, SLOT(addResolution()));
     resetGUI();
 
@@ -585,6 +600,7 @@ void PConverter::settingsChanged()
     CSettings::instance()->setVCStacksWidth(blockWidthField->value());
     CSettings::instance()->setVCStacksHeight(blockHeightField->value());
     CSettings::instance()->setVCStacksDepth(blockDepthField->value());
+    CSettings::instance()->setVCThreads(threadsField->value());
     CSettings::instance()->writeSettings();
 }
 
@@ -691,6 +707,14 @@ void PConverter::volformatChanged (int )
         if(sender == outFormatCBox)
             blockDepthField->setVisible(true);
     }
+    else if(sender->currentText().compare(iim::CHUNKED_FORMAT.c_str(), Qt::CaseInsensitive) == 0)
+    {
+        helpBox->setText("One Zarr array per resolution, with (c,z,y,x) chunks of the given size compressed independently (see <a href=\"https://zarr.readthedocs.io\">this</a> link)");
+        buttonLayout->setCurrentWidget(dirButton);
+
+        if(sender == outFormatCBox)
+            blockDepthField->setVisible(true);
+    }
     else
         helpBox->setText("<html><p style=\"text-align:justify;\"> Format not yet supported. </p></html>");
 }
@@ -865,6 +889,8 @@ void PConverter::updateContent()
         int layer_width = vc->getH1()-vc->getH0();
         int layer_depth = pow(2.0f, max_res);
         float GBytes = (layer_height/1000.0f)*(layer_width/1000.0f)*(layer_depth/1000.0f)*vc->getVolume()->getDIM_C()*vc->getVolume()->getBYTESxCHAN();
+        if(threadsField->value() > 1)
+            GBytes *= 2;    // the next layer is read while the current one is saved
         memoryField->setText(QString::number(GBytes, 'f', 3).append(" GB"));
     }
     catch(RuntimeException &ex)
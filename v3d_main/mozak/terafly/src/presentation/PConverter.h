@@ -92,6 +92,7 @@ class teramanager::PConverter : public QWidget
         QSpinBox* blockDepthField;      //field to select stacks depth (optional)
         QLabel* memoryField;            //field for memory usage estimation
         QComboBox* downsamplingCbox;    //downsampling method
+        QSpinBox* threadsField;         //number of threads used for tile generation
 
         QElapsedTimer timer;            //timer
 
@@ -74,7 +74,11 @@ SOURCES += ../terafly/src/core/iomanager/plugins/tiff3D/tiff3D.cpp
 #setup imagemanager
 INCLUDEPATH += ../terafly/src/core/imagemanager
 HEADERS += ../terafly/src/core/imagemanager/BDVVolume.h
+HEADERS += ../terafly/src/core/imagemanager/BlockCache.h
 HEADERS += ../terafly/src/core/imagemanager/HDF5Mngr.h
+HEADERS += ../terafly/src/core/imagemanager/HalveSample.h
+HEADERS += ../terafly/src/core/imagemanager/ChunkedFmtMngr.h
+HEADERS += ../terafly/src/core/imagemanager/ChunkedVolume.h
 HEADERS += ../terafly/src/core/imagemanager/imBlock.h
 HEADERS += ../terafly/src/core/imagemanager/dirent_win.h
 HEADERS += ../terafly/src/core/imagemanager/IM_config.h
@@ -94,7 +98,11 @@ HEADERS += ../terafly/src/core/imagemanager/VirtualFmtMngr.h
 HEADERS += ../terafly/src/core/imagemanager/VirtualVolume.h
 HEADERS += ../terafly/src/core/imagemanager/UnstitchedVolume.h
 SOURCES += ../terafly/src/core/imagemanager/BDVVolume.cpp
+SOURCES += ../terafly/src/core/imagemanager/BlockCache.cpp
 SOURCES += ../terafly/src/core/imagemanager/HDF5Mngr.cpp
+SOURCES += ../terafly/src/core/imagemanager/HalveSample.cpp
+SOURCES += ../terafly/src/core/imagemanager/ChunkedFmtMngr.cpp
+SOURCES += ../terafly/src/core/imagemanager/ChunkedVolume.cpp
 SOURCES += ../terafly/src/core/imagemanager/imBlock.cpp
 SOURCES += ../terafly/src/core/imagemanager/IM_config.cpp
 SOURCES += ../terafly/src/core/imagemanager/imProgressBar.cpp
@@ -117,6 +125,7 @@ SOURCES += ../terafly/src/core/imagemanager/UnstitchedVolume.cpp
 # set up stitcher
 INCLUDEPATH += ../terafly/src/core/stitcher
 HEADERS += ../terafly/src/core/stitcher/S_config.h
+HEADERS += ../terafly/src/core/stitcher/BlockMerger.h
 HEADERS += ../terafly/src/core/stitcher/Displacement.h
 HEADERS += ../terafly/src/core/stitcher/DisplacementMIPNCC.h
 HEADERS += ../terafly/src/core/stitcher/PDAlgo.h
@@ -126,6 +135,7 @@ HEADERS += ../terafly/src/core/stitcher/StackStitcher.h
 HEADERS += ../terafly/src/core/stitcher/TPAlgo.h
 HEADERS += ../terafly/src/core/stitcher/TPAlgoMST.h
 HEADERS += ../terafly/src/core/stitcher/resumer.h
+SOURCES += ../terafly/src/core/stitcher/BlockMerger.cpp
 SOURCES += ../terafly/src/core/stitcher/Displacement.cpp
 SOURCES += ../terafly/src/core/stitcher/DisplacementMIPNCC.cpp
 SOURCES += ../terafly/src/core/stitcher/MergeTiles.cpp
@@ -1,5 +1,4 @@
 #include "DilationErosion.h"
-#include "SleepThread.h"
 
 #include "../terafly/src/presentation/theader.h"  //2015May PHC
 
@@ -13,6 +12,10 @@ DilationErosion::DilationErosion()
   xDim=yDim=zDim=0;
 }
 
+// The neighbor count of a voxel is the number of nonzero voxels in the box [x-e,x+e) x [y-e,y+e) x [z-e,z+e),
+// with coordinates outside the volume clamped to the edge. The box is separable, so the counts are computed as
+// running sums along x, then y, then z - constant work per voxel instead of (2e)^3. The z-slices are split into
+// one contiguous range per thread.
 void DilationErosion::dilateOrErode(int type, int xDim, int yDim, int zDim,
 				    unsigned char*** s, unsigned char*** t, int elementSize, int neighborsForThreshold) {
     qDebug() << "CellCounter3D::dilateOrErode() start";
@@ -21,106 +24,161 @@ void DilationErosion::dilateOrErode(int type, int xDim, int yDim, int zDim,
     this->xDim=xDim;
     this->yDim=yDim;
     this->zDim=zDim;
-    QList< QFuture<void> > deList;
-    for (int z=0;z<zDim;z++) {
-        QFuture<void> qf = QtConcurrent::run(this, &DilationErosion::dilateOrErodeZslice, type, z, elementSize, neighborsForThreshold);
+    if (elementSize<0) {
+        elementSize=0;
+    }
+    int rangeCount=QThread::idealThreadCount();
+    if (rangeCount>zDim) {
+        rangeCount=zDim;
+    }
+    if (rangeCount<1) {
+        rangeCount=1;
+    }
+    QList< QFuture<long> > deList;
+    for (int r=0;r<rangeCount;r++) {
+        int zStart=(int)(((long)zDim*r)/rangeCount);
+        int zEnd=(int)(((long)zDim*(r+1))/rangeCount);
+        QFuture<long> qf = QtConcurrent::run(this, &DilationErosion::dilateOrErodeZrange, type, zStart, zEnd, elementSize, neighborsForThreshold);
         deList.append(qf);
     }
-    while(1) {
-        SleepThread st;
-        st.msleep(5000);
-        int doneCount=0;
-        for (int i=0;i<deList.size();i++) {
-            QFuture<void> qf=deList.at(i);
-            if (qf.isFinished()) {
-                doneCount++;
+    long changedCount=0;
+    for (int i=0;i<deList.size();i++) {
+        changedCount+=deList[i].result();
+    }
+    if (type==TYPE_DILATE) {
+        qDebug() << "Dilated " << changedCount << " voxels";
+    } else if (type==TYPE_ERODE) {
+        qDebug() << "Eroded " << changedCount << " voxels";
+    }
+}
+
+// Adds (sign=1) or subtracts (sign=-1) the 2D box counts of source slice z to counts. rowCounts is a work plane of xDim*yDim.
+void DilationErosion::addSliceCounts(int z, int elementSize, int sign, int* rowCounts, int* counts) {
+    unsigned char** slice=currentSource[z];
+    const int e=elementSize;
+
+    // Along x: prefix sums over the row padded by e clamped voxels on each side
+    std::vector<int> prefix(xDim+2*e+1);
+    for (int y=0;y<yDim;y++) {
+        const unsigned char* row=slice[y];
+        prefix[0]=0;
+        for (int i=0;i<xDim+2*e;i++) {
+            int sx=i-e;
+            if (sx<0) {
+                sx=0;
+            } else if (sx>=xDim) {
+                sx=xDim-1;
             }
+            prefix[i+1]=prefix[i]+(row[sx]>0 ? 1 : 0);
+        }
+        int* r=rowCounts+y*xDim;
+        for (int x=0;x<xDim;x++) {
+            r[x]=prefix[x+2*e]-prefix[x];
+        }
+    }
+
+    // Along y: slide a window of whole rows, so the inner loops run over contiguous x
+    std::vector<int> window(xDim, 0);
+    int* w=&window[0];
+    for (int ey=-e;ey<e;ey++) {
+        int sy=ey<0 ? 0 : (ey>=yDim ? yDim-1 : ey);
+        const int* r=rowCounts+sy*xDim;
+        for (int x=0;x<xDim;x++) {
+            w[x]+=r[x];
         }
-        int stillActive=deList.size()-doneCount;
-        if (stillActive==0) {
-            break;
+    }
+    for (int y=0;y<yDim;y++) {
+        int* c=counts+y*xDim;
+        if (sign>0) {
+            for (int x=0;x<xDim;x++) {
+                c[x]+=w[x];
+            }
         } else {
-            qDebug() << "Waiting on " << stillActive << " z-slices";
+            for (int x=0;x<xDim;x++) {
+                c[x]-=w[x];
+            }
+        }
+        int addY=y+e;
+        if (addY>=yDim) {
+            addY=yDim-1;
+        }
+        int removeY=y-e;
+        if (removeY<0) {
+            removeY=0;
+        }
+        const int* add=rowCounts+addY*xDim;
+        const int* remove=rowCounts+removeY*xDim;
+        for (int x=0;x<xDim;x++) {
+            w[x]+=add[x]-remove[x];
         }
     }
 }
 
-void DilationErosion::dilateOrErodeZslice(int type, int z, int elementSize, int neighborsForThreshold) {
+long DilationErosion::dilateOrErodeZrange(int type, int zStart, int zEnd, int elementSize, int neighborsForThreshold) {
     unsigned char*** s=currentSource;
     unsigned char*** t=currentTarget;
     long dilateCount=0;
     long erosionCount=0;
-    for (int y=0;y<yDim;y++) {
-        for (int x=0;x<xDim;x++) {
-
-            int currentValue=s[z][y][x];
-
-            if (type==TYPE_ERODE) {
-                if (currentValue==0) {
-                    // nothing to do
-                    t[z][y][x]=0;
-                    continue;
-                }
-            } else if (type==TYPE_DILATE) {
-                if (currentValue>0) {
-                    t[z][y][x]=currentValue;
-                    continue;
-                }
-            }
+    const int e=elementSize;
+    const int planeSize=xDim*yDim;
+    if (zStart>=zEnd || planeSize==0) {
+        return 0;
+    }
+    std::vector<int> rowCounts(planeSize);
+    std::vector<int> counts(planeSize, 0);
 
-            int neighborCount=0;
-            for (int ez=z-elementSize;ez<z+elementSize;ez++) {
-                int sz=ez;
-                if (sz<0) {
-                    sz=0;
-                } else if (ez>=zDim) {
-                    sz=zDim-1;
-                }
-                for (int ey=y-elementSize;ey<y+elementSize;ey++) {
-                    int sy=ey;
-                    if (ey<0) {
-                        sy=0;
-                    } else if (ey>=yDim) {
-                        sy=yDim-1;
-                    }
-                    for (int ex=x-elementSize;ex<x+elementSize;ex++) {
-                        int sx=ex;
-                        if (ex<0) {
-                            sx=0;
-                        } else if (ex>=xDim) {
-                            sx=xDim-1;
-                        }
-                        // DEBUG
-                        unsigned char neighborValue=s[sz][sy][sx];
-                        if (neighborValue>0) {
-                            neighborCount++;
-                        }
-                    }
-                }
-            }
+    // Counts of the z-window for zStart, then slide it one slice at a time
+    for (int ez=zStart-e;ez<zStart+e;ez++) {
+        int sz=ez<0 ? 0 : (ez>=zDim ? zDim-1 : ez);
+        addSliceCounts(sz, e, 1, &rowCounts[0], &counts[0]);
+    }
 
+    for (int z=zStart;z<zEnd;z++) {
+        for (int y=0;y<yDim;y++) {
+            const int* c=&counts[y*xDim];
+            const unsigned char* sRow=s[z][y];
+            unsigned char* tRow=t[z][y];
             if (type==TYPE_DILATE) {
-                if (neighborCount>=neighborsForThreshold) {
-                    dilateCount++;
-                    t[z][y][x] = 255;
-                } else {
-                    t[z][y][x] = 0;
+                for (int x=0;x<xDim;x++) {
+                    if (sRow[x]>0) {
+                        tRow[x]=sRow[x];
+                    } else if (c[x]>=neighborsForThreshold) {
+                        dilateCount++;
+                        tRow[x]=255;
+                    } else {
+                        tRow[x]=0;
+                    }
                 }
             } else if (type==TYPE_ERODE) {
-                if (neighborCount<=neighborsForThreshold) {
-                    erosionCount++;
-                    t[z][y][x] = 0;
-                } else {
-                    t[z][y][x] = s[z][y][x];
+                for (int x=0;x<xDim;x++) {
+                    if (sRow[x]==0) {
+                        tRow[x]=0;
+                    } else if (c[x]<=neighborsForThreshold) {
+                        erosionCount++;
+                        tRow[x]=0;
+                    } else {
+                        tRow[x]=sRow[x];
+                    }
                 }
             }
-
+        }
+        if (z+1<zEnd && e>0) {
+            int addZ=z+e;
+            if (addZ>=zDim) {
+                addZ=zDim-1;
+            }
+            int removeZ=z-e;
+            if (removeZ<0) {
+                removeZ=0;
+            }
+            if (addZ!=removeZ) {
+                addSliceCounts(addZ, e, 1, &rowCounts[0], &counts[0]);
+                addSliceCounts(removeZ, e, -1, &rowCounts[0], &counts[0]);
+            }
         }
     }
     if (type==TYPE_DILATE) {
-        qDebug() << "Dilated " << dilateCount << " voxels";
-    } else if (type==TYPE_ERODE) {
-        qDebug() << "Eroded " << erosionCount << " voxels";
+        return dilateCount;
     }
+    return erosionCount;
 }
-
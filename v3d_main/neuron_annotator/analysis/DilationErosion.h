@@ -23,7 +23,8 @@ class DilationErosion
   void dilateOrErode(int type, int xDim, int yDim, int zDim, unsigned char*** s, unsigned char*** t, int elementSize, int neighborsForThreshold);
 
  private:
-  void dilateOrErodeZslice(int type, int z, int elementSize, int neighborsForThreshold);
+  long dilateOrErodeZrange(int type, int zStart, int zEnd, int elementSize, int neighborsForThreshold);
+  void addSliceCounts(int z, int elementSize, int sign, int* rowCounts, int* counts);
 
   unsigned char*** currentSource;
   unsigned char*** currentTarget;
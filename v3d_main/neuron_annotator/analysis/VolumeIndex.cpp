@@ -119,7 +119,6 @@ Implementation
 *********************/
 
 #include "MaskChan.h"
-#include "SleepThread.h"
 #include "VolumeIndex.h"
 #include "DilationErosion.h"
 #include "../utility/ImageLoaderBasic.h"
@@ -178,6 +177,7 @@ VolumeIndex::VolumeIndex()
   maxHits=100;
   backgroundWeight=1.0L;
   maskDilation=0;
+  allSamples=false;
 
   queryImage=0L;
   blankSubjectScore=0L;
@@ -239,6 +239,9 @@ int VolumeIndex::processArgs(vector<char*> *argList)
 	  QString maskDilationString=(*argList)[++i];
 	  maskDilation=maskDilationString.toInt();
 	}
+	if (arg=="-allSamples") {
+	  allSamples=true;
+	}
     }
     if (modeString.size()>0) {
       if (modeString=="sample") {
@@ -1833,6 +1836,7 @@ bool VolumeIndex::computeBlankSubjectScore()
   }
   delete [] queryData;
   delete [] subjectData;
+  return true;
 }
 
 /* this extracts subvolume data from an image, and uses the threshold array to consolidate the information into a single array ordered by level */
@@ -1930,15 +1934,13 @@ bool VolumeIndex::computeSubjectScores()
 {
   searchResultList.clear();
 
-  // We want to iterate through the 1st-stage index, spawning threads that are individually responsible for each sample. These 1st-stage
-  // threads will then visit each non-zero 2nd-stage index, and launch 2nd-stage threads which will add their results to the searchResultList.
-  // After all are finished, this list will be sorted and the results reported.
-
-  char* ownerBuffer=new char[2000];
+  // The primary index is mapped and parsed into one SampleThread per sample. Samples whose first-stage mask has no cell in
+  // common with the query are pruned, unless -allSamples is given. The secondary index cells in the union of the remaining
+  // first-stage masks are then handed out to one SearchWorker per core, so each secondary index file is read once for all samples.
+  // A fragment scores the blank subject score everywhere, corrected by its entries in the cells where it has data.
 
-  fid=openPrimaryIndex("rb");
-
-  sampleFutureList.clear();
+  QTime searchTimer;
+  searchTimer.start();
 
   int s1TotalVoxels=X1_SIZE*Y1_SIZE*Z1_SIZE;
   int firstStageIndexBytes=s1TotalVoxels/8;
@@ -1946,282 +1948,312 @@ bool VolumeIndex::computeSubjectScores()
     firstStageIndexBytes++;
   }
 
-  int sampleIndex=0;
-
-  int debugCounter=0;
+  QString primaryIndexPath=indexSpecification->rootPath;
+  primaryIndexPath.append("/");
+  primaryIndexPath.append(PRIMARY_INDEX_FILENAME);
+  QFile primaryIndexFile(primaryIndexPath);
+  if (!primaryIndexFile.open(QIODevice::ReadOnly)) {
+    qDebug() << "Could not open primary index file=" << primaryIndexPath;
+    return false;
+  }
+  qint64 primaryIndexSize=primaryIndexFile.size();
+  QByteArray primaryIndexBuffer;
+  const uchar* primaryIndexData=0L;
+  if (primaryIndexSize>0) {
+    primaryIndexData=primaryIndexFile.map(0, primaryIndexSize);
+    if (primaryIndexData==0L) {
+      // Mapping is not available on every file system - fall back to reading the whole index
+      primaryIndexBuffer=primaryIndexFile.readAll();
+      primaryIndexData=(const uchar*)primaryIndexBuffer.constData();
+      primaryIndexSize=primaryIndexBuffer.size();
+    }
+  }
+  if (!readPrimaryIndex(primaryIndexData, primaryIndexSize, firstStageIndexBytes)) {
+    return false;
+  }
 
-  while(!feof(fid)) {
+  // First-stage filter
+  QByteArray queryMask(firstStageIndexBytes, 0);
+  for (int z1=0;z1<Z1_SIZE;z1++) {
+    for (int y1=0;y1<Y1_SIZE;y1++) {
+      for (int x1=0;x1<X1_SIZE;x1++) {
+	if (blankSubjectScore[z1][y1][x1]->nonzeroCount>0) {
+	  int x1_position=z1*Y1_SIZE*X1_SIZE + y1*X1_SIZE + x1;
+	  queryMask[x1_position/8] = queryMask[x1_position/8] | (1 << (x1_position%8));
+	}
+      }
+    }
+  }
+  QByteArray searchMask(firstStageIndexBytes, 0);
+  QHash<long, SampleThread*> sampleMap;
+  int prunedCount=0;
+  for (int s=0;s<sampleThreadList.size();s++) {
+    SampleThread* st=sampleThreadList[s];
+    bool overlap=allSamples;
+    for (int i=0;i<firstStageIndexBytes && !overlap;i++) {
+      if (st->firstStageData[i] & queryMask[i]) {
+	overlap=true;
+      }
+    }
+    if (!overlap) {
+      if (DEBUG_FLAG) qDebug() << "Pruning sampleId=" << st->sampleId << " with no first-stage overlap";
+      prunedCount++;
+      continue;
+    }
+    sampleMap.insert(st->sampleId, st);
+    for (int i=0;i<firstStageIndexBytes;i++) {
+      searchMask[i] = searchMask[i] | st->firstStageData[i];
+    }
+  }
+  QVector<int> cellList;
+  for (int i=0;i<s1TotalVoxels;i++) {
+    if ((searchMask[i/8] >> (i%8)) & 1) {
+      cellList.append(i);
+    }
+  }
 
-    debugCounter++;
+  if (DEBUG_FLAG) qDebug() << "Searching " << sampleMap.size() << " samples over " << cellList.size() << " secondary index cells";
+
+  int workerCount=QThread::idealThreadCount();
+  if (workerCount>cellList.size()) {
+    workerCount=cellList.size();
+  }
+  if (workerCount<1) {
+    workerCount=1;
+  }
+  QAtomicInt cellCursor(0);
+  QList<SearchWorker*> workerList;
+  QList< QFuture<void> > workerFutureList;
+  for (int w=0;w<workerCount;w++) {
+    SearchWorker* worker=new SearchWorker();
+    worker->cellList=&cellList;
+    worker->cellCursor=&cellCursor;
+    worker->sampleMap=&sampleMap;
+    worker->entryCount=0;
+    worker->error=false;
+    workerList.append(worker);
+    workerFutureList.append(QtConcurrent::run(this, &VolumeIndex::runSearchWorker, worker));
+  }
+  for (int w=0;w<workerFutureList.size();w++) {
+    workerFutureList[w].waitForFinished();
+  }
+
+  // Merge the worker results - every worker map is ordered by (sampleId, fragmentId), so the result does not depend on scheduling
+  QMap< QPair<long,long>, MaskScore > scoreMap;
+  long entryCount=0;
+  bool error=false;
+  for (int w=0;w<workerList.size();w++) {
+    SearchWorker* worker=workerList[w];
+    QMap< QPair<long,long>, MaskScore >::const_iterator i;
+    for (i=worker->scoreMap.constBegin();i!=worker->scoreMap.constEnd();++i) {
+      scoreMap[i.key()].append(&i.value());
+    }
+    entryCount+=worker->entryCount;
+    error = error || worker->error;
+    delete worker;
+  }
+  if (error) {
+    qDebug() << "Error while reading the secondary index";
+    return false;
+  }
 
-    if (debugCounter > 3) {
-      break;
+  MaskScore blankTotal;
+  for (int z1=0;z1<Z1_SIZE;z1++) {
+    for (int y1=0;y1<Y1_SIZE;y1++) {
+      for (int x1=0;x1<X1_SIZE;x1++) {
+	blankTotal.append(blankSubjectScore[z1][y1][x1]);
+      }
     }
+  }
+  QMap< QPair<long,long>, MaskScore >::const_iterator i;
+  for (i=scoreMap.constBegin();i!=scoreMap.constEnd();++i) {
+    SampleThread* st=sampleMap[i.key().first];
+    MaskScore* wholeMaskScore=new MaskScore(blankTotal);
+    wholeMaskScore->append(&i.value());
+    computeMaskScore(wholeMaskScore);
+    SubjectScore* ss=new SubjectScore();
+    ss->sampleId=st->sampleId;
+    ss->fragmentId=i.key().second;
+    ss->owner=st->owner;
+    ss->firstStageVoxelCount=st->firstStageVoxelCount;
+    ss->maskScore=wholeMaskScore;
+    searchResultList.append(ss);
+  }
 
+  // Now sort the results
+  qStableSort(searchResultList.begin(), searchResultList.end(), ScoreSort());
+
+  // The first-stage data points into the primary index, which is unmapped when the file is closed
+  for (int s=0;s<sampleThreadList.size();s++) {
+    sampleThreadList[s]->firstStageData=0L;
+  }
+  primaryIndexFile.close();
+
+  double seconds=searchTimer.elapsed()/1000.0;
+  qDebug() << "Searched " << sampleThreadList.size() << " samples (" << prunedCount << " pruned by first-stage filter, " << entryCount << " entries scored) in "
+	   << seconds << " seconds = " << (seconds>0.0 ? sampleThreadList.size()/seconds : 0.0) << " samples/s using " << workerCount << " threads";
+
+  return true;
+}
+
+bool VolumeIndex::readPrimaryIndex(const uchar* data, qint64 size, int firstStageIndexBytes)
+{
+  qDeleteAll(sampleThreadList);
+  sampleThreadList.clear();
+
+  qint64 position=0;
+  while (position<size) {
     long sampleId;
     int ownerLength;
     int firstStageVoxelCount;
-    fread(&sampleId, sizeof(long), 1, fid);
-    if (feof(fid)) {
-      break;
+    if (size-position < (qint64)(sizeof(long)+sizeof(int))) {
+      qDebug() << "Primary index is truncated at position=" << position;
+      return false;
     }
-    fread(&ownerLength, sizeof(int), 1, fid);
-    if (ownerLength>2000) {
+    memcpy(&sampleId, data+position, sizeof(long));
+    position+=sizeof(long);
+    memcpy(&ownerLength, data+position, sizeof(int));
+    position+=sizeof(int);
+    if (ownerLength<0 || ownerLength>2000) {
       qDebug() << "Exceeded maximum owner name length buffer";
       return false;
     }
-    fread(ownerBuffer, sizeof(char), ownerLength, fid);
-    ownerBuffer[ownerLength]='\0';
-    QString owner = QString::fromLocal8Bit(ownerBuffer);
+    if (size-position < (qint64)(ownerLength+sizeof(int)+firstStageIndexBytes)) {
+      qDebug() << "Primary index is truncated for sampleId=" << sampleId;
+      return false;
+    }
+    QString owner = QString::fromLocal8Bit((const char*)(data+position), ownerLength);
+    position+=ownerLength;
+    memcpy(&firstStageVoxelCount, data+position, sizeof(int));
+    position+=sizeof(int);
+
+    if (DEBUG_FLAG) qDebug() << "sampleId=" << sampleId << " owner=" << owner << " firstStageVoxelCount=" << firstStageVoxelCount;
+
     SampleThread* st=new SampleThread();
     st->sampleId=sampleId;
     st->owner=owner;
     st->fid=0L;
-    fread(&firstStageVoxelCount, sizeof(int), 1, fid);
-
-    if (DEBUG_FLAG) qDebug() << "sampleId=" << sampleId << " owner=" << owner << " firstStageVoxelCount=" << firstStageVoxelCount;
-
     st->firstStageVoxelCount=firstStageVoxelCount;
-    st->firstStageData=new char[firstStageIndexBytes];
-    int readCount=fread(st->firstStageData, sizeof(char), firstStageIndexBytes, fid);
-
-    if (DEBUG_FLAG) qDebug() << "read " << readCount << " of " << firstStageIndexBytes << " first stage data";
-
-    for (int i=0;i<firstStageIndexBytes;i++) {
-      int it=st->firstStageData[i];
-      if (DEBUG_FLAG) qDebug() << i << " = " << it;
-    }
-
-    //    st=runSampleThread(st);
-    //    delete [] st->firstStageData; // to clear space
-    //    st->firstStageData=0L;
-
+    st->firstStageData=(char*)(data+position);
+    position+=firstStageIndexBytes;
     sampleThreadList.append(st);
-    qDebug() << "Adding runSampleThread to sampleFutureList for sampleId=" << sampleId;
-    QFuture<SampleThread*> sf = QtConcurrent::run(this, &VolumeIndex::runSampleThread, st);
-    sampleFutureList.append(sf);
-  }
-
-  if (DEBUG_FLAG) qDebug() << "Check6 - sampleFutureList size=" << sampleFutureList.size();
-
-  // THIS NEEDS TO BE RE-IMPLEMENTED WITH SEPARATE SAMPLE/FRAGMENT THREAD POOLS TO PREVENT DEADLOCK
-  int doneCount=0;
-  while(1) {
-    if (DEBUG_FLAG) qDebug() << "Starting sleep";
-    SleepThread st;
-    st.msleep(5000);
-    if (DEBUG_FLAG) qDebug() << "Done with sleep";
-    qDebug() << "sampleFutureList has " << sampleFutureList.size() << " entries";
-    for (int i=0;i<sampleFutureList.size();i++) {
-      if (DEBUG_FLAG) qDebug() << "Checking sampleThread " << i;
-      QFuture<SampleThread*> sf=sampleFutureList.at(i);
-      if (sf.isFinished()) {
-	if (DEBUG_FLAG) qDebug() << "thread is finished";
-	SampleThread* st = sf.result();
-	addSampleResult(st);
-	sampleFutureList.removeOne(sf);
-  	doneCount++;
-	qDebug() << "Finished " << doneCount << " runSampleThreads";
-      } else {
-	if (DEBUG_FLAG) qDebug() << "thread is not finished";
-      }
-    }
-    if (ERROR_FLAG) {
-      if (DEBUG_FLAG) qDebug() << "Error during execution of SampleThreads";
-      return false;
-    }
-    int stillActive=sampleFutureList.size();
-    if (stillActive==0) {
-      break;
-    } else {
-      if (DEBUG_FLAG) qDebug() << "Waiting on " << stillActive << " sample search threads";
-    }
   }
-
-  if (DEBUG_FLAG) qDebug() << "Finished with runSampleThread manager loop - searchResultList has " << searchResultList.size() << " entries";
-
-  // Now sort the results
-  qSort(searchResultList.begin(), searchResultList.end(), ScoreSort());
-
-  // Cleanup
-  fclose(fid);
-  fid=0L;
-  delete [] ownerBuffer;
-
   return true;
 }
 
-void VolumeIndex::addSampleResult(SampleThread* st)
+// Each worker takes the next unvisited cell from the shared cursor until none are left, so a few crowded cells
+// do not hold up the rest of the search.
+void VolumeIndex::runSearchWorker(SearchWorker* worker)
 {
-  long sampleId=st->sampleId;
-  QList<long> keyList=st->fragmentScoreMap.keys();
-  for (int i=0;i<keyList.size();i++) {
-    long fragmentId=keyList[i];
-    MaskScore* wholeMaskScore=new MaskScore();
-    SubjectScore* ss=new SubjectScore();
-    ss->sampleId=st->sampleId;
-    ss->fragmentId=fragmentId;
-    ss->owner=st->owner;
-    ss->firstStageVoxelCount=st->firstStageVoxelCount;
-    QList<MaskScore*> maskScoreList=st->fragmentScoreMap[fragmentId];
-    if (maskScoreList.size()>0) {
-      for (int j=0;j<maskScoreList.size();j++) {
-	MaskScore* partialMaskScore=maskScoreList[j];
-	wholeMaskScore->append(partialMaskScore);
-      }
+  const int maxS2Size=UNIT*UNIT*UNIT;
+  char* queryData=new char[maxS2Size];
+  char* subjectData=new char[maxS2Size];
+  while (true) {
+    int next=worker->cellCursor->fetchAndAddOrdered(1);
+    if (next>=worker->cellList->size()) {
+      break;
     }
-    for (int z1=0;z1<Z1_SIZE;z1++) {
-      for (int y1=0;y1<Y1_SIZE;y1++) {
-	for (int x1=0;x1<X1_SIZE;x1++) {
-	  QString nonzeroSignature=QString::number(x1)+" "+QString::number(y1)+" "+QString::number(z1);
-	  if (!fragmentStage1NonzeroSet[fragmentId].contains(nonzeroSignature)) {
-	    wholeMaskScore->append(blankSubjectScore[z1][y1][x1]);
-	  }
-	}
-      }
+    if (!scoreSecondaryIndexCell(worker->cellList->at(next), worker, queryData, subjectData)) {
+      worker->error=true;
+      break;
     }
-    computeMaskScore(wholeMaskScore);
-    ss->maskScore=wholeMaskScore;
-    searchResultList.append(ss);
   }
+  delete [] queryData;
+  delete [] subjectData;
 }
 
-// The sample thread is responsible for visiting each nonzero second-stage
-// index. For each nonzero entry, it reads the corresponding 2nd-stage
-// index, and looks for all entries associated with its sampleId.
-// For each associated entry, it calcluates the MaskScore, and adds this
-// to its collection.
-
-// Once done, it iterates through all map entries, and for each one, it
-// computes a global score for each fragment, which is added to the
-// searchResultList.
-
-SampleThread* VolumeIndex::runSampleThread(SampleThread* sampleThread)
+// Scores every qualifying entry of one secondary index file against the query. The query subvolume is extracted once per cell.
+bool VolumeIndex::scoreSecondaryIndexCell(int cell, SearchWorker* worker, char* queryData, char* subjectData)
 {
-  if (DEBUG_FLAG) qDebug() << "runSampleThread starting for id=" << sampleThread->sampleId;
-  for (int z1=0;z1<Z1_SIZE;z1++) {
-    for (int y1=0;y1<Y1_SIZE;y1++) {
-      for (int x1=0;x1<X1_SIZE;x1++) {
-	int x1_position=z1*Y1_SIZE*X1_SIZE + y1*X1_SIZE + x1;
-	int byte_position=x1_position/8;
-	int byteOffset = x1_position-8*byte_position;
-	char v=sampleThread->firstStageData[byte_position];
-	v >>= byteOffset;
-	char one=1;
-	if (v & one > 0) {
-	  // This position has data - open 2nd-stage index
-	  if (DEBUG_FLAG) qDebug() << "For sample " << sampleThread->sampleId << " opening secondary index at position x=" << x1 << " y=" << y1 << " z=" << z1;
-	  sampleThread->fid=openSecondaryIndexToRead(x1, y1, z1);
-	  if (!sampleThread->fid) {
-	    QString secondaryIndexFilepath=getSecondaryIndexFilepath(x1, y1, z1);
-	    qDebug() << "Could not open secondary index to read=" << secondaryIndexFilepath;
-	    ERROR_FLAG=true;
-	    return sampleThread;
-	  }
-	  int xlen=UNIT;
-	  if (x1==(X1_SIZE-1)) {
-	    xlen = X_SIZE - x1*UNIT;
-	  }
-	  int ylen=UNIT;
-	  if (y1==(Y1_SIZE-1)) {
-	    ylen = Y_SIZE - y1*UNIT;
-	  }
-	  int zlen=UNIT;
-	  if (z1==(Z1_SIZE-1)) {
-	    zlen = Z_SIZE - z1*UNIT;
-	  }
-	  int s2units=xlen*ylen*zlen;
-	  int s2byteLength=getStage2DataByteCount(s2units);
-	  char* secondStageData=new char[s2byteLength];
-	  // Now iterate through index file and select qualifying entries
-	  while (!feof(sampleThread->fid)) {
-	    char entryCode=0;
-	    fread(&entryCode, sizeof(char), 1, sampleThread->fid);
-	    if (feof(sampleThread->fid)) {
-	      break;
-	    }
-	    if (entryCode!=ENTRY_CODE) {
-	      qDebug() << "Error: ENTRY_CODE does not match";
-	      ERROR_FLAG=true;
-	      return sampleThread;
-	    } else {
-	      if (DEBUG_FLAG) qDebug() << "Confirmed ENTRY_CODE is correct";
-	    }
-	    int xstart, ystart, zstart;
-	    long fragmentId, sampleId;
-	    int voxelCount;
-	    fread(&xstart, sizeof(int), 1, sampleThread->fid);
-	    fread(&ystart, sizeof(int), 1, sampleThread->fid);
-	    fread(&zstart, sizeof(int), 1, sampleThread->fid);
-	    if (!(xstart==x1*UNIT && ystart==y1*UNIT && zstart==z1*UNIT)) {
-	      qDebug() << "2nd stage index x y z do not match index file";
-	      ERROR_FLAG=true;
-	      return sampleThread;
-	    }
-	    fread(&fragmentId, sizeof(long), 1, sampleThread->fid);
-	    fread(&sampleId, sizeof(long), 1, sampleThread->fid);
-	    fread(&voxelCount, sizeof(int), 1, sampleThread->fid);
-	    fread(secondStageData, sizeof(char), s2byteLength, sampleThread->fid);
-	    if (DEBUG_FLAG) qDebug() << "runSampleThread sampleId=" << sampleId << " fragmentId=" << fragmentId << " voxelCount=" << voxelCount << " minSubjectVoxels=" << minSubjectVoxels;
-	    if (sampleId==sampleThread->sampleId && voxelCount >= minSubjectVoxels) {
-	      if (DEBUG_FLAG) qDebug() << "Calling addMaskScoreForSecondStageEntry()";
-	      addMaskScoreForSecondStageEntry(fragmentId, sampleThread, secondStageData, s2units, x1, y1, z1);
-	    }
-	  }
-	  delete [] secondStageData;
-	  if (sampleThread->fid!=0L) {
-	    fclose(sampleThread->fid);
-	    sampleThread->fid=0L;
-	  }
-	}
-      }
-    }
+  int x1=cell % X1_SIZE;
+  int y1=(cell / X1_SIZE) % Y1_SIZE;
+  int z1=cell / (X1_SIZE*Y1_SIZE);
+
+  QString secondaryIndexFilepath=getSecondaryIndexFilepath(x1, y1, z1);
+  QFile secondaryIndexFile(secondaryIndexFilepath);
+  if (!secondaryIndexFile.open(QIODevice::ReadOnly)) {
+    qDebug() << "Could not open secondary index to read=" << secondaryIndexFilepath;
+    return false;
+  }
+  qint64 size=secondaryIndexFile.size();
+  if (size==0) {
+    return true;
+  }
+  QByteArray buffer;
+  const uchar* data=secondaryIndexFile.map(0, size);
+  if (data==0L) {
+    buffer=secondaryIndexFile.readAll();
+    data=(const uchar*)buffer.constData();
+    size=buffer.size();
   }
-  return sampleThread;
-}
 
-void VolumeIndex::addMaskScoreForSecondStageEntry(long fragmentId, SampleThread* sampleThread, char* secondStageData, int dataUnits, int x1, int y1, int z1)
-{
-  QString nonzeroSignature=QString::number(x1)+" "+QString::number(y1)+" "+QString::number(z1);
-  fragmentStage1NonzeroSet[fragmentId].insert(nonzeroSignature);
+  int xlen=UNIT;
+  if (x1==(X1_SIZE-1)) {
+    xlen = X_SIZE - x1*UNIT;
+  }
+  int ylen=UNIT;
+  if (y1==(Y1_SIZE-1)) {
+    ylen = Y_SIZE - y1*UNIT;
+  }
+  int zlen=UNIT;
+  if (z1==(Z1_SIZE-1)) {
+    zlen = Z_SIZE - z1*UNIT;
+  }
+  int s2units=xlen*ylen*zlen;
+  int s2byteLength=getStage2DataByteCount(s2units);
+  const qint64 entryLength=sizeof(char) + 3*sizeof(int) + 2*sizeof(long) + sizeof(int) + s2byteLength;
 
-  // First get query data ready
-  int qCount=1;
+  const MaskScore* blankScore=blankSubjectScore[z1][y1][x1];
   char qtArr[1];
   qtArr[0]=1;
-  int maxS2Size=UNIT*UNIT*UNIT;
-  char* queryData = new char[maxS2Size];
-  int subvolumeSize=getImageSubvolumeDataByStage1Coordinates(queryImage, queryData, x1, y1, z1, qCount, qtArr);
-
-  // Then get subject data ready
-  int s2bytes=getStage2DataByteCount(dataUnits);
-  char* subjectData = new char[maxS2Size];
-  expandSubjectData(secondStageData, subjectData, dataUnits);
-
-  // Then compute score
-  MaskScore* ms=computeSubvolumeScore(queryData, subjectData, dataUnits);
-  ms->x=x1;
-  ms->y=y1;
-  ms->z=z1;
-  if (DEBUG_FLAG) qDebug() << "maskScore=" << ms->score << " x=" << ms->x << " y=" << ms->y << " z=" << ms->z << " zeroCount=" << ms->zeroCount << " nonzeroCount=" << ms->nonzeroCount << " zeroScore=" << ms->zeroScore << " nonzeroScore=" << ms->nonzeroScore;
-
-  // Add to list
-  if (DEBUG_FLAG) qDebug() << "sampleThread->fragmentScoreMap has " << sampleThread->fragmentScoreMap.size() << " entries, before addition";
-  if (sampleThread->fragmentScoreMap.contains(fragmentId)) {
-    if (DEBUG_FLAG) qDebug() << "appending additional score for fragment, which already has " << sampleThread->fragmentScoreMap[fragmentId].size() << " entries";
-    sampleThread->fragmentScoreMap[fragmentId].append(ms);
-  } else {
-    if (DEBUG_FLAG) qDebug() << "Creating new MaskScore list for sampleId=" << sampleThread->sampleId << " fragmentId=" << fragmentId;
-    QList<MaskScore*> fragmentMaskScoreList;
-    fragmentMaskScoreList.append(ms);
-    sampleThread->fragmentScoreMap[fragmentId]=fragmentMaskScoreList;
-  }
+  bool queryLoaded=false;
 
-  delete [] queryData;
-  delete [] subjectData;
+  qint64 position=0;
+  while (position<size) {
+    if (size-position < entryLength) {
+      qDebug() << "Secondary index=" << secondaryIndexFilepath << " is truncated at position=" << position;
+      return false;
+    }
+    const uchar* entry=data+position;
+    position+=entryLength;
+    if ((char)entry[0]!=ENTRY_CODE) {
+      qDebug() << "Error: ENTRY_CODE does not match";
+      return false;
+    }
+    entry+=sizeof(char);
+    int xstart, ystart, zstart;
+    long fragmentId, sampleId;
+    int voxelCount;
+    memcpy(&xstart, entry, sizeof(int)); entry+=sizeof(int);
+    memcpy(&ystart, entry, sizeof(int)); entry+=sizeof(int);
+    memcpy(&zstart, entry, sizeof(int)); entry+=sizeof(int);
+    if (!(xstart==x1*UNIT && ystart==y1*UNIT && zstart==z1*UNIT)) {
+      qDebug() << "2nd stage index x y z do not match index file";
+      return false;
+    }
+    memcpy(&fragmentId, entry, sizeof(long)); entry+=sizeof(long);
+    memcpy(&sampleId, entry, sizeof(long)); entry+=sizeof(long);
+    memcpy(&voxelCount, entry, sizeof(int)); entry+=sizeof(int);
+    if (voxelCount < minSubjectVoxels || !worker->sampleMap->contains(sampleId)) {
+      continue;
+    }
+    if (!queryLoaded) {
+      getImageSubvolumeDataByStage1Coordinates(queryImage, queryData, x1, y1, z1, 1, qtArr);
+      queryLoaded=true;
+    }
+    expandSubjectData((const char*)entry, subjectData, s2units);
+    MaskScore* ms=computeSubvolumeScore(queryData, subjectData, s2units);
+    if (DEBUG_FLAG) qDebug() << "sampleId=" << sampleId << " fragmentId=" << fragmentId << " x=" << x1 << " y=" << y1 << " z=" << z1 << " zeroScore=" << ms->zeroScore << " nonzeroScore=" << ms->nonzeroScore;
+    MaskScore& fragmentScore=worker->scoreMap[qMakePair(sampleId, fragmentId)];
+    fragmentScore.append(ms);
+    fragmentScore.remove(blankScore);
+    delete ms;
+    worker->entryCount++;
+  }
+  return true;
 }
 
- void VolumeIndex::expandSubjectData(char* compressed, char* expanded, int units)
+ void VolumeIndex::expandSubjectData(const char* compressed, char* expanded, int units)
  {
    int bytePosition=0;
    char one=1;
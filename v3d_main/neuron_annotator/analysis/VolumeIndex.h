@@ -223,6 +223,14 @@ class MaskScore
     this->fragmentNonzeroCount+=m2->fragmentNonzeroCount;
   }
 
+  void remove(const MaskScore* m2) {
+    this->zeroCount-=m2->zeroCount;
+    this->nonzeroCount-=m2->nonzeroCount;
+    this->zeroScore-=m2->zeroScore;
+    this->nonzeroScore-=m2->nonzeroScore;
+    this->fragmentNonzeroCount-=m2->fragmentNonzeroCount;
+  }
+
 };
 
 class SubjectScore
@@ -253,6 +261,7 @@ class FragmentThread
   SubjectScore* score;
 };
 
+// A sample of the primary index. firstStageData points into the mapped primary index during the search.
 class SampleThread
 {
  public:
@@ -265,6 +274,19 @@ class SampleThread
   //  QList< QFuture<FragmentThread*> > fragmentFutureList;
   QMap<long, QList<MaskScore*> > fragmentScoreMap;
 };
+
+// Scores the secondary index cells handed out by cellCursor, see VolumeIndex::runSearchWorker().
+// scoreMap holds for each (sampleId, fragmentId) the entry scores minus the blank subject scores of their cells.
+class SearchWorker
+{
+ public:
+  const QVector<int>* cellList;
+  QAtomicInt* cellCursor;
+  const QHash<long, SampleThread*>* sampleMap;
+  QMap< QPair<long,long>, MaskScore > scoreMap;
+  long entryCount;
+  bool error;
+};
   
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -321,6 +343,7 @@ public:
         usage.append("     -maxHits <max number of hits> [100]                                                                \n");
 	usage.append("     -backgroundWeight <float. 0=ignore 1=same >1=more than mask> [1.0]                                 \n");
 	usage.append("     -maskDilation <int, num cycles. 0=none 1=1, etc> [0]                                               \n");
+	usage.append("     -allSamples   score the samples with no first-stage overlap with the query too                     \n");
         usage.append("                                                                                                        \n");
         return usage;
     }
@@ -337,6 +360,8 @@ private:
     bool DEBUG_FLAG;
     int mode;
 
+    bool allSamples;
+
     QString modeString;
     QString indexSpecificationFilepath;
     QString sampleIndexFilepath;
@@ -426,17 +451,15 @@ private:
 
     QList<SubjectScore*> searchResultList;
     QList<SampleThread*> sampleThreadList;
-    QMap< long, QSet<QString> > fragmentStage1NonzeroSet;
 
-    SampleThread* runSampleThread(SampleThread* sampleThread);
     FragmentThread* runFragmentThread(FragmentThread* fragmentThread);
 
-    QList< QFuture<SampleThread*> > sampleFutureList;
+    bool readPrimaryIndex(const uchar* data, qint64 size, int firstStageIndexBytes);
+    void runSearchWorker(SearchWorker* worker);
+    bool scoreSecondaryIndexCell(int cell, SearchWorker* worker, char* queryData, char* subjectData);
 
-    void addMaskScoreForSecondStageEntry(long fragmentId, SampleThread* sampleThread, char* secondStageData, int dataUnits, int x1, int y1, int z1);
     void computeMaskScore(MaskScore* maskScore);
-    void expandSubjectData(char* compressed, char* expanded, int units);
-    void addSampleResult(SampleThread* st);
+    void expandSubjectData(const char* compressed, char* expanded, int units);
 
     bool displaySearchResults();
     
@@ -22,6 +22,20 @@
 
 using namespace std;
 
+// DataStream of a QIODevice, to read a blocked PBD with ImageLoaderBasic
+class QIODeviceStream : public DataStream
+{
+public:
+    QIODeviceStream(QIODevice& device) : device(device) {}
+    virtual size_t read(void* dst, size_t numBytes) {
+        qint64 nread = device.read((char*)dst, numBytes);
+        return (nread<0) ? 0 : (size_t)nread;
+    }
+
+protected:
+    QIODevice& device;
+};
+
 ImageLoader::ImageLoader()
     : progressIndex(0)
 {
@@ -111,6 +125,30 @@ int ImageLoader::processArgs( vector<char*>* argList )
             }
             while ( !done && i < ( argList->size() - 1 ) );
         }
+        else if ( arg == "-convertblk" )
+        {
+            mode=MODE_CONVERT_BLOCKED;
+            bool haveInput=false;
+            do
+            {
+                QString possibleFile=(*argList)[++i];
+                if ( !possibleFile.startsWith( "-" ) && !haveInput )
+                {
+                    inputFilepath=possibleFile;
+                    haveInput=true;
+                }
+                else if ( !possibleFile.startsWith( "-" ) && haveInput )
+                {
+                    targetFilepath=possibleFile;
+                }
+                else
+                {
+                    done=true;
+                    i--; // rewind
+                }
+            }
+            while ( !done && i < ( argList->size() - 1 ) );
+        }
         else if ( arg == "-convert3" )
         {
             mode=MODE_CONVERT3;
@@ -237,7 +275,7 @@ bool ImageLoader::execute()
         }
         return false;
     }
-    else if ( mode == MODE_CONVERT || mode == MODE_CONVERT8 || mode == MODE_CONVERT3 )
+    else if ( mode == MODE_CONVERT || mode == MODE_CONVERT8 || mode == MODE_CONVERT3 || mode == MODE_CONVERT_BLOCKED )
     {
       qDebug() << "ImageLoader::execute() mode=" << mode;
         if ( inputFilepath.compare( targetFilepath ) == 0 )
@@ -823,6 +861,10 @@ bool ImageLoader::saveImageByMode(My4DImage * stackp, const char* filepath, int
 	  qDebug() << "ImageLoader::saveImageByMode: calling saveStack2RawPBD with datatype = V3D_UNKNOWN";
 	  saveStack2RawPBD(filepath, V3D_UNKNOWN, data, sz);
         }
+        else if ( saveMode == MODE_CONVERT_BLOCKED )
+        {
+          saveStack2RawPBDBlocked(filepath, stackp->getDatatype(), data, sz);
+        }
         else
         {
 	  saveStack2RawPBD(filepath, stackp->getDatatype(), data, sz);
@@ -951,6 +993,20 @@ int ImageLoader::loadRaw2StackPBDFromStream(QIODevice& fileStream, V3DLONG fileS
     stopwatch.start();
     // qDebug() << "ImageLoader::loadRaw2StackPBDFromStream" << filename << stopwatch.elapsed() << __FILE__ << __LINE__;
 
+    // blocked PBD, decoded on threads of its own
+    QByteArray key = fileStream.peek(24);
+    if ( key.size() == 24 && isBlockedPBDKey(key.constData()) )
+    {
+        emit progressMessageChanged("Decompressing image...");
+        QIODeviceStream stream(fileStream);
+        berror = ImageLoaderBasic::loadRaw2StackPBD(stream, fileSize, image, false);
+        if ( berror == 0 )
+        {
+            emit progressComplete(progressIndex);
+        }
+        return berror;
+    }
+
     int datatype;
 
     /*
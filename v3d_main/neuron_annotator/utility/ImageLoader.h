@@ -20,7 +20,7 @@ public:
     ~ImageLoader();
 
     enum Mode { MODE_UNDEFINED, MODE_LOAD_TEST, MODE_CONVERT, MODE_CONVERT8,
-                MODE_MIP, MODE_MAP_CHANNELS, MODE_CONVERT3, MODE_CODECS
+                MODE_MIP, MODE_MAP_CHANNELS, MODE_CONVERT3, MODE_CODECS, MODE_CONVERT_BLOCKED
               };
 
     static string getCommandLineDescription()
@@ -37,6 +37,7 @@ public:
         usage.append("   -convert  <source file>    <target file>                                                             \n");
         usage.append("   -convert8 <source file>    <target file>                                                             \n");
 	usage.append("   -convert3 <source file>    <target file>                                                             \n");
+        usage.append("   -convertblk <source file>  <target file>    blocked v3dpbd, for parallel decoding and slice reads        \n");
         usage.append("   -mip <stack input filepath>  <2D mip tif output filepath> [-flipy]                                   \n");
         usage.append("   -mapchannels <sourcestack> <targetstack> <csv map string, eg, \"0,1,2,0\" maps s0 to t1 and s2 to t0>\n");
         usage.append( "   -codecs <source file> <target file> <channels:CODEC:[\"codec options\"] repeat for each channel(s)., eg, \n" );
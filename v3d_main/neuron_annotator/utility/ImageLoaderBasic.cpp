@@ -7,6 +7,9 @@
 
 #include "ImageLoaderBasic.h"
 #include "../../basic_c_fun/stackutil.h"
+#include "../../basic_c_fun/basic_parallel.h"
+#include <cctype>
+#include <cstring>
 #include <iostream>
 #include <sstream>
 #include <string>
@@ -50,6 +53,7 @@ ImageLoaderBasic::ImageLoaderBasic()
     , compressionPosition(0)
     , decompressionPosition(0)
     , decompressionPrior(0)
+    , numThreads(0)
 {
 }
 
@@ -1287,16 +1291,331 @@ int ImageLoaderBasic::loadRaw2StackPBD(const char* filename, Image4DSimple * ima
     return loadRaw2StackPBD(fileStream, fileSize, image, useThreading);
 }
 
-/* virtual */
-int ImageLoaderBasic::loadRaw2StackPBD(DataStream& fileStream, V3DLONG fileSize, Image4DSimple * image, bool useThreading)
+/*
+
+ Blocked PBD
+
+ Same header as the stream format above, except the format key "v3d_volume_pkbitdf_blkNN" where NN is the
+ version, then
+
+ <block slices>  BIT32, number of z-slices per block
+ <block count>   BIT32, = channels * ceil(z / block slices), the blocks of channel 0 first
+ <offsets>       (block count + 1) * 8 bytes, of each block from the end of the offsets, then the total size
+ <blocks>        each compressed as a whole 8-bit or 16-bit stream of its slices, the prior value starting at 0
+
+ So each block can be encoded and decoded by a thread of its own, and read alone.
+
+*/
+
+static const char PBD_BLOCK_FORMAT_PREFIX[] = "v3d_volume_pkbitdf_blk";
+
+static void swap8bytes(void * targetp)
 {
-    if (useThreading) {
-        cerr << "Error: attempt to use threading with ImageLoaderBasic" << __FILE__ << __LINE__ << endl;
+    unsigned char * p = (unsigned char *)targetp;
+    for (int i=0; i<4; i++)
+        std::swap(p[i], p[7-i]);
+}
+
+// One block of a blocked PBD, encoded when target is 0, else decoded into target
+struct PbdBlockJob
+{
+    PbdBlockJob() : source(0), sourceLength(0), target(0), targetLength(0), ok(false) {}
+
+    unsigned char * source;
+    V3DLONG sourceLength;
+    unsigned char * target;
+    V3DLONG targetLength;
+    std::vector<unsigned char> encoded;
+    bool ok;
+};
+
+// Runs the jobs on a few threads of basic_parallel, as ImageLoaderBasic does not link Qt.
+// Each block has a coder of its own, for the prior value of the decompression.
+class PbdBlockCoder
+{
+public:
+    PbdBlockCoder(const ImageLoaderBasic& owner, int datatype, std::vector<PbdBlockJob>& jobs)
+        : owner(owner), datatype(datatype), jobs(jobs)
+    {}
+
+    // false if a job failed or the load was canceled
+    bool run(int numThreads)
+    {
+        if (numThreads<=0)
+            numThreads = v3d_num_cores();
+
+        // this thread works too, and alone if no thread can be started
+        v3d_parallel_for((V3DLONG)jobs.size(), numThreads, codeJobs, this);
+
+        for (size_t k=0; k<jobs.size(); k++)
+            if (! jobs[k].ok) return false;
+        return true;
     }
 
-    decompressionPrior = 0;
-    int berror = 0;
+protected:
+    static void codeJobs(void* coder, V3DLONG b, V3DLONG e)
+    {
+        PbdBlockCoder* c = (PbdBlockCoder*)coder;
+        for (V3DLONG k=b; k<e && ! c->owner.isCanceled(); k++)
+            c->code(c->jobs[k]);
+    }
+
+    void code(PbdBlockJob& job)
+    {
+        ImageLoaderBasic coder;
+        if (job.target)
+        {
+            V3DLONG dlength = (datatype==1) ? coder.decompressPBD8(job.source, job.target, job.sourceLength)
+                                            : coder.decompressPBD16(job.source, job.target, job.sourceLength);
+            job.ok = (dlength==job.targetLength);
+        }
+        else
+        {
+            // the 2x room of saveStack2RawPBD
+            V3DLONG maxSize = job.sourceLength*2 + 16;
+            job.encoded.resize(maxSize);
+            V3DLONG p = (datatype==1) ? coder.compressPBD8(&job.encoded[0], job.source, job.sourceLength, maxSize)
+                                      : coder.compressPBD16(&job.encoded[0], job.source, job.sourceLength, maxSize);
+            job.ok = (p>0);
+            job.encoded.resize(p);
+            std::vector<unsigned char>(job.encoded).swap(job.encoded);
+        }
+    }
+
+    const ImageLoaderBasic& owner;
+    int datatype;
+    std::vector<PbdBlockJob>& jobs;
+};
+
+
+/* static */
+bool ImageLoaderBasic::isBlockedPBDKey(const char * key, int * version)
+{
+    V3DLONG lenprefix = strlen(PBD_BLOCK_FORMAT_PREFIX);
+    if (strncmp(key, PBD_BLOCK_FORMAT_PREFIX, lenprefix))
+        return false;
+    const char * digits = key + lenprefix;
+    if (strlen(digits)!=2 || !isdigit(digits[0]) || !isdigit(digits[1]))
+        return false;
+    if (version)
+        *version = (digits[0]-'0')*10 + (digits[1]-'0');
+    return true;
+}
 
+/* static */
+bool ImageLoaderBasic::isBlockedPBD(const char * filename)
+{
+    char key[25] = {0};
+    FILE * f = fopen(filename, "rb");
+    if (! f)
+        return false;
+    size_t nread = fread(key, 1, 24, f);
+    fclose(f);
+    return nread==24 && isBlockedPBDKey(key);
+}
+
+// Reads the block index that follows the header of a blocked PBD. offsets has the size of all the blocks last.
+int ImageLoaderBasic::readPBDBlockIndex(DataStream& fileStream, V3DLONG bytesLeft, bool b_swap, const V3DLONG * sz,
+                                        V3DLONG& blockSlices, std::vector<V3DLONG>& offsets)
+{
+    BIT32_UNIT blockHeader[2] = {0, 0};
+    if (bytesLeft<8 || fileStream.read((char*)blockHeader, 8)!=8)
+        return exitWithError("Blocked PBD : the block index is missing.");
+    if (b_swap)
+    {
+        swap4bytes((void *)(blockHeader+0));
+        swap4bytes((void *)(blockHeader+1));
+    }
+    blockSlices = blockHeader[0];
+    V3DLONG blockCount = blockHeader[1];
+    if (blockSlices<=0 || blockCount != sz[3]*((sz[2]+blockSlices-1)/blockSlices))
+    {
+        stringstream msg;
+        msg << "Blocked PBD : " << blockCount << " blocks of " << blockSlices << " slices do not fit the image size.";
+        return exitWithError(msg.str());
+    }
+
+    std::vector<v3d_uint64> index(blockCount+1);
+    V3DLONG indexBytes = (blockCount+1)*8;
+    if (bytesLeft-8<indexBytes || (V3DLONG)fileStream.read((char*)&index[0], indexBytes)!=indexBytes)
+        return exitWithError("Blocked PBD : the block index is truncated.");
+
+    offsets.resize(blockCount+1);
+    for (V3DLONG b=0; b<=blockCount; b++)
+    {
+        if (b_swap)
+            swap8bytes(&index[b]);
+        offsets[b] = (V3DLONG)index[b];
+        if (offsets[b] < (b ? offsets[b-1] : 0))
+            return exitWithError("Blocked PBD : the block index is corrupted.");
+    }
+    if (offsets[blockCount] != bytesLeft-8-indexBytes)
+    {
+        stringstream msg;
+        msg << "Blocked PBD : the blocks have " << bytesLeft-8-indexBytes << " bytes, the index says " << offsets[blockCount] << ".";
+        return exitWithError(msg.str());
+    }
+    return 0;
+}
+
+int ImageLoaderBasic::saveStack2RawPBDBlocked(const char * filename, ImagePixelType datatype, unsigned char* data, const V3DLONG * sz, V3DLONG blockSlices)
+{
+    short int dcode = (short int)datatype;
+    if (!(dcode==1 || dcode==2))
+    {
+        stringstream msg;
+        msg << "Unrecognized data type code = [" << dcode << "]. Blocked PBD supports 8-bit and 16-bit data.";
+        return exitWithError(msg.str());
+    }
+    V3DLONG unitSize = dcode;
+    V3DLONG sliceBytes = sz[0]*sz[1]*unitSize;
+    if (sliceBytes<=0 || sz[2]<=0 || sz[3]<=0)
+        return exitWithError("Blocked PBD : empty image");
+    if (blockSlices<=0)
+        blockSlices = std::max(V3DLONG(1), V3DLONG(1<<20)/sliceBytes);
+    blockSlices = std::min(blockSlices, sz[2]);
+    V3DLONG zBlocks = (sz[2]+blockSlices-1)/blockSlices;
+    V3DLONG blockCount = sz[3]*zBlocks;
+
+    std::vector<PbdBlockJob> jobs(blockCount);
+    for (V3DLONG b=0; b<blockCount; b++)
+    {
+        V3DLONG c = b/zBlocks, z0 = (b%zBlocks)*blockSlices;
+        jobs[b].source = data + (c*sz[2]+z0)*sliceBytes;
+        jobs[b].sourceLength = std::min(blockSlices, sz[2]-z0)*sliceBytes;
+    }
+    PbdBlockCoder coder(*this, dcode, jobs);
+    if (! coder.run(numThreads))
+        return exitWithError("Error during compressPBD");
+
+    std::vector<v3d_uint64> index(blockCount+1, 0);
+    for (V3DLONG b=0; b<blockCount; b++)
+        index[b+1] = index[b] + jobs[b].encoded.size();
+
+    fid = fopen(filename, "wb");
+    if (!fid)
+        return exitWithError("Fail to open file for writing");
+
+    char formatkey[32];
+    sprintf(formatkey, "%s%02d", PBD_BLOCK_FORMAT_PREFIX, PBD_BLOCK_FORMAT_VERSION);
+    char endianCodeMachine = checkMachineEndian();
+    if (endianCodeMachine!='B' && endianCodeMachine!='L')
+        return exitWithError("This program only supports big- or little- endian but not other format. Cannot save data on this machine.");
+    BIT32_UNIT mysz[4];
+    for (int i=0; i<4; i++)
+        mysz[i] = (BIT32_UNIT)sz[i];
+    BIT32_UNIT blockHeader[2] = {(BIT32_UNIT)blockSlices, (BIT32_UNIT)blockCount};
+
+    bool ok = fwrite(formatkey, 1, 24, fid)==24
+           && fwrite(&endianCodeMachine, 1, 1, fid)==1
+           && fwrite(&dcode, 2, 1, fid)==1
+           && fwrite(mysz, 4, 4, fid)==4
+           && fwrite(blockHeader, 4, 2, fid)==2
+           && fwrite(&index[0], 8, blockCount+1, fid)==(size_t)(blockCount+1);
+    for (V3DLONG b=0; ok && b<blockCount; b++)
+        ok = fwrite(&jobs[b].encoded[0], 1, jobs[b].encoded.size(), fid)==jobs[b].encoded.size();
+    if (! ok)
+        return exitWithError("File write error");
+
+    printf("Blocked PBD: %ld blocks of %ld slices, original size=%ld  post-compression size=%ld  ratio=%f\n",
+           (long)blockCount, (long)blockSlices, (long)(sz[3]*sz[2]*sliceBytes), (long)index[blockCount],
+           double(sz[3]*sz[2]*sliceBytes)/index[blockCount]);
+
+    fclose(fid);
+    fid = 0;
+    return 0;
+}
+
+// Only the blocks of slices [z0, z1) are read and decoded, for all the channels
+int ImageLoaderBasic::loadRaw2StackPBDSlices(const char * filename, V3DLONG z0, V3DLONG z1, Image4DSimple * image)
+{
+    fid = fopen(filename, "rb");
+    if (! fid)
+        return exitWithError(std::string("Fail to open file for reading."));
+    fseek(fid, 0, SEEK_END);
+    V3DLONG fileSize = ftell(fid);
+    rewind(fid);
+    FileStarStream fileStream(fid);
+
+    bool b_blocked = false;
+    bool b_swap = false;
+    int datatype = 0;
+    V3DLONG sz[4];
+    int berror = readPBDHeader(fileStream, fileSize, b_blocked, b_swap, datatype, sz);
+    if (berror)
+        return berror;
+    if (! b_blocked)
+        return exitWithError("This PBD file is not blocked, its slices can not be read alone: see saveStack2RawPBDBlocked.");
+    if (z0<0 || z1>sz[2] || z0>=z1)
+    {
+        stringstream msg;
+        msg << "Slices [" << z0 << ", " << z1 << ") are out of the " << sz[2] << " slices of the image.";
+        return exitWithError(msg.str());
+    }
+
+    V3DLONG headerSize = 4*4+2+1+(V3DLONG)keyread.size()-1;
+    V3DLONG blockSlices = 0;
+    std::vector<V3DLONG> offsets;
+    berror = readPBDBlockIndex(fileStream, fileSize-headerSize, b_swap, sz, blockSlices, offsets);
+    if (berror)
+        return berror;
+    V3DLONG dataStart = headerSize + 8 + 8*V3DLONG(offsets.size());
+
+    V3DLONG unitSize = datatype;
+    V3DLONG sliceBytes = sz[0]*sz[1]*unitSize;
+    V3DLONG zBlocks = (sz[2]+blockSlices-1)/blockSlices;
+    V3DLONG b0 = z0/blockSlices, b1 = (z1-1)/blockSlices + 1;
+    V3DLONG zb0 = b0*blockSlices, zb1 = std::min(b1*blockSlices, sz[2]);
+
+    // the blocks of a channel follow each other
+    std::vector<V3DLONG> start(sz[3]);
+    V3DLONG compressedBytes = 0;
+    for (V3DLONG c=0; c<sz[3]; c++)
+    {
+        start[c] = compressedBytes;
+        compressedBytes += offsets[c*zBlocks+b1] - offsets[c*zBlocks+b0];
+    }
+    compressionBuffer.resize(compressedBytes);
+    std::vector<unsigned char> decoded(sz[3]*(zb1-zb0)*sliceBytes);
+
+    std::vector<PbdBlockJob> jobs;
+    for (V3DLONG c=0; c<sz[3]; c++)
+    {
+        V3DLONG first = offsets[c*zBlocks+b0];
+        V3DLONG n = offsets[c*zBlocks+b1] - first;
+        if (n>0 && (fseek(fid, long(dataStart+first), SEEK_SET)!=0 || (V3DLONG)fread(&compressionBuffer[start[c]], 1, n, fid)!=n))
+            return exitWithError(std::string("Something wrong in file reading."));
+        for (V3DLONG b=b0; b<b1; b++)
+        {
+            PbdBlockJob job;
+            job.source = &compressionBuffer[0] + start[c] + offsets[c*zBlocks+b] - first;
+            job.sourceLength = offsets[c*zBlocks+b+1] - offsets[c*zBlocks+b];
+            job.target = &decoded[0] + (c*(zb1-zb0) + b*blockSlices-zb0)*sliceBytes;
+            job.targetLength = (std::min((b+1)*blockSlices, sz[2]) - b*blockSlices)*sliceBytes;
+            jobs.push_back(job);
+        }
+    }
+    fclose(fid);
+    fid = 0;
+
+    PbdBlockCoder coder(*this, datatype, jobs);
+    bool ok = coder.run(numThreads);
+    std::vector<unsigned char>().swap(compressionBuffer);
+    if (isCanceled())
+        return exitWithError(std::string("load canceled"));
+    if (! ok)
+        return exitWithError(std::string("Blocked PBD : corrupted block, the decoded size is not the block size."));
+
+    image->createBlankImage(sz[0], sz[1], z1-z0, sz[3], datatype);
+    for (V3DLONG c=0; c<sz[3]; c++)
+        memcpy(image->getRawData() + c*(z1-z0)*sliceBytes,
+               &decoded[0] + (c*(zb1-zb0) + z0-zb0)*sliceBytes, (z1-z0)*sliceBytes);
+    return 0;
+}
+
+// Reads the header common to the stream and the blocked PBD, up to the sizes
+int ImageLoaderBasic::readPBDHeader(DataStream& fileStream, V3DLONG fileSize, bool& b_blocked, bool& b_swap, int& datatype, V3DLONG * sz)
+{
     /* Read header */
     char formatkey[] = "v3d_volume_pkbitdf_encod";
     V3DLONG lenkey = strlen(formatkey);
@@ -1321,7 +1640,15 @@ int ImageLoaderBasic::loadRaw2StackPBD(DataStream& fileStream, V3DLONG fileSize,
     keyread[lenkey] = '\0';
 
     V3DLONG i;
-    if (strcmp(formatkey, &keyread[0])) /* is non-zero then the two strings are different */
+    int version = 0;
+    b_blocked = isBlockedPBDKey(&keyread[0], &version);
+    if (b_blocked && version > PBD_BLOCK_FORMAT_VERSION)
+    {
+        stringstream msg;
+        msg << "Blocked PBD version " << version << " is not supported in this version, which reads up to version " << PBD_BLOCK_FORMAT_VERSION << ".";
+        return exitWithError(msg.str());
+    }
+    if (strcmp(formatkey, &keyread[0]) && ! b_blocked) /* is non-zero then the two strings are different */
     {
         return exitWithError("Unrecognized file format.");
     }
@@ -1341,7 +1668,7 @@ int ImageLoaderBasic::loadRaw2StackPBD(DataStream& fileStream, V3DLONG fileSize,
         return exitWithError("This program only supports big- or little- endian but not other format. Check your data endian.");
     }
 
-    int b_swap = (endianCodeMachine==endianCodeData)?0:1;
+    b_swap = (endianCodeMachine!=endianCodeData);
 
     short int dcode = 0;
     // fread(&dcode, 2, 1, fid); /* because I have already checked the file size to be bigger than the header, no need to check the number of actual bytes read. */
@@ -1349,8 +1676,6 @@ int ImageLoaderBasic::loadRaw2StackPBD(DataStream& fileStream, V3DLONG fileSize,
     if (b_swap)
         swap2bytes((void *)&dcode);
 
-    int datatype;
-
     switch (dcode)
     {
     case PBD_3_BIT_DTYPE:
@@ -1376,19 +1701,10 @@ int ImageLoaderBasic::loadRaw2StackPBD(DataStream& fileStream, V3DLONG fileSize,
         msg << "The file type is incorrect or this code is not supported in this version.";
         return exitWithError(msg.str());
     }
-
-    // qDebug() << "Setting datatype=" << datatype;
-
-    if (datatype==1 || datatype==PBD_3_BIT_DTYPE) {
-        image->setDatatype(V3D_UINT8);
-    } else if (datatype==2) {
-        image->setDatatype(V3D_UINT16);
-    } else {
-        return exitWithError("ImageLoader::loadRaw2StackPBD : only datatype=1 or datatype=2 supported");
+    if (b_blocked && datatype!=1 && datatype!=2)
+    {
+        return exitWithError("Blocked PBD : only datatype=1 or datatype=2 supported");
     }
-    loadDatatype=image->getDatatype(); // used for threaded loading
-
-    // qDebug() << "Finished setting datatype=" << image->getDatatype();
 
     V3DLONG unitSize = datatype; // temporarily I use the same number, which indicates the number of bytes for each data point (pixel). This can be extended in the future.
 
@@ -1420,25 +1736,70 @@ int ImageLoaderBasic::loadRaw2StackPBD(DataStream& fileStream, V3DLONG fileSize,
         }
     }
 
-    std::vector<V3DLONG> sz(4, 0); // avoid memory leak
-    // V3DLONG * sz = new V3DLONG [4]; // reallocate the memory if the input parameter is non-null. Note that this requests the input is also an NULL point, the same to img.
-
-    V3DLONG totalUnit = 1;
     for (i=0;i<4;i++)
     {
         sz[i] = (V3DLONG)mysz[i];
 	pbd_sz[i]=sz[i];
 	cerr << "Set pbd_sz " << i << " to " << pbd_sz[i] << "\n";
-        totalUnit *= sz[i];
     }
+    return 0;
+}
+
+/* virtual */
+int ImageLoaderBasic::loadRaw2StackPBD(DataStream& fileStream, V3DLONG fileSize, Image4DSimple * image, bool useThreading)
+{
+    if (useThreading) {
+        cerr << "Error: attempt to use threading with ImageLoaderBasic" << __FILE__ << __LINE__ << endl;
+    }
+
+    decompressionPrior = 0;
+    int berror = 0;
+
+    bool b_blocked = false;
+    bool b_swap = false;
+    int datatype = 0;
+    std::vector<V3DLONG> sz(4, 0); // avoid memory leak
+    berror = readPBDHeader(fileStream, fileSize, b_blocked, b_swap, datatype, &sz[0]);
+    if (berror)
+        return berror;
+
+    // qDebug() << "Setting datatype=" << datatype;
+
+    if (datatype==1 || datatype==PBD_3_BIT_DTYPE) {
+        image->setDatatype(V3D_UINT8);
+    } else if (datatype==2) {
+        image->setDatatype(V3D_UINT16);
+    } else {
+        return exitWithError("ImageLoader::loadRaw2StackPBD : only datatype=1 or datatype=2 supported");
+    }
+    loadDatatype=image->getDatatype(); // used for threaded loading
+
+    // qDebug() << "Finished setting datatype=" << image->getDatatype();
+
+    V3DLONG unitSize = datatype; // temporarily I use the same number, which indicates the number of bytes for each data point (pixel). This can be extended in the future.
+
+    V3DLONG totalUnit = 1;
+    for (int i=0;i<4;i++)
+        totalUnit *= sz[i];
 
     //mexPrintf("The input file has a size [%ld bytes], different from what specified in the header [%ld bytes]. Exit.\n", fileSize, totalUnit*unitSize+4*4+2+1+lenkey);
     //mexPrintf("The read sizes are: %ld %ld %ld %ld\n", sz[0], sz[1], sz[2], sz[3]);
 
-    V3DLONG headerSize=4*4+2+1+lenkey;
+    V3DLONG headerSize=4*4+2+1+(V3DLONG)keyread.size()-1;
     V3DLONG compressedBytes=fileSize-headerSize;
     maxDecompressionSize=totalUnit*unitSize;
     channelLength=sz[0]*sz[1]*sz[2];
+
+    V3DLONG blockSlices = 0;
+    std::vector<V3DLONG> offsets;
+    if (b_blocked)
+    {
+        berror = readPBDBlockIndex(fileStream, compressedBytes, b_swap, &sz[0], blockSlices, offsets);
+        if (berror)
+            return berror;
+        compressedBytes = offsets.back();
+    }
+
     compressionBuffer.resize(compressedBytes);
     pbd3_current_channel=0;
 
@@ -1458,6 +1819,49 @@ int ImageLoaderBasic::loadRaw2StackPBD(DataStream& fileStream, V3DLONG fileSize,
     image->createBlankImage(sz[0], sz[1], sz[2], sz[3], blankImageDataType);
     decompressionBuffer = image->getRawData();
 
+    if (b_blocked)
+    {
+        // all the blocks are read, then decoded together
+        while (remainingBytes>0)
+        {
+            if (isCanceled())
+                return exitWithError(std::string("image load canceled"));
+            V3DLONG curReadBytes = (remainingBytes<readStepSizeBytes) ? remainingBytes : readStepSizeBytes;
+            V3DLONG nread = fileStream.read((char*)(&compressionBuffer[0]+totalReadBytes), curReadBytes);
+            if (nread!=curReadBytes)
+            {
+                stringstream msg;
+                msg << "Something wrong in file reading. The program reads [";
+                msg << nread << " data points] but the file says there should be [";
+                msg << curReadBytes << " data points].";
+                return exitWithError(msg.str());
+            }
+            totalReadBytes+=nread;
+            remainingBytes -= nread;
+        }
+
+        std::vector<PbdBlockJob> jobs(offsets.size()-1);
+        V3DLONG sliceBytes = sz[0]*sz[1]*unitSize;
+        V3DLONG zBlocks = (sz[2]+blockSlices-1)/blockSlices;
+        for (V3DLONG b=0; b<(V3DLONG)jobs.size(); b++)
+        {
+            V3DLONG c = b/zBlocks, z0 = (b%zBlocks)*blockSlices;
+            PbdBlockJob& job = jobs[b];
+            job.source = &compressionBuffer[0] + offsets[b];
+            job.sourceLength = offsets[b+1]-offsets[b];
+            job.target = decompressionBuffer + (c*sz[2]+z0)*sliceBytes;
+            job.targetLength = std::min(blockSlices, sz[2]-z0)*sliceBytes;
+        }
+        PbdBlockCoder coder(*this, datatype, jobs);
+        bool ok = coder.run(numThreads);
+        std::vector<unsigned char>().swap(compressionBuffer);
+        if (isCanceled())
+            return exitWithError(std::string("load canceled"));
+        if (! ok)
+            return exitWithError(std::string("Blocked PBD : corrupted block, the decoded size is not the block size."));
+        return berror;
+    }
+
     while (remainingBytes>0)
     {
         // qDebug() << "ImageLoader::loadRaw2StackPBD" << filename << stopwatch.elapsed() << __FILE__ << __LINE__;
@@ -1473,7 +1877,7 @@ int ImageLoaderBasic::loadRaw2StackPBD(DataStream& fileStream, V3DLONG fileSize,
 	V3DLONG bytesToChannelBoundary=(pbd3_current_channel+1)*channelLength - totalReadBytes;
 	curReadBytes = (curReadBytes>bytesToChannelBoundary) ? bytesToChannelBoundary : curReadBytes;
         // nread = fread(&compressionBuffer[0]+totalReadBytes, 1, curReadBytes, fid);
-        nread = fileStream.read((char*)(&compressionBuffer[0]+totalReadBytes), curReadBytes);
+        V3DLONG nread = fileStream.read((char*)(&compressionBuffer[0]+totalReadBytes), curReadBytes);
         totalReadBytes+=nread;
 
 	cerr << "nread=" << nread << " curReadBytes=" << curReadBytes << " bytesToChannelBoundary=" << bytesToChannelBoundary << " totalReadBytes=" << totalReadBytes << "\n";
@@ -16,6 +16,9 @@
 
 static const short int PBD_3_BIT_DTYPE = 33;
 
+// Blocked PBD, see saveStack2RawPBDBlocked: the version is the last two digits of the format key
+static const int PBD_BLOCK_FORMAT_VERSION = 1;
+
 // Abstraction for possibly reading from sources that are not files.
 class DataStream
 {
@@ -24,9 +27,13 @@ public:
 };
 
 
+class PbdBlockCoder;
+
 // Simple implementation of ImageLoader that uses no Qt.
 class ImageLoaderBasic
 {
+    friend class PbdBlockCoder;
+
 public:
     ImageLoaderBasic();
     virtual ~ImageLoaderBasic();
@@ -60,6 +67,14 @@ public:
     int saveStack2RawPBD(const char * filename, ImagePixelType dataType, unsigned char* data, const V3DLONG * sz);
     virtual int loadRaw2StackPBD(DataStream& fileStream, V3DLONG fileSize, Image4DSimple * image, bool useThreading);
     virtual int loadRaw2StackPBD(const char * filename, Image4DSimple * image, bool useThreading);
+    // Blocked PBD: each channel is cut into blocks of z-slices compressed independently, with an index of the blocks,
+    // so the blocks are encoded and decoded on several threads and z-slices [z0, z1) can be read alone.
+    // loadRaw2StackPBD reads both formats. blockSlices=0 picks about 1 MB per block.
+    int saveStack2RawPBDBlocked(const char * filename, ImagePixelType dataType, unsigned char* data, const V3DLONG * sz, V3DLONG blockSlices=0);
+    int loadRaw2StackPBDSlices(const char * filename, V3DLONG z0, V3DLONG z1, Image4DSimple * image);
+    static bool isBlockedPBD(const char * filename);
+    static bool isBlockedPBDKey(const char * key, int * version=0);
+    void setNumThreads(int n) {numThreads = n;} // for the blocked PBD, 0 for all the cores
     V3DLONG decompressPBD8(unsigned char * sourceData, unsigned char * targetData, V3DLONG sourceLength);
     V3DLONG decompressPBD16(unsigned char * sourceData, unsigned char * targetData, V3DLONG sourceLength);
     bool isCanceled() const {return bIsCanceled;}
@@ -87,6 +102,10 @@ protected:
     V3DLONG decompressPBD3(unsigned char * sourceData, unsigned char * targetData, V3DLONG sourceLength);
     int pbd3GetRepeatCountFromBytes(unsigned char keyByte, unsigned char valueByte, unsigned char* repeatValue);
 
+    int readPBDHeader(DataStream& fileStream, V3DLONG fileSize, bool& b_blocked, bool& b_swap, int& datatype, V3DLONG * sz);
+    int readPBDBlockIndex(DataStream& fileStream, V3DLONG bytesLeft, bool b_swap, const V3DLONG * sz,
+                          V3DLONG& blockSlices, std::vector<V3DLONG>& offsets);
+
     volatile bool bIsCanceled;
     FILE * fid;
     V3DLONG totalReadBytes;
@@ -106,6 +125,7 @@ protected:
     unsigned char pbd3_current_min;
     unsigned char pbd3_current_max;
     V3DLONG pbd_sz[4];
+    int numThreads; // for the blocked PBD
 };
 
 
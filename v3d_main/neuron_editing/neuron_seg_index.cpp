@@ -0,0 +1,157 @@
+/*
+ *  neuron_seg_index.cpp
+ *
+ *  see neuron_seg_index.h
+ *
+ */
+
+#include "neuron_seg_index.h"
+#include "neuron_sim_scores.h"
+
+#include <algorithm>
+#include <math.h>
+
+
+#define SEG_LEAF_SIZE  8       // edges per leaf
+#define SEG_SLACK      1e-5    // relative to the coordinates, against the float rounding of dist_pt_to_line_seg
+
+
+struct _SegAxisLess
+{
+	const XYZ* ends;
+	int axis;
+	_SegAxisLess(const XYZ* e, int a) : ends(e), axis(a) {}
+	bool operator()(V3DLONG i, V3DLONG j) const  {return ends[2*i].v[axis]+ends[2*i+1].v[axis] < ends[2*j].v[axis]+ends[2*j+1].v[axis];}
+};
+
+
+NeuronSegmentIndex::NeuronSegmentIndex(const NeuronTree * p_tree)
+{
+	b_first_node = false;
+	scale = 0;
+	if (!p_tree || p_tree->listNeuron.size()<=0)  return;
+
+	const QList<NeuronSWC> & qlist = p_tree->listNeuron;
+	V3DLONG p_tree_sz = qlist.size();
+	first_node = XYZ(qlist.at(0).x, qlist.at(0).y, qlist.at(0).z);
+	b_first_node = true;
+
+	// the same edges as dist_pt_to_swc
+	QHash<int, int> h = generate_neuron_swc_hash(p_tree);
+	ends.reserve(2*p_tree_sz);
+	for (V3DLONG i=0; i<p_tree_sz; i++)
+	{
+		const NeuronSWC & tp1 = qlist.at(i);
+		if (tp1.pn < 0 || tp1.pn >= p_tree_sz)
+			continue;
+		const NeuronSWC & tp2 = qlist.at(h.value(tp1.pn));
+		ends.push_back(XYZ(tp1.x, tp1.y, tp1.z));
+		ends.push_back(XYZ(tp2.x, tp2.y, tp2.z));
+	}
+	for (size_t k=0; k<ends.size(); k++)
+		for (int d=0; d<3; d++)
+			scale = std::max(scale, fabs(double(ends[k].v[d])));
+
+	V3DLONG n = size();
+	order.resize(n);
+	for (V3DLONG i=0; i<n; i++)  order[i] = i;
+	nodes.reserve(4*(n/SEG_LEAF_SIZE +1));
+	if (n>0)  buildNode(0, n);
+}
+
+void NeuronSegmentIndex::boxOfEdges(V3DLONG start, V3DLONG count, float box[6]) const
+{
+	const XYZ & p = ends[2*order[start]];
+	for (int d=0; d<3; d++)  box[d] = box[d+3] = p.v[d];
+	for (V3DLONG k=start; k<start+count; k++)
+		for (int e=0; e<2; e++)
+		{
+			const XYZ & q = ends[2*order[k]+e];
+			for (int d=0; d<3; d++)
+			{
+				if (q.v[d] < box[d])    box[d] = q.v[d];
+				if (q.v[d] > box[d+3])  box[d+3] = q.v[d];
+			}
+		}
+}
+
+V3DLONG NeuronSegmentIndex::buildNode(V3DLONG start, V3DLONG count)
+{
+	V3DLONG id = nodes.size();
+	nodes.push_back(Node());
+	{
+		Node& a = nodes[id];
+		a.left = a.right = -1;
+		a.start = start;
+		a.count = count;
+		boxOfEdges(start, count, a.box);
+	}
+
+	if (count <= SEG_LEAF_SIZE)
+		return id;
+
+	// median split of the edge centers along the longest side
+	const float* box = nodes[id].box;
+	int axis = 0;
+	for (int d=1; d<3; d++)
+		if (box[d+3]-box[d] > box[axis+3]-box[axis])  axis = d;
+	V3DLONG half = count/2;
+	std::nth_element(order.begin()+start, order.begin()+start+half, order.begin()+start+count,
+			_SegAxisLess(&ends[0], axis));
+
+	V3DLONG l = buildNode(start, half);
+	V3DLONG r = buildNode(start+half, count-half);
+	nodes[id].left = l;  // after the recursion, nodes may be reallocated
+	nodes[id].right = r;
+	return id;
+}
+
+static double box_dist(const float box[6], const XYZ & pt)
+{
+	double s = 0;
+	for (int d=0; d<3; d++)
+	{
+		double t = (pt.v[d] < box[d])? box[d]-pt.v[d] : (pt.v[d] > box[d+3])? pt.v[d]-box[d+3] : 0;
+		s += t*t;
+	}
+	return sqrt(s);
+}
+
+double NeuronSegmentIndex::dist_pt(const XYZ & pt) const
+{
+	if (nodes.empty())
+		return (b_first_node)? norm(pt - first_node) : -1;
+
+	// the computed edge distances can be below the exact ones by the float rounding, so a box is
+	// skipped only if its bound exceeds the best distance by more than the slack
+	double slack = SEG_SLACK * (1 + scale + std::max(fabs(pt.x), std::max(fabs(pt.y), fabs(pt.z))));
+
+	double min_dist = -1;
+	V3DLONG stack[128];
+	int top = 0;
+	stack[top++] = 0;
+	while (top > 0)
+	{
+		const Node& a = nodes[stack[--top]];
+		if (min_dist >= 0 && box_dist(a.box, pt) - slack > min_dist)  continue;
+
+		if (a.left < 0)
+		{
+			for (V3DLONG k=a.start; k<a.start+a.count; k++)
+			{
+				V3DLONG i = order[k];
+				double cur_d = dist_pt_to_line_seg(pt, ends[2*i], ends[2*i+1]);
+				if (min_dist < 0 || cur_d < min_dist)  min_dist = cur_d;
+			}
+		}
+		else
+		{
+			// the nearer child is visited first
+			V3DLONG first = a.left, second = a.right;
+			if (box_dist(nodes[second].box, pt) < box_dist(nodes[first].box, pt))  std::swap(first, second);
+			stack[top++] = second;
+			stack[top++] = first;
+		}
+	}
+	return min_dist;
+}
@@ -0,0 +1,50 @@
+/*
+ *  neuron_seg_index.h
+ *
+ *  Bounding volume hierarchy over the edges (parent-child line segments) of a NeuronTree, for the
+ *  distance of a point to the nearest edge of a neuron (same result as dist_pt_to_swc).
+ *
+ *  The index copies the edge end points, so it stays valid if the NeuronTree is changed or deleted,
+ *  but it must be built again to see the changes. Queries are const and can be run from many threads.
+ *
+ */
+
+#ifndef __NEURON_SEG_INDEX_H__
+#define __NEURON_SEG_INDEX_H__
+
+#include "../basic_c_fun/basic_surf_objs.h"
+#include <vector>
+
+class NeuronSegmentIndex
+{
+public:
+	NeuronSegmentIndex(const NeuronTree * p_tree);
+
+	V3DLONG size() const {return V3DLONG(ends.size()/2);} // number of edges
+
+	// distance of pt to the nearest edge, the same value as dist_pt_to_swc(pt, p_tree).
+	// A tree without edges gives the distance to its first node, and -1 if it has no node.
+	double dist_pt(const XYZ & pt) const;
+
+protected:
+	struct Node
+	{
+		float box[6];     // x0,y0,z0, x1,y1,z1
+		V3DLONG left;     // child nodes, -1 for leaf
+		V3DLONG right;
+		V3DLONG start;    // leaf: edges order[start .. start+count)
+		V3DLONG count;
+	};
+
+	V3DLONG buildNode(V3DLONG start, V3DLONG count);
+	void boxOfEdges(V3DLONG start, V3DLONG count, float box[6]) const;
+
+	std::vector<XYZ> ends;          // the two end points of each edge
+	std::vector<V3DLONG> order;     // edge indexes, leaves own contiguous ranges
+	std::vector<Node> nodes;
+	XYZ first_node;
+	bool b_first_node;
+	double scale;                   // largest absolute coordinate, for the rounding slack of the bounds
+};
+
+#endif
@@ -37,8 +37,11 @@ Peng, H, Ruan, Z., Atasoy, D., and Sternson, S. (2010) “Automatic reconstructi
 #include <QInputDialog>
 
 #include "neuron_sim_scores.h"
+#include "neuron_seg_index.h"
 #include "v_neuronswc.h"
 #include <iostream>
+#include <QThread>
+#include <QtConcurrentRun>
 
 V_NeuronSWC get_v_neuron_swc(const NeuronTree *p);
 vector<V_NeuronSWC> get_neuron_segments(const NeuronTree *p);
@@ -47,11 +50,8 @@ void neuron_branch_tip_count(V3DLONG &n_branch, V3DLONG &n_tip, const V_NeuronSW
 
 double d_thres = 2.0;
 
-//round all neuronal node coordinates, and compute the average min distance matches for all places the neurons go through
-NeuronDistSimple neuron_score_rounding_nearest_neighbor(const NeuronTree *p1, const NeuronTree *p2,bool bmenu, double d_thres_updated)
+static void update_dist_thres(bool bmenu, double d_thres_updated)
 {
-	NeuronDistSimple ss;
-
     //===
     if(bmenu)
     {
@@ -71,6 +71,19 @@ NeuronDistSimple neuron_score_rounding_nearest_neighbor(const NeuronTree *p1, co
     }else
         d_thres = d_thres_updated;
     //===
+}
+
+static void resample_swc_edges(vector<XYZ> & pts, const NeuronTree *p);
+static double dist_directional_pts_1_2(V3DLONG & nseg1, V3DLONG & nseg1big, double & sum1big, const vector<XYZ> & pts1, const NeuronSegmentIndex & index2, double & maxdist);
+static NeuronDistSimple neuron_dist_simple(double sum12, V3DLONG nseg1, double sum12big, V3DLONG nseg1big, double maxdist12,
+                                           double sum21, V3DLONG nseg2, double sum21big, V3DLONG nseg2big, double maxdist21);
+
+//round all neuronal node coordinates, and compute the average min distance matches for all places the neurons go through
+NeuronDistSimple neuron_score_rounding_nearest_neighbor(const NeuronTree *p1, const NeuronTree *p2,bool bmenu, double d_thres_updated)
+{
+	NeuronDistSimple ss;
+
+    update_dist_thres(bmenu, d_thres_updated);
 
 
 	if (!p1 || !p2) return ss;
@@ -80,18 +93,76 @@ NeuronDistSimple neuron_score_rounding_nearest_neighbor(const NeuronTree *p1, co
         return ss; //requires two nodes at least
      }
 
+    //each tree is indexed and resampled once for both directions
+    NeuronSegmentIndex index1(p1), index2(p2);
+    vector<XYZ> pts1, pts2;
+    resample_swc_edges(pts1, p1);
+    resample_swc_edges(pts2, p2);
+
 	double sum12, sum21;
 	V3DLONG nseg1, nseg2;
 	double sum12big, sum21big;
     double maxdist12 = -1, maxdist21 = -1; //set as some big numbers
 	V3DLONG nseg1big, nseg2big;
-    sum12 = dist_directional_swc_1_2(nseg1, nseg1big, sum12big, p1, p2, maxdist12);
-    sum21 = dist_directional_swc_1_2(nseg2, nseg2big, sum21big, p2, p1, maxdist21);
+    sum12 = dist_directional_pts_1_2(nseg1, nseg1big, sum12big, pts1, index2, maxdist12);
+    sum21 = dist_directional_pts_1_2(nseg2, nseg2big, sum21big, pts2, index1, maxdist21);
 
     //qDebug() << "sum12="<<sum12 << "npoints1="<< nseg1 << "sum21="<< sum21 << "npoint2="<< nseg2;
     //qDebug() << "sum12big="<<sum12big << "npoints1big="<< nseg1big << "sum21big="<< sum21big << "npoint2big="<< nseg2big;
     //qDebug() << "maxdist12="<<maxdist12 << "maxdist21="<< maxdist21;
 
+    return neuron_dist_simple(sum12, nseg1, sum12big, nseg1big, maxdist12, sum21, nseg2, sum21big, nseg2big, maxdist21);
+}
+
+//score p1 against each tree of the list, with the same scores as neuron_score_rounding_nearest_neighbor(p1, &trees.at(i), ...),
+//but the threshold is asked only once. p1 is indexed and resampled only once, and the distances are computed on all cores
+QList<NeuronDistSimple> neuron_score_rounding_nearest_neighbor_batch(const NeuronTree *p1, const QList<NeuronTree> & trees, bool bmenu, double d_thres_updated)
+{
+    update_dist_thres(bmenu, d_thres_updated);
+
+    QList<NeuronDistSimple> ss_list;
+    for (V3DLONG i=0; i<trees.size(); i++)
+        ss_list.append(NeuronDistSimple());
+    if (!p1 || p1->listNeuron.size()<2)
+    {
+        cout<<"Input neurons has too few nodes, distance calculation requires at least two nodes." <<endl;
+        return ss_list;
+    }
+
+    NeuronSegmentIndex index1(p1);
+    vector<XYZ> pts1;
+    resample_swc_edges(pts1, p1);
+
+    for (V3DLONG i=0; i<trees.size(); i++)
+    {
+        const NeuronTree *p2 = &(trees.at(i));
+        if (p2->listNeuron.size()<2)
+        {
+            cout<<"Input neurons has too few nodes, distance calculation requires at least two nodes." <<endl;
+            continue;
+        }
+
+        NeuronSegmentIndex index2(p2);
+        vector<XYZ> pts2;
+        resample_swc_edges(pts2, p2);
+
+        double sum12, sum21;
+        V3DLONG nseg1, nseg2;
+        double sum12big, sum21big;
+        double maxdist12 = -1, maxdist21 = -1;
+        V3DLONG nseg1big, nseg2big;
+        sum12 = dist_directional_pts_1_2(nseg1, nseg1big, sum12big, pts1, index2, maxdist12);
+        sum21 = dist_directional_pts_1_2(nseg2, nseg2big, sum21big, pts2, index1, maxdist21);
+
+        ss_list[i] = neuron_dist_simple(sum12, nseg1, sum12big, nseg1big, maxdist12, sum21, nseg2, sum21big, nseg2big, maxdist21);
+    }
+    return ss_list;
+}
+
+static NeuronDistSimple neuron_dist_simple(double sum12, V3DLONG nseg1, double sum12big, V3DLONG nseg1big, double maxdist12,
+                                           double sum21, V3DLONG nseg2, double sum21big, V3DLONG nseg2big, double maxdist21)
+{
+	NeuronDistSimple ss;
 
     ss.dist_12_allnodes = sum12/nseg1;
     ss.dist_21_allnodes = sum21/nseg2;
@@ -130,15 +201,23 @@ double dist_directional_swc_1_2(V3DLONG & nseg1, V3DLONG & nseg1big, double & su
 	V3DLONG p1sz = p1->listNeuron.size(), p2sz = p2->listNeuron.size();
 	if (p1sz<2 || p2sz<2) return -1;
 
+	vector<XYZ> pts1;
+	resample_swc_edges(pts1, p1);
+	NeuronSegmentIndex index2(p2); //built once for all the points, instead of scanning all edges of p2 for each of them
+
+	return dist_directional_pts_1_2(nseg1, nseg1big, sum1big, pts1, index2, maxdist);
+}
+
+//produce a series of points for each line seg of the neuron, about one per pixel
+static void resample_swc_edges(vector<XYZ> & pts, const NeuronTree *p1)
+{
 	NeuronSWC *tp1, *tp2;
 	V3DLONG i, j;
-	double sum1=0;
-	nseg1=0;
-	nseg1big=0;
-	sum1big=0;
+	V3DLONG p1sz = p1->listNeuron.size();
 
 	QHash<int, int> h1 = generate_neuron_swc_hash(p1); //generate a hash lookup table from a neuron swc graph
 
+	pts.clear();
 	for (i=0;i<p1->listNeuron.size();i++)
 	{
 		//first find the two ends of a line seg
@@ -164,27 +243,56 @@ double dist_directional_swc_1_2(V3DLONG & nseg1, V3DLONG & nseg1big, double & su
 		}
         //qDebug() << "N="<<N << "len=" <<len << "xd="<<ptdiff.x << " yd=" << ptdiff.y << " zd=" << ptdiff.z << " ";
 		for (j=0;j<N;j++)
+			pts.push_back(XYZ(tp1->x + ptdiff.x*j, tp1->y + ptdiff.y*j, tp1->z + ptdiff.z*j));
+	}
+}
+
+static void dist_pts_to_index_range(const vector<XYZ> * pts, const NeuronSegmentIndex * index, vector<double> * dist, V3DLONG start, V3DLONG end)
+{
+	for (V3DLONG i=start; i<end; i++)
+		(*dist)[i] = index->dist_pt(pts->at(i));
+}
+
+static double dist_directional_pts_1_2(V3DLONG & nseg1, V3DLONG & nseg1big, double & sum1big, const vector<XYZ> & pts1, const NeuronSegmentIndex & index2, double & maxdist)
+{
+	V3DLONG i;
+	double sum1=0;
+	nseg1=0;
+	nseg1big=0;
+	sum1big=0;
+
+	//the distances are computed on all cores, then summed in the order of the points so the scores do not depend on the threads
+	V3DLONG npts = pts1.size();
+	vector<double> dist(npts);
+	int workerCount = QThread::idealThreadCount();
+	if (workerCount > npts/1024)  workerCount = int(npts/1024);
+	if (workerCount < 1)  workerCount = 1;
+	QList< QFuture<void> > workerFutureList;
+	for (int w=1; w<workerCount; w++)
+		workerFutureList.append(QtConcurrent::run(dist_pts_to_index_range, &pts1, &index2, &dist, npts*w/workerCount, npts*(w+1)/workerCount));
+	dist_pts_to_index_range(&pts1, &index2, &dist, 0, npts/workerCount);
+	for (int w=0; w<workerFutureList.size(); w++)
+		workerFutureList[w].waitForFinished();
+
+	for (i=0;i<npts;i++)
+	{
+		double cur_d = dist[i];
+		sum1 += cur_d;
+		nseg1++;
+
+		if (maxdist<0) //use <0 as a condition to check if maxdist has been set
+			maxdist = cur_d;
+		else
 		{
-			XYZ curpt(tp1->x + ptdiff.x*j, tp1->y + ptdiff.y*j, tp1->z + ptdiff.z*j);
-			double cur_d = dist_pt_to_swc(curpt, p2);
-			sum1 += cur_d;
-			nseg1++;
-
-            if (maxdist<0) //use <0 as a condition to check if maxdist has been set
-                maxdist = cur_d;
-            else
-            {
-                if (maxdist<cur_d)
-                    maxdist = cur_d;
-            }
-
-            if (cur_d>=d_thres)
-			{
-				sum1big += cur_d;
-				nseg1big++;
-                //qDebug() << "(" << cur_d << ", " << nseg1big << ")";
-			}
+			if (maxdist<cur_d)
+				maxdist = cur_d;
+		}
 
+		if (cur_d>=d_thres)
+		{
+			sum1big += cur_d;
+			nseg1big++;
+			//qDebug() << "(" << cur_d << ", " << nseg1big << ")";
 		}
 	}
     //qDebug() << "end directional neuronal distance computing";
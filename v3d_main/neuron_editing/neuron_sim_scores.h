@@ -54,8 +54,10 @@ struct NeuronDistSimple
 
 //round all neuronal node coordinates, and compute the average min distance matches for all places the neurons go through
 NeuronDistSimple neuron_score_rounding_nearest_neighbor(const NeuronTree *p1, const NeuronTree *p2, bool menu, double d_thres_updated = 2.0);
+//the same scores of p1 against each neuron of a list, indexing and resampling p1 only once and computing the distances on all cores
+QList<NeuronDistSimple> neuron_score_rounding_nearest_neighbor_batch(const NeuronTree *p1, const QList<NeuronTree> & trees, bool menu, double d_thres_updated = 2.0);
 double dist_directional_swc_1_2(V3DLONG & nseg1, V3DLONG & nseg1big, double & sum1big, const NeuronTree *p1, const NeuronTree *p2, double &maxdist);
-double dist_pt_to_swc(const XYZ & pt, const NeuronTree * p2);
+double dist_pt_to_swc(const XYZ & pt, const NeuronTree * p2); //scans all edges of p2, see NeuronSegmentIndex for many points
 double dist_pt_to_line(const XYZ & p0, const XYZ &  p1, const XYZ &  p2); //p1 and p2 define a straight line, and p0 the point
 double dist_pt_to_line_seg(const XYZ & p0, const XYZ &  p1, const XYZ &  p2); //p1 and p2 are the two ends of the line segment, and p0 the point
 
@@ -79,6 +79,7 @@ void CSettings::loadDefaultSettings()
     annotationVirtualMargin = 20;
     annotationMarkerSize = 20;
     previewMode = true;
+    voiLoadThreads = 2;
     pyramidResamplingFactor = 2;
     viewerHeight = qApp->desktop()->availableGeometry().height();
     viewerWidth = qApp->desktop()->availableGeometry().width()-380;
@@ -92,6 +93,9 @@ void CSettings::loadDefaultSettings()
     vpRefillAuto = true;
     vpRefillCoverage = 10;
     vpRefillStopCondition = 0;
+    vpRefillThreads = std::max(1, QThread::idealThreadCount());
+    vpRefillParallelIO = false;
+    vpPrefetch = true;
 
     //TeraConverter settings
     volumeConverterInputPathLRU = "";
@@ -140,6 +144,7 @@ void CSettings::writeSettings()
     settings.setValue("annotationVirtualMargin", annotationVirtualMargin);
     settings.setValue("annotationMarkerSize", annotationMarkerSize);
     settings.setValue("previewMode", previewMode);
+    settings.setValue("voiLoadThreads", voiLoadThreads);
     settings.setValue("pyramidResamplingFactor", pyramidResamplingFactor);
     settings.setValue("viewerHeight", viewerHeight);
     settings.setValue("viewerWidth", viewerWidth);
@@ -153,6 +158,9 @@ void CSettings::writeSettings()
     settings.setValue("vpRefillAuto", vpRefillAuto);
     settings.setValue("vpRefillCoverage", vpRefillCoverage);
     settings.setValue("vpRefillStopCondition", vpRefillStopCondition);
+    settings.setValue("vpRefillThreads", vpRefillThreads);
+    settings.setValue("vpRefillParallelIO", vpRefillParallelIO);
+    settings.setValue("vpPrefetch", vpPrefetch);
 
     settings.setValue("volumeConverterInputPathLRU", QString(volumeConverterInputPathLRU.c_str()));
     settings.setValue("volumeConverterOutputPathLRU", QString(volumeConverterOutputPathLRU.c_str()));
@@ -209,6 +217,8 @@ void CSettings::readSettings()
         annotationMarkerSize = settings.value("annotationMarkerSize").toInt();
     if(settings.contains("previewMode"))
         previewMode = settings.value("previewMode").toBool();
+    if(settings.contains("voiLoadThreads"))
+        voiLoadThreads = settings.value("voiLoadThreads").toInt();
     if(settings.contains("pyramidResamplingFactor"))
         pyramidResamplingFactor = settings.value("pyramidResamplingFactor").toInt();
     if(settings.contains("viewerHeight"))
@@ -235,6 +245,12 @@ void CSettings::readSettings()
         vpRefillCoverage = settings.value("vpRefillCoverage").toInt();
     if(settings.contains("vpRefillStopCondition"))
         vpRefillStopCondition = settings.value("vpRefillStopCondition").toInt();
+    if(settings.contains("vpRefillThreads"))
+        vpRefillThreads = settings.value("vpRefillThreads").toInt();
+    if(settings.contains("vpRefillParallelIO"))
+        vpRefillParallelIO = settings.value("vpRefillParallelIO").toBool();
+    if(settings.contains("vpPrefetch"))
+        vpPrefetch = settings.value("vpPrefetch").toBool();
 
 
 
@@ -68,6 +68,7 @@ class terafly::CSettings
         int annotationVirtualMargin;
         int annotationMarkerSize;
         bool previewMode;
+        int voiLoadThreads;     //number of I/O workers serving VOI load requests (see CVolume)
         int pyramidResamplingFactor;
         int viewerHeight;
         int viewerWidth;
@@ -81,6 +82,9 @@ class terafly::CSettings
         bool vpRefillAuto;
         int vpRefillCoverage;
         int vpRefillStopCondition;
+        int vpRefillThreads;
+        bool vpRefillParallelIO;
+        bool vpPrefetch;
 
         //TeraConverter members
         std::string volumeConverterInputPathLRU;
@@ -125,6 +129,7 @@ class terafly::CSettings
         int getAnnotationVirtualMargin(){return annotationVirtualMargin;}
         int getAnnotationMarkerSize(){return annotationMarkerSize;}
         bool getPreviewMode(){return previewMode;}
+        int getVoiLoadThreads(){return voiLoadThreads;}
         int getPyramidResamplingFactor(){return pyramidResamplingFactor;}
         int getViewerHeight(){return viewerHeight;}
         int getViewerWidth(){return viewerWidth;}
@@ -138,6 +143,9 @@ class terafly::CSettings
         int getVpRefillAuto(){return vpRefillAuto;}
         int getVpRefillCoverage(){return vpRefillCoverage;}
         int getVpRefillStopCondition(){return vpRefillStopCondition;}
+        int getVpRefillThreads(){return vpRefillThreads;}
+        bool getVpRefillParallelIO(){return vpRefillParallelIO;}
+        bool getVpPrefetch(){return vpPrefetch;}
 
 
 
@@ -176,6 +184,7 @@ class terafly::CSettings
         void setAnnotationVirtualMargin(int newval){annotationVirtualMargin = newval; writeSettings();}
         void setAnnotationMarkerSize(int newval){annotationMarkerSize = newval; writeSettings();}
         void setPreviewMode(bool newval){previewMode = newval; writeSettings();}
+        void setVoiLoadThreads(int newval){voiLoadThreads = newval; writeSettings();}
         void setPyramidResamplingFactor(int newval){pyramidResamplingFactor = newval; writeSettings();}
         void setViewerHeight(int newval){viewerHeight = newval; writeSettings();}
         void setViewerWidth(int newval){viewerWidth = newval; writeSettings();}
@@ -189,6 +198,9 @@ class terafly::CSettings
         void setVpRefillAuto(bool newval){vpRefillAuto = newval; writeSettings();}
         void setVpRefillCoverage(int newval){vpRefillCoverage = newval; writeSettings();}
         void setVpRefillStopCondition(int newval){vpRefillStopCondition = newval; writeSettings();}
+        void setVpRefillThreads(int newval){vpRefillThreads = newval; writeSettings();}
+        void setVpRefillParallelIO(bool newval){vpRefillParallelIO = newval; writeSettings();}
+        void setVpPrefetch(bool newval){vpPrefetch = newval; writeSettings();}
 
 
 
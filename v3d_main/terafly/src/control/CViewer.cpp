@@ -61,6 +61,8 @@ CViewer* CViewer::current = 0;
 int CViewer::nInstances = 0;
 int CViewer::nTotalInstances = 0;
 int CViewer::newViewerOperationID = 0;
+tf::xyz<float> CViewer::prefetchLastCenter = tf::xyz<float>(-1);
+int CViewer::prefetchLastResIndex = -1;
 
 void CViewer::show()
 { 
@@ -738,7 +740,9 @@ void CViewer::receiveData(
         tf::RuntimeException* ex /* = 0*/,             // exception (optional)
         qint64 elapsed_time       /* = 0 */,            // elapsed time (optional)
         QString op_dsc            /* = ""*/,            // operation descriptor (optional)
-        int step                  /* = 0 */)            // step number (optional)
+        int step                  /* = 0 */,            // step number (optional)
+        int request               /* = -1 */,           // request identifier (-1 if data were not sent by <CVolume>)
+        int streaming_steps       /* = 0 */)            // number of streaming steps of the request
 {
     /**/tf::debug(tf::LEV1, strprintf("title = %s, data_s = {%s}, data_c = {%s}, finished = %s",
                                         titleShort.c_str(),
@@ -749,6 +753,14 @@ void CViewer::receiveData(
     char message[1000];
     CVolume* cVolume = CVolume::instance();
 
+    // data (or errors) of a request that has been superseded or cancelled after sending them are stale
+    if(dest == this && request >= 0 && !cVolume->isCurrent(request, this))
+    {
+        /**/tf::debug(tf::LEV1, strprintf("title = %s: discarded data of stale request %d", titleShort.c_str(), request).c_str(), __itm__current__function__);
+        delete[] data;
+        return;
+    }
+
     //if an exception has occurred, showing a message error
     if(ex)
         QMessageBox::critical(this,QObject::tr("Error"), QObject::tr(ex->what()),QObject::tr("Ok"));
@@ -758,8 +770,14 @@ void CViewer::receiveData(
         {
             QElapsedTimer timer;
 
+            // loaded block, as sent by the request
+            std::string block;
+            if(data_s.size() == 5 && data_c.size() == 5)
+                block = strprintf("X=[%d, %d) Y=[%d, %d) Z=[%d, %d) T=[%d, %d]", data_s[0], data_s[0]+data_c[0], data_s[1], data_s[1]+data_c[1],
+                                  data_s[2], data_s[2]+data_c[2], data_s[4], data_s[4]+data_c[4]-1);
+
             // PREVIEW+STREAMING mode only: copy loaded data
-            if(data && cVolume->getStreamingSteps() != 0)
+            if(data && streaming_steps != 0)
             {
                 // update IO time
                 PLog::instance()->appendOperation(new NewViewerOperation(op_dsc.toStdString(), tf::IO, elapsed_time));
@@ -779,9 +797,8 @@ void CViewer::receiveData(
                 delete[] data;
 
                 // update log
-                sprintf(message, "Streaming %d/%d: Copied block X=[%d, %d) Y=[%d, %d) Z=[%d, %d) T=[%d, %d]  to resolution %d",
-                                  step, cVolume->getStreamingSteps(), cVolume->getVoiH0(), cVolume->getVoiH1(), cVolume->getVoiV0(), cVolume->getVoiV1(),
-                                  cVolume->getVoiD0(), cVolume->getVoiD1(), cVolume->getVoiT0(), cVolume->getVoiT1(), cVolume->getVoiResIndex());
+                sprintf(message, "Streaming %d/%d: Copied block %s  to resolution %d",
+                                  step, streaming_steps, block.c_str(), volResIndex);
                 PLog::instance()->appendOperation(new NewViewerOperation(message, tf::CPU, elapsedTime));
             }
 
@@ -791,16 +808,13 @@ void CViewer::receiveData(
             PMain::getInstance()->frameCoord->setText(strprintf("t = %d/%d", window3D->timeSlider->value()+1, CImport::instance()->getTDim()).c_str());
 
             // PREVIEW+STREAMING mode only: update image data
-            if(cVolume->getStreamingSteps() != 0)
+            if(streaming_steps != 0)
             {
                 /**/tf::debug(tf::LEV1, strprintf("title = %s: update image data", titleShort.c_str()).c_str(), __itm__current__function__);
                 timer.restart();
                 view3DWidget->updateImageData();
-                sprintf(message, "Streaming %d/%d: Block X=[%d, %d) Y=[%d, %d) Z=[%d, %d) T=[%d, %d] rendered into view %s",
-                        step, cVolume->getStreamingSteps(), cVolume->getVoiH0(), cVolume->getVoiH1(),
-                        cVolume->getVoiV0(), cVolume->getVoiV1(),
-                        cVolume->getVoiD0(), cVolume->getVoiD1(),
-                        cVolume->getVoiT0(), cVolume->getVoiT1(), title.c_str());
+                sprintf(message, "Streaming %d/%d: Block %s rendered into view %s",
+                        step, streaming_steps, block.c_str(), title.c_str());
                 PLog::instance()->appendOperation(new NewViewerOperation(message, tf::GPU, timer.elapsed()));
             }
 
@@ -808,7 +822,7 @@ void CViewer::receiveData(
             if(finished)
             {
                 // disconnect from data producer
-                disconnect(CVolume::instance(), SIGNAL(sendData(tf::uint8*,tf::integer_array,tf::integer_array,QWidget*,bool,tf::RuntimeException*,qint64,QString,int)), this, SLOT(receiveData(tf::uint8*,tf::integer_array,tf::integer_array,QWidget*,bool,tf::RuntimeException*,qint64,QString,int)));
+                disconnect(CVolume::instance(), SIGNAL(sendData(tf::uint8*,tf::integer_array,tf::integer_array,QWidget*,bool,tf::RuntimeException*,qint64,QString,int,int,int)), this, SLOT(receiveData(tf::uint8*,tf::integer_array,tf::integer_array,QWidget*,bool,tf::RuntimeException*,qint64,QString,int,int,int)));
 
                 // reset TeraFly's GUI
                 PMain::getInstance()->resetGUI();
@@ -841,6 +855,9 @@ void CViewer::receiveData(
                 //current window is now ready for user input
                 _isReady = true;
 
+                //loading neighboring VOIs in background while the user explores the current one
+                prefetch();
+
                 //saving elapsed time to log
                 if(prev)
                 {
@@ -1100,7 +1117,7 @@ CViewer::newViewer(int x, int y, int z,             //can be either the VOI's ce
 
             // connect new window to data producer
             cVolume->setSource(next);
-            connect(CVolume::instance(), SIGNAL(sendData(tf::uint8*,tf::integer_array,tf::integer_array,QWidget*,bool,tf::RuntimeException*,qint64,QString,int)), next, SLOT(receiveData(tf::uint8*,tf::integer_array,tf::integer_array,QWidget*,bool,tf::RuntimeException*,qint64,QString,int)), Qt::QueuedConnection);
+            connect(CVolume::instance(), SIGNAL(sendData(tf::uint8*,tf::integer_array,tf::integer_array,QWidget*,bool,tf::RuntimeException*,qint64,QString,int,int,int)), next, SLOT(receiveData(tf::uint8*,tf::integer_array,tf::integer_array,QWidget*,bool,tf::RuntimeException*,qint64,QString,int,int,int)), Qt::QueuedConnection);
 
 // lock updateGraphicsInProgress mutex on this thread (i.e. the GUI thread or main queue event thread)
 /**/tf::debug(tf::LEV3, strprintf("Waiting for updateGraphicsInProgress mutex").c_str(), __itm__current__function__);
@@ -2062,6 +2079,9 @@ void CViewer::restoreViewerFrom(CViewer* source) throw (RuntimeException)
         //current windows now gets ready to user input
         _isReady = true;
 
+        //loading neighboring VOIs in background while the user explores the current one
+        prefetch();
+
         // zoom-out on Virtual Pyramid requires image refresh
         if(source->volResIndex > volResIndex && CImport::instance()->isVirtualPyramid())
             refresh();
@@ -2623,7 +2643,7 @@ void CViewer::refresh() throw (tf::RuntimeException)
     cVolume->setVoi(this, volResIndex, volV0, volV1, volH0, volH1, volD0, volD1, volT0, volT1);
     cVolume->setSource(this);
     cVolume->setStreamingSteps(1);
-    connect(CVolume::instance(), SIGNAL(sendData(tf::uint8*,tf::integer_array,tf::integer_array,QWidget*,bool,tf::RuntimeException*,qint64,QString,int)), this, SLOT(receiveData(tf::uint8*,tf::integer_array,tf::integer_array,QWidget*,bool,tf::RuntimeException*,qint64,QString,int)), Qt::QueuedConnection);
+    connect(CVolume::instance(), SIGNAL(sendData(tf::uint8*,tf::integer_array,tf::integer_array,QWidget*,bool,tf::RuntimeException*,qint64,QString,int,int,int)), this, SLOT(receiveData(tf::uint8*,tf::integer_array,tf::integer_array,QWidget*,bool,tf::RuntimeException*,qint64,QString,int,int,int)), Qt::QueuedConnection);
 
     // update status bar message
     PMain::getInstance()->statusBar->showMessage("Loading image data...");
@@ -2635,3 +2655,73 @@ void CViewer::refresh() throw (tf::RuntimeException)
     //this->setWaitingForData(true);
 }
 
+/**********************************************************************************
+* Speculatively loads the 6 face-adjacent VOIs and the current VOI at the next hi-
+* gher resolution into the Virtual Pyramid cache (if any). Loads are prioritized
+* according to the most recent navigation direction.
+***********************************************************************************/
+void CViewer::prefetch()
+{
+    /**/tf::debug(tf::LEV1, strprintf("title = %s", titleShort.c_str()).c_str(), __itm__current__function__);
+
+    // prefetch is available on Virtual Pyramid only (which provides the cache)
+    if(!CImport::instance()->isVirtualPyramid() || !CSettings::instance()->getVpPrefetch())
+        return;
+    tf::VirtualPyramid* vp = CImport::instance()->getVirtualPyramid();
+    if(!vp)
+        return;
+
+    // pending prefetch jobs refer to the previous viewpoint and are no longer needed
+    vp->prefetchCancel();
+
+    // current VOI, image dimensions and pyramid level
+    iim::VirtualVolume* vol = CImport::instance()->getVolume(volResIndex);
+    int level = CImport::instance()->getResolutions() - 1 - volResIndex;
+    int voi0[3] = {volH0, volV0, volD0};
+    int voi1[3] = {volH1, volV1, volD1};
+    int dims[3] = {vol->getDIM_H(), vol->getDIM_V(), vol->getDIM_D()};
+
+    // navigation direction = displacement of the (normalized) VOI center w.r.t. the previous viewpoint
+    float center[3], dir[3], dir_norm = 0;
+    for(int i=0; i<3; i++)
+        center[i] = (voi0[i]+voi1[i])/(2.0f*dims[i]);
+    dir[0] = center[0] - prefetchLastCenter.x;
+    dir[1] = center[1] - prefetchLastCenter.y;
+    dir[2] = center[2] - prefetchLastCenter.z;
+    bool zoomed_in  = prefetchLastResIndex != -1 && volResIndex > prefetchLastResIndex;
+    bool zoomed_out = prefetchLastResIndex != -1 && volResIndex < prefetchLastResIndex;
+    if(prefetchLastResIndex == -1 || volResIndex != prefetchLastResIndex)
+        dir[0] = dir[1] = dir[2] = 0;
+    for(int i=0; i<3; i++)
+        dir_norm += dir[i]*dir[i];
+    dir_norm = std::sqrt(dir_norm);
+    prefetchLastCenter = tf::xyz<float>(center[0], center[1], center[2]);
+    prefetchLastResIndex = volResIndex;
+
+    // 6 face-adjacent VOIs: priority is proportional to the alignment with the navigation direction
+    for(int axis=0; axis<3; axis++)
+        for(int sign=-1; sign<=1; sign+=2)
+        {
+            int start[3] = {voi0[0], voi0[1], voi0[2]};
+            int end[3]   = {voi1[0], voi1[1], voi1[2]};
+            int size = voi1[axis] - voi0[axis];
+            start[axis] = std::max(0, sign < 0 ? voi0[axis] - size : voi1[axis]);
+            end[axis]   = std::min(dims[axis], sign < 0 ? voi0[axis] : voi1[axis] + size);
+            if(start[axis] >= end[axis])
+                continue;
+
+            int priority = dir_norm > 0 ? static_cast<int>(100*sign*dir[axis]/dir_norm) : 0;
+            vp->prefetch(tf::xyz<size_t>(start[0], start[1], start[2]), tf::xyz<size_t>(end[0], end[1], end[2]), level, priority);
+        }
+
+    // current VOI at the next higher resolution: highest priority after a zoom-in, lowest after a zoom-out
+    if(volResIndex + 1 < CImport::instance()->getResolutions())
+    {
+        iim::VirtualVolume* vol_hr = CImport::instance()->getVolume(volResIndex + 1);
+        float ratio[3] = {vol_hr->getDIM_H()/float(dims[0]), vol_hr->getDIM_V()/float(dims[1]), vol_hr->getDIM_D()/float(dims[2])};
+        int priority = zoomed_in ? 100 : (zoomed_out ? -100 : 0);
+        vp->prefetch(tf::xyz<size_t>(voi0[0]*ratio[0], voi0[1]*ratio[1], voi0[2]*ratio[2]),
+                     tf::xyz<size_t>(voi1[0]*ratio[0] + 0.5f, voi1[1]*ratio[1] + 0.5f, voi1[2]*ratio[2] + 0.5f), level - 1, priority);
+    }
+}
+
@@ -99,6 +99,10 @@ class terafly::CViewer : public QWidget
         QElapsedTimer newViewerTimer;
         static int newViewerOperationID;
 
+        //PREFETCH: last viewpoint (normalized VOI center and resolution) used to predict the navigation direction
+        static tf::xyz<float> prefetchLastCenter;
+        static int prefetchLastResIndex;
+
         //inhibiting default constructor
         CViewer();
 
@@ -189,6 +193,13 @@ class terafly::CViewer : public QWidget
         ***********************************************************************************/
         void refresh() throw (tf::RuntimeException);
 
+        /**********************************************************************************
+        * Speculatively loads the 6 face-adjacent VOIs and the current VOI at the next hi-
+        * gher resolution into the Virtual Pyramid cache (if any). Loads are prioritized
+        * according to the most recent navigation direction.
+        ***********************************************************************************/
+        void prefetch();
+
         /**********************************************************************************
         * Resizes  the  given image subvolume in a  newly allocated array using the fastest
         * achievable interpolation method. The image currently shown is used as data source.
@@ -356,7 +367,9 @@ class terafly::CViewer : public QWidget
                 tf::RuntimeException* ex = 0,      // exception (optional)
                 qint64 elapsed_time = 0,            // elapsed time (optional)
                 QString op_dsc="",                  // operation descriptor (optional)
-                int step=0);                        // step number (optional)
+                int step=0,                         // step number (optional)
+                int request=-1,                     // request identifier (-1 if data were not sent by <CVolume>)
+                int streaming_steps=0);             // number of streaming steps of the request
 
 
         /**********************************************************************************
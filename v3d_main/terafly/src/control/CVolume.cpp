@@ -33,12 +33,55 @@
 #include "TiledVolume.h"
 #include "TiledMCVolume.h"
 #include "iomanager.config.h"
+#include "CSettings.h"
+#include <QRunnable>
 
 using namespace terafly;
 using namespace iim;
 
 CVolume* CVolume::uniqueInstance = 0;
 
+/*******************************************************************************************************************************
+* I/O worker: serves the oldest pending request, if any (a request may have been dropped by coalescing in the meanwhile)
+*******************************************************************************************************************************/
+class CVolume::Loader : public QRunnable
+{
+    private:
+
+        CVolume* cVolume;
+
+    public:
+
+        Loader(CVolume* _cVolume) : QRunnable(), cVolume(_cVolume){}
+
+        void run()
+        {
+            CVolume::Request* req = cVolume->takeRequest();
+            if(req)
+            {
+                cVolume->serve(req);
+                cVolume->releaseRequest(req);
+            }
+        }
+};
+
+bool CVolume::Request::sameVOI(const Request &r) const
+{
+    return voiResIndex == r.voiResIndex &&
+           voiV0 == r.voiV0 && voiV1 == r.voiV1 && voiH0 == r.voiH0 && voiH1 == r.voiH1 &&
+           voiD0 == r.voiD0 && voiD1 == r.voiD1 && voiT0 == r.voiT0 && voiT1 == r.voiT1 &&
+           cur_t == r.cur_t && streamingSteps == r.streamingSteps;
+}
+
+CVolume::CVolume() : QObject()
+{
+    /**/tf::debug(tf::LEV1, 0, __itm__current__function__);
+
+    requestsCount = 0;
+    ioPool.setMaxThreadCount(std::max(1, CSettings::instance()->getVoiLoadThreads()));
+    reset();
+}
+
 void CVolume::uninstance()
 {
     /**/tf::debug(tf::LEV1, 0, __itm__current__function__);
@@ -53,6 +96,160 @@ void CVolume::uninstance()
 CVolume::~CVolume()
 {
     /**/tf::debug(tf::LEV1, 0, __itm__current__function__);
+
+    // drop pending requests and wait for the running ones, whose data are discarded
+    cancel();
+    ioPool.waitForDone();
+
+    for(std::map<int, QMutex*>::iterator it = volumeMutexes.begin(); it != volumeMutexes.end(); it++)
+        delete it->second;
+}
+
+// load data using the currently set VOI in a separate I/O worker
+void CVolume::start()
+{
+    /**/tf::debug(tf::LEV1, strprintf("source = %p, res = %d, X=[%d, %d) Y=[%d, %d) Z=[%d, %d), T=[%d, %d], cur_t = %d",
+                                        source, voiResIndex, voiH0, voiH1, voiV0, voiV1, voiD0, voiD1, voiT0, voiT1, cur_t).c_str(), __itm__current__function__);
+
+    Request* req = new Request();
+    req->voiResIndex = voiResIndex;
+    req->voiV0 = voiV0; req->voiV1 = voiV1;
+    req->voiH0 = voiH0; req->voiH1 = voiH1;
+    req->voiD0 = voiD0; req->voiD1 = voiD1;
+    req->voiT0 = voiT0; req->voiT1 = voiT1;
+    req->cur_t = cur_t;
+    req->source = source;
+    req->streamingSteps = streamingSteps;
+    req->cancelled = false;
+
+    {
+        QMutexLocker locker(&queueMutex);
+
+        // coalesce with a queued or running request for the same destination and VOI
+        for(std::list<Request*>::iterator it = pending.begin(); it != pending.end(); it++)
+            if((*it)->source == source && (*it)->sameVOI(*req))
+            {
+                /**/tf::debug(tf::LEV3, strprintf("coalesced with queued request %d", (*it)->id).c_str(), __itm__current__function__);
+                currentRequests[source] = (*it)->id;
+                delete req;
+                return;
+            }
+        for(std::list<Request*>::iterator it = running.begin(); it != running.end(); it++)
+            if((*it)->source == source && !(*it)->cancelled && (*it)->sameVOI(*req))
+            {
+                /**/tf::debug(tf::LEV3, strprintf("coalesced with running request %d", (*it)->id).c_str(), __itm__current__function__);
+                currentRequests[source] = (*it)->id;
+                delete req;
+                return;
+            }
+
+        // supersede previous requests for the same destination
+        for(std::list<Request*>::iterator it = pending.begin(); it != pending.end();)
+            if((*it)->source == source)
+            {
+                /**/tf::debug(tf::LEV3, strprintf("dropped superseded queued request %d", (*it)->id).c_str(), __itm__current__function__);
+                delete *it;
+                it = pending.erase(it);
+            }
+            else
+                it++;
+        for(std::list<Request*>::iterator it = running.begin(); it != running.end(); it++)
+            if((*it)->source == source)
+                (*it)->cancelled = true;
+
+        req->id = requestsCount++;
+        pending.push_back(req);
+        currentRequests[source] = req->id;
+    }
+
+    // cancel requests of the destination as soon as it is destroyed
+    connect(source, SIGNAL(destroyed(QObject*)), this, SLOT(sourceDestroyed(QObject*)), Qt::UniqueConnection);
+
+    ioPool.start(new Loader(this));
+}
+
+// cancel all the requests sent to the given destination (all destinations if 0)
+void CVolume::cancel(QWidget* dest /* = 0 */)
+{
+    /**/tf::debug(tf::LEV1, strprintf("dest = %p", dest).c_str(), __itm__current__function__);
+
+    QMutexLocker locker(&queueMutex);
+
+    if(dest)
+        currentRequests.erase(dest);
+    else
+        currentRequests.clear();
+    for(std::list<Request*>::iterator it = pending.begin(); it != pending.end();)
+        if(!dest || (*it)->source == dest)
+        {
+            delete *it;
+            it = pending.erase(it);
+        }
+        else
+            it++;
+    for(std::list<Request*>::iterator it = running.begin(); it != running.end(); it++)
+        if(!dest || (*it)->source == dest)
+            (*it)->cancelled = true;
+}
+
+// cancels all the requests of a destroyed destination
+void CVolume::sourceDestroyed(QObject* obj)
+{
+    cancel(static_cast<QWidget*>(obj));
+}
+
+// number of requests waiting for, or being served by, an I/O worker
+int CVolume::getRequestsInProgress()
+{
+    QMutexLocker locker(&queueMutex);
+    return static_cast<int>(pending.size() + running.size());
+}
+
+// whether <request> is the latest request sent to <dest> and has not been cancelled
+bool CVolume::isCurrent(int request, QWidget* dest)
+{
+    QMutexLocker locker(&queueMutex);
+
+    std::map<QWidget*, int>::iterator it = currentRequests.find(dest);
+    return it != currentRequests.end() && it->second == request;
+}
+
+// moves the oldest pending request to <running> (0 if none)
+CVolume::Request* CVolume::takeRequest()
+{
+    QMutexLocker locker(&queueMutex);
+
+    if(pending.empty())
+        return 0;
+    Request* req = pending.front();
+    pending.pop_front();
+    running.push_back(req);
+    return req;
+}
+
+// removes a served request from <running>
+void CVolume::releaseRequest(Request* req)
+{
+    QMutexLocker locker(&queueMutex);
+
+    running.remove(req);
+    delete req;
+}
+
+bool CVolume::isCancelled(Request* req)
+{
+    QMutexLocker locker(&queueMutex);
+    return req->cancelled;
+}
+
+QMutex* CVolume::volumeMutex(int resIndex)
+{
+    QMutexLocker locker(&queueMutex);
+
+    QMutex* &mutex = volumeMutexes[resIndex];
+    if(!mutex)
+        mutex = new QMutex();
+    return mutex;
 }
 
 // load data using the currently set VOI
@@ -63,12 +260,11 @@ tf::uint8* CVolume::loadData() throw (tf::RuntimeException)
         // get volume at the currently selected resolution
         VirtualVolume* volume = CImport::instance()->getVolume(voiResIndex);
 
-        // set volume active time frames
-        volume->setActiveFrames(voiT0, voiT1);
-
         /**/tf::debug(tf::LEV3, "load data", __itm__current__function__);
         QElapsedTimer timer;
         timer.start();
+        QMutexLocker volumeLocker(volumeMutex(voiResIndex));
+        volume->setActiveFrames(voiT0, voiT1);
         uint8* imgData = volume->loadSubvolume_to_UINT8(voiV0, voiV1, voiH0, voiH1, voiD0, voiD1);
         PLog::instance()->appendOperation(new NewViewerOperation(strprintf("Block X=[%d, %d) Y=[%d, %d) Z=[%d, %d), T=[%d, %d] loaded from res %d",
                                                                            voiH0, voiH1, voiV0, voiV1, voiD0, voiD1, voiT0, voiT1, voiResIndex), tf::IO, timer.elapsed()));
@@ -92,13 +288,24 @@ tf::uint8* CVolume::loadData() throw (tf::RuntimeException)
     }
 }
 
-//automatically called when current thread is started
-void CVolume::run()
+// loads the VOI and sends data to the destination (called by I/O workers)
+void CVolume::serve(Request* req)
 {
-    /**/tf::debug(tf::LEV1, 0, __itm__current__function__);
+    /**/tf::debug(tf::LEV1, strprintf("request %d", req->id).c_str(), __itm__current__function__);
+
+    // the request is served on its own copy of the VOI
+    int voiResIndex = req->voiResIndex;
+    int voiV0 = req->voiV0, voiV1 = req->voiV1, voiH0 = req->voiH0, voiH1 = req->voiH1, voiD0 = req->voiD0, voiD1 = req->voiD1, voiT0 = req->voiT0, voiT1 = req->voiT1;
+    int cur_t = req->cur_t;
+    int streamingSteps = req->streamingSteps;
+    QWidget* source = req->source;
 
     try
     {
+        // superseded while waiting for an I/O worker
+        if(isCancelled(req))
+            return;
+
         VirtualVolume* volume = CImport::instance()->getVolume(voiResIndex);
 
         //---- Alessandro 2013-04-17: if VOI exceeds limits it is automatically adjusted. This is very useful in the cases the user is zooming-in
@@ -117,13 +324,6 @@ void CVolume::run()
             throw RuntimeException(strprintf("Invalid subvolume intervals inserted: X=[%d, %d), Y=[%d, %d), Z=[%d, %d), T=[%d, %d]",
                                              voiH0, voiH1, voiV0, voiV1, voiD0, voiD1, voiT0, voiT1));
 
-        // check destination
-        /**/tf::debug(tf::LEV2, "Check destination", __itm__current__function__);
-        CViewer* destination = dynamic_cast<CViewer*>(source);
-        if(!destination)
-            throw RuntimeException("Destination type not supported");
-        /**/tf::debug(tf::LEV2, strprintf("destination registered as \"%s\"", destination->title.c_str()).c_str(), __itm__current__function__);
-
         //checking for an imported volume
         if(volume)
         {
@@ -135,11 +335,22 @@ void CVolume::run()
                     // load selected frame
                     QElapsedTimer timerIO;
                     timerIO.start();
-                    volume->setActiveFrames(cur_t, cur_t);
-                    /**/tf::debug(tf::LEV3, "load selected time frame", __itm__current__function__);
-                    uint8* voiData = volume->loadSubvolume_to_UINT8(voiV0, voiV1, voiH0, voiH1, voiD0, voiD1);
+                    uint8* voiData = 0;
+                    {
+                        QMutexLocker volumeLocker(volumeMutex(voiResIndex));
+                        volume->setActiveFrames(cur_t, cur_t);
+                        /**/tf::debug(tf::LEV3, "load selected time frame", __itm__current__function__);
+                        voiData = volume->loadSubvolume_to_UINT8(voiV0, voiV1, voiH0, voiH1, voiD0, voiD1);
+                    }
                     qint64 elapsedTime = timerIO.elapsed();
 
+                    // superseded while loading: discard data
+                    if(isCancelled(req))
+                    {
+                        delete[] voiData;
+                        return;
+                    }
+
 
                     // wait for GUI thread to update graphics
                     /**/tf::debug(tf::LEV3, "Waiting for updateGraphicsInProgress mutex", __itm__current__function__);
@@ -152,21 +363,35 @@ void CVolume::run()
                     integer_array data_c = make_vector<int>() << voiH1-voiH0  << voiV1-voiV0  << voiD1-voiD0  << volume->getNACtiveChannels() << 1;
                     emit sendData(voiData, data_s, data_c, source, false, 0, elapsedTime,
                                 strprintf("Block X=[%d, %d) Y=[%d, %d) Z=[%d, %d), T=[%d, %d] loaded from res %d",
-                                voiH0, voiH1, voiV0, voiV1, voiD0, voiD1, cur_t, cur_t, voiResIndex).c_str());
+                                voiH0, voiH1, voiV0, voiV1, voiD0, voiD1, cur_t, cur_t, voiResIndex).c_str(), 0, req->id, streamingSteps);
 
                     // unlock updateGraphicsInProgress mutex
                     /**/tf::debug(tf::LEV3, strprintf("updateGraphicsInProgress.unlock()").c_str(), __itm__current__function__);
                     /**/ updateGraphicsInProgress.unlock();
                 }
+                // superseded while the selected frame was being loaded: skip loading all frames
+                if(isCancelled(req))
+                    return;
                 {
                     // load data
                     QElapsedTimer timerIO;
                     timerIO.start();
-                    volume->setActiveFrames(voiT0, voiT1);
-                    /**/tf::debug(tf::LEV3, "load data", __itm__current__function__);
-                    uint8* voiData = volume->loadSubvolume_to_UINT8(voiV0, voiV1, voiH0, voiH1, voiD0, voiD1);
+                    uint8* voiData = 0;
+                    {
+                        QMutexLocker volumeLocker(volumeMutex(voiResIndex));
+                        volume->setActiveFrames(voiT0, voiT1);
+                        /**/tf::debug(tf::LEV3, "load data", __itm__current__function__);
+                        voiData = volume->loadSubvolume_to_UINT8(voiV0, voiV1, voiH0, voiH1, voiD0, voiD1);
+                    }
                     qint64 elapsedTime = timerIO.elapsed();
 
+                    // superseded while loading: discard data
+                    if(isCancelled(req))
+                    {
+                        delete[] voiData;
+                        return;
+                    }
+
 
                     // wait for GUI thread to update graphics
                     /**/tf::debug(tf::LEV3, "Waiting for updateGraphicsInProgress mutex", __itm__current__function__);
@@ -179,7 +404,7 @@ void CVolume::run()
                     integer_array data_c = make_vector<int>() << voiH1-voiH0  << voiV1-voiV0  << voiD1-voiD0  << volume->getNACtiveChannels() << voiT1-voiT0+1;
                     emit sendData(voiData, data_s, data_c, source, true, 0, elapsedTime,
                                 strprintf("Block X=[%d, %d) Y=[%d, %d) Z=[%d, %d), T=[%d, %d] loaded from res %d",
-                                voiH0, voiH1, voiV0, voiV1, voiD0, voiD1, voiT0, voiT1, voiResIndex).c_str());
+                                voiH0, voiH1, voiV0, voiV1, voiD0, voiD1, voiT0, voiT1, voiResIndex).c_str(), 0, req->id, streamingSteps);
                     /**/tf::debug(tf::LEV3, "sendData signal emitted", __itm__current__function__);
 
                     // unlock updateGraphicsInProgress mutex
@@ -344,63 +569,68 @@ void CVolume::run()
     }
     catch( iim::IOException& exception)
     {
+        // errors of superseded requests are not sent
+        if(isCancelled(req))
+            return;
+
         // before emit signal, it is necessary to wait for updateGraphicsInProgress mutex
-        CViewer* dest = dynamic_cast<CViewer*>(source);
         /**/ updateGraphicsInProgress.lock();
-        reset();
-        //bufferMutex.unlock();
         tf::warning(exception.what(), "CVolume");
         /**/ updateGraphicsInProgress.unlock();
 
-        emit sendData(0, make_vector<int>(), make_vector<int>(), dest, true, new RuntimeException(exception.what()), 0, "");
+        emit sendData(0, make_vector<int>(), make_vector<int>(), source, true, new RuntimeException(exception.what()), 0, "", 0, req->id, streamingSteps);
     }
     catch( iom::exception& exception)
     {
+        // errors of superseded requests are not sent
+        if(isCancelled(req))
+            return;
+
         // before emit signal, it is necessary to wait for updateGraphicsInProgress mutex
-        CViewer* dest = dynamic_cast<CViewer*>(source);
         /**/ updateGraphicsInProgress.lock();
-        reset();
-        //bufferMutex.unlock();
         tf::warning(exception.what(), "CVolume");
         /**/ updateGraphicsInProgress.unlock();
 
-        emit sendData(0, make_vector<int>(), make_vector<int>(), dest, true, new RuntimeException(exception.what()), 0, "");
+        emit sendData(0, make_vector<int>(), make_vector<int>(), source, true, new RuntimeException(exception.what()), 0, "", 0, req->id, streamingSteps);
     }
     catch( RuntimeException& exception)
     {
+        // errors of superseded requests are not sent
+        if(isCancelled(req))
+            return;
+
         // before emit signal, it is necessary to wait for updateGraphicsInProgress mutex
-        CViewer* dest = dynamic_cast<CViewer*>(source);
         /**/ updateGraphicsInProgress.lock();
-        reset();
-        //bufferMutex.unlock();
         tf::warning(exception.what(), "CVolume");
         /**/ updateGraphicsInProgress.unlock();
 
-        emit sendData(0, make_vector<int>(), make_vector<int>(), dest, true, new RuntimeException(exception.what()), 0, "");
+        emit sendData(0, make_vector<int>(), make_vector<int>(), source, true, new RuntimeException(exception.what()), 0, "", 0, req->id, streamingSteps);
     }
     catch(const char* error)
     {
+        // errors of superseded requests are not sent
+        if(isCancelled(req))
+            return;
+
         // before emit signal, it is necessary to wait for updateGraphicsInProgress mutex
-        CViewer* dest = dynamic_cast<CViewer*>(source);
         /**/ updateGraphicsInProgress.lock();
-        reset();
-        //bufferMutex.unlock();
         tf::warning(error, "CVolume");
         /**/ updateGraphicsInProgress.unlock();
 
-        emit sendData(0, make_vector<int>(), make_vector<int>(), dest, true, new RuntimeException(error), 0, "");
+        emit sendData(0, make_vector<int>(), make_vector<int>(), source, true, new RuntimeException(error), 0, "", 0, req->id, streamingSteps);
     }
     catch(...)
     {
+        // errors of superseded requests are not sent
+        if(isCancelled(req))
+            return;
+
         // before emit signal, it is necessary to wait for updateGraphicsInProgress mutex
-        CViewer* dest = dynamic_cast<CViewer*>(source);
         /**/ updateGraphicsInProgress.lock();
-        reset();
-        //bufferMutex.unlock();
         tf::warning("Unknown error occurred", "CVolume");
         /**/ updateGraphicsInProgress.unlock();
 
-        emit sendData(0, make_vector<int>(), make_vector<int>(), dest, true, new RuntimeException("Unknown error occurred"), 0, "");
+        emit sendData(0, make_vector<int>(), make_vector<int>(), source, true, new RuntimeException("Unknown error occurred"), 0, "", 0, req->id, streamingSteps);
     }
 }
 
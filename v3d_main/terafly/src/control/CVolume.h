@@ -29,13 +29,28 @@
 #ifndef CLOADSUBVOLUME_H
 #define CLOADSUBVOLUME_H
 
-#include <QThread>
+#include <QObject>
+#include <QMutex>
+#include <QThreadPool>
 #include <string>
+#include <list>
+#include <map>
 #include "CPlugin.h"
 #include "CImport.h"
 #include "CViewer.h"
 
-class terafly::CVolume : public QThread
+/*******************************************************************************************************************************
+* VOI loading is served by a queue of requests and a pool of I/O workers (see CSettings::getVoiLoadThreads):
+* - each call to <start()> enqueues a snapshot of the currently set VOI, so that setting a new VOI never affects the requests
+*   that are already queued or being served
+* - a request for the same destination and VOI of a queued (or running) request is coalesced into the latter
+* - a request supersedes all the requests previously sent to the same destination: queued ones are dropped, running ones are
+*   cancelled, i.e. their data are discarded as soon as loading is over and are not sent
+* - requests of destinations that have been destroyed are cancelled as well
+* Reads from the same resolution are serialized (volumes are not thread-safe), whereas different resolutions are read con-
+* currently, so that a stale request at one resolution does not delay the loading of a new one at another resolution.
+*******************************************************************************************************************************/
+class terafly::CVolume : public QObject
 {
     Q_OBJECT
 
@@ -46,15 +61,39 @@ class terafly::CVolume : public QThread
         * instantiated by calling static method "istance(...)"
         **********************************************************************************/
         static CVolume* uniqueInstance;
-        CVolume() : QThread()
-        {
-         /**/tf::debug(tf::LEV1, 0, __itm__current__function__);
-
-            reset();
-        }
+        CVolume();
 
-        //automatically called when current thread is started
-        void run();
+        // VOI load request
+        struct Request
+        {
+            int id;                                                 // request identifier (in order of submission)
+            int voiResIndex;                                        // volume of interest resolution index
+            int voiV0,voiV1,voiH0,voiH1,voiD0,voiD1,voiT0,voiT1;    // volume of interest coordinates
+            int cur_t;                                              // current time frame selected
+            QWidget* source;                                        // the object that requested the VOI
+            int streamingSteps;                                     // number of streaming steps
+            bool cancelled;                                         // whether the request has been superseded (guarded by <queueMutex>)
+
+            bool sameVOI(const Request &r) const;
+        };
+        class Loader;                                               // I/O worker (see CVolume.cpp)
+        friend class Loader;
+
+        // request queue
+        std::list<Request*> pending;                                // requests waiting for an I/O worker
+        std::list<Request*> running;                                // requests being served
+        int requestsCount;                                          // number of requests submitted so far
+        std::map<QWidget*, int> currentRequests;                    // latest request of each destination (guarded by <queueMutex>)
+        QMutex queueMutex;                                          // guards <pending>, <running> and <volumeMutexes>
+        QThreadPool ioPool;                                         // I/O workers
+        std::map<int, QMutex*> volumeMutexes;                       // serialize reads from the same resolution
+
+        // called by I/O workers
+        Request* takeRequest();                                     // moves the oldest pending request to <running> (0 if none)
+        void releaseRequest(Request* req);                          // removes a served request from <running>
+        bool isCancelled(Request* req);
+        QMutex* volumeMutex(int resIndex);
+        void serve(Request* req);                                   // loads the VOI and sends data to the destination
 
         //members
         //I suspect the "int" below might be problematic in the long run, but I leave them as is at this moment. I would use V3D_LONG instead.  by PHC 20131029
@@ -64,6 +103,11 @@ class terafly::CVolume : public QThread
         int streamingSteps;                                         //
         int cur_t;                                                  // current time frame selected (it is loaded and shown before the other frames)
 
+    private slots:
+
+        // cancels all the requests of a destroyed destination
+        void sourceDestroyed(QObject* obj);
+
     public:
 
         /*********************************************************************************
@@ -483,6 +527,22 @@ class terafly::CVolume : public QThread
         // load data using the currently set VOI
         tf::uint8* loadData() throw (tf::RuntimeException);
 
+        // load data using the currently set VOI in a separate I/O worker. Data are sent to the listener with <sendData(...)>
+        void start();
+
+        // cancel all the requests sent to the given destination (all destinations if 0)
+        void cancel(QWidget* dest = 0);
+
+        // number of requests waiting for, or being served by, an I/O worker
+        int getRequestsInProgress();
+
+        // whether <request> is the latest request sent to <dest> and has not been cancelled: data sent by other
+        // requests are stale and must be discarded by the destination
+        bool isCurrent(int request, QWidget* dest);
+
+        // wait for all I/O workers to terminate
+        void waitForDone(){ioPool.waitForDone();}
+
         friend class CViewer;
 
     signals:
@@ -499,7 +559,9 @@ class terafly::CVolume : public QThread
                 tf::RuntimeException* ex = 0,      // exception (optional)
                 qint64 elapsed_time = 0,            // elapsed time (optional)
                 QString op_dsc="",                  // operation descriptor (optional)
-                int step=0);                        // step number (optional)
+                int step=0,                         // step number (optional)
+                int request=-1,                     // request identifier (see <isCurrent>)
+                int streaming_steps=0);             // number of streaming steps of the request
 };
 
 #endif // CLOADSUBVOLUME_H
@@ -1,6 +1,7 @@
 #include "VirtualPyramid.h"
 #include "VirtualVolume.h"
 #include <fstream>
+#include <functional>
 #include "IOPluginAPI.h"
 #include "CImageUtils.h"
 #include "basic_4dimage.h"
@@ -20,6 +21,9 @@ unsigned char tf::VirtualPyramid::empty_viz_intensity = 128;
 // empty image space visualization: salt & pepper percentage
 float tf::VirtualPyramid::empty_viz_salt_pepper_percentage = 0.001;
 
+// allow concurrent reads from the unconverted volume (thread-safe formats only)
+bool tf::VirtualPyramid::parallel_io = false;
+
 // VirtualPyramid constructor 1
 tf::VirtualPyramid::VirtualPyramid(
         std::string           highresPath,              // highest-res (unconverted) volume path
@@ -43,6 +47,11 @@ throw (iim::IOException, iom::exception, tf::RuntimeException)
 
     // set object members
     _vol = highresVol;
+    _ramBudget = 0;
+    _refillDone = _refillTotal = 0;
+    _refillCanceled = false;
+    _prefetchGeneration = 0;
+    _prefetchPool.setMaxThreadCount(1);
     _volPath = highresPath;
 
     // init working folder
@@ -99,6 +108,11 @@ throw (iim::IOException, iom::exception, tf::RuntimeException)
 
     // set object members
     _vol = highresVol;
+    _ramBudget = 0;
+    _refillDone = _refillTotal = 0;
+    _refillCanceled = false;
+    _prefetchGeneration = 0;
+    _prefetchPool.setMaxThreadCount(1);
     _volPath = highresPath;
 
     // init working folder
@@ -213,6 +227,11 @@ throw (iim::IOException, iom::exception, tf::RuntimeException)
 
     // set object members
     _vol = highresVol;
+    _ramBudget = 0;
+    _refillDone = _refillTotal = 0;
+    _refillCanceled = false;
+    _prefetchGeneration = 0;
+    _prefetchPool.setMaxThreadCount(1);
     _volPath = highresPath;
 
     // init working folder
@@ -230,6 +249,10 @@ tf::VirtualPyramid::~VirtualPyramid() throw(iim::IOException)
 {
     /**/tf::debug(tf::LEV2, 0, __itm__current__function__);
 
+    // stop refill and prefetch workers (if any) before releasing cache layers
+    refillCancel(true);
+    prefetchCancel(true);
+
     try
     {
 		this->clear(false);
@@ -516,6 +539,55 @@ void tf::VirtualPyramid::initPyramid(
                                                  _virtualPyramid[k]->getDIM_C(),
                                                  _virtualPyramid[k]->getDIM_T()), block5Ddim, block_format));
     }
+
+    // init statistics
+    _stats.resize(_cachePyramid.size());
+    for(size_t k = 0; k < _cachePyramid.size(); k++)
+    {
+        QMutexLocker locker(_cachePyramid[k]->mutex());
+        updateStats(k);
+    }
+}
+
+// update statistics of the given cache layer (to be called with the layer lock held)
+void tf::VirtualPyramid::updateStats(size_t level)
+{
+    cache_stats stats;
+    stats.memoryUsed = _cachePyramid[level]->memoryUsed();
+    stats.memoryMax = _cachePyramid[level]->memoryMax();
+    stats.completeness = _cachePyramid[level]->completeness();
+    stats.hits = _cachePyramid[level]->hits();
+    stats.misses = _cachePyramid[level]->misses();
+    stats.evictions = _cachePyramid[level]->evictions();
+    stats.prefetches = _cachePyramid[level]->prefetches();
+    stats.prefetchHits = _cachePyramid[level]->prefetchHits();
+
+    QMutexLocker locker(&_statsMutex);
+    _stats[level] = stats;
+}
+
+// completeness index of the given VOI in the given cache layer, without waiting for refill/prefetch threads
+bool                                    // return false if the layer is currently in use
+tf::VirtualPyramid::completeness(
+        int level,                      // pyramid layer
+        iim::voi3D<> voi,               // VOI in the 'level' coordinate system
+        float & value)                  // output: completeness index between 0 and 1
+throw (iim::IOException, iom::exception, tf::RuntimeException)
+{
+    if(!_cachePyramid[level]->mutex()->tryLock())
+        return false;
+
+    try
+    {
+        value = _cachePyramid[level]->completeness(voi);
+    }
+    catch(...)
+    {
+        _cachePyramid[level]->mutex()->unlock();
+        throw;
+    }
+    _cachePyramid[level]->mutex()->unlock();
+    return true;
 }
 
 // load volume of interest from the given resolution layer
@@ -550,8 +622,11 @@ throw (iim::IOException, iom::exception, tf::RuntimeException)
     // highest-res layer = THE image
     if(level == 0)
     {
-        // fetch data
-        data = _vol->loadSubvolume_to_UINT8(start.y, end.y, start.x, end.x, start.z, end.z);
+        // fetch data (reads are serialized unless 'parallel_io' is set)
+        {
+            QMutexLocker io_locker(parallel_io ? 0 : &_volMutex);
+            data = _vol->loadSubvolume_to_UINT8(start.y, end.y, start.x, end.x, start.z, end.z);
+        }
 
         // replace perfect 0 with 1 ('0' value is reserved for empty/nonloaded voxels)
         // ***WARNING*** : here, we are deliberately changing the meaning of the data for efficient representation, counting, and access of empty/nonloaded voxels
@@ -567,7 +642,13 @@ throw (iim::IOException, iom::exception, tf::RuntimeException)
         //             |
         //            \ /
         //             °   CRUCIAL : in this version, we decided not to cache the highest-res layer (too RAM / disk space expensive)
+        //
+        // blocks accessed from now on are needed by this VOI and must not be evicted
+        size_t clock_start = HyperGridCache::clock();
         for(size_t l = 1; l <_cachePyramid.size(); l++)
+        {
+            // each layer is locked separately, so that other threads can access the layers not being written
+            QMutexLocker locker(_cachePyramid[l]->mutex());
             _cachePyramid[l]->putData
 			(
 				tf::image5D<uint8>
@@ -579,16 +660,29 @@ throw (iim::IOException, iom::exception, tf::RuntimeException)
                 tf::xyzt<size_t>( start.x, start.y, start.z, _vol->getT0()),
                 _virtualPyramid[l]->_resamplingFactor * (-1)
 			);
+            updateStats(l);
+        }
+
+        // stay within RAM budget
+        releaseMemory(clock_start);
     }
     // lower-res layers = virtual layers
     else
     {
         // fetch data
-        data = _cachePyramid[level]->readData(
-                    voi4D<int>(
-                        xyzt<int>(start.x, start.y, start.z, _vol->getT0()),
-                        xyzt<int>(end.x, end.y, end.z, _vol->getT1()+1)),
-                    active_channels<>(_vol->getActiveChannels(), _vol->getNACtiveChannels())).data;
+        size_t clock_start = HyperGridCache::clock();
+        {
+            QMutexLocker locker(_cachePyramid[level]->mutex());
+            data = _cachePyramid[level]->readData(
+                        voi4D<int>(
+                            xyzt<int>(start.x, start.y, start.z, _vol->getT0()),
+                            xyzt<int>(end.x, end.y, end.z, _vol->getT1()+1)),
+                        active_channels<>(_vol->getActiveChannels(), _vol->getNACtiveChannels())).data;
+            updateStats(level);
+        }
+
+        // stay within RAM budget
+        releaseMemory(clock_start);
 
         // if required, replace empty voxels (0s) with the chosen visualization method for empty image regions
         if(empty_viz_method == tf::VirtualPyramid::SALT_AND_PEPPER)
@@ -622,6 +716,31 @@ tf::VirtualPyramid::refill(
         refill_strategy strategy,   // refill strategy
         tf::xyz<size_t> block_dim   // block dimension
 ) throw (iim::IOException, iom::exception, tf::RuntimeException)
+{
+    // take first non-complete block
+    std::vector < iim::voi3D<size_t> > blocks = refillBlocks(cache_level, VOI, strategy, block_dim, 1);
+
+    // no blocks found, it means all blocks are complete --> return false
+    if(blocks.empty())
+        return false;
+
+    // otherwise fetch data from highest-res (layer = 0)
+    delete this->loadVOI(tf::xyz<size_t>(blocks[0].start.x, blocks[0].start.y, blocks[0].start.z),
+                         tf::xyz<size_t>(blocks[0].end.x,   blocks[0].end.y,   blocks[0].end.z), 0).data;
+
+    return true;
+}
+
+// get noncomplete blocks in the given cache layer and VOI, sorted according to the given strategy
+// - returned blocks are in the highest-res image coordinate system
+std::vector< iim::voi3D<size_t> >
+tf::VirtualPyramid::refillBlocks(
+        int cache_level,            // cache level where to search noncomplete blocks (default: lowest-res cache layer)
+        iim::voi3D<> VOI,           // volume of interest in the 'cache_level' coordinate system
+        refill_strategy strategy,   // refill strategy
+        tf::xyz<size_t> block_dim,  // block dimension
+        size_t max_blocks           // stop searching after 'max_blocks' noncomplete blocks have been found
+) throw (iim::IOException, iom::exception, tf::RuntimeException)
 {
     // check preconditions
     if(!_vol)
@@ -773,36 +892,116 @@ tf::VirtualPyramid::refill(
 //    printf("\n\n");
 
 
-    // take first non-complete tile
-    size_t k = 0;
-    for(; k < tiles.size(); k++)
+    // take non-complete tiles, using the 'tiles_copy' tiles with coordinates in the highest-res image space
+    std::vector < iim::voi3D<size_t> > noncomplete;
+    QMutexLocker locker(_cachePyramid[cache_level]->mutex());
+    for(size_t k = 0; k < tiles.size() && noncomplete.size() < max_blocks; k++)
     {
         float c = _cachePyramid[cache_level]->completeness(tiles[k]);
         if(c < 1)
         {
-//            printf("first noncomplete tile found (%f): [%d,%d) [%d,%d) [%d,%d)\n",
+//            printf("noncomplete tile found (%f): [%d,%d) [%d,%d) [%d,%d)\n",
 //                   c,
 //                   tiles[k].start.x, tiles[k].end.x,
 //                   tiles[k].start.y, tiles[k].end.y,
 //                   tiles[k].start.z, tiles[k].end.z);
-            break;
+            noncomplete.push_back(tiles_copy[k]);
         }
     }
 
+    return noncomplete;
+}
 
-    // if k is out of bounds, it means all tiles are complete --> return false
-    if(k == tiles.size())
-        return false;
-    // otherwise fetch data from highest-res (layer = 0) using the 'tiles_copy' tiles with coordinates in the highest-res image space
-    else
-        delete this->loadVOI(tf::xyz<size_t>(tiles_copy[k].start.x, tiles_copy[k].start.y, tiles_copy[k].start.z),
-                             tf::xyz<size_t>(tiles_copy[k].end.x,   tiles_copy[k].end.y,   tiles_copy[k].end.z), 0).data;
+// asynchronous refill: same as refill(), but up to 'max_blocks' noncomplete blocks are refilled concurrently by a pool of worker threads
+int                                 // return # of submitted blocks (0 if no empty regions found or a refill is already running)
+tf::VirtualPyramid::refillAsync(
+        int cache_level,            // cache level where to search the 'emptiest' region (default: lowest-res cache layer)
+        iim::voi3D<> VOI,           // volume of interest in the 'cache_level' coordinate system
+        refill_strategy strategy,   // refill strategy
+        tf::xyz<size_t> block_dim,  // block dimension
+        int max_blocks,             // maximum # of blocks to refill (-1 = all noncomplete blocks)
+        int n_threads               // # of worker threads (0 = one per core)
+) throw (iim::IOException, iom::exception, tf::RuntimeException)
+{
+    /**/tf::debug(tf::LEV2, tf::strprintf("max_blocks = %d, n_threads = %d", max_blocks, n_threads).c_str(), __itm__current__function__);
+
+    // only one refill at a time
+    if(refillRunning())
+        return 0;
 
-//    float cnew = _cachePyramid[cache_level]->completeness(tiles[k]);
-//    if(cnew != 1)
-//        throw tf::RuntimeException(tf::strprintf("in VirtualPyramid::refill(): completeness != 1 (%f) after refill, VOI x=[%d,%d) y=[%d,%d) z=[%d,%d)", cnew, tiles[k].start.x, tiles[k].end.x, tiles[k].start.y, tiles[k].end.y, tiles[k].start.z, tiles[k].end.z));
+    std::vector < iim::voi3D<size_t> > blocks = refillBlocks(cache_level, VOI, strategy, block_dim,
+                                                             max_blocks < 0 ? std::numeric_limits<size_t>::max() : size_t(max_blocks));
+    if(blocks.empty())
+        return 0;
 
-    return true;
+    // reset refill state
+    {
+        QMutexLocker locker(&_refillMutex);
+        _refillDone = 0;
+        _refillTotal = blocks.size();
+        _refillCanceled = false;
+        _refillError.clear();
+    }
+
+    // submit jobs in the order given by the refill strategy
+    _refillPool.setMaxThreadCount(n_threads > 0 ? n_threads : std::max(1, QThread::idealThreadCount()));
+    for(size_t i=0; i<blocks.size(); i++)
+        _refillPool.start(new RefillJob(this, blocks[i]));
+
+    return blocks.size();
+}
+
+// wait for the asynchronous refill to finish
+// - with a timeout, returns as soon as one job is completed or the timeout expires (useful to update progress)
+bool                                // return true if refill has finished
+tf::VirtualPyramid::refillWait(
+        int msecs)                  // maximum waiting time (-1 = no timeout)
+throw (tf::RuntimeException)
+{
+    QMutexLocker locker(&_refillMutex);
+    if(msecs < 0)
+        while(_refillDone < _refillTotal)
+            _refillCond.wait(&_refillMutex);
+    else if(_refillDone < _refillTotal)
+        _refillCond.wait(&_refillMutex, msecs);
+    bool finished = _refillDone >= _refillTotal;
+
+    // rethrow errors raised by worker threads
+    if(!_refillError.empty())
+    {
+        std::string error = _refillError;
+        _refillError.clear();
+        throw tf::RuntimeException(error);
+    }
+
+    return finished;
+}
+
+// cancel the asynchronous refill: blocks not yet started are skipped
+void tf::VirtualPyramid::refillCancel(bool wait)
+{
+    /**/tf::debug(tf::LEV2, 0, __itm__current__function__);
+
+    _refillCanceled = true;
+    if(wait)
+    {
+        QMutexLocker locker(&_refillMutex);
+        while(_refillDone < _refillTotal)
+            _refillCond.wait(&_refillMutex);
+    }
+}
+
+// asynchronous refill progress
+bool tf::VirtualPyramid::refillRunning()
+{
+    QMutexLocker locker(&_refillMutex);
+    return _refillDone < _refillTotal;
+}
+void tf::VirtualPyramid::refillProgress(int & done, int & total)
+{
+    QMutexLocker locker(&_refillMutex);
+    done = _refillDone;
+    total = _refillTotal;
 }
 
 
@@ -818,26 +1017,28 @@ throw (iim::IOException, iom::exception, tf::RuntimeException)
     if(layer != -1 && (layer < 0 || layer >= cachePyramid().size()))
         throw iim::IOException("Cannot clear pyramid cache: invalid layer selection");
 
-
     // get modified blocks (if any)
-    std::vector <tf::HyperGridCache::CacheBlock*> blocks_modified;
+    // - layers are locked one at a time and not while waiting for the user, so that refill workers (if any) are not stalled
+    size_t n_modified = 0;
+    float GB = 0;
     for(int i=0; i<cachePyramid().size(); i++)
     {
         if(layer == -1 || layer == i)
         {
+            QMutexLocker locker(_cachePyramid[i]->mutex());
             std::vector <tf::HyperGridCache::CacheBlock*> modified_i = cachePyramid()[i]->blocksChanged();
-            blocks_modified.insert(blocks_modified.end(), modified_i.begin(), modified_i.end());
+            n_modified += modified_i.size();
+
+            // calculate overall image data size
+            for(int j=0; j<modified_i.size(); j++)
+                GB += modified_i[j]->memoryMax();
         }
     }
 
-    // calculate overall image data size
-    float GB = 0;
-    for(int i=0; i<blocks_modified.size(); i++)
-        GB += blocks_modified[i]->memoryMax();
-
 
-    // save modified blocks
-    if(blocks_modified.size())
+    // ask whether to save modified blocks
+    bool save = false;
+    if(n_modified)
     {
         int ret = QMessageBox::Yes;
         if(ask_to_save)
@@ -850,32 +1051,254 @@ throw (iim::IOException, iom::exception, tf::RuntimeException)
             msgBox.setDefaultButton(QMessageBox::Yes);
             ret = msgBox.exec();
         }
+        save = ret == QMessageBox::Yes;
+    }
 
-        if(ret == QMessageBox::Yes)
+    // save modified blocks (if requested), then clear all blocks
+    QProgressDialog* progress = 0;
+    if(save)
+    {
+        progress = new QProgressDialog("Save virtual pyramid files...", "Cancel", 0, int(n_modified));
+        progress->setWindowModality(Qt::WindowModal);
+        progress->setMinimumDuration(0);
+    }
+    try
+    {
+        size_t n_saved = 0;
+        for(int i=0; i<cachePyramid().size(); i++)
         {
-            QProgressDialog progress("Save virtual pyramid files...", "Cancel", 0, blocks_modified.size());
-            progress.setWindowModality(Qt::WindowModal);
-            progress.setMinimumDuration(0);
-
-            for (int i = 0; i < blocks_modified.size(); i++)
+            if(layer == -1 || layer == i)
             {
-                progress.setValue(i);
-                progress.setLabelText(iim::strprintf("Save virtual pyramid files %d of %d...", i+1, blocks_modified.size()).c_str());
+                QMutexLocker locker(_cachePyramid[i]->mutex());
+
+                std::vector <tf::HyperGridCache::CacheBlock*> blocks_modified = save ? cachePyramid()[i]->blocksChanged() : std::vector <tf::HyperGridCache::CacheBlock*>();
+                for (int j = 0; j < blocks_modified.size() && save; j++, n_saved++)
+                {
+                    progress->setValue(int(std::min(n_saved, n_modified)));
+                    progress->setLabelText(iim::strprintf("Save virtual pyramid files %d of %d...", int(n_saved+1), int(n_modified)).c_str());
 
-                blocks_modified[i]->save();
+                    blocks_modified[j]->save();
 
-                if (progress.wasCanceled())
-                    break;
+                    if (progress->wasCanceled())
+                        save = false;
+                }
+
+                cachePyramid()[i]->clear();
+                updateStats(i);
             }
-            progress.setValue(blocks_modified.size());
         }
     }
+    catch(...)
+    {
+        delete progress;
+        throw;
+    }
+    if(progress)
+    {
+        progress->setValue(progress->maximum());
+        delete progress;
+    }
+}
 
-    // clear all blocks
-    for(int i=0; i<cachePyramid().size(); i++)
+// get current RAM usage (in GB) summed over all cache layers
+float tf::VirtualPyramid::memoryUsed()
+{
+    float sum = 0;
+    for(size_t i=0; i<_cachePyramid.size(); i++)
     {
-        if(layer == -1 || layer == i)
-            cachePyramid()[i]->clear();
+        QMutexLocker locker(_cachePyramid[i]->mutex());
+        sum += _cachePyramid[i]->memoryUsed();
+    }
+    return sum;
+}
+
+// release RAM by evicting the least recently / least frequently visited blocks until RAM usage is within budget
+size_t                                  // return number of evicted blocks
+tf::VirtualPyramid::releaseMemory(
+        size_t protect_since)           // blocks accessed after this cache clock tick are not evicted
+throw (iim::IOException, iom::exception, tf::RuntimeException)
+{
+    /**/tf::debug(tf::LEV2, tf::strprintf("budget = %.2f GB", _ramBudget).c_str(), __itm__current__function__);
+
+    // no budget set: nothing to do
+    if(_ramBudget <= 0)
+        return 0;
+
+    // one release at a time: cache layers are locked one by one, never while holding another layer lock
+    QMutexLocker locker(&_releaseMutex);
+
+    // collect blocks currently in RAM from all cache layers along with their eviction score
+    std::vector < std::pair<float, tf::HyperGridCache::CacheBlock*> > resident;
+    float used = 0;
+    size_t now = HyperGridCache::clock();
+    for(size_t i=0; i<_cachePyramid.size(); i++)
+    {
+        QMutexLocker layer_locker(_cachePyramid[i]->mutex());
+        std::vector <tf::HyperGridCache::CacheBlock*> resident_i = _cachePyramid[i]->blocksResident();
+        for(size_t j=0; j<resident_i.size(); j++)
+        {
+            used += resident_i[j]->memoryUsed();
+            resident.push_back(std::pair<float, tf::HyperGridCache::CacheBlock*>(resident_i[j]->evictionScore(now), resident_i[j]));
+        }
+    }
+    if(used <= _ramBudget)
+        return 0;
+
+    // evict blocks with the highest eviction score first (i.e. least recently and least frequently visited)
+    std::sort(resident.begin(), resident.end(), std::greater< std::pair<float, tf::HyperGridCache::CacheBlock*> >());
+    size_t evicted = 0;
+    std::vector<bool> changed(_cachePyramid.size(), false);
+    for(size_t i=0; i<resident.size() && used > _ramBudget; i++)
+    {
+        tf::HyperGridCache::CacheBlock* block = resident[i].second;
+        QMutexLocker layer_locker(block->parent()->mutex());
+
+        // block may have been accessed or evicted by another thread in the meantime
+        if(!block->resident() || block->lastAccess() > protect_since)
+            continue;
+        used -= block->memoryUsed();
+        block->evict();
+        evicted++;
+
+        for(size_t l=0; l<_cachePyramid.size(); l++)
+            if(_cachePyramid[l] == block->parent())
+                changed[l] = true;
+    }
+
+    // update statistics of the layers where blocks have been evicted
+    for(size_t l=0; l<_cachePyramid.size(); l++)
+        if(changed[l])
+        {
+            QMutexLocker layer_locker(_cachePyramid[l]->mutex());
+            updateStats(l);
+        }
+
+    return evicted;
+}
+
+// refill job: loads one block from the highest-res image (data are propagated to all cache layers by loadVOI)
+void tf::VirtualPyramid::RefillJob::run()
+{
+    std::string error;
+    try
+    {
+        if(!_parent->_refillCanceled)
+            delete _parent->loadVOI(tf::xyz<size_t>(_block.start.x, _block.start.y, _block.start.z),
+                                    tf::xyz<size_t>(_block.end.x,   _block.end.y,   _block.end.z), 0).data;
+    }
+    catch(iim::IOException & e)
+    {
+        error = e.what();
+    }
+    catch(iom::exception & e)
+    {
+        error = e.what();
+    }
+    catch(tf::RuntimeException & e)
+    {
+        error = e.what();
+    }
+
+    QMutexLocker locker(&_parent->_refillMutex);
+    if(!error.empty())
+    {
+        // the first error stops the refill
+        if(_parent->_refillError.empty())
+            _parent->_refillError = error;
+        _parent->_refillCanceled = true;
+    }
+    _parent->_refillDone++;
+    _parent->_refillCond.wakeAll();
+}
+
+// speculatively load the cache blocks intersecting the given VOI into RAM
+void tf::VirtualPyramid::prefetch(
+        xyz<size_t> start,          // xyz range [start, end)
+        xyz<size_t> end,            // xyz range [start, end)
+        int level,                  // pyramid layer (0=highest resolution, the higher the lower the resolution)
+        int priority /*= 0*/)       // job priority
+{
+    /**/tf::debug(tf::LEV2, strprintf("level = %d, voi = [%d,%d) x [%d,%d) x [%d,%d), priority = %d",
+                                     level, start.x, end.x, start.y, end.y, start.z, end.z, priority).c_str(), __itm__current__function__);
+
+    // highest-res layer is not cached
+    if(level <= 0 || level >= _cachePyramid.size())
+        return;
+
+    // clip VOI to the image space
+    iim::voi3D<size_t> voi(iim::xyz<size_t>(start.x, start.y, start.z),
+                           iim::xyz<size_t>(std::min(end.x, _cachePyramid[level]->dims().x),
+                                            std::min(end.y, _cachePyramid[level]->dims().y),
+                                            std::min(end.z, _cachePyramid[level]->dims().z)));
+    if(!voi.isValid())
+        return;
+
+    _prefetchPool.start(new PrefetchJob(this, voi, level, _prefetchGeneration), priority);
+}
+
+// cancel pending prefetch jobs
+void tf::VirtualPyramid::prefetchCancel(bool wait /*= false*/)   // wait for the running job to finish
+{
+    /**/tf::debug(tf::LEV2, 0, __itm__current__function__);
+
+    _prefetchGeneration++;
+    if(wait)
+        _prefetchPool.waitForDone();
+}
+
+// prefetch job: loads the cache blocks intersecting the VOI, then releases RAM if needed
+// - block files are read without holding the cache lock, which is taken only to find and to store the blocks
+void tf::VirtualPyramid::PrefetchJob::run()
+{
+    // skip outdated jobs
+    if(_generation != _parent->_prefetchGeneration)
+        return;
+
+    // prefetch is speculative: errors are logged, not reported to the user
+    try
+    {
+        std::vector <tf::HyperGridCache::CacheBlock*> blocks;
+        std::vector <size_t> last_access;
+        size_t clock_start = 0;
+        {
+            QMutexLocker locker(_parent->_cachePyramid[_level]->mutex());
+            clock_start = HyperGridCache::clock();
+            blocks = _parent->_cachePyramid[_level]->blocksMissing(_voi);
+            for(size_t i=0; i<blocks.size(); i++)
+                last_access.push_back(blocks[i]->lastAccess());
+        }
+
+        size_t loaded = 0;
+        for(size_t i=0; i<blocks.size() && _generation == _parent->_prefetchGeneration; i++)
+        {
+            size_t emptycount = 0;
+            tf::uint8* data = blocks[i]->read(emptycount);
+
+            QMutexLocker locker(_parent->_cachePyramid[_level]->mutex());
+            if(blocks[i]->prefetch(data, emptycount, last_access[i]))
+                loaded++;
+        }
+
+        if(loaded)
+        {
+            {
+                QMutexLocker locker(_parent->_cachePyramid[_level]->mutex());
+                _parent->updateStats(_level);
+            }
+            _parent->releaseMemory(clock_start);
+        }
+    }
+    catch(iim::IOException & e)
+    {
+        tf::warning(e.what(), __itm__current__function__);
+    }
+    catch(iom::exception & e)
+    {
+        tf::warning(e.what(), __itm__current__function__);
+    }
+    catch(tf::RuntimeException & e)
+    {
+        tf::warning(e.what(), __itm__current__function__);
     }
 }
 
@@ -1030,13 +1453,17 @@ throw (iim::IOException)
 ***************************************
 ---------------------------------------------------------------------------------------------------------------------------*/
 
+// access clock shared among all caches
+size_t tf::HyperGridCache::_clock = 0;
+QMutex tf::HyperGridCache::_clockMutex;
+
 // constructor 1
 tf::HyperGridCache::HyperGridCache(
         std::string path,                              // where cache files are stored / have to be stored
         xyzct<size_t> image_dim,                       // image dimensions along X, Y, Z, C (channel), and T (time)
         xyzct<size_t> block_dim,					// hypergrid block dimensions along X, Y, Z, C (channel), and T (time)
         const std::string block_fmt)                   // hypergrid block file format
-throw (iim::IOException, tf::RuntimeException, iom::exception)
+throw (iim::IOException, tf::RuntimeException, iom::exception) : _mutex(QMutex::Recursive)
 {
     /**/tf::debug(tf::LEV2, iim::strprintf("_path = \"%s\", image_dim = {%d, %d, %d, %d, %d}, block_dim = {%d, %d, %d, %d, %d}, block_fmt = \"%s\"",
                                            _path.c_str(), image_dim.x, image_dim.y, image_dim.z, image_dim.c, image_dim.t, block_dim.x, block_dim.y, block_dim.z, block_dim.c, block_dim.t, block_fmt.c_str()).c_str(), __itm__current__function__);
@@ -1047,6 +1474,7 @@ throw (iim::IOException, tf::RuntimeException, iom::exception)
     _block_dim = block_dim;
     _hypergrid = 0;
     _block_fmt = block_fmt;
+    _hits = _misses = _evictions = _prefetches = _prefetchHits = 0;
 
     // adjust block dim if needed
     if(_block_dim.x == std::numeric_limits<size_t>::max())
@@ -1459,6 +1887,38 @@ std::vector<tf::HyperGridCache::CacheBlock*> tf::HyperGridCache::blocksChanged()
     return modified;
 }
 
+std::vector<tf::HyperGridCache::CacheBlock*> tf::HyperGridCache::blocksResident()
+{
+    std::vector<tf::HyperGridCache::CacheBlock*> resident;
+    for(size_t t=0; t<_nBlocks.t; t++)
+        for(size_t c=0; c<_nBlocks.c; c++)
+            for(size_t z=0; z<_nBlocks.z; z++)
+                for(size_t y=0; y<_nBlocks.y; y++)
+                    for(size_t x=0; x<_nBlocks.x; x++)
+                        if(_hypergrid[t][c][z][y][x]->resident())
+                            resident.push_back(_hypergrid[t][c][z][y][x]);
+    return resident;
+}
+
+// get blocks intersecting the given VOI whose data are not in RAM
+std::vector<tf::HyperGridCache::CacheBlock*>
+tf::HyperGridCache::blocksMissing(
+        iim::voi3D<size_t> voi)         // 3D VOI (all channels and time points)
+{
+    /**/tf::debug(tf::LEV3, strprintf("path = \"%s\", voi = [%d,%d) x [%d,%d) x [%d,%d)",
+                                     _path.c_str(), voi.start.x, voi.end.x, voi.start.y, voi.end.y, voi.start.z, voi.end.z).c_str(), __itm__current__function__);
+
+    std::vector<CacheBlock*> missing;
+    for(size_t t=0; t<_nBlocks.t; t++)
+        for(size_t c=0; c<_nBlocks.c; c++)
+            for(size_t z=0; z<_nBlocks.z; z++)
+                for(size_t y=0; y<_nBlocks.y; y++)
+                    for(size_t x=0; x<_nBlocks.x; x++)
+                        if(!_hypergrid[t][c][z][y][x]->resident() && _hypergrid[t][c][z][y][x]->intersection(voi).isValid())
+                            missing.push_back(_hypergrid[t][c][z][y][x]);
+    return missing;
+}
+
 // clear all data
 void tf::HyperGridCache::clear()
 {
@@ -1554,6 +2014,8 @@ throw (iim::IOException, iom::exception)
     _imdata = 0;
     _index  = index;
     _visits = 0;
+    _lastAccess = 0;
+    _prefetched = false;
     _emptycount = 0;
     _hasChanged = false;
 
@@ -1664,6 +2126,22 @@ void tf::HyperGridCache::CacheBlock::load() throw (iim::IOException, iom::except
 {
     /**/tf::debug(tf::LEV2, 0, __itm__current__function__);
 
+    size_t emptycount = 0;
+    tf::uint8* data = read(emptycount);
+    if(_imdata)
+        delete[] _imdata;
+    _imdata = data;
+    _emptycount = emptycount;
+}
+
+// read block data from disk into a new buffer, without modifying the block (can be called without holding the cache lock)
+tf::uint8*                              // return block data (to be deleted by the caller)
+tf::HyperGridCache::CacheBlock::read(
+        size_t & emptycount)            // output: # of empty voxels
+throw (iim::IOException, iom::exception, tf::RuntimeException)
+{
+    /**/tf::debug(tf::LEV2, strprintf("path = \"%s\"", _path.c_str()).c_str(), __itm__current__function__);
+
     // precondition checks
     if(_dims.c > 3)
         throw iim::IOException("I/O functions with c (channels) > 3 not yet implemented", __itm__current__function__);
@@ -1672,11 +2150,8 @@ void tf::HyperGridCache::CacheBlock::load() throw (iim::IOException, iom::except
     if(!_dims.x || !_dims.y || !_dims.z || !_dims.c ||!_dims.t)
         throw iim::IOException("dims <= 0", __itm__current__function__);
 
-    // allocate memory for data if needed
-    if(!_imdata)
-        _imdata = new uint8[_dims.x * _dims.y * _dims.z * _dims.c * _dims.t];
-
     // try to load data from disk
+    tf::uint8* data = 0;
     if(iim::isFile(_path))
     {
         //int dimX = _dims.x, dimY=_dims.y, dimZ=_dims.z, dimC=_dims.c, bytes = 1;
@@ -1684,8 +2159,7 @@ void tf::HyperGridCache::CacheBlock::load() throw (iim::IOException, iom::except
         img.loadImage(_path.c_str());
         if(!img.valid())
             throw iim::IOException(tf::strprintf("Cannot read image block at \"%s\"", _path.c_str()));
-        delete _imdata;
-        _imdata = img.getRawData();
+        data = img.getRawData();
         img.setRawDataPointerToNull();
         /*if(iom::IOPluginFactory::instance()->getPlugin3D("tiff3D")->isChansInterleaved())
         {
@@ -1713,13 +2187,38 @@ void tf::HyperGridCache::CacheBlock::load() throw (iim::IOException, iom::except
     }
     else // otherwise initialize to perfect black (0: value reserved for empty voxels)
     {
+        data = new uint8[_dims.size()];
         size_t imdata_size = _dims.size();
         for(size_t i = 0; i<imdata_size; i++)
-            _imdata[i] = 0;
+            data[i] = 0;
     }
 
-    // update empty voxel count
-    updateEmptyCount();
+    // count empty voxels
+    emptycount = 0;
+    size_t total = _dims.size();
+    for(size_t i=0; i<total; i++)
+        if(!data[i])
+            emptycount++;
+
+    return data;
+}
+
+// load if needed and update hits/misses and access time
+void tf::HyperGridCache::CacheBlock::access() throw (iim::IOException, iom::exception, tf::RuntimeException)
+{
+    if(_imdata)
+    {
+        _parent->_hits++;
+        if(_prefetched)
+            _parent->_prefetchHits++;
+        _prefetched = false;
+    }
+    else
+    {
+        _parent->_misses++;
+        load();
+    }
+    _lastAccess = HyperGridCache::tick();
 }
 
 // save to disk
@@ -1823,8 +2322,7 @@ void tf::HyperGridCache::CacheBlock::putData(
         throw iim::IOException(tf::strprintf("Invalid block VOI [%d,%d) along x-axis", block_voi.start.x, block_voi.end.x));
 
 	// load block if needed
-    if(!_imdata)
-		load();
+    access();
 
 	// prepare metadata
 	unsigned int src_dims[5], src_offset[5], src_count[5], dst_dims[5], dst_offset[5];
@@ -1902,8 +2400,7 @@ void tf::HyperGridCache::CacheBlock::readData(
         throw iim::IOException(tf::strprintf("Invalid image VOI [%d,%d) along x-axis", block_voi.start.x, block_voi.end.x));
 
     // load block if needed
-    if(!_imdata)
-        load();
+    access();
 
     // prepare metadata
     unsigned int src_dims[5], src_offset[5], src_count[5], dst_dims[5], dst_offset[5];
@@ -1932,4 +2429,41 @@ void tf::HyperGridCache::CacheBlock::readData(
     _visits++;
 }
 
+// store data read by read() into RAM without counting as an access
+bool tf::HyperGridCache::CacheBlock::prefetch(
+        tf::uint8* data,                // block data returned by read(), owned by the block from now on
+        size_t emptycount,              // # of empty voxels returned by read()
+        size_t last_access)             // value of lastAccess() before read() was called
+{
+    // block has been accessed while data were read (it may have been loaded, modified, and saved again): discard data
+    if(_imdata || _lastAccess != last_access)
+    {
+        delete[] data;
+        return false;
+    }
+
+    _imdata = data;
+    _emptycount = emptycount;
+    _prefetched = true;
+    _parent->_prefetches++;
+
+    // prefetched blocks get a new clock tick, so that they are protected from the eviction round that follows
+    // their prefetch, and they are more recent than all accessed blocks when the next rounds begin
+    _lastAccess = HyperGridCache::tick();
+    return true;
+}
+
+// save to disk (if modified) and release RAM
+void tf::HyperGridCache::CacheBlock::evict() throw (iim::IOException, iom::exception, tf::RuntimeException)
+{
+    /**/tf::debug(tf::LEV2, strprintf("path = \"%s\"", _path.c_str()).c_str(), __itm__current__function__);
+
+    if(!_imdata)
+        return;
+
+    save();
+    clear();
+    _parent->_evictions++;
+}
+
 /*---- END HYPER GRID CACHE BLOCK section --------------------------------------------------------------------------------*/
@@ -3,6 +3,10 @@
 
 #include "CPlugin.h"
 #include "VirtualVolume.h"
+#include <QMutex>
+#include <QWaitCondition>
+#include <QThreadPool>
+#include <QRunnable>
 
 #if defined(USE_Qt5_VS2015_Win7_81) || defined(USE_Qt5_VS2015_Win10_10_14393)
 #include <QtWidgets>
@@ -11,6 +15,20 @@
 // Virtual Pyramid class: builds a virtual image pyramid on top of real (unconverted) image data
 class terafly::VirtualPyramid
 {
+    public:
+
+        // statistics of one cache layer (see cacheStats)
+        struct cache_stats
+        {
+            float  memoryUsed;                              // current RAM usage in GB
+            float  memoryMax;                               // maximum RAM usage in GB
+            float  completeness;                            // completeness index of the whole layer
+            size_t hits, misses, evictions;                 // block access counters
+            size_t prefetches, prefetchHits;                // prefetch counters
+
+            cache_stats() : memoryUsed(0), memoryMax(0), completeness(0), hits(0), misses(0), evictions(0), prefetches(0), prefetchHits(0){}
+        };
+
     private:
 
         // object members
@@ -19,6 +37,26 @@ class terafly::VirtualPyramid
         std::string                         _path;                  // where files should be stored
         std::vector< tf::VirtualPyramidLayer* > _virtualPyramid;    // virtual (=do NOT contain any data) pyramid layers (ordered by descending resolution)
         std::vector< tf::HyperGridCache*>  _cachePyramid;           // actual (=do contain data) pyramid 'cache' layers: cache data from/to disk and RAM at all resolution layers (ordered by descending resolution)
+        float                               _ramBudget;             // maximum RAM (in GB) that cache layers are allowed to allocate (<= 0 means no limit)
+        QMutex                              _releaseMutex;          // serializes releaseMemory() (each cache layer has its own lock, see HyperGridCache::mutex)
+        QMutex                              _volMutex;              // serializes reads from the unconverted volume (see 'parallel_io')
+        std::vector<cache_stats>            _stats;                 // statistics of each cache layer, updated by the threads that access the layer
+        QMutex                              _statsMutex;            // guards '_stats'
+
+        // asynchronous refill members
+        class RefillJob;                                            // refill of one block, executed by a worker thread
+        QThreadPool                         _refillPool;            // worker threads
+        QMutex                              _refillMutex;           // guards the refill members below
+        QWaitCondition                      _refillCond;            // signaled each time a refill job is completed
+        int                                 _refillDone;            // # of completed (or skipped) refill jobs
+        int                                 _refillTotal;           // # of submitted refill jobs
+        volatile bool                       _refillCanceled;        // if true, pending refill jobs are skipped
+        std::string                         _refillError;           // error message of the first failed refill job (if any)
+
+        // asynchronous prefetch members
+        class PrefetchJob;                                          // prefetch of one VOI, executed by the prefetch thread
+        QThreadPool                         _prefetchPool;          // prefetch thread (one thread, jobs are run by descending priority)
+        volatile int                        _prefetchGeneration;    // incremented by prefetchCancel(): jobs submitted before are skipped
 
 
         // disable default constructor
@@ -31,6 +69,7 @@ class terafly::VirtualPyramid
                 tf::xyz<size_t> block_dim	= tf::xyz<size_t>(256), // block dimensions
                 const std::string block_format = ".tif"             // block file format
         ) throw (iim::IOException, iom::exception, tf::RuntimeException);
+        void updateStats(size_t level);             // update '_stats' of the given cache layer (to be called with the layer lock held)
 
 
     public:
@@ -101,6 +140,24 @@ class terafly::VirtualPyramid
         std::vector<iim::VirtualVolume*> virtualPyramid();
         std::string path(){return _path;}
         std::vector <tf::HyperGridCache*> cachePyramid(){return _cachePyramid;}
+        float ramBudget(){return _ramBudget;}
+
+        // get a snapshot of the statistics of all cache layers without waiting for refill/prefetch threads
+        std::vector<cache_stats> cacheStats(){QMutexLocker locker(&_statsMutex); return _stats;}
+
+        // completeness index of the given VOI in the given cache layer
+        // - does not wait for refill/prefetch threads: returns false if the layer is currently in use
+        bool completeness(
+                int level,                          // pyramid layer
+                iim::voi3D<> voi,                   // VOI in the 'level' coordinate system
+                float & value)                      // output: completeness index between 0 and 1
+        throw (iim::IOException, iom::exception, tf::RuntimeException);
+
+        // SET methods
+        void setRamBudget(float GB){_ramBudget = GB;}
+
+        // get current RAM usage (in GB) summed over all cache layers
+        float memoryUsed();
 
 
         // load volume of interest from the given resolution layer
@@ -126,6 +183,59 @@ class terafly::VirtualPyramid
         throw (iim::IOException, iom::exception, tf::RuntimeException);
 
 
+        // get noncomplete blocks in the given cache layer and VOI, sorted according to the given strategy
+        // - returned blocks are in the highest-res image coordinate system
+        std::vector< iim::voi3D<size_t> >
+        refillBlocks(
+                int cache_level = -1,                                   // cache level where to search noncomplete blocks (default: lowest-res cache layer)
+                iim::voi3D<> VOI = iim::voi3D<>::biggest(),             // volume of interest in the 'cache_level' coordinate system (default: the entire volume)
+                refill_strategy strategy = REFILL_RANDOM,               // refill strategy
+                tf::xyz<size_t> block_dim = tf::xyz<size_t>::biggest(), // block dimension
+                size_t max_blocks = std::numeric_limits<size_t>::max()) // stop searching after 'max_blocks' noncomplete blocks have been found
+        throw (iim::IOException, iom::exception, tf::RuntimeException);
+
+
+        // asynchronous refill: same as refill(), but up to 'max_blocks' noncomplete blocks are refilled concurrently by a pool of worker threads
+        // - returns immediately: use refillProgress(), refillWait() and refillCancel() to monitor / stop the refill
+        // - errors raised by worker threads are rethrown by refillWait()
+        int                                                             // return # of submitted blocks (0 if no empty regions found or a refill is already running)
+        refillAsync(
+                int cache_level = -1,                                   // cache level where to search the 'emptiest' region (default: lowest-res cache layer)
+                iim::voi3D<> VOI = iim::voi3D<>::biggest(),             // volume of interest in the 'cache_level' coordinate system (default: the entire volume)
+                refill_strategy strategy = REFILL_RANDOM,               // refill strategy
+                tf::xyz<size_t> block_dim = tf::xyz<size_t>::biggest(), // block dimension
+                int max_blocks = -1,                                    // maximum # of blocks to refill (-1 = all noncomplete blocks)
+                int n_threads = 0)                                      // # of worker threads (0 = one per core)
+        throw (iim::IOException, iom::exception, tf::RuntimeException);
+
+        // wait for the asynchronous refill to finish
+        // - with a timeout, returns as soon as one job is completed or the timeout expires (useful to update progress)
+        bool                                                            // return true if refill has finished
+        refillWait(int msecs = -1)                                      // maximum waiting time (-1 = no timeout)
+        throw (tf::RuntimeException);
+
+        // cancel the asynchronous refill: blocks not yet started are skipped
+        void refillCancel(bool wait = true);                            // wait for running jobs to finish
+
+        // asynchronous refill progress
+        bool refillRunning();
+        void refillProgress(int & done, int & total);
+
+
+        // speculatively load the cache blocks intersecting the given VOI into RAM (no data are copied)
+        // - returns immediately: the VOI is loaded by a low-priority background thread
+        // - jobs with higher 'priority' are run first
+        // - only cache layers are prefetched (level > 0), i.e. the unconverted image is never accessed
+        void prefetch(
+                xyz<size_t> start,  // xyz range [start, end)
+                xyz<size_t> end,    // xyz range [start, end)
+                int level,          // pyramid layer (0=highest resolution, the higher the lower the resolution)
+                int priority = 0);  // job priority
+
+        // cancel pending prefetch jobs (e.g. because they refer to a previous viewpoint)
+        void prefetchCancel(bool wait = false);                         // wait for the running job to finish
+
+
         // clear cached data
         void clear(
                 bool ask_to_save = true,    // user is asked whether to save modified data (if any)
@@ -133,6 +243,14 @@ class terafly::VirtualPyramid
         throw (iim::IOException, iom::exception, tf::RuntimeException);
 
 
+        // release RAM by evicting the least recently / least frequently visited blocks until RAM usage is within budget
+        // - modified blocks are saved to disk before being evicted
+        size_t                                                          // return number of evicted blocks
+        releaseMemory(
+                size_t protect_since = std::numeric_limits<size_t>::max())  // blocks accessed after this cache clock tick are not evicted
+        throw (iim::IOException, iom::exception, tf::RuntimeException);
+
+
         // *** PATH (local, remote, lowres image, ...) getters and checkers ***
         // return path where Virtual Pyramid data are expected to be found on local storage (i.e. executable's folder)
         static std::string pathLocal(const std::string & _volPath);
@@ -166,11 +284,49 @@ class terafly::VirtualPyramid
         static empty_viz_mode empty_viz_method;                // empty image space visualization: method
         static unsigned char empty_viz_intensity;              // empty image space visualization: intensity level of empty voxels
         static float empty_viz_salt_pepper_percentage;         // empty image space visualization: salt & pepper percentage
+        static bool parallel_io;                                // allow concurrent reads from the unconverted volume (thread-safe formats only)
 
         friend class VirtualPyramidLayer;
 };
 
 
+// Virtual Pyramid refill job
+// - loads one block from the highest-res image, which propagates data to all cache layers
+class terafly::VirtualPyramid::RefillJob : public QRunnable
+{
+    private:
+
+        tf::VirtualPyramid* _parent;        // container
+        iim::voi3D<size_t>  _block;         // block to be refilled (highest-res image coordinate system)
+
+    public:
+
+        RefillJob(tf::VirtualPyramid* parent, iim::voi3D<size_t> block) : QRunnable(), _parent(parent), _block(block){}
+
+        void run();
+};
+
+
+// Virtual Pyramid prefetch job
+// - loads the cache blocks intersecting one VOI of a given cache layer
+class terafly::VirtualPyramid::PrefetchJob : public QRunnable
+{
+    private:
+
+        tf::VirtualPyramid* _parent;        // container
+        iim::voi3D<size_t>  _voi;           // VOI to be prefetched ('_level' coordinate system)
+        int                 _level;         // pyramid layer
+        int                 _generation;    // value of parent's '_prefetchGeneration' at submission time
+
+    public:
+
+        PrefetchJob(tf::VirtualPyramid* parent, iim::voi3D<size_t> voi, int level, int generation) :
+            QRunnable(), _parent(parent), _voi(voi), _level(level), _generation(generation){}
+
+        void run();
+};
+
+
 // Virtual Pyramid Layer class
 // - a wrapper built on the highest-res image to intercept its load methods
 // - inherits from VirtualVolume, which makes using a Virtual Pyramid Image transparent to the client
@@ -244,6 +400,14 @@ class terafly::HyperGridCache
         std::string _block_fmt;                     // block file format (e.g. ".tif", ".v3draw", ...)
         tf::xyzct<size_t> _nBlocks;                 // hypergrid dimension along X, Y, Z, C (channel), and T (time)
         tf::xyzct<size_t> _dims;                    // image space dimensions along X, Y, Z, C (channel), and T (time)
+        size_t _hits;                               // # of block accesses served from RAM
+        size_t _misses;                             // # of block accesses that required loading from disk
+        size_t _evictions;                          // # of blocks evicted from RAM to stay within the RAM budget
+        size_t _prefetches;                         // # of blocks loaded from disk by prefetch()
+        size_t _prefetchHits;                       // # of prefetched blocks that have been accessed afterwards (before being evicted)
+        QMutex _mutex;                              // serializes accesses to this cache (recursive, see VirtualPyramid)
+        static size_t _clock;                       // access clock shared among all caches (incremented at each block access)
+        static QMutex _clockMutex;                  // guards '_clock', which is incremented by threads holding locks of different caches
 
         // object methods
         HyperGridCache(){}                          // disable default constructor
@@ -281,6 +445,26 @@ class terafly::HyperGridCache
         // get blocks that have changed from pyramid startup
         std::vector<CacheBlock*> blocksChanged();
 
+        // get blocks whose data are currently in RAM
+        std::vector<CacheBlock*> blocksResident();
+
+        // get hits / misses / evictions counters
+        size_t hits(){return _hits;}
+        size_t misses(){return _misses;}
+        size_t evictions(){return _evictions;}
+        size_t prefetches(){return _prefetches;}
+        size_t prefetchHits(){return _prefetchHits;}
+        void resetCounters(){_hits = _misses = _evictions = _prefetches = _prefetchHits = 0;}
+
+        // get lock of this cache, to be held by threads accessing cache data
+        QMutex* mutex(){return &_mutex;}
+
+        // get current value of the access clock
+        static size_t clock(){QMutexLocker locker(&_clockMutex); return _clock;}
+
+        // increment the access clock and return the new value
+        static size_t tick(){QMutexLocker locker(&_clockMutex); return ++_clock;}
+
         // get current RAM usage in Gigabytes
         float memoryUsed();
 
@@ -310,6 +494,10 @@ class terafly::HyperGridCache
         throw (iim::IOException, iom::exception, tf::RuntimeException);
 
 
+        // get blocks intersecting the given VOI whose data are not in RAM (to be prefetched, see CacheBlock::read and CacheBlock::prefetch)
+        std::vector<CacheBlock*> blocksMissing(iim::voi3D<size_t> voi); // 3D VOI (all channels and time points)
+
+
         // clear all data
         void clear();
 
@@ -331,12 +519,15 @@ class terafly::HyperGridCache
                 std::string       _path;                    // path of file where this block is stored
                 bool              _hasChanged;                // whether the data of this block has been modified w.r.t. its original version stored on the disk
                 int               _visits;                  // # of times this block has been visited (load and/or store)
+                size_t            _lastAccess;              // access clock tick of the last visit (see HyperGridCache::clock)
+                bool              _prefetched;              // whether this block has been loaded by prefetch() and not yet accessed
                 size_t            _emptycount;              // # of empty voxels (= 0 with '0' reserved for empty voxels only / values start from 1)
 
                 // object utility methods
                 CacheBlock(){}                              // disable default constructor
                 void load() throw (iim::IOException, iom::exception, tf::RuntimeException);   // load from disk
                 void updateEmptyCount();                    // update empty voxel count
+                void access() throw (iim::IOException, iom::exception, tf::RuntimeException);   // load if needed and update hits/misses and access time
 
 
             public:
@@ -366,6 +557,19 @@ class terafly::HyperGridCache
                 // whether this block has changed (contains new data) since the last data fetch
                 bool hasChanged(){return _hasChanged;}
 
+                // whether this block data are in RAM
+                bool resident(){return _imdata != 0;}
+
+                // get container
+                HyperGridCache* parent(){return _parent;}
+
+                // get access clock tick of the last visit
+                size_t lastAccess(){return _lastAccess;}
+
+                // eviction score at the given clock tick: the older the last access and the fewer the visits, the higher the score
+                // - a prefetched block counts as visited once, so that it is not evicted before blocks accessed as recently
+                float evictionScore(size_t now){return (now - _lastAccess) / (1.0f + std::log(1.0f + _visits + (_prefetched ? 1 : 0)));}
+
                 // get bytes per pixel
                 size_t bytesPerPixel(){return sizeof(unsigned char);}
 
@@ -432,6 +636,16 @@ class terafly::HyperGridCache
                 // save to disk
                 void save() throw (iim::IOException, iom::exception, tf::RuntimeException);
 
+                // read data from disk into a new buffer without modifying the block (can be called without holding the cache lock)
+                tf::uint8* read(size_t & emptycount) throw (iim::IOException, iom::exception, tf::RuntimeException);
+
+                // store data returned by read() into RAM without counting as an access
+                // - data are discarded (return false) if the block is resident or has been accessed since 'last_access'
+                bool prefetch(tf::uint8* data, size_t emptycount, size_t last_access);
+
+                // save to disk (if modified) and release RAM
+                void evict() throw (iim::IOException, iom::exception, tf::RuntimeException);
+
                 // clear data
                 void clear()
                 {
@@ -439,6 +653,7 @@ class terafly::HyperGridCache
                         delete[] _imdata;
                     _imdata = 0;
                     _hasChanged = 0;
+                    _prefetched = false;
                 }
         };
 };
@@ -119,10 +119,10 @@ void PMain::uninstance()
 {
     /**/tf::debug(tf::LEV1, 0, __itm__current__function__);
 
+    CVolume::uninstance();
     CImport::uninstance();
     PDialogImport::uninstance();
     PAbout::uninstance();
-    CVolume::uninstance();
     CViewer::uninstance();
     CSettings::uninstance();
     CAnnotations::uninstance();
@@ -1356,6 +1356,9 @@ void PMain::closeVolume()
     if(PAnoToolBar::isInstantiated())
         PAnoToolBar::instance()->releaseTools();
 
+    // stop loading data before volumes are released
+    CVolume::instance()->cancel();
+    CVolume::instance()->waitForDone();
     CImport::instance()->reset();
     CVolume::instance()->reset();
 
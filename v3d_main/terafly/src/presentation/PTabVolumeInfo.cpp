@@ -117,6 +117,12 @@ tf::PTabVolumeInfo::PTabVolumeInfo(QWidget *parent) : QWidget(parent)
     vp_refill_coverage_spinbox = new QSpinBox(this);
     vp_refill_coverage_spinbox->setSuffix("%");
     vp_refill_coverage_spinbox->setAlignment(Qt::AlignCenter);
+    vp_refill_threads_spinbox = new QSpinBox(this);
+    vp_refill_threads_spinbox->setAlignment(Qt::AlignCenter);
+    vp_refill_threads_spinbox->setSuffix(" thr");
+    vp_refill_threads_spinbox->setToolTip("Number of threads used to refill blocks concurrently");
+    vp_refill_parallel_io_checkbox = new QCheckBox("parallel I/O", this);
+    vp_refill_parallel_io_checkbox->setToolTip("Refill threads read the unconverted image concurrently (enable only if the image format supports concurrent reads)");
     vp_block_dimX = new QSpinBox(this);
     vp_block_dimX->setAlignment(Qt::AlignCenter);
     vp_block_dimX->setSuffix("(x)");
@@ -157,6 +163,16 @@ tf::PTabVolumeInfo::PTabVolumeInfo(QWidget *parent) : QWidget(parent)
     vp_max_ram_spinbox->setMinimum(0.5);
     vp_max_ram_spinbox->setAlignment(Qt::AlignCenter);
     vp_max_ram_spinbox->setSingleStep(0.1);
+    vp_ram_stats = new QLineEdit(this);
+    vp_ram_stats->setReadOnly(true);
+    vp_ram_stats->setSizePolicy(QSizePolicy::MinimumExpanding, QSizePolicy::Fixed);
+    vp_ram_stats->setTextMargins(5, 0, 0, 0);
+    vp_prefetch_stats = new QLineEdit(this);
+    vp_prefetch_stats->setReadOnly(true);
+    vp_prefetch_stats->setSizePolicy(QSizePolicy::MinimumExpanding, QSizePolicy::Fixed);
+    vp_prefetch_stats->setTextMargins(5, 0, 0, 0);
+    vp_prefetch_checkbox = new QCheckBox("enable", this);
+    vp_prefetch_checkbox->setToolTip("Load neighboring regions and the next higher resolution in background");
     //vp_ram_show_res_buttons = new QPushButton(this);
     //vp_ram_show_res_buttons->setCheckable(true);
 
@@ -219,6 +235,8 @@ tf::PTabVolumeInfo::PTabVolumeInfo(QWidget *parent) : QWidget(parent)
     vp_refill_coverage_spinbox->setFixedWidth(lastColumnWidth);
     expl_panel_layout->addWidget(vp_refill_button,              3,0,1,1);
     expl_panel_layout->addWidget(vp_refill_strategy_combobox,   3,1,1,1);
+    vp_refill_threads_spinbox->setFixedWidth(lastColumnWidth);
+    expl_panel_layout->addWidget(vp_refill_threads_spinbox,     3,2,1,1);
     expl_panel_layout->addWidget(vp_refill_auto_checkbox,       4,0,2,1, Qt::AlignCenter);
     expl_panel_layout->addWidget(vp_refill_stop_combobox,       4,1,1,1);
     expl_panel_layout->addWidget(vp_refill_times_spinbox,       4,2,1,1);
@@ -229,6 +247,7 @@ tf::PTabVolumeInfo::PTabVolumeInfo(QWidget *parent) : QWidget(parent)
     block_layout->addWidget(vp_block_dimY);
     block_layout->addWidget(vp_block_dimZ);
     expl_panel_layout->addLayout(block_layout,                  5,1,1,1);
+    expl_panel_layout->addWidget(vp_refill_parallel_io_checkbox,6,1,1,2);
     vp_exploration_panel->setLayout(expl_panel_layout);
     /* ----------- allocated RAM panel --------------- */
     QGridLayout* vp_RAM_layout = new QGridLayout();
@@ -248,6 +267,12 @@ tf::PTabVolumeInfo::PTabVolumeInfo(QWidget *parent) : QWidget(parent)
         vp_RAM_layout->addWidget(vp_ram_clear_buttons[i],       i+1,2,1,1);
         vp_ram_clear_buttons[i]->setFixedWidth(lastColumnWidth);
     }
+    vp_RAM_layout->addWidget(new QLabel("Blocks:"),             vp_ram_max_size+1,0,1,1);
+    vp_RAM_layout->addWidget(vp_ram_stats,                      vp_ram_max_size+1,1,1,2);
+    vp_RAM_layout->addWidget(new QLabel("Prefetch:"),           vp_ram_max_size+2,0,1,1);
+    vp_RAM_layout->addWidget(vp_prefetch_stats,                 vp_ram_max_size+2,1,1,1);
+    vp_prefetch_checkbox->setFixedWidth(lastColumnWidth);
+    vp_RAM_layout->addWidget(vp_prefetch_checkbox,              vp_ram_max_size+2,2,1,1);
     vp_ram_panel->setLayout(vp_RAM_layout);
     /* ---------------- MAIN LAYOUT ------------------ */
     QVBoxLayout* pyramid_layout = new QVBoxLayout();
@@ -288,6 +313,9 @@ tf::PTabVolumeInfo::PTabVolumeInfo(QWidget *parent) : QWidget(parent)
     connect(vp_refill_auto_checkbox, SIGNAL(toggled(bool)), this, SLOT(vp_refill_auto_checkbox_changed(bool)));
     connect(vp_refill_stop_combobox, SIGNAL(currentIndexChanged(int)), this, SLOT(vp_refill_stop_combobox_changed(int)));
     connect(vp_refill_coverage_spinbox, SIGNAL(valueChanged(int)), this, SLOT(vp_refill_coverage_spinbox_changed(int)));
+    connect(vp_refill_threads_spinbox, SIGNAL(valueChanged(int)), this, SLOT(vp_refill_threads_spinbox_changed(int)));
+    connect(vp_refill_parallel_io_checkbox, SIGNAL(toggled(bool)), this, SLOT(vp_refill_parallel_io_checkbox_changed(bool)));
+    connect(vp_prefetch_checkbox, SIGNAL(toggled(bool)), this, SLOT(vp_prefetch_checkbox_changed(bool)));
 
     for(size_t i=0; i<vp_ram_clear_buttons.size(); i++)
         connect(vp_ram_clear_buttons[i], SIGNAL(clicked()), this, SLOT(clear_button_clicked()));
@@ -308,6 +336,8 @@ void tf::PTabVolumeInfo::reset()
     vp_subsampling->setText("");
     vp_tiledims->setText("");
     vp_tileformat->setText("");
+    vp_ram_stats->setText("");
+    vp_prefetch_stats->setText("");
     vp_panel->setVisible(false);
     vp_ram_panel->setVisible(false);
     vp_exploration_panel->setVisible(false);
@@ -366,6 +396,14 @@ void tf::PTabVolumeInfo::reset()
     vp_refill_stop_combobox->setCurrentIndex(CSettings::instance()->getVpRefillStopCondition());
     vp_refill_stop_combobox_changed(vp_refill_stop_combobox->currentIndex());
 
+    vp_refill_threads_spinbox->setMinimum(1);
+    vp_refill_threads_spinbox->setMaximum(64);
+    vp_refill_threads_spinbox->setValue(CSettings::instance()->getVpRefillThreads());
+    vp_refill_parallel_io_checkbox->setChecked(CSettings::instance()->getVpRefillParallelIO());
+    tf::VirtualPyramid::parallel_io = CSettings::instance()->getVpRefillParallelIO();
+    vp_prefetch_checkbox->setChecked(CSettings::instance()->getVpPrefetch());
+    refill_in_background = false;
+
 }
 
 void tf::PTabVolumeInfo::init()
@@ -437,6 +475,8 @@ void tf::PTabVolumeInfo::init()
         vp_block_dimY->setValue(pyramid[0]->blockDim().y);
         vp_block_dimZ->setValue(pyramid[0]->blockDim().z);
 
+        virtualPyramid->setRamBudget(vp_max_ram_spinbox->value());
+
         recheck_button_clicked();
 
         if(vp_ram_max_size < pyramid.size() + 1)
@@ -548,13 +588,30 @@ void tf::PTabVolumeInfo::update()
     if(!virtualPyramid)
         return;
 
+    // background refill completed: show new data
+    if(refill_in_background && !virtualPyramid->refillRunning())
+    {
+        refill_in_background = false;
+        try
+        {
+            virtualPyramid->refillWait(0);
+        }
+        catch(tf::RuntimeException & ex)
+        {
+            QMessageBox::critical(this,QObject::tr("Error"), QObject::tr(ex.what()),QObject::tr("Ok"));
+        }
+        viewer->refresh();
+    }
+
+    // cache layers may be accessed by refill threads: read a snapshot of their statistics instead of waiting for them
+    std::vector <tf::VirtualPyramid::cache_stats> cache = virtualPyramid->cacheStats();
+
     // update RAM usage for each Virtual Pyramid cache layer
-    std::vector <tf::HyperGridCache*> cache = virtualPyramid->cachePyramid();
     float sum = 0;
     for(int i=0; i<cache.size(); i++)
     {
-        float allocableMB = cache[i]->memoryMax() * 1000;
-        float allocatedMB = cache[i]->memoryUsed() * 1000;
+        float allocableMB = cache[i].memoryMax * 1000;
+        float allocatedMB = cache[i].memoryUsed * 1000;
         sum += allocatedMB;
         if(allocableMB < 100)
             vp_ram_bars[i+1]->setText(tf::strprintf("%.1f/%.1f MB", allocatedMB, allocableMB));
@@ -576,20 +633,43 @@ void tf::PTabVolumeInfo::update()
     vp_ram_bars[0]->setStep(tf::round(100*(sum/1000.0f)/vp_max_ram_spinbox->value()));
 
 
-    // automatically release RAM resources if needed
+    // update cache hits / misses / evictions
+    size_t hits = 0, misses = 0, evictions = 0, prefetches = 0, prefetch_hits = 0;
+    for(int i=0; i<cache.size(); i++)
+    {
+        hits += cache[i].hits;
+        misses += cache[i].misses;
+        evictions += cache[i].evictions;
+        prefetches += cache[i].prefetches;
+        prefetch_hits += cache[i].prefetchHits;
+    }
+    vp_ram_stats->setText(tf::strprintf("%d hits, %d misses (%.1f%% hit rate), %d evictions",
+                                        int(hits), int(misses), hits+misses ? 100.0f*hits/(hits+misses) : 0.0f, int(evictions)).c_str());
+
+    // update prefetch statistics: prefetch hit rate = fraction of prefetched blocks that have been used afterwards
+    vp_prefetch_stats->setText(tf::strprintf("%d blocks, %d used (%.1f%% hit rate)",
+                                        int(prefetches), int(prefetch_hits), prefetches ? 100.0f*prefetch_hits/prefetches : 0.0f).c_str());
+
+    // automatically release RAM resources if needed (least recently / frequently visited blocks first)
     if(sum/1000 > vp_max_ram_spinbox->value())
     {
-        virtualPyramid->clear(false);
-        recheck_button_clicked();
+        virtualPyramid->setRamBudget(vp_max_ram_spinbox->value());
+
+        // while refilling, RAM is released by the refill threads after each block
+        if(!virtualPyramid->refillRunning() && virtualPyramid->releaseMemory())
+            recheck_button_clicked();
     }
 
-    // update local and global exploration bars
+    // update local and global exploration bars (the local bar is left unchanged if its layer is in use)
     iim::voi3D<> voi( iim::xyz<size_t>(viewer->volH0, viewer->volV0, viewer->volD0), iim::xyz<size_t>(viewer->volH1, viewer->volV1, viewer->volD1) );
-    float completeness_local  = viewer->volResIndex == cache.size() - 1 ? 1.0f : cache[cache.size()-1-viewer->volResIndex]->completeness(voi);
-    float completeness_global = cache[cache.size()-1]->completeness();
-    vp_exploration_bar_local->setStep(tf::round(completeness_local*10000));
+    float completeness_local  = 1.0f;
+    if(viewer->volResIndex == cache.size() - 1 || virtualPyramid->completeness(cache.size()-1-viewer->volResIndex, voi, completeness_local))
+    {
+        vp_exploration_bar_local->setStep(tf::round(completeness_local*10000));
+        vp_exploration_bar_local->setText(tf::strprintf( "Current VOI: %.2f %%", completeness_local*100));
+    }
+    float completeness_global = cache[cache.size()-1].completeness;
     vp_exploration_bar_global->setStep(tf::round(completeness_global*10000));
-    vp_exploration_bar_local->setText(tf::strprintf( "Current VOI: %.2f %%", completeness_local*100));
     vp_exploration_bar_global->setText(tf::strprintf("Whole image: %.2f %%", completeness_global*100));
 
     // refill in background after 3 seconds inactivity
@@ -600,6 +680,9 @@ void tf::PTabVolumeInfo::update()
 void tf::PTabVolumeInfo::ram_limit_changed(double v)
 {
     CSettings::instance()->setRamLimitGB(v);
+    tf::VirtualPyramid *virtualPyramid = CImport::instance()->getVirtualPyramid();
+    if(virtualPyramid)
+        virtualPyramid->setRamBudget(v);
     update();
 }
 
@@ -616,6 +699,8 @@ void tf::PTabVolumeInfo::vp_refill_button_clicked(bool in_background)
     tf::VirtualPyramid *virtualPyramid = CImport::instance()->getVirtualPyramid();
     if(!virtualPyramid)
         return;
+    if(virtualPyramid->refillRunning())
+        return;
     if(vp_exploration_bar_local->finished())
     {
         if(!in_background) // need to be "quiet" if refill is done in background
@@ -630,6 +715,41 @@ void tf::PTabVolumeInfo::vp_refill_button_clicked(bool in_background)
         return;
     }
 
+    // refill settings
+    tf::xyz<size_t> block_dim = tf::xyz<size_t>::biggest();
+    if( ! vp_refill_auto_checkbox->isChecked())
+    {
+        block_dim.x = vp_block_dimX->value();
+        block_dim.y = vp_block_dimY->value();
+        block_dim.z = vp_block_dimZ->value();
+    }
+    int cache_level = virtualPyramid->cachePyramid().size()-1-viewer->volResIndex;
+    iim::voi3D<> voi( iim::xyz<size_t>(viewer->volH0, viewer->volV0, viewer->volD0), iim::xyz<size_t>(viewer->volH1, viewer->volV1, viewer->volD1) );
+    tf::VirtualPyramid::refill_strategy strategy = tf::VirtualPyramid::refill_strategy(vp_refill_strategy_combobox->currentIndex());
+    int n_threads = vp_refill_threads_spinbox->value();
+
+    // background refill: submit one block per thread and return immediately (completion is checked by update())
+    if(in_background)
+    {
+        try
+        {
+            refill_in_background = virtualPyramid->refillAsync(cache_level, voi, strategy, block_dim, n_threads, n_threads) > 0;
+        }
+        catch(tf::RuntimeException & ex)
+        {
+            QMessageBox::critical(this,QObject::tr("Error"), QObject::tr(ex.what()),QObject::tr("Ok"));
+        }
+        catch (iim::IOException & ex)
+        {
+            QMessageBox::critical(this,QObject::tr("Error"), QObject::tr(ex.what()),QObject::tr("Ok"));
+        }
+        catch (iom::exception & ex)
+        {
+            QMessageBox::critical(this,QObject::tr("Error"), QObject::tr(ex.what()),QObject::tr("Ok"));
+        }
+        return;
+    }
+
     // try to lock mutex for refill, if fails return immediately
     if(!refill_mutex.tryLock())
         return;
@@ -645,48 +765,44 @@ void tf::PTabVolumeInfo::vp_refill_button_clicked(bool in_background)
     pMain.setCursor(Qt::BusyCursor);
 
     // prepare progress bar
-    int maximum = in_background ? 1 : vp_refill_stop_combobox->currentIndex() == 0? vp_refill_times_spinbox->value() : vp_refill_coverage_spinbox->value()*100 - vp_exploration_bar_local->step() ;
+    bool by_coverage = vp_refill_stop_combobox->currentIndex() == 1;
+    int maximum = by_coverage ? vp_refill_coverage_spinbox->value()*100 - vp_exploration_bar_local->step() : vp_refill_times_spinbox->value();
     QProgressDialog progress("Refill...", "Cancel", 0, maximum, this);
     progress.setWindowModality(Qt::WindowModal);
     progress.setMinimumDuration(0);
     progress.setLabelText("Refill...");
 
-    tf::xyz<size_t> block_dim = tf::xyz<size_t>::biggest();
-    if( ! vp_refill_auto_checkbox->isChecked())
-    {
-        block_dim.x = vp_block_dimX->value();
-        block_dim.y = vp_block_dimY->value();
-        block_dim.z = vp_block_dimZ->value();
-    }
-
-    // do as many times as requested by user
+    // refill blocks concurrently until done, canceled, or the requested coverage is reached
     try
     {
-        std::vector <tf::HyperGridCache*> cache = virtualPyramid->cachePyramid();
-        int value = 0;
-        while(value < maximum)
+        int submitted = virtualPyramid->refillAsync(cache_level, voi, strategy, block_dim, by_coverage ? -1 : maximum, n_threads);
+        int done = 0, total = 0, last_done = 0;
+        while(!virtualPyramid->refillWait(100))
         {
-            // refill here
-            // @TODO: use a separate thread
-            QApplication::processEvents();
-            iim::voi3D<> voi( iim::xyz<size_t>(viewer->volH0, viewer->volV0, viewer->volD0), iim::xyz<size_t>(viewer->volH1, viewer->volV1, viewer->volD1) );
-            virtualPyramid->refill(cache.size()-1-viewer->volResIndex, voi, tf::VirtualPyramid::refill_strategy(vp_refill_strategy_combobox->currentIndex()), block_dim);
             QApplication::processEvents();
 
-            // update GUI (otherwise it will freeze: we are blocking the event-loop thread)
-           // update();
-
             // show/update progress
-            value = vp_refill_stop_combobox->currentIndex() == 0 || in_background ? value+1 : vp_exploration_bar_local->step() - vp_refill_coverage_spinbox->value()*100 + maximum;
-            progress.setValue(value);
+            virtualPyramid->refillProgress(done, total);
+            if(done != last_done)
+            {
+                last_done = done;
 
-            // refresh
-            viewer->refresh();
+                // refresh (also updates exploration bars)
+                viewer->refresh();
+                update();
+
+                int value = by_coverage ? vp_exploration_bar_local->step() - vp_refill_coverage_spinbox->value()*100 + maximum : done;
+                progress.setValue(std::min(value, maximum));
+                progress.setLabelText(tf::strprintf("Refill block %d of %d...", done, submitted).c_str());
+                if(value >= maximum)
+                    virtualPyramid->refillCancel(false);
+            }
 
             // terminate now if requested by the user
             if (progress.wasCanceled())
-                break;
+                virtualPyramid->refillCancel(false);
         }
+        viewer->refresh();
     }
     catch(tf::RuntimeException & ex)
     {
@@ -802,6 +918,26 @@ void tf::PTabVolumeInfo::vp_refill_coverage_spinbox_changed(int v)
     CSettings::instance()->setVpRefillCoverage(v);
 }
 
+void tf::PTabVolumeInfo::vp_refill_threads_spinbox_changed(int v)
+{
+    CSettings::instance()->setVpRefillThreads(v);
+}
+
+void tf::PTabVolumeInfo::vp_refill_parallel_io_checkbox_changed(bool v)
+{
+    CSettings::instance()->setVpRefillParallelIO(v);
+    tf::VirtualPyramid::parallel_io = v;
+}
+
+void tf::PTabVolumeInfo::vp_prefetch_checkbox_changed(bool v)
+{
+    CSettings::instance()->setVpPrefetch(v);
+
+    // stop pending prefetch jobs
+    if(!v && CImport::instance()->isVirtualPyramid() && CImport::instance()->getVirtualPyramid())
+        CImport::instance()->getVirtualPyramid()->prefetchCancel();
+}
+
 void tf::PTabVolumeInfo::vp_refill_auto_checkbox_changed(bool v)
 {
 //    if(vp_refill_auto_checkbox->isVisible() == false)
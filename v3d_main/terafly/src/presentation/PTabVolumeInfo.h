@@ -81,6 +81,8 @@ class terafly::PTabVolumeInfo : public QWidget
         QComboBox* vp_refill_stop_combobox;
         QSpinBox* vp_refill_times_spinbox;
         QSpinBox* vp_refill_coverage_spinbox;
+        QSpinBox* vp_refill_threads_spinbox;
+        QCheckBox* vp_refill_parallel_io_checkbox;
         QSpinBox* vp_block_dimX;
         QSpinBox* vp_block_dimY;
         QSpinBox* vp_block_dimZ;
@@ -92,10 +94,14 @@ class terafly::PTabVolumeInfo : public QWidget
         std::vector <QLabel*> vp_ram_labels;
         std::vector <QGradientBar*> vp_ram_bars;
         std::vector <QPushButton*> vp_ram_clear_buttons;
+        QLineEdit* vp_ram_stats;
+        QLineEdit* vp_prefetch_stats;
+        QCheckBox* vp_prefetch_checkbox;
         static const size_t vp_ram_max_size = 8;
 
         QTimer updateTimer;
         QMutex refill_mutex;
+        bool refill_in_background;
         CUserInactivityFilter inactivityDetector;
 
 
@@ -125,6 +131,9 @@ class terafly::PTabVolumeInfo : public QWidget
         void vp_refill_auto_checkbox_changed(bool v);
         void vp_refill_stop_combobox_changed(int v);
         void vp_refill_coverage_spinbox_changed(int v);
+        void vp_refill_threads_spinbox_changed(int v);
+        void vp_refill_parallel_io_checkbox_changed(bool v);
+        void vp_prefetch_checkbox_changed(bool v);
 
 };
 
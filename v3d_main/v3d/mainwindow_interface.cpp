@@ -309,6 +309,9 @@ bool XFormWidget::transferImageData(Image4DSimple *img, unsigned char *a) // FIX
 		this->imgData->setOriginZ( img->getOriginZ() );
 		this->imgData->setCustomStructPointer( img->getCustomStructPointer() );
 
+		// the data is now owned by imgData: a memory-mapped stack goes with its releaser, so it is unmapped, not delete []
+		if (a == img->getRawData() && img->getRawDataReleaser())
+			this->imgData->setRawDataPointer( a, img->getRawDataReleaser() );
 		img->setRawDataPointerToNull();
 
 		//setColorGUI(); //110722, 110802 RZC: had called in setImageData() above
@@ -389,6 +392,20 @@ void XFormWidget::pushImageIn3DWindow()
 		mypara_3Dlocalview.window3D->setDataTitle(windowTitle());
 	}
 }
+void XFormWidget::pushDisplayRangeIn3DWindow()
+{
+	V3dR_GLWidget* w = 0;
+	if (mypara_3Dview.b_still_open && mypara_3Dview.window3D
+			&& (w = mypara_3Dview.window3D->getGLWidget()))
+	{
+		w->updateImageDataChannels();
+	}
+	if (mypara_3Dlocalview.b_still_open && mypara_3Dlocalview.window3D
+			&& (w = mypara_3Dlocalview.window3D->getGLWidget()))
+	{
+		w->updateImageDataChannels();
+	}
+}
 int XFormWidget::pushTimepointIn3DWindow(int timepoint)
 {
 	V3dR_GLWidget* w = 0;
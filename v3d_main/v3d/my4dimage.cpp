@@ -491,6 +491,7 @@ void My4DImage::loadImage(const char* filename)
 	cleanExistData();
 
 	bool b_useMylib=false;
+	bool b_mmapRaw=false;
 
 
         bool lsmFlag = false;
@@ -511,11 +512,13 @@ void My4DImage::loadImage(const char* filename)
             b_useMylib = V3dApplication::getMainWindow()->global_setting.b_UseMylibTiff;
             qDebug() << "My4DImage::loadImage() set b_useMylib to value=" << b_useMylib << " based on global settings from MainWindow";
         }
+        if (V3dApplication::getMainWindow())
+            b_mmapRaw = V3dApplication::getMainWindow()->global_setting.b_mmapRawStack;
 
 
         qDebug() << "My4DImage::loadImage() calling Image4DSimple::loadImage() with b_useMylib=" << b_useMylib;
 
-	Image4DSimple::loadImage(filename, b_useMylib);
+	Image4DSimple::loadImage(filename, b_useMylib, b_mmapRaw);
 
 	setupData4D();
 }
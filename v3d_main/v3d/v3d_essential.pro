@@ -185,6 +185,8 @@ HEADERS += ../basic_c_fun/mg_utilities.h \
     ../basic_c_fun/img_definition.h \
     ../basic_c_fun/volimg_proc_declare.h \
     ../basic_c_fun/volimg_proc.h \
+    ../basic_c_fun/volimg_proc_fused.h \
+    ../basic_c_fun/basic_parallel.h \
     ../basic_c_fun/v3d_message.h \
     ../basic_c_fun/color_xyz.h \
     ../basic_c_fun/basic_surf_objs.h \
@@ -204,6 +206,7 @@ HEADERS += ../basic_c_fun/mg_utilities.h \
     ../neuron_editing/apo_xforms.h \
     ../neuron_editing/neuron_xforms.h \
     ../neuron_editing/neuron_sim_scores.h \
+    ../neuron_editing/neuron_seg_index.h \
     ../neuron_editing/v_neuronswc.h \
     ../neuron_editing/neuron_format_converter.h \
     ../neuron_tracing/neuron_tracing.h \
@@ -213,6 +216,9 @@ HEADERS += ../basic_c_fun/mg_utilities.h \
     ../3drenderer/GLee_r.h \
     ../3drenderer/renderer.h \
     ../3drenderer/renderer_gl1.h \
+    ../3drenderer/pickindex.h \
+    ../3drenderer/neurontube.h \
+    ../3drenderer/labelmarchingcubes.h \
     ../3drenderer/v3dr_surfaceDialog.h \
     ../3drenderer/ItemEditor.h \
     ../3drenderer/renderer_gl2.h \
@@ -288,6 +294,7 @@ SOURCES += ../basic_c_fun/mg_utilities.cpp \
     ../basic_c_fun/mg_image_lib.cpp \
     ../basic_c_fun/stackutil.cpp \
     ../basic_c_fun/basic_memory.cpp \
+    ../basic_c_fun/basic_parallel.cpp \
     ../basic_c_fun/v3d_message.cpp \
     ../basic_c_fun/basic_surf_objs.cpp \
     ../basic_c_fun/basic_4dimage.cpp \
@@ -298,6 +305,7 @@ SOURCES += ../basic_c_fun/mg_utilities.cpp \
     ../neuron_editing/apo_xforms.cpp \
     ../neuron_editing/neuron_xforms.cpp \
     ../neuron_editing/neuron_sim_scores.cpp \
+    ../neuron_editing/neuron_seg_index.cpp \
     ../neuron_editing/v_neuronswc.cpp \
     ../neuron_editing/neuron_format_converter.cpp \
     ../neuron_tracing/dij_bgl.cpp \
@@ -309,7 +317,12 @@ SOURCES += ../basic_c_fun/mg_utilities.cpp \
     ../3drenderer/renderer.cpp \
     ../3drenderer/renderer_tex.cpp \
     ../3drenderer/renderer_obj.cpp \
+    ../3drenderer/renderer_brick.cpp \
+    ../3drenderer/renderer_tube.cpp \
     ../3drenderer/renderer_hit.cpp \
+    ../3drenderer/pickindex.cpp \
+    ../3drenderer/neurontube.cpp \
+    ../3drenderer/labelmarchingcubes.cpp \
     ../3drenderer/nstroke.cpp \
     ../3drenderer/nstroke_tracing.cpp \
     ../3drenderer/renderer_labelfield.cpp \
@@ -461,6 +474,7 @@ win32:LIBS += -L../common_lib/winlib64 -lteem  -lbz2 -lz  #for nrrd support
 
 INCLUDEPATH += ../common_lib/include
 DEFINES *= TEEM_STATIC
+DEFINES *= VOLIMG_PROC_THREADS # threaded volimg_proc.h functions, see basic_parallel.cpp
 QMAKE_CXXFLAGS += -DTEEM_STATIC
 
 #removed LIBS+=./??? for Eclipse IDE using customized Build-command or Make-target instead, by RZC 20110709
@@ -38,6 +38,7 @@ v3d_global_preference_dialog.h
  2010-06-01
  2010-06-02
  2010-09-04: by PHC. add b_UseMylibTiff
+ 2026-10-17: add b_mmapRawStack
 **
 ****************************************************************************/
 
@@ -90,6 +91,7 @@ public:
 		spinBox_autoVideoCardStreamMode->setRange(-1,2); spinBox_autoVideoCardStreamMode->setValue(p->autoVideoCardStreamMode);
 		
 		checkBox_libTiff_Mylib->setChecked(!(p->b_UseMylibTiff));
+		checkBox_mmapRawStack->setChecked(p->b_mmapRawStack);
 
 
 		//image analysis
@@ -141,6 +143,7 @@ public:
 		p->b_autoVideoCardNPTTex = checkBox_autoVideoCardNPTTex->isChecked();
 		p->autoVideoCardStreamMode = spinBox_autoVideoCardStreamMode->value();
 		p->b_UseMylibTiff = !(checkBox_libTiff_Mylib->isChecked());
+		p->b_mmapRawStack = checkBox_mmapRawStack->isChecked();
 
 		//image analysis
 		p->GPara_landmarkMatchingMethod = comboBox_reg_markermatch_method->currentIndex(); //100601, by PHC: (PointMatchMethodType)comboBox_reg_markermatch_method->currentIndex();
@@ -183,6 +186,7 @@ public:
 		global_setting.b_autoVideoCardNPTTex = settings.value("b_autoVideoCardNPTTex", def.b_autoVideoCardNPTTex).toBool();
 		global_setting.autoVideoCardStreamMode = settings.value("autoVideoCardStreamMode",def.autoVideoCardStreamMode).toInt();
 		global_setting.b_UseMylibTiff = settings.value("b_UseMylibTiff", def.b_autoVideoCardCompress).toBool();
+		global_setting.b_mmapRawStack = settings.value("b_mmapRawStack", def.b_mmapRawStack).toBool();
 
 		//image analysis tab
 		global_setting.GPara_landmarkMatchingMethod = settings.value("GPara_landmarkMatchingMethod", def.GPara_landmarkMatchingMethod).toInt(); //by PHC, 100601: (PointMatchMethodType)
@@ -223,6 +227,7 @@ public:
 		settings.setValue("b_autoVideoCardNPTTex", global_setting.b_autoVideoCardNPTTex);
 		settings.setValue("autoVideoCardStreamMode", global_setting.autoVideoCardStreamMode);
 		settings.setValue("b_UseMylibTiff", global_setting.b_UseMylibTiff);
+		settings.setValue("b_mmapRawStack", global_setting.b_mmapRawStack);
 
 		//image analysis tab
 		settings.setValue("GPara_landmarkMatchingMethod", global_setting.GPara_landmarkMatchingMethod);
@@ -60,6 +60,7 @@ INCLUDEPATH += $$LOCAL_DIR/include \
 LIBS += -L$$LOCAL_DIR/lib \
 	-L$$WINGW_DIR/lib
 CONFIG += qtestlib # for preview movie animation, by RZC
+DEFINES *= VOLIMG_PROC_THREADS # threaded volimg_proc.h functions, see basic_parallel.cpp
 
 # the following trick was figured out by Ruan Zongcai
 # CONFIG += release ### disable most of warnings
@@ -75,6 +76,8 @@ HEADERS += ../basic_c_fun/mg_utilities.h \
     ../basic_c_fun/img_definition.h \
     ../basic_c_fun/volimg_proc_declare.h \
     ../basic_c_fun/volimg_proc.h \
+    ../basic_c_fun/volimg_proc_fused.h \
+    ../basic_c_fun/basic_parallel.h \
     ../worm_straighten_c/bdb_minus.h \
     ../worm_straighten_c/mst_prim_c.h \
     ../worm_straighten_c/bfs.h \
@@ -106,6 +109,7 @@ SOURCES += ../basic_c_fun/mg_utilities.cpp \
     ../basic_c_fun/mg_image_lib.cpp \
     ../basic_c_fun/stackutil.cpp \
     ../basic_c_fun/basic_memory.cpp \
+    ../basic_c_fun/basic_parallel.cpp \
     ../worm_straighten_c/bdb_minus.cpp \
     ../worm_straighten_c/mst_prim_c.cpp \
     ../worm_straighten_c/bfs_1root.cpp \
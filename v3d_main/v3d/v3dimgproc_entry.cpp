@@ -667,6 +667,8 @@ void XFormView::popupImageProcessingDialog(QString item)
 			{
 				imgData->updateminmaxvalues();
 				imgData->updateViews();
+				if (imgData->getXWidget())
+					imgData->getXWidget()->pushDisplayRangeIn3DWindow();
 			}
 			else if (item==tr(" -- invert image color"))
 			{
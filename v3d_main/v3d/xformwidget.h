@@ -428,6 +428,7 @@ public:    // in mainwindow_interface.cpp
 	void closeROI3DWindow();
 	void pushObjectIn3DWindow();
 	void pushImageIn3DWindow();
+	void pushDisplayRangeIn3DWindow(); // only the display range (p_vmin/p_vmax) of some channels changed
 	int pushTimepointIn3DWindow(int timepoint);
 
 	bool screenShot3DWindow(QString filename);